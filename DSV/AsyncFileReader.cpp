@@ -0,0 +1,210 @@
+﻿/**
+ * @file AsyncFileReader.cpp
+ * @brief 异步文件读取类实现文件
+ * @details 该文件实现了基于Windows重叠IO的批量读取，以及其他平台的pread回退
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "AsyncFileReader.h"
+#include "PipelineProfiler.h"
+#include <QString>
+#include <QtGlobal>
+#include <algorithm>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief 构造函数
+ */
+AsyncFileReader::AsyncFileReader() :
+    _handle(NULL),
+    _descriptor(-1)
+{
+}
+
+/**
+ * @brief 析构函数
+ */
+AsyncFileReader::~AsyncFileReader()
+{
+    close();
+}
+
+/**
+ * @brief 打开文件
+ * @param path 文件路径
+ * @return 打开成功时返回true
+ * @details Windows上以重叠IO方式打开，并提示系统按随机访问缓存
+ */
+bool AsyncFileReader::open(const std::string& path)
+{
+    close();
+#ifdef Q_OS_WIN
+    HANDLE handle = CreateFileW(reinterpret_cast<const wchar_t*>(QString::fromStdString(path).utf16()), GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_OVERLAPPED | FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    _handle = handle;
+#else
+    _descriptor = ::open(path.c_str(), O_RDONLY);
+    if (_descriptor < 0) {
+        return false;
+    }
+#endif
+    return true;
+}
+
+/**
+ * @brief 关闭文件
+ */
+void AsyncFileReader::close()
+{
+#ifdef Q_OS_WIN
+    if (_handle) {
+        CloseHandle(static_cast<HANDLE>(_handle));
+        _handle = NULL;
+    }
+#else
+    if (_descriptor >= 0) {
+        ::close(_descriptor);
+        _descriptor = -1;
+    }
+#endif
+}
+
+/**
+ * @brief 检查文件是否已打开
+ * @return 已打开时返回true
+ */
+bool AsyncFileReader::isOpen() const
+{
+#ifdef Q_OS_WIN
+    return _handle != NULL;
+#else
+    return _descriptor >= 0;
+#endif
+}
+
+/**
+ * @brief 读取一批请求
+ * @param requests 读请求
+ * @param onComplete 完成回调
+ * @return 文件已打开时返回true
+ * @details Windows上每个在途请求使用一个手动重置事件，WaitForMultipleObjects等待任一请求完成，
+ *          回调后在同一槽位补发下一个请求。缓存命中时ReadFile同步完成，事件同样被置位，按相同路径处理
+ */
+bool AsyncFileReader::read(const std::vector<Request>& requests, const CompletionHandler& onComplete) const
+{
+    if (!isOpen()) {
+        return false;
+    }
+    if (requests.empty()) {
+        return true;
+    }
+    PipelineProfiler::count(PipelineProfiler::AsyncFileRead, requests.size());
+#ifdef Q_OS_WIN
+    HANDLE handle = static_cast<HANDLE>(_handle);
+    const size_t window = std::min(requests.size(), kMaxInFlight);
+    std::vector<OVERLAPPED> overlapped(window);
+    std::vector<HANDLE> events(window);
+    std::vector<std::vector<unsigned char> > buffers(window);
+    std::vector<size_t> requestOfSlot(window);
+    for (size_t slot = 0; slot < window; ++slot) {
+        events[slot] = CreateEventW(NULL, TRUE, FALSE, NULL);
+        if (!events[slot]) {
+            for (size_t created = 0; created < slot; ++created) {
+                CloseHandle(events[created]);
+            }
+            return false;
+        }
+    }
+
+    // 在途请求的槽位和对应事件，二者顺序一致
+    std::vector<size_t> activeSlots;
+    std::vector<HANDLE> activeEvents;
+    size_t next = 0;
+    auto submit = [&](size_t slot) {
+        while (next < requests.size()) {
+            const Request& request = requests[next];
+            const size_t index = next++;
+            if (request.length == 0 || request.length > 0xFFFFFFFFULL) {
+                continue;
+            }
+            buffers[slot].resize(static_cast<size_t>(request.length));
+            ZeroMemory(&overlapped[slot], sizeof(OVERLAPPED));
+            overlapped[slot].Offset = static_cast<DWORD>(request.offset & 0xFFFFFFFFULL);
+            overlapped[slot].OffsetHigh = static_cast<DWORD>(request.offset >> 32);
+            overlapped[slot].hEvent = events[slot];
+            ResetEvent(events[slot]);
+            if (!ReadFile(handle, buffers[slot].data(), static_cast<DWORD>(request.length), NULL, &overlapped[slot]) &&
+                GetLastError() != ERROR_IO_PENDING) {
+                continue;
+            }
+            requestOfSlot[slot] = index;
+            activeSlots.push_back(slot);
+            activeEvents.push_back(events[slot]);
+            return;
+        }
+    };
+    for (size_t slot = 0; slot < window; ++slot) {
+        submit(slot);
+    }
+
+    while (!activeSlots.empty()) {
+        const DWORD result = WaitForMultipleObjects(static_cast<DWORD>(activeEvents.size()), activeEvents.data(), FALSE, INFINITE);
+        if (result >= WAIT_OBJECT_0 + activeEvents.size()) {
+            // 等待失败时取消剩余请求，缓冲区在请求结束前不能释放
+            for (size_t position = 0; position < activeSlots.size(); ++position) {
+                DWORD transferred = 0;
+                CancelIoEx(handle, &overlapped[activeSlots[position]]);
+                GetOverlappedResult(handle, &overlapped[activeSlots[position]], &transferred, TRUE);
+            }
+            break;
+        }
+        const size_t position = result - WAIT_OBJECT_0;
+        const size_t slot = activeSlots[position];
+        activeSlots.erase(activeSlots.begin() + position);
+        activeEvents.erase(activeEvents.begin() + position);
+
+        DWORD transferred = 0;
+        const size_t index = requestOfSlot[slot];
+        if (GetOverlappedResult(handle, &overlapped[slot], &transferred, FALSE) && transferred == requests[index].length) {
+            onComplete(index, buffers[slot].data(), requests[index].length);
+        }
+        submit(slot);
+    }
+    for (HANDLE event : events) {
+        CloseHandle(event);
+    }
+#else
+    std::vector<unsigned char> buffer;
+    for (size_t index = 0; index < requests.size(); ++index) {
+        const Request& request = requests[index];
+        if (request.length == 0) {
+            continue;
+        }
+        buffer.resize(static_cast<size_t>(request.length));
+        unsigned long long done = 0;
+        while (done < request.length) {
+            const ssize_t bytes = ::pread(_descriptor, buffer.data() + done, static_cast<size_t>(request.length - done),
+                static_cast<off_t>(request.offset + done));
+            if (bytes <= 0) {
+                break;
+            }
+            done += static_cast<unsigned long long>(bytes);
+        }
+        if (done == request.length) {
+            onComplete(index, buffer.data(), request.length);
+        }
+    }
+#endif
+    return true;
+}
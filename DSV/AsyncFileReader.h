@@ -0,0 +1,105 @@
+﻿/**
+ * @file    AsyncFileReader.h
+ * @brief   异步文件读取类，同时发出多个按偏移的读请求
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了原生格式后端使用的异步读取层，包括：
+ *          - Windows上以FILE_FLAG_OVERLAPPED打开文件，用重叠IO同时发出一批读请求
+ *          - 按完成顺序回调，调用者在数据到达后立即解码，其余请求继续在存储上排队
+ *          - 其他平台回退为按顺序的pread
+ *
+ * @note    读取线程之间不共享状态，多个IO工作线程可以同时对同一个对象调用read
+ * @see     TiledTiffImage
+ */
+
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @class  AsyncFileReader
+ * @brief  异步文件读取类
+ * @details 一次read调用最多同时保持kMaxInFlight个请求在途，某个请求完成后立即回调并补发下一个请求。
+ *          存储（尤其是网络存储）的延迟由在途请求重叠，而不需要增加IO工作线程数。
+ *
+ * @example
+ *          AsyncFileReader reader;
+ *          if (reader.open("slide.svs")) {
+ *              std::vector<AsyncFileReader::Request> requests = { { 1024, 4096 }, { 8192, 4096 } };
+ *              reader.read(requests, [](size_t index, const unsigned char* data, unsigned long long length) {
+ *                  // 解码第index个请求的数据
+ *              });
+ *          }
+ * @see     TiledTiffImage::decodeRegion
+ */
+class AsyncFileReader
+{
+public:
+    /**
+     * @struct  Request
+     * @brief   读请求
+     */
+    struct Request {
+        unsigned long long offset;  ///< 文件偏移
+        unsigned long long length;  ///< 字节数
+    };
+
+    /**
+     * @brief   完成回调
+     * @details 参数为请求在列表中的序号、数据和字节数，数据只在回调期间有效
+     */
+    typedef std::function<void(size_t, const unsigned char*, unsigned long long)> CompletionHandler;
+
+    /**
+     * @brief   默认构造函数
+     */
+    AsyncFileReader();
+
+    /**
+     * @brief   析构函数
+     * @details 关闭文件
+     */
+    ~AsyncFileReader();
+
+    /**
+     * @brief   打开文件
+     * @param   path 文件路径（UTF-8）
+     * @return  打开成功时返回true
+     */
+    bool open(const std::string& path);
+
+    /**
+     * @brief   关闭文件
+     * @note    调用者需保证没有进行中的read
+     */
+    void close();
+
+    /**
+     * @brief   检查文件是否已打开
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief   读取一批请求
+     * @details 请求按列表顺序发出，按完成顺序回调；读取失败或不完整的请求不回调
+     * @param   requests 读请求
+     * @param   onComplete 完成回调，在调用线程中执行
+     * @return  文件已打开时返回true
+     */
+    bool read(const std::vector<Request>& requests, const CompletionHandler& onComplete) const;
+
+    /** @brief 一次read调用中同时在途的最大请求数 */
+    static const size_t kMaxInFlight = 32;
+
+private:
+    AsyncFileReader(const AsyncFileReader&);
+    AsyncFileReader& operator=(const AsyncFileReader&);
+
+    /** @brief 文件句柄，仅Windows平台使用 */
+    void* _handle;
+
+    /** @brief 文件描述符，仅非Windows平台使用 */
+    int _descriptor;
+};
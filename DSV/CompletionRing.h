@@ -0,0 +1,154 @@
+﻿/**
+ * @file    CompletionRing.h
+ * @brief   完成队列，工作线程向GUI线程提交结果的无锁有界环形队列
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了多生产者单消费者（MPSC）的有界环形队列，包括：
+ *          - 每个槽位带序号，生产者只用一次CAS占用槽位，不需要加锁
+ *          - 消费者只在一个线程中取出，取出不需要CAS
+ *          - 队列满时push返回false，由调用者决定等待或丢弃
+ *
+ * @note    工作线程各自提交自己的结果，生产者之间只在尾指针上竞争；
+ *          GUI线程按帧取出，取出过程中不会被工作线程阻塞
+ * @see     IOThread::deliverTile, IOThread::processTileDeliveries
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+/**
+ * @class  CompletionRing
+ * @brief  无锁MPSC有界环形队列
+ * @details 槽位的序号等于待写入的位置时可写，等于位置加一时可读；
+ *          消费者读取后把序号设为位置加容量，留给下一轮的生产者。
+ *          容量必须是2的幂。
+ * @tparam  T 元素类型，必须可默认构造和移动赋值
+ *
+ * @example
+ *          // 使用示例
+ *          CompletionRing<TileDelivery> ring(1024);
+ *          ring.push(delivery);          // 任意线程
+ *          TileDelivery result;
+ *          while (ring.pop(result)) { }  // 同一个消费者线程
+ */
+template <typename T>
+class CompletionRing
+{
+public:
+    /**
+     * @brief   构造函数
+     * @param   capacity 容量，向上取整为2的幂
+     */
+    explicit CompletionRing(size_t capacity) :
+        _capacity(roundUpPowerOfTwo(capacity)),
+        _mask(_capacity - 1),
+        _slots(new Slot[_capacity]),
+        _head(0),
+        _tail(0)
+    {
+        for (size_t i = 0; i < _capacity; ++i) {
+            _slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    CompletionRing(const CompletionRing&) = delete;
+    CompletionRing& operator=(const CompletionRing&) = delete;
+
+    /**
+     * @brief   提交一个元素
+     * @param   value 元素，成功时内容被移走
+     * @return  队列满时返回false，value保持不变
+     * @note    可在任意线程中调用
+     */
+    bool push(T& value) {
+        size_t position = _tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = _slots[position & _mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+            if (difference == 0) {
+                if (_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0) {
+                return false;
+            }
+            else {
+                position = _tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief   取出队首元素
+     * @param   value 取出的元素
+     * @return  队列为空（或队首槽位尚未写完）时返回false
+     * @note    只能在消费者线程中调用
+     */
+    bool pop(T& value) {
+        Slot& slot = _slots[_head & _mask];
+        if (slot.sequence.load(std::memory_order_acquire) != _head + 1) {
+            return false;
+        }
+        value = std::move(slot.value);
+        slot.value = T();
+        slot.sequence.store(_head + _capacity, std::memory_order_release);
+        ++_head;
+        return true;
+    }
+
+    /**
+     * @brief   队列是否为空
+     * @return  队首槽位没有已写完的元素时返回true
+     * @note    只能在消费者线程中调用；其他线程调用时结果只是近似值
+     */
+    bool empty() const {
+        size_t head = _head;
+        return _slots[head & _mask].sequence.load(std::memory_order_acquire) != head + 1;
+    }
+
+    /** @brief 容量 */
+    size_t capacity() const { return _capacity; }
+
+private:
+    /**
+     * @brief 槽位
+     * @details 序号与元素放在一起，相邻槽位由不同生产者写入时可能共享缓存行，
+     *          对每帧几十个结果的负载可以接受
+     */
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static size_t roundUpPowerOfTwo(size_t value) {
+        size_t result = 2;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    /** @brief 容量，2的幂 */
+    const size_t _capacity;
+
+    /** @brief 位置到槽位索引的掩码 */
+    const size_t _mask;
+
+    /** @brief 槽位数组 */
+    std::unique_ptr<Slot[]> _slots;
+
+    /** @brief 下一个读取位置，只由消费者访问 */
+    size_t _head;
+
+    /** @brief 下一个写入位置，生产者之间用CAS竞争 */
+    std::atomic<size_t> _tail;
+};
@@ -0,0 +1,451 @@
+﻿/**
+ * @file CompressedTileCache.cpp
+ * @brief 内存压缩瓦片缓存实现文件
+ * @details 该文件实现了压缩瓦片缓存及其使用的两种编码：
+ *          - QOI：按像素与前一像素的差值、最近颜色索引和游程编码，适合8位RGB(A)
+ *          - LZ4块格式：贪心的哈希匹配，用于16位、32位和浮点数据
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "CompressedTileCache.h"
+#include <cstring>
+
+namespace {
+
+    /** @brief QOI像素 */
+    struct QOIPixel {
+        unsigned char r, g, b, a;
+    };
+
+    inline bool operator==(const QOIPixel& first, const QOIPixel& second) {
+        return first.r == second.r && first.g == second.g && first.b == second.b && first.a == second.a;
+    }
+
+    inline unsigned int qoiHash(const QOIPixel& px) {
+        return (px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) % 64;
+    }
+
+    enum QOIOp {
+        QOI_OP_INDEX = 0x00,
+        QOI_OP_DIFF = 0x40,
+        QOI_OP_LUMA = 0x80,
+        QOI_OP_RUN = 0xc0,
+        QOI_OP_RGB = 0xfe,
+        QOI_OP_RGBA = 0xff
+    };
+
+    /**
+     * @brief QOI编码
+     * @details 与QOI规范的数据块相同，不写文件头和结束标记，像素数由原始字节数决定
+     */
+    void encodeQOI(const unsigned char* src, unsigned long long pixels, unsigned int channels, std::vector<unsigned char>& out) {
+        QOIPixel index[64];
+        std::memset(index, 0, sizeof(index));
+        QOIPixel prev = { 0, 0, 0, 255 };
+        unsigned int run = 0;
+        for (unsigned long long i = 0; i < pixels; ++i, src += channels) {
+            QOIPixel px = { src[0], src[1], src[2], channels == 4 ? src[3] : prev.a };
+            if (px == prev) {
+                ++run;
+                if (run == 62 || i + 1 == pixels) {
+                    out.push_back(static_cast<unsigned char>(QOI_OP_RUN | (run - 1)));
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                out.push_back(static_cast<unsigned char>(QOI_OP_RUN | (run - 1)));
+                run = 0;
+            }
+            const unsigned int hash = qoiHash(px);
+            if (index[hash] == px) {
+                out.push_back(static_cast<unsigned char>(QOI_OP_INDEX | hash));
+            }
+            else {
+                index[hash] = px;
+                if (px.a == prev.a) {
+                    const signed char vr = static_cast<signed char>(px.r - prev.r);
+                    const signed char vg = static_cast<signed char>(px.g - prev.g);
+                    const signed char vb = static_cast<signed char>(px.b - prev.b);
+                    const signed char vgr = static_cast<signed char>(vr - vg);
+                    const signed char vgb = static_cast<signed char>(vb - vg);
+                    if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                        out.push_back(static_cast<unsigned char>(QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2)));
+                    }
+                    else if (vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8) {
+                        out.push_back(static_cast<unsigned char>(QOI_OP_LUMA | (vg + 32)));
+                        out.push_back(static_cast<unsigned char>((vgr + 8) << 4 | (vgb + 8)));
+                    }
+                    else {
+                        const unsigned char rgb[4] = { QOI_OP_RGB, px.r, px.g, px.b };
+                        out.insert(out.end(), rgb, rgb + 4);
+                    }
+                }
+                else {
+                    const unsigned char rgba[5] = { QOI_OP_RGBA, px.r, px.g, px.b, px.a };
+                    out.insert(out.end(), rgba, rgba + 5);
+                }
+            }
+            prev = px;
+        }
+    }
+
+    /**
+     * @brief QOI解码
+     * @return 数据完整时返回true
+     */
+    bool decodeQOI(const unsigned char* in, unsigned long long inSize, unsigned char* dst, unsigned long long pixels, unsigned int channels) {
+        QOIPixel index[64];
+        std::memset(index, 0, sizeof(index));
+        QOIPixel px = { 0, 0, 0, 255 };
+        unsigned long long pos = 0;
+        unsigned int run = 0;
+        for (unsigned long long i = 0; i < pixels; ++i, dst += channels) {
+            if (run > 0) {
+                --run;
+            }
+            else {
+                if (pos >= inSize) {
+                    return false;
+                }
+                const unsigned char b1 = in[pos++];
+                if (b1 == QOI_OP_RGB) {
+                    if (pos + 3 > inSize) {
+                        return false;
+                    }
+                    px.r = in[pos]; px.g = in[pos + 1]; px.b = in[pos + 2];
+                    pos += 3;
+                }
+                else if (b1 == QOI_OP_RGBA) {
+                    if (pos + 4 > inSize) {
+                        return false;
+                    }
+                    px.r = in[pos]; px.g = in[pos + 1]; px.b = in[pos + 2]; px.a = in[pos + 3];
+                    pos += 4;
+                }
+                else if ((b1 & 0xc0) == QOI_OP_INDEX) {
+                    px = index[b1];
+                }
+                else if ((b1 & 0xc0) == QOI_OP_DIFF) {
+                    px.r += ((b1 >> 4) & 0x03) - 2;
+                    px.g += ((b1 >> 2) & 0x03) - 2;
+                    px.b += (b1 & 0x03) - 2;
+                }
+                else if ((b1 & 0xc0) == QOI_OP_LUMA) {
+                    if (pos >= inSize) {
+                        return false;
+                    }
+                    const unsigned char b2 = in[pos++];
+                    const int vg = (b1 & 0x3f) - 32;
+                    px.r += vg - 8 + ((b2 >> 4) & 0x0f);
+                    px.g += vg;
+                    px.b += vg - 8 + (b2 & 0x0f);
+                }
+                else {
+                    run = b1 & 0x3f;
+                }
+                index[qoiHash(px)] = px;
+            }
+            dst[0] = px.r;
+            dst[1] = px.g;
+            dst[2] = px.b;
+            if (channels == 4) {
+                dst[3] = px.a;
+            }
+        }
+        return pos == inSize;
+    }
+
+    /** @brief LZ4最短匹配长度 */
+    const unsigned int kLZ4MinMatch = 4;
+
+    /** @brief LZ4块末尾必须为字面量的字节数 */
+    const unsigned int kLZ4LastLiterals = 5;
+
+    /** @brief LZ4最后一个匹配的起点距块末尾的最小字节数 */
+    const unsigned int kLZ4MatchLimit = 12;
+
+    /** @brief 哈希表位数 */
+    const unsigned int kLZ4HashLog = 12;
+
+    inline unsigned int read32(const unsigned char* p) {
+        unsigned int value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline unsigned int lz4Hash(unsigned int sequence) {
+        return (sequence * 2654435761U) >> (32 - kLZ4HashLog);
+    }
+
+    /** @brief 写入LZ4扩展长度（连续的255加余数） */
+    inline void writeLength(std::vector<unsigned char>& out, unsigned long long length) {
+        while (length >= 255) {
+            out.push_back(255);
+            length -= 255;
+        }
+        out.push_back(static_cast<unsigned char>(length));
+    }
+
+    /** @brief 写入一个序列：字面量和可选的匹配 */
+    void writeSequence(std::vector<unsigned char>& out, const unsigned char* literals, unsigned long long literalLength,
+        unsigned int offset, unsigned long long matchLength) {
+        const unsigned long long matchCode = matchLength ? matchLength - kLZ4MinMatch : 0;
+        out.push_back(static_cast<unsigned char>((literalLength < 15 ? literalLength : 15) << 4 | (matchCode < 15 ? matchCode : 15)));
+        if (literalLength >= 15) {
+            writeLength(out, literalLength - 15);
+        }
+        out.insert(out.end(), literals, literals + literalLength);
+        if (matchLength) {
+            out.push_back(static_cast<unsigned char>(offset & 0xff));
+            out.push_back(static_cast<unsigned char>(offset >> 8));
+            if (matchCode >= 15) {
+                writeLength(out, matchCode - 15);
+            }
+        }
+    }
+
+    /**
+     * @brief LZ4块编码
+     * @details 单遍贪心匹配，未命中时按距上次匹配的距离加大步长，跳过不可压缩的区域
+     */
+    void encodeLZ4(const unsigned char* src, unsigned long long size, std::vector<unsigned char>& out) {
+        unsigned long long anchor = 0;
+        if (size > kLZ4MatchLimit) {
+            int table[1 << kLZ4HashLog];
+            std::fill(table, table + (1 << kLZ4HashLog), -1);
+            const unsigned long long matchLimit = size - kLZ4MatchLimit;
+            const unsigned long long matchEnd = size - kLZ4LastLiterals;
+            unsigned long long ip = 0;
+            while (ip <= matchLimit) {
+                const unsigned int sequence = read32(src + ip);
+                const unsigned int hash = lz4Hash(sequence);
+                const int ref = table[hash];
+                table[hash] = static_cast<int>(ip);
+                if (ref >= 0 && ip - ref <= 0xffff && read32(src + ref) == sequence) {
+                    unsigned long long length = kLZ4MinMatch;
+                    while (ip + length < matchEnd && src[ref + length] == src[ip + length]) {
+                        ++length;
+                    }
+                    writeSequence(out, src + anchor, ip - anchor, static_cast<unsigned int>(ip - ref), length);
+                    ip += length;
+                    anchor = ip;
+                }
+                else {
+                    ip += 1 + ((ip - anchor) >> 6);
+                }
+            }
+        }
+        writeSequence(out, src + anchor, size - anchor, 0, 0);
+    }
+
+    /** @brief 读取LZ4扩展长度 */
+    inline bool readLength(const unsigned char* in, unsigned long long inSize, unsigned long long& pos, unsigned long long& length) {
+        unsigned char byte;
+        do {
+            if (pos >= inSize) {
+                return false;
+            }
+            byte = in[pos++];
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    /**
+     * @brief LZ4块解码
+     * @return 数据完整且解码长度等于size时返回true
+     */
+    bool decodeLZ4(const unsigned char* in, unsigned long long inSize, unsigned char* dst, unsigned long long size) {
+        unsigned long long pos = 0;
+        unsigned long long outPos = 0;
+        while (pos < inSize) {
+            const unsigned char token = in[pos++];
+            unsigned long long literalLength = token >> 4;
+            if (literalLength == 15 && !readLength(in, inSize, pos, literalLength)) {
+                return false;
+            }
+            if (pos + literalLength > inSize || outPos + literalLength > size) {
+                return false;
+            }
+            std::memcpy(dst + outPos, in + pos, literalLength);
+            pos += literalLength;
+            outPos += literalLength;
+            if (pos == inSize) {
+                break;
+            }
+            if (pos + 2 > inSize) {
+                return false;
+            }
+            const unsigned int offset = in[pos] | (in[pos + 1] << 8);
+            pos += 2;
+            unsigned long long matchLength = token & 0x0f;
+            if (matchLength == 15 && !readLength(in, inSize, pos, matchLength)) {
+                return false;
+            }
+            matchLength += kLZ4MinMatch;
+            if (offset == 0 || offset > outPos || outPos + matchLength > size) {
+                return false;
+            }
+            // 匹配可能与输出重叠（offset小于长度），逐字节复制
+            const unsigned char* match = dst + outPos - offset;
+            for (unsigned long long i = 0; i < matchLength; ++i) {
+                dst[outPos + i] = match[i];
+            }
+            outPos += matchLength;
+        }
+        return outPos == size;
+    }
+
+}
+
+const double CompressedTileCache::kMinCompressionRatio = 1.25;
+
+/**
+ * @brief 构造函数
+ * @param maxByteSize 压缩数据的最大字节数
+ */
+CompressedTileCache::CompressedTileCache(unsigned long long maxByteSize) :
+    _tiles(maxByteSize)
+{
+}
+
+/**
+ * @brief 读取并解压瓦片
+ * @param key 缓存键
+ * @param data 输出缓冲区
+ * @param byteSize 期望的原始字节数
+ * @return 命中时返回true
+ * @details 在分片锁内解压，保证解压期间缓存项不会被淘汰
+ */
+bool CompressedTileCache::get(unsigned long long key, void* data, unsigned long long byteSize)
+{
+    return _tiles.visit(key, [data, byteSize](unsigned char* blob, unsigned int size) {
+        return decompress(blob, size, data, byteSize);
+    });
+}
+
+/**
+ * @brief 压缩并保存瓦片
+ * @param key 缓存键
+ * @param data 原始数据
+ * @param byteSize 原始字节数
+ * @param channels 8位数据的每像素通道数
+ * @details 曾经命中过的瓦片解压后回到解码瓦片缓存，再次淘汰时这里仍保留着，无需重新压缩
+ */
+void CompressedTileCache::put(unsigned long long key, const void* data, unsigned long long byteSize, unsigned int channels)
+{
+    if (byteSize == 0 || byteSize > 0x7FFFFFFFULL || _tiles.maxCacheSize() == 0) {
+        return;
+    }
+    if (_tiles.visit(key, [](unsigned char*, unsigned int) { return true; })) {
+        return;
+    }
+    thread_local std::vector<unsigned char> blob;
+    compress(data, byteSize, channels, blob);
+    if (blob.size() * kMinCompressionRatio > byteSize) {
+        return;
+    }
+    unsigned char* stored = new unsigned char[blob.size()];
+    std::memcpy(stored, blob.data(), blob.size());
+    if (_tiles.set(key, stored, static_cast<unsigned int>(blob.size()))) {
+        delete[] stored;
+    }
+}
+
+/**
+ * @brief 设置压缩数据的最大字节数
+ * @param maxByteSize 字节数
+ */
+void CompressedTileCache::setMaxCacheSize(unsigned long long maxByteSize)
+{
+    _tiles.setMaxCacheSize(maxByteSize);
+}
+
+/**
+ * @brief 获取压缩数据的最大字节数
+ * @return 字节数
+ */
+unsigned long long CompressedTileCache::maxCacheSize() const
+{
+    return _tiles.maxCacheSize();
+}
+
+/**
+ * @brief 获取压缩数据当前占用的字节数
+ * @return 字节数
+ */
+unsigned long long CompressedTileCache::currentCacheSize() const
+{
+    return _tiles.currentCacheSize();
+}
+
+/**
+ * @brief 清空缓存
+ */
+void CompressedTileCache::clear()
+{
+    _tiles.clear();
+}
+
+/**
+ * @brief 压缩数据
+ * @param data 原始数据
+ * @param byteSize 原始字节数
+ * @param channels 8位数据的每像素通道数
+ * @param blob 输出的缓存项
+ */
+void CompressedTileCache::compress(const void* data, unsigned long long byteSize, unsigned int channels, std::vector<unsigned char>& blob)
+{
+    const unsigned char* src = static_cast<const unsigned char*>(data);
+    const bool qoi = (channels == 3 || channels == 4) && byteSize % channels == 0;
+    blob.clear();
+    blob.push_back(static_cast<unsigned char>(qoi ? (static_cast<unsigned int>(QOI) | channels << 4) : static_cast<unsigned int>(LZ4)));
+    for (unsigned int i = 0; i < 4; ++i) {
+        blob.push_back(static_cast<unsigned char>(byteSize >> (8 * i)));
+    }
+    if (qoi) {
+        encodeQOI(src, byteSize / channels, channels, blob);
+    }
+    else {
+        encodeLZ4(src, byteSize, blob);
+    }
+}
+
+/**
+ * @brief 解压数据
+ * @param blob 缓存项
+ * @param blobSize 缓存项字节数
+ * @param data 输出缓冲区
+ * @param byteSize 期望的原始字节数
+ * @return 解压成功时返回true
+ * @details QOI项的通道数记录在编码字节的高4位
+ */
+bool CompressedTileCache::decompress(const unsigned char* blob, unsigned long long blobSize, void* data, unsigned long long byteSize)
+{
+    if (blobSize < kHeaderSize) {
+        return false;
+    }
+    unsigned long long rawSize = 0;
+    for (unsigned int i = 0; i < 4; ++i) {
+        rawSize |= static_cast<unsigned long long>(blob[1 + i]) << (8 * i);
+    }
+    if (rawSize != byteSize) {
+        return false;
+    }
+    unsigned char* dst = static_cast<unsigned char*>(data);
+    const unsigned char codec = blob[0] & 0x0f;
+    if (codec == QOI) {
+        const unsigned int channels = blob[0] >> 4;
+        if ((channels != 3 && channels != 4) || byteSize % channels != 0) {
+            return false;
+        }
+        return decodeQOI(blob + kHeaderSize, blobSize - kHeaderSize, dst, byteSize / channels, channels);
+    }
+    else if (codec == LZ4) {
+        return decodeLZ4(blob + kHeaderSize, blobSize - kHeaderSize, dst, byteSize);
+    }
+    return false;
+}
@@ -0,0 +1,125 @@
+﻿/**
+ * @file    CompressedTileCache.h
+ * @brief   内存压缩瓦片缓存类，保存从解码瓦片缓存淘汰的瓦片
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了位于解码瓦片缓存与磁盘缓存之间的内存压缩层，包括：
+ *          - 8位3/4通道数据（原生RGB(A)和ARGB32瓦片）使用QOI编码
+ *          - 其他数据类型使用LZ4块格式编码
+ *          - 按压缩后的字节数做LRU淘汰
+ *          解压一个瓦片远比重新解码JPEG便宜，相同内存预算下可以保留更多的切片区域。
+ *
+ * @note    该类是线程安全的，IOWorker、PrefetchThread和淘汰回调可以并发访问
+ * @see     TileCache, MultiResolutionImage, DiskTileCache
+ */
+
+#pragma once
+
+#include "TileCache.hpp"
+#include <vector>
+
+/**
+ * @class  CompressedTileCache
+ * @brief  内存压缩瓦片缓存
+ * @details 以解码瓦片缓存键索引，每项为 [编码 1字节][原始字节数 4字节][编码数据]，
+ *          编码字节的低4位为Codec，QOI项的高4位为通道数。
+ *          压缩率低于kMinCompressionRatio的瓦片不保存，直接丢弃。
+ *
+ * @example
+ *          // 使用示例
+ *          CompressedTileCache compressed(64 * 1024 * 1024);
+ *          compressed.put(key, data, byteSize, 3);
+ *          if (compressed.get(key, buffer, byteSize)) {
+ *              // 使用buffer
+ *          }
+ * @see     MultiResolutionImage::readFromCompressedCache
+ */
+class CompressedTileCache
+{
+public:
+    /**
+     * @brief 编码方式
+     */
+    enum Codec {
+        QOI = 1,    ///< 8位3/4通道像素
+        LZ4 = 2     ///< 任意字节流
+    };
+
+    /**
+     * @brief   构造函数
+     * @param   maxByteSize 压缩数据的最大字节数
+     */
+    explicit CompressedTileCache(unsigned long long maxByteSize);
+
+    /**
+     * @brief   读取并解压瓦片
+     * @param   key 解码瓦片缓存键
+     * @param   data 输出缓冲区
+     * @param   byteSize 期望的原始字节数
+     * @return  命中且大小一致时返回true
+     */
+    bool get(unsigned long long key, void* data, unsigned long long byteSize);
+
+    /**
+     * @brief   压缩并保存瓦片
+     * @param   key 解码瓦片缓存键
+     * @param   data 原始数据
+     * @param   byteSize 原始字节数
+     * @param   channels 8位数据的每像素通道数，为3或4时使用QOI，其余使用LZ4
+     * @note    键已存在、瓦片超过上限或压缩率过低时忽略
+     */
+    void put(unsigned long long key, const void* data, unsigned long long byteSize, unsigned int channels);
+
+    /**
+     * @brief   设置压缩数据的最大字节数
+     * @param   maxByteSize 字节数，超出部分立即淘汰
+     */
+    void setMaxCacheSize(unsigned long long maxByteSize);
+
+    /**
+     * @brief   获取压缩数据的最大字节数
+     * @return  字节数
+     */
+    unsigned long long maxCacheSize() const;
+
+    /**
+     * @brief   获取压缩数据当前占用的字节数
+     * @return  字节数
+     */
+    unsigned long long currentCacheSize() const;
+
+    /**
+     * @brief   清空缓存
+     */
+    void clear();
+
+    /**
+     * @brief   压缩数据
+     * @param   data 原始数据
+     * @param   byteSize 原始字节数
+     * @param   channels 8位数据的每像素通道数
+     * @param   blob 输出的缓存项（含头部）
+     */
+    static void compress(const void* data, unsigned long long byteSize, unsigned int channels, std::vector<unsigned char>& blob);
+
+    /**
+     * @brief   解压数据
+     * @param   blob 缓存项（含头部）
+     * @param   blobSize 缓存项字节数
+     * @param   data 输出缓冲区
+     * @param   byteSize 期望的原始字节数
+     * @return  数据完整且大小一致时返回true
+     */
+    static bool decompress(const unsigned char* blob, unsigned long long blobSize, void* data, unsigned long long byteSize);
+
+private:
+    /** @brief 缓存项头部字节数 */
+    static const unsigned int kHeaderSize = 5;
+
+    /** @brief 保存瓦片所需的最小压缩率（原始字节数/压缩字节数） */
+    static const double kMinCompressionRatio;
+
+    /** @brief 压缩后的瓦片 */
+    TileCache<unsigned char> _tiles;
+};
@@ -0,0 +1,482 @@
+﻿/**
+ * @file DeepZoomImage.cpp
+ * @brief Deep Zoom远程切片实现文件
+ * @details 该文件实现了通过HTTP读取DZI金字塔的功能，包括：
+ *          - DZI描述文件的下载和解析
+ *          - 每个线程独立的网络连接和并发瓦片请求
+ *          - 去掉重叠边后的瓦片拼接
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "DeepZoomImage.h"
+#include "PipelineProfiler.h"
+#include "PipelineTrace.h"
+#include "TileBufferPool.h"
+#include <QCryptographicHash>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QThreadStorage>
+#include <QXmlStreamReader>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <shared_mutex>
+
+namespace {
+
+    /**
+     * @brief 获取当前线程的网络连接管理器
+     * @details QNetworkAccessManager只能在创建它的线程中使用，每个IO工作线程各自持有一个，
+     *          线程结束时由QThreadStorage释放
+     */
+    QNetworkAccessManager* threadNetworkManager()
+    {
+        static QThreadStorage<QNetworkAccessManager*> managers;
+        if (!managers.hasLocalData()) {
+            managers.setLocalData(new QNetworkAccessManager());
+        }
+        return managers.localData();
+    }
+
+    /**
+     * @brief 并发下载一组地址
+     * @param urls 地址列表
+     * @param timeout 单个请求的传输超时（毫秒）
+     * @param validator 可为NULL；不为NULL时输出第一个请求的ETag或Last-Modified
+     * @return 与urls一一对应的响应内容，失败的请求为空
+     * @details 全部请求同时发出，允许HTTP流水线和HTTP/2多路复用，用局部事件循环等待全部完成
+     */
+    std::vector<QByteArray> fetchAll(const std::vector<QUrl>& urls, int timeout, QByteArray* validator)
+    {
+        std::vector<QByteArray> bodies(urls.size());
+        if (urls.empty()) {
+            return bodies;
+        }
+        QNetworkAccessManager* manager = threadNetworkManager();
+        QEventLoop loop;
+        size_t pending = urls.size();
+        std::vector<QNetworkReply*> replies;
+        replies.reserve(urls.size());
+        for (const QUrl& url : urls) {
+            QNetworkRequest request(url);
+            request.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
+            request.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+            request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+            request.setTransferTimeout(timeout);
+            QNetworkReply* reply = manager->get(request);
+            QObject::connect(reply, &QNetworkReply::finished, &loop, [&pending, &loop]() {
+                if (--pending == 0) {
+                    loop.quit();
+                }
+            });
+            replies.push_back(reply);
+        }
+        loop.exec(QEventLoop::ExcludeUserInputEvents);
+
+        for (size_t i = 0; i < replies.size(); ++i) {
+            QNetworkReply* reply = replies[i];
+            if (reply->error() == QNetworkReply::NoError) {
+                bodies[i] = reply->readAll();
+                if (validator && i == 0) {
+                    *validator = reply->rawHeader("ETag");
+                    if (validator->isEmpty()) {
+                        *validator = reply->rawHeader("Last-Modified");
+                    }
+                }
+            }
+            delete reply;
+        }
+        return bodies;
+    }
+
+    /**
+     * @brief 把名称转换为地址
+     * @param fileName http(s)或file地址，或本地路径
+     * @return 地址，本地路径转换为file地址
+     */
+    QUrl toUrl(const std::string& fileName)
+    {
+        const QString name = QString::fromStdString(fileName);
+        QUrl url(name);
+        const QString scheme = url.scheme().toLower();
+        if (scheme == "http" || scheme == "https" || scheme == "file") {
+            return url;
+        }
+        return QUrl::fromLocalFile(name);
+    }
+}
+
+/**
+ * @brief 构造函数
+ */
+DeepZoomImage::DeepZoomImage()
+    : MultiResolutionImage(),
+    _tileSize(0),
+    _overlap(0),
+    _maxDziLevel(0)
+{
+}
+
+/**
+ * @brief 析构函数
+ */
+DeepZoomImage::~DeepZoomImage()
+{
+    std::unique_lock<std::shared_mutex> l(*_openCloseMutex);
+    cleanup();
+    MultiResolutionImage::cleanup();
+}
+
+/**
+ * @brief 检查名称是否为DZI描述文件
+ * @param fileName URL或本地路径
+ * @return 扩展名为.dzi时返回true
+ */
+bool DeepZoomImage::isDeepZoomName(const std::string& fileName)
+{
+    return toUrl(fileName).path().toLower().endsWith(".dzi");
+}
+
+/**
+ * @brief 解析DZI描述文件
+ * @param descriptor 描述文件内容
+ * @return 描述有效时返回true
+ */
+bool DeepZoomImage::parseDescriptor(const QByteArray& descriptor)
+{
+    QXmlStreamReader xml(descriptor);
+    bool haveImage = false;
+    unsigned long long width = 0, height = 0;
+    while (!xml.atEnd()) {
+        if (xml.readNext() != QXmlStreamReader::StartElement) {
+            continue;
+        }
+        const QXmlStreamAttributes attributes = xml.attributes();
+        if (xml.name() == QLatin1String("Image")) {
+            _tileSize = attributes.value("TileSize").toUInt();
+            _overlap = attributes.value("Overlap").toUInt();
+            _format = attributes.value("Format").toString().toLower();
+            haveImage = true;
+        }
+        else if (xml.name() == QLatin1String("Size")) {
+            width = attributes.value("Width").toULongLong();
+            height = attributes.value("Height").toULongLong();
+        }
+    }
+    if (xml.hasError() || !haveImage || _tileSize == 0 || _format.isEmpty() || width == 0 || height == 0) {
+        return false;
+    }
+
+    const unsigned long long longSide = std::max(width, height);
+    _maxDziLevel = 0;
+    while ((1ULL << _maxDziLevel) < longSide) {
+        ++_maxDziLevel;
+    }
+    for (unsigned int level = 0; level <= _maxDziLevel; ++level) {
+        std::vector<unsigned long long> dims;
+        dims.push_back((width + (1ULL << level) - 1) >> level);
+        dims.push_back((height + (1ULL << level) - 1) >> level);
+        _levelDimensions.push_back(dims);
+        std::vector<unsigned long long> tileSize(2, _tileSize);
+        _levelTileSizes.push_back(tileSize);
+        if (std::max(dims[0], dims[1]) <= _tileSize) {
+            break;
+        }
+    }
+    _numberOfLevels = static_cast<unsigned int>(_levelDimensions.size());
+    return true;
+}
+
+/**
+ * @brief 初始化Deep Zoom图像
+ * @param imagePath 描述文件的URL或本地路径
+ * @return 初始化是否成功
+ * @details 瓦片目录为描述文件去掉.dzi后加"_files/"，查询参数保留给每个瓦片请求
+ */
+bool DeepZoomImage::initializeType(const std::string& imagePath)
+{
+    std::unique_lock<std::shared_mutex> l(*_openCloseMutex);
+    cleanup();
+
+    _descriptorUrl = toUrl(imagePath);
+    QByteArray validator;
+    const QByteArray descriptor = fetchAll(std::vector<QUrl>(1, _descriptorUrl), kRequestTimeout, &validator)[0];
+    if (descriptor.isEmpty() || !parseDescriptor(descriptor)) {
+        cleanup();
+        _isValid = false;
+        return false;
+    }
+
+    QString path = _descriptorUrl.path();
+    path.chop(4);
+    _tilesUrl = _descriptorUrl;
+    _tilesUrl.setPath(path + "_files/");
+
+    if (validator.isEmpty() && _descriptorUrl.isLocalFile()) {
+        QFileInfo info(_descriptorUrl.toLocalFile());
+        validator = QByteArray::number(info.lastModified().toMSecsSinceEpoch());
+    }
+    if (validator.isEmpty()) {
+        validator = QCryptographicHash::hash(descriptor, QCryptographicHash::Sha1).toHex();
+    }
+    _identity = (_descriptorUrl.toString() + "|" + QString::fromLatin1(validator)).toStdString();
+
+    _dataType = SlideColorManagement::DataType::UChar;
+    _samplesPerPixel = 3;
+    _colorType = SlideColorManagement::ColorType::RGB;
+    _fileType = "deepzoom";
+
+    _properties.emplace_back("deepzoom.url", false, 0.0, _descriptorUrl.toString().toStdString());
+    _properties.emplace_back("deepzoom.tile-size", true, static_cast<double>(_tileSize));
+    _properties.emplace_back("deepzoom.overlap", true, static_cast<double>(_overlap));
+    _properties.emplace_back("deepzoom.format", false, 0.0, _format.toStdString());
+    _properties.emplace_back("openslide.level-count", true, static_cast<double>(_numberOfLevels));
+    _properties.emplace_back("openslide.level[0].width", true, static_cast<double>(_levelDimensions[0][0]));
+    _properties.emplace_back("openslide.level[0].height", true, static_cast<double>(_levelDimensions[0][1]));
+
+    _isValid = true;
+    return _isValid;
+}
+
+/**
+ * @brief 清理资源
+ * @details 清空描述信息、层级和属性
+ */
+void DeepZoomImage::cleanup()
+{
+    _descriptorUrl = QUrl();
+    _tilesUrl = QUrl();
+    _format.clear();
+    _tileSize = 0;
+    _overlap = 0;
+    _maxDziLevel = 0;
+    _identity.clear();
+    _levelDimensions.clear();
+    _levelTileSizes.clear();
+    _spacing.clear();
+    _properties.clear();
+}
+
+/**
+ * @brief 获取瓦片地址
+ * @param level 层级
+ * @param column 瓦片列
+ * @param row 瓦片行
+ * @return 瓦片地址
+ */
+QUrl DeepZoomImage::tileUrl(unsigned int level, long long column, long long row) const
+{
+    QUrl url = _tilesUrl;
+    url.setPath(_tilesUrl.path() + QString::number(_maxDziLevel - level) + "/" + QString::number(column) + "_" +
+        QString::number(row) + "." + _format);
+    return url;
+}
+
+/**
+ * @brief 读取层级区域
+ * @param startX 起始X坐标（第0层坐标）
+ * @param startY 起始Y坐标（第0层坐标）
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 层级
+ * @param rgb RGB输出缓冲区，可为NULL
+ * @param argb ARGB32输出缓冲区，可为NULL
+ * @return 所需瓦片全部下载、解码且尺寸与DZI几何一致时返回true
+ * @details 输出缓冲区预先填充为白色，区域完全位于图像之外时直接返回true。
+ *          DZI瓦片在不位于图像左边和上边时带有overlap像素的重叠边，复制时跳过。
+ *          任一瓦片请求失败（HTTP错误、超时、内容为空或无法解码）或尺寸不符时返回false，
+ *          调用者不应缓存该区域，避免短暂的网络故障把白色瓦片写入磁盘缓存
+ */
+bool DeepZoomImage::fetchRegion(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level, unsigned char* rgb, unsigned int* argb) const
+{
+    const std::vector<unsigned long long>& dims = _levelDimensions[level];
+    const double downsample = static_cast<double>(_levelDimensions[0][0]) / dims[0];
+    const long long levelX = std::llround(startX / downsample);
+    const long long levelY = std::llround(startY / downsample);
+    const long long x0 = std::max(levelX, 0LL);
+    const long long y0 = std::max(levelY, 0LL);
+    const long long x1 = std::min(levelX + static_cast<long long>(width), static_cast<long long>(dims[0]));
+    const long long y1 = std::min(levelY + static_cast<long long>(height), static_cast<long long>(dims[1]));
+    if (x0 >= x1 || y0 >= y1) {
+        return true;
+    }
+
+    const long long tileSize = _tileSize;
+    std::vector<QUrl> urls;
+    std::vector<std::pair<long long, long long> > tiles;
+    for (long long row = y0 / tileSize; row <= (y1 - 1) / tileSize; ++row) {
+        for (long long column = x0 / tileSize; column <= (x1 - 1) / tileSize; ++column) {
+            urls.push_back(tileUrl(level, column, row));
+            tiles.push_back(std::make_pair(column, row));
+        }
+    }
+    std::vector<QByteArray> bodies;
+    {
+        PipelineTrace::ScopedEvent event("DeepZoomImage::fetchTiles", startX, startY, static_cast<int>(level));
+        bodies = fetchAll(urls, kRequestTimeout, NULL);
+    }
+
+    const long long levelWidth = static_cast<long long>(dims[0]);
+    const long long levelHeight = static_cast<long long>(dims[1]);
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        if (bodies[i].isEmpty()) {
+            return false;
+        }
+        QImage tile = QImage::fromData(bodies[i]);
+        if (tile.isNull()) {
+            return false;
+        }
+        const long long tileX = tiles[i].first * tileSize;
+        const long long tileY = tiles[i].second * tileSize;
+        const long long offsetX = tiles[i].first > 0 ? _overlap : 0;
+        const long long offsetY = tiles[i].second > 0 ? _overlap : 0;
+        // 瓦片尺寸由DZI几何决定：内容部分加上左上和右下（不位于图像边缘时）的重叠边
+        const long long expectedWidth = offsetX + std::min(tileSize, levelWidth - tileX) + (tileX + tileSize < levelWidth ? _overlap : 0);
+        const long long expectedHeight = offsetY + std::min(tileSize, levelHeight - tileY) + (tileY + tileSize < levelHeight ? _overlap : 0);
+        if (tile.width() != expectedWidth || tile.height() != expectedHeight) {
+            return false;
+        }
+        tile = tile.convertToFormat(QImage::Format_RGB32);
+        const long long copyX0 = std::max(x0, tileX);
+        const long long copyX1 = std::min(std::min(x1, tileX + tileSize), tileX + tile.width() - offsetX);
+        const long long copyY0 = std::max(y0, tileY);
+        const long long copyY1 = std::min(std::min(y1, tileY + tileSize), tileY + tile.height() - offsetY);
+        if (copyX0 >= copyX1 || copyY0 >= copyY1) {
+            continue;
+        }
+        for (long long y = copyY0; y < copyY1; ++y) {
+            const QRgb* source = reinterpret_cast<const QRgb*>(tile.constScanLine(static_cast<int>(y - tileY + offsetY))) +
+                (copyX0 - tileX + offsetX);
+            const long long destination = (y - levelY) * static_cast<long long>(width) + (copyX0 - levelX);
+            if (argb) {
+                std::memcpy(argb + destination, source, static_cast<size_t>(copyX1 - copyX0) * sizeof(unsigned int));
+            }
+            else {
+                unsigned char* target = rgb + destination * 3;
+                for (long long x = 0; x < copyX1 - copyX0; ++x) {
+                    target[x * 3] = static_cast<unsigned char>(qRed(source[x]));
+                    target[x * 3 + 1] = static_cast<unsigned char>(qGreen(source[x]));
+                    target[x * 3 + 2] = static_cast<unsigned char>(qBlue(source[x]));
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 读取区域数据
+ * @param startX 起始X坐标（第0层坐标）
+ * @param startY 起始Y坐标（第0层坐标）
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @return RGB数据，图像无效时返回NULL
+ */
+void* DeepZoomImage::readDataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level)
+{
+    unsigned char* rgb = TileBufferPool::allocateArray<unsigned char>(width * height * 3);
+    if (!readDataIntoBuffer(startX, startY, width, height, level, rgb, m_currentZPlaneIndex)) {
+        TileBufferPool::release(rgb);
+        return NULL;
+    }
+    return rgb;
+}
+
+/**
+ * @brief 把区域数据下载到调用者的缓冲区
+ * @param startX 起始X坐标（第0层坐标）
+ * @param startY 起始Y坐标（第0层坐标）
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @param data 输出缓冲区，width*height*3字节
+ * @param zPlane Z平面索引，DZI只有一个平面，忽略
+ * @return 图像有效且所需瓦片全部下载成功时返回true
+ */
+bool DeepZoomImage::readDataIntoBuffer(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level, void* data, const unsigned int& zPlane)
+{
+    if (!_isValid || level >= _numberOfLevels) {
+        return false;
+    }
+
+    PipelineProfiler::ScopedTimer timer(PipelineProfiler::ReadDataFromImage, PipelineProfiler::ReadDeepZoom);
+    std::shared_lock<std::shared_mutex> l(*_openCloseMutex);
+    unsigned char* rgb = static_cast<unsigned char*>(data);
+    std::fill(rgb, rgb + width * height * 3, 255);
+    return fetchRegion(startX, startY, width, height, level, rgb, NULL);
+}
+
+/**
+ * @brief 直接读取ARGB32数据
+ * @param startX 起始X坐标（第0层坐标）
+ * @param startY 起始Y坐标（第0层坐标）
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @param data 输出缓冲区
+ * @param zPlane Z平面索引，DZI只有一个平面，忽略
+ * @return 图像有效且所需瓦片全部下载成功时返回true
+ */
+bool DeepZoomImage::readARGB32DataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level, unsigned int* data, const unsigned int& zPlane)
+{
+    if (!_isValid || level >= _numberOfLevels) {
+        return false;
+    }
+
+    PipelineProfiler::ScopedTimer timer(PipelineProfiler::ReadDataFromImage, PipelineProfiler::ReadDeepZoom);
+    std::shared_lock<std::shared_mutex> l(*_openCloseMutex);
+    std::fill(data, data + width * height, 0xFFFFFFFF);
+    return fetchRegion(startX, startY, width, height, level, NULL, data);
+}
+
+/**
+ * @brief 获取属性
+ * @param propertyName 属性名称
+ * @return 属性值字符串
+ */
+std::string DeepZoomImage::getProperty(const std::string& propertyName)
+{
+    for (const auto& property : _properties) {
+        if (property.name == propertyName) {
+            return property.isNumeric ? std::to_string(property.numericValue) : property.stringValue;
+        }
+    }
+    return std::string();
+}
+
+/**
+ * @brief 获取标签图
+ * @return 空图像
+ */
+const QImage DeepZoomImage::getLabel()
+{
+    return QImage();
+}
+
+/**
+ * @brief 获取图像属性
+ * @return 属性列表
+ */
+const std::vector<SlideColorManagement::PropertyInfo> DeepZoomImage::getProperties()
+{
+    return _properties;
+}
+
+/**
+ * @brief 获取磁盘缓存身份
+ * @return 描述文件URL和校验值
+ */
+std::string DeepZoomImage::cacheIdentity() const
+{
+    return _identity;
+}
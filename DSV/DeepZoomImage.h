@@ -0,0 +1,197 @@
+﻿/**
+ * @file    DeepZoomImage.h
+ * @brief   Deep Zoom远程切片实现类，通过HTTP按瓦片读取DZI金字塔
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了从切片服务器流式读取Deep Zoom（DZI）金字塔，包括：
+ *          - 解析DZI描述文件（TileSize、Overlap、Format和第0层尺寸）
+ *          - 把DZI层级映射为按分辨率从高到低排列的层级
+ *          - 在调用读取的IO工作线程上并发请求与区域相交的全部瓦片（HTTP流水线/HTTP2）
+ *          - 以URL和服务器校验值作为磁盘瓦片缓存的身份，再次打开时直接命中本地缓存
+ *
+ * @note    描述文件可以是http(s) URL，也可以是本地路径，瓦片位于同名的_files目录下
+ * @see     MultiResolutionImage, DeepZoomImageFactory, DiskTileCache
+ */
+
+#pragma once
+#include "MultiResolutionImage.h"
+#include <QByteArray>
+#include <QImage>
+#include <QString>
+#include <QUrl>
+#include <vector>
+
+/**
+ * @class  DeepZoomImage
+ * @brief  Deep Zoom远程切片实现类
+ * @details DZI第maxLevel层（maxLevel = ceil(log2(max(宽, 高)))）为全分辨率，作为第0层；
+ *          DZI第maxLevel - i层作为第i层，直到长边不超过一个瓦片。
+ *
+ *          读取区域时先列出相交的瓦片，再在当前线程的QNetworkAccessManager上一次性发出全部请求，
+ *          用局部事件循环等待全部完成后按去掉重叠边的核心区域复制。请求失败或超时的瓦片为白色。
+ *          每个IO工作线程有自己的连接，多个工作线程的请求同时进行。
+ *
+ *          解码结果经MultiResolutionImage写入解码瓦片缓存和磁盘瓦片缓存，
+ *          同一切片再次浏览时不再访问网络。
+ *
+ * @note   需要Qt Network模块；只提供8位RGB数据，没有标签图
+ * @example
+ *          // 使用示例
+ *          DeepZoomImage* image = new DeepZoomImage();
+ *          if (image->initialize("https://tiles.example.org/slide.dzi")) {
+ *              unsigned char* data = new unsigned char[256 * 256 * 3];
+ *              image->getRawRegion<unsigned char>(0, 0, 256, 256, 0, data);
+ *          }
+ * @see     MultiResolutionImage, DeepZoomImageFactory
+ */
+class DeepZoomImage : public MultiResolutionImage
+{
+public:
+    /**
+     * @brief   默认构造函数
+     * @note    构造函数不会访问网络，需要调用initialize来加载描述文件
+     */
+    DeepZoomImage();
+
+    /**
+     * @brief   析构函数
+     */
+    ~DeepZoomImage();
+
+    /**
+     * @brief   初始化Deep Zoom图像
+     * @details 下载并解析DZI描述文件，建立层级
+     * @param   imagePath 描述文件的URL或本地路径
+     * @return  描述文件有效时返回true
+     */
+    bool initializeType(const std::string& imagePath);
+
+    /**
+     * @brief   获取通道最小值
+     * @return  8位RGB数据，始终为0
+     */
+    double getMinValue(int channel = -1) { return 0.; }
+
+    /**
+     * @brief   获取通道最大值
+     * @return  8位RGB数据，始终为255
+     */
+    double getMaxValue(int channel = -1) { return 255.; }
+
+    /**
+     * @brief   获取属性
+     * @param   propertyName 属性名称，与getProperties返回的名称相同
+     * @return  属性值，不存在时返回空字符串
+     */
+    std::string getProperty(const std::string& propertyName);
+
+    /**
+     * @brief   获取标签图
+     * @return  DZI没有标签图，始终返回空图像
+     */
+    const QImage getLabel();
+
+    /**
+     * @brief   获取图像属性
+     * @details 包括deepzoom.*描述字段，以及按openslide命名的层级数和第0层尺寸
+     * @return  属性列表
+     */
+    const std::vector<SlideColorManagement::PropertyInfo> getProperties();
+
+    /**
+     * @brief   获取磁盘缓存身份
+     * @details 描述文件URL加服务器返回的ETag或Last-Modified，
+     *          服务器不提供校验值时使用描述文件内容，切片在服务器上更新后自动使用新的缓存
+     * @return  缓存身份字符串
+     */
+    std::string cacheIdentity() const;
+
+    /**
+     * @brief   检查名称是否为DZI描述文件
+     * @details 只检查URL路径或文件名的扩展名，不访问网络，用于工厂的格式探测
+     * @param   fileName URL或本地路径
+     * @return  扩展名为.dzi时返回true
+     */
+    static bool isDeepZoomName(const std::string& fileName);
+
+protected:
+    /**
+     * @brief   清理资源
+     * @details 清空描述信息和瓦片地址
+     */
+    void cleanup();
+
+    /**
+     * @brief   读取区域数据
+     * @details 并发下载与区域相交的瓦片并复制重叠部分，区域超出图像或瓦片缺失的部分为白色
+     * @return  从TileBufferPool分配的RGB数据（unsigned char，3通道），调用者负责归还
+     */
+    void* readDataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level);
+
+    /**
+     * @brief   把区域数据下载到调用者的缓冲区
+     * @details 与readDataFromImage相同，但直接写入data，省去返回缓冲区和一次复制
+     * @return  图像有效且所需瓦片全部下载成功时返回true；失败时不缓存，下次重新下载
+     */
+    bool readDataIntoBuffer(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, void* data, const unsigned int& zPlane);
+
+    /**
+     * @brief   直接读取ARGB32数据
+     * @details 瓦片解码为QImage::Format_RGB32后按行复制，不透明像素与预乘格式相同
+     * @return  图像有效且所需瓦片全部下载成功时返回true；失败时不缓存，下次重新下载
+     */
+    bool readARGB32DataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, unsigned int* data, const unsigned int& zPlane);
+
+private:
+    /**
+     * @brief   解析DZI描述文件
+     * @param   descriptor 描述文件内容
+     * @return  缺少Image或Size元素、尺寸为0时返回false
+     */
+    bool parseDescriptor(const QByteArray& descriptor);
+
+    /**
+     * @brief   获取瓦片地址
+     * @param   level 层级
+     * @param   column 瓦片列
+     * @param   row 瓦片行
+     * @return  <名称>_files/<DZI层级>/<列>_<行>.<格式>
+     */
+    QUrl tileUrl(unsigned int level, long long column, long long row) const;
+
+    /**
+     * @brief   读取层级区域
+     * @details 起点为第0层坐标；rgb和argb二者取一作为输出
+     * @return  所需瓦片全部下载、解码且尺寸与DZI几何一致时返回true，否则返回false，调用者不应缓存结果
+     */
+    bool fetchRegion(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, unsigned char* rgb, unsigned int* argb) const;
+
+    /** @brief 描述文件地址 */
+    QUrl _descriptorUrl;
+
+    /** @brief 瓦片目录地址，路径以"_files/"结尾 */
+    QUrl _tilesUrl;
+
+    /** @brief 瓦片图像格式（jpeg、png） */
+    QString _format;
+
+    /** @brief 瓦片大小（不含重叠边） */
+    unsigned int _tileSize;
+
+    /** @brief 瓦片四周的重叠像素 */
+    unsigned int _overlap;
+
+    /** @brief 全分辨率对应的DZI层级 */
+    unsigned int _maxDziLevel;
+
+    /** @brief 磁盘缓存身份 */
+    std::string _identity;
+
+    /** @brief 单个瓦片请求的超时时间（毫秒） */
+    static const int kRequestTimeout = 15000;
+};
@@ -22,6 +22,7 @@ void DetailDialog::initUi()
     // 用于记录是否已经添加了某些信息的标志
     bool addedWidth = false;
     bool addedHeight = false;
+    bool addedMPP = false;
 
     // 遍历属性信息
     for (const auto& prop : m_properties) {
@@ -31,11 +32,12 @@ void DetailDialog::initUi()
             QLabel* appMag = new QLabel(data, this);
             mainLayout->addWidget(appMag);
         }
-        else if (prop.name == "aperio.MPP") {
+        else if ((prop.name == "aperio.MPP" || prop.name == "openslide.mpp-x") && !addedMPP) {
             QString data = QStringLiteral("每像素微米数：") + QString::number(prop.numericValue);
             m_MPP = prop.numericValue;
             QLabel* appMag = new QLabel(data, this);
             mainLayout->addWidget(appMag);
+            addedMPP = true; // 标记已添加MPP信息
         }
         else if ((prop.name == "aperio.OriginalWidth" || prop.name == "openslide.level[0].width") && !addedWidth) {
             QString data = QStringLiteral("图像宽度：") + QString::number(prop.numericValue);
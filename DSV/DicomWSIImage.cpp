@@ -0,0 +1,602 @@
+﻿/**
+ * @file DicomWSIImage.cpp
+ * @brief DICOM全切片图像实现文件
+ * @details 该文件实现了基于libdicom的DICOM WSI读取，包括：
+ *          - 序列层级实例的收集和排序
+ *          - 按帧行列读取和解码瓦片帧
+ *          - 标签图和属性的读取
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "DicomWSIImage.h"
+#include "PipelineProfiler.h"
+#include "TileBufferPool.h"
+#include "dicom/dicom.h"
+#include <QDir>
+#include <QFileInfo>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <shared_mutex>
+
+namespace {
+
+    /**
+     * @brief 查找数据集元素
+     * @param dataset 数据集
+     * @param keyword DICOM关键字
+     * @return 元素，不存在时返回NULL
+     */
+    DcmElement* findElement(const DcmDataSet* dataset, const char* keyword) {
+        uint32_t tag = dcm_dict_tag_from_keyword(keyword);
+        return (dataset && tag) ? dcm_dataset_contains(dataset, tag) : NULL;
+    }
+
+    /**
+     * @brief 读取字符串元素
+     * @return 值，不存在时返回空字符串
+     */
+    std::string getString(const DcmDataSet* dataset, const char* keyword, uint32_t index = 0) {
+        DcmElement* element = findElement(dataset, keyword);
+        const char* value = NULL;
+        if (element && index < dcm_element_get_vm(element) && dcm_element_get_value_string(NULL, element, index, &value) && value) {
+            return value;
+        }
+        return std::string();
+    }
+
+    /**
+     * @brief 读取整数元素
+     * @return 值，不存在时返回0
+     */
+    long long getInteger(const DcmDataSet* dataset, const char* keyword) {
+        DcmElement* element = findElement(dataset, keyword);
+        int64_t value = 0;
+        if (element && dcm_element_get_value_integer(NULL, element, 0, &value)) {
+            return value;
+        }
+        return 0;
+    }
+
+    /**
+     * @brief 读取序列元素的第一项
+     * @return 第一项数据集，不存在时返回NULL
+     */
+    const DcmDataSet* getFirstItem(const DcmDataSet* dataset, const char* keyword) {
+        DcmElement* element = findElement(dataset, keyword);
+        DcmSequence* sequence = NULL;
+        if (element && dcm_element_get_value_sequence(NULL, element, &sequence) && sequence && dcm_sequence_count(sequence) > 0) {
+            return dcm_sequence_get(NULL, sequence, 0);
+        }
+        return NULL;
+    }
+
+    /**
+     * @brief 实例摘要
+     */
+    struct InstanceInfo {
+        std::string path;
+        std::string series;
+        std::string flavour;            ///< ImageType的第三个值：VOLUME、LABEL、OVERVIEW、THUMBNAIL
+        unsigned long long width = 0;   ///< TotalPixelMatrixColumns
+        unsigned long long height = 0;  ///< TotalPixelMatrixRows
+        unsigned int frameWidth = 0;
+        unsigned int frameHeight = 0;
+        unsigned int samplesPerPixel = 0;
+        unsigned int bitsAllocated = 0;
+        double spacingX = 0.;           ///< 列方向像素间距（微米）
+        double spacingY = 0.;           ///< 行方向像素间距（微米）
+    };
+
+    /**
+     * @brief 读取实例摘要
+     * @param path 实例文件路径
+     * @param info 输出的摘要
+     * @return 文件是DICOM且可读取元数据时返回true
+     */
+    bool readInstanceInfo(const std::string& path, InstanceInfo& info) {
+        DcmError* error = NULL;
+        DcmFilehandle* handle = dcm_filehandle_create_from_file(&error, path.c_str());
+        if (!handle) {
+            dcm_error_clear(&error);
+            return false;
+        }
+        const DcmDataSet* metadata = dcm_filehandle_get_metadata_subset(&error, handle);
+        if (!metadata) {
+            dcm_error_clear(&error);
+            dcm_filehandle_destroy(handle);
+            return false;
+        }
+        info.path = path;
+        info.series = getString(metadata, "SeriesInstanceUID");
+        info.flavour = getString(metadata, "ImageType", 2);
+        info.width = getInteger(metadata, "TotalPixelMatrixColumns");
+        info.height = getInteger(metadata, "TotalPixelMatrixRows");
+        info.frameWidth = static_cast<unsigned int>(getInteger(metadata, "Columns"));
+        info.frameHeight = static_cast<unsigned int>(getInteger(metadata, "Rows"));
+        info.samplesPerPixel = static_cast<unsigned int>(getInteger(metadata, "SamplesPerPixel"));
+        info.bitsAllocated = static_cast<unsigned int>(getInteger(metadata, "BitsAllocated"));
+        // PixelSpacing为DS字符串，以毫米为单位，依次为行间距和列间距
+        const DcmDataSet* pixelMeasures = getFirstItem(getFirstItem(metadata, "SharedFunctionalGroupsSequence"), "PixelMeasuresSequence");
+        const std::string rowSpacing = getString(pixelMeasures, "PixelSpacing", 0);
+        const std::string columnSpacing = getString(pixelMeasures, "PixelSpacing", 1);
+        if (!rowSpacing.empty() && !columnSpacing.empty()) {
+            info.spacingX = std::strtod(columnSpacing.c_str(), NULL) * 1000.;
+            info.spacingY = std::strtod(rowSpacing.c_str(), NULL) * 1000.;
+        }
+        dcm_filehandle_destroy(handle);
+        return true;
+    }
+
+    /**
+     * @brief 把数据集元素加入属性列表（dcm_dataset_foreach回调）
+     * @param element 元素
+     * @param client 属性列表
+     * @return 始终返回true以继续遍历
+     * @details 跳过序列和二进制元素；单值数值元素作为数值属性
+     */
+    bool collectProperty(const DcmElement* element, void* client) {
+        std::vector<SlideColorManagement::PropertyInfo>* properties = static_cast<std::vector<SlideColorManagement::PropertyInfo>*>(client);
+        DcmVRClass vrClass = dcm_dict_vr_class(dcm_element_get_vr(element));
+        if (vrClass == DCM_VR_CLASS_SEQUENCE || vrClass == DCM_VR_CLASS_BINARY || vrClass == DCM_VR_CLASS_ERROR) {
+            return true;
+        }
+        const char* keyword = dcm_dict_keyword_from_tag(dcm_element_get_tag(element));
+        if (!keyword) {
+            return true;
+        }
+        const std::string name = std::string("dicom.") + keyword;
+        if (dcm_element_get_vm(element) == 1 && vrClass == DCM_VR_CLASS_NUMERIC_INTEGER) {
+            int64_t value = 0;
+            if (dcm_element_get_value_integer(NULL, element, 0, &value)) {
+                properties->emplace_back(name, true, static_cast<double>(value));
+                return true;
+            }
+        }
+        else if (dcm_element_get_vm(element) == 1 && vrClass == DCM_VR_CLASS_NUMERIC_DECIMAL) {
+            double value = 0.;
+            if (dcm_element_get_value_decimal(NULL, element, 0, &value)) {
+                properties->emplace_back(name, true, value);
+                return true;
+            }
+        }
+        char* text = dcm_element_value_to_string(element);
+        if (text) {
+            properties->emplace_back(name, false, 0.0, text);
+            // 与分配在同一运行库中释放
+            dcm_free(text);
+        }
+        return true;
+    }
+}
+
+/**
+ * @brief 构造函数：初始化DICOM WSI图像对象
+ */
+DicomWSIImage::DicomWSIImage()
+    : MultiResolutionImage()
+{
+}
+
+/**
+ * @brief 析构函数：关闭所有文件句柄
+ */
+DicomWSIImage::~DicomWSIImage()
+{
+    std::unique_lock<std::shared_mutex> l(*_openCloseMutex);
+    cleanup();
+    MultiResolutionImage::cleanup();
+}
+
+/**
+ * @brief 检查DICOM文件标记
+ * @param fileName 文件路径
+ * @return 偏移128处为"DICM"时返回true
+ */
+bool DicomWSIImage::hasDicomSignature(const std::string& fileName)
+{
+    std::ifstream file(fileName.c_str(), std::ios::binary);
+    char header[132];
+    if (!file.read(header, sizeof(header))) {
+        return false;
+    }
+    return std::memcmp(header + 128, "DICM", 4) == 0;
+}
+
+/**
+ * @brief 初始化DICOM WSI图像
+ * @param imagePath 任一层级实例的文件路径
+ * @return 初始化是否成功
+ * @details 读取给定实例的序列号后扫描同一目录的.dcm文件：
+ *          - VOLUME实例按宽度从大到小作为层级，宽度相同的重复实例只保留一个
+ *          - 第一个LABEL实例作为标签图
+ *          只支持8位、1或3通道的实例
+ */
+bool DicomWSIImage::initializeType(const std::string& imagePath)
+{
+    std::unique_lock<std::shared_mutex> l(*_openCloseMutex);
+    cleanup();
+
+    InstanceInfo opened;
+    if (!readInstanceInfo(imagePath, opened) || opened.series.empty()) {
+        _isValid = false;
+        return false;
+    }
+
+    std::vector<InstanceInfo> volumes;
+    if (opened.flavour == "VOLUME") {
+        volumes.push_back(opened);
+    }
+    else if (opened.flavour == "LABEL") {
+        _labelPath = opened.path;
+    }
+    QDir directory = QFileInfo(QString::fromStdString(imagePath)).absoluteDir();
+    const QString openedPath = QFileInfo(QString::fromStdString(imagePath)).absoluteFilePath();
+    QFileInfoList candidates = directory.entryInfoList(QStringList() << "*.dcm", QDir::Files);
+    for (const QFileInfo& candidate : candidates) {
+        if (candidate.absoluteFilePath() == openedPath) {
+            continue;
+        }
+        InstanceInfo info;
+        if (!readInstanceInfo(candidate.absoluteFilePath().toStdString(), info) || info.series != opened.series) {
+            continue;
+        }
+        if (info.flavour == "VOLUME") {
+            volumes.push_back(info);
+        }
+        else if (info.flavour == "LABEL" && _labelPath.empty()) {
+            _labelPath = info.path;
+        }
+    }
+
+    volumes.erase(std::remove_if(volumes.begin(), volumes.end(), [](const InstanceInfo& info) {
+        return info.width == 0 || info.height == 0 || info.frameWidth == 0 || info.frameHeight == 0 ||
+            info.bitsAllocated != 8 || (info.samplesPerPixel != 1 && info.samplesPerPixel != 3);
+    }), volumes.end());
+    std::stable_sort(volumes.begin(), volumes.end(), [](const InstanceInfo& a, const InstanceInfo& b) { return a.width > b.width; });
+    volumes.erase(std::unique(volumes.begin(), volumes.end(), [](const InstanceInfo& a, const InstanceInfo& b) { return a.width == b.width; }), volumes.end());
+    if (volumes.empty()) {
+        _isValid = false;
+        return false;
+    }
+
+    for (const InstanceInfo& info : volumes) {
+        std::unique_ptr<Level> level(new Level());
+        level->path = info.path;
+        level->frameWidth = info.frameWidth;
+        level->frameHeight = info.frameHeight;
+        _levels.push_back(std::move(level));
+        std::vector<unsigned long long> dims;
+        dims.push_back(info.width);
+        dims.push_back(info.height);
+        _levelDimensions.push_back(dims);
+        std::vector<unsigned long long> frameSize;
+        frameSize.push_back(info.frameWidth);
+        frameSize.push_back(info.frameHeight);
+        _levelTileSizes.push_back(frameSize);
+    }
+    _numberOfLevels = static_cast<unsigned int>(_levels.size());
+    _dataType = SlideColorManagement::DataType::UChar;
+    _samplesPerPixel = 3;
+    _colorType = SlideColorManagement::ColorType::RGB;
+    if (volumes[0].spacingX > 0. && volumes[0].spacingY > 0.) {
+        _spacing.push_back(volumes[0].spacingX);
+        _spacing.push_back(volumes[0].spacingY);
+    }
+    _fileType = "DICOM";
+
+    // 属性取自最高分辨率实例，按openslide的命名补充常用的几项
+    InstanceInfo& base = volumes[0];
+    _properties.emplace_back("openslide.level-count", true, static_cast<double>(_numberOfLevels));
+    _properties.emplace_back("openslide.level[0].width", true, static_cast<double>(base.width));
+    _properties.emplace_back("openslide.level[0].height", true, static_cast<double>(base.height));
+    if (!_spacing.empty()) {
+        _properties.emplace_back("openslide.mpp-x", true, _spacing[0]);
+        _properties.emplace_back("openslide.mpp-y", true, _spacing[1]);
+    }
+    DcmError* error = NULL;
+    DcmFilehandle* handle = dcm_filehandle_create_from_file(&error, base.path.c_str());
+    if (handle) {
+        const DcmDataSet* metadata = dcm_filehandle_get_metadata_subset(&error, handle);
+        if (metadata) {
+            dcm_dataset_foreach(metadata, collectProperty, &_properties);
+            DcmElement* icc = findElement(getFirstItem(metadata, "OpticalPathSequence"), "ICCProfile");
+            const void* value = NULL;
+            if (icc && dcm_element_get_value_binary(&error, icc, &value) && value) {
+                const unsigned char* bytes = static_cast<const unsigned char*>(value);
+                _iccProfile.assign(bytes, bytes + dcm_element_get_length(icc));
+            }
+        }
+        dcm_filehandle_destroy(handle);
+    }
+    dcm_error_clear(&error);
+
+    _isValid = true;
+    return _isValid;
+}
+
+/**
+ * @brief 清理资源
+ * @details 关闭所有句柄并清空层级、标签和属性
+ */
+void DicomWSIImage::cleanup()
+{
+    for (auto& level : _levels) {
+        std::lock_guard<std::mutex> l(level->mutex);
+        for (DcmFilehandle* handle : level->idleHandles) {
+            dcm_filehandle_destroy(handle);
+        }
+        level->idleHandles.clear();
+    }
+    _levels.clear();
+    _labelPath.clear();
+    _levelDimensions.clear();
+    _levelTileSizes.clear();
+    _spacing.clear();
+    _properties.clear();
+    _iccProfile.clear();
+}
+
+/**
+ * @brief 取用文件句柄
+ * @param level 层级
+ * @return 文件句柄，打开失败时返回NULL
+ * @details 没有空闲句柄时打开新的句柄，并预先读取帧索引
+ */
+DcmFilehandle* DicomWSIImage::acquireHandle(Level& level)
+{
+    {
+        std::lock_guard<std::mutex> l(level.mutex);
+        if (!level.idleHandles.empty()) {
+            DcmFilehandle* handle = level.idleHandles.back();
+            level.idleHandles.pop_back();
+            return handle;
+        }
+    }
+    DcmError* error = NULL;
+    DcmFilehandle* handle = dcm_filehandle_create_from_file(&error, level.path.c_str());
+    if (handle && (!dcm_filehandle_get_metadata_subset(&error, handle) || !dcm_filehandle_prepare_read_frame(&error, handle))) {
+        dcm_filehandle_destroy(handle);
+        handle = NULL;
+    }
+    dcm_error_clear(&error);
+    return handle;
+}
+
+/**
+ * @brief 归还文件句柄
+ * @param level 层级
+ * @param handle 文件句柄
+ */
+void DicomWSIImage::releaseHandle(Level& level, DcmFilehandle* handle)
+{
+    std::lock_guard<std::mutex> l(level.mutex);
+    level.idleHandles.push_back(handle);
+}
+
+/**
+ * @brief 解码一帧
+ * @param handle 文件句柄
+ * @param level 层级
+ * @param column 帧列号
+ * @param row 帧行号
+ * @param rgb 输出的RGB数据
+ * @return 是否解码成功
+ * @details 封装传输语法（JPEG、JPEG 2000等）交给Qt的图像解码插件，
+ *          JPEG的YBR色彩空间由解码器转换；未压缩帧支持RGB（交错或平面）和MONOCHROME1/2
+ */
+bool DicomWSIImage::readFrame(DcmFilehandle* handle, const Level& level, unsigned int column, unsigned int row, std::vector<unsigned char>& rgb)
+{
+    DcmError* error = NULL;
+    DcmFrame* frame = dcm_filehandle_read_frame_position(&error, handle, column, row);
+    if (!frame) {
+        // 稀疏平铺中缺失的帧同样返回NULL
+        dcm_error_clear(&error);
+        return false;
+    }
+    const unsigned int frameWidth = dcm_frame_get_columns(frame);
+    const unsigned int frameHeight = dcm_frame_get_rows(frame);
+    const unsigned int samplesPerPixel = dcm_frame_get_samples_per_pixel(frame);
+    const unsigned long long nrPixels = static_cast<unsigned long long>(frameWidth) * frameHeight;
+    const unsigned char* value = reinterpret_cast<const unsigned char*>(dcm_frame_get_value(frame));
+    const unsigned int length = dcm_frame_get_length(frame);
+    const char* syntax = dcm_frame_get_transfer_syntax_uid(frame);
+    bool decoded = false;
+    if (frameWidth != level.frameWidth || frameHeight != level.frameHeight || !value) {
+        decoded = false;
+    }
+    else if (syntax && dcm_is_encapsulated_transfer_syntax(syntax)) {
+        QImage image;
+        if (image.loadFromData(value, static_cast<int>(length))) {
+            image = image.convertToFormat(QImage::Format_RGB888);
+            if (static_cast<unsigned int>(image.width()) == frameWidth && static_cast<unsigned int>(image.height()) == frameHeight) {
+                for (unsigned int y = 0; y < frameHeight; ++y) {
+                    std::memcpy(rgb.data() + static_cast<size_t>(y) * frameWidth * 3, image.constScanLine(y), frameWidth * 3);
+                }
+                decoded = true;
+            }
+        }
+    }
+    else if (dcm_frame_get_bits_allocated(frame) == 8) {
+        const std::string photometric = dcm_frame_get_photometric_interpretation(frame) ? dcm_frame_get_photometric_interpretation(frame) : "";
+        if (samplesPerPixel == 3 && photometric == "RGB" && length >= nrPixels * 3) {
+            if (dcm_frame_get_planar_configuration(frame) == 0) {
+                std::memcpy(rgb.data(), value, nrPixels * 3);
+            }
+            else {
+                for (unsigned long long i = 0; i < nrPixels; ++i) {
+                    rgb[i * 3] = value[i];
+                    rgb[i * 3 + 1] = value[nrPixels + i];
+                    rgb[i * 3 + 2] = value[2 * nrPixels + i];
+                }
+            }
+            decoded = true;
+        }
+        else if (samplesPerPixel == 1 && (photometric == "MONOCHROME2" || photometric == "MONOCHROME1") && length >= nrPixels) {
+            const unsigned char invert = photometric == "MONOCHROME1" ? 255 : 0;
+            for (unsigned long long i = 0; i < nrPixels; ++i) {
+                unsigned char gray = value[i] ^ invert;
+                rgb[i * 3] = gray;
+                rgb[i * 3 + 1] = gray;
+                rgb[i * 3 + 2] = gray;
+            }
+            decoded = true;
+        }
+    }
+    dcm_frame_destroy(frame);
+    return decoded;
+}
+
+/**
+ * @brief 读取区域数据
+ * @param startX 起始X坐标（第0层坐标）
+ * @param startY 起始Y坐标（第0层坐标）
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @return RGB数据，图像无效时返回NULL
+ */
+void* DicomWSIImage::readDataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level)
+{
+    unsigned char* rgb = TileBufferPool::allocateArray<unsigned char>(width * height * 3);
+    if (!readDataIntoBuffer(startX, startY, width, height, level, rgb, m_currentZPlaneIndex)) {
+        TileBufferPool::release(rgb);
+        return NULL;
+    }
+    return rgb;
+}
+
+/**
+ * @brief 把区域数据解码到调用者的缓冲区
+ * @param startX 起始X坐标（第0层坐标）
+ * @param startY 起始Y坐标（第0层坐标）
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @param data 输出缓冲区，width*height*3字节
+ * @param zPlane Z平面索引，单平面格式忽略
+ * @return 图像有效且能取得文件句柄时返回true
+ */
+bool DicomWSIImage::readDataIntoBuffer(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level, void* data, const unsigned int& zPlane)
+{
+    if (!_isValid || level >= _levels.size()) {
+        return false;
+    }
+
+    PipelineProfiler::ScopedTimer timer(PipelineProfiler::ReadDataFromImage, PipelineProfiler::ReadDicomWSI);
+    std::shared_lock<std::shared_mutex> l(*_openCloseMutex);
+    unsigned char* rgb = static_cast<unsigned char*>(data);
+    std::fill(rgb, rgb + width * height * 3, 255);
+
+    Level& current = *_levels[level];
+    // 起点与OpenSlide一致使用第0层坐标，换算为该层级的像素坐标
+    const double downsample = static_cast<double>(_levelDimensions[0][0]) / _levelDimensions[level][0];
+    const long long levelX = std::llround(startX / downsample);
+    const long long levelY = std::llround(startY / downsample);
+    const long long levelWidth = static_cast<long long>(_levelDimensions[level][0]);
+    const long long levelHeight = static_cast<long long>(_levelDimensions[level][1]);
+    const long long x0 = std::max(levelX, 0LL);
+    const long long y0 = std::max(levelY, 0LL);
+    const long long x1 = std::min(levelX + static_cast<long long>(width), levelWidth);
+    const long long y1 = std::min(levelY + static_cast<long long>(height), levelHeight);
+    if (x0 >= x1 || y0 >= y1) {
+        return true;
+    }
+    DcmFilehandle* handle = acquireHandle(current);
+    if (!handle) {
+        // 打不开文件时不能把填充的白色当作有效数据缓存
+        return false;
+    }
+
+    const long long frameWidth = current.frameWidth;
+    const long long frameHeight = current.frameHeight;
+    std::vector<unsigned char> frame(static_cast<size_t>(frameWidth * frameHeight * 3));
+    for (long long row = y0 / frameHeight; row <= (y1 - 1) / frameHeight; ++row) {
+        for (long long column = x0 / frameWidth; column <= (x1 - 1) / frameWidth; ++column) {
+            if (!readFrame(handle, current, static_cast<unsigned int>(column), static_cast<unsigned int>(row), frame)) {
+                continue;
+            }
+            const long long frameX = column * frameWidth;
+            const long long frameY = row * frameHeight;
+            const long long copyX0 = std::max(x0, frameX);
+            const long long copyX1 = std::min(x1, frameX + frameWidth);
+            const long long copyY0 = std::max(y0, frameY);
+            const long long copyY1 = std::min(y1, frameY + frameHeight);
+            for (long long y = copyY0; y < copyY1; ++y) {
+                std::memcpy(rgb + ((y - levelY) * static_cast<long long>(width) + (copyX0 - levelX)) * 3,
+                    frame.data() + ((y - frameY) * frameWidth + (copyX0 - frameX)) * 3, static_cast<size_t>(copyX1 - copyX0) * 3);
+            }
+        }
+    }
+    releaseHandle(current, handle);
+    return true;
+}
+
+/**
+ * @brief 获取属性
+ * @param propertyName 属性名称
+ * @return 属性值字符串
+ */
+std::string DicomWSIImage::getProperty(const std::string& propertyName)
+{
+    for (const auto& property : _properties) {
+        if (property.name == propertyName) {
+            return property.isNumeric ? std::to_string(property.numericValue) : property.stringValue;
+        }
+    }
+    return std::string();
+}
+
+/**
+ * @brief 获取标签图
+ * @return LABEL实例的第一帧，不存在或无法解码时返回空图像
+ */
+const QImage DicomWSIImage::getLabel()
+{
+    if (_labelPath.empty()) {
+        return QImage();
+    }
+    InstanceInfo info;
+    if (!readInstanceInfo(_labelPath, info) || info.frameWidth == 0 || info.frameHeight == 0) {
+        return QImage();
+    }
+    Level label;
+    label.path = _labelPath;
+    label.frameWidth = info.frameWidth;
+    label.frameHeight = info.frameHeight;
+    DcmFilehandle* handle = acquireHandle(label);
+    if (!handle) {
+        return QImage();
+    }
+    std::vector<unsigned char> rgb(static_cast<size_t>(info.frameWidth) * info.frameHeight * 3);
+    bool decoded = readFrame(handle, label, 0, 0, rgb);
+    dcm_filehandle_destroy(handle);
+    if (!decoded) {
+        return QImage();
+    }
+    return QImage(rgb.data(), info.frameWidth, info.frameHeight, info.frameWidth * 3, QImage::Format_RGB888).copy();
+}
+
+/**
+ * @brief 获取图像属性
+ * @return 属性列表
+ */
+const std::vector<SlideColorManagement::PropertyInfo> DicomWSIImage::getProperties()
+{
+    return _properties;
+}
+
+/**
+ * @brief 获取切片的ICC颜色配置文件
+ * @return ICC配置文件
+ */
+std::vector<unsigned char> DicomWSIImage::getICCProfile()
+{
+    return _iccProfile;
+}
@@ -0,0 +1,193 @@
+﻿/**
+ * @file    DicomWSIImage.h
+ * @brief   DICOM全切片图像实现类，基于libdicom直接读取瓦片帧
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了DSV项目的DICOM WSI（VL Whole Slide Microscopy Image）支持，包括：
+ *          - 按SeriesInstanceUID收集同一目录下的金字塔层级实例
+ *          - 通过libdicom的帧索引按瓦片行列读取帧，支持稀疏平铺
+ *          - 解码JPEG/JPEG 2000帧和未压缩帧为RGB数据
+ *          - LABEL实例作为标签图，数据集元素作为图像属性
+ *
+ * @note    该类依赖随项目发布的libdicom（Env/include/dicom）
+ * @see     MultiResolutionImage, DicomWSIImageFactory
+ */
+
+#pragma once
+#include "MultiResolutionImage.h"
+#include <QImage>
+#include <mutex>
+#include <vector>
+
+ // libdicom的前向声明
+struct _DcmFilehandle;
+typedef struct _DcmFilehandle DcmFilehandle;
+
+/**
+ * @class  DicomWSIImage
+ * @brief  DICOM全切片图像实现类
+ * @details DICOM WSI的每个金字塔层级是一个实例（一个.dcm文件），帧即为瓦片。
+ *          打开任一实例时，扫描同一目录下SeriesInstanceUID相同、ImageType为VOLUME的实例，
+ *          按TotalPixelMatrixColumns从大到小排列为层级。
+ *
+ *          读取区域时只解码与区域相交的帧：区域与帧网格对齐且大小等于帧时恰好解码一帧，
+ *          不经过OpenSlide的重新分块。缺失的帧（稀疏平铺）以白色填充。
+ *
+ *          每个层级维护一组libdicom文件句柄，读取线程各自取用，互不阻塞。
+ *
+ * @note   该类是线程安全的，支持多线程并发访问
+ * @example
+ *          // 使用示例
+ *          DicomWSIImage* image = new DicomWSIImage();
+ *          if (image->initialize("level-0.dcm")) {
+ *              unsigned char* data = new unsigned char[256 * 256 * 3];
+ *              image->getRawRegion<unsigned char>(0, 0, 256, 256, 0, data);
+ *          }
+ * @see     MultiResolutionImage, DicomWSIImageFactory
+ */
+class DicomWSIImage : public MultiResolutionImage
+{
+public:
+    /**
+     * @brief   默认构造函数
+     * @note    构造函数不会打开文件，需要调用initialize来加载图像
+     */
+    DicomWSIImage();
+
+    /**
+     * @brief   析构函数
+     * @details 关闭所有层级的文件句柄
+     */
+    ~DicomWSIImage();
+
+    /**
+     * @brief   初始化DICOM WSI图像
+     * @details 读取实例的元数据，收集同一序列的所有层级和标签实例
+     * @param   imagePath 任一层级实例的文件路径
+     * @return  找到至少一个可读取的VOLUME层级时返回true
+     */
+    bool initializeType(const std::string& imagePath);
+
+    /**
+     * @brief   获取通道最小值
+     * @return  8位RGB数据，始终为0
+     */
+    double getMinValue(int channel = -1) { return 0.; }
+
+    /**
+     * @brief   获取通道最大值
+     * @return  8位RGB数据，始终为255
+     */
+    double getMaxValue(int channel = -1) { return 255.; }
+
+    /**
+     * @brief   获取属性
+     * @param   propertyName 属性名称，与getProperties返回的名称相同
+     * @return  属性值，不存在时返回空字符串
+     */
+    std::string getProperty(const std::string& propertyName);
+
+    /**
+     * @brief   获取标签图
+     * @return  序列中LABEL实例的第一帧，不存在时返回空图像
+     */
+    const QImage getLabel();
+
+    /**
+     * @brief   获取图像属性
+     * @details 最高分辨率实例的数据集元素以"dicom.关键字"命名，
+     *          另外按openslide的命名给出层级数、第0层尺寸和像素间距
+     * @return  属性列表
+     */
+    const std::vector<SlideColorManagement::PropertyInfo> getProperties();
+
+    /**
+     * @brief   获取切片的ICC颜色配置文件
+     * @return  最高分辨率实例OpticalPathSequence第一项的ICCProfile，不存在时为空
+     */
+    std::vector<unsigned char> getICCProfile() override;
+
+    /**
+     * @brief   检查文件是否为DICOM文件
+     * @details 只检查128字节前导之后的"DICM"标记
+     * @param   fileName 文件路径
+     * @return  带有DICM标记时返回true
+     */
+    static bool hasDicomSignature(const std::string& fileName);
+
+protected:
+    /**
+     * @brief   清理资源
+     * @details 关闭所有层级的文件句柄并清空层级信息
+     */
+    void cleanup();
+
+    /**
+     * @brief   读取区域数据
+     * @details 逐个解码与区域相交的帧并复制重叠部分，区域超出图像或帧缺失的部分为白色
+     * @return  从TileBufferPool分配的RGB数据（unsigned char，3通道），调用者负责归还
+     */
+    void* readDataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level);
+
+    /**
+     * @brief   把区域数据解码到调用者的缓冲区
+     * @details 与readDataFromImage相同，但直接写入data，省去返回缓冲区和一次复制
+     * @return  图像有效且能取得文件句柄时返回true
+     */
+    bool readDataIntoBuffer(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, void* data, const unsigned int& zPlane);
+
+private:
+    /**
+     * @struct  Level
+     * @brief   单个金字塔层级
+     */
+    struct Level {
+        /** @brief 实例文件路径 */
+        std::string path;
+
+        /** @brief 帧宽度（Columns） */
+        unsigned int frameWidth = 0;
+
+        /** @brief 帧高度（Rows） */
+        unsigned int frameHeight = 0;
+
+        /** @brief 保护idleHandles */
+        std::mutex mutex;
+
+        /** @brief 空闲的文件句柄 */
+        std::vector<DcmFilehandle*> idleHandles;
+    };
+
+    /**
+     * @brief   取用层级的文件句柄
+     * @return  文件句柄，打开失败时返回NULL
+     */
+    DcmFilehandle* acquireHandle(Level& level);
+
+    /**
+     * @brief   归还层级的文件句柄
+     */
+    void releaseHandle(Level& level, DcmFilehandle* handle);
+
+    /**
+     * @brief   把一帧解码为RGB数据
+     * @param   handle 层级的文件句柄
+     * @param   column 帧列号，从0开始
+     * @param   row 帧行号，从0开始
+     * @param   rgb 输出的RGB数据，大小为frameWidth * frameHeight * 3
+     * @return  解码成功时返回true，帧缺失或格式不支持时返回false
+     */
+    bool readFrame(DcmFilehandle* handle, const Level& level, unsigned int column, unsigned int row, std::vector<unsigned char>& rgb);
+
+    /** @brief 按分辨率从高到低排列的层级 */
+    std::vector<std::unique_ptr<Level> > _levels;
+
+    /** @brief LABEL实例路径，不存在时为空 */
+    std::string _labelPath;
+
+    /** @brief ICC颜色配置文件 */
+    std::vector<unsigned char> _iccProfile;
+};
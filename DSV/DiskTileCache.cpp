@@ -0,0 +1,395 @@
+﻿/**
+ * @file DiskTileCache.cpp
+ * @brief 磁盘持久化瓦片缓存实现文件
+ * @details 该文件实现了按切片文件身份组织的磁盘瓦片缓存，包括：
+ *          - 包文件的创建、扫描和截断修复
+ *          - zlib压缩的瓦片追加写入
+ *          - 基于内存映射的瓦片读取
+ *          - 包文件的LRU淘汰
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "DiskTileCache.h"
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QDebug>
+#include <atomic>
+#include <cstring>
+#include <map>
+
+namespace {
+
+    /** @brief 包文件魔数和版本，版本2起键中的层级为包含虚拟层级的逻辑层级，版本3起记录头包含瓦片宽高 */
+    const char kPackMagic[16] = { 'D', 'S', 'V', 'T', 'I', 'L', 'E', 'P', 'A', 'C', 'K', 0, 3, 0, 0, 0 };
+
+    /** @brief 记录头字节数：键8字节 + 宽度4字节 + 高度4字节 + 原始字节数4字节 + 压缩字节数4字节 */
+    const qint64 kRecordHeaderSize = 24;
+
+    /** @brief 磁盘缓存的全局设置 */
+    struct DiskCacheSettings {
+        QMutex mutex;
+        bool enabled = true;
+        QString directory;
+        unsigned long long maxSize = 2ULL * 1024 * 1024 * 1024;
+        std::map<QString, std::weak_ptr<DiskTileCache> > openCaches;
+    };
+
+    DiskCacheSettings& settings()
+    {
+        static DiskCacheSettings instance;
+        return instance;
+    }
+}
+
+/**
+ * @brief 打开切片对应的磁盘缓存
+ * @param imagePath 切片文件路径
+ * @return 磁盘缓存对象，失败时返回空指针
+ * @details 包文件名为（绝对路径、大小、修改时间）的SHA1，文件被修改后自动使用新的包文件
+ */
+std::shared_ptr<DiskTileCache> DiskTileCache::open(const std::string& imagePath)
+{
+    QFileInfo info(QString::fromStdString(imagePath));
+    if (!info.exists()) {
+        return std::shared_ptr<DiskTileCache>();
+    }
+    QString identity = info.absoluteFilePath() + "|" + QString::number(info.size()) + "|" + QString::number(info.lastModified().toMSecsSinceEpoch());
+    return openIdentity(identity.toStdString());
+}
+
+/**
+ * @brief 按身份字符串打开磁盘缓存
+ * @param identity 切片身份
+ * @return 磁盘缓存对象，失败时返回空指针
+ * @details 包文件名为身份的SHA-1
+ */
+std::shared_ptr<DiskTileCache> DiskTileCache::openIdentity(const std::string& identity)
+{
+    QString packName = QString::fromLatin1(QCryptographicHash::hash(QString::fromStdString(identity).toUtf8(), QCryptographicHash::Sha1).toHex()) + ".pack";
+
+    DiskCacheSettings& s = settings();
+    QMutexLocker locker(&s.mutex);
+    if (!s.enabled) {
+        return std::shared_ptr<DiskTileCache>();
+    }
+    QString directory = s.directory.isEmpty() ? QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/tiles" : s.directory;
+    if (!QDir().mkpath(directory)) {
+        return std::shared_ptr<DiskTileCache>();
+    }
+    QString packPath = QDir(directory).filePath(packName);
+
+    std::shared_ptr<DiskTileCache> cache = s.openCaches[packPath].lock();
+    if (cache) {
+        return cache;
+    }
+    enforceDiskLimit(directory, packPath);
+    cache.reset(new DiskTileCache(packPath, s.maxSize));
+    if (!cache->load()) {
+        return std::shared_ptr<DiskTileCache>();
+    }
+    s.openCaches[packPath] = cache;
+    return cache;
+}
+
+/**
+ * @brief 构造函数
+ * @param packPath 包文件路径
+ * @param maxPackSize 包文件大小上限
+ */
+DiskTileCache::DiskTileCache(const QString& packPath, unsigned long long maxPackSize) :
+    _pack(packPath),
+    _map(NULL),
+    _mappedSize(0),
+    _packSize(0),
+    _maxPackSize(maxPackSize)
+{
+}
+
+/**
+ * @brief 析构函数
+ * @details 解除映射并关闭包文件
+ */
+DiskTileCache::~DiskTileCache()
+{
+    QMutexLocker locker(&_mutex);
+    if (_map) {
+        _pack.unmap(_map);
+        _map = NULL;
+    }
+    _pack.close();
+}
+
+/**
+ * @brief 打开包文件并重建索引
+ * @return 成功时返回true
+ * @details 文件头不匹配时清空重建；扫描到不完整的记录时截断到最后一条完整记录
+ */
+bool DiskTileCache::load()
+{
+    QMutexLocker locker(&_mutex);
+    if (!_pack.open(QIODevice::ReadWrite)) {
+        qDebug() << "DiskTileCache: cannot open" << _pack.fileName();
+        return false;
+    }
+    char header[sizeof(kPackMagic)];
+    if (_pack.size() < static_cast<qint64>(sizeof(kPackMagic)) || _pack.read(header, sizeof(header)) != sizeof(header) ||
+        std::memcmp(header, kPackMagic, sizeof(kPackMagic)) != 0) {
+        _pack.resize(0);
+        _pack.seek(0);
+        _pack.write(kPackMagic, sizeof(kPackMagic));
+        _pack.flush();
+    }
+    _packSize = _pack.size();
+
+    if (!remap()) {
+        return false;
+    }
+    qint64 offset = sizeof(kPackMagic);
+    while (offset + kRecordHeaderSize <= _packSize) {
+        RecordKey key;
+        quint32 rawSize, storedSize;
+        std::memcpy(&key.key, _map + offset, sizeof(key.key));
+        std::memcpy(&key.width, _map + offset + 8, sizeof(key.width));
+        std::memcpy(&key.height, _map + offset + 12, sizeof(key.height));
+        std::memcpy(&rawSize, _map + offset + 16, sizeof(rawSize));
+        std::memcpy(&storedSize, _map + offset + 20, sizeof(storedSize));
+        if (offset + kRecordHeaderSize + storedSize > _packSize) {
+            break;
+        }
+        IndexEntry entry = { offset + kRecordHeaderSize, rawSize, storedSize };
+        _index[key] = entry;
+        offset += kRecordHeaderSize + storedSize;
+    }
+    if (offset != _packSize) {
+        _pack.unmap(_map);
+        _map = NULL;
+        _mappedSize = 0;
+        _pack.resize(offset);
+        _packSize = offset;
+    }
+    // 更新修改时间，作为LRU淘汰的最近使用时间
+    _pack.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    return true;
+}
+
+/**
+ * @brief 重新映射包文件
+ * @return 成功时返回true
+ */
+bool DiskTileCache::remap()
+{
+    if (_map) {
+        _pack.unmap(_map);
+        _map = NULL;
+        _mappedSize = 0;
+    }
+    if (_packSize == 0) {
+        return true;
+    }
+    _map = _pack.map(0, _packSize);
+    if (!_map) {
+        return false;
+    }
+    _mappedSize = _packSize;
+    return true;
+}
+
+/**
+ * @brief 读取瓦片
+ * @param key 缓存键
+ * @param width 瓦片宽度
+ * @param height 瓦片高度
+ * @param data 输出缓冲区
+ * @param byteSize 期望字节数
+ * @return 命中时返回true
+ */
+bool DiskTileCache::get(unsigned long long key, unsigned int width, unsigned int height, void* data, unsigned long long byteSize)
+{
+    QByteArray stored;
+    {
+        QMutexLocker locker(&_mutex);
+        auto it = _index.find(RecordKey(key, width, height));
+        if (it == _index.end() || it->second.rawSize != byteSize) {
+            return false;
+        }
+        const IndexEntry& entry = it->second;
+        if (entry.offset + entry.storedSize > _mappedSize && !remap()) {
+            return false;
+        }
+        stored = QByteArray(reinterpret_cast<const char*>(_map + entry.offset), entry.storedSize);
+    }
+    QByteArray raw = qUncompress(stored);
+    if (static_cast<unsigned long long>(raw.size()) != byteSize) {
+        return false;
+    }
+    std::memcpy(data, raw.constData(), byteSize);
+    return true;
+}
+
+/**
+ * @brief 写入瓦片
+ * @param key 缓存键
+ * @param width 瓦片宽度
+ * @param height 瓦片高度
+ * @param data 原始数据
+ * @param byteSize 原始字节数
+ * @details 使用快速压缩级别，避免拖慢IO线程
+ */
+void DiskTileCache::put(unsigned long long key, unsigned int width, unsigned int height, const void* data, unsigned long long byteSize)
+{
+    const RecordKey recordKey(key, width, height);
+    {
+        QMutexLocker locker(&_mutex);
+        if (_index.find(recordKey) != _index.end()) {
+            return;
+        }
+    }
+    QByteArray stored = qCompress(reinterpret_cast<const uchar*>(data), static_cast<int>(byteSize), 1);
+
+    QMutexLocker locker(&_mutex);
+    if (_index.find(recordKey) != _index.end() ||
+        static_cast<unsigned long long>(_packSize + kRecordHeaderSize + stored.size()) > _maxPackSize) {
+        return;
+    }
+    quint32 rawSize = static_cast<quint32>(byteSize);
+    quint32 storedSize = static_cast<quint32>(stored.size());
+    char header[kRecordHeaderSize];
+    std::memcpy(header, &recordKey.key, sizeof(recordKey.key));
+    std::memcpy(header + 8, &recordKey.width, sizeof(recordKey.width));
+    std::memcpy(header + 12, &recordKey.height, sizeof(recordKey.height));
+    std::memcpy(header + 16, &rawSize, sizeof(rawSize));
+    std::memcpy(header + 20, &storedSize, sizeof(storedSize));
+    if (!_pack.seek(_packSize) || _pack.write(header, kRecordHeaderSize) != kRecordHeaderSize ||
+        _pack.write(stored) != stored.size() || !_pack.flush()) {
+        // 写入失败时截断半条记录，保持包文件可扫描；Windows上截断前需解除映射
+        if (_map) {
+            _pack.unmap(_map);
+            _map = NULL;
+            _mappedSize = 0;
+        }
+        _pack.resize(_packSize);
+        return;
+    }
+    IndexEntry entry = { _packSize + kRecordHeaderSize, rawSize, storedSize };
+    _index[recordKey] = entry;
+    _packSize += kRecordHeaderSize + storedSize;
+}
+
+/**
+ * @brief 获取包文件当前大小
+ * @return 字节数
+ */
+unsigned long long DiskTileCache::size()
+{
+    QMutexLocker locker(&_mutex);
+    return _packSize;
+}
+
+/**
+ * @brief 获取与包文件配套的附属文件路径
+ * @param suffix 附属文件后缀
+ * @return 附属文件路径
+ */
+QString DiskTileCache::sidecarPath(const QString& suffix) const
+{
+    QFileInfo pack(_pack.fileName());
+    return pack.dir().filePath(pack.completeBaseName() + suffix);
+}
+
+/**
+ * @brief 按最近使用时间淘汰包文件
+ * @param directory 缓存目录
+ * @param keep 不淘汰的包文件
+ * @details 从最久未使用的包文件开始删除，直到总大小不超过上限；正在使用的包文件不删除
+ */
+void DiskTileCache::enforceDiskLimit(const QString& directory, const QString& keep)
+{
+    DiskCacheSettings& s = settings();
+    QFileInfoList packs = QDir(directory).entryInfoList(QStringList() << "*.pack", QDir::Files, QDir::Time);
+    unsigned long long totalSize = 0;
+    for (const QFileInfo& pack : packs) {
+        totalSize += pack.size();
+    }
+    // entryInfoList按修改时间由新到旧排序
+    for (int i = packs.size() - 1; i >= 0 && totalSize > s.maxSize; --i) {
+        QString path = packs[i].absoluteFilePath();
+        if (QDir::cleanPath(path) == QDir::cleanPath(keep) || !s.openCaches[path].expired()) {
+            continue;
+        }
+        if (QFile::remove(path)) {
+            totalSize -= packs[i].size();
+            s.openCaches.erase(path);
+            // 附属文件（如查看器快照）只对该包文件中的瓦片有意义
+            QDir packDirectory = packs[i].dir();
+            for (const QString& sidecar : packDirectory.entryList(QStringList() << packs[i].completeBaseName() + ".*", QDir::Files)) {
+                packDirectory.remove(sidecar);
+            }
+        }
+    }
+}
+
+/**
+ * @brief 启用或禁用磁盘缓存
+ * @param enabled 是否启用
+ */
+void DiskTileCache::setEnabled(bool enabled)
+{
+    QMutexLocker locker(&settings().mutex);
+    settings().enabled = enabled;
+}
+
+/**
+ * @brief 磁盘缓存是否启用
+ * @return 启用时返回true
+ */
+bool DiskTileCache::isEnabled()
+{
+    QMutexLocker locker(&settings().mutex);
+    return settings().enabled;
+}
+
+/**
+ * @brief 设置缓存目录
+ * @param directory 缓存目录
+ */
+void DiskTileCache::setCacheDirectory(const QString& directory)
+{
+    QMutexLocker locker(&settings().mutex);
+    settings().directory = directory;
+}
+
+/**
+ * @brief 获取缓存目录
+ * @return 缓存目录，未设置时为默认目录
+ */
+QString DiskTileCache::cacheDirectory()
+{
+    QMutexLocker locker(&settings().mutex);
+    return settings().directory.isEmpty() ? QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/tiles" : settings().directory;
+}
+
+/**
+ * @brief 设置总大小上限
+ * @param maxSize 字节数
+ */
+void DiskTileCache::setMaxDiskSize(unsigned long long maxSize)
+{
+    QMutexLocker locker(&settings().mutex);
+    settings().maxSize = maxSize;
+}
+
+/**
+ * @brief 获取总大小上限
+ * @return 字节数
+ */
+unsigned long long DiskTileCache::maxDiskSize()
+{
+    QMutexLocker locker(&settings().mutex);
+    return settings().maxSize;
+}
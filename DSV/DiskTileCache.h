@@ -0,0 +1,233 @@
+﻿/**
+ * @file    DiskTileCache.h
+ * @brief   磁盘持久化瓦片缓存类，跨会话保存解码后的瓦片
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了位于内存TileCache之下的磁盘瓦片缓存，包括：
+ *          - 以文件身份（绝对路径、大小、修改时间）区分切片，每个切片一个包文件
+ *          - 以解码瓦片缓存键（层级、X、Y）和瓦片宽高索引包内的瓦片记录
+ *          - 瓦片以zlib压缩后追加写入包文件，读取时通过内存映射访问
+ *          - 按包文件最近使用时间淘汰，总大小不超过上限
+ *          再次打开同一切片时，未命中内存缓存的瓦片直接从磁盘解压，无需重新解码。
+ *
+ * @note    该类是线程安全的，IOWorker和PrefetchThread可以并发读写
+ * @see     TileCache, MultiResolutionImage, MultiResolutionImageFactory
+ */
+
+#pragma once
+
+#include <QString>
+#include <QFile>
+#include <QMutex>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @class  DiskTileCache
+ * @brief  磁盘持久化瓦片缓存
+ * @details 包文件格式：16字节文件头（魔数+版本），之后为连续的瓦片记录，
+ *          每条记录为 [键 8字节][宽度 4字节][高度 4字节][原始字节数 4字节][压缩字节数 4字节][压缩数据]。
+ *          缓存键只包含起点，宽高一起参与索引，不同瓦片尺寸设置下的瓦片互不冲突。
+ *          包文件自描述，打开时扫描记录头重建索引；末尾不完整的记录（异常退出）会被截断。
+ *
+ *          同一切片在进程内只对应一个DiskTileCache对象，多个查看器共享。
+ *
+ * @example
+ *          // 使用示例
+ *          std::shared_ptr<DiskTileCache> diskCache = DiskTileCache::open("slide.svs");
+ *          if (diskCache) {
+ *              img->setDiskCache(diskCache);
+ *          }
+ * @see     MultiResolutionImage::setDiskCache
+ */
+class DiskTileCache
+{
+public:
+    /**
+     * @brief   打开切片对应的磁盘缓存
+     * @details 根据文件身份定位包文件，不存在时创建，并按总大小上限淘汰最久未使用的其他包文件
+     *
+     * @param   imagePath 切片文件路径
+     * @return  磁盘缓存对象，缓存被禁用或无法创建时返回空指针
+     * @note    同一切片重复打开时返回同一对象
+     */
+    static std::shared_ptr<DiskTileCache> open(const std::string& imagePath);
+
+    /**
+     * @brief   按身份字符串打开磁盘缓存
+     * @details 供没有本地文件的切片（如远程DZI）使用，身份相同时使用同一包文件
+     *
+     * @param   identity 切片身份，内容变化时应随之变化
+     * @return  磁盘缓存对象，缓存被禁用或无法创建时返回空指针
+     * @see     MultiResolutionImage::cacheIdentity
+     */
+    static std::shared_ptr<DiskTileCache> openIdentity(const std::string& identity);
+
+    /**
+     * @brief   析构函数
+     * @details 解除内存映射并关闭包文件
+     */
+    ~DiskTileCache();
+
+    /**
+     * @brief   读取瓦片
+     * @param   key 解码瓦片缓存键
+     * @param   width 瓦片宽度
+     * @param   height 瓦片高度
+     * @param   data 输出缓冲区
+     * @param   byteSize 期望的原始字节数
+     * @return  命中且大小一致时返回true
+     * @note    解压在锁外进行
+     */
+    bool get(unsigned long long key, unsigned int width, unsigned int height, void* data, unsigned long long byteSize);
+
+    /**
+     * @brief   写入瓦片
+     * @param   key 解码瓦片缓存键
+     * @param   width 瓦片宽度
+     * @param   height 瓦片高度
+     * @param   data 原始数据
+     * @param   byteSize 原始字节数
+     * @note    键已存在或包文件达到上限时忽略；压缩在锁外进行
+     */
+    void put(unsigned long long key, unsigned int width, unsigned int height, const void* data, unsigned long long byteSize);
+
+    /**
+     * @brief   获取包文件当前大小
+     * @return  字节数
+     */
+    unsigned long long size();
+
+    /**
+     * @brief   获取与包文件配套的附属文件路径
+     * @param   suffix 附属文件后缀（含点），如ViewerSnapshot::kFileSuffix
+     * @return  与包文件同名、后缀不同的路径；包文件被淘汰时附属文件一起删除
+     */
+    QString sidecarPath(const QString& suffix) const;
+
+    /**
+     * @brief   启用或禁用磁盘缓存
+     * @param   enabled 是否启用，默认启用
+     * @note    只影响之后打开的切片
+     */
+    static void setEnabled(bool enabled);
+
+    /**
+     * @brief   磁盘缓存是否启用
+     * @return  启用时返回true
+     */
+    static bool isEnabled();
+
+    /**
+     * @brief   设置缓存目录
+     * @param   directory 缓存目录，默认为QStandardPaths::CacheLocation下的tiles目录
+     */
+    static void setCacheDirectory(const QString& directory);
+
+    /**
+     * @brief   获取缓存目录
+     * @return  缓存目录
+     */
+    static QString cacheDirectory();
+
+    /**
+     * @brief   设置所有包文件的总大小上限
+     * @param   maxSize 字节数，默认2GB
+     */
+    static void setMaxDiskSize(unsigned long long maxSize);
+
+    /**
+     * @brief   获取所有包文件的总大小上限
+     * @return  字节数
+     */
+    static unsigned long long maxDiskSize();
+
+private:
+    /**
+     * @brief   构造函数
+     * @param   packPath 包文件路径
+     * @param   maxPackSize 包文件大小上限
+     */
+    DiskTileCache(const QString& packPath, unsigned long long maxPackSize);
+
+    /**
+     * @brief   打开包文件并重建索引
+     * @return  成功时返回true
+     */
+    bool load();
+
+    /**
+     * @brief   重新映射包文件
+     * @details 追加写入后映射范围不再覆盖新记录，读取新记录前调用
+     * @return  成功时返回true
+     * @note    调用者需持有_mutex
+     */
+    bool remap();
+
+    /**
+     * @brief   按最近使用时间淘汰包文件
+     * @param   directory 缓存目录
+     * @param   keep 不淘汰的包文件
+     */
+    static void enforceDiskLimit(const QString& directory, const QString& keep);
+
+    /**
+     * @brief 记录键，解码瓦片缓存键加瓦片宽高
+     */
+    struct RecordKey {
+        unsigned long long key;   ///< 解码瓦片缓存键
+        quint32 width;            ///< 瓦片宽度
+        quint32 height;           ///< 瓦片高度
+
+        RecordKey() : key(0), width(0), height(0) {}
+        RecordKey(unsigned long long k, quint32 w, quint32 h) : key(k), width(w), height(h) {}
+
+        bool operator==(const RecordKey& other) const
+        {
+            return key == other.key && width == other.width && height == other.height;
+        }
+    };
+
+    /**
+     * @brief 记录键的哈希函数
+     */
+    struct RecordKeyHash {
+        size_t operator()(const RecordKey& k) const
+        {
+            unsigned long long h = k.key ^ ((static_cast<unsigned long long>(k.width) << 32 | k.height) * 0x9E3779B97F4A7C15ULL);
+            return std::hash<unsigned long long>()(h);
+        }
+    };
+
+    /**
+     * @brief 索引项
+     */
+    struct IndexEntry {
+        qint64 offset;        ///< 压缩数据在包文件中的偏移
+        quint32 rawSize;      ///< 原始字节数
+        quint32 storedSize;   ///< 压缩字节数
+    };
+
+    /** @brief 保护包文件、映射和索引的互斥锁 */
+    QMutex _mutex;
+
+    /** @brief 包文件 */
+    QFile _pack;
+
+    /** @brief 包文件的内存映射，NULL表示未映射 */
+    uchar* _map;
+
+    /** @brief 映射的字节数 */
+    qint64 _mappedSize;
+
+    /** @brief 包文件当前大小 */
+    qint64 _packSize;
+
+    /** @brief 包文件大小上限 */
+    unsigned long long _maxPackSize;
+
+    /** @brief 键到记录的索引 */
+    std::unordered_map<RecordKey, IndexEntry, RecordKeyHash> _index;
+};
@@ -8,7 +8,90 @@
  */
 
 #include "FileWidget.h"
+#include "MultiResolutionImageFactory.h"
+#include "ThumbnailService.h"
+#include "SlideIndex.h"
 #include <QDebug>
+#include <QStyledItemDelegate>
+#include <QDir>
+#include <QHelpEvent>
+#include <QLineEdit>
+#include <QToolTip>
+
+namespace {
+    /**
+     * @brief 缩略图项代理
+     * @details 支持格式的切片文件以缩略图作为图标，缩略图只在行被绘制时请求，
+     *          因此只为滚动到视野中的行生成。文件系统模型、最近文件模型和搜索结果模型
+     *          都在Qt::UserRole + 1中保存文件路径。工具提示显示切片索引中的元数据
+     */
+    class ThumbnailDelegate : public QStyledItemDelegate
+    {
+    public:
+        ThumbnailDelegate(ThumbnailService* service, SlideIndex* index, QObject* parent) :
+            QStyledItemDelegate(parent),
+            _service(service),
+            _index(index)
+        {
+            for (const std::string& extension : MultiResolutionImageFactory::getAllSupportedExtensions()) {
+                _extensions.insert(QString::fromStdString(extension).toLower());
+            }
+        }
+
+        void paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const override
+        {
+            const QString filePath = slidePath(index);
+            if (!filePath.isEmpty()) {
+                QPixmap pixmap;
+                _service->thumbnail(filePath, pixmap);
+            }
+            QStyledItemDelegate::paint(painter, option, index);
+        }
+
+        bool helpEvent(QHelpEvent* event, QAbstractItemView* view, const QStyleOptionViewItem& option, const QModelIndex& index) override
+        {
+            const QString filePath = slidePath(index);
+            SlideIndex::Entry entry;
+            if (event && event->type() == QEvent::ToolTip && !filePath.isEmpty() && _index->lookup(filePath, entry) && entry.slide) {
+                QToolTip::showText(event->globalPos(), entry.description(), view);
+                return true;
+            }
+            return QStyledItemDelegate::helpEvent(event, view, option, index);
+        }
+
+    protected:
+        void initStyleOption(QStyleOptionViewItem* option, const QModelIndex& index) const override
+        {
+            QStyledItemDelegate::initStyleOption(option, index);
+            const QString filePath = slidePath(index);
+            if (filePath.isEmpty()) {
+                return;
+            }
+            // 缩略图未就绪时也保留图标尺寸，缩略图到达后行高不变
+            const int size = _service->getThumbnailSize();
+            option->decorationSize = QSize(size, size);
+            QPixmap pixmap;
+            if (_service->thumbnail(filePath, pixmap, false) && !pixmap.isNull()) {
+                option->features |= QStyleOptionViewItem::HasDecoration;
+                option->icon = QIcon(pixmap);
+            }
+        }
+
+    private:
+        QString slidePath(const QModelIndex& index) const
+        {
+            if (index.column() != 0) {
+                return QString();
+            }
+            const QString filePath = index.data(Qt::UserRole + 1).toString();
+            return _extensions.contains(QFileInfo(filePath).suffix().toLower()) ? filePath : QString();
+        }
+
+        ThumbnailService* _service;
+        SlideIndex* _index;
+        QSet<QString> _extensions;
+    };
+}
 //#pragma execution_character_set("utf-8")
 /**
  * @brief 文件窗口部件构造函数
@@ -16,7 +99,9 @@
  * @details 初始化文件窗口部件，设置基本属性、界面布局和样式
  */
 FileWidget::FileWidget(QWidget *parent = nullptr)
-	: QWidget(parent)
+	: QWidget(parent),
+    _thumbnails(new ThumbnailService(this)),
+    _index(new SlideIndex(this))
 {
     setFixedWidth(500);     // 设置固定宽度
     setMinimumSize(500, 786);  // 设置最小尺寸
@@ -76,11 +161,19 @@ void FileWidget::initUI()
     FileTreeLabel->setObjectName("FileTreeLabel");
     FileTreeVerticalLayout->addWidget(FileTreeLabel, 0);
 
+    // 创建搜索框，在切片索引中按文件名或厂商搜索
+    QLineEdit* searchEdit = new QLineEdit(this);
+    searchEdit->setObjectName(QStringLiteral("searchEdit"));
+    searchEdit->setPlaceholderText(QStringLiteral("搜索已索引的切片"));
+    searchEdit->setClearButtonEnabled(true);
+    FileTreeVerticalLayout->addWidget(searchEdit, 0);
+
     // 创建水平布局
     QHBoxLayout* FileTreeHorizontalLayout = new QHBoxLayout();
     
     // 创建标签页控件
     QTabWidget* tabWidget = new QTabWidget(this);
+    tabWidget->setObjectName(QStringLiteral("tabWidget"));
     tabWidget->setTabPosition(QTabWidget::West);  // 标签页位置在左侧
     tabWidget->setStyle(/*new TabStyle(style())*/style());
 
@@ -94,9 +187,11 @@ void FileWidget::initUI()
     treeModel->setObjectName(QStringLiteral("treeModel"));
     treeModel->setRootPath(QDir::currentPath());  // 设置根路径为当前目录
     
-    // 设置文件过滤器，只显示支持的图像格式
+    // 设置文件过滤器，只显示已注册工厂支持的图像格式
     QStringList sNameFilter;
-    sNameFilter << "*.tif"<<"*.svs"<<"*.czi"<<"*.ndpi"<<"*.dcm"<<"*.tiff"<<"*.scn"<<"*.zvi"<<"*.bif";
+    for (const std::string& extension : MultiResolutionImageFactory::getAllSupportedExtensions()) {
+        sNameFilter << QStringLiteral("*.") + QString::fromStdString(extension);
+    }
     treeModel->setNameFilterDisables(false);
     treeModel->setNameFilters(sNameFilter);
     
@@ -109,8 +204,12 @@ void FileWidget::initUI()
     treeView->setColumnHidden(2, true);  // 隐藏类型列
     treeView->setColumnHidden(3, true);  // 隐藏修改日期列
     
+    treeView->setItemDelegate(new ThumbnailDelegate(_thumbnails, _index, treeView));
+
     // 连接树形视图点击信号
     connect(treeView, &QTreeView::clicked, this, &FileWidget::onTreeViewItemClicked);
+    // 文件系统模型加载完一个文件夹后在后台为其中的切片建立索引
+    connect(treeModel, &QFileSystemModel::directoryLoaded, _index, &SlideIndex::scanDirectory);
 
     // 创建列表视图（最近文件）
     QListView* listView = new QListView(this);
@@ -123,18 +222,75 @@ void FileWidget::initUI()
     QStandardItemModel* listmodel = new QStandardItemModel(this);
     listmodel->setObjectName(QStringLiteral("listmodel"));
     listView->setModel(listmodel);
+    listView->setItemDelegate(new ThumbnailDelegate(_thumbnails, _index, listView));
+
+    // 创建列表视图（搜索结果）
+    QListView* searchView = new QListView(this);
+    searchView->setObjectName(QStringLiteral("searchView"));
+    searchView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    QStandardItemModel* searchModel = new QStandardItemModel(this);
+    searchModel->setObjectName(QStringLiteral("searchModel"));
+    searchView->setModel(searchModel);
+    searchView->setItemDelegate(new ThumbnailDelegate(_thumbnails, _index, searchView));
     
     // 连接信号槽
     connect(this, &FileWidget::fileSelected, this, &FileWidget::onFileSelected);
     connect(listView, &QListView::clicked, this, &FileWidget::onListViewItemClicked); // 连接 QListView 点击信号
+    connect(_thumbnails, &ThumbnailService::thumbnailReady, this, &FileWidget::onThumbnailReady);
+    connect(searchEdit, &QLineEdit::textChanged, this, &FileWidget::onSearchTextChanged);
+    connect(searchView, &QListView::clicked, this, &FileWidget::onSearchViewItemClicked);
 
     // 添加标签页
     tabWidget->addTab(treeView, QStringLiteral("文件"));
     tabWidget->addTab(listView, QStringLiteral("最近"));
+    tabWidget->addTab(searchView, QStringLiteral("搜索"));
     FileTreeHorizontalLayout->addWidget(tabWidget);
     FileTreeVerticalLayout->addLayout(FileTreeHorizontalLayout, 9);
 }
 
+/**
+ * @brief 获取阅片顺序中位于指定切片之后的切片
+ * @param filePath 当前切片路径
+ * @param count 最多返回的切片数
+ * @return 切片路径列表
+ */
+QStringList FileWidget::nextSlides(const QString& filePath, int count) const
+{
+    QStringList slides;
+    if (count <= 0) {
+        return slides;
+    }
+    QListView* listView = this->findChild<QListView*>("listView");
+    QStandardItemModel* listmodel = listView ? qobject_cast<QStandardItemModel*>(listView->model()) : NULL;
+    if (listmodel) {
+        for (int i = 0; i < listmodel->rowCount(); ++i) {
+            QStandardItem* item = listmodel->item(i);
+            if (item && item->data().toString() == filePath) {
+                for (int j = i + 1; j < listmodel->rowCount() && slides.size() < count; ++j) {
+                    slides << listmodel->item(j)->data().toString();
+                }
+                break;
+            }
+        }
+    }
+    if (!slides.isEmpty()) {
+        return slides;
+    }
+    // 工作列表通常是同一目录中按名称排列的一组切片
+    QFileInfo fileInfo(filePath);
+    QStringList nameFilters;
+    for (const std::string& extension : MultiResolutionImageFactory::getAllSupportedExtensions()) {
+        nameFilters << QStringLiteral("*.") + QString::fromStdString(extension);
+    }
+    QDir directory = fileInfo.absoluteDir();
+    const QStringList siblings = directory.entryList(nameFilters, QDir::Files, QDir::Name | QDir::IgnoreCase);
+    const int index = siblings.indexOf(fileInfo.fileName());
+    for (int i = index + 1; index >= 0 && i < siblings.size() && slides.size() < count; ++i) {
+        slides << directory.filePath(siblings[i]);
+    }
+    return slides;
+}
+
 /**
  * @brief 树形视图项目点击事件处理
  * @param index 被点击的项目索引
@@ -151,18 +307,13 @@ void FileWidget::onTreeViewItemClicked(const QModelIndex& index)
         return;
 
     QString filePath = model->filePath(index); // 获取文件路径
-    QFileInfo fileInfo(filePath);
+    if (model->isDir(index))
+        return;
 
-    // 检查是否为支持的文件格式
-    if (fileInfo.isFile() && fileInfo.suffix().toLower() == "tif"   || 
-        fileInfo.isFile() && fileInfo.suffix().toLower() == "tiff"  ||
-        fileInfo.isFile() && fileInfo.suffix().toLower()=="svs"     || 
-        fileInfo.isFile() && fileInfo.suffix().toLower() == "ndpi"  || 
-        fileInfo.isFile() && fileInfo.suffix().toLower() == "czi"   ||
-        fileInfo.isFile() && fileInfo.suffix().toLower() == "bif"   ||
-        fileInfo.isFile() && fileInfo.suffix().toLower() == "zvi"   ||
-        fileInfo.isFile() && fileInfo.suffix().toLower() == "scn"   ||
-        fileInfo.isFile() && fileInfo.suffix().toLower() == "dcm") // 检查是否为支持的图像文件
+    // 已索引的文件直接使用索引结果；尚未索引时探测文件格式，探测结果按文件缓存，不会完整打开切片
+    SlideIndex::Entry entry;
+    const bool slide = _index->lookup(filePath, entry) ? entry.slide : MultiResolutionImageFactory::canOpenImage(filePath.toStdString());
+    if (slide)
     {
         emit fileSelected(filePath); // 发出自定义信号
     }
@@ -226,4 +377,65 @@ void FileWidget::onListViewItemClicked(const QModelIndex& index)
         QString filePath = item->data().toString(); // 获取用户数据（文件路径）
         emit filePathTrans(filePath);
     }
+}
+
+/**
+ * @brief 缩略图就绪事件处理
+ * @param filePath 切片文件路径
+ * @details 只重绘可见区域，未显示的行不受影响
+ */
+void FileWidget::onThumbnailReady(const QString& filePath)
+{
+    Q_UNUSED(filePath);
+    QTreeView* treeView = this->findChild<QTreeView*>("treeView");
+    if (treeView)
+        treeView->viewport()->update();
+    QListView* listView = this->findChild<QListView*>("listView");
+    if (listView)
+        listView->viewport()->update();
+    QListView* searchView = this->findChild<QListView*>("searchView");
+    if (searchView)
+        searchView->viewport()->update();
+}
+
+/**
+ * @brief 搜索文本变化事件处理
+ * @param text 搜索文本
+ * @details 搜索结果最多显示kMaxSearchResults项，有结果时切换到搜索标签页
+ */
+void FileWidget::onSearchTextChanged(const QString& text)
+{
+    static const int kMaxSearchResults = 200;
+    QListView* searchView = this->findChild<QListView*>("searchView");
+    QStandardItemModel* model = searchView ? qobject_cast<QStandardItemModel*>(searchView->model()) : NULL;
+    if (!model)
+        return;
+
+    model->clear();
+    const QStringList results = _index->search(text, kMaxSearchResults);
+    for (const QString& filePath : results)
+    {
+        QStandardItem* item = new QStandardItem(QFileInfo(filePath).fileName());
+        item->setData(filePath); // 将文件路径作为用户数据
+        item->setToolTip(filePath);
+        item->setEditable(false);
+        model->appendRow(item);
+    }
+    QTabWidget* tabWidget = this->findChild<QTabWidget*>("tabWidget");
+    if (tabWidget && !results.isEmpty())
+        tabWidget->setCurrentWidget(searchView);
+}
+
+/**
+ * @brief 搜索结果点击事件处理
+ * @param index 被点击的项目索引
+ */
+void FileWidget::onSearchViewItemClicked(const QModelIndex& index)
+{
+    if (!index.isValid())
+        return;
+
+    const QString filePath = index.data(Qt::UserRole + 1).toString();
+    if (!filePath.isEmpty())
+        emit fileSelected(filePath);
 }
\ No newline at end of file
@@ -31,6 +31,9 @@
 #include <QListView>
 #include <QStandardItemModel>
 
+class ThumbnailService;
+class SlideIndex;
+
  /**
   * @class  FileWidget
   * @brief  文件窗口类，提供文件浏览和管理功能
@@ -86,6 +89,18 @@ public:
      */
     ~FileWidget();
 
+    /**
+     * @brief   获取阅片顺序中位于指定切片之后的切片
+     * @details 切片在最近列表中且不是最后一项时按最近列表的顺序返回；
+     *          否则按文件树的排序（文件名）返回同一目录中其后的支持格式的切片
+     *
+     * @param   filePath 当前切片路径
+     * @param   count 最多返回的切片数
+     * @return  切片路径列表
+     * @see     SlidePreloader::setWorklist
+     */
+    QStringList nextSlides(const QString& filePath, int count) const;
+
 private:
     /**
      * @brief   初始化用户界面
@@ -154,4 +169,37 @@ private slots:
      * @see     onTreeViewItemClicked, onFileSelected
      */
     void onListViewItemClicked(const QModelIndex& index);
+
+    /**
+     * @brief   缩略图就绪槽函数
+     * @details 重绘文件树和最近文件列表的可见区域
+     *
+     * @param   filePath 切片文件路径
+     * @see     ThumbnailService::thumbnailReady
+     */
+    void onThumbnailReady(const QString& filePath);
+
+    /**
+     * @brief   搜索文本变化槽函数
+     * @details 在切片索引中搜索，结果显示在搜索标签页中，不访问文件系统
+     *
+     * @param   text 搜索文本
+     * @see     SlideIndex::search
+     */
+    void onSearchTextChanged(const QString& text);
+
+    /**
+     * @brief   搜索结果点击槽函数
+     * @details 发出文件选择信号，切片同时加入最近文件列表
+     *
+     * @param   index 被点击项目的模型索引
+     */
+    void onSearchViewItemClicked(const QModelIndex& index);
+
+private:
+    /** @brief 缩略图服务，为文件树和最近文件列表的可见行生成缩略图 */
+    ThumbnailService* _thumbnails;
+
+    /** @brief 切片索引，在后台扫描文件树加载的文件夹 */
+    SlideIndex* _index;
 };
\ No newline at end of file
@@ -2,7 +2,7 @@
  * @file IOThread.cpp
  * @brief IO线程管理器实现文件
  * @details 该文件实现了多线程IO任务管理功能，包括：
- *          - 多线程工作池管理
+ *          - 多线程工作池管理（每线程独立队列，工作窃取）
  *          - 任务队列管理
  *          - 背景和前景图像设置
  *          - 颜色查找表管理
@@ -14,71 +14,454 @@
 #include "IOThread.h"
 #include "MultiResolutionImage.h"
 #include "IOWorker.h"
+#include "IOWorkerPool.h"
+#include "TileTask.h"
+#include "OverlayTileCache.h"
+#include "PipelineProfiler.h"
+#include "PipelineTrace.h"
+#include "IccProfile.h"
+#include <QPixmap>
+#include <QTimer>
+#include <cmath>
+#include <iterator>
+#include <algorithm>
+
+/**
+ * @brief 任务调度顺序比较
+ * @param a 任务a
+ * @param b 任务b
+ * @return a是否应排在b之前
+ * @details 后台任务排在所有显示任务之后；粗层级优先，保证视野内尽快出现低分辨率内容；
+ *          同层级按到视野中心的距离排序
+ */
+static bool jobPrecedes(const ThreadJob* a, const ThreadJob* b)
+{
+	if (a->_deferred != b->_deferred) {
+		return b->_deferred;
+	}
+	if (a->_level != b->_level) {
+		return a->_level > b->_level;
+	}
+	return a->_priority < b->_priority;
+}
+
+/**
+ * @brief 任务覆盖的瓦片列数和行数
+ * @param job 任务
+ * @param columns 输出列数
+ * @param rows 输出行数
+ * @details 合并IO任务覆盖多个瓦片，其余任务只覆盖一个瓦片
+ */
+static void jobTiles(const ThreadJob* job, unsigned int& columns, unsigned int& rows)
+{
+	if (const BatchIOJob* batch = dynamic_cast<const BatchIOJob*>(job)) {
+		columns = batch->_columns;
+		rows = batch->_rows;
+	}
+	else {
+		columns = 1;
+		rows = 1;
+	}
+}
 
 /**
  * @brief 构造函数：初始化IO线程管理器
  * @param parent 父对象
- * @param nrThreads 工作线程数量
- * @details 创建指定数量的IOWorker线程，并设置为高优先级
+ * @param nrThreads 工作线程数量，0表示沿用全局线程池当前的线程数
+ * @details 向全局线程池注册，队列数与线程池的工作线程数一致
  */
 IOThread::IOThread(QObject *parent, unsigned int nrThreads)
 	: QObject(parent),
 	_abort(false),
-	_threadsWaiting(0)
+	_nrJobs(0),
+	_nextQueue(0),
+	_backgroundChannel(0),
+	_foregroundChannel(0),
+	_foregroundImageScale(1.),
+	_LUT(),
+	_activeJobs(0),
+	_persistentLevel(0),
+	_settings(std::make_shared<const IOWorkerSettings>()),
+	_renderGeneration(0),
+	_backgroundGeneration(0),
+	_overlayCache(std::make_shared<OverlayTileCache>()),
+	_overlayGeneration(0),
+	_zPlane(0),
+	_deliveries(kDeliveryCapacity),
+	_deliveryScheduled(false)
 {
-	for (int i = 0; i < nrThreads; ++i) {
-		IOWorker* worker = new IOWorker(this);
-		worker->start(QThread::HighPriority);
-		_workers.push_back(worker);
+	IOWorkerPool* pool = IOWorkerPool::instance();
+	if (nrThreads != 0) {
+		pool->setNumberOfThreads(nrThreads);
+	}
+	updateSettings([this](IOWorkerSettings& settings) { settings._overlayCache = _overlayCache; });
+	pool->registerClient(this);
+}
+
+/**
+ * @brief 获取默认工作线程数量
+ * @return 工作线程数量
+ */
+unsigned int IOThread::defaultNumberOfThreads()
+{
+	return IOWorkerPool::defaultNumberOfThreads();
+}
+
+/**
+ * @brief 发布新的设置快照
+ * @param modifier 修改快照副本的函数
+ * @details 正在执行的任务继续使用旧快照，下一个任务开始使用新快照
+ */
+template<typename Modifier>
+void IOThread::updateSettings(Modifier modifier)
+{
+	std::shared_ptr<IOWorkerSettings> settings = std::make_shared<IOWorkerSettings>(*std::atomic_load(&_settings));
+	modifier(*settings);
+	std::atomic_store(&_settings, std::shared_ptr<const IOWorkerSettings>(settings));
+}
+
+/**
+ * @brief 获取当前设置快照
+ * @return 设置快照
+ */
+std::shared_ptr<const IOWorkerSettings> IOThread::getSettings() const
+{
+	return std::atomic_load(&_settings);
+}
+
+/**
+ * @brief 渲染任务析构函数
+ * @details 释放任务持有的前景瓦片
+ */
+RenderJob::~RenderJob()
+{
+	delete _foregroundTile;
+}
+
+/**
+ * @brief 获取当前前景渲染代
+ * @return 当前代
+ */
+unsigned int IOThread::getRenderGeneration() const
+{
+	return _renderGeneration;
+}
+
+/**
+ * @brief 进入新的前景渲染代
+ * @details 先递增代号再通知工作线程，之后入队的渲染任务都带有新代号
+ */
+void IOThread::advanceRenderGeneration()
+{
+	unsigned int generation = ++_renderGeneration;
+	updateSettings([generation](IOWorkerSettings& settings) { settings._renderGeneration = generation; });
+}
+
+/**
+ * @brief 获取当前背景渲染代
+ * @return 当前代
+ */
+unsigned int IOThread::getBackgroundGeneration() const
+{
+	return _backgroundGeneration;
+}
+
+/**
+ * @brief 进入新的背景渲染代
+ * @details 先递增代号再通知工作线程，之后入队的背景任务都带有新代号
+ */
+void IOThread::advanceBackgroundGeneration()
+{
+	unsigned int generation = ++_backgroundGeneration;
+	updateSettings([generation](IOWorkerSettings& settings) { settings._backgroundGeneration = generation; });
+}
+
+/**
+ * @brief 进入新的叠加层外观代
+ * @details 前景渲染代之前调用，保证新代的快照中缓存的渲染结果已经失效
+ */
+void IOThread::advanceOverlayGeneration()
+{
+	unsigned int generation = ++_overlayGeneration;
+	updateSettings([generation](IOWorkerSettings& settings) { settings._overlayGeneration = generation; });
+}
+
+/**
+ * @brief 设置荧光多通道合成
+ * @param channels 各通道的显示设置
+ * @details 只编译可见且在背景图像通道范围内的通道，编译结果由所有工作线程共享
+ */
+void IOThread::setChannelComposite(const std::vector<SlideColorManagement::ChannelDisplay>& channels)
+{
+	_channelComposite.reset();
+	if (!channels.empty()) {
+		unsigned int samplesPerPixel = 0;
+		if (std::shared_ptr<MultiResolutionImage> img = _bck_img.lock()) {
+			samplesPerPixel = img->getSamplesPerPixel();
+		}
+		std::shared_ptr<std::vector<PixelConversion::CompositeChannel> > composite = std::make_shared<std::vector<PixelConversion::CompositeChannel> >();
+		for (unsigned int i = 0; i < channels.size() && i < samplesPerPixel; ++i) {
+			const SlideColorManagement::ChannelDisplay& display = channels[i];
+			if (!display.visible) {
+				continue;
+			}
+			composite->push_back(PixelConversion::CompositeChannel());
+			PixelConversion::buildCompositeChannel(composite->back(), i, display.windowMin, display.windowMax, display.gamma,
+				static_cast<unsigned char>(std::max(0.f, std::min(display.color[0], 255.f))),
+				static_cast<unsigned char>(std::max(0.f, std::min(display.color[1], 255.f))),
+				static_cast<unsigned char>(std::max(0.f, std::min(display.color[2], 255.f))));
+		}
+		_channelComposite = composite;
+	}
+	std::shared_ptr<const std::vector<PixelConversion::CompositeChannel> > compiled = _channelComposite;
+	updateSettings([&compiled](IOWorkerSettings& settings) { settings._channelComposite = compiled; });
+	advanceBackgroundGeneration();
+}
+
+/**
+ * @brief 设置背景瓦片增强
+ * @param sharpness 反锐化掩模强度
+ * @param gamma 伽马指数
+ * @param brightness 亮度偏移
+ * @param contrast 对比度
+ * @details 不改变图像的参数发布为空，工作线程直接跳过增强
+ */
+void IOThread::setEnhancement(float sharpness, float gamma, float brightness, float contrast)
+{
+	std::shared_ptr<PixelConversion::Enhancement> enhancement = std::make_shared<PixelConversion::Enhancement>();
+	PixelConversion::buildEnhancement(*enhancement, sharpness, gamma, brightness, contrast);
+	if (PixelConversion::isIdentity(*enhancement)) {
+		enhancement.reset();
+	}
+	_enhancement = enhancement;
+	std::shared_ptr<const PixelConversion::Enhancement> compiled = _enhancement;
+	updateSettings([&compiled](IOWorkerSettings& settings) { settings._enhancement = compiled; });
+	advanceBackgroundGeneration();
+}
+
+/**
+ * @brief 设置显示的Z平面
+ * @param zPlane Z平面索引
+ * @details 先发布新平面再增加背景渲染代，带新一代背景渲染代的结果总是来自新平面
+ */
+void IOThread::setZPlane(unsigned int zPlane)
+{
+	if (zPlane == _zPlane) {
+		return;
+	}
+	_zPlane = zPlane;
+	updateSettings([zPlane](IOWorkerSettings& settings) { settings._zPlane = zPlane; });
+	advanceBackgroundGeneration();
+}
+
+/**
+ * @brief 调整工作线程数量
+ * @param nrThreads 新的线程数量，0表示按CPU核数自动确定
+ * @details 工作线程由全局线程池管理，修改对所有视图生效
+ */
+void IOThread::setNumberOfThreads(unsigned int nrThreads)
+{
+	if (!_abort) {
+		IOWorkerPool::instance()->setNumberOfThreads(nrThreads);
+	}
+}
+
+/**
+ * @brief 调整队列数量
+ * @param nrQueues 新的队列数量，至少为1
+ * @details 由IOWorkerPool在线程数改变时调用，多余队列中的任务重新分配到剩余队列
+ */
+void IOThread::resizeQueues(unsigned int nrQueues)
+{
+	nrQueues = std::max(nrQueues, 1u);
+	QWriteLocker queuesLocker(&_queuesLock);
+	while (_queues.size() < nrQueues) {
+		_queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+	}
+	std::list<ThreadJob*> orphanedJobs;
+	while (_queues.size() > nrQueues) {
+		orphanedJobs.splice(orphanedJobs.end(), _queues.back()->jobs);
+		_queues.pop_back();
+	}
+	for (auto job : orphanedJobs) {
+		WorkerQueue* queue = _queues[_nextQueue++ % _queues.size()].get();
+		QMutexLocker queueLocker(&queue->mutex);
+		insertJob(queue->jobs, job);
 	}
 }
 
 /**
  * @brief 获取当前任务数量
- * @return 任务队列中的任务数量
- * @details 线程安全地获取任务列表的大小
+ * @return 所有队列中的任务总数
  */
 unsigned int IOThread::numberOfJobs()
 {
-	_jobListMutex.lock();
-	unsigned int nrJobs = _jobList.size();
-	_jobListMutex.unlock();
-	return nrJobs;
+	return _nrJobs;
+}
+
+/**
+ * @brief 是否空闲
+ * @return 队列为空且没有正在执行的任务时返回true
+ */
+bool IOThread::isIdle() const
+{
+	return _nrJobs == 0 && _activeJobs == 0;
+}
+
+/**
+ * @brief 任务执行完成
+ * @details 由工作线程在任务执行完成并发出结果信号后调用，之后工作线程不再访问该对象
+ */
+void IOThread::jobFinished()
+{
+	--_activeJobs;
 }
 
 /**
  * @brief 关闭IO线程管理器
- * @details 设置中止标志，等待所有工作线程完成并清理资源
+ * @details 设置中止标志，从全局线程池注销（等待正在执行的任务完成）并释放剩余任务
  */
 void IOThread::shutdown() {
+	if (_abort) {
+		return;
+	}
 	_abort = true;
-	for (std::vector<IOWorker*>::iterator it = _workers.begin(); it != _workers.end(); ++it) {
-		(*it)->abort();
-		while ((*it)->isRunning()) {
-			_condition.wakeOne();
+	std::list<ThreadJob*> jobs;
+	_queuesLock.lockForWrite();
+	for (auto& queue : _queues) {
+		jobs.splice(jobs.end(), queue->jobs);
+	}
+	IOWorkerPool::instance()->jobsRemoved(_nrJobs.exchange(0));
+	_queuesLock.unlock();
+	IOWorkerPool::instance()->unregisterClient(this);
+	for (auto job : jobs) {
+		delete job;
+	}
+	// 未发出的结果不再投递，前景源数据随之释放；工作线程已空闲，不会再写入
+	TileDelivery delivery;
+	while (_deliveries.pop(delivery)) {
+		delete delivery._foregroundTile;
+	}
+}
+
+/**
+ * @brief 提交一个瓦片结果
+ * @param delivery 结果
+ * @details 只有把_deliveryScheduled由false改为true的结果才投递队列事件，批量处理开始前到达的结果都并入同一批。
+ *          队列满时已有批量处理在排队，让出时间片等待GUI线程取出；shutdown等待工作线程空闲，等待中发现关闭时放弃
+ */
+void IOThread::deliverTile(TileDelivery& delivery)
+{
+	if (_abort) {
+		delete delivery._foregroundTile;
+		return;
+	}
+	while (!_deliveries.push(delivery)) {
+		if (_abort) {
+			delete delivery._foregroundTile;
+			return;
 		}
-		delete (*it);
+		QThread::yieldCurrentThread();
+	}
+	if (!_deliveryScheduled.exchange(true)) {
+		QMetaObject::invokeMethod(this, "processTileDeliveries", Qt::QueuedConnection);
+	}
+}
+
+/**
+ * @brief 是否有尚未发出信号的瓦片结果
+ * @return 投递队列非空时返回true
+ */
+bool IOThread::hasPendingDeliveries() const
+{
+	return !_deliveries.empty();
+}
+
+/**
+ * @brief 立即发出所有待投递的瓦片结果
+ * @details 已安排的批量处理之后发现队列为空时直接结束
+ */
+void IOThread::flushTileDeliveries()
+{
+	TileDelivery delivery;
+	while (_deliveries.pop(delivery)) {
+		dispatchTileDelivery(delivery);
+	}
+}
+
+/**
+ * @brief 按帧批量投递瓦片结果
+ * @details 超出时间预算的结果留在完成队列中，保持工作线程提交的顺序；
+ *          清除_deliveryScheduled之后再检查一次队列，避免与同时提交的工作线程互相错过
+ */
+void IOThread::processTileDeliveries()
+{
+	if (_lastDelivery.isValid() && _lastDelivery.elapsed() < kDeliveryInterval) {
+		QTimer::singleShot(static_cast<int>(kDeliveryInterval - _lastDelivery.elapsed()), this, &IOThread::processTileDeliveries);
+		return;
+	}
+	_lastDelivery.start();
+	{
+		PipelineTrace::ScopedEvent event("IOThread::processTileDeliveries");
+		TileDelivery delivery;
+		while (_lastDelivery.elapsed() < kDeliveryBudget && _deliveries.pop(delivery)) {
+			dispatchTileDelivery(delivery);
+		}
+	}
+	if (_deliveries.empty()) {
+		_deliveryScheduled = false;
+		if (_deliveries.empty() || _deliveryScheduled.exchange(true)) {
+			return;
+		}
+	}
+	QTimer::singleShot(kDeliveryInterval, this, &IOThread::processTileDeliveries);
+}
+
+/**
+ * @brief 发出一个结果的信号
+ * @param delivery 结果
+ * @details 像素图在GUI线程中创建，平台相关的上传只在这里发生一次；接收者在同一线程中，信号为直接调用
+ */
+void IOThread::dispatchTileDelivery(TileDelivery& delivery)
+{
+	QPixmap* tile = delivery._hasTile ? new QPixmap(QPixmap::fromImage(delivery._tile)) : NULL;
+	delivery._tile = QImage();
+	switch (delivery._kind) {
+	case TileDelivery::TileLoaded: {
+		QPixmap* foregroundPixmap = delivery._hasForeground ? new QPixmap(QPixmap::fromImage(delivery._foreground)) : NULL;
+		emit tileLoaded(tile, delivery._tileX, delivery._tileY, delivery._tileSize, delivery._tileByteSize, delivery._tileLevel,
+			delivery._foregroundTile, foregroundPixmap, delivery._renderGeneration, delivery._backgroundGeneration);
+		break;
+	}
+	case TileDelivery::ForegroundRendered:
+		emit foregroundTileRendered(tile, delivery._tileX, delivery._tileY, delivery._tileLevel, delivery._renderGeneration);
+		break;
+	case TileDelivery::BackgroundRendered:
+		emit backgroundTileRendered(tile, delivery._tileX, delivery._tileY, delivery._tileLevel, delivery._backgroundGeneration);
+		break;
+	case TileDelivery::PreviewLoaded:
+		emit tilePreviewLoaded(tile, delivery._tileX, delivery._tileY, delivery._tileSize, delivery._tileLevel);
+		break;
 	}
-	_workers.clear();
 }
 
 /**
  * @brief 获取所有工作线程
  * @return 工作线程向量
- * @details 返回所有IOWorker线程的指针
+ * @details 返回全局线程池中所有IOWorker线程的指针
  */
 std::vector<IOWorker*> IOThread::getWorkers()
 {
-	return _workers;
+	return IOWorkerPool::instance()->getWorkers();
 }
 
 /**
  * @brief 获取等待中的线程数量
  * @return 等待任务的线程数量
- * @details 返回当前等待在条件变量上的线程数量
+ * @details 返回全局线程池中等待在条件变量上的线程数量
  */
 unsigned int IOThread::getWaitingThreads() {
-	return _threadsWaiting;
+	return IOWorkerPool::instance()->getWaitingThreads();
 }
 
 /**
@@ -97,34 +480,259 @@ IOThread::~IOThread()
  * @param imgPosY 图像Y位置
  * @param level 图像层级
  * @param foregroundTile 前景瓦片（可选）
- * @details 根据是否提供前景瓦片创建IOJob或RenderJob，并添加到任务队列前端
+ * @param preview IO任务是否先投递预览
+ * @details 根据是否提供前景瓦片创建IOJob或RenderJob，由enqueueJob按当前视野计算优先级后
+ *          轮询投放到各工作线程的队列中并有序插入
  */
-void IOThread::addJob(const unsigned int tileSize, const long long imgPosX, const long long imgPosY, const unsigned int level, ImageSource* foregroundTile)
+void IOThread::addJob(const unsigned int tileSize, const long long imgPosX, const long long imgPosY, const unsigned int level, ImageSource* foregroundTile,
+	bool preview)
 {
 	ThreadJob* job = NULL;
 	if (foregroundTile) {
-		job = new RenderJob(tileSize, imgPosX, imgPosY, level, foregroundTile);
+		job = new RenderJob(tileSize, imgPosX, imgPosY, level, foregroundTile, _renderGeneration);
 	}
 	else {
-		job = new IOJob(tileSize, imgPosX, imgPosY, level);
+		IOJob* ioJob = new IOJob(tileSize, imgPosX, imgPosY, level);
+		ioJob->_preview = preview;
+		job = ioJob;
+	}
+	job->_zPlane = _zPlane;
+	enqueueJob(job);
+}
+
+/**
+ * @brief 添加合并IO任务
+ * @param tileSize 瓦片大小
+ * @param imgPosX 第一列瓦片的X位置
+ * @param imgPosY 第一行瓦片的Y位置
+ * @param columns 列数
+ * @param rows 行数
+ * @param level 图像层级
+ * @param preview 是否先投递预览
+ * @details 只有一个瓦片时按普通IO任务排队
+ */
+void IOThread::addBatchJob(const unsigned int tileSize, const long long imgPosX, const long long imgPosY, const unsigned int columns,
+	const unsigned int rows, const unsigned int level, bool preview)
+{
+	if (columns * rows <= 1) {
+		addJob(tileSize, imgPosX, imgPosY, level, NULL, preview);
+		return;
+	}
+	BatchIOJob* job = new BatchIOJob(tileSize, imgPosX, imgPosY, columns, rows, level);
+	job->_preview = preview;
+	job->_zPlane = _zPlane;
+	enqueueJob(job);
+}
+
+/**
+ * @brief 添加背景重新合成任务
+ * @param tileSize 瓦片大小
+ * @param imgPosX 图像X位置
+ * @param imgPosY 图像Y位置
+ * @param level 图像层级
+ * @param residentOnly 是否只处理内存缓存中的瓦片
+ */
+void IOThread::addBackgroundRenderJob(const unsigned int tileSize, const long long imgPosX, const long long imgPosY, const unsigned int level,
+	bool residentOnly)
+{
+	BackgroundRenderJob* job = new BackgroundRenderJob(tileSize, imgPosX, imgPosY, level, _backgroundGeneration, residentOnly);
+	job->_zPlane = _zPlane;
+	enqueueJob(job);
+}
+
+/**
+ * @brief 添加瓦片任务
+ * @param task 瓦片任务
+ * @param nrJobs 并行处理的瓦片数
+ * @details 瓦片任务都是后台任务，彼此之间先来先处理
+ */
+void IOThread::addTileTask(std::shared_ptr<TileTask> task, unsigned int nrJobs)
+{
+	if (nrJobs == 0) {
+		QReadLocker queuesLocker(&_queuesLock);
+		nrJobs = 2 * static_cast<unsigned int>(std::max<size_t>(_queues.size(), 1));
+	}
+	nrJobs = std::min(nrJobs, task->getNumberOfTiles());
+	for (unsigned int i = 0; i < nrJobs; ++i) {
+		enqueueJob(new TileTaskJob(task));
+	}
+}
+
+/**
+ * @brief 投放任务
+ * @param job 任务
+ * @details 没有工作线程队列时直接释放任务
+ */
+void IOThread::enqueueJob(ThreadJob* job)
+{
+	// 工作线程重新投放TileTaskJob时也会调用，视野中心在锁内复制
+	QPointF fovCenter;
+	{
+		QMutexLocker fieldOfViewLocker(&_fieldOfViewMutex);
+		fovCenter = _fovCenter;
+	}
+	updateJobPriority(job, fovCenter);
+	job->_enqueueTime = PipelineProfiler::timestamp();
+	PipelineTrace::instant("IOThread::enqueueJob", job->_imgPosX, job->_imgPosY, job->_level);
+	{
+		QReadLocker queuesLocker(&_queuesLock);
+		if (_abort || _queues.empty()) {
+			delete job;
+			return;
+		}
+		WorkerQueue* queue = _queues[_nextQueue++ % _queues.size()].get();
+		QMutexLocker queueLocker(&queue->mutex);
+		insertJob(queue->jobs, job);
+		++_nrJobs;
+	}
+	IOWorkerPool::instance()->jobsAdded();
+}
+
+/**
+ * @brief 计算任务优先级
+ * @param job 任务
+ * @param fovCenter 视野中心（第0层像素坐标）
+ * @details 未设置背景图像时无法换算坐标，优先级保持为0；合并IO任务按整块的中心计算
+ */
+void IOThread::updateJobPriority(ThreadJob* job, const QPointF& fovCenter) const
+{
+	if (job->_level >= _levelDownsamples.size()) {
+		job->_priority = 0.f;
+		return;
+	}
+	unsigned int columns, rows;
+	jobTiles(job, columns, rows);
+	float tileExtent = job->_tileSize * _levelDownsamples[job->_level];
+	float dx = (job->_imgPosX + 0.5f * columns) * tileExtent - fovCenter.x();
+	float dy = (job->_imgPosY + 0.5f * rows) * tileExtent - fovCenter.y();
+	job->_priority = std::sqrt(dx * dx + dy * dy);
+}
+
+/**
+ * @brief 按优先级插入任务
+ * @param jobs 目标队列
+ * @param job 任务
+ * @details 插入到第一个优先级低于该任务的位置之前，相同优先级保持先来先处理
+ */
+void IOThread::insertJob(std::list<ThreadJob*>& jobs, ThreadJob* job)
+{
+	std::list<ThreadJob*>::iterator it = jobs.begin();
+	while (it != jobs.end() && !jobPrecedes(job, *it)) {
+		++it;
+	}
+	jobs.insert(it, job);
+}
+
+/**
+ * @brief 更新当前视野
+ * @param FOV 视野范围（第0层像素坐标）
+ * @param persistentLevel 始终保留的层级
+ * @details 剔除与新视野不相交的IO任务并重新排序剩余任务，合并IO任务整块离开视野时才剔除。
+ *          被剔除任务的空信号在释放互斥锁之后逐个瓦片发送，避免槽函数中回调IOThread时死锁
+ */
+void IOThread::setFieldOfView(const QRectF& FOV, unsigned int persistentLevel)
+{
+	std::vector<ThreadJob*> staleJobs;
+	const QPointF fovCenter = FOV.center();
+	{
+		QMutexLocker fieldOfViewLocker(&_fieldOfViewMutex);
+		_fovCenter = fovCenter;
+		_fieldOfView = FOV;
+		_persistentLevel = persistentLevel;
+	}
+	_queuesLock.lockForRead();
+	for (auto& queue : _queues) {
+		QMutexLocker queueLocker(&queue->mutex);
+		for (std::list<ThreadJob*>::iterator it = queue->jobs.begin(); it != queue->jobs.end();) {
+			ThreadJob* job = *it;
+			if (dynamic_cast<IOJob*>(job) && job->_level < persistentLevel && job->_level < _levelDownsamples.size()) {
+				unsigned int columns, rows;
+				jobTiles(job, columns, rows);
+				float tileExtent = job->_tileSize * _levelDownsamples[job->_level];
+				QRectF tileRect(job->_imgPosX * tileExtent, job->_imgPosY * tileExtent, columns * tileExtent, rows * tileExtent);
+				if (!tileRect.intersects(FOV)) {
+					staleJobs.push_back(job);
+					it = queue->jobs.erase(it);
+					--_nrJobs;
+					IOWorkerPool::instance()->jobsRemoved(1);
+					continue;
+				}
+			}
+			updateJobPriority(job, fovCenter);
+			++it;
+		}
+		queue->jobs.sort(jobPrecedes);
+	}
+	_queuesLock.unlock();
+
+	for (auto job : staleJobs) {
+		emitCancelledTiles(job);
+		delete job;
+	}
+}
+
+/**
+ * @brief 检查正在执行的IO任务是否已过期
+ * @param job 任务
+ * @param levelDownsample 任务层级的降采样比例
+ * @return 任务已过期时返回true
+ */
+bool IOThread::isJobStale(const ThreadJob* job, double levelDownsample) const
+{
+	QMutexLocker fieldOfViewLocker(&_fieldOfViewMutex);
+	if (_fieldOfView.isEmpty() || job->_level >= _persistentLevel) {
+		return false;
+	}
+	unsigned int columns, rows;
+	jobTiles(job, columns, rows);
+	const double tileExtent = job->_tileSize * levelDownsample;
+	return !QRectF(job->_imgPosX * tileExtent, job->_imgPosY * tileExtent, columns * tileExtent, rows * tileExtent).intersects(_fieldOfView);
+}
+
+/**
+ * @brief 为未执行的IO任务发送空结果
+ * @param job IO任务
+ * @details 合并IO任务逐个瓦片发送，TileManager据此重置每个瓦片的覆盖状态
+ */
+void IOThread::emitCancelledTiles(const ThreadJob* job)
+{
+	unsigned int columns, rows;
+	jobTiles(job, columns, rows);
+	for (unsigned int r = 0; r < rows; ++r) {
+		for (unsigned int c = 0; c < columns; ++c) {
+			emit tileLoaded(nullptr, job->_imgPosX + c, job->_imgPosY + r, job->_tileSize, 0, job->_level, nullptr, nullptr);
+		}
 	}
-	QMutexLocker locker(&_jobListMutex);
-	_jobList.push_front(job);
-	_condition.wakeOne();
 }
 
 /**
  * @brief 设置背景图像
  * @param bck_img 背景图像弱指针
- * @details 为所有工作线程设置背景图像引用
+ * @details 为所有工作线程设置背景图像引用；RGB图像嵌入ICC配置文件时一次性编译到sRGB的3D查找表，
+ *          工作线程只做查表插值
  */
 void IOThread::setBackgroundImage(std::weak_ptr<MultiResolutionImage> bck_img)
 {
-	QMutexLocker locker(&_jobListMutex);
 	_bck_img = bck_img;
-	for (unsigned int i = 0; i < _workers.size(); ++i) {
-		_workers[i]->setBackgroundImage(_bck_img);
+	_levelDownsamples.clear();
+	_colorTransform.reset();
+	if (std::shared_ptr<MultiResolutionImage> img = _bck_img.lock()) {
+		for (int i = 0; i < img->getNumberOfLevels(); ++i) {
+			_levelDownsamples.push_back(img->getLevelDownsample(i));
+		}
+		const SlideColorManagement::ColorType colorType = img->getColorType();
+		if (colorType == SlideColorManagement::ColorType::RGB || colorType == SlideColorManagement::ColorType::RGBA) {
+			_colorTransform = IccProfile::compileToSRGB(img->getICCProfile());
+		}
 	}
+	// 合成设置按通道索引编译，不沿用到新图像
+	_channelComposite.reset();
+	std::shared_ptr<const PixelConversion::ColorLUT3D> colorTransform = _colorTransform;
+	updateSettings([&bck_img, &colorTransform](IOWorkerSettings& settings) {
+		settings._bck_img = bck_img;
+		settings._channelComposite.reset();
+		settings._colorTransform = colorTransform;
+	});
 }
 
 /**
@@ -135,34 +743,39 @@ void IOThread::setBackgroundImage(std::weak_ptr<MultiResolutionImage> bck_img)
  */
 void IOThread::setForegroundImage(std::weak_ptr<MultiResolutionImage> for_img, float scale)
 {
-	QMutexLocker locker(&_jobListMutex);
 	_for_img = for_img;
-	for (unsigned int i = 0; i < _workers.size(); ++i) {
-		_workers[i]->setForegroundImage(for_img, scale);
-	}
+	_foregroundImageScale = scale;
+	updateSettings([&for_img, scale](IOWorkerSettings& settings) {
+		settings._for_img = for_img;
+		settings._foregroundImageScale = scale;
+	});
+	advanceRenderGeneration();
 }
 
 /**
- * @brief 获取任务
- * @return 任务指针，如果没有任务或已中止则返回NULL
- * @details 从任务队列前端获取任务，如果队列为空则等待
+ * @brief 从队列中取出任务
+ * @param queueIndex 工作线程的队列索引
+ * @param includeDeferred 是否取后台任务
+ * @return 任务指针，没有符合条件的任务时返回NULL
+ * @details 从工作线程对应的队列开始依次检查，其他队列中的任务即为窃取。
+ *          后台任务排在队尾，队首为后台任务说明该队列没有显示任务
  */
-ThreadJob* IOThread::getJob()
+ThreadJob* IOThread::takeJob(unsigned int queueIndex, bool includeDeferred)
 {
-	_jobListMutex.lock();
-	while (_jobList.empty() && !_abort) {
-		_threadsWaiting++;
-		_condition.wait(&_jobListMutex);
-		_threadsWaiting--;
-	}
-	if (_abort) {
-		_jobListMutex.unlock();
-		return NULL;
+	QReadLocker queuesLocker(&_queuesLock);
+	unsigned int nrQueues = _queues.size();
+	for (unsigned int i = 0; i < nrQueues; ++i) {
+		WorkerQueue* queue = _queues[(queueIndex + i) % nrQueues].get();
+		QMutexLocker queueLocker(&queue->mutex);
+		if (!queue->jobs.empty() && (includeDeferred || !queue->jobs.front()->_deferred)) {
+			ThreadJob* job = queue->jobs.front();
+			queue->jobs.pop_front();
+			--_nrJobs;
+			++_activeJobs;
+			return job;
+		}
 	}
-	ThreadJob* job = _jobList.front();
-	_jobList.pop_front();
-	_jobListMutex.unlock();
-	return job;
+	return NULL;
 }
 
 /**
@@ -171,19 +784,30 @@ ThreadJob* IOThread::getJob()
  */
 void IOThread::clearJobs()
 {
-	QMutexLocker locker(&_jobListMutex);
-	for (auto job : _jobList) {
-		if (_workers.size() > 0) {
-			if (dynamic_cast<IOJob*>(job)) {
-				emit _workers[0]->tileLoaded(nullptr, job->_imgPosX, job->_imgPosY, job->_tileSize, 0, job->_level, nullptr, nullptr);
-			}
-			else {
-				emit _workers[0]->foregroundTileRendered(nullptr, job->_imgPosX, job->_imgPosY, job->_level);
+	std::list<ThreadJob*> jobs;
+	_queuesLock.lockForRead();
+	for (auto& queue : _queues) {
+		QMutexLocker queueLocker(&queue->mutex);
+		_nrJobs -= queue->jobs.size();
+		IOWorkerPool::instance()->jobsRemoved(queue->jobs.size());
+		jobs.splice(jobs.end(), queue->jobs);
+	}
+	_queuesLock.unlock();
+	for (auto job : jobs) {
+		if (dynamic_cast<IOJob*>(job)) {
+			emitCancelledTiles(job);
+		}
+		else if (dynamic_cast<RenderJob*>(job)) {
+			emit foregroundTileRendered(nullptr, job->_imgPosX, job->_imgPosY, job->_level, _renderGeneration);
+		}
+		if (TileTaskJob* taskJob = dynamic_cast<TileTaskJob*>(job)) {
+			// 取消后把剩余瓦片逐个计为完成，保证任务最终发出完成信号
+			taskJob->_task->cancel();
+			while (taskJob->_task->processNextTile()) {
 			}
 		}
 		delete job;
 	}
-	_jobList.clear();
 }
 
 /**
@@ -192,11 +816,9 @@ void IOThread::clearJobs()
  * @details 为所有工作线程设置新的背景通道
  */
 void IOThread::onBackgroundChannelChanged(int channel) {
-	_jobListMutex.lock();
-	for (unsigned int i = 0; i < _workers.size(); ++i) {
-		_workers[i]->setBackgroundChannel(channel);
-	}
-	_jobListMutex.unlock();
+	_backgroundChannel = channel;
+	updateSettings([channel](IOWorkerSettings& settings) { settings._backgroundChannel = channel; });
+	advanceBackgroundGeneration();
 }
 
 /**
@@ -205,11 +827,10 @@ void IOThread::onBackgroundChannelChanged(int channel) {
  * @details 为所有工作线程设置新的前景通道
  */
 void IOThread::onForegroundChannelChanged(int channel) {
-	_jobListMutex.lock();
-	for (unsigned int i = 0; i < _workers.size(); ++i) {
-		_workers[i]->setForegroundChannel(channel);
-	}
-	_jobListMutex.unlock();
+	_foregroundChannel = channel;
+	updateSettings([channel](IOWorkerSettings& settings) { settings._foregroundChannel = channel; });
+	advanceOverlayGeneration();
+	advanceRenderGeneration();
 }
 
 /**
@@ -218,9 +839,8 @@ void IOThread::onForegroundChannelChanged(int channel) {
  * @details 为所有工作线程设置新的颜色查找表
  */
 void IOThread::onLUTChanged(const SlideColorManagement::LUT& LUT) {
-	_jobListMutex.lock();
-	for (unsigned int i = 0; i < _workers.size(); ++i) {
-		_workers[i]->setLUT(LUT);
-	}
-	_jobListMutex.unlock();
+	_LUT = LUT;
+	updateSettings([&LUT](IOWorkerSettings& settings) { settings._LUT = LUT; });
+	advanceOverlayGeneration();
+	advanceRenderGeneration();
 }
\ No newline at end of file
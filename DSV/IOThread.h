@@ -21,15 +21,29 @@
 #pragma once
 
 #include <QObject>
+#include <QElapsedTimer>
+#include <QImage>
 #include <QMutex>
 #include <QWaitCondition>
 #include <QThread>
+#include <QReadWriteLock>
+#include <QRectF>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "CompletionRing.h"
 #include "SlideColorManagement.h"
+#include "PixelConversion.h"
 
  // 前向声明
 class MultiResolutionImage;
 class IOWorker;
 class ImageSource;
+class TileTask;
+class OverlayTileCache;
+class QPixmap;
+struct IOWorkerSettings;
 
 /**
  * @class  ThreadJob
@@ -54,6 +68,18 @@ public:
     /** @brief 瓦片所属的层级索引 */
     unsigned int _level;
 
+    /** @brief 瓦片所属的Z平面索引，由IOThread入队时设置 */
+    unsigned int _zPlane;
+
+    /** @brief 调度优先级，瓦片中心到当前视野中心的距离（第0层像素），越小越先处理 */
+    float _priority;
+
+    /** @brief 是否为后台任务，后台任务排在所有显示任务之后 */
+    bool _deferred;
+
+    /** @brief 入队时间戳（PipelineProfiler::timestamp），统计关闭时为0 */
+    long long _enqueueTime;
+
     /**
      * @brief   构造函数
      * @details 创建线程任务对象，初始化瓦片处理的基本参数
@@ -62,10 +88,10 @@ public:
      * @param   imgPosX 瓦片在图像中的X坐标
      * @param   imgPosY 瓦片在图像中的Y坐标
      * @param   level 瓦片所属的层级索引
-     * @note    构造函数会初始化所有成员变量
+     * @note    构造函数会初始化所有成员变量，优先级由IOThread入队时计算
      */
     ThreadJob(unsigned int tileSize, long long imgPosX, long long imgPosY, unsigned int level) :
-        _tileSize(tileSize), _imgPosX(imgPosX), _imgPosY(imgPosY), _level(level)
+        _tileSize(tileSize), _imgPosX(imgPosX), _imgPosY(imgPosY), _level(level), _zPlane(0), _priority(0.f), _deferred(false), _enqueueTime(0)
     {
         // 构造函数体为空，所有初始化在初始化列表中完成
     }
@@ -93,6 +119,14 @@ public:
 class IOJob : public ThreadJob
 {
 public:
+    /**
+     * @brief 是否先投递缩小解码的预览
+     * @details 由TileManager在瓦片附近没有足够精细的已显示瓦片时设置，
+     *          工作线程在完整解码之前先发出tilePreviewLoaded
+     * @see     IOThread::kPreviewScale, IOThread::tilePreviewLoaded
+     */
+    bool _preview;
+
     /**
      * @brief   构造函数
      * @details 创建IO任务对象，调用基类构造函数初始化基本参数
@@ -104,12 +138,48 @@ public:
      * @note    该构造函数直接调用基类构造函数
      */
     IOJob(unsigned int tileSize, long long imgPosX, long long imgPosY, unsigned int level) :
-        ThreadJob(tileSize, imgPosX, imgPosY, level)
+        ThreadJob(tileSize, imgPosX, imgPosY, level),
+        _preview(false)
     {
         // 构造函数体为空，所有初始化在基类构造函数中完成
     }
 };
 
+/**
+ * @class  BatchIOJob
+ * @brief  合并IO任务类，一次加载相邻的多个瓦片
+ * @details 覆盖从(_imgPosX, _imgPosY)开始的_columns x _rows个同一层级的瓦片。
+ *          工作线程把未命中缓存的瓦片合并为一次包围区域的读取，再拆分为逐个瓦片的结果投递，
+ *          每个瓦片的结果与单独的IOJob相同；取消时同样逐个瓦片发出空结果
+ *
+ * @see     IOJob, IOThread::addBatchJob, MultiResolutionImage::getARGB32Tiles
+ */
+class BatchIOJob : public IOJob
+{
+public:
+    /** @brief 列数 */
+    unsigned int _columns;
+
+    /** @brief 行数 */
+    unsigned int _rows;
+
+    /**
+     * @brief   构造函数
+     * @param   tileSize 瓦片大小（像素）
+     * @param   imgPosX 第一列瓦片的X坐标
+     * @param   imgPosY 第一行瓦片的Y坐标
+     * @param   columns 列数
+     * @param   rows 行数
+     * @param   level 瓦片所属的层级索引
+     */
+    BatchIOJob(unsigned int tileSize, long long imgPosX, long long imgPosY, unsigned int columns, unsigned int rows, unsigned int level) :
+        IOJob(tileSize, imgPosX, imgPosY, level),
+        _columns(columns),
+        _rows(rows)
+    {
+    }
+};
+
 /**
  * @class  RenderJob
  * @brief  渲染任务类，用于瓦片前景渲染任务
@@ -121,9 +191,12 @@ public:
  */
 class RenderJob : public ThreadJob {
 public:
-    /** @brief 前景瓦片的图像源指针 */
+    /** @brief 前景瓦片的图像源指针，由任务持有并在析构时释放 */
     ImageSource* _foregroundTile;
 
+    /** @brief 入队时的前景渲染代，低于工作线程当前代的任务不再执行 */
+    unsigned int _generation;
+
     /**
      * @brief   构造函数
      * @details 创建渲染任务对象，初始化瓦片处理参数和前景瓦片信息
@@ -132,15 +205,119 @@ public:
      * @param   imgPosX 瓦片在图像中的X坐标
      * @param   imgPosY 瓦片在图像中的Y坐标
      * @param   level 瓦片所属的层级索引
-     * @param   foregroundTile 前景瓦片的图像源指针
+     * @param   foregroundTile 前景瓦片的图像源指针，所有权转移给任务
+     * @param   generation 前景渲染代
      * @note    该构造函数会初始化所有成员变量，包括前景瓦片信息
      */
-    RenderJob(unsigned int tileSize, long long imgPosX, long long imgPosY, unsigned int level, ImageSource* foregroundTile) :
+    RenderJob(unsigned int tileSize, long long imgPosX, long long imgPosY, unsigned int level, ImageSource* foregroundTile, unsigned int generation = 0) :
         ThreadJob(tileSize, imgPosX, imgPosY, level),
-        _foregroundTile(foregroundTile)
+        _foregroundTile(foregroundTile),
+        _generation(generation)
     {
         // 构造函数体为空，所有初始化在初始化列表中完成
     }
+
+    /**
+     * @brief   析构函数
+     * @details 释放前景瓦片的图像源
+     */
+    ~RenderJob();
+};
+
+/**
+ * @class  BackgroundRenderJob
+ * @brief  背景重新合成任务类，用于已显示瓦片的背景重新渲染
+ * @details 该类继承自ThreadJob。工作线程按当前通道合成设置重新渲染背景瓦片，
+ *          原始数据通常命中MultiResolutionImage的解码瓦片缓存，不必重新读取和解码文件。
+ * @see     ThreadJob, RenderJob, IOThread::addBackgroundRenderJob
+ */
+class BackgroundRenderJob : public ThreadJob {
+public:
+    /** @brief 入队时的背景渲染代，低于工作线程当前代的任务不再执行 */
+    unsigned int _generation;
+
+    /** @brief 只处理原始数据仍在内存缓存中的瓦片，未命中时放弃任务而不读取图像 */
+    bool _residentOnly;
+
+    /**
+     * @brief   构造函数
+     * @param   tileSize 瓦片大小（像素）
+     * @param   imgPosX 瓦片在图像中的X坐标
+     * @param   imgPosY 瓦片在图像中的Y坐标
+     * @param   level 瓦片所属的层级索引
+     * @param   generation 背景渲染代
+     * @param   residentOnly 是否只处理内存缓存中的瓦片
+     */
+    BackgroundRenderJob(unsigned int tileSize, long long imgPosX, long long imgPosY, unsigned int level, unsigned int generation,
+        bool residentOnly = false) :
+        ThreadJob(tileSize, imgPosX, imgPosY, level),
+        _generation(generation),
+        _residentOnly(residentOnly)
+    {
+        // 构造函数体为空，所有初始化在初始化列表中完成
+    }
+};
+
+/**
+ * @class  TileTaskJob
+ * @brief  瓦片任务的执行槽，每次执行处理瓦片任务的一个瓦片
+ * @details 该类继承自ThreadJob，是后台任务：排在显示任务之后，也不会因视场变化被剔除。
+ *          任务不携带瓦片坐标，由TileTask::processNextTile决定处理哪个瓦片；
+ *          工作线程处理完后重新投放一个TileTaskJob，直到任务没有剩余瓦片
+ * @see     ThreadJob, TileTask, IOThread::addTileTask
+ */
+class TileTaskJob : public ThreadJob {
+public:
+    /** @brief 所属的瓦片任务 */
+    std::shared_ptr<TileTask> _task;
+
+    /**
+     * @brief   构造函数
+     * @param   task 所属的瓦片任务
+     */
+    TileTaskJob(std::shared_ptr<TileTask> task) :
+        ThreadJob(0, 0, 0, 0),
+        _task(task)
+    {
+        _deferred = true;
+    }
+};
+
+/**
+ * @struct  TileDelivery
+ * @brief   工作线程交给GUI线程的一个瓦片结果
+ * @details 图像已是显示格式（RGB32或ARGB32_Premultiplied），在工作线程中只构造QImage；
+ *          IOThread在GUI线程中按帧批量取出结果，转换为QPixmap后发出与kind对应的信号
+ * @see     IOThread::deliverTile
+ */
+struct TileDelivery {
+    /** @brief 结果类型，对应IOThread的四个结果信号 */
+    enum Kind {
+        TileLoaded,             ///< tileLoaded
+        PreviewLoaded,          ///< tilePreviewLoaded，tile为缩小kPreviewScale倍的预览
+        ForegroundRendered,     ///< foregroundTileRendered，tile为前景图像
+        BackgroundRendered      ///< backgroundTileRendered
+    };
+
+    TileDelivery(Kind kind = TileLoaded, unsigned int tileX = 0, unsigned int tileY = 0, unsigned int tileLevel = 0) :
+        _kind(kind), _hasTile(false), _hasForeground(false), _foregroundTile(NULL), _tileX(tileX), _tileY(tileY),
+        _tileSize(0), _tileByteSize(0), _tileLevel(tileLevel), _renderGeneration(0), _backgroundGeneration(0)
+    {
+    }
+
+    Kind _kind;
+    bool _hasTile;                      ///< false时信号中的瓦片为NULL，表示加载失败或任务被取消
+    QImage _tile;
+    bool _hasForeground;                ///< true时tileLoaded带非NULL的前景像素图（可能为空像素图）
+    QImage _foreground;
+    ImageSource* _foregroundTile;       ///< 前景源数据，所有权随tileLoaded信号转移
+    unsigned int _tileX;
+    unsigned int _tileY;
+    unsigned int _tileSize;
+    unsigned int _tileByteSize;
+    unsigned int _tileLevel;
+    unsigned int _renderGeneration;
+    unsigned int _backgroundGeneration;
 };
 
 /**
@@ -155,7 +332,9 @@ public:
  *
  *          主要功能包括：
  *          - 任务队列管理：添加、获取、清空任务
- *          - 工作线程管理：创建、监控、关闭工作线程
+ *          - 工作线程管理：工作线程由全局IOWorkerPool管理，所有视图共享，支持运行时调整线程数
+ *          - 工作窃取：每个工作线程在每个IOThread中对应一个任务队列，空闲时从其他队列窃取任务
+ *          - 设置快照：图像、通道、LUT等设置保存为不可变快照，工作线程执行该对象的任务时取得一次
  *          - 图像源管理：设置背景和前景图像
  *          - 动态配置：支持LUT和通道的动态切换
  *          - 线程同步：使用互斥锁和条件变量确保线程安全
@@ -163,7 +342,7 @@ public:
  * @note   该类继承自QObject，支持Qt的信号槽机制
  * @example
  *          // 使用示例
- *          IOThread* ioThread = new IOThread(parent, 4); // 创建4个工作线程
+ *          IOThread* ioThread = new IOThread(parent); // 注册到全局线程池，第二个参数非0时同时调整线程池的线程数
  *
  *          // 设置背景图像
  *          ioThread->setBackgroundImage(backgroundImage);
@@ -173,7 +352,7 @@ public:
  *
  *          // 添加瓦片渲染任务
  *          ioThread->addJob(256, 0, 0, 0, foregroundTile);
- * @see     IOWorker, MultiResolutionImage, ThreadJob
+ * @see     IOWorker, IOWorkerPool, MultiResolutionImage, ThreadJob
  */
 class IOThread : public QObject
 {
@@ -182,18 +361,18 @@ class IOThread : public QObject
 public:
     /**
      * @brief   构造函数
-     * @details 创建IO线程管理器，初始化工作线程池和任务队列
+     * @details 创建IO线程管理器并注册到全局IOWorkerPool
      *
      * @param   parent 父对象指针
-     * @param   nrThreads 工作线程数量，默认为2
-     * @note    构造函数会创建指定数量的IOWorker线程
+     * @param   nrThreads 工作线程数量，默认为0，表示沿用线程池当前的线程数（首次创建时为defaultNumberOfThreads()）
+     * @note    线程池的线程数对所有视图生效
      */
-    IOThread(QObject* parent, unsigned int nrThreads = 2);
+    IOThread(QObject* parent, unsigned int nrThreads = 0);
 
     /**
      * @brief   析构函数
-     * @details 清理IO线程管理器资源，包括停止所有工作线程和清理任务队列
-     * @note    析构函数会调用shutdown()确保所有线程正确停止
+     * @details 清理IO线程管理器资源，包括从线程池注销和清理任务队列
+     * @note    析构函数会调用shutdown()，确保工作线程不再访问该对象
      */
     ~IOThread();
 
@@ -206,10 +385,99 @@ public:
      * @param   imgPosY 瓦片在图像中的Y坐标
      * @param   level 瓦片所属的层级索引
      * @param   foregroundTile 前景瓦片图像源指针，NULL表示IO任务，非NULL表示渲染任务
+     * @param   preview IO任务是否先投递预览，渲染任务忽略
      * @note    该函数是线程安全的，支持多线程并发调用
-     * @see     getJob, clearJobs
+     * @see     takeJob, clearJobs
+     */
+    void addJob(const unsigned int tileSize, const long long imgPosX, const long long imgPosY, const unsigned int level, ImageSource* foregroundTile = NULL,
+        bool preview = false);
+
+    /**
+     * @brief   添加合并IO任务
+     * @details 相邻的columns x rows个瓦片作为一个任务排队，由一次区域读取加载，结果仍逐个瓦片发出tileLoaded
+     *
+     * @param   tileSize 瓦片大小（像素）
+     * @param   imgPosX 第一列瓦片的X坐标
+     * @param   imgPosY 第一行瓦片的Y坐标
+     * @param   columns 列数
+     * @param   rows 行数
+     * @param   level 瓦片所属的层级索引
+     * @param   preview 是否在区域读取之前逐个瓦片投递预览
+     * @see     addJob, BatchIOJob
+     */
+    void addBatchJob(const unsigned int tileSize, const long long imgPosX, const long long imgPosY, const unsigned int columns,
+        const unsigned int rows, const unsigned int level, bool preview = false);
+
+    /**
+     * @brief 预览相对完整瓦片的缩小倍数
+     * @details 等于JPEG解码器DCT缩放的最大倍数，预览只需解码每个8x8块的直流系数
+     */
+    static const unsigned int kPreviewScale = 8;
+
+    /**
+     * @brief   添加背景重新合成任务
+     * @details 创建带当前背景渲染代的BackgroundRenderJob并添加到任务队列中
+     * @param   tileSize 瓦片大小（像素）
+     * @param   imgPosX 瓦片在图像中的X坐标
+     * @param   imgPosY 瓦片在图像中的Y坐标
+     * @param   level 瓦片所属的层级索引
+     * @param   residentOnly 为true时只处理原始数据仍在内存缓存中的瓦片，不读取图像
+     * @note    该函数是线程安全的
+     * @see     TileManager::updateTileBackgrounds
+     */
+    void addBackgroundRenderJob(const unsigned int tileSize, const long long imgPosX, const long long imgPosY, const unsigned int level,
+        bool residentOnly = false);
+
+    /**
+     * @brief   添加瓦片任务
+     * @details 投放nrJobs个TileTaskJob，每个执行完一个瓦片后由工作线程重新投放，
+     *          队列中的任务数与任务的瓦片数无关
+     * @param   task 瓦片任务
+     * @param   nrJobs 并行处理的瓦片数，0表示工作线程数的两倍；不超过任务的瓦片数
+     * @note    该函数是线程安全的；clearJobs会取消尚未执行完的瓦片任务
+     * @see     TileTask, RegionAnalysis, RegionExport
      */
-    void addJob(const unsigned int tileSize, const long long imgPosX, const long long imgPosY, const unsigned int level, ImageSource* foregroundTile = NULL);
+    void addTileTask(std::shared_ptr<TileTask> task, unsigned int nrJobs = 0);
+
+    /**
+     * @brief   设置荧光多通道合成
+     * @details 第i项对应背景图像的第i个通道，不可见的通道和超出背景图像通道数的项被忽略。
+     *          设置编译为每通道的颜色贡献表后共享给所有工作线程，
+     *          单色和多通道背景按合成结果渲染；channels为空时恢复为单通道灰度显示
+     * @param   channels 各通道的显示设置
+     * @note    只能在GUI线程中调用，调用后背景渲染代加一；
+     *          已显示的瓦片需要调用TileManager::updateTileBackgrounds重新合成
+     * @see     getBackgroundGeneration, SlideColorManagement::ChannelDisplay
+     */
+    void setChannelComposite(const std::vector<SlideColorManagement::ChannelDisplay>& channels);
+
+    /**
+     * @brief   设置背景瓦片增强
+     * @details 参数编译为PixelConversion::Enhancement后共享给所有工作线程，
+     *          之后渲染的背景瓦片在投递前就地锐化并查表；参数不改变图像时不增强。
+     *          设置与背景图像无关，切换图像后保持
+     * @param   sharpness 反锐化掩模强度，-1到2，负值为平滑
+     * @param   gamma 伽马指数
+     * @param   brightness 亮度偏移
+     * @param   contrast 对比度
+     * @note    只能在GUI线程中调用，调用后背景渲染代加一；
+     *          已显示的瓦片需要调用TileManager::updateTileBackgrounds(true)从内存缓存重新处理
+     * @see     PixelConversion::buildEnhancement, getBackgroundGeneration
+     */
+    void setEnhancement(float sharpness, float gamma, float brightness, float contrast);
+
+    /**
+     * @brief   设置显示的Z平面
+     * @details 之后加入的IO任务和背景重新合成任务读取该平面，背景渲染代加一；
+     *          已排队的IO任务执行时改为读取新平面，已显示的瓦片需要调用TileManager::updateTileBackgrounds重新读取
+     * @param   zPlane Z平面索引
+     * @note    只能在GUI线程中调用
+     * @see     MultiResolutionImage::getNumberOfZPlanes
+     */
+    void setZPlane(unsigned int zPlane);
+
+    /** @brief 获取显示的Z平面 */
+    unsigned int getZPlane() const { return _zPlane; }
 
     /**
      * @brief   设置背景图像
@@ -233,23 +501,105 @@ public:
     void setForegroundImage(std::weak_ptr<MultiResolutionImage> for_img, float scale = 1.);
 
     /**
-     * @brief   从队列中获取一个任务
-     * @details 从任务队列中取出一个待处理的任务，如果队列为空则阻塞等待
+     * @brief   为工作线程取出一个任务
+     * @details 优先从工作线程对应的队列取任务，该队列为空时依次从其他队列窃取，不阻塞。
+     *          取出的任务计入活动任务数，工作线程执行完成后调用jobFinished
      *
-     * @return  任务对象指针，如果线程被中止则返回NULL
-     * @note    该函数是线程安全的，支持多线程并发调用
-     * @see     addJob, clearJobs
+     * @param   queueIndex 工作线程的队列索引
+     * @param   includeDeferred 是否取后台任务，为false时只取显示任务
+     * @return  任务对象指针，没有符合条件的任务时返回NULL
+     * @note    由IOWorkerPool调用，该函数是线程安全的
+     * @see     IOWorkerPool::getJob, jobFinished
+     */
+    ThreadJob* takeJob(unsigned int queueIndex, bool includeDeferred);
+
+    /**
+     * @brief   任务执行完成
+     * @details 工作线程通过deliverTile提交任务的结果之后调用
+     * @see     takeJob, isIdle
+     */
+    void jobFinished();
+
+    /**
+     * @brief   是否空闲
+     * @details 队列为空且没有工作线程正在执行该对象的任务。
+     *          其他视图的任务不影响结果，等待本视图的任务完成时应使用该函数而非getWaitingThreads
+     * @return  是否空闲
+     */
+    bool isIdle() const;
+
+    /**
+     * @brief   提交一个瓦片结果
+     * @details 由工作线程调用，结果写入无锁完成队列；尚未安排批量处理时向GUI线程投递一次，
+     *          之后到达的结果并入同一批，避免每个瓦片一个队列事件。
+     *          完成队列满时等待GUI线程取出，对象关闭后结果直接丢弃
+     * @param   delivery 结果，内容被移走
+     * @note    该函数是线程安全的，不加锁，GUI线程取出结果时不会阻塞工作线程
+     * @see     flushTileDeliveries
+     */
+    void deliverTile(TileDelivery& delivery);
+
+    /**
+     * @brief   是否有尚未发出信号的瓦片结果
+     * @details isIdle为true后结果可能仍在投递队列中，等待瓦片显示时应同时检查该函数
+     */
+    bool hasPendingDeliveries() const;
+
+    /**
+     * @brief   立即发出所有待投递的瓦片结果
+     * @details 在GUI线程中调用，不受每帧时间预算限制，用于清空瓦片前收拢已完成的结果
+     */
+    void flushTileDeliveries();
+
+    /**
+     * @brief   调整队列数量
+     * @details 由IOWorkerPool在注册和线程数改变时调用
+     * @param   nrQueues 队列数量，与工作线程数一致
+     */
+    void resizeQueues(unsigned int nrQueues);
+
+    /**
+     * @brief   获取当前设置快照
+     * @details 工作线程在每个任务开始时取得一次并在整个任务中使用
+     * @return  设置快照
+     * @note    该函数是线程安全的
      */
-    ThreadJob* getJob();
+    std::shared_ptr<const IOWorkerSettings> getSettings() const;
 
     /**
      * @brief   清空任务队列
      * @details 清空所有待处理的任务，释放任务对象的内存
      * @note    该函数是线程安全的，会等待所有任务处理完成
-     * @see     addJob, getJob
+     * @see     addJob, takeJob
      */
     void clearJobs();
 
+    /**
+     * @brief   更新调度所用的当前视野
+     * @details 记录新的视野中心并按其重新排序队列；与新视野不相交的IO任务视为过期，
+     *          直接从队列中移除并发送空的tileLoaded信号，以便TileManager重置覆盖状态。
+     *          排序规则为粗层级优先，同层级按瓦片中心到视野中心的距离由近及远。
+     *
+     * @param   FOV 视野范围（第0层像素坐标）
+     * @param   persistentLevel 不被剔除的最低层级，该层级及更粗层级的任务始终保留
+     * @note    渲染任务（RenderJob）不会被剔除，只参与重新排序
+     * @see     addJob, clearJobs
+     */
+    void setFieldOfView(const QRectF& FOV, unsigned int persistentLevel);
+
+    /**
+     * @brief   检查正在执行的IO任务是否已过期
+     * @details 与setFieldOfView剔除排队任务的规则相同：层级低于persistentLevel且瓦片（合并IO任务为整块）与当前视野不相交。
+     *          工作线程在任务的各执行阶段之间调用，过期的任务放弃剩余阶段
+     *
+     * @param   job 任务
+     * @param   levelDownsample 任务层级的降采样比例
+     * @return  任务已过期时返回true，尚未设置视野时返回false
+     * @note    该函数是线程安全的
+     * @see     IOWorker::executeIOJob
+     */
+    bool isJobStale(const ThreadJob* job, double levelDownsample) const;
+
     /**
      * @brief   获取队列中的任务数量
      * @details 返回当前任务队列中待处理任务的数量
@@ -261,13 +611,32 @@ public:
     unsigned int numberOfJobs();
 
     /**
-     * @brief   关闭所有工作线程
-     * @details 停止所有工作线程，清空任务队列，释放相关资源
-     * @note    该函数会等待所有线程正确停止后再返回
+     * @brief   关闭IO线程管理器
+     * @details 清空任务队列并从线程池注销，之后投放的任务直接丢弃
+     * @note    该函数会等待正在执行的本对象的任务完成后再返回，其他视图的任务不受影响
      * @see     ~IOThread
      */
     void shutdown();
 
+    /**
+     * @brief   调整工作线程数量
+     * @details 转发给全局IOWorkerPool，对所有视图生效；
+     *          减少时停止多余的工作线程，并把其队列中的任务转移到剩余队列
+     *
+     * @param   nrThreads 新的工作线程数量，0表示使用defaultNumberOfThreads()
+     * @note    只能在GUI线程中调用
+     * @see     defaultNumberOfThreads, IOWorkerPool::setNumberOfThreads
+     */
+    void setNumberOfThreads(unsigned int nrThreads);
+
+    /**
+     * @brief   获取默认工作线程数量
+     * @details 根据std::thread::hardware_concurrency()确定，为GUI线程保留一个核心，最少2个
+     *
+     * @return  默认工作线程数量
+     */
+    static unsigned int defaultNumberOfThreads();
+
     /**
      * @brief   获取所有工作线程
      * @details 返回所有工作线程的指针数组
@@ -288,6 +657,114 @@ public:
      */
     unsigned int getWaitingThreads();
 
+    /**
+     * @brief   获取当前前景渲染代
+     * @details 前景图像、前景通道或LUT每次改变时加一。渲染任务在入队时记录当前代，
+     *          工作线程跳过过期的渲染任务，并在渲染结果中附带所用设置的代，
+     *          TileManager据此丢弃过期结果，无需等待工作线程空闲
+     *
+     * @return  当前代
+     * @note    该函数是线程安全的
+     * @see     TileManager::updateTileForegounds
+     */
+    unsigned int getRenderGeneration() const;
+
+    /**
+     * @brief   获取当前背景渲染代
+     * @details 背景通道、通道合成设置、增强设置或Z平面每次改变时加一，用法与前景渲染代相同
+     * @return  当前代
+     * @note    该函数是线程安全的
+     * @see     TileManager::updateTileBackgrounds
+     */
+    unsigned int getBackgroundGeneration() const;
+
+    /** @brief 获取前景图像 */
+    std::weak_ptr<MultiResolutionImage> getForegroundImage() const { return _for_img; }
+
+    /** @brief 获取前景图像缩放因子 */
+    float getForegroundImageScale() const { return _foregroundImageScale; }
+
+    /** @brief 获取背景通道 */
+    int getBackgroundChannel() const { return _backgroundChannel; }
+
+    /** @brief 获取前景通道 */
+    int getForegroundChannel() const { return _foregroundChannel; }
+
+    /** @brief 获取颜色查找表 */
+    const SlideColorManagement::LUT& getLUT() const { return _LUT; }
+
+    /**
+     * @brief   获取前景瓦片缓存
+     * @details 缓存在所有工作线程之间共享，与场景中的瓦片无关，
+     *          切换前景图像、重新加载背景或清空瓦片后再次加载的前景瓦片直接从中取得
+     * @return  前景瓦片缓存
+     */
+    std::shared_ptr<OverlayTileCache> getOverlayCache() const { return _overlayCache; }
+
+    /** @brief 获取编译后的通道合成设置，为空表示不合成 */
+    std::shared_ptr<const std::vector<PixelConversion::CompositeChannel> > getChannelComposite() const { return _channelComposite; }
+
+    /** @brief 获取编译后的背景瓦片增强设置，为空表示不增强 */
+    std::shared_ptr<const PixelConversion::Enhancement> getEnhancement() const { return _enhancement; }
+
+    /** @brief 获取背景图像ICC配置文件编译成的查找表，为空表示不做颜色转换 */
+    std::shared_ptr<const PixelConversion::ColorLUT3D> getColorTransform() const { return _colorTransform; }
+
+signals:
+    /**
+     * @brief   瓦片加载完成信号
+     * @details 工作线程提交的结果由投递队列按帧批量发出，也在任务被剔除或清空时以空瓦片发出
+     *
+     * @param   tile 加载完成的瓦片像素图，NULL表示加载失败或任务被取消
+     * @param   tileX 瓦片X坐标
+     * @param   tileY 瓦片Y坐标
+     * @param   tileSize 瓦片大小
+     * @param   tileByteSize 瓦片字节大小
+     * @param   tileLevel 瓦片层级
+     * @param   foregroundTile 前景瓦片图像源指针，默认为NULL
+     * @param   foregroundPixmap 前景瓦片像素图，默认为NULL
+     * @param   renderGeneration 渲染foregroundPixmap所用设置的渲染代
+     * @param   backgroundGeneration 渲染tile所用设置的背景渲染代
+     * @note    所有结果信号都在GUI线程中发出，像素图在GUI线程中由QImage创建
+     * @see     foregroundTileRendered
+     */
+    void tileLoaded(QPixmap* tile, unsigned int tileX, unsigned int tileY, unsigned int tileSize, unsigned int tileByteSize, unsigned int tileLevel, ImageSource* foregroundTile = NULL, QPixmap* foregroundPixmap = NULL, unsigned int renderGeneration = 0, unsigned int backgroundGeneration = 0);
+
+    /**
+     * @brief   前景瓦片渲染完成信号
+     * @param   tile 渲染完成的前景瓦片像素图
+     * @param   tileX 瓦片X坐标
+     * @param   tileY 瓦片Y坐标
+     * @param   tileLevel 瓦片层级
+     * @param   renderGeneration 渲染所用设置的渲染代
+     * @see     tileLoaded
+     */
+    void foregroundTileRendered(QPixmap* tile, unsigned int tileX, unsigned int tileY, unsigned int tileLevel, unsigned int renderGeneration);
+
+    /**
+     * @brief   背景瓦片重新合成完成信号
+     * @param   tile 重新渲染的背景瓦片像素图
+     * @param   tileX 瓦片X坐标
+     * @param   tileY 瓦片Y坐标
+     * @param   tileLevel 瓦片层级
+     * @param   backgroundGeneration 渲染所用设置的背景渲染代
+     * @see     tileLoaded
+     */
+    void backgroundTileRendered(QPixmap* tile, unsigned int tileX, unsigned int tileY, unsigned int tileLevel, unsigned int backgroundGeneration);
+
+    /**
+     * @brief   瓦片预览加载完成信号
+     * @details 带预览标记的IO任务在完整解码之前发出，之后同一瓦片的tileLoaded总会到达（可能为空瓦片）；
+     *          没有连接接收者时不应为任务设置预览标记，否则像素图无人释放
+     * @param   tile 预览像素图，边长为tileSize / kPreviewScale，所有权转移给接收者
+     * @param   tileX 瓦片X坐标
+     * @param   tileY 瓦片Y坐标
+     * @param   tileSize 完整瓦片的大小
+     * @param   tileLevel 瓦片层级
+     * @see     tileLoaded, IOJob::_preview
+     */
+    void tilePreviewLoaded(QPixmap* tile, unsigned int tileX, unsigned int tileY, unsigned int tileSize, unsigned int tileLevel);
+
 public slots:
     /**
      * @brief   背景通道改变槽函数
@@ -319,15 +796,107 @@ public slots:
      */
     void onLUTChanged(const SlideColorManagement::LUT& LUTname);
 
+private slots:
+    /**
+     * @brief   按帧批量投递瓦片结果
+     * @details 距上一批不足kDeliveryInterval时推迟到下一帧；每批最多占用kDeliveryBudget毫秒，
+     *          剩余结果留到下一帧，使输入事件在大量加载期间也能及时处理
+     */
+    void processTileDeliveries();
+
 private:
-    /** @brief 线程中止标志，true表示需要停止所有线程 */
-    bool _abort;
+    /**
+     * @brief   在GUI线程中把一个结果转换为QPixmap并发出对应信号
+     * @param   delivery 结果
+     */
+    void dispatchTileDelivery(TileDelivery& delivery);
+
+    /** @brief 两批瓦片结果之间的最小间隔（毫秒），约一帧 */
+    static const int kDeliveryInterval = 16;
+
+    /** @brief 每批瓦片结果最多占用的GUI线程时间（毫秒） */
+    static const int kDeliveryBudget = 8;
+
+    /** @brief 完成队列容量，远大于每帧的结果数，满时工作线程等待 */
+    static const size_t kDeliveryCapacity = 1024;
+
+    /**
+     * @brief   计算任务的调度优先级
+     * @details 以第0层像素坐标计算瓦片中心到当前视野中心的距离
+     *
+     * @param   job 待计算的任务
+     * @param   fovCenter 调用者在_fieldOfViewMutex内取得的视野中心
+     * @note    工作线程重新投放任务时也会调用，视野中心由调用者复制后传入
+     */
+    void updateJobPriority(ThreadJob* job, const QPointF& fovCenter) const;
+
+    /**
+     * @brief   为未执行的IO任务逐个瓦片发出空的tileLoaded信号
+     * @param   job IO任务或合并IO任务
+     * @note    只在GUI线程中调用，调用时不持有队列锁
+     */
+    void emitCancelledTiles(const ThreadJob* job);
+
+    /**
+     * @brief   将任务按优先级插入队列
+     * @param   jobs 目标任务队列
+     * @param   job 待插入的任务
+     * @note    调用者需持有目标队列的互斥锁
+     */
+    void insertJob(std::list<ThreadJob*>& jobs, ThreadJob* job);
+
+    /**
+     * @brief   发布新的设置快照
+     * @details 复制当前快照，由modifier修改后原子替换
+     *
+     * @param   modifier 修改快照副本的函数
+     * @note    设置函数只在GUI线程调用，因此读-改-写之间无需CAS重试
+     */
+    template<typename Modifier>
+    void updateSettings(Modifier modifier);
+
+    /**
+     * @brief   进入新的前景渲染代
+     * @details 在快照中的前景设置更新之后调用，保证新代的快照带有新设置
+     */
+    void advanceRenderGeneration();
+
+    /**
+     * @brief   进入新的背景渲染代
+     * @details 在快照中的背景设置更新之后调用
+     */
+    void advanceBackgroundGeneration();
+
+    /**
+     * @brief   进入新的叠加层外观代
+     * @details 前景通道或LUT改变后调用，使前景瓦片缓存中的渲染结果失效，源数据仍然保留
+     */
+    void advanceOverlayGeneration();
+
+    /**
+     * @brief   将任务投放到工作线程队列
+     * @details 按当前视野计算优先级后轮询投放并唤醒一个等待的工作线程
+     * @param   job 待投放的任务，所有权转移给队列
+     */
+    void enqueueJob(ThreadJob* job);
 
-    /** @brief 保护任务队列的互斥锁 */
-    QMutex _jobListMutex;
+    /**
+     * @struct  WorkerQueue
+     * @brief   单个工作线程的任务队列
+     */
+    struct WorkerQueue {
+        /** @brief 保护该队列的互斥锁 */
+        QMutex mutex;
 
-    /** @brief 线程同步条件变量，用于线程间的等待和通知 */
-    QWaitCondition _condition;
+        /** @brief 按优先级有序存储的任务，队首优先处理 */
+        std::list<ThreadJob*> jobs;
+    };
+
+    /** @brief 关闭标志，true表示不再接受新任务 */
+    std::atomic<bool> _abort;
+
+    /** @brief 保护队列数组结构的读写锁，调整线程数时加写锁 */
+    QReadWriteLock _queuesLock;
 
     /** @brief 背景图像的弱引用指针 */
     std::weak_ptr<MultiResolutionImage> _bck_img;
@@ -335,12 +904,78 @@ private:
     /** @brief 前景图像的弱引用指针 */
     std::weak_ptr<MultiResolutionImage> _for_img;
 
-    /** @brief 任务队列，存储待处理的线程任务 */
-    std::list<ThreadJob*> _jobList;
+    /** @brief 每个工作线程一个任务队列，索引与IOWorker::getQueueIndex一致 */
+    std::vector<std::unique_ptr<WorkerQueue> > _queues;
+
+    /** @brief 所有队列中的任务总数 */
+    std::atomic<unsigned int> _nrJobs;
+
+    /** @brief 下一个新任务投放的队列索引，轮询分配 */
+    unsigned int _nextQueue;
+
+    /** @brief 背景通道 */
+    int _backgroundChannel;
+
+    /** @brief 前景通道 */
+    int _foregroundChannel;
+
+    /** @brief 前景图像缩放因子 */
+    float _foregroundImageScale;
+
+    /** @brief 颜色查找表 */
+    SlideColorManagement::LUT _LUT;
+
+    /** @brief 编译后的通道合成设置，为空表示不合成 */
+    std::shared_ptr<const std::vector<PixelConversion::CompositeChannel> > _channelComposite;
+
+    /** @brief 编译后的背景瓦片增强设置，为空表示不增强 */
+    std::shared_ptr<const PixelConversion::Enhancement> _enhancement;
+
+    /** @brief 背景图像ICC配置文件编译成的到sRGB的查找表，为空表示不转换 */
+    std::shared_ptr<const PixelConversion::ColorLUT3D> _colorTransform;
+
+    /** @brief 背景图像各层级的降采样比例，用于将瓦片坐标换算到第0层像素坐标 */
+    std::vector<float> _levelDownsamples;
+
+    /** @brief 当前视野中心（第0层像素坐标），由_fieldOfViewMutex保护 */
+    QPointF _fovCenter;
+
+    /** @brief 保护_fovCenter、_fieldOfView和_persistentLevel，供工作线程计算优先级和判断执行中的任务是否过期 */
+    mutable QMutex _fieldOfViewMutex;
+
+    /** @brief 当前视野（第0层像素坐标），为空表示尚未设置 */
+    QRectF _fieldOfView;
+
+    /** @brief 不被剔除的最低层级 */
+    unsigned int _persistentLevel;
+
+    /** @brief 已取出但尚未执行完成的任务数 */
+    std::atomic<unsigned int> _activeJobs;
+
+    /** @brief 工作线程使用的设置快照，通过std::atomic_load/std::atomic_store访问 */
+    std::shared_ptr<const IOWorkerSettings> _settings;
+
+    /** @brief 当前前景渲染代 */
+    std::atomic<unsigned int> _renderGeneration;
+
+    /** @brief 当前背景渲染代 */
+    std::atomic<unsigned int> _backgroundGeneration;
+
+    /** @brief 前景瓦片缓存，保存在设置快照中供工作线程使用 */
+    std::shared_ptr<OverlayTileCache> _overlayCache;
+
+    /** @brief 当前叠加层外观代，只在GUI线程中修改 */
+    unsigned int _overlayGeneration;
+
+    /** @brief 显示的Z平面，只在GUI线程中修改 */
+    unsigned int _zPlane;
+
+    /** @brief 等待GUI线程发出信号的瓦片结果，工作线程写入，只在GUI线程中取出 */
+    CompletionRing<TileDelivery> _deliveries;
 
-    /** @brief 工作线程数组，存储所有IOWorker线程指针 */
-    std::vector<IOWorker*> _workers;
+    /** @brief 是否已安排批量投递 */
+    std::atomic<bool> _deliveryScheduled;
 
-    /** @brief 等待中的线程数量计数器 */
-    unsigned int _threadsWaiting;
+    /** @brief 上一批投递的时间，只在GUI线程中访问 */
+    QElapsedTimer _lastDelivery;
 };
\ No newline at end of file
@@ -15,21 +15,33 @@
 #include "ImageSource.h"
 #include "MultiResolutionImage.h"
 #include "IOThread.h"
+#include "IOWorkerPool.h"
+#include "TileTask.h"
 #include "UtilityFunctions.h"
+#include "PixelConversion.h"
 #include "SlideColorManagement.h"
+#include "PipelineProfiler.h"
+#include "PipelineTrace.h"
+#include "SlideStatistics.h"
+#include "TileBufferPool.h"
+#include "TissueMask.h"
+#include "OverlayTileCache.h"
+#include <cmath>
+#include <cstring>
 
 /**
  * @brief 构造函数：初始化IO工作线程
- * @param thread 父IO线程对象
- * @details 初始化工作线程的成员变量，包括通道设置、图像引用等
+ * @param pool 全局线程池
+ * @param queueIndex 任务队列索引
+ * @details 渲染设置不保存在工作线程中，每个任务使用所属IOThread的设置快照
  */
-IOWorker::IOWorker(IOThread* thread) :
-    QThread(thread),
+IOWorker::IOWorker(IOWorkerPool* pool, unsigned int queueIndex) :
+    QThread(pool),
+    _pool(pool),
+    _client(NULL),
     _abort(false),
-    _backgroundChannel(0),
-    _foregroundChannel(0),
-    _foregroundImageScale(1.),
-    _LUT()
+    _queueIndex(queueIndex),
+    _foregroundTableOwner(NULL)
 {
 }
 
@@ -50,161 +62,514 @@ void IOWorker::abort() {
     _abort = true;
 }
 
-/**
- * @brief 设置背景通道
- * @param channel 通道索引
- * @details 线程安全地设置背景图像的显示通道
- */
-void IOWorker::setBackgroundChannel(int channel) {
-    mutex.lock();
-    _backgroundChannel = channel;
-    mutex.unlock();
-}
-
-/**
- * @brief 设置前景通道
- * @param channel 通道索引
- * @details 线程安全地设置前景图像的显示通道
- */
-void IOWorker::setForegroundChannel(int channel) {
-    mutex.lock();
-    _foregroundChannel = channel;
-    mutex.unlock();
-}
-
-/**
- * @brief 设置颜色查找表
- * @param LUT 颜色查找表
- * @details 线程安全地设置用于前景图像渲染的颜色查找表
- */
-void IOWorker::setLUT(const SlideColorManagement::LUT& LUT) {
-    mutex.lock();
-    _LUT = LUT;
-    mutex.unlock();
-}
-
-/**
- * @brief 设置背景图像
- * @param bck_img 背景图像弱指针
- * @details 线程安全地设置背景图像引用
- */
-void IOWorker::setBackgroundImage(std::weak_ptr<MultiResolutionImage> bck_img) {
-    mutex.lock();
-    _bck_img = bck_img;
-    mutex.unlock();
-}
-
-/**
- * @brief 设置前景图像
- * @param for_img 前景图像弱指针
- * @param scale 缩放比例
- * @details 线程安全地设置前景图像引用和缩放比例
- */
-void IOWorker::setForegroundImage(std::weak_ptr<MultiResolutionImage> for_img, float scale) {
-    mutex.lock();
-    _for_img = for_img;
-    _foregroundImageScale = scale;
-    mutex.unlock();
-}
-
 /**
  * @brief 工作线程主循环
- * @details 持续从任务队列获取任务并执行，支持IOJob和RenderJob两种任务类型
+ * @details 持续从线程池获取任务并执行，支持IOJob、RenderJob、BackgroundRenderJob和TileTaskJob。
+ *          每个任务开始时取得一次所属IOThread的设置快照，执行期间不持有任何锁；
+ *          调用jobFinished之后不再访问该IOThread。统计打开时记录任务的排队时间和执行时间
  */
 void IOWorker::run()
 {
     forever{
-      ThreadJob * newJob = dynamic_cast<IOThread*>(parent())->getJob();
+      IOThread* client = NULL;
+      ThreadJob * newJob = _pool->getJob(this, client);
+      if (!newJob) {
+        return;
+      }
+      _client = client;
       if (_abort) {
+        // 线程被回收时已取出的任务不再执行，通知TileManager重置覆盖状态
+        if (BatchIOJob* job = dynamic_cast<BatchIOJob*>(newJob)) {
+          for (unsigned int r = 0; r < job->_rows; ++r) {
+            for (unsigned int c = 0; c < job->_columns; ++c) {
+              TileDelivery delivery(TileDelivery::TileLoaded, job->_imgPosX + c, job->_imgPosY + r, job->_level);
+              delivery._tileSize = job->_tileSize;
+              client->deliverTile(delivery);
+            }
+          }
+        }
+        else if (dynamic_cast<IOJob*>(newJob)) {
+          TileDelivery delivery(TileDelivery::TileLoaded, newJob->_imgPosX, newJob->_imgPosY, newJob->_level);
+          delivery._tileSize = newJob->_tileSize;
+          client->deliverTile(delivery);
+        }
+        else if (TileTaskJob* job = dynamic_cast<TileTaskJob*>(newJob)) {
+          // 把执行槽交还给其余工作线程，否则瓦片任务少了一路并行，最后一路时永远不会结束
+          client->addTileTask(job->_task, 1);
+        }
+        delete newJob;
+        _client = NULL;
+        client->jobFinished();
         return;
       }
 
-      mutex.lock();
-      if (IOJob* job = dynamic_cast<IOJob*>(newJob)) {
-        executeIOJob(job);
+      if (newJob->_enqueueTime != 0) {
+        const long long now = PipelineProfiler::timestamp();
+        if (now != 0) {
+          PipelineProfiler::record(PipelineProfiler::JobQueueWait, now - newJob->_enqueueTime);
+        }
+      }
+      PipelineProfiler::ScopedTimer timer(PipelineProfiler::JobExecute);
+      std::shared_ptr<const IOWorkerSettings> settings = client->getSettings();
+      if (BatchIOJob* job = dynamic_cast<BatchIOJob*>(newJob)) {
+        job->_zPlane = settings->_zPlane;
+        executeBatchIOJob(job, *settings);
+      }
+      else if (IOJob* job = dynamic_cast<IOJob*>(newJob)) {
+        // 显示已切换到其他Z平面时按当前平面读取，结果与快照中的背景渲染代一致
+        job->_zPlane = settings->_zPlane;
+        executeIOJob(job, *settings);
       }
       else if (RenderJob* job = dynamic_cast<RenderJob*>(newJob)) {
-        executeRenderJob(job);
+        // 前景设置已再次改变的渲染任务直接丢弃，新一代的任务已经入队
+        if (job->_generation >= settings->_renderGeneration) {
+          executeRenderJob(job, *settings);
+        }
+      }
+      else if (BackgroundRenderJob* job = dynamic_cast<BackgroundRenderJob*>(newJob)) {
+        if (job->_generation >= settings->_backgroundGeneration) {
+          executeBackgroundRenderJob(job, *settings);
+        }
+      }
+      else if (TileTaskJob* job = dynamic_cast<TileTaskJob*>(newJob)) {
+        if (job->_task->processNextTile()) {
+          client->addTileTask(job->_task, 1);
+        }
       }
       delete newJob;
-      mutex.unlock();
+      _client = NULL;
+      client->jobFinished();
+    }
+}
+
+/**
+ * @brief IO任务在阶段之间传递的中间结果
+ */
+struct IOWorker::IOJobState {
+    /** @brief 背景图像，任务开始时锁定，执行期间保持有效 */
+    std::shared_ptr<MultiResolutionImage> background;
+    /** @brief 背景图像的数据类型对应的处理函数，数据类型不支持时为空 */
+    const TypedKernels* kernels;
+    /** @brief 任务层级的降采样比例，用于判断任务是否过期 */
+    double levelDownsample;
+    /** @brief 读取阶段得到的原始样本，为空表示读取阶段已得到最终图像 */
+    std::shared_ptr<void> samples;
+    /** @brief 投递给IOThread的结果 */
+    TileDelivery delivery;
+    /** @brief 前景瓦片的源数据，投递时所有权交给IOThread */
+    ImageSource* foregroundTile;
+
+    explicit IOJobState(const IOJob* job) :
+        kernels(NULL),
+        levelDownsample(1.),
+        delivery(TileDelivery::TileLoaded, job->_imgPosX, job->_imgPosY, job->_level),
+        foregroundTile(NULL)
+    {
     }
+
+    ~IOJobState() {
+        delete foregroundTile;
+    }
+};
+
+namespace {
+    /** @brief 各执行阶段对应的计时阶段和时间线事件名称 */
+    const PipelineProfiler::Stage kJobStageTimers[] = {
+        PipelineProfiler::JobReadStage, PipelineProfiler::JobConvertStage, PipelineProfiler::JobOverlayStage, PipelineProfiler::JobDeliverStage
+    };
+    const char* const kJobStageEvents[] = {
+        "IOWorker::readStage", "IOWorker::convertStage", "IOWorker::overlayStage", "IOWorker::deliverStage"
+    };
+
+    /**
+     * @brief 投递预览的最低读取延迟（每百万像素毫秒）
+     * @details 本地SSD上一个512x512的JPEG瓦片在几毫秒内解码完成，预览只会增加一次解码和一次像素图上传
+     */
+    const double kPreviewReadLatency = 25.;
+
+    /** @brief 背景是否为可以直接读取预乘ARGB32的8位RGB图像 */
+    bool readsARGB32(const MultiResolutionImage& background) {
+        return background.getColorType() == SlideColorManagement::ColorType::RGB &&
+            background.getDataType() == SlideColorManagement::DataType::UChar;
+    }
+}
+
+bool IOWorker::executeIOJob(IOJob* job, const IOWorkerSettings& settings) {
+    PipelineTrace::ScopedEvent event("IOWorker::executeIOJob", job->_imgPosX, job->_imgPosY, job->_level);
+    PipelineTrace::flow(PipelineTrace::FlowStep, job->_imgPosX, job->_imgPosY, job->_level);
+    IOJobState state(job);
+    state.background = settings._bck_img.lock();
+    if (state.background) {
+        state.kernels = typedKernels(state.background->getDataType());
+        state.levelDownsample = state.background->getLevelDownsample(job->_level);
+        if (job->_preview && readsARGB32(*state.background) && !_client->isJobStale(job, state.levelDownsample) &&
+            previewTile(state.background, job, state.delivery._tile, settings)) {
+            return runIOJobStages(job, state, OverlayStage, settings);
+        }
+    }
+    return runIOJobStages(job, state, ReadStage, settings);
 }
 
-bool IOWorker::executeIOJob(IOJob* job) {
-    std::shared_ptr<MultiResolutionImage> local_bck_img = _bck_img.lock();
-    float levelDownsample = local_bck_img->getLevelDownsample(job->_level);
-    ImageSource* foregroundTile = NULL;
-    QPixmap* foregroundPixmap = NULL;
-    if (std::shared_ptr<MultiResolutionImage> local_for_img = _for_img.lock()) {
-        if (local_for_img->getDataType() == SlideColorManagement::DataType::UChar) {
-            foregroundTile = getForegroundTile<unsigned char>(local_for_img, job);
-            foregroundPixmap = renderForegroundImage<unsigned char>(dynamic_cast<Patch<unsigned char>*>(foregroundTile), job->_tileSize);
+bool IOWorker::previewTile(const std::shared_ptr<MultiResolutionImage>& background, const IOJob* job, QImage& tile, const IOWorkerSettings& settings) {
+    const double levelDownsample = background->getLevelDownsample(job->_level);
+    const long long startX = std::llround(job->_imgPosX * levelDownsample * job->_tileSize);
+    const long long startY = std::llround(job->_imgPosY * levelDownsample * job->_tileSize);
+    if (std::shared_ptr<const TissueMask> tissueMask = background->getTissueMask()) {
+        const double tileExtent = levelDownsample * job->_tileSize;
+        if (!tissueMask->containsTissue(startX, startY, tileExtent, tileExtent)) {
+            return false;
         }
-        else if (local_for_img->getDataType() == SlideColorManagement::DataType::UInt16) {
-            foregroundTile = getForegroundTile<unsigned short>(local_for_img, job);
-            foregroundPixmap = renderForegroundImage<unsigned short>(dynamic_cast<Patch<unsigned short>*>(foregroundTile), job->_tileSize);
+    }
+    QImage cached(job->_tileSize, job->_tileSize, QImage::Format_ARGB32_Premultiplied);
+    if (background->getCachedARGB32Region(startX, startY, job->_tileSize, job->_tileSize, job->_level,
+        reinterpret_cast<unsigned int*>(cached.bits()), job->_zPlane)) {
+        QImage solidTile = solidTileFromImage(cached);
+        tile = solidTile.isNull() ? cached : solidTile;
+        return true;
+    }
+    const double latency = background->getReadLatency();
+    if ((latency > 0. && latency < kPreviewReadLatency) || job->_tileSize < IOThread::kPreviewScale) {
+        return false;
+    }
+    PipelineTrace::ScopedEvent event("IOWorker::previewTile", job->_imgPosX, job->_imgPosY, job->_level);
+    const unsigned int previewSize = job->_tileSize / IOThread::kPreviewScale;
+    QImage preview(previewSize, previewSize, QImage::Format_ARGB32_Premultiplied);
+    if (!background->getPreviewARGB32Region(startX, startY, previewSize * IOThread::kPreviewScale, previewSize * IOThread::kPreviewScale, job->_level,
+        IOThread::kPreviewScale, reinterpret_cast<unsigned int*>(preview.bits()), job->_zPlane)) {
+        return false;
+    }
+    TileDelivery delivery(TileDelivery::PreviewLoaded, job->_imgPosX, job->_imgPosY, job->_level);
+    delivery._tile = postProcessTile(preview, settings);
+    delivery._hasTile = !delivery._tile.isNull();
+    delivery._tileSize = job->_tileSize;
+    delivery._backgroundGeneration = settings._backgroundGeneration;
+    _client->deliverTile(delivery);
+    return false;
+}
+
+bool IOWorker::runIOJobStages(IOJob* job, IOJobState& state, JobStage firstStage, const IOWorkerSettings& settings) {
+    long long backgroundTime = 0;
+    for (int stage = firstStage; stage < NumberOfJobStages; ++stage) {
+        if (_abort || _client->isJobStale(job, state.levelDownsample)) {
+            // 瓦片已离开视野，放弃剩余阶段；空结果使TileManager重置覆盖状态，与排队任务被剔除时相同
+            PipelineProfiler::count(PipelineProfiler::JobCancelled);
+            PipelineTrace::instant("IOWorker::jobCancelled", job->_imgPosX, job->_imgPosY, job->_level);
+            TileDelivery cancelled(TileDelivery::TileLoaded, job->_imgPosX, job->_imgPosY, job->_level);
+            cancelled._tileSize = job->_tileSize;
+            _client->deliverTile(cancelled);
+            return false;
         }
-        else if (local_for_img->getDataType() == SlideColorManagement::DataType::UInt32) {
-            foregroundTile = getForegroundTile<unsigned int>(local_for_img, job);
-            foregroundPixmap = renderForegroundImage<unsigned int>(dynamic_cast<Patch<unsigned int>*>(foregroundTile), job->_tileSize);
+        PipelineTrace::ScopedEvent stageEvent(kJobStageEvents[stage], job->_imgPosX, job->_imgPosY, job->_level);
+        const long long stageStart = PipelineProfiler::timestamp();
+        const bool proceed = runIOJobStage(static_cast<JobStage>(stage), job, state, settings);
+        if (stageStart != 0) {
+            const long long elapsed = PipelineProfiler::timestamp() - stageStart;
+            PipelineProfiler::record(kJobStageTimers[stage], elapsed);
+            if (stage == ReadStage || stage == ConvertStage) {
+                backgroundTime += elapsed;
+            }
+            if (stage == ConvertStage) {
+                PipelineProfiler::record(PipelineProfiler::RenderBackgroundImage, backgroundTime);
+            }
         }
-        else if (local_for_img->getDataType() == SlideColorManagement::DataType::Float) {
-            foregroundTile = getForegroundTile<float>(local_for_img, job);
-            foregroundPixmap = renderForegroundImage<float>(dynamic_cast<Patch<float>*>(foregroundTile), job->_tileSize);
+        if (!proceed) {
+            return false;
         }
     }
+    return true;
+}
 
-    if (local_bck_img) {
-        QPixmap* backgroundTile = NULL;
-        SlideColorManagement::ColorType cType = local_bck_img->getColorType();
-        if (local_bck_img->getDataType() == SlideColorManagement::DataType::UChar) {
-            backgroundTile = renderBackgroundImage<unsigned char>(local_bck_img, job, cType);
+bool IOWorker::executeBatchIOJob(BatchIOJob* job, const IOWorkerSettings& settings) {
+    PipelineTrace::ScopedEvent event("IOWorker::executeBatchIOJob", job->_imgPosX, job->_imgPosY, job->_level);
+    std::vector<IOJob> tileJobs;
+    tileJobs.reserve(static_cast<size_t>(job->_columns) * job->_rows);
+    for (unsigned int r = 0; r < job->_rows; ++r) {
+        for (unsigned int c = 0; c < job->_columns; ++c) {
+            tileJobs.emplace_back(job->_tileSize, job->_imgPosX + c, job->_imgPosY + r, job->_level);
+            tileJobs.back()._zPlane = job->_zPlane;
+            tileJobs.back()._preview = job->_preview;
         }
-        else if (local_bck_img->getDataType() == SlideColorManagement::DataType::Float) {
-            backgroundTile = renderBackgroundImage<float>(local_bck_img, job, cType);
+    }
+    std::shared_ptr<MultiResolutionImage> background = settings._bck_img.lock();
+    const bool direct = background && readsARGB32(*background);
+    if (!direct) {
+        // 只有预乘ARGB32直读可以合并，其余格式逐个瓦片执行完整的IO任务
+        for (IOJob& tileJob : tileJobs) {
+            executeIOJob(&tileJob, settings);
+        }
+        return true;
+    }
+
+    // 读取阶段：过期和组织掩膜判定为背景的瓦片不参与合并读取
+    const double levelDownsample = background->getLevelDownsample(job->_level);
+    const double tileExtent = levelDownsample * job->_tileSize;
+    std::shared_ptr<const TissueMask> tissueMask = background->getTissueMask();
+    std::vector<QImage> images(tileJobs.size());
+    std::vector<unsigned int*> buffers(tileJobs.size(), NULL);
+    std::vector<char> skipped(tileJobs.size(), 0);
+    const long long readStart = PipelineProfiler::timestamp();
+    for (size_t i = 0; i < tileJobs.size(); ++i) {
+        const IOJob& tileJob = tileJobs[i];
+        if (_abort || _client->isJobStale(&tileJob, levelDownsample)) {
+            skipped[i] = 1;
+            continue;
         }
-        else if (local_bck_img->getDataType() == SlideColorManagement::DataType::UInt16) {
-            backgroundTile = renderBackgroundImage<unsigned short>(local_bck_img, job, cType);
+        if (tissueMask && !tissueMask->containsTissue(std::llround(tileJob._imgPosX * tileExtent), std::llround(tileJob._imgPosY * tileExtent),
+            tileExtent, tileExtent)) {
+            PipelineProfiler::count(PipelineProfiler::BackgroundTileSynthesized);
+            unsigned char bgR, bgG, bgB;
+            background->getBackgroundColor(bgR, bgG, bgB);
+            images[i] = createSolidTile(QColor(bgR, bgG, bgB));
+            continue;
         }
-        else if (local_bck_img->getDataType() == SlideColorManagement::DataType::UInt32) {
-            backgroundTile = renderBackgroundImage<unsigned int>(local_bck_img, job, cType);
+        if (job->_preview && previewTile(background, &tileJob, images[i], settings)) {
+            // 完整瓦片已在内存缓存中，不参与合并读取
+            continue;
         }
-        emit tileLoaded(backgroundTile, job->_imgPosX, job->_imgPosY, job->_tileSize, job->_tileSize * job->_tileSize * local_bck_img->getSamplesPerPixel(), job->_level, foregroundTile, foregroundPixmap);
+        images[i] = QImage(job->_tileSize, job->_tileSize, QImage::Format_ARGB32_Premultiplied);
+        buffers[i] = reinterpret_cast<unsigned int*>(images[i].bits());
+    }
+    bool read = false;
+    {
+        PipelineTrace::ScopedEvent readEvent("IOWorker::readStage", job->_imgPosX, job->_imgPosY, job->_level);
+        read = background->getARGB32Tiles(job->_imgPosX, job->_imgPosY, job->_tileSize, job->_columns, job->_rows, job->_level, buffers, job->_zPlane);
+    }
+    if (readStart != 0) {
+        const long long elapsed = PipelineProfiler::timestamp() - readStart;
+        PipelineProfiler::record(PipelineProfiler::JobReadStage, elapsed);
+        PipelineProfiler::record(PipelineProfiler::RenderBackgroundImage, elapsed);
+    }
+
+    // 拆分为逐个瓦片的结果，前景和投递阶段与单独的IO任务相同
+    for (size_t i = 0; i < tileJobs.size(); ++i) {
+        IOJob& tileJob = tileJobs[i];
+        if (!read || skipped[i]) {
+            // 读取时已过期的瓦片按单独的任务处理：仍然过期时在第一个阶段之前放弃
+            executeIOJob(&tileJob, settings);
+            continue;
+        }
+        PipelineTrace::flow(PipelineTrace::FlowStep, tileJob._imgPosX, tileJob._imgPosY, tileJob._level);
+        IOJobState state(&tileJob);
+        state.background = background;
+        state.kernels = typedKernels(background->getDataType());
+        state.levelDownsample = levelDownsample;
+        QImage solidTile = buffers[i] ? solidTileFromImage(images[i]) : QImage();
+        state.delivery._tile = solidTile.isNull() ? images[i] : solidTile;
+        images[i] = QImage();
+        runIOJobStages(&tileJob, state, OverlayStage, settings);
+    }
+    return true;
+}
+
+bool IOWorker::runIOJobStage(JobStage stage, IOJob* job, IOJobState& state, const IOWorkerSettings& settings) {
+    switch (stage) {
+    case ReadStage:
+        if (state.background && state.kernels) {
+            state.delivery._tile = (this->*state.kernels->readBackground)(state.background, job, state.background->getColorType(), state.samples, false);
+        }
+        return true;
+    case ConvertStage:
+        if (state.samples) {
+            state.delivery._tile = (this->*state.kernels->convertBackground)(state.background, job, state.background->getColorType(), state.samples, settings);
+            state.samples.reset();
+        }
+        return true;
+    case OverlayStage:
+        if (std::shared_ptr<MultiResolutionImage> local_for_img = settings._for_img.lock()) {
+            if (const TypedKernels* kernels = typedKernels(local_for_img->getDataType())) {
+                // 前景缓存命中时复制源数据交给瓦片，渲染结果以隐式共享的方式复用
+                OverlayTileCache* cache = settings._overlayCache.get();
+                std::shared_ptr<ImageSource> cachedTile;
+                if (cache) {
+                    cachedTile = cache->getSource(local_for_img, settings._foregroundImageScale, job->_level, job->_imgPosX, job->_imgPosY, job->_tileSize);
+                }
+                if (cachedTile) {
+                    state.foregroundTile = cachedTile->clone();
+                }
+                else {
+                    state.foregroundTile = (this->*kernels->getForeground)(local_for_img, job, settings);
+                    if (cache && state.foregroundTile) {
+                        cache->setSource(local_for_img, settings._foregroundImageScale, job->_level, job->_imgPosX, job->_imgPosY, job->_tileSize,
+                            std::shared_ptr<ImageSource>(state.foregroundTile->clone()));
+                    }
+                }
+                state.delivery._hasForeground = true;
+                if (!cache || !cache->getRendered(local_for_img, settings._foregroundImageScale, job->_level, job->_imgPosX, job->_imgPosY, job->_tileSize,
+                    settings._overlayGeneration, state.delivery._foreground)) {
+                    state.delivery._foreground = (this->*kernels->renderForeground)(state.foregroundTile, job->_tileSize, settings);
+                    if (cache) {
+                        cache->setRendered(local_for_img, settings._foregroundImageScale, job->_level, job->_imgPosX, job->_imgPosY, job->_tileSize,
+                            settings._overlayGeneration, state.delivery._foreground);
+                    }
+                }
+            }
+        }
+        return true;
+    case DeliverStage:
+        if (!state.background) {
+            return false;
+        }
+        state.delivery._tile = postProcessTile(state.delivery._tile, settings);
+        state.delivery._hasTile = !state.delivery._tile.isNull();
+        state.delivery._tileSize = job->_tileSize;
+        state.delivery._tileByteSize = job->_tileSize * job->_tileSize * state.background->getSamplesPerPixel();
+        state.delivery._foregroundTile = state.foregroundTile;
+        state.foregroundTile = NULL;
+        state.delivery._renderGeneration = settings._renderGeneration;
+        state.delivery._backgroundGeneration = settings._backgroundGeneration;
+        _client->deliverTile(state.delivery);
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool IOWorker::executeBackgroundRenderJob(BackgroundRenderJob* job, const IOWorkerSettings& settings) {
+    std::shared_ptr<MultiResolutionImage> local_bck_img = settings._bck_img.lock();
+    if (!local_bck_img) {
+        return false;
+    }
+    TileDelivery delivery(TileDelivery::BackgroundRendered, job->_imgPosX, job->_imgPosY, job->_level);
+    delivery._tile = renderBackgroundTile(local_bck_img, job, settings);
+    if (!delivery._tile.isNull()) {
+        delivery._hasTile = true;
+        delivery._backgroundGeneration = settings._backgroundGeneration;
+        _client->deliverTile(delivery);
         return true;
     }
     return false;
 }
 
-bool IOWorker::executeRenderJob(RenderJob* job) {
-    QPixmap* foregroundPixmap = NULL;
-    if (job->_foregroundTile->getDataType() == SlideColorManagement::DataType::UChar) {
-        foregroundPixmap = renderForegroundImage<unsigned char>(dynamic_cast<Patch<unsigned char>*>(job->_foregroundTile), job->_tileSize);
+QImage IOWorker::renderBackgroundTile(std::shared_ptr<MultiResolutionImage> local_bck_img, const BackgroundRenderJob* job, const IOWorkerSettings& settings) {
+    const TypedKernels* kernels = typedKernels(local_bck_img->getDataType());
+    if (!kernels) {
+        return QImage();
+    }
+    PipelineProfiler::ScopedTimer timer(PipelineProfiler::RenderBackgroundImage);
+    std::shared_ptr<void> samples;
+    QImage tile = (this->*kernels->readBackground)(local_bck_img, job, local_bck_img->getColorType(), samples, job->_residentOnly);
+    if (samples) {
+        tile = (this->*kernels->convertBackground)(local_bck_img, job, local_bck_img->getColorType(), samples, settings);
     }
-    else if (job->_foregroundTile->getDataType() == SlideColorManagement::DataType::UInt16) {
-        foregroundPixmap = renderForegroundImage<unsigned short>(dynamic_cast<Patch<unsigned short>*>(job->_foregroundTile), job->_tileSize);
+    return postProcessTile(tile, settings);
+}
+
+QImage IOWorker::postProcessTile(QImage tile, const IOWorkerSettings& settings) {
+    if ((!settings._colorTransform && !settings._enhancement) || tile.isNull() || tile.depth() != 32) {
+        return tile;
     }
-    else if (job->_foregroundTile->getDataType() == SlideColorManagement::DataType::UInt32) {
-        foregroundPixmap = renderForegroundImage<unsigned int>(dynamic_cast<Patch<unsigned int>*>(job->_foregroundTile), job->_tileSize);
+    if (settings._colorTransform) {
+        PipelineProfiler::ScopedTimer timer(PipelineProfiler::ColorTransformTile);
+        // 显示格式的瓦片按行连续存放，整块作为一个像素序列处理
+        PixelConversion::applyColorLUT3D(reinterpret_cast<unsigned int*>(tile.bits()),
+            static_cast<unsigned long long>(tile.bytesPerLine() / 4) * tile.height(), *settings._colorTransform);
     }
-    else if (job->_foregroundTile->getDataType() == SlideColorManagement::DataType::Float) {
-        foregroundPixmap = renderForegroundImage<float>(dynamic_cast<Patch<float>*>(job->_foregroundTile), job->_tileSize);
+    if (settings._enhancement) {
+        PipelineProfiler::ScopedTimer timer(PipelineProfiler::EnhanceTile);
+        PixelConversion::enhanceARGB32(reinterpret_cast<unsigned int*>(tile.bits()), tile.width(), tile.height(), tile.bytesPerLine() / 4,
+            *settings._enhancement);
     }
-    if (foregroundPixmap) {
-        emit foregroundTileRendered(foregroundPixmap, job->_imgPosX, job->_imgPosY, job->_level);
+    return tile;
+}
+
+const IOWorker::TypedKernels* IOWorker::typedKernels(SlideColorManagement::DataType dataType) {
+    // 按SlideColorManagement::DataType的枚举值索引，InvalidDataType为空
+    static const TypedKernels kernels[] = {
+        { NULL, NULL, NULL, NULL },
+        { &IOWorker::readBackgroundImage<unsigned char>, &IOWorker::convertBackgroundImage<unsigned char>, &IOWorker::getForegroundSource<unsigned char>, &IOWorker::renderForegroundSource<unsigned char> },
+        { &IOWorker::readBackgroundImage<unsigned short>, &IOWorker::convertBackgroundImage<unsigned short>, &IOWorker::getForegroundSource<unsigned short>, &IOWorker::renderForegroundSource<unsigned short> },
+        { &IOWorker::readBackgroundImage<unsigned int>, &IOWorker::convertBackgroundImage<unsigned int>, &IOWorker::getForegroundSource<unsigned int>, &IOWorker::renderForegroundSource<unsigned int> },
+        { &IOWorker::readBackgroundImage<float>, &IOWorker::convertBackgroundImage<float>, &IOWorker::getForegroundSource<float>, &IOWorker::renderForegroundSource<float> }
+    };
+    const unsigned int index = static_cast<unsigned int>(dataType);
+    if (index == 0 || index >= sizeof(kernels) / sizeof(kernels[0])) {
+        return NULL;
+    }
+    return &kernels[index];
+}
+
+template<typename T>
+ImageSource* IOWorker::getForegroundSource(std::shared_ptr<MultiResolutionImage> local_for_img, const IOJob* job, const IOWorkerSettings& settings) {
+    return getForegroundTile<T>(local_for_img, job, settings);
+}
+
+template<typename T>
+QImage IOWorker::renderForegroundSource(ImageSource* foregroundTile, unsigned int backgroundTileSize, const IOWorkerSettings& settings) {
+    return renderForegroundImage<T>(dynamic_cast<Patch<T>*>(foregroundTile), backgroundTileSize, settings);
+}
+
+bool IOWorker::executeRenderJob(RenderJob* job, const IOWorkerSettings& settings) {
+    if (const TypedKernels* kernels = typedKernels(job->_foregroundTile->getDataType())) {
+        // 转换失败时同样投递（空像素图），与TileManager对渲染结果的处理一致
+        TileDelivery delivery(TileDelivery::ForegroundRendered, job->_imgPosX, job->_imgPosY, job->_level);
+        delivery._tile = (this->*kernels->renderForeground)(job->_foregroundTile, job->_tileSize, settings);
+        delivery._hasTile = true;
+        delivery._renderGeneration = settings._renderGeneration;
+        _client->deliverTile(delivery);
         return true;
     }
-    else {
-        return false;
+    return false;
+}
+
+template<typename T>
+QImage IOWorker::readBackgroundImage(std::shared_ptr<MultiResolutionImage> local_bck_img, const ThreadJob* job, SlideColorManagement::ColorType colorType,
+    std::shared_ptr<void>& samples, bool residentOnly) {
+    PipelineTrace::ScopedEvent event("IOWorker::readBackgroundImage", job->_imgPosX, job->_imgPosY, job->_level);
+    // 四舍五入而不是截断，换算回层级坐标时落在原生瓦片边界上
+    double levelDownsample = local_bck_img->getLevelDownsample(job->_level);
+    long long startX = std::llround(job->_imgPosX * levelDownsample * job->_tileSize);
+    long long startY = std::llround(job->_imgPosY * levelDownsample * job->_tileSize);
+
+    // 组织掩膜中只有玻片背景的瓦片直接用背景色填充，不读取也不解码
+    if (std::shared_ptr<const TissueMask> tissueMask = local_bck_img->getTissueMask()) {
+        const double tileExtent = levelDownsample * job->_tileSize;
+        if (!tissueMask->containsTissue(startX, startY, tileExtent, tileExtent)) {
+            PipelineProfiler::count(PipelineProfiler::BackgroundTileSynthesized);
+            unsigned char bgR, bgG, bgB;
+            local_bck_img->getBackgroundColor(bgR, bgG, bgB);
+            return createSolidTile(QColor(bgR, bgG, bgB));
+        }
     }
+
+    // 8位RGB图像优先尝试直接读取预乘ARGB到QImage内存，省去中间缓冲和格式转换
+    if (colorType == SlideColorManagement::ColorType::RGB && local_bck_img->getDataType() == SlideColorManagement::DataType::UChar) {
+        QImage tileImg(job->_tileSize, job->_tileSize, QImage::Format_ARGB32_Premultiplied);
+        unsigned int* pixels = reinterpret_cast<unsigned int*>(tileImg.bits());
+        const bool read = residentOnly ? local_bck_img->getCachedARGB32Region(startX, startY, job->_tileSize, job->_tileSize, job->_level, pixels, job->_zPlane) :
+            local_bck_img->getARGB32Region(startX, startY, job->_tileSize, job->_tileSize, job->_level, pixels, job->_zPlane);
+        if (read) {
+            QImage solidTile = solidTileFromImage(tileImg);
+            return solidTile.isNull() ? tileImg : solidTile;
+        }
+    }
+
+    unsigned int samplesPerPixel = local_bck_img->getSamplesPerPixel();
+    // 样本缓冲区从池中分配，转换阶段把图像转换为显示格式（复制像素）后归还
+    T* imgBuf = TileBufferPool::allocateArray<T>(static_cast<size_t>(job->_tileSize) * job->_tileSize * samplesPerPixel);
+    samples.reset(imgBuf, TileBufferPool::release);
+    if (!residentOnly) {
+        local_bck_img->getRawRegion(startX, startY, job->_tileSize, job->_tileSize, job->_level, imgBuf, job->_zPlane);
+        // 加载的瓦片顺带计入切片统计，后台统计任务不再读取这些单元
+        std::shared_ptr<SlideStatistics> statistics = local_bck_img->getStatistics();
+        if (statistics && job->_zPlane == 0) {
+            statistics->accumulate(job->_level, static_cast<long long>(job->_imgPosX) * job->_tileSize, static_cast<long long>(job->_imgPosY) * job->_tileSize,
+                job->_tileSize, job->_tileSize, imgBuf);
+        }
+    }
+    else if (!local_bck_img->readCachedRegion(startX, startY, job->_tileSize, job->_tileSize, job->_level, imgBuf, job->_zPlane)) {
+        // 原始数据已被淘汰，瓦片保留当前的像素图，不为调整显示参数重新读取图像
+        PipelineProfiler::count(PipelineProfiler::ResidentTileMiss);
+        samples.reset();
+    }
+    return QImage();
 }
 
 template<typename T>
-QPixmap* IOWorker::renderBackgroundImage(std::shared_ptr<MultiResolutionImage> local_bck_img, const IOJob* job, SlideColorManagement::ColorType colorType) {
-    float levelDownsample = local_bck_img->getLevelDownsample(job->_level);
+QImage IOWorker::convertBackgroundImage(std::shared_ptr<MultiResolutionImage> local_bck_img, const ThreadJob* job, SlideColorManagement::ColorType colorType,
+    const std::shared_ptr<void>& samples, const IOWorkerSettings& settings) {
+    PipelineTrace::ScopedEvent event("IOWorker::convertBackgroundImage", job->_imgPosX, job->_imgPosY, job->_level);
     unsigned int samplesPerPixel = local_bck_img->getSamplesPerPixel();
-    T* imgBuf = new T[job->_tileSize * job->_tileSize * samplesPerPixel];
-    local_bck_img->getRawRegion(job->_imgPosX * levelDownsample * job->_tileSize, job->_imgPosY * levelDownsample * job->_tileSize, job->_tileSize, job->_tileSize, job->_level, imgBuf);
+    T* imgBuf = static_cast<T*>(samples.get());
     QImage renderedImg;
     if (colorType == SlideColorManagement::ColorType::RGB) {
         renderedImg = QImage(reinterpret_cast<unsigned char*>(imgBuf), (job->_tileSize), (job->_tileSize), (job->_tileSize) * 3, QImage::Format_RGB888);
@@ -212,23 +577,69 @@ QPixmap* IOWorker::renderBackgroundImage(std::shared_ptr<MultiResolutionImage> l
     else if (colorType == SlideColorManagement::ColorType::RGBA) {
         renderedImg = QImage(reinterpret_cast<unsigned char*>(imgBuf), (job->_tileSize), (job->_tileSize), (job->_tileSize) * 4, QImage::Format_RGBA8888);
     }
+    else if (settings._channelComposite) {
+        // 各通道的样本在同一次遍历中读取并加性混合
+        PipelineProfiler::ScopedTimer convertTimer(PipelineProfiler::ConvertMonochromeToRGB);
+        PipelineTrace::ScopedEvent convertEvent("PixelConversion::compositeChannelsToARGB32", job->_imgPosX, job->_imgPosY, job->_level);
+        renderedImg = QImage(job->_tileSize, job->_tileSize, QImage::Format_ARGB32_Premultiplied);
+        PixelConversion::compositeChannelsToARGB32(imgBuf, static_cast<unsigned long long>(job->_tileSize) * job->_tileSize, samplesPerPixel,
+            settings._channelComposite->data(), static_cast<unsigned int>(settings._channelComposite->size()), reinterpret_cast<unsigned int*>(renderedImg.bits()));
+    }
     else {
-        renderedImg = convertMonochromeToRGB(imgBuf, job->_tileSize, job->_tileSize, _backgroundChannel, samplesPerPixel, local_bck_img->getMinValue(_backgroundChannel), local_bck_img->getMaxValue(_backgroundChannel), SlideColorManagement::DefaultColorLUT["Background"]);
+        // "Background" LUT为相对的黑到白线性映射，等价于按通道范围做窗宽窗位
+        PipelineProfiler::ScopedTimer convertTimer(PipelineProfiler::ConvertMonochromeToRGB);
+        PipelineTrace::ScopedEvent convertEvent("PixelConversion::windowLevelToARGB32", job->_imgPosX, job->_imgPosY, job->_level);
+        renderedImg = QImage(job->_tileSize, job->_tileSize, QImage::Format_ARGB32_Premultiplied);
+        double channelMin, channelMax;
+        local_bck_img->getChannelRange(settings._backgroundChannel, channelMin, channelMax);
+        PixelConversion::windowLevelToARGB32(imgBuf, static_cast<unsigned long long>(job->_tileSize) * job->_tileSize, settings._backgroundChannel, samplesPerPixel,
+            channelMin, channelMax, nullptr, reinterpret_cast<unsigned int*>(renderedImg.bits()));
+    }
+    QImage solidTile = solidTileFromImage(renderedImg);
+    if (!solidTile.isNull()) {
+        return solidTile;
     }
-    QPixmap* renderedPixmap = new QPixmap(QPixmap::fromImage(renderedImg));
-    delete[] imgBuf;
-    return renderedPixmap;
+    if (renderedImg.format() == QImage::Format_ARGB32_Premultiplied) {
+        return renderedImg;
+    }
+    // RGB888和RGBA8888转换为绘制引擎直接使用的格式，GUI线程创建像素图时不再转换
+    PipelineTrace::ScopedEvent convertEvent("QImage::convertToFormat", job->_imgPosX, job->_imgPosY, job->_level);
+    return renderedImg.convertToFormat(colorType == SlideColorManagement::ColorType::RGBA ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+}
+
+QImage IOWorker::createSolidTile(const QColor& color) {
+    PipelineProfiler::count(PipelineProfiler::SolidTile);
+    QImage tile(1, 1, color.alpha() == 255 ? QImage::Format_RGB32 : QImage::Format_ARGB32_Premultiplied);
+    tile.fill(color);
+    return tile;
+}
+
+QImage IOWorker::solidTileFromImage(const QImage& image) {
+    if (image.isNull()) {
+        return QImage();
+    }
+    const int bytesPerPixel = image.depth() / 8;
+    const unsigned char* first = image.constScanLine(0);
+    for (int y = 0; y < image.height(); ++y) {
+        const unsigned char* line = image.constScanLine(y);
+        for (int x = 0; x < image.width(); ++x) {
+            if (std::memcmp(line + x * bytesPerPixel, first, bytesPerPixel) != 0) {
+                return QImage();
+            }
+        }
+    }
+    return createSolidTile(image.pixelColor(0, 0));
 }
 
 template<typename T>
-Patch<T>* IOWorker::getForegroundTile(std::shared_ptr<MultiResolutionImage> local_for_img, const IOJob* job) {
-    std::shared_ptr<MultiResolutionImage> loc_bck_img = _bck_img.lock();
-    int levelDifference = loc_bck_img->getBestLevelForDownSample(_foregroundImageScale);
+Patch<T>* IOWorker::getForegroundTile(std::shared_ptr<MultiResolutionImage> local_for_img, const IOJob* job, const IOWorkerSettings& settings) {
+    std::shared_ptr<MultiResolutionImage> loc_bck_img = settings._bck_img.lock();
+    int levelDifference = loc_bck_img->getBestLevelForDownSample(settings._foregroundImageScale);
     int fgImageLevel = job->_level - levelDifference;
 
     // If we request a level which is outside the range of the foreground image (e.g. level 8 when it only has 7 levels), get level 7 and scale up.
     float foregroundExtraScaling = 1.;
-    if (fgImageLevel > local_for_img->getNumberOfLevels()) {
+    if (fgImageLevel >= local_for_img->getNumberOfLevels()) {
         fgImageLevel = local_for_img->getNumberOfLevels() - 1;
     }
     else if (fgImageLevel < 0) {
@@ -240,30 +651,66 @@ Patch<T>* IOWorker::getForegroundTile(std::shared_ptr<MultiResolutionImage> loca
     int correctedTileSize = job->_tileSize * foregroundExtraScaling;
     unsigned int samplesPerPixel = local_for_img->getSamplesPerPixel();
     float fgLevelDownsample = local_for_img->getLevelDownsample(fgImageLevel);
-    T* imgBuf = new T[correctedTileSize * correctedTileSize * samplesPerPixel];
+    T* imgBuf = TileBufferPool::allocateArray<T>(static_cast<size_t>(correctedTileSize) * correctedTileSize * samplesPerPixel);
     local_for_img->getRawRegion(job->_imgPosX * fgLevelDownsample * foregroundExtraScaling * job->_tileSize, job->_imgPosY * fgLevelDownsample * foregroundExtraScaling * job->_tileSize, correctedTileSize, correctedTileSize, fgImageLevel, imgBuf);
+    // 前景比背景瓦片精细时在原始数据上缩小，之后缓存和查表的像素数都只有瓦片大小
+    if (correctedTileSize > static_cast<int>(job->_tileSize)) {
+        T* resampled = TileBufferPool::allocateArray<T>(static_cast<size_t>(job->_tileSize) * job->_tileSize * samplesPerPixel);
+        PixelConversion::resample(imgBuf, correctedTileSize, correctedTileSize, samplesPerPixel, resampled, job->_tileSize, job->_tileSize,
+            foregroundInterpolation<T>(settings));
+        TileBufferPool::release(imgBuf);
+        imgBuf = resampled;
+        correctedTileSize = job->_tileSize;
+    }
     std::vector<double> minValues, maxValues;
     for (unsigned int i = 0; i < local_for_img->getSamplesPerPixel(); ++i) {
         minValues.push_back(local_for_img->getMinValue(i));
         maxValues.push_back(local_for_img->getMaxValue(i));
     }
-    Patch<T>* foregroundTile = new Patch<T>({ static_cast<unsigned long long>(correctedTileSize), static_cast<unsigned long long>(correctedTileSize), 1 }, local_for_img->getColorType(), imgBuf, true, minValues, maxValues);
+    Patch<T>* foregroundTile = new Patch<T>({ static_cast<unsigned long long>(correctedTileSize), static_cast<unsigned long long>(correctedTileSize), samplesPerPixel },
+        local_for_img->getColorType(), imgBuf, true, minValues, maxValues);
+    // 在放入前景缓存之前统计一次，缓存命中和重新渲染时复制的瓦片带着统计结果，不再遍历数据
+    foregroundTile->getMinValue();
     return foregroundTile;
 }
 
 template<typename T>
-QPixmap* IOWorker::renderForegroundImage(Patch<T>* foregroundTile, unsigned int backgroundTileSize) {
+QImage IOWorker::renderForegroundImage(Patch<T>* foregroundTile, unsigned int backgroundTileSize, const IOWorkerSettings& settings) {
     std::vector<unsigned long long> dims = foregroundTile->getDimensions();
-    QImage renderedImage = convertMonochromeToRGB(foregroundTile->getPointer(), dims[0], dims[0], _foregroundChannel, foregroundTile->getSamplesPerPixel(), foregroundTile->getMinValue(_foregroundChannel), foregroundTile->getMaxValue(_foregroundChannel), _LUT);
-
-    if (!renderedImage.isNull()) {
-        if (backgroundTileSize != dims[0]) {
-            renderedImage = renderedImage.scaled(backgroundTileSize, backgroundTileSize);
-        }
-        QPixmap* renderedPixmap = new QPixmap(QPixmap::fromImage(renderedImage));
-        return renderedPixmap;
+    // 前景图像有切片统计时按切片范围归一化，相邻瓦片的颜色一致；否则按瓦片自身的范围
+    double channelMin, channelMax;
+    std::shared_ptr<MultiResolutionImage> local_for_img = settings._for_img.lock();
+    std::shared_ptr<SlideStatistics> statistics = local_for_img ? local_for_img->getStatistics() : std::shared_ptr<SlideStatistics>();
+    if (!statistics || !statistics->getRange(settings._foregroundChannel, channelMin, channelMax)) {
+        channelMin = foregroundTile->getMinValue(settings._foregroundChannel);
+        channelMax = foregroundTile->getMaxValue(settings._foregroundChannel);
     }
-    else {
-        return new QPixmap();
+    if (_foregroundTableOwner != _client || !_foregroundTable.isCompiledFor<T>(channelMin, channelMax, settings._renderGeneration)) {
+        _foregroundTable.compile<T>(settings._LUT, channelMin, channelMax, settings._renderGeneration);
+        _foregroundTableOwner = _client;
+    }
+    const unsigned int samplesPerPixel = foregroundTile->getSamplesPerPixel();
+    const unsigned int tileSize = static_cast<unsigned int>(dims[0]);
+    QImage renderedImage;
+    if (backgroundTileSize > tileSize && foregroundInterpolation<T>(settings) == PixelConversion::Bilinear) {
+        // 连续值先在原始数据上插值再查表，颜色按插值后的值取得
+        TileBuffer<T> resampled(static_cast<size_t>(backgroundTileSize) * backgroundTileSize * samplesPerPixel);
+        PixelConversion::resample(foregroundTile->getPointer(), tileSize, tileSize, samplesPerPixel, resampled.get(),
+            backgroundTileSize, backgroundTileSize, PixelConversion::Bilinear);
+        PipelineProfiler::ScopedTimer convertTimer(PipelineProfiler::ConvertMonochromeToRGB);
+        return convertMonochromeToRGB(resampled.get(), backgroundTileSize, backgroundTileSize, settings._foregroundChannel, samplesPerPixel, _foregroundTable);
+    }
+    {
+        PipelineProfiler::ScopedTimer convertTimer(PipelineProfiler::ConvertMonochromeToRGB);
+        renderedImage = convertMonochromeToRGB(foregroundTile->getPointer(), tileSize, tileSize, settings._foregroundChannel, samplesPerPixel, _foregroundTable);
+    }
+
+    if (!renderedImage.isNull() && backgroundTileSize != tileSize) {
+        // 标签图按补丁大小查表后最近邻放大颜色，与先放大标签再查表的结果相同
+        QImage scaledImage(backgroundTileSize, backgroundTileSize, QImage::Format_ARGB32_Premultiplied);
+        PixelConversion::resample(reinterpret_cast<const unsigned int*>(renderedImage.constBits()), tileSize, tileSize, 1,
+            reinterpret_cast<unsigned int*>(scaledImage.bits()), backgroundTileSize, backgroundTileSize, PixelConversion::Nearest);
+        renderedImage = scaledImage;
     }
+    return renderedImage;
 }
\ No newline at end of file
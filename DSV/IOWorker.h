@@ -21,16 +21,85 @@
 #pragma once
 
 #include <QThread>
-#include <QMutex>
-#include <QPixmap>
+#include <QImage>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <vector>
 #include "SlideColorManagement.h"
+#include "UtilityFunctions.h"
+#include "PixelConversion.h"
 #include "Patch.h"
 
  // 前向声明
 class MultiResolutionImage;
 class IOJob;
+class BatchIOJob;
 class RenderJob;
+class BackgroundRenderJob;
+class ThreadJob;
 class IOThread;
+class IOWorkerPool;
+class OverlayTileCache;
+
+/**
+ * @struct  IOWorkerSettings
+ * @brief   工作线程渲染设置的不可变快照
+ * @details 包含图像引用、通道、缩放因子和LUT。每个IOThread保存一份，设置函数复制当前快照、修改后整体原子替换，
+ *          工作线程在每个任务开始时取得任务所属IOThread的快照并在整个任务中使用，
+ *          因此修改设置不必等待正在解码的瓦片完成
+ * @see     IOWorker, IOThread::getSettings
+ */
+struct IOWorkerSettings {
+    /** @brief 背景图像的弱引用指针 */
+    std::weak_ptr<MultiResolutionImage> _bck_img;
+
+    /** @brief 前景图像的弱引用指针 */
+    std::weak_ptr<MultiResolutionImage> _for_img;
+
+    /** @brief 背景图像当前显示的通道索引 */
+    int _backgroundChannel = 0;
+
+    /** @brief 前景图像当前显示的通道索引 */
+    int _foregroundChannel = 0;
+
+    /**
+     * @brief 前景图像相对于背景图像的缩放因子
+     * @details 前景图像只能与背景图像相同大小或更小，因此该值范围为1到正无穷
+     */
+    float _foregroundImageScale = 1.;
+
+    /** @brief 当前使用的颜色查找表（LUT） */
+    SlideColorManagement::LUT _LUT;
+
+    /** @brief 前景设置对应的渲染代，随渲染结果一起发出 */
+    unsigned int _renderGeneration = 0;
+
+    /** @brief 编译后的荧光多通道合成设置，为空时单色和多通道背景按_backgroundChannel显示灰度 */
+    std::shared_ptr<const std::vector<PixelConversion::CompositeChannel> > _channelComposite;
+
+    /** @brief 背景设置对应的渲染代，随背景渲染结果一起发出 */
+    unsigned int _backgroundGeneration = 0;
+
+    /** @brief 编译后的背景瓦片增强设置，为空时不增强 */
+    std::shared_ptr<const PixelConversion::Enhancement> _enhancement;
+
+    /** @brief 背景图像ICC配置文件编译成的到sRGB的查找表，为空时不转换 */
+    std::shared_ptr<const PixelConversion::ColorLUT3D> _colorTransform;
+
+    /** @brief 所有工作线程共享的前景瓦片缓存，为空时不缓存 */
+    std::shared_ptr<OverlayTileCache> _overlayCache;
+
+    /**
+     * @brief 叠加层外观代
+     * @details 前景通道或LUT改变时加一，与_renderGeneration不同，切换前景图像时不变，
+     *          因此缓存的渲染结果在切换回原来的前景图像后仍然有效
+     */
+    unsigned int _overlayGeneration = 0;
+
+    /** @brief 显示的Z平面，IO任务读取该平面 */
+    unsigned int _zPlane = 0;
+};
 
 /**
  * @class  IOWorker
@@ -38,7 +107,7 @@ class IOThread;
  * @details 该类是DSV项目中异步IO处理的具体执行单元，负责：
  *          - 从任务队列中获取并执行瓦片处理任务
  *          - 从多分辨率图像中加载指定位置的瓦片数据
- *          - 将瓦片数据渲染为QPixmap格式
+ *          - 将瓦片数据渲染为显示格式的QImage，像素图由GUI线程创建
  *          - 处理背景和前景图像的合成渲染
  *          - 应用颜色通道和LUT设置
  *          - 通过信号机制与主线程通信
@@ -49,25 +118,19 @@ class IOThread;
  *          - 图像渲染：将原始数据转换为显示格式
  *          - 图像合成：背景和前景图像的叠加处理
  *          - 动态配置：支持通道和LUT的动态切换
- *          - 线程安全：使用互斥锁保护共享资源
+ *          - 线程安全：设置以不可变快照形式原子发布，任务执行期间不持有锁
+ *          - 多视图共享：工作线程属于全局IOWorkerPool，依次执行各IOThread的任务，
+ *            使用任务所属IOThread的设置快照，结果交给该IOThread按帧批量投递到GUI线程
  *
- * @note   该类继承自QThread，运行在独立的工作线程中
+ * @note   该类继承自QThread，运行在独立的工作线程中，由IOWorkerPool创建和销毁
  * @example
- *          // 使用示例
- *          IOThread* ioThread = new IOThread(parent, 4);
- *          IOWorker* worker = new IOWorker(ioThread);
- *
- *          // 设置图像源
- *          worker->setBackgroundImage(backgroundImage);
- *          worker->setForegroundImage(foregroundImage, 0.5);
- *
- *          // 设置显示参数
- *          worker->setBackgroundChannel(0);
- *          worker->setLUT(SlideColorManagement::LUT::HOT);
- *
- *          // 启动工作线程
- *          worker->start();
- * @see     IOThread, ThreadJob, MultiResolutionImage, Patch
+ *          // 使用示例：工作线程由线程池管理，视图只与IOThread交互
+ *          IOThread* ioThread = new IOThread(parent);
+ *          ioThread->setBackgroundImage(backgroundImage);
+ *          ioThread->setForegroundImage(foregroundImage, 0.5);
+ *          ioThread->onLUTChanged(SlideColorManagement::LUT::HOT);
+ *          QObject::connect(ioThread, SIGNAL(tileLoaded(...)), manager, SLOT(onTileLoaded(...)));
+ * @see     IOThread, IOWorkerPool, ThreadJob, MultiResolutionImage, Patch
  */
 class IOWorker : public QThread
 {
@@ -78,11 +141,12 @@ public:
      * @brief   构造函数
      * @details 创建IO工作线程对象，初始化线程参数和资源
      *
-     * @param   thread IO线程管理器指针，用于获取任务和配置
+     * @param   pool 全局线程池，用于获取任务
+     * @param   queueIndex 该线程在每个IOThread中对应的任务队列索引
      * @note    构造函数会初始化所有成员变量，但不会启动线程
      * @see     ~IOWorker, start
      */
-    IOWorker(IOThread* thread);
+    IOWorker(IOWorkerPool* pool, unsigned int queueIndex = 0);
 
     /**
      * @brief   析构函数
@@ -101,86 +165,29 @@ public:
     void abort();
 
     /**
-     * @brief   设置背景图像通道
-     * @details 设置背景图像的显示通道索引
-     *
-     * @param   channel 通道索引
-     * @note    该设置会影响后续的瓦片渲染
-     * @see     setForegroundChannel, setLUT
-     */
-    void setBackgroundChannel(int channel);
-
-    /**
-     * @brief   设置前景图像通道
-     * @details 设置前景图像的显示通道索引
-     *
-     * @param   channel 通道索引
-     * @note    该设置会影响后续的瓦片渲染
-     * @see     setBackgroundChannel, setLUT
-     */
-    void setForegroundChannel(int channel);
-
-    /**
-     * @brief   设置颜色查找表（LUT）
-     * @details 设置用于图像颜色映射的查找表
-     *
-     * @param   LUTname LUT对象，定义颜色映射规则
-     * @note    该设置会影响后续的瓦片渲染颜色
-     * @see     setBackgroundChannel, setForegroundChannel
-     */
-    void setLUT(const SlideColorManagement::LUT& LUTname);
-
-    /**
-     * @brief   设置背景图像
-     * @details 设置用于瓦片加载的背景多分辨率图像
-     *
-     * @param   bck_img 背景图像的弱引用指针
-     * @note    使用弱引用避免循环引用，图像对象由外部管理
-     * @see     setForegroundImage
+     * @brief   是否已被中止
+     * @return  true表示线程已被要求停止
+     * @see     abort
      */
-    void setBackgroundImage(std::weak_ptr<MultiResolutionImage> bck_img);
+    bool isAborted() const { return _abort; }
 
     /**
-     * @brief   设置前景图像
-     * @details 设置用于瓦片渲染的前景多分辨率图像
-     *
-     * @param   for_img 前景图像的弱引用指针
-     * @param   scale 前景图像的缩放因子，默认为1.0
-     * @note    前景图像只能与背景图像相同大小或更小
-     * @see     setBackgroundImage
+     * @brief   获取该线程对应的任务队列索引
+     * @return  队列索引
+     * @see     IOThread::takeJob
      */
-    void setForegroundImage(std::weak_ptr<MultiResolutionImage> for_img, float scale = 1.);
+    unsigned int getQueueIndex() const { return _queueIndex; }
 
-signals:
     /**
-     * @brief   瓦片加载完成信号
-     * @details 当瓦片数据加载完成时发出此信号
-     *
-     * @param   tile 加载完成的瓦片像素图
-     * @param   tileX 瓦片X坐标
-     * @param   tileY 瓦片Y坐标
-     * @param   tileSize 瓦片大小
-     * @param   tileByteSize 瓦片字节大小
-     * @param   tileLevel 瓦片层级
-     * @param   foregroundTile 前景瓦片图像源指针，默认为NULL
-     * @param   foregroundPixmap 前景瓦片像素图，默认为NULL
-     * @note    该信号由主线程接收，用于更新UI显示
-     * @see     foregroundTileRendered
+     * @brief   按设置后处理背景瓦片
+     * @param   tile 显示格式的背景瓦片，通常由本线程独占，就地修改不会复制
+     * @param   settings 任务开始时取得的设置快照
+     * @return  处理后的瓦片；没有颜色转换和增强设置、瓦片为空或不是32位格式时原样返回
+     * @details 先按ICC配置文件转换到sRGB，再锐化和调整色调，使增强参数作用于显示颜色。
+     *          瓦片图层最底层的缩略图同样经过该函数，与瓦片颜色一致
+     * @see     PixelConversion::applyColorLUT3D, PixelConversion::enhanceARGB32, IOThread::setEnhancement
      */
-    void tileLoaded(QPixmap* tile, unsigned int tileX, unsigned int tileY, unsigned int tileSize, unsigned int tileByteSize, unsigned int tileLevel, ImageSource* foregroundTile = NULL, QPixmap* foregroundPixmap = NULL);
-
-    /**
-     * @brief   前景瓦片渲染完成信号
-     * @details 当前景瓦片渲染完成时发出此信号
-     *
-     * @param   tile 渲染完成的前景瓦片像素图
-     * @param   tileX 瓦片X坐标
-     * @param   tileY 瓦片Y坐标
-     * @param   tileLevel 瓦片层级
-     * @note    该信号由主线程接收，用于更新前景显示
-     * @see     tileLoaded
-     */
-    void foregroundTileRendered(QPixmap* tile, unsigned int tileX, unsigned int tileY, unsigned int tileLevel);
+    static QImage postProcessTile(QImage tile, const IOWorkerSettings& settings);
 
 protected:
     /**
@@ -192,70 +199,200 @@ protected:
     void run();
 
 private:
-    /** @brief 保护共享资源的互斥锁 */
-    QMutex mutex;
+    /** @brief 全局线程池 */
+    IOWorkerPool* _pool;
 
-    /** @brief 背景图像的弱引用指针 */
-    std::weak_ptr<MultiResolutionImage> _bck_img;
-
-    /** @brief 前景图像的弱引用指针 */
-    std::weak_ptr<MultiResolutionImage> _for_img;
+    /** @brief 当前任务所属的IOThread，结果信号由它发出；仅在工作线程中访问 */
+    IOThread* _client;
 
     /** @brief 线程中止标志，true表示需要停止线程 */
-    bool _abort;
+    std::atomic<bool> _abort;
 
-    /** @brief 背景图像当前显示的通道索引 */
-    int _backgroundChannel;
+    /** @brief 该线程对应的任务队列索引 */
+    unsigned int _queueIndex;
 
-    /** @brief 前景图像当前显示的通道索引 */
-    int _foregroundChannel;
+    /** @brief 前景LUT编译成的稠密颜色表，仅在工作线程中访问，所属IOThread、渲染代或通道范围改变时重新编译 */
+    DenseLUT _foregroundTable;
+
+    /** @brief 编译_foregroundTable时的IOThread，不同视图的渲染代各自计数，不能只比较渲染代 */
+    const IOThread* _foregroundTableOwner;
 
     /**
-     * @brief 前景图像相对于背景图像的缩放因子
-     * @details 前景图像只能与背景图像相同大小或更小，因此该值范围为1到正无穷
-     * @note    该值用于计算前景瓦片在背景瓦片中的位置和大小
+     * @brief   IO任务的执行阶段
+     * @details 按枚举顺序执行，阶段之间检查任务是否过期，各阶段分别计时
      */
-    float _foregroundImageScale;
+    enum JobStage {
+        ReadStage,          ///< 读取背景瓦片：组织掩膜、ARGB32直读或原始样本
+        ConvertStage,       ///< 把原始样本转换为显示格式
+        OverlayStage,       ///< 读取前景瓦片并查表
+        DeliverStage,       ///< 把结果交给IOThread
+        NumberOfJobStages
+    };
 
-    /** @brief 当前使用的颜色查找表（LUT） */
-    SlideColorManagement::LUT _LUT;
+    /** @brief IO任务在阶段之间传递的中间结果，定义见IOWorker.cpp */
+    struct IOJobState;
 
     /**
      * @brief   执行IO任务
-     * @details 处理瓦片数据加载任务，从多分辨率图像中提取瓦片数据
+     * @details 依次执行JobStage的各阶段。每个阶段开始前检查线程是否中止、瓦片是否已离开视野
+     *          （IOThread::isJobStale），过期的任务放弃剩余阶段并投递空结果，
+     *          TileManager据此重置覆盖状态，与排队任务被剔除时相同
      *
      * @param   job IO任务对象指针
-     * @return  true表示任务执行成功，false表示失败
-     * @note    该函数会发出tileLoaded信号通知主线程
-     * @see     executeRenderJob, tileLoaded
+     * @param   settings 任务开始时取得的设置快照
+     * @return  true表示任务执行成功，false表示失败或被放弃
+     * @note    结果通过任务所属IOThread的deliverTile交给GUI线程，由其发出tileLoaded信号
+     * @see     executeRenderJob, IOThread::tileLoaded, runIOJobStage
+     */
+    bool executeIOJob(IOJob* job, const IOWorkerSettings& settings);
+
+    /**
+     * @brief   执行合并IO任务
+     * @details 8位RGB图像把块内未过期、含组织的瓦片交给MultiResolutionImage::getARGB32Tiles一次读取，
+     *          再逐个瓦片从OverlayStage开始执行剩余阶段；其余格式或不支持直接读取时逐个瓦片调用executeIOJob
+     *
+     * @param   job 合并IO任务对象指针
+     * @param   settings 任务开始时取得的设置快照
+     * @return  true表示所有瓦片都已处理（包括投递空结果）
+     * @see     executeIOJob, BatchIOJob
+     */
+    bool executeBatchIOJob(BatchIOJob* job, const IOWorkerSettings& settings);
+
+    /**
+     * @brief   为带预览标记的任务投递预览
+     * @details 只用于8位RGB背景。完整瓦片已在内存缓存中时不需要预览，直接返回该瓦片；
+     *          组织掩膜判定为背景、实测读取延迟低于阈值或格式不支持缩小解码时什么也不做
+     *
+     * @param   background 背景图像
+     * @param   job IO任务，_preview为true
+     * @param   tile 完整瓦片在内存缓存中时输出该瓦片（可能为1x1纯色瓦片）
+     * @param   settings 任务开始时取得的设置快照
+     * @return  true表示tile已是最终的背景瓦片，调用者跳过读取和转换阶段
+     * @see     MultiResolutionImage::getPreviewARGB32Region, IOThread::tilePreviewLoaded
      */
-    bool executeIOJob(IOJob* job);
+    bool previewTile(const std::shared_ptr<MultiResolutionImage>& background, const IOJob* job, QImage& tile, const IOWorkerSettings& settings);
+
+    /**
+     * @brief   从指定阶段开始依次执行IO任务的剩余阶段
+     * @param   job IO任务对象指针
+     * @param   state 阶段之间的中间结果，firstStage之前的阶段已填写
+     * @param   firstStage 第一个执行的阶段
+     * @param   settings 任务开始时取得的设置快照
+     * @return  true表示任务执行成功，false表示失败或被放弃
+     * @see     executeIOJob, runIOJobStage
+     */
+    bool runIOJobStages(IOJob* job, IOJobState& state, JobStage firstStage, const IOWorkerSettings& settings);
+
+    /**
+     * @brief   执行IO任务的一个阶段
+     * @param   stage 阶段
+     * @param   job IO任务对象指针
+     * @param   state 阶段之间的中间结果
+     * @param   settings 任务开始时取得的设置快照
+     * @return  false表示任务无法继续（如背景图像已释放）
+     */
+    bool runIOJobStage(JobStage stage, IOJob* job, IOJobState& state, const IOWorkerSettings& settings);
 
     /**
      * @brief   执行渲染任务
      * @details 处理瓦片渲染任务，将前景瓦片与背景瓦片进行合成
      *
      * @param   job 渲染任务对象指针
+     * @param   settings 任务开始时取得的设置快照
      * @return  true表示任务执行成功，false表示失败
-     * @note    该函数会发出foregroundTileRendered信号通知主线程
-     * @see     executeIOJob, foregroundTileRendered
+     * @note    结果通过IOThread::deliverTile交给GUI线程，由其发出foregroundTileRendered信号
+     * @see     executeIOJob, IOThread::foregroundTileRendered
+     */
+    bool executeRenderJob(RenderJob* job, const IOWorkerSettings& settings);
+
+    /**
+     * @brief   执行背景重新合成任务
+     * @details 按当前通道合成设置重新渲染背景瓦片
+     *
+     * @param   job 背景重新合成任务对象指针
+     * @param   settings 任务开始时取得的设置快照
+     * @return  true表示任务执行成功，false表示失败
+     * @note    结果通过IOThread::deliverTile交给GUI线程，由其发出backgroundTileRendered信号
+     * @see     executeIOJob, backgroundTileRendered
+     */
+    bool executeBackgroundRenderJob(BackgroundRenderJob* job, const IOWorkerSettings& settings);
+
+    /**
+     * @brief   按背景图像数据类型渲染背景瓦片
+     * @param   local_bck_img 背景图像对象的共享指针
+     * @param   job 当前任务对象指针
+     * @param   settings 任务开始时取得的设置快照
+     * @return  显示格式的瓦片图像，数据类型不支持或只处理驻留瓦片而缓存未命中时返回空图像
+     * @details 依次执行读取、转换和后处理三个阶段，用于背景重新合成任务
+     * @see     readBackgroundImage, convertBackgroundImage, postProcessTile
+     */
+    QImage renderBackgroundTile(std::shared_ptr<MultiResolutionImage> local_bck_img, const BackgroundRenderJob* job, const IOWorkerSettings& settings);
+
+    /**
+     * @brief   创建纯色瓦片
+     * @param   color 瓦片颜色
+     * @return  1x1图像，转换为像素图后WSITileGraphicsItem据此以fillRect绘制整个瓦片
+     * @see     WSITileGraphicsItem::isSolid
+     */
+    static QImage createSolidTile(const QColor& color);
+
+    /**
+     * @brief   把所有像素相同的瓦片图像转换为纯色瓦片
+     * @param   image 渲染得到的瓦片图像
+     * @return  图像为纯色时返回createSolidTile的结果，否则返回空图像
+     * @details 逐像素与第一个像素比较，普通瓦片在最初几个像素就能确定不是纯色
      */
-    bool executeRenderJob(RenderJob* job);
+    static QImage solidTileFromImage(const QImage& image);
 
     /**
-     * @brief   渲染背景图像瓦片
-     * @details 将多分辨率图像中的瓦片数据渲染为QPixmap格式
+     * @brief   选择前景重采样的插值方式
+     * @tparam  T 前景数据类型
+     * @param   settings 设置快照
+     * @return  整数前景配绝对索引LUT时按标签图处理返回Nearest，其余（概率图等）返回Bilinear
+     */
+    template<typename T>
+    static PixelConversion::Interpolation foregroundInterpolation(const IOWorkerSettings& settings) {
+        return std::is_integral<T>::value && !settings._LUT.relative ? PixelConversion::Nearest : PixelConversion::Bilinear;
+    }
+
+    /**
+     * @brief   读取背景图像瓦片
+     * @details 渲染背景瓦片的读取阶段。组织掩膜判定为背景的瓦片直接返回纯色瓦片，
+     *          8位RGB图像直接读取预乘ARGB32，其余格式读取原始样本交给convertBackgroundImage
      *
      * @tparam  T 图像数据类型（如unsigned char, unsigned short等）
      * @param   local_bck_img 背景图像对象的共享指针
-     * @param   currentJob 当前IO任务对象指针
+     * @param   currentJob 当前任务对象指针（IOJob或BackgroundRenderJob）
+     * @param   colorType 颜色类型
+     * @param   samples 输出读取的原始样本（从TileBufferPool分配），已得到最终图像时为空
+     * @param   residentOnly 为true时只从内存缓存读取，未命中时samples为空并返回空图像
+     * @return  已得到最终图像时返回该图像（纯色瓦片为1x1），否则返回空图像
+     * @see     convertBackgroundImage, MultiResolutionImage::readCachedRegion
+     */
+    template <typename T>
+    QImage readBackgroundImage(std::shared_ptr<MultiResolutionImage> local_bck_img, const ThreadJob* currentJob, SlideColorManagement::ColorType colorType,
+        std::shared_ptr<void>& samples, bool residentOnly);
+
+    /**
+     * @brief   转换背景图像瓦片
+     * @details 渲染背景瓦片的转换阶段，把readBackgroundImage读取的原始样本转换为显示格式
+     *          （RGB32或ARGB32_Premultiplied）的QImage，像素图由GUI线程创建
+     *
+     * @tparam  T 图像数据类型（如unsigned char, unsigned short等）
+     * @param   local_bck_img 背景图像对象的共享指针
+     * @param   currentJob 当前任务对象指针（IOJob或BackgroundRenderJob）
      * @param   colorType 颜色类型，决定渲染方式
-     * @return  渲染完成的瓦片像素图指针
-     * @note    该函数是模板函数，支持不同的图像数据类型
-     * @see     getForegroundTile, renderForegroundImage
+     * @param   samples readBackgroundImage读取的原始样本
+     * @param   settings 任务开始时取得的设置快照
+     * @return  渲染完成的瓦片图像；所有像素相同的瓦片返回1x1纯色图像
+     * @note    该函数是模板函数，支持不同的图像数据类型；设置了通道合成时单色和多通道背景
+     *          由PixelConversion::compositeChannelsToARGB32一次遍历合成，否则按通道最小/最大值做窗宽窗位，
+     *          由PixelConversion::windowLevelToARGB32直接写入ARGB32_Premultiplied图像
+     * @see     readBackgroundImage, getForegroundTile, renderForegroundImage
      */
     template <typename T>
-    QPixmap* renderBackgroundImage(std::shared_ptr<MultiResolutionImage> local_bck_img, const IOJob* currentJob, SlideColorManagement::ColorType colorType);
+    QImage convertBackgroundImage(std::shared_ptr<MultiResolutionImage> local_bck_img, const ThreadJob* currentJob, SlideColorManagement::ColorType colorType,
+        const std::shared_ptr<void>& samples, const IOWorkerSettings& settings);
 
     /**
      * @brief   获取前景瓦片数据
@@ -264,24 +401,55 @@ private:
      * @tparam  T 图像数据类型（如unsigned char, unsigned short等）
      * @param   local_for_img 前景图像对象的共享指针
      * @param   currentJob 当前IO任务对象指针
+     * @param   settings 任务开始时取得的设置快照
      * @return  前景瓦片数据补丁对象指针
-     * @note    该函数是模板函数，支持不同的图像数据类型
-     * @see     renderBackgroundImage, renderForegroundImage
+     * @note    该函数是模板函数，支持不同的图像数据类型；前景层级比背景瓦片更精细时
+     *          读取后立即按foregroundInterpolation缩小到背景瓦片大小，补丁和之后的查表都只有瓦片大小
+     * @see     readBackgroundImage, renderForegroundImage
      */
     template<typename T>
-    Patch<T>* getForegroundTile(std::shared_ptr<MultiResolutionImage> local_for_img, const IOJob* currentJob);
+    Patch<T>* getForegroundTile(std::shared_ptr<MultiResolutionImage> local_for_img, const IOJob* currentJob, const IOWorkerSettings& settings);
 
     /**
      * @brief   渲染前景图像瓦片
-     * @details 将前景瓦片数据渲染为QPixmap格式
+     * @details 将前景瓦片数据渲染为ARGB32_Premultiplied格式的QImage
      *
      * @tparam  T 图像数据类型（如unsigned char, unsigned short等）
      * @param   foregroundTile 前景瓦片数据补丁对象指针
      * @param   backgroundTileSize 背景瓦片大小，用于缩放前景瓦片
-     * @return  渲染完成的前景瓦片像素图指针
-     * @note    该函数是模板函数，支持不同的图像数据类型
-     * @see     renderBackgroundImage, getForegroundTile
+     * @param   settings 任务开始时取得的设置快照
+     * @return  渲染完成的前景瓦片图像，转换失败时为空图像
+     * @note    该函数是模板函数，支持不同的图像数据类型；LUT只在渲染代改变后的第一个瓦片编译一次。
+     *          补丁小于背景瓦片时，标签图先按补丁大小查表再最近邻放大像素，连续值先双线性放大原始数据再查表
+     * @see     convertBackgroundImage, getForegroundTile
      */
     template<typename T>
-    QPixmap* renderForegroundImage(Patch<T>* foregroundTile, unsigned int backgroundTileSize);
+    QImage renderForegroundImage(Patch<T>* foregroundTile, unsigned int backgroundTileSize, const IOWorkerSettings& settings);
+
+    /**
+     * @brief   按数据类型实例化的瓦片处理函数
+     * @details 替代对SlideColorManagement::DataType的if分支链，每个任务只查一次表
+     */
+    struct TypedKernels {
+        QImage (IOWorker::*readBackground)(std::shared_ptr<MultiResolutionImage>, const ThreadJob*, SlideColorManagement::ColorType, std::shared_ptr<void>&, bool);
+        QImage (IOWorker::*convertBackground)(std::shared_ptr<MultiResolutionImage>, const ThreadJob*, SlideColorManagement::ColorType,
+            const std::shared_ptr<void>&, const IOWorkerSettings&);
+        ImageSource* (IOWorker::*getForeground)(std::shared_ptr<MultiResolutionImage>, const IOJob*, const IOWorkerSettings&);
+        QImage (IOWorker::*renderForeground)(ImageSource*, unsigned int, const IOWorkerSettings&);
+    };
+
+    /**
+     * @brief   查找数据类型对应的瓦片处理函数
+     * @param   dataType 图像数据类型
+     * @return  处理函数表项，数据类型无效时返回NULL
+     */
+    static const TypedKernels* typedKernels(SlideColorManagement::DataType dataType);
+
+    /** @brief getForegroundTile的类型擦除包装，用于TypedKernels */
+    template<typename T>
+    ImageSource* getForegroundSource(std::shared_ptr<MultiResolutionImage> local_for_img, const IOJob* currentJob, const IOWorkerSettings& settings);
+
+    /** @brief renderForegroundImage的类型擦除包装，用于TypedKernels */
+    template<typename T>
+    QImage renderForegroundSource(ImageSource* foregroundTile, unsigned int backgroundTileSize, const IOWorkerSettings& settings);
 };
\ No newline at end of file
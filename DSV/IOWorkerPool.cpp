@@ -0,0 +1,301 @@
+﻿/**
+ * @file    IOWorkerPool.cpp
+ * @brief   全局IO工作线程池实现
+ * @author  [JianZhang]
+ * @date    2025-01-19
+ * @version 1.0.0
+ */
+
+#include "IOWorkerPool.h"
+#include "IOThread.h"
+#include "IOWorker.h"
+#include "PipelineProfiler.h"
+#include <QCoreApplication>
+#include <QThread>
+#include <algorithm>
+#include <thread>
+
+/**
+ * @brief 获取单例
+ * @return 线程池
+ */
+IOWorkerPool* IOWorkerPool::instance()
+{
+    static IOWorkerPool* pool = new IOWorkerPool(defaultNumberOfThreads());
+    return pool;
+}
+
+/**
+ * @brief 构造函数
+ * @param nrThreads 工作线程数量
+ * @details 应用程序退出时停止工作线程，避免静态析构阶段线程仍在运行
+ */
+IOWorkerPool::IOWorkerPool(unsigned int nrThreads) :
+    QObject(),
+    _nrJobs(0),
+    _nextClient(0),
+    _threadsWaiting(0),
+    _abort(false)
+{
+    if (QCoreApplication* app = QCoreApplication::instance()) {
+        QObject::connect(app, SIGNAL(aboutToQuit()), this, SLOT(shutdown()));
+    }
+    setNumberOfThreads(nrThreads);
+}
+
+/**
+ * @brief 析构函数
+ */
+IOWorkerPool::~IOWorkerPool()
+{
+    shutdown();
+}
+
+/**
+ * @brief 获取默认工作线程数量
+ * @return 工作线程数量
+ * @details 为GUI线程保留一个核心；hardware_concurrency()无法确定时返回2
+ */
+unsigned int IOWorkerPool::defaultNumberOfThreads()
+{
+    unsigned int nrCores = std::thread::hardware_concurrency();
+    if (nrCores <= 2) {
+        return 2;
+    }
+    return nrCores - 1;
+}
+
+/**
+ * @brief 注册客户端
+ * @param client IO线程管理器
+ */
+void IOWorkerPool::registerClient(IOThread* client)
+{
+    QWriteLocker locker(&_clientsLock);
+    if (std::find(_clients.begin(), _clients.end(), client) == _clients.end()) {
+        client->resizeQueues(std::max<size_t>(_workers.size(), 1));
+        _clients.push_back(client);
+    }
+}
+
+/**
+ * @brief 注销客户端
+ * @param client IO线程管理器
+ * @details 工作线程在读锁内取任务并增加客户端的活动任务数，
+ *          因此移除之后只需等待活动任务数归零
+ */
+void IOWorkerPool::unregisterClient(IOThread* client)
+{
+    {
+        QWriteLocker locker(&_clientsLock);
+        std::vector<IOThread*>::iterator it = std::find(_clients.begin(), _clients.end(), client);
+        if (it == _clients.end()) {
+            return;
+        }
+        _clients.erase(it);
+    }
+    while (!client->isIdle()) {
+        QThread::yieldCurrentThread();
+    }
+}
+
+/**
+ * @brief 通知有新任务
+ * @param nrJobs 任务数
+ * @details 先计数再唤醒，与getJob中加锁后再检查计数的顺序配合，避免丢失唤醒
+ */
+void IOWorkerPool::jobsAdded(unsigned int nrJobs)
+{
+    PipelineProfiler::setGauge(PipelineProfiler::IOQueueDepth, _nrJobs += nrJobs);
+    QMutexLocker locker(&_waitMutex);
+    if (nrJobs == 1) {
+        _condition.wakeOne();
+    }
+    else {
+        _condition.wakeAll();
+    }
+}
+
+/**
+ * @brief 记录移除的任务
+ * @param nrJobs 任务数
+ */
+void IOWorkerPool::jobsRemoved(unsigned int nrJobs)
+{
+    PipelineProfiler::setGauge(PipelineProfiler::IOQueueDepth, _nrJobs -= nrJobs);
+}
+
+/**
+ * @brief 从客户端中取出一个任务
+ * @param queueIndex 队列索引
+ * @param client 输出任务所属的客户端
+ * @return 任务指针，没有任务时返回NULL
+ */
+ThreadJob* IOWorkerPool::takeJob(unsigned int queueIndex, IOThread*& client)
+{
+    QReadLocker locker(&_clientsLock);
+    const unsigned int nrClients = _clients.size();
+    if (nrClients == 0) {
+        return NULL;
+    }
+    const unsigned int first = _nextClient++;
+    for (int pass = 0; pass < 2; ++pass) {
+        const bool includeDeferred = pass == 1;
+        for (unsigned int i = 0; i < nrClients; ++i) {
+            IOThread* candidate = _clients[(first + i) % nrClients];
+            if (ThreadJob* job = candidate->takeJob(queueIndex, includeDeferred)) {
+                PipelineProfiler::setGauge(PipelineProfiler::IOQueueDepth, --_nrJobs);
+                client = candidate;
+                return job;
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 获取任务
+ * @param worker 工作线程
+ * @param client 输出任务所属的客户端
+ * @return 任务指针，已中止则返回NULL
+ * @details 取不到任务时在条件变量上等待；等待前在_waitMutex保护下再次检查任务数
+ */
+ThreadJob* IOWorkerPool::getJob(IOWorker* worker, IOThread*& client)
+{
+    forever {
+        if (_abort || worker->isAborted()) {
+            return NULL;
+        }
+        if (ThreadJob* job = takeJob(worker->getQueueIndex(), client)) {
+            return job;
+        }
+        _waitMutex.lock();
+        if (_nrJobs == 0 && !_abort && !worker->isAborted()) {
+            _threadsWaiting++;
+            _condition.wait(&_waitMutex);
+            _threadsWaiting--;
+        }
+        _waitMutex.unlock();
+    }
+}
+
+/**
+ * @brief 唤醒所有等待的工作线程
+ */
+void IOWorkerPool::wakeAll()
+{
+    QMutexLocker locker(&_waitMutex);
+    _condition.wakeAll();
+}
+
+/**
+ * @brief 调整工作线程数量
+ * @param nrThreads 新的线程数量，0表示按CPU核数自动确定
+ * @details 减少线程时先停止多余线程，再调整客户端的队列数，被停止的线程取出但未执行的任务由客户端重新投放
+ */
+void IOWorkerPool::setNumberOfThreads(unsigned int nrThreads)
+{
+    if (nrThreads == 0) {
+        nrThreads = defaultNumberOfThreads();
+    }
+    if (_abort || nrThreads == _workers.size()) {
+        return;
+    }
+    if (nrThreads > _workers.size()) {
+        unsigned int firstNewWorker = _workers.size();
+        {
+            QWriteLocker locker(&_clientsLock);
+            for (auto client : _clients) {
+                client->resizeQueues(nrThreads);
+            }
+            for (unsigned int i = firstNewWorker; i < nrThreads; ++i) {
+                _workers.push_back(new IOWorker(this, i));
+            }
+        }
+        for (unsigned int i = firstNewWorker; i < nrThreads; ++i) {
+            _workers[i]->start(QThread::HighPriority);
+        }
+        return;
+    }
+
+    while (_workers.size() > nrThreads) {
+        IOWorker* worker = _workers.back();
+        // 等待检查中止标志与进入等待都在_waitMutex内完成，中止后唤醒一次即可，不必循环唤醒
+        worker->abort();
+        wakeAll();
+        worker->wait();
+        {
+            QWriteLocker locker(&_clientsLock);
+            _workers.pop_back();
+        }
+        delete worker;
+    }
+    {
+        QWriteLocker locker(&_clientsLock);
+        for (auto client : _clients) {
+            client->resizeQueues(nrThreads);
+        }
+    }
+    wakeAll();
+}
+
+/**
+ * @brief 停止所有工作线程
+ * @details 客户端队列中剩余的任务由各IOThread在关闭时释放
+ */
+void IOWorkerPool::shutdown()
+{
+    _abort = true;
+    std::vector<IOWorker*> workers;
+    {
+        QWriteLocker locker(&_clientsLock);
+        workers.swap(_workers);
+    }
+    for (auto worker : workers) {
+        worker->abort();
+    }
+    wakeAll();
+    for (auto worker : workers) {
+        worker->wait();
+        delete worker;
+    }
+}
+
+/**
+ * @brief 获取所有工作线程
+ * @return 工作线程数组
+ */
+std::vector<IOWorker*> IOWorkerPool::getWorkers() const
+{
+    QReadLocker locker(&_clientsLock);
+    return _workers;
+}
+
+/**
+ * @brief 获取工作线程数量
+ * @return 线程数
+ */
+unsigned int IOWorkerPool::getNumberOfThreads() const
+{
+    QReadLocker locker(&_clientsLock);
+    return _workers.size();
+}
+
+/**
+ * @brief 获取等待中的工作线程数量
+ * @return 线程数
+ */
+unsigned int IOWorkerPool::getWaitingThreads() const
+{
+    return _threadsWaiting;
+}
+
+/**
+ * @brief 获取已注册的客户端数量
+ * @return 客户端数
+ */
+unsigned int IOWorkerPool::getNumberOfClients() const
+{
+    QReadLocker locker(&_clientsLock);
+    return _clients.size();
+}
@@ -0,0 +1,167 @@
+﻿/**
+ * @file    IOWorkerPool.h
+ * @brief   全局IO工作线程池
+ * @author  [JianZhang]
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 所有IOThread共享同一组IOWorker线程，同时打开多个切片时线程数不随视图数增长
+ * @see     IOThread, IOWorker
+ */
+
+#pragma once
+#include <QObject>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QWaitCondition>
+#include <atomic>
+#include <vector>
+
+class IOThread;
+class IOWorker;
+class ThreadJob;
+
+/**
+ * @class  IOWorkerPool
+ * @brief  全局IO工作线程池
+ * @details 单例。每个IOThread作为客户端注册，保存自己的任务队列和渲染设置；
+ *          工作线程按轮询顺序依次从各客户端取任务，保证并排显示的多个视图公平地分享线程：
+ *          先在所有客户端中查找显示任务，都没有时再取后台任务（区域分析、导出等），
+ *          因此一个视图的后台任务不会拖慢另一个视图的瓦片加载。
+ *
+ *          客户端注销时等待它正在执行的任务完成，之后工作线程不会再访问该客户端。
+ *
+ * @example
+ *          // IOThread在构造时注册，析构时注销
+ *          IOWorkerPool::instance()->registerClient(this);
+ *          IOWorkerPool::instance()->unregisterClient(this);
+ */
+class IOWorkerPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief   获取单例
+     * @return  线程池，首次调用时按defaultNumberOfThreads()创建工作线程，应用程序退出时停止
+     */
+    static IOWorkerPool* instance();
+
+    /**
+     * @brief   注册客户端
+     * @param   client IO线程管理器，其队列数调整为当前工作线程数
+     */
+    void registerClient(IOThread* client);
+
+    /**
+     * @brief   注销客户端
+     * @details 从轮询列表中移除后等待该客户端正在执行的任务完成，返回后工作线程不再访问client
+     * @param   client IO线程管理器
+     */
+    void unregisterClient(IOThread* client);
+
+    /**
+     * @brief   通知有新任务
+     * @param   nrJobs 新投放的任务数
+     * @details 由客户端在任务入队后调用，唤醒等待的工作线程
+     */
+    void jobsAdded(unsigned int nrJobs = 1);
+
+    /**
+     * @brief   记录从客户端队列中移除但未执行的任务
+     * @param   nrJobs 移除的任务数
+     */
+    void jobsRemoved(unsigned int nrJobs);
+
+    /**
+     * @brief   为工作线程获取一个任务
+     * @param   worker 请求任务的工作线程
+     * @param   client 输出任务所属的客户端，客户端的活动任务数已经加一
+     * @return  任务对象指针，线程池或该工作线程被中止时返回NULL
+     * @details 没有任务时阻塞等待
+     */
+    ThreadJob* getJob(IOWorker* worker, IOThread*& client);
+
+    /**
+     * @brief   调整工作线程数量
+     * @details 增加时创建并启动新的工作线程；减少时停止多余的工作线程，
+     *          并让所有客户端把对应队列中的任务转移到剩余队列
+     * @param   nrThreads 新的工作线程数量，0表示使用defaultNumberOfThreads()
+     * @note    只能在GUI线程中调用，对所有视图生效
+     */
+    void setNumberOfThreads(unsigned int nrThreads);
+
+    /**
+     * @brief   获取默认工作线程数量
+     * @details 根据std::thread::hardware_concurrency()确定，为GUI线程保留一个核心，最少2个
+     * @return  默认工作线程数量
+     */
+    static unsigned int defaultNumberOfThreads();
+
+    /** @brief 获取所有工作线程 */
+    std::vector<IOWorker*> getWorkers() const;
+
+    /** @brief 获取工作线程数量 */
+    unsigned int getNumberOfThreads() const;
+
+    /** @brief 获取等待中的工作线程数量 */
+    unsigned int getWaitingThreads() const;
+
+    /** @brief 获取已注册的客户端数量 */
+    unsigned int getNumberOfClients() const;
+
+public slots:
+    /**
+     * @brief   停止所有工作线程
+     * @details 应用程序退出前调用，之后投放的任务不再执行
+     */
+    void shutdown();
+
+private:
+    /**
+     * @brief   构造函数
+     * @param   nrThreads 工作线程数量
+     */
+    explicit IOWorkerPool(unsigned int nrThreads);
+
+    /** @brief 析构函数 */
+    ~IOWorkerPool();
+
+    /**
+     * @brief   从客户端中取出一个任务
+     * @param   queueIndex 工作线程的队列索引
+     * @param   client 输出任务所属的客户端
+     * @return  任务，所有客户端都没有任务时返回NULL
+     * @details 从轮询位置开始，先取显示任务、后取后台任务
+     */
+    ThreadJob* takeJob(unsigned int queueIndex, IOThread*& client);
+
+    /** @brief 唤醒所有等待的工作线程 */
+    void wakeAll();
+
+    /** @brief 已注册的客户端 */
+    std::vector<IOThread*> _clients;
+
+    /** @brief 保护_clients，工作线程取任务时加读锁，注册和注销时加写锁 */
+    mutable QReadWriteLock _clientsLock;
+
+    /** @brief 工作线程，只在GUI线程中修改 */
+    std::vector<IOWorker*> _workers;
+
+    /** @brief 所有客户端队列中的任务总数 */
+    std::atomic<unsigned int> _nrJobs;
+
+    /** @brief 下一次取任务时首先检查的客户端 */
+    std::atomic<unsigned int> _nextClient;
+
+    /** @brief 等待中的工作线程数量 */
+    std::atomic<unsigned int> _threadsWaiting;
+
+    /** @brief 线程池中止标志 */
+    std::atomic<bool> _abort;
+
+    /** @brief 保护等待计数和条件变量的互斥锁 */
+    QMutex _waitMutex;
+
+    /** @brief 工作线程等待任务的条件变量 */
+    QWaitCondition _condition;
+};
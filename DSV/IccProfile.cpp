@@ -0,0 +1,397 @@
+﻿/**
+ * @file IccProfile.cpp
+ * @brief ICC颜色配置文件实现文件
+ * @details 实现ICC配置文件头和标签表的解析、curv/para曲线、lut8Type/lut16Type查找表、
+ *          矩阵/TRC求值，以及PCS到sRGB的转换和3D查找表编译
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "IccProfile.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+    /** @brief 配置文件头长度，标签数紧随其后 */
+    const unsigned long long kHeaderSize = 128;
+
+    /** @brief 标签表最大条目数，超出时视为损坏 */
+    const unsigned int kMaxTags = 1024;
+
+    /**
+     * @brief 四字符签名
+     */
+    constexpr unsigned int signature(char a, char b, char c, char d) {
+        return (static_cast<unsigned int>(a) << 24) | (static_cast<unsigned int>(b) << 16) | (static_cast<unsigned int>(c) << 8) | static_cast<unsigned int>(d);
+    }
+
+    /** @brief 读取大端序16位无符号数 */
+    unsigned int readU16(const unsigned char* p) {
+        return (static_cast<unsigned int>(p[0]) << 8) | p[1];
+    }
+
+    /** @brief 读取大端序32位无符号数 */
+    unsigned int readU32(const unsigned char* p) {
+        return (static_cast<unsigned int>(p[0]) << 24) | (static_cast<unsigned int>(p[1]) << 16) | (static_cast<unsigned int>(p[2]) << 8) | p[3];
+    }
+
+    /** @brief 读取s15Fixed16Number */
+    double readS15Fixed16(const unsigned char* p) {
+        return static_cast<int>(readU32(p)) / 65536.;
+    }
+
+    /**
+     * @brief PCS（D50 XYZ）到线性sRGB的矩阵
+     * @details sRGB原色在Bradford色适应到D50后的逆矩阵，D50白点映射为(1, 1, 1)
+     */
+    const double kXYZD50ToLinearSRGB[9] = {
+        3.1338561, -1.6168667, -0.4906146,
+        -0.9787684, 1.9161415, 0.0334540,
+        0.0719453, -0.2289914, 1.4052427
+    };
+
+    /**
+     * @brief sRGB传递函数，线性值编码为显示值
+     */
+    double encodeSRGB(double linear) {
+        linear = std::max(0., std::min(linear, 1.));
+        return linear <= 0.0031308 ? 12.92 * linear : 1.055 * std::pow(linear, 1. / 2.4) - 0.055;
+    }
+
+    /**
+     * @brief CIE Lab的逆非线性函数
+     */
+    double labInverse(double t) {
+        const double delta = 6. / 29.;
+        return t > delta ? t * t * t : 3. * delta * delta * (t - 4. / 29.);
+    }
+
+    /**
+     * @brief 检查[offset, offset + length)是否位于配置文件内
+     */
+    bool inRange(unsigned long long size, unsigned long long offset, unsigned long long length) {
+        return offset <= size && length <= size - offset;
+    }
+}
+
+double IccProfile::Curve::evaluate(double x) const
+{
+    x = std::max(0., std::min(x, 1.));
+    if (!table.empty()) {
+        if (table.size() == 1) {
+            return table[0];
+        }
+        const double position = x * (table.size() - 1);
+        const size_t index = std::min(static_cast<size_t>(position), table.size() - 2);
+        const double fraction = position - index;
+        return table[index] + (table[index + 1] - table[index]) * fraction;
+    }
+    const double g = params[0], a = params[1], b = params[2], c = params[3], d = params[4], e = params[5], f = params[6];
+    double y = 0.;
+    switch (type) {
+    case 1:
+        y = (a != 0. && x >= -b / a) ? std::pow(std::max(a * x + b, 0.), g) : 0.;
+        break;
+    case 2:
+        y = (a != 0. && x >= -b / a) ? std::pow(std::max(a * x + b, 0.), g) + c : c;
+        break;
+    case 3:
+        y = x >= d ? std::pow(std::max(a * x + b, 0.), g) : c * x;
+        break;
+    case 4:
+        y = x >= d ? std::pow(std::max(a * x + b, 0.), g) + e : c * x + f;
+        break;
+    default:
+        y = std::pow(x, g);
+        break;
+    }
+    return std::max(0., std::min(y, 1.));
+}
+
+/**
+ * @brief 读取curv或para曲线
+ * @param data 配置文件
+ * @param size 配置文件大小
+ * @param offset 标签数据偏移
+ * @param curve 输出的曲线
+ * @return 标签有效时返回true
+ */
+bool IccProfile::readCurve(const unsigned char* data, unsigned long long size, unsigned long long offset, Curve& curve)
+{
+    if (!inRange(size, offset, 12)) {
+        return false;
+    }
+    const unsigned int type = readU32(data + offset);
+    if (type == signature('c', 'u', 'r', 'v')) {
+        const unsigned long long count = readU32(data + offset + 8);
+        if (count == 0) {
+            curve.type = 0;
+            curve.params[0] = 1.;
+            return true;
+        }
+        if (!inRange(size, offset + 12, count * 2)) {
+            return false;
+        }
+        if (count == 1) {
+            // u8Fixed8Number表示的伽马
+            curve.type = 0;
+            curve.params[0] = readU16(data + offset + 12) / 256.;
+            return true;
+        }
+        curve.table.resize(static_cast<size_t>(count));
+        for (unsigned long long i = 0; i < count; ++i) {
+            curve.table[i] = readU16(data + offset + 12 + i * 2) / 65535.;
+        }
+        return true;
+    }
+    if (type == signature('p', 'a', 'r', 'a')) {
+        static const unsigned int kParameterCounts[] = { 1, 3, 4, 5, 7 };
+        const unsigned int function = readU16(data + offset + 8);
+        if (function > 4 || !inRange(size, offset + 12, kParameterCounts[function] * 4)) {
+            return false;
+        }
+        curve.type = static_cast<int>(function);
+        for (unsigned int i = 0; i < kParameterCounts[function]; ++i) {
+            curve.params[i] = readS15Fixed16(data + offset + 12 + i * 4);
+        }
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 读取lut8Type或lut16Type的A2B0
+ * @param data 配置文件
+ * @param size 配置文件大小
+ * @param offset 标签数据偏移
+ * @param length 标签长度
+ * @return 为3输入3输出的查找表时返回true
+ * @details 矩阵只用于XYZ输入，RGB输入的A2B0忽略矩阵
+ */
+bool IccProfile::readLut(const unsigned char* data, unsigned long long size, unsigned long long offset, unsigned long long length)
+{
+    if (!inRange(size, offset, length) || length < 48) {
+        return false;
+    }
+    const unsigned int type = readU32(data + offset);
+    const bool lut16 = type == signature('m', 'f', 't', '2');
+    if (!lut16 && type != signature('m', 'f', 't', '1')) {
+        return false;
+    }
+    const unsigned int inputChannels = data[offset + 8];
+    const unsigned int outputChannels = data[offset + 9];
+    const unsigned int gridPoints = data[offset + 10];
+    if (inputChannels != 3 || outputChannels != 3 || gridPoints < 2) {
+        return false;
+    }
+    unsigned long long position = offset + 48;
+    unsigned long long inputEntries = 256, outputEntries = 256;
+    if (lut16) {
+        if (length < 52) {
+            return false;
+        }
+        inputEntries = readU16(data + offset + 48);
+        outputEntries = readU16(data + offset + 50);
+        position = offset + 52;
+        if (inputEntries < 2 || outputEntries < 2) {
+            return false;
+        }
+    }
+    const unsigned int sampleBytes = lut16 ? 2 : 1;
+    const double scale = lut16 ? 65535. : 255.;
+    const unsigned long long clutEntries = static_cast<unsigned long long>(gridPoints) * gridPoints * gridPoints * 3;
+    const unsigned long long needed = (3 * inputEntries + clutEntries + 3 * outputEntries) * sampleBytes;
+    if (!inRange(size, position, needed) || position + needed > offset + length) {
+        return false;
+    }
+    auto sample = [&](unsigned long long index) {
+        const unsigned char* p = data + position + index * sampleBytes;
+        return (lut16 ? readU16(p) : *p) / scale;
+    };
+    for (unsigned int c = 0; c < 3; ++c) {
+        _inputCurves[c].table.resize(static_cast<size_t>(inputEntries));
+        for (unsigned long long i = 0; i < inputEntries; ++i) {
+            _inputCurves[c].table[i] = sample(c * inputEntries + i);
+        }
+    }
+    const unsigned long long clutStart = 3 * inputEntries;
+    _clut.resize(static_cast<size_t>(clutEntries));
+    for (unsigned long long i = 0; i < clutEntries; ++i) {
+        _clut[i] = sample(clutStart + i);
+    }
+    const unsigned long long outputStart = clutStart + clutEntries;
+    for (unsigned int c = 0; c < 3; ++c) {
+        _outputCurves[c].table.resize(static_cast<size_t>(outputEntries));
+        for (unsigned long long i = 0; i < outputEntries; ++i) {
+            _outputCurves[c].table[i] = sample(outputStart + c * outputEntries + i);
+        }
+    }
+    _gridPoints = gridPoints;
+    _lut16 = lut16;
+    return true;
+}
+
+/**
+ * @brief 解析ICC配置文件
+ * @param data 配置文件的原始字节
+ * @return 解析成功时返回配置文件，否则返回空指针
+ * @details A2B0优先于矩阵/TRC，与ICC规范对相对色度意图的规定一致
+ */
+std::shared_ptr<IccProfile> IccProfile::parse(const std::vector<unsigned char>& data)
+{
+    const unsigned char* p = data.data();
+    unsigned long long size = data.size();
+    if (size < kHeaderSize + 4 || readU32(p + 36) != signature('a', 'c', 's', 'p') || readU32(p + 16) != signature('R', 'G', 'B', ' ')) {
+        return std::shared_ptr<IccProfile>();
+    }
+    // 头中的大小比实际数据小时以头为准，忽略尾部多余的字节
+    size = std::min<unsigned long long>(size, std::max<unsigned long long>(readU32(p), kHeaderSize + 4));
+    const unsigned int pcs = readU32(p + 20);
+    if (pcs != signature('X', 'Y', 'Z', ' ') && pcs != signature('L', 'a', 'b', ' ')) {
+        return std::shared_ptr<IccProfile>();
+    }
+    const unsigned int tagCount = readU32(p + kHeaderSize);
+    if (tagCount > kMaxTags || !inRange(size, kHeaderSize + 4, static_cast<unsigned long long>(tagCount) * 12)) {
+        return std::shared_ptr<IccProfile>();
+    }
+
+    std::shared_ptr<IccProfile> profile(new IccProfile());
+    profile->_pcsLab = pcs == signature('L', 'a', 'b', ' ');
+    const unsigned int xyzTags[3] = { signature('r', 'X', 'Y', 'Z'), signature('g', 'X', 'Y', 'Z'), signature('b', 'X', 'Y', 'Z') };
+    const unsigned int trcTags[3] = { signature('r', 'T', 'R', 'C'), signature('g', 'T', 'R', 'C'), signature('b', 'T', 'R', 'C') };
+    unsigned long long a2b0Offset = 0, a2b0Length = 0;
+    unsigned long long xyzOffsets[3] = { 0, 0, 0 }, trcOffsets[3] = { 0, 0, 0 };
+    for (unsigned int i = 0; i < tagCount; ++i) {
+        const unsigned char* entry = p + kHeaderSize + 4 + i * 12;
+        const unsigned int tag = readU32(entry);
+        const unsigned long long offset = readU32(entry + 4);
+        const unsigned long long length = readU32(entry + 8);
+        if (!inRange(size, offset, length)) {
+            continue;
+        }
+        if (tag == signature('A', '2', 'B', '0')) {
+            a2b0Offset = offset;
+            a2b0Length = length;
+        }
+        for (unsigned int c = 0; c < 3; ++c) {
+            if (tag == xyzTags[c] && length >= 20) {
+                xyzOffsets[c] = offset;
+            }
+            if (tag == trcTags[c]) {
+                trcOffsets[c] = offset;
+            }
+        }
+    }
+
+    if (a2b0Length > 0 && profile->readLut(p, size, a2b0Offset, a2b0Length)) {
+        profile->_useLut = true;
+        return profile;
+    }
+    for (unsigned int c = 0; c < 3; ++c) {
+        if (xyzOffsets[c] == 0 || trcOffsets[c] == 0 || readU32(p + xyzOffsets[c]) != signature('X', 'Y', 'Z', ' ') ||
+            !readCurve(p, size, trcOffsets[c], profile->_inputCurves[c])) {
+            return std::shared_ptr<IccProfile>();
+        }
+        // 第c个原色的XYZ是矩阵的第c列
+        for (unsigned int row = 0; row < 3; ++row) {
+            profile->_matrix[row * 3 + c] = readS15Fixed16(p + xyzOffsets[c] + 8 + row * 4);
+        }
+    }
+    return profile;
+}
+
+/**
+ * @brief 把PCS编码的归一化值解码为D50 XYZ
+ * @param pcs 查找表输出，0-1
+ * @param xyz 输出的XYZ
+ * @details lut16Type沿用v2的Lab编码（L = 100 * v / 0xFF00），XYZ为u1Fixed15Number
+ */
+void IccProfile::pcsToXYZ(const double* pcs, double* xyz) const
+{
+    if (_pcsLab) {
+        const double scale = _lut16 ? 65535. / 65280. : 1.;
+        const double L = pcs[0] * scale * 100.;
+        const double a = pcs[1] * scale * 255. - 128.;
+        const double b = pcs[2] * scale * 255. - 128.;
+        const double fy = (L + 16.) / 116.;
+        xyz[0] = 0.9642 * labInverse(fy + a / 500.);
+        xyz[1] = labInverse(fy);
+        xyz[2] = 0.8249 * labInverse(fy - b / 200.);
+    }
+    else {
+        for (unsigned int c = 0; c < 3; ++c) {
+            xyz[c] = pcs[c] * 65535. / 32768.;
+        }
+    }
+}
+
+/**
+ * @brief 把设备RGB转换为sRGB
+ * @param rgb 设备RGB
+ * @param srgb 输出的sRGB
+ */
+void IccProfile::toSRGB(const double* rgb, double* srgb) const
+{
+    double values[3];
+    for (unsigned int c = 0; c < 3; ++c) {
+        values[c] = _inputCurves[c].evaluate(rgb[c]);
+    }
+    double xyz[3] = { 0., 0., 0. };
+    if (_useLut) {
+        // CLUT三线性插值，第一个输入变化最慢
+        const unsigned int n = _gridPoints;
+        unsigned int index[3];
+        double fraction[3];
+        for (unsigned int c = 0; c < 3; ++c) {
+            const double position = std::max(0., std::min(values[c], 1.)) * (n - 1);
+            index[c] = std::min(static_cast<unsigned int>(position), n - 2);
+            fraction[c] = position - index[c];
+        }
+        double pcs[3] = { 0., 0., 0. };
+        for (unsigned int corner = 0; corner < 8; ++corner) {
+            double weight = 1.;
+            size_t node = 0;
+            for (unsigned int c = 0; c < 3; ++c) {
+                const unsigned int bit = (corner >> (2 - c)) & 1;
+                weight *= bit ? fraction[c] : 1. - fraction[c];
+                node = node * n + index[c] + bit;
+            }
+            for (unsigned int c = 0; c < 3; ++c) {
+                pcs[c] += weight * _clut[node * 3 + c];
+            }
+        }
+        for (unsigned int c = 0; c < 3; ++c) {
+            pcs[c] = _outputCurves[c].evaluate(pcs[c]);
+        }
+        pcsToXYZ(pcs, xyz);
+    }
+    else {
+        for (unsigned int row = 0; row < 3; ++row) {
+            xyz[row] = _matrix[row * 3] * values[0] + _matrix[row * 3 + 1] * values[1] + _matrix[row * 3 + 2] * values[2];
+        }
+    }
+    for (unsigned int row = 0; row < 3; ++row) {
+        srgb[row] = encodeSRGB(kXYZD50ToLinearSRGB[row * 3] * xyz[0] + kXYZD50ToLinearSRGB[row * 3 + 1] * xyz[1] + kXYZD50ToLinearSRGB[row * 3 + 2] * xyz[2]);
+    }
+}
+
+/**
+ * @brief 把配置文件编译为到sRGB的3D查找表
+ * @param data 配置文件的原始字节
+ * @return 查找表，不需要变换时返回空指针
+ */
+std::shared_ptr<const PixelConversion::ColorLUT3D> IccProfile::compileToSRGB(const std::vector<unsigned char>& data)
+{
+    std::shared_ptr<IccProfile> profile = data.empty() ? std::shared_ptr<IccProfile>() : parse(data);
+    if (!profile) {
+        return std::shared_ptr<const PixelConversion::ColorLUT3D>();
+    }
+    std::shared_ptr<PixelConversion::ColorLUT3D> lut = std::make_shared<PixelConversion::ColorLUT3D>();
+    PixelConversion::buildColorLUT3D(*lut, [&profile](const double* rgb, double* result) { profile->toSRGB(rgb, result); });
+    if (PixelConversion::isIdentity(*lut)) {
+        return std::shared_ptr<const PixelConversion::ColorLUT3D>();
+    }
+    return lut;
+}
@@ -0,0 +1,121 @@
+﻿/**
+ * @file    IccProfile.h
+ * @brief   ICC颜色配置文件类，把切片的设备RGB转换到sRGB显示
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了不依赖外部颜色管理库的ICC配置文件解析和求值，包括：
+ *          - 矩阵/TRC配置文件（rXYZ、gXYZ、bXYZ加rTRC、gTRC、bTRC，曲线为curv或para）
+ *          - 基于查找表的A2B0（lut8Type、lut16Type），PCS为XYZ或Lab
+ *          - PCS（D50）到sRGB的转换，相对色度意图
+ *          - 编译为PixelConversion::ColorLUT3D，显示时不再逐像素求值配置文件
+ *
+ * @note    lutAtoBType（v4 mAB）的A2B0被忽略，有矩阵/TRC标签时退回矩阵/TRC，否则视为不支持
+ * @see     PixelConversion::ColorLUT3D, MultiResolutionImage::getICCProfile
+ */
+
+#pragma once
+
+#include "PixelConversion.h"
+#include <memory>
+#include <vector>
+
+/**
+ * @class  IccProfile
+ * @brief  解析后的RGB输入ICC配置文件
+ * @details 配置文件为大端序，解析时对所有偏移做越界检查，损坏或不支持的配置文件返回空指针。
+ *          求值顺序与ICC规范一致：
+ *          - 矩阵/TRC：XYZ = M * (TRC_r(r), TRC_g(g), TRC_b(b))
+ *          - lut8/lut16：输入曲线、三线性CLUT、输出曲线，结果按PCS编码解码为XYZ
+ *          之后按Bradford适应的D50到sRGB矩阵和sRGB传递函数得到显示值。
+ *
+ * @note   创建后不再修改，可在多个线程中同时求值
+ *
+ * @example
+ * @code
+ * std::shared_ptr<const PixelConversion::ColorLUT3D> lut = IccProfile::compileToSRGB(img->getICCProfile());
+ * if (lut) {
+ *     PixelConversion::applyColorLUT3D(pixels, nrPixels, *lut);
+ * }
+ * @endcode
+ */
+class IccProfile
+{
+public:
+    /**
+     * @brief   解析ICC配置文件
+     * @param   data 配置文件的原始字节
+     * @return  设备颜色空间为RGB且包含支持的A2B0或矩阵/TRC标签时返回配置文件，否则返回空指针
+     */
+    static std::shared_ptr<IccProfile> parse(const std::vector<unsigned char>& data);
+
+    /**
+     * @brief   把配置文件编译为到sRGB的3D查找表
+     * @param   data 配置文件的原始字节
+     * @return  查找表；配置文件为空、不支持或变换近似恒等（例如sRGB配置文件）时返回空指针
+     * @see     PixelConversion::buildColorLUT3D, PixelConversion::isIdentity
+     */
+    static std::shared_ptr<const PixelConversion::ColorLUT3D> compileToSRGB(const std::vector<unsigned char>& data);
+
+    /**
+     * @brief   把设备RGB转换为sRGB
+     * @param   rgb 设备RGB，0-1
+     * @param   srgb 输出的sRGB，0-1，超出色域的值被限制
+     */
+    void toSRGB(const double* rgb, double* srgb) const;
+
+private:
+    /**
+     * @brief 一维曲线
+     * @details table非空时按等间距采样线性插值，否则按参数曲线求值；type为0时即 y = x ^ gamma
+     */
+    struct Curve {
+        std::vector<double> table;
+        int type = 0;
+        double params[7] = { 1., 1., 0., 0., 0., 0., 0. };
+        double evaluate(double x) const;
+    };
+
+    IccProfile() = default;
+
+    /**
+     * @brief   读取curv或para曲线
+     * @return  标签有效时返回true
+     */
+    static bool readCurve(const unsigned char* data, unsigned long long size, unsigned long long offset, Curve& curve);
+
+    /**
+     * @brief   读取lut8Type或lut16Type的A2B0
+     * @return  为3输入3输出的查找表时返回true
+     */
+    bool readLut(const unsigned char* data, unsigned long long size, unsigned long long offset, unsigned long long length);
+
+    /**
+     * @brief   把PCS编码的归一化值解码为D50 XYZ
+     */
+    void pcsToXYZ(const double* pcs, double* xyz) const;
+
+    /** @brief 是否使用A2B0查找表，否则使用矩阵/TRC */
+    bool _useLut = false;
+
+    /** @brief PCS为Lab，否则为XYZ */
+    bool _pcsLab = false;
+
+    /** @brief 查找表为lut16Type（影响PCS编码），否则为lut8Type */
+    bool _lut16 = false;
+
+    /** @brief 矩阵/TRC的设备RGB到XYZ矩阵，按行存放 */
+    double _matrix[9] = { 0. };
+
+    /** @brief 矩阵/TRC的三条色调曲线，或查找表的输入曲线 */
+    Curve _inputCurves[3];
+
+    /** @brief 查找表的输出曲线 */
+    Curve _outputCurves[3];
+
+    /** @brief 查找表每个方向的网格点数 */
+    unsigned int _gridPoints = 0;
+
+    /** @brief 查找表网格，归一化到0-1，每个网格点3个输出 */
+    std::vector<double> _clut;
+};
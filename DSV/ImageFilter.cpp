@@ -21,18 +21,18 @@ void ImageFilter::initUi()
 	this->setMaximumSize(300, 700);
 	QVBoxLayout* mainLayout = new QVBoxLayout(this);
 
-	QCheckBox* Guass = new QCheckBox(QStringLiteral("高斯滤波"),this);
-	Guass->setObjectName(QStringLiteral("GuassFilter"));
-	Guass->setFixedHeight(30);
-	QFont fontsize = Guass->font();
+	m_GaussCheck = new QCheckBox(QStringLiteral("高斯滤波"),this);
+	m_GaussCheck->setObjectName(QStringLiteral("GuassFilter"));
+	m_GaussCheck->setFixedHeight(30);
+	QFont fontsize = m_GaussCheck->font();
 	fontsize.setPointSizeF(20);
-	Guass->setFont(fontsize);
+	m_GaussCheck->setFont(fontsize);
 
 	
-	QCheckBox* Sharp = new QCheckBox(QStringLiteral("锐化"), this);
-	Sharp->setObjectName(QStringLiteral("SharpFilter"));
-	Sharp->setFixedHeight(30);
-	Sharp->setFont(fontsize);
+	m_SharpCheck = new QCheckBox(QStringLiteral("锐化"), this);
+	m_SharpCheck->setObjectName(QStringLiteral("SharpFilter"));
+	m_SharpCheck->setFixedHeight(30);
+	m_SharpCheck->setFont(fontsize);
 
 
 	QHBoxLayout* H3 = new QHBoxLayout(this);
@@ -42,11 +42,11 @@ void ImageFilter::initUi()
 	m_SharpSlider->setOrientation(Qt::Horizontal);
 	m_SharpSlider->setFixedHeight(30);
 	
-	//m_SharpSlider->setEnabled(false);
+	m_SharpSlider->setEnabled(false);
 	m_SharpSlider->setRange(0, 200);
 	m_LineEdit = new QLineEdit(this);
 	m_LineEdit->setObjectName(QStringLiteral("ValueOfSharp"));
-	//m_LineEdit->setEnabled(false);
+	m_LineEdit->setEnabled(false);
 	m_LineEdit->setFixedHeight(30);
 	m_LineEdit->setStyleSheet(R"(
         QLineEdit {
@@ -62,9 +62,12 @@ void ImageFilter::initUi()
 	H3->addWidget(m_SharpSlider,3);
 	H3->addWidget(m_LineEdit,1);
 
-	mainLayout->addWidget(Guass);
-	mainLayout->addWidget(Sharp);
+	mainLayout->addWidget(m_GaussCheck);
+	mainLayout->addWidget(m_SharpCheck);
 	mainLayout->addLayout(H3);
+	m_BrightnessSlider = addSliderRow(QStringLiteral("亮度"), -50, 50, 0, mainLayout);
+	m_ContrastSlider = addSliderRow(QStringLiteral("对比度"), 0, 300, 100, mainLayout);
+	m_GammaSlider = addSliderRow(QStringLiteral("伽马"), 10, 300, 100, mainLayout);
 	// 添加垂直伸缩项，让H1和H2下方有空间
 	QSpacerItem* verticalSpacer = new QSpacerItem(20, 40, QSizePolicy::Minimum, QSizePolicy::Expanding);
 	mainLayout->addItem(verticalSpacer);
@@ -87,5 +90,41 @@ void ImageFilter::initConnect()
 			m_SharpSlider->setValue(sliderNum);
 		}
 		});
+	connect(m_SharpCheck, &QCheckBox::toggled, [this](bool checked) {
+		m_SharpSlider->setEnabled(checked);
+		m_LineEdit->setEnabled(checked);
+		emitEnhancement();
+		});
+	connect(m_GaussCheck, &QCheckBox::toggled, this, &ImageFilter::emitEnhancement);
+	connect(m_SharpSlider, &QSlider::valueChanged, this, &ImageFilter::emitEnhancement);
+	connect(m_BrightnessSlider, &QSlider::valueChanged, this, &ImageFilter::emitEnhancement);
+	connect(m_ContrastSlider, &QSlider::valueChanged, this, &ImageFilter::emitEnhancement);
+	connect(m_GammaSlider, &QSlider::valueChanged, this, &ImageFilter::emitEnhancement);
+}
+
+QSlider* ImageFilter::addSliderRow(const QString& text, int minimum, int maximum, int value, QVBoxLayout* mainLayout)
+{
+	QHBoxLayout* row = new QHBoxLayout();
+	QLabel* label = new QLabel(text, this);
+	label->setFixedHeight(30);
+	QSlider* slider = new QSlider(Qt::Horizontal, this);
+	slider->setFixedHeight(30);
+	slider->setRange(minimum, maximum);
+	slider->setValue(value);
+	row->addWidget(label, 1);
+	row->addWidget(slider, 3);
+	mainLayout->addLayout(row);
+	return slider;
+}
+
+void ImageFilter::emitEnhancement()
+{
+	// 滑块值按百分比换算，锐化与高斯平滑叠加为一个反锐化掩模强度
+	float sharpness = m_SharpCheck->isChecked() ? m_SharpSlider->value() / 100.f : 0.f;
+	if (m_GaussCheck->isChecked()) {
+		sharpness -= 1.f;
+	}
+	emit enhancementChanged(sharpness, m_GammaSlider->value() / 100.f, m_BrightnessSlider->value() / 100.f,
+		m_ContrastSlider->value() / 100.f);
 }
 
@@ -81,6 +81,19 @@ public:
      */
     ~ImageFilter();
 
+signals:
+    /**
+     * @brief   增强参数改变信号
+     * @details 勾选框或任一滑块改变时发出。锐化未勾选时强度为0，勾选高斯滤波时强度减1（平滑）
+     *
+     * @param   sharpness 反锐化掩模强度，-1到2
+     * @param   gamma 伽马指数
+     * @param   brightness 亮度偏移
+     * @param   contrast 对比度
+     * @see     PathologyViewer::setEnhancement
+     */
+    void enhancementChanged(float sharpness, float gamma, float brightness, float contrast);
+
 private:
     /**
      * @brief   初始化用户界面
@@ -98,9 +111,41 @@ private:
      */
     void initConnect();
 
+    /**
+     * @brief   按当前控件状态发出enhancementChanged
+     * @see     enhancementChanged
+     */
+    void emitEnhancement();
+
+    /**
+     * @brief   创建带标签的参数滑块行
+     * @param   text 标签文字
+     * @param   minimum 最小值
+     * @param   maximum 最大值
+     * @param   value 初始值
+     * @param   mainLayout 加入的布局
+     * @return  创建的滑块
+     */
+    QSlider* addSliderRow(const QString& text, int minimum, int maximum, int value, QVBoxLayout* mainLayout);
+
+    /** @brief 高斯滤波勾选框 */
+    QCheckBox* m_GaussCheck;
+
+    /** @brief 锐化勾选框，勾选后锐化滑块生效 */
+    QCheckBox* m_SharpCheck;
+
     /** @brief 锐化滑块指针，用于控制图像锐化程度 */
     QSlider* m_SharpSlider;
 
+    /** @brief 亮度滑块，-50到50对应亮度偏移-0.5到0.5 */
+    QSlider* m_BrightnessSlider;
+
+    /** @brief 对比度滑块，0到300对应对比度0到3 */
+    QSlider* m_ContrastSlider;
+
+    /** @brief 伽马滑块，10到300对应伽马0.1到3 */
+    QSlider* m_GammaSlider;
+
     /** @brief 参数输入文本框指针，用于输入精确的处理参数 */
     QLineEdit* m_LineEdit;
 };
\ No newline at end of file
@@ -107,6 +107,14 @@ public:
      */
     virtual const std::vector<double> getSpacing() const;
 
+    /**
+     * @brief   获取数据源持有的像素数据字节数
+     * @details 用于缓存的内存统计，不持有像素数据的数据源返回0
+     *
+     * @return  像素数据的字节数
+     */
+    virtual unsigned long long getByteSize() const { return 0; }
+
     /**
      * @brief   获取图像数据的最小值
      * @details 获取指定通道或所有通道的数据最小值
@@ -0,0 +1,513 @@
+﻿/**
+ * @file AnnotationLayerItem.cpp
+ * @brief 标注图层图形项实现文件
+ * @details 该文件实现了大批量标注的显示，包括：
+ *          - 网格索引和聚类金字塔的构建
+ *          - 按屏幕尺寸选择细节层次
+ *          - 按颜色合并路径的批量绘制
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "AnnotationLayerItem.h"
+#include <QPainter>
+#include <QPainterPath>
+#include <QStyleOptionGraphicsItem>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief 构造函数
+ * @param parent 父图形项
+ * @details 默认屏幕尺寸小于0.5像素时隐藏，小于4像素画点，小于16像素画简化多边形；
+ *          聚类单元不小于48像素
+ */
+AnnotationLayerItem::AnnotationLayerItem(QGraphicsItem* parent) :
+    QGraphicsObject(parent),
+    _indexDirty(false),
+    _cellExtent(1.),
+    _gridWidth(0),
+    _gridHeight(0),
+    _visitStamp(0),
+    _hidePixels(0.5),
+    _pointPixels(4.),
+    _simplifyPixels(16.),
+    _maxIndividual(kDefaultMaxIndividual),
+    _clusterPixels(48.)
+{
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+    setZValue(9);
+}
+
+/**
+ * @brief 获取边界矩形
+ * @return 所有标注包围盒的并集
+ */
+QRectF AnnotationLayerItem::boundingRect() const
+{
+    return _bounds;
+}
+
+/**
+ * @brief 查找或加入颜色
+ * @param color 颜色
+ * @return 颜色下标
+ */
+int AnnotationLayerItem::colorIndex(const QColor& color)
+{
+    for (size_t i = 0; i < _palette.size(); ++i) {
+        if (_palette[i] == color) {
+            return static_cast<int>(i);
+        }
+    }
+    _palette.push_back(color);
+    return static_cast<int>(_palette.size() - 1);
+}
+
+/**
+ * @brief 添加一个标注
+ * @param polygon 多边形
+ * @param color 颜色
+ * @return 标注编号
+ */
+int AnnotationLayerItem::addAnnotation(const QPolygonF& polygon, const QColor& color)
+{
+    Annotation annotation;
+    annotation.polygon = polygon;
+    annotation.coarse = coarsen(polygon);
+    annotation.bounds = polygon.boundingRect();
+    annotation.color = colorIndex(color);
+    prepareGeometryChange();
+    _bounds = _annotations.empty() ? annotation.bounds : _bounds.united(annotation.bounds);
+    _annotations.push_back(annotation);
+    _indexDirty = true;
+    update(annotation.bounds);
+    return static_cast<int>(_annotations.size() - 1);
+}
+
+/**
+ * @brief 批量添加同一颜色的标注
+ * @param polygons 多边形列表
+ * @param color 颜色
+ * @details 只做一次几何变化通知，索引在下一次绘制时重建
+ */
+void AnnotationLayerItem::addAnnotations(const QVector<QPolygonF>& polygons, const QColor& color)
+{
+    if (polygons.isEmpty()) {
+        return;
+    }
+    const int index = colorIndex(color);
+    prepareGeometryChange();
+    _annotations.reserve(_annotations.size() + polygons.size());
+    for (const QPolygonF& polygon : polygons) {
+        Annotation annotation;
+        annotation.polygon = polygon;
+        annotation.coarse = coarsen(polygon);
+        annotation.bounds = polygon.boundingRect();
+        annotation.color = index;
+        _bounds = _annotations.empty() ? annotation.bounds : _bounds.united(annotation.bounds);
+        _annotations.push_back(annotation);
+    }
+    _indexDirty = true;
+    update();
+}
+
+/**
+ * @brief 删除所有标注
+ */
+void AnnotationLayerItem::clearAnnotations()
+{
+    prepareGeometryChange();
+    _annotations.clear();
+    _palette.clear();
+    _bounds = QRectF();
+    _cellOffsets.clear();
+    _cellEntries.clear();
+    _clusterLevels.clear();
+    _visited.clear();
+    _gridWidth = 0;
+    _gridHeight = 0;
+    _indexDirty = false;
+}
+
+/**
+ * @brief 获取标注数量
+ * @return 标注数量
+ */
+int AnnotationLayerItem::getNumberOfAnnotations() const
+{
+    return static_cast<int>(_annotations.size());
+}
+
+/**
+ * @brief 获取标注的多边形
+ * @param id 标注编号
+ * @return 多边形
+ */
+const QPolygonF& AnnotationLayerItem::getPolygon(int id) const
+{
+    return _annotations[id].polygon;
+}
+
+/**
+ * @brief 获取标注的颜色
+ * @param id 标注编号
+ * @return 颜色
+ */
+QColor AnnotationLayerItem::getColor(int id) const
+{
+    return _palette[_annotations[id].color];
+}
+
+/**
+ * @brief 设置细节层次阈值
+ * @param hidePixels 隐藏阈值
+ * @param pointPixels 画点阈值
+ * @param simplifyPixels 简化阈值
+ */
+void AnnotationLayerItem::setLevelOfDetail(qreal hidePixels, qreal pointPixels, qreal simplifyPixels)
+{
+    _hidePixels = hidePixels;
+    _pointPixels = pointPixels;
+    _simplifyPixels = simplifyPixels;
+    update();
+}
+
+/**
+ * @brief 设置聚类参数
+ * @param maxIndividual 可见标注数上限
+ * @param clusterPixels 聚类单元的最小屏幕像素数
+ */
+void AnnotationLayerItem::setClustering(int maxIndividual, qreal clusterPixels)
+{
+    _maxIndividual = maxIndividual;
+    _clusterPixels = clusterPixels;
+    update();
+}
+
+/**
+ * @brief 生成简化多边形
+ * @param polygon 完整多边形
+ * @return 简化多边形
+ */
+QPolygonF AnnotationLayerItem::coarsen(const QPolygonF& polygon)
+{
+    if (polygon.size() <= kCoarseVertices) {
+        return polygon;
+    }
+    QPolygonF coarse;
+    coarse.reserve(kCoarseVertices);
+    for (int i = 0; i < kCoarseVertices; ++i) {
+        coarse.append(polygon[static_cast<int>(static_cast<long long>(i) * polygon.size() / kCoarseVertices)]);
+    }
+    return coarse;
+}
+
+/**
+ * @brief 包围盒是否与矩形相交
+ * @param bounds 包围盒
+ * @param rect 矩形
+ * @return 相交或接触时返回true
+ * @details QRectF::intersects对宽或高为0的矩形总是返回false，直线和单点标注需要单独处理
+ */
+bool AnnotationLayerItem::overlaps(const QRectF& bounds, const QRectF& rect)
+{
+    return bounds.left() <= rect.right() && bounds.right() >= rect.left() &&
+        bounds.top() <= rect.bottom() && bounds.bottom() >= rect.top();
+}
+
+/**
+ * @brief 计算矩形覆盖的单元范围
+ * @return 是否与网格相交
+ */
+bool AnnotationLayerItem::cellRange(const QRectF& rect, qreal cellExtent, int width, int height, int& x0, int& y0, int& x1, int& y1) const
+{
+    if (width <= 0 || height <= 0 || !overlaps(_bounds, rect)) {
+        return false;
+    }
+    x0 = std::max(0, static_cast<int>(std::floor((rect.left() - _bounds.left()) / cellExtent)));
+    y0 = std::max(0, static_cast<int>(std::floor((rect.top() - _bounds.top()) / cellExtent)));
+    x1 = std::min(width - 1, static_cast<int>(std::floor((rect.right() - _bounds.left()) / cellExtent)));
+    y1 = std::min(height - 1, static_cast<int>(std::floor((rect.bottom() - _bounds.top()) / cellExtent)));
+    return x0 <= x1 && y0 <= y1;
+}
+
+/**
+ * @brief 重建网格索引和聚类金字塔
+ * @details 先统计每个单元的登记数再一次性填充（CSR），避免为每个单元分配数组
+ */
+void AnnotationLayerItem::rebuildIndex()
+{
+    _indexDirty = false;
+    const qreal extent = std::max(_bounds.width(), _bounds.height());
+    _cellExtent = extent > 0. ? extent / kGridResolution : 1.;
+    _gridWidth = std::max(1, std::min(kGridResolution, static_cast<int>(std::ceil(_bounds.width() / _cellExtent))));
+    _gridHeight = std::max(1, std::min(kGridResolution, static_cast<int>(std::ceil(_bounds.height() / _cellExtent))));
+    const size_t nrCells = static_cast<size_t>(_gridWidth) * _gridHeight;
+
+    _cellOffsets.assign(nrCells + 1, 0);
+    for (const Annotation& annotation : _annotations) {
+        int x0, y0, x1, y1;
+        if (cellRange(annotation.bounds, _cellExtent, _gridWidth, _gridHeight, x0, y0, x1, y1)) {
+            for (int y = y0; y <= y1; ++y) {
+                for (int x = x0; x <= x1; ++x) {
+                    ++_cellOffsets[static_cast<size_t>(y) * _gridWidth + x + 1];
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < nrCells; ++i) {
+        _cellOffsets[i + 1] += _cellOffsets[i];
+    }
+    _cellEntries.resize(_cellOffsets[nrCells]);
+    std::vector<unsigned int> fill(_cellOffsets.begin(), _cellOffsets.end() - 1);
+    for (size_t id = 0; id < _annotations.size(); ++id) {
+        int x0, y0, x1, y1;
+        if (cellRange(_annotations[id].bounds, _cellExtent, _gridWidth, _gridHeight, x0, y0, x1, y1)) {
+            for (int y = y0; y <= y1; ++y) {
+                for (int x = x0; x <= x1; ++x) {
+                    _cellEntries[fill[static_cast<size_t>(y) * _gridWidth + x]++] = static_cast<int>(id);
+                }
+            }
+        }
+    }
+    _visited.assign(_annotations.size(), 0);
+    _visitStamp = 0;
+
+    // 第0层按标注中心统计，之后每层合并2x2个单元
+    _clusterLevels.clear();
+    ClusterLevel base;
+    base.width = _gridWidth;
+    base.height = _gridHeight;
+    base.cellExtent = _cellExtent;
+    base.cells.resize(nrCells);
+    for (const Annotation& annotation : _annotations) {
+        const QPointF center = annotation.bounds.center();
+        const int x = std::min(_gridWidth - 1, std::max(0, static_cast<int>((center.x() - _bounds.left()) / _cellExtent)));
+        const int y = std::min(_gridHeight - 1, std::max(0, static_cast<int>((center.y() - _bounds.top()) / _cellExtent)));
+        ClusterCell& cell = base.cells[static_cast<size_t>(y) * _gridWidth + x];
+        ++cell.count;
+        cell.sumX += center.x();
+        cell.sumY += center.y();
+    }
+    _clusterLevels.push_back(base);
+    while (_clusterLevels.back().width > 1 || _clusterLevels.back().height > 1) {
+        const ClusterLevel& fine = _clusterLevels.back();
+        ClusterLevel coarse;
+        coarse.width = (fine.width + 1) / 2;
+        coarse.height = (fine.height + 1) / 2;
+        coarse.cellExtent = fine.cellExtent * 2.;
+        coarse.cells.resize(static_cast<size_t>(coarse.width) * coarse.height);
+        for (int y = 0; y < fine.height; ++y) {
+            for (int x = 0; x < fine.width; ++x) {
+                const ClusterCell& source = fine.cells[static_cast<size_t>(y) * fine.width + x];
+                ClusterCell& target = coarse.cells[static_cast<size_t>(y / 2) * coarse.width + x / 2];
+                target.count += source.count;
+                target.sumX += source.sumX;
+                target.sumY += source.sumY;
+            }
+        }
+        _clusterLevels.push_back(coarse);
+    }
+}
+
+/**
+ * @brief 查询包围盒与矩形相交的标注
+ * @param rect 查询矩形
+ * @return 标注编号
+ */
+std::vector<int> AnnotationLayerItem::annotationsInRect(const QRectF& rect)
+{
+    std::vector<int> result;
+    if (_indexDirty) {
+        rebuildIndex();
+    }
+    int x0, y0, x1, y1;
+    if (!cellRange(rect, _cellExtent, _gridWidth, _gridHeight, x0, y0, x1, y1)) {
+        return result;
+    }
+    if (++_visitStamp == 0) {
+        std::fill(_visited.begin(), _visited.end(), 0);
+        _visitStamp = 1;
+    }
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            const size_t cell = static_cast<size_t>(y) * _gridWidth + x;
+            for (unsigned int i = _cellOffsets[cell]; i < _cellOffsets[cell + 1]; ++i) {
+                const int id = _cellEntries[i];
+                if (_visited[id] != _visitStamp) {
+                    _visited[id] = _visitStamp;
+                    if (overlaps(_annotations[id].bounds, rect)) {
+                        result.push_back(id);
+                    }
+                }
+            }
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+/**
+ * @brief 绘制函数
+ * @param painter 绘制器
+ * @param option 绘制选项
+ * @param widget 绘制目标窗口
+ * @details 在单元屏幕尺寸不小于聚类尺寸的最细金字塔层上统计暴露区域内的标注数，
+ *          超过上限时画聚类，否则逐个绘制
+ */
+void AnnotationLayerItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
+{
+    if (_annotations.empty()) {
+        return;
+    }
+    if (_indexDirty) {
+        rebuildIndex();
+    }
+    const qreal lod = option->levelOfDetailFromTransform(painter->worldTransform());
+    if (lod <= 0.) {
+        return;
+    }
+    const QRectF exposed = option->exposedRect;
+    size_t levelIndex = 0;
+    while (levelIndex + 1 < _clusterLevels.size() && _clusterLevels[levelIndex].cellExtent * lod < _clusterPixels) {
+        ++levelIndex;
+    }
+    const ClusterLevel& level = _clusterLevels[levelIndex];
+    unsigned long long visible = 0;
+    int x0, y0, x1, y1;
+    if (cellRange(exposed, level.cellExtent, level.width, level.height, x0, y0, x1, y1)) {
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                visible += level.cells[static_cast<size_t>(y) * level.width + x].count;
+            }
+        }
+    }
+    if (visible > static_cast<unsigned long long>(_maxIndividual)) {
+        paintClusters(painter, level, exposed, lod);
+    }
+    else {
+        paintAnnotations(painter, exposed, lod);
+    }
+}
+
+/**
+ * @brief 逐个绘制标注
+ * @param painter 绘制器
+ * @param exposed 暴露区域
+ * @param lod 细节层次
+ * @details 同一颜色的多边形合并为一个QPainterPath、点合并为一次drawPoints，
+ *          绘制调用数与颜色数成正比而不是与标注数成正比
+ */
+void AnnotationLayerItem::paintAnnotations(QPainter* painter, const QRectF& exposed, qreal lod)
+{
+    int x0, y0, x1, y1;
+    if (!cellRange(exposed, _cellExtent, _gridWidth, _gridHeight, x0, y0, x1, y1)) {
+        return;
+    }
+    if (++_visitStamp == 0) {
+        std::fill(_visited.begin(), _visited.end(), 0);
+        _visitStamp = 1;
+    }
+    std::vector<QPainterPath> paths(_palette.size());
+    std::vector<QVector<QPointF> > points(_palette.size());
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            const size_t cell = static_cast<size_t>(y) * _gridWidth + x;
+            for (unsigned int i = _cellOffsets[cell]; i < _cellOffsets[cell + 1]; ++i) {
+                const int id = _cellEntries[i];
+                if (_visited[id] == _visitStamp) {
+                    continue;
+                }
+                _visited[id] = _visitStamp;
+                const Annotation& annotation = _annotations[id];
+                if (!overlaps(annotation.bounds, exposed)) {
+                    continue;
+                }
+                const qreal screenSize = std::max(annotation.bounds.width(), annotation.bounds.height()) * lod;
+                if (screenSize < _hidePixels) {
+                    continue;
+                }
+                if (screenSize < _pointPixels) {
+                    points[annotation.color].append(annotation.bounds.center());
+                }
+                else {
+                    paths[annotation.color].addPolygon(screenSize < _simplifyPixels ? annotation.coarse : annotation.polygon);
+                    paths[annotation.color].closeSubpath();
+                }
+            }
+        }
+    }
+    painter->save();
+    painter->setBrush(Qt::NoBrush);
+    for (size_t c = 0; c < _palette.size(); ++c) {
+        if (!paths[c].isEmpty()) {
+            QPen pen(_palette[c], 1.);
+            pen.setCosmetic(true);
+            painter->setPen(pen);
+            painter->drawPath(paths[c]);
+        }
+        if (!points[c].isEmpty()) {
+            QPen pen(_palette[c], _pointPixels);
+            pen.setCosmetic(true);
+            pen.setCapStyle(Qt::RoundCap);
+            painter->setPen(pen);
+            painter->drawPoints(points[c].constData(), points[c].size());
+        }
+    }
+    painter->restore();
+}
+
+/**
+ * @brief 绘制聚类
+ * @param painter 绘制器
+ * @param level 聚类金字塔层
+ * @param exposed 暴露区域
+ * @param lod 细节层次
+ * @details 每个非空单元在标注中心的平均位置画一个圆，半径随计数对数增长且不超过单元的一半；
+ *          圆足够大时在设备坐标下绘制计数，文字大小不随缩放变化
+ */
+void AnnotationLayerItem::paintClusters(QPainter* painter, const ClusterLevel& level, const QRectF& exposed, qreal lod)
+{
+    int x0, y0, x1, y1;
+    if (!cellRange(exposed, level.cellExtent, level.width, level.height, x0, y0, x1, y1)) {
+        return;
+    }
+    const QColor color = _palette.size() == 1 ? _palette.front() : QColor(255, 200, 0);
+    const qreal maxRadius = level.cellExtent * lod / 2.;
+    QPainterPath circles;
+    std::vector<std::pair<QPointF, unsigned int> > labels;
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            const ClusterCell& cell = level.cells[static_cast<size_t>(y) * level.width + x];
+            if (cell.count == 0) {
+                continue;
+            }
+            const QPointF center(cell.sumX / cell.count, cell.sumY / cell.count);
+            const qreal radius = std::min(maxRadius, 3. + 2. * std::log2(static_cast<qreal>(cell.count)));
+            circles.addEllipse(center, radius / lod, radius / lod);
+            if (cell.count > 1 && radius >= 8.) {
+                labels.push_back(std::make_pair(center, cell.count));
+            }
+        }
+    }
+    painter->save();
+    QPen pen(color.darker(150), 1.);
+    pen.setCosmetic(true);
+    painter->setPen(pen);
+    QColor fill = color;
+    fill.setAlpha(128);
+    painter->setBrush(fill);
+    painter->drawPath(circles);
+    if (!labels.empty()) {
+        const QTransform transform = painter->worldTransform();
+        painter->resetTransform();
+        painter->setPen(Qt::black);
+        for (const auto& label : labels) {
+            const QPointF position = transform.map(label.first);
+            painter->drawText(QRectF(position.x() - 32., position.y() - 8., 64., 16.), Qt::AlignCenter, QString::number(label.second));
+        }
+    }
+    painter->restore();
+}
@@ -0,0 +1,272 @@
+﻿/**
+ * @file    AnnotationLayerItem.h
+ * @brief   标注图层图形项类，以空间索引和细节层次绘制大批量标注
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了DSV项目的大批量标注显示，包括：
+ *          - 以均匀网格（CSR存储）索引所有标注的包围盒
+ *          - 按屏幕尺寸选择细节层次：隐藏、画点、画简化多边形或完整多边形
+ *          - 缩小时以网格金字塔聚合标注，每个单元画一个带计数的聚类圆
+ *          - 按颜色合并为少量QPainterPath批量绘制，代替逐个图形项的paint
+ *          用于导入十万级的AI检测结果（如细胞核轮廓），交互编辑的标注仍使用RenderElement。
+ *
+ * @note    标注坐标为场景坐标，与RenderElement相同
+ * @see     RenderElement, ContourRenderElement, WSITileLayerItem, PathologyViewer
+ */
+
+#pragma once
+
+#include <QGraphicsObject>
+#include <QPolygonF>
+#include <QColor>
+#include <QVector>
+#include <vector>
+
+/**
+ * @class  AnnotationLayerItem
+ * @brief  标注图层图形项
+ * @details 场景中以一个图形项代表一批只读标注。添加标注后索引标记为失效，
+ *          在下一次绘制或查询时一次性重建，批量导入时不会反复重建。
+ *
+ *          绘制时先按暴露区域在聚类金字塔中统计可见标注数：
+ *          - 超过kDefaultMaxIndividual时画聚类：选择单元在屏幕上不小于聚类尺寸的最细金字塔层
+ *          - 否则逐个处理与暴露区域相交的标注，屏幕尺寸小于隐藏阈值时跳过，
+ *            小于画点阈值时画点，小于简化阈值时画最多kCoarseVertices个顶点的简化多边形
+ *
+ * @example
+ * @code
+ * AnnotationLayerItem* layer = viewer->getAnnotationLayer();
+ * layer->addAnnotations(nuclei, QColor(0, 255, 0));
+ * std::vector<int> hits = layer->annotationsInRect(QRectF(x, y, w, h));
+ * @endcode
+ */
+class AnnotationLayerItem : public QGraphicsObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief   构造函数
+     * @param   parent 父图形项指针
+     */
+    AnnotationLayerItem(QGraphicsItem* parent = nullptr);
+
+    /**
+     * @brief   获取边界矩形
+     * @return  所有标注包围盒的并集
+     */
+    QRectF boundingRect() const;
+
+    /**
+     * @brief   绘制函数
+     * @param   painter     绘制器指针
+     * @param   option      绘制选项指针，exposedRect为图层坐标下的暴露区域
+     * @param   widget      绘制目标窗口指针
+     */
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget);
+
+    /**
+     * @brief   添加一个标注
+     * @param   polygon 多边形（场景坐标）
+     * @param   color 颜色
+     * @return  标注编号，从0开始连续分配
+     */
+    int addAnnotation(const QPolygonF& polygon, const QColor& color);
+
+    /**
+     * @brief   批量添加同一颜色的标注
+     * @param   polygons 多边形列表（场景坐标）
+     * @param   color 颜色
+     */
+    void addAnnotations(const QVector<QPolygonF>& polygons, const QColor& color);
+
+    /**
+     * @brief   删除所有标注
+     */
+    void clearAnnotations();
+
+    /**
+     * @brief   获取标注数量
+     * @return  标注数量
+     */
+    int getNumberOfAnnotations() const;
+
+    /**
+     * @brief   获取标注的多边形
+     * @param   id 标注编号
+     * @return  多边形
+     */
+    const QPolygonF& getPolygon(int id) const;
+
+    /**
+     * @brief   获取标注的颜色
+     * @param   id 标注编号
+     * @return  颜色
+     */
+    QColor getColor(int id) const;
+
+    /**
+     * @brief   查询包围盒与矩形相交的标注
+     * @param   rect 查询矩形（场景坐标）
+     * @return  标注编号，按编号升序
+     */
+    std::vector<int> annotationsInRect(const QRectF& rect);
+
+    /**
+     * @brief   设置细节层次阈值
+     * @param   hidePixels 屏幕尺寸小于该值的标注不绘制
+     * @param   pointPixels 屏幕尺寸小于该值的标注画为点
+     * @param   simplifyPixels 屏幕尺寸小于该值的标注画为简化多边形
+     * @note    屏幕尺寸为包围盒较长边在屏幕上的像素数
+     */
+    void setLevelOfDetail(qreal hidePixels, qreal pointPixels, qreal simplifyPixels);
+
+    /**
+     * @brief   设置聚类参数
+     * @param   maxIndividual 可见标注数超过该值时改为画聚类
+     * @param   clusterPixels 聚类单元在屏幕上的最小像素数
+     */
+    void setClustering(int maxIndividual, qreal clusterPixels);
+
+private:
+    /**
+     * @brief 标注
+     */
+    struct Annotation {
+        QPolygonF polygon;      ///< 完整多边形
+        QPolygonF coarse;       ///< 简化多边形，顶点不超过kCoarseVertices
+        QRectF bounds;          ///< 包围盒
+        int color;              ///< 在_palette中的下标
+    };
+
+    /**
+     * @brief 聚类单元
+     */
+    struct ClusterCell {
+        unsigned int count = 0; ///< 中心落在单元内的标注数
+        double sumX = 0.;       ///< 中心X坐标之和
+        double sumY = 0.;       ///< 中心Y坐标之和
+    };
+
+    /**
+     * @brief 聚类金字塔的一层，单元边长为上一层的两倍
+     */
+    struct ClusterLevel {
+        int width = 0;
+        int height = 0;
+        qreal cellExtent = 0.;
+        std::vector<ClusterCell> cells;
+    };
+
+    /**
+     * @brief   查找或加入颜色
+     * @param   color 颜色
+     * @return  在_palette中的下标
+     */
+    int colorIndex(const QColor& color);
+
+    /**
+     * @brief   重建网格索引和聚类金字塔
+     * @details 网格覆盖_bounds，较长边分为kGridResolution个单元；
+     *          每个标注登记在其包围盒覆盖的所有单元中
+     */
+    void rebuildIndex();
+
+    /**
+     * @brief   计算矩形覆盖的单元范围
+     * @param   rect 矩形（场景坐标）
+     * @param   cellExtent 单元边长
+     * @param   width 网格宽度
+     * @param   height 网格高度
+     * @return  矩形与网格不相交时返回false
+     */
+    bool cellRange(const QRectF& rect, qreal cellExtent, int width, int height, int& x0, int& y0, int& x1, int& y1) const;
+
+    /**
+     * @brief   逐个绘制标注
+     * @param   painter 绘制器
+     * @param   exposed 暴露区域
+     * @param   lod 当前细节层次（每场景单位的屏幕像素数）
+     */
+    void paintAnnotations(QPainter* painter, const QRectF& exposed, qreal lod);
+
+    /**
+     * @brief   绘制聚类
+     * @param   painter 绘制器
+     * @param   level 聚类金字塔层
+     * @param   exposed 暴露区域
+     * @param   lod 当前细节层次
+     */
+    void paintClusters(QPainter* painter, const ClusterLevel& level, const QRectF& exposed, qreal lod);
+
+    /**
+     * @brief   生成简化多边形
+     * @param   polygon 完整多边形
+     * @return  等间隔取kCoarseVertices个顶点的多边形
+     */
+    static QPolygonF coarsen(const QPolygonF& polygon);
+
+    /** @brief 包围盒是否与矩形相交（含退化为线或点的包围盒） */
+    static bool overlaps(const QRectF& bounds, const QRectF& rect);
+
+    /** @brief 网格较长边的单元数 */
+    static const int kGridResolution = 256;
+
+    /** @brief 简化多边形的顶点数 */
+    static const int kCoarseVertices = 8;
+
+    /** @brief 默认的可见标注数上限 */
+    static const int kDefaultMaxIndividual = 20000;
+
+    /** @brief 标注 */
+    std::vector<Annotation> _annotations;
+
+    /** @brief 颜色表 */
+    std::vector<QColor> _palette;
+
+    /** @brief 所有标注包围盒的并集 */
+    QRectF _bounds;
+
+    /** @brief 索引是否需要重建 */
+    bool _indexDirty;
+
+    /** @brief 网格单元边长 */
+    qreal _cellExtent;
+
+    /** @brief 网格宽度 */
+    int _gridWidth;
+
+    /** @brief 网格高度 */
+    int _gridHeight;
+
+    /** @brief 每个单元在_cellEntries中的起始位置，长度为单元数+1 */
+    std::vector<unsigned int> _cellOffsets;
+
+    /** @brief 按单元连续存放的标注编号 */
+    std::vector<int> _cellEntries;
+
+    /** @brief 聚类金字塔，第0层与网格相同，最后一层为单个单元 */
+    std::vector<ClusterLevel> _clusterLevels;
+
+    /** @brief 查询去重用的访问标记 */
+    std::vector<unsigned int> _visited;
+
+    /** @brief 当前查询的访问标记值 */
+    unsigned int _visitStamp;
+
+    /** @brief 隐藏阈值（像素） */
+    qreal _hidePixels;
+
+    /** @brief 画点阈值（像素） */
+    qreal _pointPixels;
+
+    /** @brief 简化阈值（像素） */
+    qreal _simplifyPixels;
+
+    /** @brief 可见标注数上限 */
+    int _maxIndividual;
+
+    /** @brief 聚类单元的最小屏幕像素数 */
+    qreal _clusterPixels;
+};
@@ -0,0 +1,684 @@
+﻿/**
+ * @file AnnotationStore.cpp
+ * @brief 标注存储类实现文件
+ * @details 该文件实现了分块二进制标注存储的读写，包括：
+ *          - 标注记录的序列化和JSON转换
+ *          - 按空间瓦片分组写出数据块和索引
+ *          - 按数据块懒加载记录
+ *          - 标注记录与渲染元素的转换
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "AnnotationStore.h"
+#include "RectRenderElement.h"
+#include "EllipseRenderElement.h"
+#include "LineRenderElement.h"
+#include "ContourRenderElement.h"
+#include "TextRenderElement.h"
+#include <QDataStream>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QDebug>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+/** @brief 文件魔数 */
+const char kStoreMagic[8] = { 'D', 'S', 'V', 'A', 'N', 'N', 'O', 0 };
+
+/** @brief 文件格式版本 */
+const quint32 kStoreVersion = 1;
+
+/** @brief 文件头字节数 */
+const int kHeaderSize = 32;
+
+/** @brief 索引项字节数 */
+const int kIndexEntrySize = 4 * sizeof(double) + 8 + 4 + 4;
+
+/** @brief 一条记录序列化后的最小字节数：类型、颜色、线宽、像素尺寸、两个空字符串和点数 */
+const int kMinRecordBytes = 4 + 3 + 4 + 8 + 4 + 4 + 4;
+
+/** @brief 一个点序列化后的字节数 */
+const int kPointBytes = 2 * sizeof(double);
+
+/**
+ * @brief 配置数据流的字节序和浮点精度，保证文件跨平台一致
+ */
+void setupStream(QDataStream& stream)
+{
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::DoublePrecision);
+}
+
+/**
+ * @brief 序列化一条记录
+ */
+void writeRecord(QDataStream& stream, const AnnotationRecord& record)
+{
+    stream << static_cast<qint32>(record.type)
+        << static_cast<quint8>(record.color.red())
+        << static_cast<quint8>(record.color.green())
+        << static_cast<quint8>(record.color.blue())
+        << static_cast<qint32>(record.lineWidth)
+        << record.pixelSize
+        << record.name
+        << record.text
+        << static_cast<quint32>(record.points.size());
+    for (const QPointF& point : record.points) {
+        stream << point.x() << point.y();
+    }
+}
+
+/**
+ * @brief 反序列化一条记录
+ * @return 数据流出错时返回false
+ */
+bool readRecord(QDataStream& stream, AnnotationRecord& record)
+{
+    qint32 type, lineWidth;
+    quint8 red, green, blue;
+    quint32 nrPoints;
+    stream >> type >> red >> green >> blue >> lineWidth >> record.pixelSize >> record.name >> record.text >> nrPoints;
+    if (stream.status() != QDataStream::Ok) {
+        return false;
+    }
+    record.type = static_cast<RenderElement::ElementType>(type);
+    record.color = QColor(red, green, blue);
+    record.lineWidth = lineWidth;
+    record.points.clear();
+    // 点数来自文件，按数据流剩余的字节数检查后再预留
+    if (nrPoints > static_cast<quint64>(stream.device()->bytesAvailable()) / kPointBytes) {
+        return false;
+    }
+    record.points.reserve(static_cast<int>(nrPoints));
+    for (quint32 i = 0; i < nrPoints && stream.status() == QDataStream::Ok; ++i) {
+        double x, y;
+        stream >> x >> y;
+        record.points.append(QPointF(x, y));
+    }
+    return stream.status() == QDataStream::Ok;
+}
+
+}
+
+/**
+ * @brief 获取包围盒
+ * @return 几何点的包围盒
+ */
+QRectF AnnotationRecord::bounds() const
+{
+    return points.boundingRect();
+}
+
+/**
+ * @brief 转换为JSON对象
+ * @return JSON对象
+ * @details 样式字段与RenderElement::toJson一致，几何点以[x, y]数组保存
+ */
+QJsonObject AnnotationRecord::toJson() const
+{
+    QJsonArray pointArray;
+    for (const QPointF& point : points) {
+        pointArray.append(QJsonArray{ point.x(), point.y() });
+    }
+    QJsonObject json{
+        {"type", static_cast<int>(type)},
+        {"r", color.red()},
+        {"g", color.green()},
+        {"b", color.blue()},
+        {"lineWidth", lineWidth},
+        {"name", name},
+        {"pixelSize", pixelSize},
+        {"points", pointArray}
+    };
+    if (!text.isEmpty()) {
+        json["text"] = text;
+    }
+    return json;
+}
+
+/**
+ * @brief 从JSON对象恢复
+ * @param json JSON对象
+ * @return 标注记录
+ * @details 同时接受toJson输出的顶层字段和RenderElement(QJsonObject)读取的base对象，
+ *          线宽字段接受lineWidth或width
+ */
+AnnotationRecord AnnotationRecord::fromJson(const QJsonObject& json)
+{
+    const QJsonObject base = json.contains("base") ? json["base"].toObject() : json;
+    AnnotationRecord record;
+    record.type = static_cast<RenderElement::ElementType>(base["type"].toInt(RenderElement::Undefined));
+    record.color = QColor(base["r"].toInt(), base["g"].toInt(), base["b"].toInt());
+    record.lineWidth = base.contains("lineWidth") ? base["lineWidth"].toInt() : base["width"].toInt(2);
+    record.name = base["name"].toString();
+    record.pixelSize = base["pixelSize"].toDouble();
+    const QJsonArray pointArray = json.contains("points") ? json["points"].toArray() : base["points"].toArray();
+    record.points.reserve(pointArray.size());
+    for (const QJsonValue& value : pointArray) {
+        const QJsonArray point = value.toArray();
+        record.points.append(QPointF(point.at(0).toDouble(), point.at(1).toDouble()));
+    }
+    record.text = json.contains("text") ? json["text"].toString() : base["text"].toString();
+    return record;
+}
+
+/**
+ * @brief 创建渲染元素
+ * @param sceneScale 场景坐标与第0层坐标的比例
+ * @return 新建的图形项
+ */
+QGraphicsItem* AnnotationRecord::createElement(double sceneScale) const
+{
+    if (points.isEmpty()) {
+        return nullptr;
+    }
+    QPolygonF scenePoints;
+    scenePoints.reserve(points.size());
+    for (const QPointF& point : points) {
+        scenePoints.append(point * sceneScale);
+    }
+    const QPen pen(color, lineWidth);
+    QGraphicsItem* item = nullptr;
+    switch (type) {
+    case RenderElement::Rectangle: {
+        RectRenderElement* rect = new RectRenderElement(name, scenePoints.boundingRect());
+        rect->setPen(pen);
+        item = rect;
+        break;
+    }
+    case RenderElement::Ellipse: {
+        EllipseRenderElement* ellipse = new EllipseRenderElement(name, scenePoints.boundingRect());
+        ellipse->setPen(pen);
+        item = ellipse;
+        break;
+    }
+    case RenderElement::Line: {
+        if (scenePoints.size() < 2) {
+            return nullptr;
+        }
+        LineRenderElement* line = new LineRenderElement(name, scenePoints[0], scenePoints[1]);
+        line->setPen(pen);
+        item = line;
+        break;
+    }
+    case RenderElement::Polygon:
+    case RenderElement::Contour:
+    case RenderElement::Angle: {
+        ContourRenderElement* contour = new ContourRenderElement(name, scenePoints);
+        contour->setPen(pen);
+        item = contour;
+        break;
+    }
+    case RenderElement::Text: {
+        TextRenderElement* textItem = new TextRenderElement(name, text);
+        textItem->setPos(scenePoints[0]);
+        textItem->setDefaultTextColor(color);
+        item = textItem;
+        break;
+    }
+    default:
+        return nullptr;
+    }
+    RenderElement* element = dynamic_cast<RenderElement*>(item);
+    element->setColor(color);
+    element->setLineWidth(lineWidth);
+    element->setPixelSize(pixelSize);
+    return item;
+}
+
+/**
+ * @brief 从渲染元素生成记录
+ * @param item 图形项
+ * @param sceneScale 场景坐标与第0层坐标的比例
+ * @param record 输出记录
+ * @return 是否为可保存的渲染元素
+ * @details 几何取场景坐标，包含用户拖动产生的位移；颜色和线宽取图形项实际使用的画笔
+ */
+bool AnnotationRecord::fromElement(QGraphicsItem* item, double sceneScale, AnnotationRecord& record)
+{
+    RenderElement* element = dynamic_cast<RenderElement*>(item);
+    if (!element || sceneScale <= 0.) {
+        return false;
+    }
+    QPolygonF scenePoints;
+    QPen pen;
+    record.text.clear();
+    if (RectRenderElement* rect = dynamic_cast<RectRenderElement*>(item)) {
+        const QRectF bounds = rect->mapRectToScene(rect->rect());
+        scenePoints << bounds.topLeft() << bounds.bottomRight();
+        pen = rect->pen();
+    }
+    else if (EllipseRenderElement* ellipse = dynamic_cast<EllipseRenderElement*>(item)) {
+        const QRectF bounds = ellipse->mapRectToScene(ellipse->rect());
+        scenePoints << bounds.topLeft() << bounds.bottomRight();
+        pen = ellipse->pen();
+    }
+    else if (LineRenderElement* line = dynamic_cast<LineRenderElement*>(item)) {
+        scenePoints << line->mapToScene(line->line().p1()) << line->mapToScene(line->line().p2());
+        pen = line->pen();
+    }
+    else if (ContourRenderElement* contour = dynamic_cast<ContourRenderElement*>(item)) {
+        scenePoints = contour->mapToScene(contour->polygon());
+        pen = contour->pen();
+    }
+    else if (TextRenderElement* textItem = dynamic_cast<TextRenderElement*>(item)) {
+        scenePoints << textItem->scenePos();
+        pen = QPen(textItem->defaultTextColor(), element->getLineWidth());
+        record.text = textItem->toPlainText();
+    }
+    else {
+        return false;
+    }
+    if (scenePoints.isEmpty()) {
+        return false;
+    }
+    record.type = element->returnType();
+    record.color = pen.color();
+    record.lineWidth = pen.width();
+    record.name = element->name();
+    record.pixelSize = element->getPixelSize();
+    record.points.clear();
+    record.points.reserve(scenePoints.size());
+    for (const QPointF& point : scenePoints) {
+        record.points.append(point / sceneScale);
+    }
+    return true;
+}
+
+/**
+ * @brief 构造函数
+ */
+AnnotationStoreWriter::AnnotationStoreWriter() :
+    _tileExtent(4096.),
+    _count(0),
+    _pendingBytes(0),
+    _nrChunks(0)
+{
+}
+
+/**
+ * @brief 析构函数
+ * @details 未关闭的文件在此写出索引
+ */
+AnnotationStoreWriter::~AnnotationStoreWriter()
+{
+    if (_file.isOpen()) {
+        close();
+    }
+}
+
+/**
+ * @brief 创建存储文件
+ * @param path 文件路径
+ * @param tileExtent 空间瓦片边长
+ * @return 成功时返回true
+ * @details 先写入索引偏移为0的文件头，close时回填
+ */
+bool AnnotationStoreWriter::open(const QString& path, double tileExtent)
+{
+    if (_file.isOpen()) {
+        close();
+    }
+    _file.setFileName(path);
+    if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "AnnotationStoreWriter: cannot open" << path;
+        return false;
+    }
+    _tileExtent = tileExtent > 0. ? tileExtent : 4096.;
+    _count = 0;
+    _pendingBytes = 0;
+    _pending.clear();
+    _index.clear();
+    _nrChunks = 0;
+    char header[kHeaderSize] = {};
+    std::memcpy(header, kStoreMagic, sizeof(kStoreMagic));
+    std::memcpy(header + 8, &kStoreVersion, sizeof(kStoreVersion));
+    return _file.write(header, kHeaderSize) == kHeaderSize;
+}
+
+/**
+ * @brief 添加一条记录
+ * @param record 标注记录
+ * @return 写出数据块失败时返回false
+ */
+bool AnnotationStoreWriter::add(const AnnotationRecord& record)
+{
+    if (!_file.isOpen()) {
+        return false;
+    }
+    const QRectF bounds = record.bounds();
+    const QPointF center = bounds.center();
+    const qint32 tileX = static_cast<qint32>(std::floor(center.x() / _tileExtent));
+    const qint32 tileY = static_cast<qint32>(std::floor(center.y() / _tileExtent));
+    const unsigned long long key = (static_cast<unsigned long long>(static_cast<quint32>(tileX)) << 32) | static_cast<quint32>(tileY);
+
+    QByteArray bytes;
+    {
+        QDataStream stream(&bytes, QIODevice::WriteOnly);
+        setupStream(stream);
+        writeRecord(stream, record);
+    }
+    PendingChunk& chunk = _pending[key];
+    chunk.bounds = chunk.count == 0 ? bounds : chunk.bounds.united(bounds);
+    chunk.data.append(bytes);
+    ++chunk.count;
+    ++_count;
+    _pendingBytes += bytes.size();
+    if (chunk.data.size() >= kChunkBytes && !flushChunk(chunk)) {
+        return false;
+    }
+    if (_pendingBytes > kMaxPendingBytes) {
+        return flushAll();
+    }
+    return true;
+}
+
+/**
+ * @brief 写出一个数据块并加入索引
+ * @param chunk 未写出的数据块，写出后清空
+ * @return 成功时返回true
+ */
+bool AnnotationStoreWriter::flushChunk(PendingChunk& chunk)
+{
+    if (chunk.count == 0) {
+        return true;
+    }
+    const QByteArray stored = qCompress(chunk.data, 1);
+    const qint64 offset = _file.pos();
+    if (_file.write(stored) != stored.size()) {
+        qDebug() << "AnnotationStoreWriter: write failed" << _file.fileName();
+        return false;
+    }
+    const double bounds[4] = { chunk.bounds.x(), chunk.bounds.y(), chunk.bounds.width(), chunk.bounds.height() };
+    const quint32 storedSize = static_cast<quint32>(stored.size());
+    char entry[kIndexEntrySize];
+    std::memcpy(entry, bounds, sizeof(bounds));
+    std::memcpy(entry + 32, &offset, sizeof(offset));
+    std::memcpy(entry + 40, &storedSize, sizeof(storedSize));
+    std::memcpy(entry + 44, &chunk.count, sizeof(chunk.count));
+    _index.insert(_index.end(), entry, entry + kIndexEntrySize);
+    ++_nrChunks;
+
+    _pendingBytes -= chunk.data.size();
+    chunk.data.clear();
+    chunk.bounds = QRectF();
+    chunk.count = 0;
+    return true;
+}
+
+/**
+ * @brief 写出全部未写出的数据块
+ * @return 成功时返回true
+ */
+bool AnnotationStoreWriter::flushAll()
+{
+    for (auto& it : _pending) {
+        if (!flushChunk(it.second)) {
+            return false;
+        }
+    }
+    _pending.clear();
+    _pendingBytes = 0;
+    return true;
+}
+
+/**
+ * @brief 逐行导入JSON-seq文件
+ * @param path 输入文件路径
+ * @return 导入的记录数
+ * @details 每次只解析一行，不构建整个文档；无法解析的行被跳过
+ */
+long long AnnotationStoreWriter::importJsonSeq(const QString& path)
+{
+    QFile input(path);
+    if (!input.open(QIODevice::ReadOnly)) {
+        qDebug() << "AnnotationStoreWriter: cannot open" << path;
+        return -1;
+    }
+    long long imported = 0;
+    while (!input.atEnd()) {
+        const QByteArray line = input.readLine().trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+        QJsonParseError error;
+        const QJsonDocument document = QJsonDocument::fromJson(line, &error);
+        if (error.error != QJsonParseError::NoError || !document.isObject()) {
+            continue;
+        }
+        if (!add(AnnotationRecord::fromJson(document.object()))) {
+            break;
+        }
+        ++imported;
+    }
+    return imported;
+}
+
+/**
+ * @brief 写出剩余数据块和索引并关闭文件
+ * @return 成功时返回true
+ */
+bool AnnotationStoreWriter::close()
+{
+    if (!_file.isOpen()) {
+        return false;
+    }
+    bool ok = flushAll();
+    const qint64 indexOffset = _file.pos();
+    ok = ok && _file.write(reinterpret_cast<const char*>(&_nrChunks), sizeof(_nrChunks)) == sizeof(_nrChunks);
+    ok = ok && (_index.empty() || _file.write(_index.data(), _index.size()) == static_cast<qint64>(_index.size()));
+    if (ok) {
+        char header[kHeaderSize] = {};
+        std::memcpy(header, kStoreMagic, sizeof(kStoreMagic));
+        std::memcpy(header + 8, &kStoreVersion, sizeof(kStoreVersion));
+        std::memcpy(header + 16, &indexOffset, sizeof(indexOffset));
+        std::memcpy(header + 24, &_count, sizeof(_count));
+        ok = _file.seek(0) && _file.write(header, kHeaderSize) == kHeaderSize;
+    }
+    _file.close();
+    _index.clear();
+    _pending.clear();
+    return ok;
+}
+
+/**
+ * @brief 构造函数
+ */
+AnnotationStoreReader::AnnotationStoreReader() :
+    _count(0)
+{
+}
+
+/**
+ * @brief 析构函数
+ */
+AnnotationStoreReader::~AnnotationStoreReader()
+{
+    close();
+}
+
+/**
+ * @brief 打开存储文件
+ * @param path 文件路径
+ * @return 成功时返回true
+ * @details 只读取文件头和索引，索引项越界时视为文件损坏
+ */
+bool AnnotationStoreReader::open(const QString& path)
+{
+    close();
+    _file.setFileName(path);
+    if (!_file.open(QIODevice::ReadOnly)) {
+        qDebug() << "AnnotationStoreReader: cannot open" << path;
+        return false;
+    }
+    char header[kHeaderSize];
+    quint32 version = 0;
+    qint64 indexOffset = 0;
+    if (_file.read(header, kHeaderSize) != kHeaderSize || std::memcmp(header, kStoreMagic, sizeof(kStoreMagic)) != 0) {
+        close();
+        return false;
+    }
+    std::memcpy(&version, header + 8, sizeof(version));
+    std::memcpy(&indexOffset, header + 16, sizeof(indexOffset));
+    std::memcpy(&_count, header + 24, sizeof(_count));
+    quint32 nrChunks = 0;
+    if (version != kStoreVersion || indexOffset < kHeaderSize || !_file.seek(indexOffset) ||
+        _file.read(reinterpret_cast<char*>(&nrChunks), sizeof(nrChunks)) != sizeof(nrChunks)) {
+        close();
+        return false;
+    }
+    // 块数来自文件，按索引之后剩余的字节数检查后再读取，损坏的文件头不会请求过量内存
+    const qint64 indexBytes = static_cast<qint64>(nrChunks) * kIndexEntrySize;
+    if (static_cast<qint64>(nrChunks) > (_file.size() - indexOffset - static_cast<qint64>(sizeof(nrChunks))) / kIndexEntrySize) {
+        close();
+        return false;
+    }
+    const QByteArray index = _file.read(indexBytes);
+    if (static_cast<qint64>(index.size()) != indexBytes) {
+        close();
+        return false;
+    }
+    _chunks.reserve(nrChunks);
+    for (quint32 i = 0; i < nrChunks; ++i) {
+        const char* entry = index.constData() + static_cast<size_t>(i) * kIndexEntrySize;
+        double bounds[4];
+        ChunkInfo info;
+        std::memcpy(bounds, entry, sizeof(bounds));
+        std::memcpy(&info.offset, entry + 32, sizeof(info.offset));
+        std::memcpy(&info.storedSize, entry + 40, sizeof(info.storedSize));
+        std::memcpy(&info.count, entry + 44, sizeof(info.count));
+        if (info.offset < kHeaderSize || info.offset + info.storedSize > indexOffset) {
+            close();
+            return false;
+        }
+        info.bounds = QRectF(bounds[0], bounds[1], bounds[2], bounds[3]);
+        _bounds = _chunks.empty() ? info.bounds : _bounds.united(info.bounds);
+        _chunks.push_back(info);
+    }
+    return true;
+}
+
+/**
+ * @brief 关闭文件
+ */
+void AnnotationStoreReader::close()
+{
+    _file.close();
+    _chunks.clear();
+    _bounds = QRectF();
+    _count = 0;
+}
+
+/**
+ * @brief 查询包围盒与矩形相交的数据块
+ * @param rect 查询矩形
+ * @return 数据块编号
+ * @details 包围盒为单点或直线时QRectF::intersects返回false，因此逐边比较
+ */
+std::vector<int> AnnotationStoreReader::chunksInRect(const QRectF& rect) const
+{
+    std::vector<int> result;
+    for (size_t i = 0; i < _chunks.size(); ++i) {
+        const QRectF& bounds = _chunks[i].bounds;
+        if (bounds.left() <= rect.right() && bounds.right() >= rect.left() &&
+            bounds.top() <= rect.bottom() && bounds.bottom() >= rect.top()) {
+            result.push_back(static_cast<int>(i));
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief 读取一个数据块
+ * @param chunk 数据块编号
+ * @param records 输出记录
+ * @return 成功时返回true
+ */
+bool AnnotationStoreReader::readChunk(int chunk, std::vector<AnnotationRecord>& records)
+{
+    if (chunk < 0 || chunk >= static_cast<int>(_chunks.size()) || !_file.isOpen()) {
+        return false;
+    }
+    const ChunkInfo& info = _chunks[chunk];
+    if (!_file.seek(info.offset)) {
+        return false;
+    }
+    const QByteArray stored = _file.read(info.storedSize);
+    if (stored.size() != static_cast<int>(info.storedSize)) {
+        return false;
+    }
+    const QByteArray raw = qUncompress(stored);
+    // 记录数来自索引，损坏的文件可能给出远超数据块内容的值，预留内存之前先检查
+    if (info.count > static_cast<quint32>(raw.size() / kMinRecordBytes)) {
+        return false;
+    }
+    QDataStream stream(raw);
+    setupStream(stream);
+    records.reserve(records.size() + info.count);
+    for (quint32 i = 0; i < info.count; ++i) {
+        AnnotationRecord record;
+        if (!readRecord(stream, record)) {
+            return false;
+        }
+        records.push_back(std::move(record));
+    }
+    return true;
+}
+
+/**
+ * @brief 读取与矩形相交的记录
+ * @param rect 查询矩形
+ * @return 标注记录
+ */
+std::vector<AnnotationRecord> AnnotationStoreReader::read(const QRectF& rect)
+{
+    std::vector<AnnotationRecord> result;
+    std::vector<AnnotationRecord> records;
+    for (int chunk : chunksInRect(rect)) {
+        records.clear();
+        readChunk(chunk, records);
+        for (AnnotationRecord& record : records) {
+            const QRectF bounds = record.bounds();
+            if (bounds.left() <= rect.right() && bounds.right() >= rect.left() &&
+                bounds.top() <= rect.bottom() && bounds.bottom() >= rect.top()) {
+                result.push_back(std::move(record));
+            }
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief 逐块导出为JSON-seq文件
+ * @param path 输出文件路径
+ * @return 成功时返回true
+ * @details 每次只解压一个数据块，内存占用与标注总数无关
+ */
+bool AnnotationStoreReader::exportJsonSeq(const QString& path)
+{
+    QFile output(path);
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "AnnotationStoreReader: cannot open" << path;
+        return false;
+    }
+    std::vector<AnnotationRecord> records;
+    for (int chunk = 0; chunk < static_cast<int>(_chunks.size()); ++chunk) {
+        records.clear();
+        if (!readChunk(chunk, records)) {
+            return false;
+        }
+        for (const AnnotationRecord& record : records) {
+            QByteArray line = QJsonDocument(record.toJson()).toJson(QJsonDocument::Compact);
+            line.append('\n');
+            if (output.write(line) != line.size()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
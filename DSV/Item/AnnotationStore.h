@@ -0,0 +1,299 @@
+﻿/**
+ * @file    AnnotationStore.h
+ * @brief   标注存储类，以分块二进制格式流式读写大批量标注
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了标注的批量导入导出，包括：
+ *          - 与RenderElement::toJson字段一致的标注记录
+ *          - 按空间瓦片分块写入的二进制存储，写入时内存占用有上限
+ *          - 只读取索引的存储读取器，按矩形区域懒加载数据块
+ *          - 与逐行JSON（JSON-seq）文件的相互转换
+ *          - 标注记录与渲染元素之间的转换
+ *
+ * @note    10^5~10^6个标注时不构建QJsonDocument，也不一次性创建所有图形项
+ * @see     RenderElement, PathologyViewer
+ */
+
+#pragma once
+
+#include <QString>
+#include <QColor>
+#include <QPolygonF>
+#include <QRectF>
+#include <QFile>
+#include <QByteArray>
+#include <QJsonObject>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "RenderElement.h"
+
+class QGraphicsItem;
+
+/**
+ * @struct AnnotationRecord
+ * @brief  标注记录，一个渲染元素的样式和几何
+ * @details 坐标为第0层图像坐标，points的含义随类型不同：
+ *          - Rectangle和Ellipse：外接矩形的两个对角点
+ *          - Line：起点和终点
+ *          - Polygon、Contour和Angle：全部顶点
+ *          - Text：文本的左上角，文本内容在text中
+ */
+struct AnnotationRecord
+{
+    /** @brief 元素类型 */
+    RenderElement::ElementType type = RenderElement::Undefined;
+
+    /** @brief 颜色 */
+    QColor color = Qt::black;
+
+    /** @brief 线宽（像素） */
+    int lineWidth = 2;
+
+    /** @brief 名称 */
+    QString name;
+
+    /** @brief 像素尺寸 */
+    double pixelSize = 0.;
+
+    /** @brief 几何点 */
+    QPolygonF points;
+
+    /** @brief 文本内容，仅Text类型使用 */
+    QString text;
+
+    /**
+     * @brief   获取包围盒
+     * @return  几何点的包围盒（第0层坐标）
+     */
+    QRectF bounds() const;
+
+    /**
+     * @brief   转换为JSON对象
+     * @return  与RenderElement::toJson相同的字段，另加points（[[x, y], ...]）和text
+     */
+    QJsonObject toJson() const;
+
+    /**
+     * @brief   从JSON对象恢复
+     * @param   json JSON对象，字段可以位于顶层（toJson）或base对象中（RenderElement(QJsonObject)）
+     * @return  标注记录
+     */
+    static AnnotationRecord fromJson(const QJsonObject& json);
+
+    /**
+     * @brief   创建渲染元素
+     * @param   sceneScale 场景坐标与第0层坐标的比例
+     * @return  新建的图形项，由调用者加入场景；类型不支持时返回nullptr
+     */
+    QGraphicsItem* createElement(double sceneScale) const;
+
+    /**
+     * @brief   从渲染元素生成记录
+     * @param   item 图形项
+     * @param   sceneScale 场景坐标与第0层坐标的比例
+     * @param   record 输出记录
+     * @return  item不是可保存的渲染元素时返回false
+     */
+    static bool fromElement(QGraphicsItem* item, double sceneScale, AnnotationRecord& record);
+};
+
+/**
+ * @class  AnnotationStoreWriter
+ * @brief  标注存储写入器
+ * @details 文件格式：
+ *          - 32字节文件头：[魔数 8字节][版本 4字节][保留 4字节][索引偏移 8字节][标注数 8字节]
+ *          - 若干数据块，每块为qCompress压缩的一组记录
+ *          - 索引：[块数 4字节]，每块 [包围盒 4个double][偏移 8字节][压缩字节数 4字节][记录数 4字节]
+ *
+ *          记录按包围盒中心所在的空间瓦片分组，同一瓦片的记录达到kChunkBytes时写出一个数据块；
+ *          所有未写出的记录超过kMaxPendingBytes时全部写出，因此写入时内存占用有上限。
+ *          同一瓦片可以有多个数据块。索引在close时写入，未正常关闭的文件无法打开。
+ *
+ * @example
+ *          AnnotationStoreWriter writer;
+ *          if (writer.open("cells.dsva")) {
+ *              for (const AnnotationRecord& record : records) {
+ *                  writer.add(record);
+ *              }
+ *              writer.close();
+ *          }
+ */
+class AnnotationStoreWriter
+{
+public:
+    AnnotationStoreWriter();
+    ~AnnotationStoreWriter();
+
+    /**
+     * @brief   创建存储文件
+     * @param   path 文件路径
+     * @param   tileExtent 空间瓦片边长（第0层像素）
+     * @return  成功时返回true
+     */
+    bool open(const QString& path, double tileExtent = 4096.);
+
+    /**
+     * @brief   添加一条记录
+     * @param   record 标注记录
+     * @return  写出数据块失败时返回false
+     */
+    bool add(const AnnotationRecord& record);
+
+    /**
+     * @brief   逐行导入JSON-seq文件
+     * @param   path 每行一个toJson对象的文本文件
+     * @return  导入的记录数，文件无法打开时返回-1
+     */
+    long long importJsonSeq(const QString& path);
+
+    /**
+     * @brief   写出剩余数据块和索引并关闭文件
+     * @return  成功时返回true
+     */
+    bool close();
+
+    /**
+     * @brief   获取已添加的记录数
+     * @return  记录数
+     */
+    unsigned long long getNumberOfAnnotations() const { return _count; }
+
+private:
+    /**
+     * @brief 未写出的数据块
+     */
+    struct PendingChunk {
+        QByteArray data;    ///< 序列化后的记录
+        QRectF bounds;      ///< 记录包围盒的并集
+        quint32 count = 0;  ///< 记录数
+    };
+
+    /**
+     * @brief 写出一个数据块并加入索引
+     */
+    bool flushChunk(PendingChunk& chunk);
+
+    /**
+     * @brief 写出全部未写出的数据块
+     */
+    bool flushAll();
+
+    QFile _file;
+    double _tileExtent;
+    unsigned long long _count;
+    unsigned long long _pendingBytes;
+    std::unordered_map<unsigned long long, PendingChunk> _pending;
+    std::vector<char> _index;
+    quint32 _nrChunks;
+
+    /** @brief 单个数据块的目标大小（未压缩） */
+    static const int kChunkBytes = 256 * 1024;
+
+    /** @brief 所有未写出记录的上限 */
+    static const unsigned long long kMaxPendingBytes = 32ULL * 1024 * 1024;
+};
+
+/**
+ * @class  AnnotationStoreReader
+ * @brief  标注存储读取器
+ * @details 打开时只读取文件头和索引，数据块在查询时按需读取和解压。
+ *          该类不是线程安全的。
+ *
+ * @example
+ *          AnnotationStoreReader reader;
+ *          if (reader.open("cells.dsva")) {
+ *              for (int chunk : reader.chunksInRect(FOV)) {
+ *                  std::vector<AnnotationRecord> records;
+ *                  reader.readChunk(chunk, records);
+ *              }
+ *          }
+ */
+class AnnotationStoreReader
+{
+public:
+    AnnotationStoreReader();
+    ~AnnotationStoreReader();
+
+    /**
+     * @brief   打开存储文件
+     * @param   path 文件路径
+     * @return  文件头或索引无效时返回false
+     */
+    bool open(const QString& path);
+
+    /**
+     * @brief   关闭文件
+     */
+    void close();
+
+    /**
+     * @brief   获取记录总数
+     * @return  记录数
+     */
+    unsigned long long getNumberOfAnnotations() const { return _count; }
+
+    /**
+     * @brief   获取数据块数
+     * @return  数据块数
+     */
+    int getNumberOfChunks() const { return static_cast<int>(_chunks.size()); }
+
+    /**
+     * @brief   获取所有标注的包围盒
+     * @return  包围盒（第0层坐标）
+     */
+    QRectF getBounds() const { return _bounds; }
+
+    /**
+     * @brief   获取文件路径
+     * @return  打开的文件路径
+     */
+    QString fileName() const { return _file.fileName(); }
+
+    /**
+     * @brief   查询包围盒与矩形相交的数据块
+     * @param   rect 查询矩形（第0层坐标）
+     * @return  数据块编号
+     */
+    std::vector<int> chunksInRect(const QRectF& rect) const;
+
+    /**
+     * @brief   读取一个数据块
+     * @param   chunk 数据块编号
+     * @param   records 读取的记录追加到末尾
+     * @return  读取或解压失败时返回false
+     */
+    bool readChunk(int chunk, std::vector<AnnotationRecord>& records);
+
+    /**
+     * @brief   读取与矩形相交的记录
+     * @param   rect 查询矩形（第0层坐标）
+     * @return  包围盒与矩形相交的记录
+     */
+    std::vector<AnnotationRecord> read(const QRectF& rect);
+
+    /**
+     * @brief   逐块导出为JSON-seq文件
+     * @param   path 输出文件路径，每行一个toJson对象
+     * @return  成功时返回true
+     */
+    bool exportJsonSeq(const QString& path);
+
+private:
+    /**
+     * @brief 数据块索引项
+     */
+    struct ChunkInfo {
+        QRectF bounds;
+        qint64 offset;
+        quint32 storedSize;
+        quint32 count;
+    };
+
+    QFile _file;
+    std::vector<ChunkInfo> _chunks;
+    QRectF _bounds;
+    unsigned long long _count;
+};
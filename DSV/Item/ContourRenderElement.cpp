@@ -62,6 +62,7 @@ ContourRenderElement::ContourRenderElement(QString strName, QVector<QPointF> pts
     setZValue(10);                 // 设置Z轴值
     setFlags(ItemIsMovable|ItemIsSelectable|ItemIsFocusable);  // 设置交互标志
     // 移除 ItemIgnoresTransformations，改用自定义绘制
+    recomputeMetrics(polygon());
     
     //// 创建文本项显示描述信息
     //m_pTextItem = new QGraphicsTextItem(this);
@@ -91,8 +92,44 @@ ContourRenderElement::~ContourRenderElement()
 void ContourRenderElement::addPoint(const QPointF& pt)
 {
     QPolygonF poly = polygon();  // 获取当前多边形
+    if (poly.size() != m_metricsVertices) {
+        recomputeMetrics(poly);
+        m_runPoints.clear();
+    }
+    if (m_simplifyTolerance > 0. && !poly.isEmpty()) {
+        const QPointF last = poly.last();
+        // 距离阈值：离最后一个顶点太近的采样点直接丢弃
+        if (std::hypot(pt.x() - last.x(), pt.y() - last.y()) < m_simplifyTolerance) {
+            return;
+        }
+        // 角度阈值：最后一个顶点与被它替换过的采样点都在新线段的容差内时，用新点替换最后一个顶点
+        if (poly.size() >= 2 && m_runPoints.size() < kMaxRunPoints) {
+            const QPointF prev = poly.at(poly.size() - 2);
+            const bool forward = (last.x() - prev.x()) * (pt.x() - last.x()) + (last.y() - prev.y()) * (pt.y() - last.y()) > 0.;
+            bool collinear = forward && segmentDistance(last, prev, pt) < m_simplifyTolerance;
+            for (size_t i = 0; collinear && i < m_runPoints.size(); ++i) {
+                collinear = segmentDistance(m_runPoints[i], prev, pt) < m_simplifyTolerance;
+            }
+            if (collinear) {
+                m_openPerimeter += std::hypot(pt.x() - prev.x(), pt.y() - prev.y()) - std::hypot(last.x() - prev.x(), last.y() - prev.y());
+                m_openCrossSum += (prev.x() * pt.y() - pt.x() * prev.y()) - (prev.x() * last.y() - last.x() * prev.y());
+                m_runPoints.push_back(last);
+                poly.last() = pt;
+                setPolygon(poly);
+                return;
+            }
+        }
+        m_runPoints.clear();
+    }
+    if (!poly.isEmpty()) {
+        // 只累加新增的一条边
+        const QPointF& last = poly.last();
+        m_openPerimeter += std::hypot(pt.x() - last.x(), pt.y() - last.y());
+        m_openCrossSum += last.x() * pt.y() - pt.x() * last.y();
+    }
     poly.append(pt);             // 添加新点
-    updateContour(poly);         // 更新轮廓
+    m_metricsVertices = poly.size();
+    setPolygon(poly);
 }
 
 /**
@@ -103,6 +140,8 @@ void ContourRenderElement::addPoint(const QPointF& pt)
 void ContourRenderElement::updateContour(QVector<QPointF> pts)
 {
     setPolygon(QPolygonF(pts));  // 设置新的多边形
+    recomputeMetrics(polygon());
+    m_runPoints.clear();
     //setToolTip(getDescription()); // 更新工具提示
     //
     //// 创建或更新文本项
@@ -149,48 +188,157 @@ void ContourRenderElement::hoverEnterEvent(QGraphicsSceneHoverEvent* event)
     update();
 }
 
+/**
+ * @brief 设置绘制时的简化容差
+ * @param tolerance 容差（场景坐标），0表示不简化
+ */
+void ContourRenderElement::setSimplifyTolerance(qreal tolerance)
+{
+    m_simplifyTolerance = tolerance;
+    m_runPoints.clear();
+}
+
+/**
+ * @brief 结束绘制
+ * @details 以简化容差对整条轮廓执行Douglas-Peucker简化，并重新计算几何度量
+ */
+void ContourRenderElement::finishContour()
+{
+    m_runPoints.clear();
+    if (m_simplifyTolerance <= 0.) {
+        return;
+    }
+    const QPolygonF poly = polygon();
+    const QPolygonF simplified = simplify(poly, m_simplifyTolerance);
+    if (simplified.size() != poly.size()) {
+        setPolygon(simplified);
+        recomputeMetrics(simplified);
+    }
+}
+
+/**
+ * @brief 点到线段的距离
+ * @param pt 点
+ * @param a 线段起点
+ * @param b 线段终点
+ * @return 距离
+ */
+qreal ContourRenderElement::segmentDistance(const QPointF& pt, const QPointF& a, const QPointF& b)
+{
+    const qreal dx = b.x() - a.x();
+    const qreal dy = b.y() - a.y();
+    const qreal lengthSquared = dx * dx + dy * dy;
+    qreal t = 0.;
+    if (lengthSquared > 0.) {
+        t = ((pt.x() - a.x()) * dx + (pt.y() - a.y()) * dy) / lengthSquared;
+        t = qBound(0., t, 1.);
+    }
+    return std::hypot(pt.x() - (a.x() + t * dx), pt.y() - (a.y() + t * dy));
+}
+
+/**
+ * @brief Douglas-Peucker折线简化
+ * @param poly 折线
+ * @param tolerance 容差
+ * @return 保留首尾顶点、其余顶点与简化结果的距离不超过容差的折线
+ * @details 使用显式栈代替递归，5万个顶点的轮廓也不会栈溢出
+ */
+QPolygonF ContourRenderElement::simplify(const QPolygonF& poly, qreal tolerance)
+{
+    const int numPoints = poly.size();
+    if (numPoints < 3 || tolerance <= 0.) {
+        return poly;
+    }
+    std::vector<bool> keep(numPoints, false);
+    keep[0] = true;
+    keep[numPoints - 1] = true;
+    std::vector<std::pair<int, int> > stack;
+    stack.push_back(std::make_pair(0, numPoints - 1));
+    while (!stack.empty()) {
+        const int first = stack.back().first;
+        const int last = stack.back().second;
+        stack.pop_back();
+        qreal maxDistance = 0.;
+        int farthest = -1;
+        for (int i = first + 1; i < last; ++i) {
+            const qreal distance = segmentDistance(poly.at(i), poly.at(first), poly.at(last));
+            if (distance > maxDistance) {
+                maxDistance = distance;
+                farthest = i;
+            }
+        }
+        if (farthest >= 0 && maxDistance > tolerance) {
+            keep[farthest] = true;
+            stack.push_back(std::make_pair(first, farthest));
+            stack.push_back(std::make_pair(farthest, last));
+        }
+    }
+    QPolygonF simplified;
+    for (int i = 0; i < numPoints; ++i) {
+        if (keep[i]) {
+            simplified.append(poly.at(i));
+        }
+    }
+    return simplified;
+}
+
+/**
+ * @brief 重新计算折线的几何度量
+ * @param poly 多边形
+ * @details 累计从第一个顶点到最后一个顶点的各边长度和叉积和，不含闭合边
+ */
+void ContourRenderElement::recomputeMetrics(const QPolygonF& poly)
+{
+    m_openPerimeter = 0.;
+    m_openCrossSum = 0.;
+    for (int i = 0; i + 1 < poly.size(); ++i) {
+        const QPointF& currentPoint = poly.at(i);
+        const QPointF& nextPoint = poly.at(i + 1);
+        m_openPerimeter += std::hypot(nextPoint.x() - currentPoint.x(), nextPoint.y() - currentPoint.y());
+        m_openCrossSum += currentPoint.x() * nextPoint.y() - nextPoint.x() * currentPoint.y();
+    }
+    m_metricsVertices = poly.size();
+}
+
 /**
  * @brief 计算轮廓面积
  * @return 轮廓的实际面积（平方微米）
- * @details 使用多边形面积公式计算轮廓的实际面积
+ * @details 鞋带公式：缓存的叉积和加上闭合边的叉积，取绝对值的一半，与顶点数无关。
+ *          多边形被setPolygon直接修改（顶点数变化）时重新计算缓存
  */
 float ContourRenderElement:: getArea()
 {
-    QPolygonF poly = polygon();  // 获取多边形
-    double area = 0;
-    int numPoints = poly.size();
-    
-    // 使用多边形面积公式计算面积
-    for (int i = 0; i < numPoints - 1; ++i) {
-        QPointF currentPoint = poly.at(i);
-        QPointF nextPoint = poly.at(i + 1);
-        area += (currentPoint.x() * nextPoint.y() - nextPoint.x() * currentPoint.y());
+    const QPolygonF poly = polygon();  // 获取多边形
+    if (poly.size() != m_metricsVertices) {
+        recomputeMetrics(poly);
     }
-    
-    return qAbs(area / 4.0)*data(0).toDouble()*data(0).toDouble();
+    if (poly.size() < 3) {
+        return 0.0f;
+    }
+    const QPointF& first = poly.first();
+    const QPointF& last = poly.last();
+    const double area = m_openCrossSum + (last.x() * first.y() - first.x() * last.y());
+    const double pixelSize = data(0).toDouble();
+    return qAbs(area / 2.0) * pixelSize * pixelSize;
 }
 
 /**
  * @brief 计算轮廓周长
  * @return 轮廓的实际周长（微米）
- * @details 计算轮廓各边长的总和
+ * @details 缓存的各边长度之和加上最后一个顶点到第一个顶点的闭合边
  */
 float ContourRenderElement::getPerimeter()
 {
-    QPolygonF poly = polygon();  // 获取多边形
-    double perimeter = 0;
-    int numPoints = poly.size();
-    
-    // 计算各边长度的总和
-    for (int i = 0; i < numPoints; ++i) {
-        int nextIndex = (i + 1) % numPoints;  // 下一个顶点索引，循环处理最后一个顶点到第一个顶点的情况
-        QPointF currentPoint = poly.at(i);
-        QPointF nextPoint = poly.at(nextIndex);
-        double dx = nextPoint.x() - currentPoint.x();
-        double dy = nextPoint.y() - currentPoint.y();
-        perimeter += sqrt(dx * dx + dy * dy);
+    const QPolygonF poly = polygon();  // 获取多边形
+    if (poly.size() != m_metricsVertices) {
+        recomputeMetrics(poly);
     }
-    
+    if (poly.size() < 2) {
+        return 0.0f;
+    }
+    const QPointF& first = poly.first();
+    const QPointF& last = poly.last();
+    const double perimeter = m_openPerimeter + std::hypot(first.x() - last.x(), first.y() - last.y());
     return perimeter * data(0).toDouble();
 }
 
@@ -215,14 +363,8 @@ void ContourRenderElement::hoverLeaveEvent(QGraphicsSceneHoverEvent* event)
  */
 QString ContourRenderElement::getDescription()
 {
-    float area = getArea();
-    float perimeter = getPerimeter();
-    
-    // 使用与直线一致的格式，分行显示
-    QString areaText = RenderElement::formatMeasurement(area, true);
-    QString perimeterText = RenderElement::formatMeasurement(perimeter, false);
-    
-    return QStringLiteral("面积: %1\n周长: %2").arg(areaText).arg(perimeterText);
+    // 使用与直线一致的格式，分行显示，数值不变时复用缓存的文本
+    return measurementDescription(getPerimeter(), getArea(), true);
 }
 
 /**
@@ -324,8 +466,12 @@ int ContourRenderElement::getDynamicFontSize()
  */
 void ContourRenderElement::updateFontSize()
 {
+    // 字号只随视图大小变化，未变化时不重新设置字体，避免文本重新排版
     if (m_pTextItem) {
-        m_pTextItem->setFont(QFont("Microsoft YaHei", getDynamicFontSize(), QFont::Normal));  // 使用微软雅黑字体
+        const int fontSize = getDynamicFontSize();
+        if (labelFontSizeChanged(fontSize)) {
+            m_pTextItem->setFont(QFont("Microsoft YaHei", fontSize, QFont::Normal));  // 使用微软雅黑字体
+        }
     }
 }
 
@@ -33,6 +33,7 @@
 #include<QGraphicsView>
 #include<QGraphicsScene>
 #include<cmath>
+#include<vector>
 
 /**
  * @brief   轮廓渲染元素类
@@ -102,9 +103,33 @@ public:
     /**
      * @brief   添加轮廓点
      * @param   pt      新的轮廓点坐标
-     * @details 向轮廓中添加一个新的点，动态扩展轮廓形状
+     * @details 向轮廓中添加一个新的点，动态扩展轮廓形状；
+     *          面积和周长只累加新增的一条边，绘制时逐点调用的开销与顶点数无关。
+     *          设置了简化容差时在线抽稀：离最后一个顶点不足容差的点被丢弃，
+     *          与前两个顶点近似共线的点替换最后一个顶点
      */
     void addPoint(const QPointF& pt);
+
+    /**
+     * @brief   设置绘制时的简化容差
+     * @param   tolerance   容差（场景坐标），通常取绘制时缩放下半个屏幕像素，0表示不简化
+     * @see     addPoint, finishContour
+     */
+    void setSimplifyTolerance(qreal tolerance);
+
+    /**
+     * @brief   结束绘制
+     * @details 以简化容差执行Douglas-Peucker简化，误差在绘制时的缩放下不超过容差
+     */
+    void finishContour();
+
+    /**
+     * @brief   Douglas-Peucker折线简化
+     * @param   poly        折线
+     * @param   tolerance   容差
+     * @return  简化后的折线，保留首尾顶点
+     */
+    static QPolygonF simplify(const QPolygonF& poly, qreal tolerance);
     
     /**
      * @brief   获取轮廓点数量
@@ -263,8 +288,37 @@ private:
      */
     void updateFontSize();
     
+    /**
+     * @brief   重新计算缓存的几何度量
+     * @param   poly    多边形
+     */
+    void recomputeMetrics(const QPolygonF& poly);
+
+    /**
+     * @brief   点到线段的距离
+     */
+    static qreal segmentDistance(const QPointF& pt, const QPointF& a, const QPointF& b);
+
     /** @brief 文本标签项，显示轮廓面积、周长或名称 */
     QGraphicsTextItem* m_pTextItem = nullptr;
+
+    /** @brief 不含闭合边的各边长度之和（像素） */
+    double m_openPerimeter = 0.;
+
+    /** @brief 不含闭合边的鞋带公式叉积和（像素平方） */
+    double m_openCrossSum = 0.;
+
+    /** @brief 缓存对应的顶点数，与polygon()不一致时重新计算 */
+    int m_metricsVertices = 0;
+
+    /** @brief 绘制时的简化容差（场景坐标），0表示不简化 */
+    qreal m_simplifyTolerance = 0.;
+
+    /** @brief 被最后一个顶点替换过的采样点，用于检查替换的累积误差 */
+    std::vector<QPointF> m_runPoints;
+
+    /** @brief 连续替换的最大次数，限制检查累积误差的开销 */
+    static const size_t kMaxRunPoints = 64;
 signals:
     void sendPerimeter(float Perimeter);
     void sendArea(float Area);
@@ -125,14 +125,8 @@ void EllipseRenderElement::updateRect(QRectF rc)
  */
 QString EllipseRenderElement::getDescription()
 {
-    float area = getArea();
-    float perimeter = getPerimeter();
-    
-    // 使用与直线一致的格式，分行显示
-    QString areaText = RenderElement::formatMeasurement(area, true);
-    QString perimeterText = RenderElement::formatMeasurement(perimeter, false);
-    
-    return QStringLiteral("面积: %1\n周长: %2").arg(areaText).arg(perimeterText);
+    // 使用与直线一致的格式，分行显示，数值不变时复用缓存的文本
+    return measurementDescription(getPerimeter(), getArea(), true);
 }
 
 /**
@@ -385,10 +379,16 @@ void EllipseRenderElement::mouseMoveEvent(QGraphicsSceneMouseEvent* event)
             // 更新控制点位置
             updateControlPoints();
             
-            // 更新工具提示和文本显示
-            setToolTip(getDescription());
+            // 更新工具提示和文本显示，测量值未变化时跳过
+            bool labelChanged = false;
+            const QString description = measurementDescription(getPerimeter(), getArea(), true, &labelChanged);
+            if (labelChanged) {
+                setToolTip(description);
+            }
             if (m_pTextItem) {
-                m_pTextItem->setText(getDescription());
+                if (labelChanged) {
+                    m_pTextItem->setText(description);
+                }
                 m_pTextItem->setPos(rect().center());  // 更新文本位置
             }
             
@@ -577,8 +577,12 @@ int EllipseRenderElement::getDynamicFontSize()
  */
 void EllipseRenderElement::updateFontSize()
 {
+    // 字号只随视图大小变化，未变化时不重新设置字体，避免文本重新排版
     if (m_pTextItem) {
-        m_pTextItem->setFont(QFont("Microsoft YaHei", getDynamicFontSize(), QFont::Normal));  // 使用微软雅黑字体
+        const int fontSize = getDynamicFontSize();
+        if (labelFontSizeChanged(fontSize)) {
+            m_pTextItem->setFont(QFont("Microsoft YaHei", fontSize, QFont::Normal));  // 使用微软雅黑字体
+        }
     }
 }
 
@@ -67,7 +67,7 @@ LineRenderElement::LineRenderElement(QString strName, const QPointF& pt1, const
     // 移除 ItemIgnoresTransformations，改用自定义绘制
     setToolTip(getDescription());
     m_pTextItem = new QGraphicsSimpleTextItem(this);
-    m_pTextItem->setFont(QFont("Microsoft YaHei", getDynamicFontSize(), QFont::Normal));  // 使用微软雅黑字体
+    updateFontSize();
     m_pTextItem->setFlag(ItemIgnoresTransformations);  // 忽略变换
     
     // 使用智能单位转换显示长度信息
@@ -110,12 +110,8 @@ void LineRenderElement::updateLine(const QPointF& pt1, const QPointF& pt2)
  */
 QString LineRenderElement::getDescription()
 {
-    float perimeter = getPerimeter();
-    
     // 线条只显示长度（周长），不显示面积
-    QString perimeterText = RenderElement::formatMeasurement(perimeter, false);
-    
-    return QStringLiteral("长度: %1").arg(perimeterText);
+    return measurementDescription(getPerimeter(), 0.0f, false);
 }
 
 /**
@@ -383,8 +379,12 @@ int LineRenderElement::getDynamicFontSize()
  */
 void LineRenderElement::updateFontSize()
 {
+    // 字号只随视图大小变化，未变化时不重新设置字体，避免文本重新排版
     if (m_pTextItem) {
-        m_pTextItem->setFont(QFont("Microsoft YaHei", getDynamicFontSize(), QFont::Normal));  // 使用微软雅黑字体
+        const int fontSize = getDynamicFontSize();
+        if (labelFontSizeChanged(fontSize)) {
+            m_pTextItem->setFont(QFont("Microsoft YaHei", fontSize, QFont::Normal));  // 使用微软雅黑字体
+        }
     }
 }
 
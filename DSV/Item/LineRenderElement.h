@@ -273,7 +273,12 @@ protected:
 
             // 更新文本项
             if (m_pTextItem) {
-                m_pTextItem->setText(QStringLiteral("长度: %1").arg(RenderElement::formatMeasurement(getPerimeter(), false)));
+                // 长度未变化时不重新设置文本，避免重新排版
+                bool labelChanged = false;
+                const QString description = measurementDescription(getPerimeter(), 0.0f, false, &labelChanged);
+                if (labelChanged) {
+                    m_pTextItem->setText(description);
+                }
                 m_pTextItem->setPos((currentLine.p1() + currentLine.p2()) / 2.0 + QPointF(10.0, 10.0));
             }
             emit sendLength(getPerimeter());  // 发送最终长度
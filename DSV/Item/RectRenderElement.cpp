@@ -290,10 +290,14 @@ void RectRenderElement::mouseMoveEvent(QGraphicsSceneMouseEvent* event)
             // 更新控制点位置
             updateControlPointsPosition();
             
-            // 更新工具提示和文本显示
-        setToolTip(getDescription());
-            if (m_pTextItem) {
-        m_pTextItem->setPlainText(getDescription());
+            // 更新工具提示和文本显示，测量值未变化时跳过
+            bool labelChanged = false;
+            const QString description = measurementDescription(getPerimeter(), getArea(), true, &labelChanged);
+            if (labelChanged) {
+                setToolTip(description);
+                if (m_pTextItem) {
+                    m_pTextItem->setPlainText(description);
+                }
             }
             
             // 更新最后鼠标位置
@@ -337,14 +341,8 @@ void RectRenderElement::mouseReleaseEvent(QGraphicsSceneMouseEvent* event)
  */
 QString RectRenderElement::getDescription()
 {
-    float area = getArea();
-    float perimeter = getPerimeter();
-    
-    // 使用与直线一致的格式，分行显示
-    QString areaText = RenderElement::formatMeasurement(area, true);
-    QString perimeterText = RenderElement::formatMeasurement(perimeter, false);
-    
-    return QStringLiteral("面积: %1\n周长: %2").arg(areaText).arg(perimeterText);
+    // 使用与直线一致的格式，分行显示，数值不变时复用缓存的文本
+    return measurementDescription(getPerimeter(), getArea(), true);
 }
 
 /**
@@ -469,9 +467,7 @@ QVariant RectRenderElement::itemChange(GraphicsItemChange change, const QVariant
         if (!m_controlPoints.isEmpty()) {
             updateControlPointsPosition();
         }
-        if (m_pTextItem) {
-            m_pTextItem->setFont(QFont("Microsoft YaHei", getDynamicFontSize(), QFont::Normal));
-        }
+        updateFontSize();
     }
     return QGraphicsRectItem::itemChange(change, value);
 }
@@ -598,7 +594,11 @@ int RectRenderElement::getDynamicFontSize()
  */
 void RectRenderElement::updateFontSize()
 {
+    // 字号只随视图大小变化，未变化时不重新设置字体，避免文本重新排版
     if (m_pTextItem) {
-        m_pTextItem->setFont(QFont("Microsoft YaHei", getDynamicFontSize(), QFont::Normal));  // 使用微软雅黑字体
+        const int fontSize = getDynamicFontSize();
+        if (labelFontSizeChanged(fontSize)) {
+            m_pTextItem->setFont(QFont("Microsoft YaHei", fontSize, QFont::Normal));  // 使用微软雅黑字体
+        }
     }
 }
\ No newline at end of file
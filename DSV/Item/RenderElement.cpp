@@ -24,22 +24,24 @@ RenderElement::RenderElement(QString strName)
 	m_strName = strName;
 	m_pen.setColor(Qt::black);
 	m_pen.setWidth(2);
+	m_dPixelSize = 1.0;
 }
 
 /**
  * @brief 构造函数：通过JSON对象初始化渲染元素
  * @param json JSON对象
- * @details 从JSON对象中解析渲染元素的属性，包括类型、颜色、线宽、名称和像素尺寸
+ * @details 从JSON对象中解析渲染元素的属性，包括类型、颜色、线宽、名称和像素尺寸。
+ *          属性可以位于base对象中，也可以位于顶层（toJson的输出）
  */
 RenderElement::RenderElement(QJsonObject json)
 {
-	QJsonObject base = json["base"].toObject();
+	QJsonObject base = json.contains("base") ? json["base"].toObject() : json;
 	m_elementType = (ElementType)base["type"].toInt();
 	int red= base["r"].toInt();
 	int green = base["g"].toInt();
 	int blue = base["b"].toInt();
 	m_pen.setColor(QColor(red, green, blue));
-	int nLineWidth = base["width"].toInt();
+	int nLineWidth = base.contains("lineWidth") ? base["lineWidth"].toInt() : base["width"].toInt();
 	m_pen.setWidth(nLineWidth);
 	m_strName = base["name"].toString();
 	m_dPixelSize = base["pixelSize"].toDouble();
@@ -161,3 +163,44 @@ QString RenderElement::formatMeasurement(float value, bool isArea)
     
     return QString("%1 %2").arg(valueStr).arg(unit);
 }
+
+/**
+ * @brief 获取缓存的测量描述
+ * @param perimeter 周长（微米），直线为长度
+ * @param area 面积（平方微米）
+ * @param withArea 是否显示面积
+ * @param changed 可选，返回描述是否与上次不同
+ * @return 测量描述文本
+ * @details 拖拽控制点时每次鼠标移动都会请求描述，数值不变时不再重新格式化
+ */
+const QString& RenderElement::measurementDescription(float perimeter, float area, bool withArea, bool* changed)
+{
+	const bool stale = !m_labelValid || m_labelPerimeter != perimeter || m_labelWithArea != withArea || (withArea && m_labelArea != area);
+	if (stale) {
+		m_labelText = withArea
+			? QStringLiteral("面积: %1\n周长: %2").arg(formatMeasurement(area, true)).arg(formatMeasurement(perimeter, false))
+			: QStringLiteral("长度: %1").arg(formatMeasurement(perimeter, false));
+		m_labelPerimeter = perimeter;
+		m_labelArea = area;
+		m_labelWithArea = withArea;
+		m_labelValid = true;
+	}
+	if (changed) {
+		*changed = stale;
+	}
+	return m_labelText;
+}
+
+/**
+ * @brief 记录标签字号
+ * @param fontSize 新的字号
+ * @return 字号变化时返回true
+ */
+bool RenderElement::labelFontSizeChanged(int fontSize)
+{
+	if (m_labelFontSize == fontSize) {
+		return false;
+	}
+	m_labelFontSize = fontSize;
+	return true;
+}
@@ -160,6 +160,13 @@ public:
      */
     void setPixelSize(double dPixelSize);
 
+    /**
+     * @brief   获取像素大小
+     * @return  像素大小值
+     * @see     setPixelSize
+     */
+    double getPixelSize() { return m_dPixelSize; }
+
     /**
      * @brief   获取线宽
      * @details 返回当前设置的线宽值
@@ -248,6 +255,25 @@ public:
     static QString formatMeasurement(float value, bool isArea = false);
 
 protected:
+    /**
+     * @brief   获取缓存的测量描述
+     * @param   perimeter   周长（微米），直线为长度
+     * @param   area        面积（平方微米）
+     * @param   withArea    是否显示面积，为false时显示为长度
+     * @param   changed     可选，返回描述是否与上次不同
+     * @return  测量描述文本
+     * @details 周长和面积与上次相同时直接返回缓存的文本，几何或像素大小变化后数值改变，
+     *          描述随之重新格式化。调用者可据changed跳过工具提示和标签的重新排版
+     */
+    const QString& measurementDescription(float perimeter, float area, bool withArea, bool* changed = nullptr);
+
+    /**
+     * @brief   记录标签字号
+     * @param   fontSize    新的字号
+     * @return  字号与上次记录的不同时返回true，调用者需要重新设置字体
+     */
+    bool labelFontSizeChanged(int fontSize);
+
     /** @brief 元素类型，标识当前元素的具体类型 */
     ElementType m_elementType;
 
@@ -260,5 +286,24 @@ protected:
     /** @brief 像素大小，用于坐标转换和缩放计算 */
     double m_dPixelSize;
 
+private:
+    /** @brief 缓存的测量描述 */
+    QString m_labelText;
+
+    /** @brief 生成缓存描述时的周长 */
+    float m_labelPerimeter = 0.0f;
+
+    /** @brief 生成缓存描述时的面积 */
+    float m_labelArea = 0.0f;
+
+    /** @brief 缓存描述是否包含面积 */
+    bool m_labelWithArea = false;
+
+    /** @brief 缓存描述是否有效 */
+    bool m_labelValid = false;
+
+    /** @brief 标签当前使用的字号，0表示尚未设置 */
+    int m_labelFontSize = 0;
+
 
 };
\ No newline at end of file
@@ -0,0 +1,445 @@
+﻿/**
+ * @file LabelMaskImage.cpp
+ * @brief 标签掩膜图像实现文件
+ * @details 该文件实现了.dlm标签掩膜的读取，包括：
+ *          - 文件映射和文件头、瓦片表的校验
+ *          - 瓦片游程的编码和解码
+ *          - 按区域裁剪的游程填充，输出标签或查找表颜色
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "LabelMaskImage.h"
+#include "PipelineProfiler.h"
+#include "TileBufferPool.h"
+#include "UtilityFunctions.h"
+#include <QtEndian>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <shared_mutex>
+
+const char LabelMaskImage::kMagic[8] = { 'D', 'S', 'V', 'L', 'M', 'S', 'K', '1' };
+
+namespace {
+
+    /**
+     * @brief 读取一个LEB128无符号整数
+     * @param data 当前位置，成功时前移
+     * @param end 数据结尾
+     * @param value 输出值
+     * @return 数据完整且不超过64位时返回true
+     */
+    bool readVarint(const unsigned char*& data, const unsigned char* end, unsigned long long& value)
+    {
+        value = 0;
+        for (unsigned int shift = 0; shift < 64 && data < end; shift += 7) {
+            const unsigned char byte = *data++;
+            value |= static_cast<unsigned long long>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief 追加一个LEB128无符号整数
+     */
+    void writeVarint(unsigned long long value, std::vector<unsigned char>& out)
+    {
+        while (value >= 0x80) {
+            out.push_back(static_cast<unsigned char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<unsigned char>(value));
+    }
+}
+
+/**
+ * @brief 构造函数
+ */
+LabelMaskImage::LabelMaskImage()
+    : MultiResolutionImage(),
+    _mapped(NULL),
+    _mappedSize(0),
+    _tileSize(0),
+    _maxLabel(0)
+{
+    setLabelLUT(SlideColorManagement::DefaultColorLUT["Label"]);
+}
+
+/**
+ * @brief 析构函数
+ */
+LabelMaskImage::~LabelMaskImage()
+{
+    std::unique_lock<std::shared_mutex> l(*_openCloseMutex);
+    cleanup();
+    MultiResolutionImage::cleanup();
+}
+
+/**
+ * @brief 检查文件头是否为标签掩膜格式
+ * @param header 文件开头的字节
+ * @param length 字节数
+ * @return 以魔数开头时返回true
+ */
+bool LabelMaskImage::matchesSignature(const unsigned char* header, size_t length)
+{
+    return length >= sizeof(kMagic) && std::memcmp(header, kMagic, sizeof(kMagic)) == 0;
+}
+
+/**
+ * @brief 打开标签掩膜文件
+ * @param imagePath 文件路径
+ * @return 文件有效时返回true
+ * @details 瓦片表中每一项的范围都在映射之内，解码时只需检查游程本身
+ */
+bool LabelMaskImage::initializeType(const std::string& imagePath)
+{
+    std::unique_lock<std::shared_mutex> l(*_openCloseMutex);
+    cleanup();
+
+    _file.setFileName(QString::fromStdString(imagePath));
+    if (!_file.open(QIODevice::ReadOnly) || _file.size() < kHeaderSize) {
+        cleanup();
+        _isValid = false;
+        return false;
+    }
+    _mappedSize = static_cast<unsigned long long>(_file.size());
+    _mapped = _file.map(0, _file.size());
+    if (!_mapped || !matchesSignature(_mapped, _mappedSize)) {
+        cleanup();
+        _isValid = false;
+        return false;
+    }
+
+    _tileSize = qFromLittleEndian<quint32>(_mapped + 8);
+    const unsigned int levels = qFromLittleEndian<quint32>(_mapped + 12);
+    _maxLabel = qFromLittleEndian<quint32>(_mapped + 16);
+    unsigned long long position = kHeaderSize;
+    if (_tileSize == 0 || levels == 0 || levels > 64 || _maxLabel > 255 || position + levels * 16ULL > _mappedSize) {
+        cleanup();
+        _isValid = false;
+        return false;
+    }
+    for (unsigned int level = 0; level < levels; ++level) {
+        std::vector<unsigned long long> dims;
+        dims.push_back(qFromLittleEndian<quint64>(_mapped + position));
+        dims.push_back(qFromLittleEndian<quint64>(_mapped + position + 8));
+        position += 16;
+        if (dims[0] == 0 || dims[1] == 0 || (level > 0 && (dims[0] > _levelDimensions[0][0] || dims[1] > _levelDimensions[0][1]))) {
+            cleanup();
+            _isValid = false;
+            return false;
+        }
+        _levelDimensions.push_back(dims);
+        _levelTileSizes.push_back(std::vector<unsigned long long>(2, _tileSize));
+    }
+    for (unsigned int level = 0; level < levels; ++level) {
+        const unsigned long long columns = _levelDimensions[level][0] / _tileSize + (_levelDimensions[level][0] % _tileSize != 0);
+        const unsigned long long rows = _levelDimensions[level][1] / _tileSize + (_levelDimensions[level][1] % _tileSize != 0);
+        // 先用除法比较，损坏的头部给出的尺寸使columns * rows溢出时也会被拒绝
+        const unsigned long long maxEntries = (_mappedSize - position) / 16;
+        if (rows == 0 || columns > maxEntries / rows) {
+            cleanup();
+            _isValid = false;
+            return false;
+        }
+        std::vector<TileEntry> tiles(static_cast<size_t>(columns * rows));
+        for (TileEntry& tile : tiles) {
+            tile.offset = qFromLittleEndian<quint64>(_mapped + position);
+            tile.length = qFromLittleEndian<quint64>(_mapped + position + 8);
+            position += 16;
+            if (tile.offset > _mappedSize || tile.length > _mappedSize - tile.offset) {
+                cleanup();
+                _isValid = false;
+                return false;
+            }
+        }
+        _tileColumns.push_back(columns);
+        _tiles.push_back(tiles);
+    }
+    _numberOfLevels = levels;
+
+    _dataType = SlideColorManagement::DataType::UChar;
+    _samplesPerPixel = 1;
+    _colorType = SlideColorManagement::ColorType::Monochrome;
+    _fileType = "labelmask";
+
+    const double rawBytes = static_cast<double>(_levelDimensions[0][0]) * _levelDimensions[0][1];
+    _properties.emplace_back("labelmask.tile-size", true, static_cast<double>(_tileSize));
+    _properties.emplace_back("labelmask.max-label", true, static_cast<double>(_maxLabel));
+    _properties.emplace_back("labelmask.compression-ratio", true, rawBytes / std::max<unsigned long long>(_mappedSize, 1));
+    _properties.emplace_back("openslide.level-count", true, static_cast<double>(_numberOfLevels));
+    _properties.emplace_back("openslide.level[0].width", true, static_cast<double>(_levelDimensions[0][0]));
+    _properties.emplace_back("openslide.level[0].height", true, static_cast<double>(_levelDimensions[0][1]));
+
+    _isValid = true;
+    return _isValid;
+}
+
+/**
+ * @brief 清理资源
+ * @details 解除文件映射并清空层级、瓦片表和属性
+ */
+void LabelMaskImage::cleanup()
+{
+    if (_mapped) {
+        _file.unmap(const_cast<unsigned char*>(_mapped));
+    }
+    _file.close();
+    _mapped = NULL;
+    _mappedSize = 0;
+    _tileSize = 0;
+    _maxLabel = 0;
+    _tileColumns.clear();
+    _tiles.clear();
+    _levelDimensions.clear();
+    _levelTileSizes.clear();
+    _spacing.clear();
+    _properties.clear();
+}
+
+/**
+ * @brief 获取属性
+ * @param propertyName 属性名称
+ * @return 属性值，数值属性转换为字符串
+ */
+std::string LabelMaskImage::getProperty(const std::string& propertyName)
+{
+    for (const SlideColorManagement::PropertyInfo& property : _properties) {
+        if (property.name == propertyName) {
+            return property.isNumeric ? std::to_string(property.numericValue) : property.stringValue;
+        }
+    }
+    return std::string();
+}
+
+/**
+ * @brief 获取标签图
+ * @return 空图像
+ */
+const QImage LabelMaskImage::getLabel()
+{
+    return QImage();
+}
+
+/**
+ * @brief 获取图像属性
+ * @return 属性列表
+ */
+const std::vector<SlideColorManagement::PropertyInfo> LabelMaskImage::getProperties()
+{
+    return _properties;
+}
+
+/**
+ * @brief 设置ARGB32解码使用的标签查找表
+ * @param LUT 查找表
+ * @details 颜色与白色背景合成为不透明像素；相对查找表按最大标签值归一化
+ */
+void LabelMaskImage::setLabelLUT(const SlideColorManagement::LUT& LUT)
+{
+    std::unique_lock<std::shared_mutex> l(*_openCloseMutex);
+    for (unsigned int label = 0; label < 256; ++label) {
+        const float value = LUT.relative ? (_maxLabel > 0 ? static_cast<float>(label) / _maxLabel : 0.f) : static_cast<float>(label);
+        const unsigned int color = applyLUT(value, LUT);
+        const unsigned int alpha = qAlpha(color);
+        const unsigned int background = 255 * (255 - alpha);
+        _palette[label] = qRgb((qRed(color) * alpha + background) / 255, (qGreen(color) * alpha + background) / 255,
+            (qBlue(color) * alpha + background) / 255);
+    }
+}
+
+/**
+ * @brief 游程编码一个瓦片
+ * @param labels 紧密排列的标签
+ * @param width 瓦片宽度
+ * @param height 瓦片高度
+ * @param encoded 追加编码结果的缓冲区
+ * @details 游程按光栅顺序跨行延续，整块背景的瓦片只有两三个字节
+ */
+void LabelMaskImage::encodeTile(const unsigned char* labels, unsigned long long width, unsigned long long height, std::vector<unsigned char>& encoded)
+{
+    const unsigned long long count = width * height;
+    unsigned long long position = 0;
+    while (position < count) {
+        const unsigned char value = labels[position];
+        unsigned long long end = position + 1;
+        while (end < count && labels[end] == value) {
+            ++end;
+        }
+        encoded.push_back(value);
+        writeVarint(end - position - 1, encoded);
+        position = end;
+    }
+}
+
+/**
+ * @brief 解码一个瓦片
+ * @param encoded 编码数据
+ * @param size 编码数据的字节数
+ * @param width 瓦片宽度
+ * @param height 瓦片高度
+ * @param labels 输出的标签，调用前清零
+ * @return 游程恰好覆盖整个瓦片时返回true
+ */
+bool LabelMaskImage::decodeTile(const unsigned char* encoded, unsigned long long size, unsigned long long width, unsigned long long height, unsigned char* labels)
+{
+    const unsigned char* data = encoded;
+    const unsigned char* end = encoded + size;
+    const unsigned long long count = width * height;
+    unsigned long long position = 0;
+    while (position < count && data < end) {
+        const unsigned char value = *data++;
+        unsigned long long length = 0;
+        if (!readVarint(data, end, length) || length >= count - position) {
+            return false;
+        }
+        std::memset(labels + position, value, static_cast<size_t>(length + 1));
+        position += length + 1;
+    }
+    return position == count;
+}
+
+/**
+ * @brief 把区域内各瓦片的游程裁剪后写入输出
+ * @details 游程按瓦片内的行拆分，只有落在区域内的部分写入；游程不足或数据损坏时停止解码该瓦片
+ */
+template <typename T, typename Lookup>
+void LabelMaskImage::decodeRegion(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level, T* data, Lookup lookup) const
+{
+    const std::vector<unsigned long long>& dims = _levelDimensions[level];
+    const double downsample = static_cast<double>(_levelDimensions[0][0]) / dims[0];
+    const long long levelX = std::llround(startX / downsample);
+    const long long levelY = std::llround(startY / downsample);
+    const long long x0 = std::max(levelX, 0LL);
+    const long long y0 = std::max(levelY, 0LL);
+    const long long x1 = std::min(levelX + static_cast<long long>(width), static_cast<long long>(dims[0]));
+    const long long y1 = std::min(levelY + static_cast<long long>(height), static_cast<long long>(dims[1]));
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    const long long tileSize = _tileSize;
+    for (long long row = y0 / tileSize; row <= (y1 - 1) / tileSize; ++row) {
+        for (long long column = x0 / tileSize; column <= (x1 - 1) / tileSize; ++column) {
+            const TileEntry& tile = _tiles[level][static_cast<size_t>(row * _tileColumns[level] + column)];
+            const long long tileX = column * tileSize;
+            const long long tileY = row * tileSize;
+            const long long tileWidth = std::min(tileSize, static_cast<long long>(dims[0]) - tileX);
+            const long long tileHeight = std::min(tileSize, static_cast<long long>(dims[1]) - tileY);
+            // 瓦片内需要写出的列和行范围
+            const long long columnBegin = std::max(x0, tileX) - tileX;
+            const long long columnEnd = std::min(x1, tileX + tileWidth) - tileX;
+            const long long rowBegin = std::max(y0, tileY) - tileY;
+            const long long rowEnd = std::min(y1, tileY + tileHeight) - tileY;
+            const long long stop = rowEnd * tileWidth;
+
+            const unsigned char* encoded = _mapped + tile.offset;
+            const unsigned char* end = encoded + tile.length;
+            long long position = 0;
+            while (position < stop && encoded < end) {
+                const unsigned char value = *encoded++;
+                unsigned long long length = 0;
+                if (!readVarint(encoded, end, length) || length >= static_cast<unsigned long long>(tileWidth * tileHeight - position)) {
+                    break;
+                }
+                const long long runEnd = position + static_cast<long long>(length) + 1;
+                if (value != 0 && runEnd > rowBegin * tileWidth) {
+                    const T color = lookup(value);
+                    for (long long p = std::max(position, rowBegin * tileWidth); p < std::min(runEnd, stop);) {
+                        const long long y = p / tileWidth;
+                        const long long x = p - y * tileWidth;
+                        const long long rowStop = std::min(runEnd, (y + 1) * tileWidth);
+                        const long long a = std::max(x, columnBegin);
+                        const long long b = std::min(rowStop - y * tileWidth, columnEnd);
+                        if (a < b) {
+                            T* target = data + (tileY + y - levelY) * static_cast<long long>(width) + (tileX + a - levelX);
+                            std::fill(target, target + (b - a), color);
+                        }
+                        p = rowStop;
+                    }
+                }
+                position = runEnd;
+            }
+        }
+    }
+}
+
+/**
+ * @brief 读取区域的标签
+ * @param startX 起始X坐标（第0层坐标）
+ * @param startY 起始Y坐标（第0层坐标）
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @return 1通道标签数据，图像无效时返回NULL
+ */
+void* LabelMaskImage::readDataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level)
+{
+    unsigned char* labels = TileBufferPool::allocateArray<unsigned char>(width * height);
+    if (!readDataIntoBuffer(startX, startY, width, height, level, labels, m_currentZPlaneIndex)) {
+        TileBufferPool::release(labels);
+        return NULL;
+    }
+    return labels;
+}
+
+/**
+ * @brief 把区域的标签解码到调用者的缓冲区
+ * @param startX 起始X坐标（第0层坐标）
+ * @param startY 起始Y坐标（第0层坐标）
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @param data 输出缓冲区，width*height字节
+ * @param zPlane Z平面索引，掩膜只有一个平面，忽略
+ * @return 图像有效时返回true
+ * @details 图像范围以外和标签0的像素为0，只有非零游程需要写出
+ */
+bool LabelMaskImage::readDataIntoBuffer(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level, void* data, const unsigned int& zPlane)
+{
+    if (!_isValid || level >= _numberOfLevels) {
+        return false;
+    }
+
+    PipelineProfiler::ScopedTimer timer(PipelineProfiler::ReadDataFromImage, PipelineProfiler::ReadLabelMask);
+    std::shared_lock<std::shared_mutex> l(*_openCloseMutex);
+    unsigned char* labels = static_cast<unsigned char*>(data);
+    std::memset(labels, 0, static_cast<size_t>(width * height));
+    decodeRegion(startX, startY, width, height, level, labels, [](unsigned char value) { return value; });
+    return true;
+}
+
+/**
+ * @brief 按标签查找表直接解码为ARGB32
+ * @param startX 起始X坐标（第0层坐标）
+ * @param startY 起始Y坐标（第0层坐标）
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @param data 输出缓冲区
+ * @param zPlane Z平面索引，忽略
+ * @return 图像有效时返回true
+ */
+bool LabelMaskImage::readARGB32DataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level, unsigned int* data, const unsigned int& zPlane)
+{
+    if (!_isValid || level >= _numberOfLevels) {
+        return false;
+    }
+
+    PipelineProfiler::ScopedTimer timer(PipelineProfiler::ReadDataFromImage, PipelineProfiler::ReadLabelMask);
+    std::shared_lock<std::shared_mutex> l(*_openCloseMutex);
+    std::fill(data, data + width * height, _palette[0]);
+    const unsigned int* palette = _palette;
+    decodeRegion(startX, startY, width, height, level, data, [palette](unsigned char value) { return palette[value]; });
+    return true;
+}
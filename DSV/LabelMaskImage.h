@@ -0,0 +1,222 @@
+﻿/**
+ * @file    LabelMaskImage.h
+ * @brief   标签掩膜图像类，读取DSV的游程编码金字塔标签掩膜格式
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了分割结果专用的标签掩膜格式，包括：
+ *          - 内存映射的.dlm文件，瓦片按游程编码存放，打开时只解析文件头和瓦片表
+ *          - 瓦片的游程直接按区域裁剪写出，不经过完整瓦片的中间缓冲区
+ *          - 作为前景时输出8位标签，经IOWorker的查表路径着色
+ *          - 作为背景时按标签查找表直接解码为ARGB32
+ *          - 粗层级由LabelMaskWriter按2x2众数下采样生成，标签值不会被插值成不存在的类别
+ *
+ * @note    文件布局（小端）：
+ *          - 偏移0：8字节魔数"DSVLMSK1"
+ *          - 偏移8：uint32瓦片大小，uint32层级数L，uint32最大标签值，uint32保留
+ *          - 偏移24：L个层级的uint64宽度和uint64高度
+ *          - 之后：各层级按行优先排列的瓦片表，每项为uint64偏移和uint64长度
+ *          - 之后：瓦片数据，每个游程为1字节标签值加LEB128编码的(长度 - 1)，按瓦片内的光栅顺序排列
+ * @see     MultiResolutionImage, LabelMaskWriter, LabelMaskImageFactory
+ */
+
+#pragma once
+#include "MultiResolutionImage.h"
+#include <QFile>
+#include <QImage>
+#include <string>
+#include <vector>
+
+/**
+ * @class  LabelMaskImage
+ * @brief  标签掩膜图像类
+ * @details 文件整体映射到内存，瓦片只在读取时解码。掩膜通常由大片相同的标签组成，
+ *          游程编码的文件一般只有原始数据的1/50到1/100，解码只是按游程填充。
+ *
+ *          readDataIntoBuffer输出1通道unsigned char标签；readARGB32DataFromImage按setLabelLUT设置的查找表
+ *          输出不透明的预乘ARGB，透明的标签与白色合成，切片视图可以直接打开掩膜文件浏览。
+ *
+ * @note   只有一个Z平面；瓦片数据损坏时该瓦片剩余的像素为标签0
+ * @example
+ *          // 使用示例
+ *          LabelMaskImage* mask = new LabelMaskImage();
+ *          if (mask->initialize("segmentation.dlm")) {
+ *              unsigned char* labels = new unsigned char[512 * 512];
+ *              mask->getRawRegion<unsigned char>(0, 0, 512, 512, 0, labels);
+ *          }
+ * @see     MultiResolutionImage, LabelMaskWriter
+ */
+class LabelMaskImage : public MultiResolutionImage
+{
+public:
+    /**
+     * @brief   默认构造函数
+     * @details 查找表默认为DefaultColorLUT["Label"]
+     * @note    构造函数不会打开文件，需要调用initialize
+     */
+    LabelMaskImage();
+
+    /**
+     * @brief   析构函数
+     */
+    ~LabelMaskImage();
+
+    /**
+     * @brief   打开标签掩膜文件
+     * @details 映射文件并校验魔数、层级尺寸和瓦片表的范围
+     * @param   imagePath 文件路径
+     * @return  文件有效时返回true
+     */
+    bool initializeType(const std::string& imagePath);
+
+    /**
+     * @brief   获取通道最小值
+     * @return  标签值，始终为0
+     */
+    double getMinValue(int channel = -1) { return 0.; }
+
+    /**
+     * @brief   获取通道最大值
+     * @return  文件头记录的最大标签值
+     */
+    double getMaxValue(int channel = -1) { return _maxLabel; }
+
+    /**
+     * @brief   获取属性
+     * @param   propertyName 属性名称，与getProperties返回的名称相同
+     * @return  属性值，不存在时返回空字符串
+     */
+    std::string getProperty(const std::string& propertyName);
+
+    /**
+     * @brief   获取标签图
+     * @return  掩膜文件没有标签图，始终返回空图像
+     */
+    const QImage getLabel();
+
+    /**
+     * @brief   获取图像属性
+     * @details 包括瓦片大小、最大标签值和压缩比
+     * @return  属性列表
+     */
+    const std::vector<SlideColorManagement::PropertyInfo> getProperties();
+
+    /**
+     * @brief   设置ARGB32解码使用的标签查找表
+     * @details 查找表按标签值的绝对索引取颜色；已解码的ARGB32瓦片仍在解码瓦片缓存中，需由调用者重新加载
+     * @param   LUT 查找表
+     */
+    void setLabelLUT(const SlideColorManagement::LUT& LUT);
+
+    /**
+     * @brief   检查文件头是否为标签掩膜格式
+     * @param   header 文件开头的字节
+     * @param   length 字节数
+     * @return  以魔数开头时返回true
+     */
+    static bool matchesSignature(const unsigned char* header, size_t length);
+
+    /**
+     * @brief   游程编码一个瓦片
+     * @param   labels 紧密排列的标签
+     * @param   width 瓦片宽度
+     * @param   height 瓦片高度
+     * @param   encoded 追加编码结果的缓冲区
+     */
+    static void encodeTile(const unsigned char* labels, unsigned long long width, unsigned long long height, std::vector<unsigned char>& encoded);
+
+    /**
+     * @brief   解码一个瓦片
+     * @param   encoded 编码数据
+     * @param   size 编码数据的字节数
+     * @param   width 瓦片宽度
+     * @param   height 瓦片高度
+     * @param   labels 输出的紧密排列的标签，调用前清零
+     * @return  数据完整时返回true
+     */
+    static bool decodeTile(const unsigned char* encoded, unsigned long long size, unsigned long long width, unsigned long long height, unsigned char* labels);
+
+    /** @brief 文件魔数 */
+    static const char kMagic[8];
+
+    /** @brief 文件头中层级尺寸之前的字节数 */
+    static const unsigned int kHeaderSize = 24;
+
+protected:
+    /**
+     * @brief   清理资源
+     * @details 解除文件映射并清空层级和瓦片表
+     */
+    void cleanup();
+
+    /**
+     * @brief   读取区域的标签
+     * @return  从TileBufferPool分配的unsigned char数据（1通道），调用者负责归还
+     */
+    void* readDataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level);
+
+    /**
+     * @brief   把区域的标签解码到调用者的缓冲区
+     * @return  图像有效时返回true
+     */
+    bool readDataIntoBuffer(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, void* data, const unsigned int& zPlane);
+
+    /**
+     * @brief   按标签查找表直接解码为ARGB32
+     * @details 每个游程只查一次表，再按颜色填充
+     * @return  图像有效时返回true
+     */
+    bool readARGB32DataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, unsigned int* data, const unsigned int& zPlane);
+
+private:
+    /**
+     * @brief 瓦片表项
+     */
+    struct TileEntry {
+        unsigned long long offset;  ///< 在文件中的偏移
+        unsigned long long length;  ///< 编码数据的字节数
+    };
+
+    /**
+     * @brief   把区域内各瓦片的游程裁剪后写入输出
+     * @tparam  T 输出类型
+     * @tparam  Lookup 标签到输出值的映射，签名为T(unsigned char)
+     * @param   startX 起始X坐标（第0层像素）
+     * @param   startY 起始Y坐标（第0层像素）
+     * @param   width 区域宽度
+     * @param   height 区域高度
+     * @param   level 层级
+     * @param   data 输出缓冲区，调用前已填充标签0对应的值
+     * @param   lookup 映射函数
+     */
+    template <typename T, typename Lookup>
+    void decodeRegion(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, T* data, Lookup lookup) const;
+
+    /** @brief 掩膜文件 */
+    QFile _file;
+
+    /** @brief 文件的内存映射 */
+    const unsigned char* _mapped;
+
+    /** @brief 映射的字节数 */
+    unsigned long long _mappedSize;
+
+    /** @brief 瓦片大小 */
+    unsigned int _tileSize;
+
+    /** @brief 最大标签值 */
+    unsigned int _maxLabel;
+
+    /** @brief 各层级的瓦片列数 */
+    std::vector<unsigned long long> _tileColumns;
+
+    /** @brief 各层级的瓦片表 */
+    std::vector<std::vector<TileEntry> > _tiles;
+
+    /** @brief 标签到不透明预乘ARGB的调色板 */
+    unsigned int _palette[256];
+};
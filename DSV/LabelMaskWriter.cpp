@@ -0,0 +1,288 @@
+﻿/**
+ * @file LabelMaskWriter.cpp
+ * @brief 标签掩膜写出实现文件
+ * @details 该文件实现了.dlm标签掩膜的生成，包括：
+ *          - 命令行解析
+ *          - 第0层瓦片的读取和游程编码
+ *          - 2x2众数下采样生成粗层级
+ *          - 文件头、瓦片表和瓦片数据的写出
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "LabelMaskWriter.h"
+#include "LabelMaskImage.h"
+#include "MultiResolutionImage.h"
+#include "MultiResolutionImageFactory.h"
+#include "DiskTileCache.h"
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QtEndian>
+#include <algorithm>
+#include <memory>
+
+namespace {
+
+    /**
+     * @brief 取2x2块的众数
+     * @details 依次比较左上、右上、左下，出现两次以上的标签即为众数；四个标签各不相同时取左上
+     */
+    inline unsigned char mode4(unsigned char a, unsigned char b, unsigned char c, unsigned char d)
+    {
+        if (a == b || a == c || a == d) {
+            return a;
+        }
+        if (b == c || b == d) {
+            return b;
+        }
+        if (c == d) {
+            return c;
+        }
+        return a;
+    }
+
+    /**
+     * @brief 追加小端32位整数
+     */
+    void appendUInt32(QByteArray& out, quint32 value)
+    {
+        uchar bytes[4];
+        qToLittleEndian(value, bytes);
+        out.append(reinterpret_cast<const char*>(bytes), 4);
+    }
+
+    /**
+     * @brief 追加小端64位整数
+     */
+    void appendUInt64(QByteArray& out, quint64 value)
+    {
+        uchar bytes[8];
+        qToLittleEndian(value, bytes);
+        out.append(reinterpret_cast<const char*>(bytes), 8);
+    }
+}
+
+/**
+ * @brief 命令行是否请求转换标签掩膜
+ * @param arguments 命令行参数
+ * @return 包含--convert-label-mask时返回true
+ */
+bool LabelMaskWriter::isRequested(const QStringList& arguments)
+{
+    return arguments.contains(QStringLiteral("--convert-label-mask"));
+}
+
+/**
+ * @brief 运行转换
+ * @param arguments 命令行参数
+ * @return 进程退出码
+ */
+int LabelMaskWriter::run(const QStringList& arguments)
+{
+    QTextStream out(stdout);
+    QStringList positional;
+    unsigned int tileSize = kDefaultTileSize;
+    for (int i = 1; i < arguments.size(); ++i) {
+        const QString& argument = arguments[i];
+        if (argument == QStringLiteral("--convert-label-mask")) {
+            continue;
+        }
+        else if (argument == QStringLiteral("--tile-size")) {
+            bool ok = false;
+            tileSize = i + 1 < arguments.size() ? arguments[++i].toUInt(&ok) : 0;
+            if (!ok || tileSize < 16 || tileSize > 65536) {
+                out << "invalid value for --tile-size\n";
+                return 2;
+            }
+        }
+        else {
+            positional.append(argument);
+        }
+    }
+    if (positional.size() != 2) {
+        out << "usage: DSV --convert-label-mask <mask> <output.dlm> [--tile-size N]\n";
+        return 2;
+    }
+    DiskTileCache::setEnabled(false);
+
+    MultiResolutionImageReader imgReader;
+    std::unique_ptr<MultiResolutionImage> img(imgReader.open(positional[0].toStdString(), "default"));
+    if (!img || !img->valid()) {
+        out << "cannot open " << positional[0] << "\n";
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QString errorMessage;
+    if (!write(*img, positional[1], tileSize, errorMessage)) {
+        out << errorMessage << "\n";
+        return 1;
+    }
+    const std::vector<unsigned long long> dims = img->getDimensions();
+    const qint64 bytes = QFileInfo(positional[1]).size();
+    out << positional[1] << ": " << bytes << " bytes, " << (static_cast<double>(dims[0]) * dims[1] / std::max<qint64>(bytes, 1))
+        << "x smaller than 8-bit raw, " << timer.elapsed() / 1000. << " s\n";
+    return 0;
+}
+
+/**
+ * @brief 把层级的一个区域解码到缓冲区
+ * @details 区域内的每个瓦片解码后按行复制到输出
+ */
+void LabelMaskWriter::decodeArea(const Level& level, unsigned int tileSize, unsigned long long x, unsigned long long y,
+    unsigned long long width, unsigned long long height, std::vector<unsigned char>& labels)
+{
+    labels.assign(static_cast<size_t>(width * height), 0);
+    std::vector<unsigned char> tile;
+    for (unsigned long long row = y / tileSize; row <= (y + height - 1) / tileSize; ++row) {
+        for (unsigned long long column = x / tileSize; column <= (x + width - 1) / tileSize; ++column) {
+            const unsigned long long tileX = column * tileSize;
+            const unsigned long long tileY = row * tileSize;
+            const unsigned long long tileWidth = std::min<unsigned long long>(tileSize, level.width - tileX);
+            const unsigned long long tileHeight = std::min<unsigned long long>(tileSize, level.height - tileY);
+            const std::vector<unsigned char>& encoded = level.tiles[static_cast<size_t>(row * level.columns + column)];
+            tile.assign(static_cast<size_t>(tileWidth * tileHeight), 0);
+            LabelMaskImage::decodeTile(encoded.data(), encoded.size(), tileWidth, tileHeight, tile.data());
+            const unsigned long long copyWidth = std::min(tileWidth, x + width - tileX);
+            const unsigned long long copyHeight = std::min(tileHeight, y + height - tileY);
+            for (unsigned long long line = 0; line < copyHeight; ++line) {
+                std::copy(tile.begin() + static_cast<size_t>(line * tileWidth), tile.begin() + static_cast<size_t>(line * tileWidth + copyWidth),
+                    labels.begin() + static_cast<size_t>((tileY - y + line) * width + (tileX - x)));
+            }
+        }
+    }
+}
+
+/**
+ * @brief 由较细层级生成下一个粗层级
+ * @details 粗层级的每个瓦片对应较细层级一个2倍大小的区域，解码该区域后逐块取众数
+ */
+LabelMaskWriter::Level LabelMaskWriter::downsample(const Level& finer, unsigned int tileSize)
+{
+    Level coarse;
+    coarse.width = (finer.width + 1) / 2;
+    coarse.height = (finer.height + 1) / 2;
+    coarse.columns = (coarse.width + tileSize - 1) / tileSize;
+    const unsigned long long rows = (coarse.height + tileSize - 1) / tileSize;
+    coarse.tiles.resize(static_cast<size_t>(coarse.columns * rows));
+
+    std::vector<unsigned char> area;
+    std::vector<unsigned char> labels;
+    for (unsigned long long row = 0; row < rows; ++row) {
+        for (unsigned long long column = 0; column < coarse.columns; ++column) {
+            const unsigned long long tileX = column * tileSize;
+            const unsigned long long tileY = row * tileSize;
+            const unsigned long long tileWidth = std::min<unsigned long long>(tileSize, coarse.width - tileX);
+            const unsigned long long tileHeight = std::min<unsigned long long>(tileSize, coarse.height - tileY);
+            const unsigned long long areaWidth = std::min(2 * tileWidth, finer.width - 2 * tileX);
+            const unsigned long long areaHeight = std::min(2 * tileHeight, finer.height - 2 * tileY);
+            decodeArea(finer, tileSize, 2 * tileX, 2 * tileY, areaWidth, areaHeight, area);
+
+            labels.resize(static_cast<size_t>(tileWidth * tileHeight));
+            for (unsigned long long y = 0; y < tileHeight; ++y) {
+                const unsigned char* top = area.data() + 2 * y * areaWidth;
+                const unsigned char* bottom = area.data() + std::min(2 * y + 1, areaHeight - 1) * areaWidth;
+                unsigned char* target = labels.data() + y * tileWidth;
+                for (unsigned long long x = 0; x < tileWidth; ++x) {
+                    const unsigned long long left = 2 * x;
+                    const unsigned long long right = std::min(left + 1, areaWidth - 1);
+                    target[x] = mode4(top[left], top[right], bottom[left], bottom[right]);
+                }
+            }
+            LabelMaskImage::encodeTile(labels.data(), tileWidth, tileHeight, coarse.tiles[static_cast<size_t>(row * coarse.columns + column)]);
+        }
+    }
+    return coarse;
+}
+
+/**
+ * @brief 把图像转换为标签掩膜文件
+ * @param source 已打开的源图像
+ * @param path 输出路径
+ * @param tileSize 瓦片大小
+ * @param errorMessage 失败原因
+ * @return 写出成功时返回true，任一源瓦片读取失败时不写出文件并返回false
+ */
+bool LabelMaskWriter::write(MultiResolutionImage& source, const QString& path, unsigned int tileSize, QString& errorMessage)
+{
+    const std::vector<unsigned long long> dims = source.getDimensions();
+    const unsigned int samples = source.getSamplesPerPixel();
+    if (dims.size() < 2 || dims[0] == 0 || dims[1] == 0 || samples == 0 || tileSize == 0) {
+        errorMessage = QStringLiteral("source image has no pixels");
+        return false;
+    }
+
+    std::vector<Level> levels(1);
+    Level& base = levels[0];
+    base.width = dims[0];
+    base.height = dims[1];
+    base.columns = (base.width + tileSize - 1) / tileSize;
+    const unsigned long long rows = (base.height + tileSize - 1) / tileSize;
+    base.tiles.resize(static_cast<size_t>(base.columns * rows));
+
+    unsigned char maxLabel = 0;
+    std::vector<unsigned char> pixels(static_cast<size_t>(tileSize) * tileSize * samples);
+    std::vector<unsigned char> labels(static_cast<size_t>(tileSize) * tileSize);
+    for (unsigned long long row = 0; row < rows; ++row) {
+        for (unsigned long long column = 0; column < base.columns; ++column) {
+            const unsigned long long tileX = column * tileSize;
+            const unsigned long long tileY = row * tileSize;
+            const unsigned long long tileWidth = std::min<unsigned long long>(tileSize, base.width - tileX);
+            const unsigned long long tileHeight = std::min<unsigned long long>(tileSize, base.height - tileY);
+            // 读取失败的瓦片会被填充为255，不能当作标签写出
+            if (!source.readRegion<unsigned char>(static_cast<long long>(tileX), static_cast<long long>(tileY), tileWidth, tileHeight, 0, pixels.data())) {
+                errorMessage = QStringLiteral("cannot read source tile (%1, %2)").arg(column).arg(row);
+                return false;
+            }
+            for (unsigned long long i = 0; i < tileWidth * tileHeight; ++i) {
+                labels[static_cast<size_t>(i)] = pixels[static_cast<size_t>(i * samples)];
+                maxLabel = std::max(maxLabel, labels[static_cast<size_t>(i)]);
+            }
+            LabelMaskImage::encodeTile(labels.data(), tileWidth, tileHeight, base.tiles[static_cast<size_t>(row * base.columns + column)]);
+        }
+    }
+    while (std::max(levels.back().width, levels.back().height) > tileSize) {
+        levels.push_back(downsample(levels.back(), tileSize));
+    }
+
+    QByteArray header(LabelMaskImage::kMagic, sizeof(LabelMaskImage::kMagic));
+    appendUInt32(header, tileSize);
+    appendUInt32(header, static_cast<quint32>(levels.size()));
+    appendUInt32(header, maxLabel);
+    appendUInt32(header, 0);
+    unsigned long long tileCount = 0;
+    for (const Level& level : levels) {
+        appendUInt64(header, level.width);
+        appendUInt64(header, level.height);
+        tileCount += level.tiles.size();
+    }
+    unsigned long long offset = LabelMaskImage::kHeaderSize + 16ULL * levels.size() + 16ULL * tileCount;
+    for (const Level& level : levels) {
+        for (const std::vector<unsigned char>& tile : level.tiles) {
+            appendUInt64(header, offset);
+            appendUInt64(header, tile.size());
+            offset += tile.size();
+        }
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        errorMessage = QStringLiteral("cannot write ") + path;
+        return false;
+    }
+    bool ok = file.write(header) == header.size();
+    for (const Level& level : levels) {
+        for (const std::vector<unsigned char>& tile : level.tiles) {
+            ok = ok && file.write(reinterpret_cast<const char*>(tile.data()), static_cast<qint64>(tile.size())) == static_cast<qint64>(tile.size());
+        }
+    }
+    if (!ok || !file.commit()) {
+        errorMessage = QStringLiteral("write failed for ") + path;
+        return false;
+    }
+    return true;
+}
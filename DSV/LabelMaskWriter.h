@@ -0,0 +1,104 @@
+﻿/**
+ * @file    LabelMaskWriter.h
+ * @brief   标签掩膜写出类，把分割结果转换为.dlm标签掩膜金字塔
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该类负责生成LabelMaskImage读取的文件，包括：
+ *          - 按瓦片读取源图像第0层的第一个通道作为标签
+ *          - 游程编码每个瓦片
+ *          - 按2x2众数下采样逐级生成粗层级，直到一个瓦片能容纳整个层级
+ *          - 通过QSaveFile一次写出，写入失败时不留下不完整的文件
+ *
+ * @note    通过命令行启动：DSV.exe --convert-label-mask mask.tif mask.dlm [--tile-size N]
+ * @see     LabelMaskImage, MultiResolutionImage
+ */
+
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <vector>
+
+class MultiResolutionImage;
+
+/**
+ * @class  LabelMaskWriter
+ * @brief  标签掩膜写出
+ * @details 源图像可以是任何可打开的单通道或多通道图像（如分割网络输出的TIFF），
+ *          按unsigned char读取，只取第一个通道，标签值超过255时按getRawRegion的类型转换截断。
+ *          编码后的瓦片保存在内存中，粗层级的每个瓦片只解码较细层级的至多4个子瓦片，
+ *          内存占用与编码后的大小成正比，与掩膜的像素数无关。
+ *
+ *          众数下采样在2x2块中取出现次数最多的标签，次数相同时取左上角优先，
+ *          边界上不足2x2的块重复最后一行（列）。与平均或双线性下采样不同，结果中不会出现源数据没有的标签。
+ *
+ * @example
+ *          // 使用示例（main.cpp）
+ *          if (LabelMaskWriter::isRequested(arguments)) {
+ *              return LabelMaskWriter::run(arguments);
+ *          }
+ */
+class LabelMaskWriter
+{
+public:
+    /**
+     * @brief   命令行是否请求转换标签掩膜
+     * @param   arguments 命令行参数
+     * @return  包含--convert-label-mask时返回true
+     */
+    static bool isRequested(const QStringList& arguments);
+
+    /**
+     * @brief   运行转换
+     * @param   arguments 命令行参数
+     * @return  进程退出码，0表示已写出文件
+     * @note    需要已创建QApplication
+     */
+    static int run(const QStringList& arguments);
+
+    /**
+     * @brief   把图像转换为标签掩膜文件
+     * @param   source 已打开的源图像
+     * @param   path 输出路径
+     * @param   tileSize 瓦片大小
+     * @param   errorMessage 失败原因，源瓦片读取失败时包含瓦片的列和行
+     * @return  写出成功时返回true；任一源瓦片读取失败时不写出文件
+     */
+    static bool write(MultiResolutionImage& source, const QString& path, unsigned int tileSize, QString& errorMessage);
+
+    /** @brief 默认瓦片大小，与SlideLoader的默认瓦片大小一致 */
+    static const unsigned int kDefaultTileSize = 512;
+
+private:
+    /**
+     * @brief 一个层级的编码结果
+     */
+    struct Level {
+        unsigned long long width;
+        unsigned long long height;
+        unsigned long long columns;
+        std::vector<std::vector<unsigned char> > tiles;   ///< 行优先的编码瓦片
+    };
+
+    /**
+     * @brief   由较细层级生成下一个粗层级
+     * @param   finer 较细层级
+     * @param   tileSize 瓦片大小
+     * @return  宽高为较细层级的一半（向上取整）的层级
+     */
+    static Level downsample(const Level& finer, unsigned int tileSize);
+
+    /**
+     * @brief   把层级的一个区域解码到缓冲区
+     * @param   level 层级
+     * @param   tileSize 瓦片大小
+     * @param   x 区域左上角X坐标（层级像素），对齐到瓦片
+     * @param   y 区域左上角Y坐标（层级像素），对齐到瓦片
+     * @param   width 区域宽度，不超过层级边界
+     * @param   height 区域高度，不超过层级边界
+     * @param   labels 输出的紧密排列的标签
+     */
+    static void decodeArea(const Level& level, unsigned int tileSize, unsigned long long x, unsigned long long y,
+        unsigned long long width, unsigned long long height, std::vector<unsigned char>& labels);
+};
@@ -9,8 +9,14 @@
 
 #include "MainWin.h"
 #include <QDebug>
+#include <QInputDialog>
 #include "MultiResolutionImage.h"
 #include "ScaleBar.h"
+#include "SlideLoader.h"
+#include "SlidePreloader.h"
+#include "ViewSynchronizer.h"
+#include "PipelineProfiler.h"
+#include "PipelineTrace.h"
 
 /**
  * @brief 主窗口构造函数
@@ -128,6 +134,57 @@ void MainWin::initUi()
 
 	this->setCentralWidget(centralWidget);
 
+	// 对比视图在打开对比切片时创建，与主视图同步浏览
+	_compareView = NULL;
+	_synchronizer = new ViewSynchronizer(this);
+	_preloader = new SlidePreloader(this);
+	_synchronizer->addViewer(pathologyView);
+
+	QAction* openCompareAction = new QAction(QStringLiteral("打开对比切片"), this);
+	openCompareAction->setShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_O));
+	connect(openCompareAction, &QAction::triggered, this, &MainWin::onOpenCompareSlide);
+	this->addAction(openCompareAction);
+
+	QAction* openRemoteAction = new QAction(QStringLiteral("打开远程切片"), this);
+	openRemoteAction->setShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_U));
+	connect(openRemoteAction, &QAction::triggered, this, &MainWin::onOpenRemoteSlide);
+	this->addAction(openRemoteAction);
+
+	QAction* pointDensityAction = new QAction(QStringLiteral("加载点检测热图"), this);
+	pointDensityAction->setShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_H));
+	connect(pointDensityAction, &QAction::triggered, this, &MainWin::onLoadPointDensity);
+	this->addAction(pointDensityAction);
+
+	QAction* closeCompareAction = new QAction(QStringLiteral("关闭对比切片"), this);
+	closeCompareAction->setShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_W));
+	connect(closeCompareAction, &QAction::triggered, this, &MainWin::onCloseCompareSlide);
+	this->addAction(closeCompareAction);
+
+	QAction* syncAction = new QAction(QStringLiteral("同步浏览"), this);
+	syncAction->setCheckable(true);
+	syncAction->setChecked(true);
+	syncAction->setShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_L));
+	connect(syncAction, &QAction::toggled, _synchronizer, &ViewSynchronizer::setEnabled);
+	this->addAction(syncAction);
+
+	// 性能统计浮层显示在主视图左上角，打开时开始记录
+	QAction* statisticsAction = new QAction(QStringLiteral("性能统计"), this);
+	statisticsAction->setCheckable(true);
+	statisticsAction->setShortcut(QKeySequence(Qt::Key_F12));
+	connect(statisticsAction, &QAction::toggled, pathologyView, &PathologyViewer::setStatisticsOverlayVisible);
+	this->addAction(statisticsAction);
+
+	QAction* exportStatisticsAction = new QAction(QStringLiteral("导出性能统计"), this);
+	exportStatisticsAction->setShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_F12));
+	connect(exportStatisticsAction, &QAction::triggered, this, &MainWin::onExportStatistics);
+	this->addAction(exportStatisticsAction);
+
+	QAction* traceAction = new QAction(QStringLiteral("记录管线时间线"), this);
+	traceAction->setCheckable(true);
+	traceAction->setShortcut(QKeySequence(Qt::Key_F11));
+	connect(traceAction, &QAction::toggled, this, &MainWin::onRecordTraceToggled);
+	this->addAction(traceAction);
+
 	// 设置工具栏
 	m_ToolBar = new CenteredToolBar(this);
 	m_ToolBar->setObjectName(QStringLiteral("ToolBar"));
@@ -181,6 +238,7 @@ void MainWin::initUi()
 	// 创建图像过滤器
 	m_ImageFilter = new ImageFilter(this);
 	m_ImageFilter->hide();
+	connect(m_ImageFilter, &ImageFilter::enhancementChanged, pathologyView, &PathologyViewer::setEnhancement);
 }
 
 /**
@@ -425,28 +483,239 @@ void MainWin::onOpenFile(const QString& fileName)
 		
 		}
 		qDebug() << fileName << factoryName;
-		std::string fn = fileName.toStdString();
 		this->setWindowTitle(QString("DSV - ") + QFileInfo(fileName).fileName());
-		MultiResolutionImageReader imgReader;
-		_img.reset(imgReader.open(fn, factoryName.toStdString()));
-		if (_img) {
-			if (_img->valid()) {
-				std::vector<unsigned long long> dimensions = _img->getLevelDimensions(_img->getNumberOfLevels() - 1);
-				qDebug() << dimensions;
-				PathologyViewer* view = this->findChild<PathologyViewer*>("pathologyView");
-				view->initialize(_img);
-			}
-			else {
-				statusBar->showMessage(QStringLiteral("Unsupport Format"));
-			}
+		if (_slideLoader) {
+			// 丢弃仍在进行的打开，线程结束后自行释放
+			_slideLoader->disconnect(this);
 		}
-		else {
-			statusBar->showMessage(QStringLiteral("InValid File"));
+		PathologyViewer* view = this->findChild<PathologyViewer*>("pathologyView");
+		_slideLoader = new SlideLoader(fileName, view->getTileSize(), this);
+		PreloadedSlide preloaded;
+		if (_preloader->take(fileName, preloaded)) {
+			_slideLoader->setPreloadedSlide(preloaded);
+		}
+		connect(_slideLoader, SIGNAL(slideOpened()), this, SLOT(onSlideOpened()));
+		connect(_slideLoader, SIGNAL(overviewLoaded(const QImage&)), this, SLOT(onOverviewLoaded(const QImage&)));
+		connect(_slideLoader, SIGNAL(associatedDataLoaded()), this, SLOT(onAssociatedDataLoaded()));
+		connect(_slideLoader, SIGNAL(openFailed(const QString&)), this, SLOT(onSlideOpenFailed(const QString&)));
+		connect(_slideLoader, SIGNAL(finished()), _slideLoader, SLOT(deleteLater()));
+		statusBar->showMessage(QStringLiteral("Opening ") + QFileInfo(fileName).fileName());
+		_slideLoader->start();
+		// 阅读当前切片时后台打开阅片顺序中的后续切片，切换时首屏无需等待
+		_preloader->setWorklist(m_FileWidget->nextSlides(fileName, static_cast<int>(_preloader->getMaxSlides())), view->getTileSize());
+	}
+}
+
+/**
+ * @brief 切片打开完成处理
+ * @details 使用已打开的图像初始化病理查看器
+ */
+void MainWin::onSlideOpened()
+{
+	SlideLoader* loader = qobject_cast<SlideLoader*>(sender());
+	PathologyViewer* view = viewerForLoader(loader);
+	if (!view) {
+		return;
+	}
+	statusBar->clearMessage();
+	std::shared_ptr<MultiResolutionImage> img = loader->getImage();
+	if (view == _compareView) {
+		_compareImg = img;
+	}
+	else {
+		_img = img;
+	}
+	std::vector<unsigned long long> dimensions = img->getLevelDimensions(img->getNumberOfLevels() - 1);
+	qDebug() << dimensions;
+	view->initialize(img);
+}
+
+/**
+ * @brief 缩略图读取完成处理
+ * @param overview 缩略图图像
+ */
+void MainWin::onOverviewLoaded(const QImage& overview)
+{
+	PathologyViewer* view = viewerForLoader(sender());
+	if (!view) {
+		return;
+	}
+	view->setOverview(overview);
+}
+
+/**
+ * @brief 关联数据读取完成处理
+ * @details 标签图像和属性在首屏显示之后才读取完成
+ */
+void MainWin::onAssociatedDataLoaded()
+{
+	SlideLoader* loader = qobject_cast<SlideLoader*>(sender());
+	PathologyViewer* view = viewerForLoader(loader);
+	if (!view) {
+		return;
+	}
+	view->setAssociatedData(loader->getLabel(), loader->getProperties());
+}
+
+/**
+ * @brief 切片打开失败处理
+ * @param message 错误信息
+ */
+void MainWin::onSlideOpenFailed(const QString& message)
+{
+	if (!viewerForLoader(sender())) {
+		return;
+	}
+	statusBar->showMessage(message);
+}
+
+PathologyViewer* MainWin::viewerForLoader(QObject* loader) const
+{
+	if (!loader) {
+		return NULL;
+	}
+	if (loader == _slideLoader) {
+		return pathologyView;
+	}
+	if (loader == _compareLoader && _compareView) {
+		return _compareView;
+	}
+	return NULL;
+}
+
+/**
+ * @brief 打开远程切片
+ * @details 地址为空或取消时不做任何操作
+ */
+void MainWin::onOpenRemoteSlide()
+{
+	bool accepted = false;
+	QString url = QInputDialog::getText(this, QStringLiteral("打开远程切片"), QStringLiteral("DZI地址："), QLineEdit::Normal,
+		QStringLiteral("https://"), &accepted).trimmed();
+	if (!accepted || url.isEmpty()) {
+		return;
+	}
+	onOpenFile(url);
+}
+
+/**
+ * @brief 打开对比切片
+ * @details 对比视图放在主视图右侧，打开过程与主切片相同
+ */
+void MainWin::onOpenCompareSlide()
+{
+	QStringList nameFilters;
+	for (const std::string& extension : MultiResolutionImageFactory::getAllSupportedExtensions()) {
+		nameFilters << QStringLiteral("*.") + QString::fromStdString(extension);
+	}
+	QString fileName = QFileDialog::getOpenFileName(this, QStringLiteral("打开对比切片"), QString(),
+		QStringLiteral("Slides (") + nameFilters.join(' ') + QStringLiteral(")"));
+	if (fileName.isEmpty()) {
+		return;
+	}
+	if (!_compareView) {
+		_compareView = new PathologyViewer(centralWidget);
+		_compareView->setObjectName("compareView");
+		QGridLayout* layout = qobject_cast<QGridLayout*>(centralWidget->layout());
+		if (layout) {
+			layout->addWidget(_compareView, 0, 1);
 		}
+		_synchronizer->addViewer(_compareView);
+	}
+	if (_compareLoader) {
+		_compareLoader->disconnect(this);
 	}
+	_compareLoader = new SlideLoader(fileName, _compareView->getTileSize(), this);
+	connect(_compareLoader, SIGNAL(slideOpened()), this, SLOT(onSlideOpened()));
+	connect(_compareLoader, SIGNAL(overviewLoaded(const QImage&)), this, SLOT(onOverviewLoaded(const QImage&)));
+	connect(_compareLoader, SIGNAL(associatedDataLoaded()), this, SLOT(onAssociatedDataLoaded()));
+	connect(_compareLoader, SIGNAL(openFailed(const QString&)), this, SLOT(onSlideOpenFailed(const QString&)));
+	connect(_compareLoader, SIGNAL(finished()), _compareLoader, SLOT(deleteLater()));
+	statusBar->showMessage(QStringLiteral("Opening ") + QFileInfo(fileName).fileName());
+	_compareLoader->start();
+}
 
+/**
+ * @brief 关闭对比切片
+ * @details 视图关闭时注销其IO线程，共享的工作线程继续服务主视图
+ */
+void MainWin::onCloseCompareSlide()
+{
+	if (!_compareView) {
+		return;
+	}
+	if (_compareLoader) {
+		_compareLoader->disconnect(this);
+	}
+	_synchronizer->removeViewer(_compareView);
+	delete _compareView;
+	_compareView = NULL;
+	_compareImg.reset();
+}
+
+/**
+ * @brief 加载点检测热图
+ * @details 结果在状态栏提示
+ */
+void MainWin::onLoadPointDensity()
+{
+	QString fileName = QFileDialog::getOpenFileName(this, QStringLiteral("加载点检测热图"), QString(),
+		QStringLiteral("Points (*.csv *.tsv *.txt)"));
+	if (fileName.isEmpty()) {
+		return;
+	}
+	if (pathologyView->setPointDensityOverlay(fileName)) {
+		statusBar->showMessage(QStringLiteral("已加载点检测热图 ") + QFileInfo(fileName).fileName());
+	}
+	else {
+		statusBar->showMessage(QStringLiteral("无法读取点文件 ") + fileName);
+	}
+}
 
+/**
+ * @brief 导出性能统计
+ * @details 结果在状态栏提示
+ */
+void MainWin::onExportStatistics()
+{
+	QString fileName = QFileDialog::getSaveFileName(this, QStringLiteral("导出性能统计"), QStringLiteral("pipeline_stats.json"),
+		QStringLiteral("JSON (*.json)"));
+	if (fileName.isEmpty()) {
+		return;
+	}
+	if (PipelineProfiler::exportJson(fileName)) {
+		statusBar->showMessage(QStringLiteral("性能统计已保存到 ") + QFileInfo(fileName).fileName());
+	}
+	else {
+		statusBar->showMessage(QStringLiteral("无法写入 ") + fileName);
+	}
+}
 
+/**
+ * @brief 开始或结束记录管线时间线
+ * @param recording 是否记录
+ * @details 停止记录后选择保存位置，取消时丢弃记录的事件
+ */
+void MainWin::onRecordTraceToggled(bool recording)
+{
+	if (recording) {
+		PipelineTrace::clear();
+		PipelineTrace::setEnabled(true);
+		statusBar->showMessage(QStringLiteral("正在记录管线时间线，再次按F11停止"));
+		return;
+	}
+	PipelineTrace::setEnabled(false);
+	QString fileName = QFileDialog::getSaveFileName(this, QStringLiteral("保存管线时间线"), QStringLiteral("pipeline_trace.json"),
+		QStringLiteral("Chrome trace (*.json)"));
+	if (!fileName.isEmpty()) {
+		if (PipelineTrace::exportJson(fileName)) {
+			statusBar->showMessage(QStringLiteral("管线时间线已保存到 ") + QFileInfo(fileName).fileName());
+		}
+		else {
+			statusBar->showMessage(QStringLiteral("无法写入 ") + fileName);
+		}
+	}
+	PipelineTrace::clear();
 }
 QList<QString> MainWin::getFileNameAndFactory() {
 	QString filterList;
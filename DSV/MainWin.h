@@ -26,6 +26,7 @@
 #include <QMouseEvent>
 #include <QFileDialog>
 #include <QStatusBar>
+#include <QPointer>
 #include "CenteredToolBar.h"
 #include "FileWidget.h"
 #include "MultiResolutionImageFactory.h"
@@ -35,6 +36,10 @@
 #include "InputDialog.h"
 #include "ImageFilter.h"
 
+class SlideLoader;
+class SlidePreloader;
+class ViewSynchronizer;
+
  // 前向声明
 class MultiResolutionImage;
 
@@ -149,11 +154,12 @@ private:
 
     /**
      * @brief   打开文件处理
-     * @details 处理文件打开操作
+     * @details 处理文件打开操作，在SlideLoader线程中异步打开文件，
+     *          元数据、缩略图就绪后分别由onSlideOpened、onOverviewLoaded显示
      *
      * @param   fileName 要打开的文件路径
-     * @note    该函数会加载指定的图像文件并显示
-     * @see     getFileNameAndFactory
+     * @note    打开过程中再次打开其他文件时，前一次的结果被丢弃
+     * @see     getFileNameAndFactory, SlideLoader
      */
     void onOpenFile(const QString& fileName);
 
@@ -205,6 +211,99 @@ private:
     /** @brief 病理查看器指针，主要的图像显示组件 */
     PathologyViewer* pathologyView;
 
+    /** @brief 当前的切片打开线程，结束后自动释放 */
+    QPointer<SlideLoader> _slideLoader;
+
+    /** @brief 工作列表预加载线程，打开切片后预加载阅片顺序中的后续切片 */
+    SlidePreloader* _preloader;
+
+    /** @brief 对比视图，并排显示第二张切片，未打开时为NULL */
+    PathologyViewer* _compareView;
+
+    /** @brief 对比视图中的图像对象 */
+    std::shared_ptr<MultiResolutionImage> _compareImg;
+
+    /** @brief 对比切片的打开线程 */
+    QPointer<SlideLoader> _compareLoader;
+
+    /** @brief 主视图与对比视图的同步器 */
+    ViewSynchronizer* _synchronizer;
+
+    /**
+     * @brief   查找切片打开线程对应的视图
+     * @param   loader 发送信号的打开线程
+     * @return  主视图或对比视图，过期的打开线程返回NULL
+     */
+    PathologyViewer* viewerForLoader(QObject* loader) const;
+
+private slots:
+    /**
+     * @brief   打开对比切片
+     * @details 在主视图右侧创建对比视图并加入同步，两个视图共用IO线程池和内存预算
+     */
+    void onOpenCompareSlide();
+
+    /**
+     * @brief   关闭对比切片
+     */
+    void onCloseCompareSlide();
+
+    /**
+     * @brief   打开远程切片
+     * @details 输入Deep Zoom描述文件的URL后按普通切片打开，瓦片边浏览边下载
+     * @see     DeepZoomImage
+     */
+    void onOpenRemoteSlide();
+
+    /**
+     * @brief   加载点检测热图
+     * @details 选择模型输出的点文件后在主视图上叠加核密度热图，不需要预先生成金字塔图像
+     * @see     PathologyViewer::setPointDensityOverlay
+     */
+    void onLoadPointDensity();
+
+    /**
+     * @brief   导出性能统计
+     * @details 把PipelineProfiler当前的阶段耗时、缓存计数和队列深度保存为JSON文件
+     * @see     PipelineProfiler::exportJson
+     */
+    void onExportStatistics();
+
+    /**
+     * @brief   开始或结束记录管线时间线
+     * @param   recording true时清空并开始记录，false时停止记录并保存为Chrome trace JSON
+     * @see     PipelineTrace
+     */
+    void onRecordTraceToggled(bool recording);
+
+    /**
+     * @brief   切片打开完成槽函数
+     * @details 元数据就绪后初始化病理查看器，首批瓦片随即开始加载
+     * @see     SlideLoader::slideOpened
+     */
+    void onSlideOpened();
+
+    /**
+     * @brief   缩略图读取完成槽函数
+     * @param   overview 缩略图层级的完整图像
+     * @see     SlideLoader::overviewLoaded
+     */
+    void onOverviewLoaded(const QImage& overview);
+
+    /**
+     * @brief   关联数据读取完成处理
+     * @details 把标签图像和属性交给病理查看器
+     * @see     SlideLoader::associatedDataLoaded
+     */
+    void onAssociatedDataLoaded();
+
+    /**
+     * @brief   切片打开失败槽函数
+     * @param   message 状态栏显示的错误信息
+     * @see     SlideLoader::openFailed
+     */
+    void onSlideOpenFailed(const QString& message);
+
 public slots:
     /**
      * @brief   设置工具栏启用状态
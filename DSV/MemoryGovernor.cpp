@@ -0,0 +1,384 @@
+﻿/**
+ * @file MemoryGovernor.cpp
+ * @brief 内存预算管理类实现文件
+ * @details 该文件实现了各级缓存之间的预算分配和系统内存不足检测
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "MemoryGovernor.h"
+#include "TileBufferPool.h"
+#include <QDebug>
+#include <algorithm>
+#include <cstdlib>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <QFile>
+#endif
+
+const double MemoryGovernor::kPixmapShare = 0.6;
+const double MemoryGovernor::kRecoveryAvailableShare = 0.15;
+
+/**
+ * @brief 获取单例
+ * @return 管理器对象
+ */
+MemoryGovernor* MemoryGovernor::instance()
+{
+    static MemoryGovernor* governor = new MemoryGovernor();
+    return governor;
+}
+
+/**
+ * @brief 构造函数
+ * @details 读取默认预算，创建系统内存不足通知并启动检测定时器
+ */
+MemoryGovernor::MemoryGovernor() :
+    QObject(),
+    _nextId(1),
+    _budget(defaultBudget()),
+    _pressureScale(1.),
+    _lowMemoryNotification(NULL)
+{
+#ifdef Q_OS_WIN
+    _lowMemoryNotification = CreateMemoryResourceNotification(LowMemoryResourceNotification);
+#endif
+    _pollTimer.setInterval(kPollInterval);
+    QObject::connect(&_pollTimer, SIGNAL(timeout()), this, SLOT(pollSystemMemory()));
+    _pollTimer.start();
+}
+
+/**
+ * @brief 析构函数
+ */
+MemoryGovernor::~MemoryGovernor()
+{
+#ifdef Q_OS_WIN
+    if (_lowMemoryNotification) {
+        CloseHandle(static_cast<HANDLE>(_lowMemoryNotification));
+    }
+#endif
+}
+
+/**
+ * @brief 计算默认预算
+ * @return 环境变量DSV_MEMORY_BUDGET_MB指定的值，否则为物理内存的1/4，限制在512MB到8GB之间
+ */
+unsigned long long MemoryGovernor::defaultBudget()
+{
+    const unsigned long long megabyte = 1024ULL * 1024;
+    if (const char* configured = std::getenv("DSV_MEMORY_BUDGET_MB")) {
+        unsigned long long value = std::strtoull(configured, NULL, 10);
+        if (value > 0) {
+            return value * megabyte;
+        }
+    }
+    unsigned long long physical = 0;
+#ifdef Q_OS_WIN
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status)) {
+        physical = status.ullTotalPhys;
+    }
+#else
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGE_SIZE);
+    if (pages > 0 && pageSize > 0) {
+        physical = static_cast<unsigned long long>(pages) * static_cast<unsigned long long>(pageSize);
+    }
+#endif
+    return std::min(std::max(physical / 4, 512 * megabyte), 8192 * megabyte);
+}
+
+/**
+ * @brief 注册缓存
+ * @param pool 缓存类别
+ * @param usage 当前用量回调
+ * @param setLimit 设置上限回调
+ * @param preferredBytes 期望上限
+ * @param pooledBytes 用量中来自瓦片缓冲区池的字节数回调，可为空
+ * @return 消费者标识
+ */
+int MemoryGovernor::registerConsumer(Pool pool, std::function<unsigned long long()> usage,
+    std::function<void(unsigned long long)> setLimit, unsigned long long preferredBytes,
+    std::function<unsigned long long()> pooledBytes)
+{
+    Consumer consumer;
+    consumer.id = _nextId++;
+    consumer.pool = pool;
+    consumer.usage = usage;
+    consumer.setLimit = setLimit;
+    consumer.pooledBytes = pooledBytes;
+    consumer.preferredBytes = preferredBytes;
+    consumer.limit = 0;
+    consumer.appliedLimit = 0;
+    _consumers.push_back(consumer);
+    rebalance();
+    return consumer.id;
+}
+
+/**
+ * @brief 注销缓存
+ * @param id 消费者标识
+ */
+void MemoryGovernor::unregisterConsumer(int id)
+{
+    auto it = std::find_if(_consumers.begin(), _consumers.end(), [id](const Consumer& c) { return c.id == id; });
+    if (it != _consumers.end()) {
+        _consumers.erase(it);
+        rebalance();
+    }
+}
+
+/**
+ * @brief 修改缓存的期望上限
+ * @param id 消费者标识
+ * @param preferredBytes 期望上限
+ */
+void MemoryGovernor::setPreferredBytes(int id, unsigned long long preferredBytes)
+{
+    for (Consumer& consumer : _consumers) {
+        if (consumer.id == id) {
+            consumer.preferredBytes = preferredBytes;
+            rebalance();
+            return;
+        }
+    }
+}
+
+/**
+ * @brief 设置总内存预算
+ * @param bytes 预算字节数
+ */
+void MemoryGovernor::setBudget(unsigned long long bytes)
+{
+    _budget = bytes;
+    rebalance();
+}
+
+/**
+ * @brief 获取总内存预算
+ * @return 预算字节数
+ */
+unsigned long long MemoryGovernor::budget() const
+{
+    return _budget;
+}
+
+/**
+ * @brief 获取当前生效的预算
+ * @return 预算字节数
+ */
+unsigned long long MemoryGovernor::effectiveBudget() const
+{
+    return static_cast<unsigned long long>(_budget * _pressureScale);
+}
+
+/**
+ * @brief 获取跟踪到的总字节数
+ * @return 字节数
+ */
+unsigned long long MemoryGovernor::trackedBytes() const
+{
+    return usage(TilePixmaps) + usage(DecodedTiles) + unmanagedBytes();
+}
+
+/**
+ * @brief 获取池中不属于任何消费者的字节数
+ * @return 字节数
+ */
+unsigned long long MemoryGovernor::unmanagedBytes() const
+{
+    unsigned long long pooled = 0;
+    for (const Consumer& consumer : _consumers) {
+        if (consumer.pooledBytes) {
+            pooled += consumer.pooledBytes();
+        }
+    }
+    const unsigned long long total = TileBufferPool::outstandingBytes() + TileBufferPool::cachedBytes();
+    return total > pooled ? total - pooled : 0;
+}
+
+/**
+ * @brief 获取某类缓存的当前用量
+ * @param pool 缓存类别
+ * @return 字节数
+ */
+unsigned long long MemoryGovernor::usage(Pool pool) const
+{
+    unsigned long long bytes = 0;
+    for (const Consumer& consumer : _consumers) {
+        if (consumer.pool == pool) {
+            bytes += consumer.usage();
+        }
+    }
+    return bytes;
+}
+
+/**
+ * @brief 系统是否处于内存紧张状态
+ * @return 内存紧张时返回true
+ */
+bool MemoryGovernor::isUnderPressure() const
+{
+    return _pressureScale < 1.;
+}
+
+/**
+ * @brief 重新分配预算
+ * @details 扣除瓦片缓冲区池的字节后按比例划分给两类缓存，一类用不完的部分交给另一类
+ */
+void MemoryGovernor::rebalance()
+{
+    if (_consumers.empty()) {
+        return;
+    }
+    const unsigned long long unmanaged = unmanagedBytes();
+    const unsigned long long effective = effectiveBudget();
+    const unsigned long long available = effective > unmanaged ? effective - unmanaged : 0;
+    const unsigned long long pixmapBytes = static_cast<unsigned long long>(available * kPixmapShare);
+    unsigned long long left = distribute(TilePixmaps, pixmapBytes);
+    left = distribute(DecodedTiles, available - pixmapBytes + left);
+    if (left > 0) {
+        distribute(TilePixmaps, pixmapBytes + left);
+    }
+    for (Consumer& consumer : _consumers) {
+        if (consumer.limit != consumer.appliedLimit) {
+            consumer.setLimit(consumer.limit);
+            consumer.appliedLimit = consumer.limit;
+        }
+    }
+}
+
+/**
+ * @brief 在同一类消费者之间分配预算
+ * @param pool 缓存类别
+ * @param bytes 该类的预算
+ * @return 未用完的预算
+ * @details 按期望上限从小到大依次分配，每个消费者取剩余预算的平均份额且不超过期望上限，
+ *          期望上限小的消费者让出的部分自然分给后面的消费者
+ */
+unsigned long long MemoryGovernor::distribute(Pool pool, unsigned long long bytes)
+{
+    std::vector<Consumer*> members;
+    for (Consumer& consumer : _consumers) {
+        if (consumer.pool == pool) {
+            members.push_back(&consumer);
+        }
+    }
+    if (members.empty()) {
+        return bytes;
+    }
+    std::sort(members.begin(), members.end(), [](const Consumer* a, const Consumer* b) { return a->preferredBytes < b->preferredBytes; });
+    unsigned long long left = bytes;
+    for (size_t i = 0; i < members.size(); ++i) {
+        const unsigned long long share = left / (members.size() - i);
+        const unsigned long long limit = std::min(share, members[i]->preferredBytes);
+        members[i]->limit = std::max(limit, std::min(kMinConsumerBytes, members[i]->preferredBytes));
+        left -= std::min(limit, left);
+    }
+    return left;
+}
+
+/**
+ * @brief 查询系统是否报告内存不足
+ * @return 内存不足时返回true
+ * @details Windows使用LowMemoryResourceNotification，其他平台以MemAvailable低于总内存5%为准
+ */
+bool MemoryGovernor::systemMemoryLow()
+{
+#ifdef Q_OS_WIN
+    BOOL low = FALSE;
+    if (_lowMemoryNotification && QueryMemoryResourceNotification(static_cast<HANDLE>(_lowMemoryNotification), &low)) {
+        return low != FALSE;
+    }
+    return false;
+#else
+    unsigned long long total = 0;
+    unsigned long long available = 0;
+    return queryPhysicalMemory(total, available) && available < total / 20;
+#endif
+}
+
+/**
+ * @brief 查询可用内存是否明显高于内存不足的阈值
+ * @return 可用物理内存不低于总内存的kRecoveryAvailableShare时返回true
+ */
+bool MemoryGovernor::systemMemoryRecovered()
+{
+    unsigned long long total = 0;
+    unsigned long long available = 0;
+    return queryPhysicalMemory(total, available) && available >= total * kRecoveryAvailableShare;
+}
+
+/**
+ * @brief 读取物理内存总量和可用量
+ * @param total 输出总字节数
+ * @param available 输出可用字节数
+ * @return 读取成功时返回true
+ * @details Windows使用GlobalMemoryStatusEx，其他平台读取/proc/meminfo的MemTotal和MemAvailable
+ */
+bool MemoryGovernor::queryPhysicalMemory(unsigned long long& total, unsigned long long& available)
+{
+#ifdef Q_OS_WIN
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (!GlobalMemoryStatusEx(&status)) {
+        return false;
+    }
+    total = status.ullTotalPhys;
+    available = status.ullAvailPhys;
+    return total > 0;
+#else
+    QFile meminfo("/proc/meminfo");
+    if (!meminfo.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    total = 0;
+    available = 0;
+    const QList<QByteArray> lines = meminfo.readAll().split('\n');
+    for (const QByteArray& line : lines) {
+        const QList<QByteArray> fields = line.simplified().split(' ');
+        if (fields.size() < 2) {
+            continue;
+        }
+        if (fields[0] == "MemTotal:") {
+            total = fields[1].toULongLong() * 1024;
+        }
+        else if (fields[0] == "MemAvailable:") {
+            available = fields[1].toULongLong() * 1024;
+        }
+    }
+    return total > 0;
+#endif
+}
+
+/**
+ * @brief 检测系统内存状态
+ * @details 内存不足时预算减半（最低1/8）并请求释放空闲缓冲区。
+ *          恢复带有滞回：只有可用内存明显高于阈值（kRecoveryAvailableShare）时才恢复，
+ *          且每次检测只把预算加倍，可用内存介于两者之间时保持当前预算
+ */
+void MemoryGovernor::pollSystemMemory()
+{
+    const bool wasUnderPressure = isUnderPressure();
+    if (systemMemoryLow()) {
+        _pressureScale = std::max(_pressureScale / 2., 0.125);
+        TileBufferPool::requestTrim();
+        if (!wasUnderPressure) {
+            qWarning() << "System memory is low, cache budget reduced to" << effectiveBudget() / (1024 * 1024) << "MB";
+            emit memoryPressureChanged(true);
+        }
+    }
+    else if (wasUnderPressure && systemMemoryRecovered()) {
+        _pressureScale = std::min(_pressureScale * 2., 1.);
+        if (!isUnderPressure()) {
+            emit memoryPressureChanged(false);
+        }
+    }
+    rebalance();
+}
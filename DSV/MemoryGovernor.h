@@ -0,0 +1,237 @@
+﻿/**
+ * @file    MemoryGovernor.h
+ * @brief   内存预算管理类，在各级缓存之间分配统一的内存预算
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了进程级的内存预算管理，包括：
+ *          - 统计瓦片像素图缓存、解码瓦片缓存和瓦片缓冲区池（Patch数据等）的实际字节数
+ *          - 按一个可配置的总预算为所有打开的查看器分配缓存上限
+ *          - 定期检测系统内存不足信号，内存紧张时逐步收紧预算并释放空闲缓冲区
+ *
+ * @note    该类只在主线程中使用，缓存上限的调整通过各缓存自身的线程安全接口完成
+ * @see     WSITileGraphicsItemCache, MultiResolutionImage, TileBufferPool
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <functional>
+#include <vector>
+
+/**
+ * @class  MemoryGovernor
+ * @brief  内存预算管理器
+ * @details 单例。各缓存以消费者的形式注册，提供当前用量、期望上限和设置上限的回调。
+ *          预算先扣除瓦片缓冲区池中无法淘汰的字节（正在解码的缓冲区、空闲链表，以及未计入任何缓存的前景Patch），
+ *          余下部分按kPixmapShare划给像素图缓存、其余划给解码瓦片缓存，
+ *          同一类中的消费者平均分配，不超过各自的期望上限，剩余部分再分给仍有需要的消费者。
+ *
+ *          系统报告内存不足时预算依次减半（最低为1/8），并请求所有线程释放池中的空闲缓冲区；
+ *          可用内存明显高于阈值后每次检测把预算加倍，逐步回到完整预算，避免预算反复切换。
+ *          多个切片同时打开时总用量因此不会随切片数增长。
+ *
+ * @example
+ *          // 使用示例
+ *          MemoryGovernor* governor = MemoryGovernor::instance();
+ *          int id = governor->registerConsumer(MemoryGovernor::TilePixmaps,
+ *              [cache]() { return cache->currentCacheSize(); },
+ *              [cache](unsigned long long limit) { cache->setMaxCacheSize(limit); },
+ *              preferredBytes);
+ *          // ...
+ *          governor->unregisterConsumer(id);
+ */
+class MemoryGovernor : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief 缓存类别
+     */
+    enum Pool {
+        TilePixmaps,        ///< 场景中的瓦片像素图（WSITileGraphicsItemCache）
+        DecodedTiles,       ///< 解码瓦片缓存（MultiResolutionImage）
+        NumberOfPools
+    };
+
+    /**
+     * @brief   获取单例
+     * @return  管理器对象，首次调用时创建并开始检测系统内存
+     */
+    static MemoryGovernor* instance();
+
+    /**
+     * @brief   注册缓存
+     * @param   pool 缓存类别
+     * @param   usage 返回当前用量（字节）的回调
+     * @param   setLimit 设置缓存上限（字节）的回调，上限低于用量时缓存应立即淘汰
+     * @param   preferredBytes 期望上限，分配的上限不超过该值
+     * @param   pooledBytes 可选，返回用量中来自TileBufferPool的字节数，这部分不再作为池中无法淘汰的字节重复扣除
+     * @return  消费者标识，用于注销和修改期望上限
+     * @note    注册后立即重新分配预算
+     */
+    int registerConsumer(Pool pool, std::function<unsigned long long()> usage,
+        std::function<void(unsigned long long)> setLimit, unsigned long long preferredBytes,
+        std::function<unsigned long long()> pooledBytes = std::function<unsigned long long()>());
+
+    /**
+     * @brief   注销缓存
+     * @param   id 消费者标识，无效时忽略
+     * @note    必须在缓存对象释放之前调用
+     */
+    void unregisterConsumer(int id);
+
+    /**
+     * @brief   修改缓存的期望上限
+     * @param   id 消费者标识
+     * @param   preferredBytes 期望上限
+     */
+    void setPreferredBytes(int id, unsigned long long preferredBytes);
+
+    /**
+     * @brief   设置总内存预算
+     * @param   bytes 预算字节数；默认为物理内存的1/4，限制在512MB到8GB之间，
+     *          也可通过环境变量DSV_MEMORY_BUDGET_MB指定
+     */
+    void setBudget(unsigned long long bytes);
+
+    /**
+     * @brief   获取总内存预算
+     */
+    unsigned long long budget() const;
+
+    /**
+     * @brief   获取当前生效的预算
+     * @return  内存紧张时为收紧后的预算
+     */
+    unsigned long long effectiveBudget() const;
+
+    /**
+     * @brief   获取跟踪到的总字节数
+     * @return  所有消费者的用量加瓦片缓冲区池的字节数
+     */
+    unsigned long long trackedBytes() const;
+
+    /**
+     * @brief   获取某类缓存的当前用量
+     * @param   pool 缓存类别
+     */
+    unsigned long long usage(Pool pool) const;
+
+    /**
+     * @brief   系统是否处于内存紧张状态
+     */
+    bool isUnderPressure() const;
+
+    /** @brief 像素图缓存占可分配预算的比例 */
+    static const double kPixmapShare;
+
+    /** @brief 每个消费者的最小上限 */
+    static const unsigned long long kMinConsumerBytes = 16ULL * 1024 * 1024;
+
+    /** @brief 系统内存检测间隔（毫秒） */
+    static const int kPollInterval = 1000;
+
+    /**
+     * @brief 恢复预算所需的可用内存比例
+     * @details 远高于判定内存不足的5%，可用内存在两者之间时保持当前预算，避免预算在1/8和完整值之间反复切换
+     */
+    static const double kRecoveryAvailableShare;
+
+public slots:
+    /**
+     * @brief   重新分配预算
+     * @details 注册、注销、修改预算和每次检测系统内存之后调用
+     */
+    void rebalance();
+
+signals:
+    /**
+     * @brief   内存紧张状态变化信号
+     * @param   underPressure true表示进入内存紧张状态，false表示预算已逐步恢复到完整值
+     */
+    void memoryPressureChanged(bool underPressure);
+
+private slots:
+    /**
+     * @brief   检测系统内存状态
+     * @details 进入或持续处于内存紧张状态时收紧预算并请求释放池中的空闲缓冲区
+     */
+    void pollSystemMemory();
+
+private:
+    MemoryGovernor();
+    ~MemoryGovernor();
+
+    /**
+     * @brief 消费者信息
+     */
+    struct Consumer {
+        int id;
+        Pool pool;
+        std::function<unsigned long long()> usage;
+        std::function<void(unsigned long long)> setLimit;
+        std::function<unsigned long long()> pooledBytes;
+        unsigned long long preferredBytes;
+        unsigned long long limit;           ///< 本次分配的上限
+        unsigned long long appliedLimit;    ///< 最近一次通过setLimit设置的上限
+    };
+
+    /**
+     * @brief   在同一类消费者之间分配预算
+     * @param   pool 缓存类别
+     * @param   bytes 该类的预算
+     * @return  未用完的预算（所有消费者都已达到期望上限）
+     */
+    unsigned long long distribute(Pool pool, unsigned long long bytes);
+
+    /**
+     * @brief   获取池中不属于任何消费者的字节数
+     * @return  TileBufferPool的已分配和空闲字节数，扣除消费者报告的pooledBytes
+     */
+    unsigned long long unmanagedBytes() const;
+
+    /**
+     * @brief   查询系统是否报告内存不足
+     */
+    bool systemMemoryLow();
+
+    /**
+     * @brief   查询可用内存是否明显高于内存不足的阈值
+     * @return  可用物理内存不低于总内存的kRecoveryAvailableShare时返回true
+     */
+    static bool systemMemoryRecovered();
+
+    /**
+     * @brief   读取物理内存总量和可用量
+     * @param   total 输出总字节数
+     * @param   available 输出可用字节数
+     * @return  读取成功时返回true
+     */
+    static bool queryPhysicalMemory(unsigned long long& total, unsigned long long& available);
+
+    /**
+     * @brief   计算默认预算
+     */
+    static unsigned long long defaultBudget();
+
+    /** @brief 已注册的消费者 */
+    std::vector<Consumer> _consumers;
+
+    /** @brief 下一个消费者标识 */
+    int _nextId;
+
+    /** @brief 总预算 */
+    unsigned long long _budget;
+
+    /** @brief 内存紧张时的预算比例，正常时为1 */
+    double _pressureScale;
+
+    /** @brief 系统内存检测定时器 */
+    QTimer _pollTimer;
+
+    /** @brief 系统内存不足通知句柄（Windows），其他平台为空 */
+    void* _lowMemoryNotification;
+};
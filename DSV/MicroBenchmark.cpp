@@ -0,0 +1,546 @@
+﻿/**
+ * @file MicroBenchmark.cpp
+ * @brief 微基准测试实现文件
+ * @details 该文件实现了缓存和像素内核的微基准测试，包括：
+ *          - 模拟视口平移和缩放的缓存键序列
+ *          - 计时循环和统计
+ *          - 文本、JSON和CSV格式的报告
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "MicroBenchmark.h"
+#include "TileCache.hpp"
+#include "WSITileGraphicsItemCache.h"
+#include "TileManager.h"
+#include "MultiResolutionImage.h"
+#include "MultiResolutionImageFactory.h"
+#include "PixelConversion.h"
+#include "UtilityFunctions.h"
+#include "SlideColorManagement.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <random>
+
+namespace {
+
+    /** @brief 随机数种子，保证不同版本的输入相同 */
+    const unsigned int kSeed = 20250119;
+
+    /** @brief 模拟视口的瓦片列数和行数（1920x1080视口、512瓦片） */
+    const int kViewportColumns = 5;
+    const int kViewportRows = 3;
+
+    /** @brief 像素内核测试的瓦片边长 */
+    const unsigned int kTileSize = 512;
+
+    /** @brief 覆盖度测试的切片尺寸，第0层约2^35像素、52万个256瓦片 */
+    const unsigned long long kCoverageWidth = 262144;
+    const unsigned long long kCoverageHeight = 131072;
+
+    /** @brief 防止编译器删除测试代码的结果汇总 */
+    volatile unsigned long long sink = 0;
+
+    /**
+     * @brief 计时执行一项测试
+     * @param name 测试名称
+     * @param options 运行参数
+     * @param items 每次执行处理的项数
+     * @param bytes 每次执行处理的字节数
+     * @param body 测试体
+     * @param results 输出结果
+     * @details 名称不匹配--filter时不执行
+     */
+    template<typename F>
+    void measure(const QString& name, const MicroBenchmark::Options& options, double items, double bytes, F body,
+        std::vector<MicroBenchmark::Result>& results, unsigned int minSamples, unsigned int maxSamples)
+    {
+        if (!options.filter.isEmpty() && !name.contains(options.filter, Qt::CaseInsensitive)) {
+            return;
+        }
+        MicroBenchmark::Result result;
+        result.name = name;
+        result.items = items;
+        result.bytes = bytes;
+        body();
+        QElapsedTimer total;
+        total.start();
+        while (result.samples.size() < minSamples ||
+            (total.elapsed() < static_cast<qint64>(options.minTimeMs) && result.samples.size() < maxSamples)) {
+            QElapsedTimer timer;
+            timer.start();
+            body();
+            result.samples.push_back(static_cast<double>(timer.nsecsElapsed()));
+        }
+        std::sort(result.samples.begin(), result.samples.end());
+        results.push_back(result);
+    }
+
+    /**
+     * @brief 生成模拟浏览的缓存键序列
+     * @param steps 视口移动次数
+     * @param levels 层级数，第0层为kCoverageWidth/256 x kCoverageHeight/256个瓦片
+     * @return 每一步视口内的所有瓦片键
+     * @details 视口多数时候平移一列或一行，约5%的步骤缩放一级并保持中心不变，
+     *          与PathologyViewer浏览时的访问模式相近：相邻步骤的键大量重叠
+     */
+    std::vector<TileCache<unsigned char>::keyType> browsingTrace(unsigned int steps, unsigned int levels)
+    {
+        std::mt19937 rng(kSeed);
+        std::uniform_int_distribution<int> direction(0, 3);
+        std::uniform_real_distribution<double> chance(0., 1.);
+        std::vector<TileCache<unsigned char>::keyType> keys;
+        keys.reserve(static_cast<size_t>(steps) * kViewportColumns * kViewportRows);
+        unsigned int level = levels / 2;
+        int x = 0, y = 0;
+        for (unsigned int step = 0; step < steps; ++step) {
+            const int columns = std::max<int>(1, static_cast<int>((kCoverageWidth >> level) / 256));
+            const int rows = std::max<int>(1, static_cast<int>((kCoverageHeight >> level) / 256));
+            if (chance(rng) < 0.05) {
+                if ((chance(rng) < 0.5 && level > 0) || level + 1 >= levels) {
+                    --level;
+                    x = x * 2 + kViewportColumns / 2;
+                    y = y * 2 + kViewportRows / 2;
+                }
+                else {
+                    ++level;
+                    x = (x - kViewportColumns / 2) / 2;
+                    y = (y - kViewportRows / 2) / 2;
+                }
+            }
+            else {
+                const int d = direction(rng);
+                x += d == 0 ? 1 : d == 1 ? -1 : 0;
+                y += d == 2 ? 1 : d == 3 ? -1 : 0;
+            }
+            x = std::max(0, std::min(x, columns - kViewportColumns));
+            y = std::max(0, std::min(y, rows - kViewportRows));
+            for (int row = 0; row < kViewportRows; ++row) {
+                for (int column = 0; column < kViewportColumns; ++column) {
+                    keys.push_back(TileCache<unsigned char>::makeKey(x + column, y + row, level));
+                }
+            }
+        }
+        return keys;
+    }
+
+    /**
+     * @brief 生成随机样本
+     * @param count 样本数
+     * @param maxValue 最大值
+     */
+    template<typename T>
+    std::vector<T> randomSamples(unsigned long long count, double maxValue)
+    {
+        std::mt19937 rng(kSeed);
+        std::uniform_real_distribution<double> value(0., maxValue);
+        std::vector<T> samples(count);
+        for (T& sample : samples) {
+            sample = static_cast<T>(value(rng));
+        }
+        return samples;
+    }
+
+    /** @brief 数据类型名称 */
+    template<typename T> const char* typeName();
+    template<> const char* typeName<unsigned char>() { return "uchar"; }
+    template<> const char* typeName<unsigned short>() { return "ushort"; }
+    template<> const char* typeName<unsigned int>() { return "uint"; }
+    template<> const char* typeName<float>() { return "float"; }
+
+    /** @brief 数据类型的典型最大值，float数据按归一化数据处理 */
+    template<typename T> double typeRange() { return static_cast<double>(std::numeric_limits<T>::max()); }
+    template<> double typeRange<unsigned int>() { return 1000000.; }
+    template<> double typeRange<float>() { return 1.; }
+
+    /**
+     * @brief 单色转换测试
+     * @param options 运行参数
+     * @param LUT 相对颜色查找表
+     * @param results 输出结果
+     * @param minSamples 最少执行次数
+     * @param maxSamples 最多执行次数
+     */
+    template<typename T>
+    void benchmarkMonochrome(const MicroBenchmark::Options& options, const SlideColorManagement::LUT& LUT,
+        std::vector<MicroBenchmark::Result>& results, unsigned int minSamples, unsigned int maxSamples)
+    {
+        const unsigned long long nrPixels = static_cast<unsigned long long>(kTileSize) * kTileSize;
+        std::vector<T> data = randomSamples<T>(nrPixels, typeRange<T>());
+        DenseLUT table;
+        table.compile<T>(LUT, 0., typeRange<T>(), 1);
+        measure(QStringLiteral("convertMonochromeToRGB/dense/") + typeName<T>(), options, nrPixels, nrPixels * sizeof(T), [&]() {
+            QImage image = convertMonochromeToRGB(static_cast<const T*>(data.data()), kTileSize, kTileSize, 0, 1, table);
+            sink = sink + image.constBits()[0];
+        }, results, minSamples, maxSamples);
+        measure(QStringLiteral("convertMonochromeToRGB/map/") + typeName<T>(), options, nrPixels, nrPixels * sizeof(T), [&]() {
+            QImage image = convertMonochromeToRGB(data.data(), kTileSize, kTileSize, 0, 1, 0., typeRange<T>(), LUT);
+            sink = sink + image.constBits()[0];
+        }, results, minSamples, maxSamples);
+    }
+}
+
+/**
+ * @brief 命令行是否请求微基准测试
+ * @param arguments 命令行参数
+ * @return 包含--microbenchmark时返回true
+ */
+bool MicroBenchmark::isRequested(const QStringList& arguments)
+{
+    return arguments.contains(QStringLiteral("--microbenchmark"));
+}
+
+/**
+ * @brief 解析命令行
+ * @param arguments 命令行参数，第一个为程序路径
+ * @param options 输出的运行参数
+ * @param errorMessage 错误信息
+ * @return 是否解析成功
+ */
+bool MicroBenchmark::parseArguments(const QStringList& arguments, Options& options, QString& errorMessage)
+{
+    for (int i = 1; i < arguments.size(); ++i) {
+        const QString& argument = arguments[i];
+        if (argument == QStringLiteral("--microbenchmark")) {
+            continue;
+        }
+        if (argument != QStringLiteral("--filter") && argument != QStringLiteral("--min-time") && argument != QStringLiteral("--report")) {
+            errorMessage = QStringLiteral("usage: DSV --microbenchmark [--filter TEXT] [--min-time MS] [--report FILE]");
+            return false;
+        }
+        if (i + 1 >= arguments.size()) {
+            errorMessage = argument + QStringLiteral(" requires a value");
+            return false;
+        }
+        const QString value = arguments[++i];
+        if (argument == QStringLiteral("--filter")) {
+            options.filter = value;
+        }
+        else if (argument == QStringLiteral("--report")) {
+            options.reportPath = value;
+        }
+        else {
+            bool ok = false;
+            options.minTimeMs = value.toUInt(&ok);
+            if (!ok) {
+                errorMessage = QStringLiteral("invalid value for ") + argument + QStringLiteral(": ") + value;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 瓦片缓存测试
+ * @param options 运行参数
+ * @param results 输出结果
+ * @details get/hit：全部键已在缓存中；get_set/evict：容量约为三个视口，
+ *          未命中时插入新瓦片并淘汰最久未使用的瓦片，与IOWorker的解码瓦片缓存用法相同
+ */
+void MicroBenchmark::benchmarkTileCache(const Options& options, std::vector<Result>& results)
+{
+    typedef TileCache<unsigned char> Cache;
+    const std::vector<Cache::keyType> trace = browsingTrace(4000, 10);
+    const unsigned int tileBytes = kTileSize * kTileSize * 3;
+
+    Cache warm(static_cast<unsigned long long>(trace.size()) * tileBytes);
+    for (Cache::keyType key : trace) {
+        unsigned char* value = NULL;
+        unsigned int size = 0;
+        warm.get(key, value, size);
+        if (!value) {
+            warm.set(key, new unsigned char[1], tileBytes);
+        }
+    }
+    measure(QStringLiteral("TileCache/get/hit"), options, trace.size(), 0., [&]() {
+        unsigned long long found = 0;
+        for (Cache::keyType key : trace) {
+            unsigned char* value = NULL;
+            unsigned int size = 0;
+            warm.get(key, value, size);
+            found += value != NULL;
+        }
+        sink = sink + found;
+    }, results, kMinSamples, kMaxSamples);
+
+    // 缓存只计大小，不访问数据，插入的数据只分配1字节，测量的是缓存本身的开销
+    Cache small(3ULL * kViewportColumns * kViewportRows * tileBytes);
+    measure(QStringLiteral("TileCache/get_set/evict"), options, trace.size(), 0., [&]() {
+        unsigned long long misses = 0;
+        for (Cache::keyType key : trace) {
+            unsigned char* value = NULL;
+            unsigned int size = 0;
+            small.get(key, value, size);
+            if (!value) {
+                small.set(key, new unsigned char[1], tileBytes);
+                ++misses;
+            }
+        }
+        sink = sink + misses;
+    }, results, kMinSamples, kMaxSamples);
+}
+
+/**
+ * @brief 瓦片图形项缓存测试
+ * @param options 运行参数
+ * @param results 输出结果
+ * @details 与TileManager相同，最低分辨率层级的图形项以固定项插入，不参与淘汰。
+ *          缓存只保存图形项指针，不访问图形项，测试使用占位地址代替真实图形项
+ */
+void MicroBenchmark::benchmarkItemCache(const Options& options, std::vector<Result>& results)
+{
+    const unsigned int levels = 10;
+    const std::vector<TileCache<unsigned char>::keyType> trace = browsingTrace(4000, levels - 1);
+    const unsigned int tileBytes = kTileSize * kTileSize * 4;
+    std::vector<unsigned char> placeholders(4096);
+    auto item = [&placeholders](unsigned long long i) {
+        return reinterpret_cast<WSITileGraphicsItem*>(placeholders.data() + (i % placeholders.size()));
+    };
+
+    WSITileGraphicsItemCache cache;
+    cache.setMaxCacheSize(4ULL * kViewportColumns * kViewportRows * tileBytes + (1ULL << 26));
+    const unsigned int topLevel = levels - 1;
+    const int topColumns = std::max<int>(1, static_cast<int>((kCoverageWidth >> topLevel) / 256));
+    const int topRows = std::max<int>(1, static_cast<int>((kCoverageHeight >> topLevel) / 256));
+    for (int y = 0; y < topRows; ++y) {
+        for (int x = 0; x < topColumns; ++x) {
+            cache.set(WSITileGraphicsItemCache::makeKey(x, y, topLevel), item(x + y * topColumns), tileBytes, true);
+        }
+    }
+    measure(QStringLiteral("WSITileGraphicsItemCache/get_set/pinned"), options, trace.size(), 0., [&]() {
+        unsigned long long misses = 0;
+        for (size_t i = 0; i < trace.size(); ++i) {
+            WSITileGraphicsItem* value = NULL;
+            unsigned int size = 0;
+            cache.get(trace[i], value, size);
+            if (!value) {
+                cache.set(trace[i], item(i), tileBytes);
+                ++misses;
+            }
+        }
+        sink = sink + misses;
+    }, results, kMinSamples, kMaxSamples);
+    cache.clear();
+}
+
+/**
+ * @brief 颜色查找表和单色转换测试
+ * @param options 运行参数
+ * @param results 输出结果
+ * @details applyLUT逐像素插值；convertMonochromeToRGB对每个数据类型分别测量
+ *          IOWorker使用的稠密查找表版本和逐像素map缓存版本
+ */
+void MicroBenchmark::benchmarkLookupTables(const Options& options, std::vector<Result>& results)
+{
+    SlideColorManagement::LUT LUT = SlideColorManagement::DefaultColorLUT["Normal"];
+    LUT.relative = true;
+    const unsigned long long nrPixels = static_cast<unsigned long long>(kTileSize) * kTileSize;
+    const std::vector<float> values = randomSamples<float>(nrPixels, 1.);
+    measure(QStringLiteral("applyLUT/float"), options, nrPixels, nrPixels * sizeof(float), [&]() {
+        unsigned long long checksum = 0;
+        for (float value : values) {
+            checksum += applyLUT(value, LUT);
+        }
+        sink = sink + checksum;
+    }, results, kMinSamples, kMaxSamples);
+    benchmarkMonochrome<unsigned char>(options, LUT, results, kMinSamples, kMaxSamples);
+    benchmarkMonochrome<unsigned short>(options, LUT, results, kMinSamples, kMaxSamples);
+    benchmarkMonochrome<unsigned int>(options, LUT, results, kMinSamples, kMaxSamples);
+    benchmarkMonochrome<float>(options, LUT, results, kMinSamples, kMaxSamples);
+}
+
+/**
+ * @brief 预乘BGRA到RGB转换测试
+ * @param options 运行参数
+ * @param results 输出结果
+ * @details 输入约90%为不透明像素，其余为半透明边缘，测试名称包含当前CPU选用的内核
+ */
+void MicroBenchmark::benchmarkBGRAConversion(const Options& options, std::vector<Result>& results)
+{
+    const unsigned long long nrPixels = static_cast<unsigned long long>(kTileSize) * kTileSize;
+    std::vector<unsigned char> bgra(nrPixels * 4);
+    std::mt19937 rng(kSeed);
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (unsigned long long i = 0; i < nrPixels; ++i) {
+        const int alpha = byte(rng) < 230 ? 255 : byte(rng);
+        for (int c = 0; c < 3; ++c) {
+            bgra[i * 4 + c] = static_cast<unsigned char>(byte(rng) * alpha / 255);
+        }
+        bgra[i * 4 + 3] = static_cast<unsigned char>(alpha);
+    }
+    std::vector<unsigned char> rgb(nrPixels * 3);
+    measure(QStringLiteral("premultipliedBGRAToRGB/") + QString::fromLatin1(PixelConversion::activeKernelName()), options, nrPixels, nrPixels * 4, [&]() {
+        PixelConversion::premultipliedBGRAToRGB(bgra.data(), rgb.data(), nrPixels, 255, 255, 255);
+        sink = sink + rgb[0];
+    }, results, kMinSamples, kMaxSamples);
+}
+
+/**
+ * @brief 覆盖度网格测试
+ * @param options 运行参数
+ * @param results 输出结果
+ * @details 在临时目录中写入一个只有描述文件的DeepZoom切片作为十亿像素级图像，
+ *          TileManager只读取层级尺寸，不读取任何瓦片，也不需要IO线程和场景
+ */
+void MicroBenchmark::benchmarkCoverage(const Options& options, std::vector<Result>& results)
+{
+    QTemporaryDir directory;
+    const QString descriptorPath = directory.filePath(QStringLiteral("coverage.dzi"));
+    QFile descriptor(descriptorPath);
+    if (!directory.isValid() || !descriptor.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return;
+    }
+    descriptor.write(QStringLiteral("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" TileSize=\"256\" Overlap=\"0\" Format=\"jpg\">"
+        "<Size Width=\"%1\" Height=\"%2\"/></Image>\n").arg(kCoverageWidth).arg(kCoverageHeight).toUtf8());
+    descriptor.close();
+    std::shared_ptr<MultiResolutionImage> img(MultiResolutionImageFactory::openImage(descriptorPath.toStdString()));
+    if (!img || !img->valid()) {
+        return;
+    }
+    TileManager manager(img, std::vector<unsigned int>(1, 256), img->getNumberOfLevels() - 1, NULL, NULL, NULL);
+    const int columns = static_cast<int>(kCoverageWidth / 256);
+    const int rows = static_cast<int>(kCoverageHeight / 256);
+    const unsigned int count = 1u << 20;
+    std::vector<int> xs = randomSamples<int>(count, columns - 1);
+    std::vector<int> ys(xs.rbegin(), xs.rend());
+    std::transform(ys.begin(), ys.end(), ys.begin(), [rows](int v) { return v % rows; });
+    const double tiles = static_cast<double>(columns) * rows;
+
+    unsigned char covers = 2;
+    measure(QStringLiteral("TileManager/setCoverage/") + QString::number(tiles, 'f', 0) + QStringLiteral("tiles"), options, count, 0., [&]() {
+        for (unsigned int i = 0; i < count; ++i) {
+            manager.setCoverage(0, xs[i], ys[i], covers);
+        }
+        covers = covers == 2 ? 0 : 2;
+    }, results, kMinSamples, kMaxSamples);
+    for (unsigned int i = 0; i < count; i += 2) {
+        manager.setCoverage(0, xs[i], ys[i], 2);
+    }
+    measure(QStringLiteral("TileManager/providesCoverage/") + QString::number(tiles, 'f', 0) + QStringLiteral("tiles"), options, count, 0., [&]() {
+        unsigned long long covered = 0;
+        for (unsigned int i = 0; i < count; ++i) {
+            covered += manager.providesCoverage(0, xs[i], ys[i]);
+        }
+        sink = sink + covered + manager.providesCoverage(0);
+    }, results, kMinSamples, kMaxSamples);
+    measure(QStringLiteral("TileManager/isCovered/level1"), options, count, 0., [&]() {
+        unsigned long long covered = 0;
+        for (unsigned int i = 0; i < count; ++i) {
+            covered += manager.isCovered(1, xs[i] / 2, ys[i] / 2);
+        }
+        sink = sink + covered;
+    }, results, kMinSamples, kMaxSamples);
+}
+
+/**
+ * @brief 输出文本表格
+ * @param results 测试结果
+ * @param out 文本输出
+ */
+void MicroBenchmark::report(const std::vector<Result>& results, QTextStream& out)
+{
+    out << QStringLiteral("%1 %2 %3 %4 %5 %6\n").arg(QStringLiteral("benchmark"), -48).arg(QStringLiteral("median_us"), 12)
+        .arg(QStringLiteral("min_us"), 12).arg(QStringLiteral("p90_us"), 12).arg(QStringLiteral("Mitems/s"), 12).arg(QStringLiteral("MB/s"), 12);
+    for (const Result& result : results) {
+        const double median = result.samples[result.samples.size() / 2];
+        const double p90 = result.samples[std::min(result.samples.size() - 1, result.samples.size() * 9 / 10)];
+        out << QStringLiteral("%1 %2 %3 %4 %5 %6\n").arg(result.name, -48).arg(median / 1000., 12, 'f', 2)
+            .arg(result.samples.front() / 1000., 12, 'f', 2).arg(p90 / 1000., 12, 'f', 2).arg(result.items / median * 1000., 12, 'f', 2)
+            .arg(result.bytes > 0. ? QString::number(result.bytes / median * 1000., 'f', 1) : QStringLiteral("-"), 12);
+    }
+}
+
+/**
+ * @brief 写入结果文件
+ * @param results 测试结果
+ * @param path 文件路径
+ * @return 写入成功时返回true
+ * @details 耗时单位为纳秒，吞吐量按中位数计算
+ */
+bool MicroBenchmark::writeReport(const std::vector<Result>& results, const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        return false;
+    }
+    if (path.endsWith(QStringLiteral(".csv"), Qt::CaseInsensitive)) {
+        QTextStream csv(&file);
+        csv << "benchmark,samples,median_ns,min_ns,mean_ns,p90_ns,items,items_per_s,bytes_per_s\n";
+        for (const Result& result : results) {
+            const double median = result.samples[result.samples.size() / 2];
+            double mean = 0.;
+            for (double sample : result.samples) {
+                mean += sample / result.samples.size();
+            }
+            csv << result.name << "," << result.samples.size() << "," << median << "," << result.samples.front() << ","
+                << mean << "," << result.samples[std::min(result.samples.size() - 1, result.samples.size() * 9 / 10)] << ","
+                << result.items << "," << result.items / median * 1e9 << "," << result.bytes / median * 1e9 << "\n";
+        }
+        return csv.status() == QTextStream::Ok;
+    }
+    QJsonArray entries;
+    for (const Result& result : results) {
+        const double median = result.samples[result.samples.size() / 2];
+        double mean = 0.;
+        for (double sample : result.samples) {
+            mean += sample / result.samples.size();
+        }
+        QJsonObject entry;
+        entry["name"] = result.name;
+        entry["samples"] = static_cast<double>(result.samples.size());
+        entry["median_ns"] = median;
+        entry["min_ns"] = result.samples.front();
+        entry["mean_ns"] = mean;
+        entry["p90_ns"] = result.samples[std::min(result.samples.size() - 1, result.samples.size() * 9 / 10)];
+        entry["items"] = result.items;
+        entry["items_per_s"] = result.items / median * 1e9;
+        entry["bytes_per_s"] = result.bytes / median * 1e9;
+        entries.append(entry);
+    }
+    QJsonObject root;
+    root["version"] = 1;
+    root["kernel"] = QString::fromLatin1(PixelConversion::activeKernelName());
+    root["results"] = entries;
+    const QByteArray json = QJsonDocument(root).toJson();
+    return file.write(json) == json.size();
+}
+
+/**
+ * @brief 运行微基准测试
+ * @param arguments 命令行参数
+ * @return 进程退出码
+ */
+int MicroBenchmark::run(const QStringList& arguments)
+{
+    QTextStream out(stdout);
+    Options options;
+    QString errorMessage;
+    if (!parseArguments(arguments, options, errorMessage)) {
+        out << errorMessage << "\n";
+        return 2;
+    }
+    std::vector<Result> results;
+    benchmarkTileCache(options, results);
+    benchmarkItemCache(options, results);
+    benchmarkLookupTables(options, results);
+    benchmarkBGRAConversion(options, results);
+    benchmarkCoverage(options, results);
+    report(results, out);
+    out.flush();
+    if (!options.reportPath.isEmpty() && !writeReport(results, options.reportPath)) {
+        out << "cannot write report " << options.reportPath << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,125 @@
+﻿/**
+ * @file    MicroBenchmark.h
+ * @brief   微基准测试类，无界面测量缓存和像素内核的吞吐量
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该类补充SlideBenchmark的端到端测量，单独测量以下热点：
+ *          - TileCache的查找、插入和LRU淘汰，键序列模拟视口平移和缩放
+ *          - WSITileGraphicsItemCache在最低分辨率层级固定时的查找和淘汰
+ *          - applyLUT以及各数据类型的convertMonochromeToRGB
+ *          - OpenSlideImage::readDataFromImage使用的预乘BGRA到RGB转换
+ *          - 十亿像素级切片上的TileManager::setCoverage/providesCoverage/isCovered
+ *          结果以文本表格输出，并可写成JSON或CSV，便于在版本之间比较
+ *
+ * @note    通过命令行启动：DSV.exe --microbenchmark [--filter TEXT] [--min-time MS] [--report FILE]
+ * @see     SlideBenchmark, PixelConversion, TileCache
+ */
+
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <vector>
+
+class QTextStream;
+
+/**
+ * @class  MicroBenchmark
+ * @brief  缓存和像素内核的微基准测试
+ * @details 每项测试先预热一次，再重复执行直到累计时间达到--min-time（默认300ms）
+ *          且至少kMinSamples次，报告每次执行耗时的中位数、最小值、平均值和p90，
+ *          以及按中位数计算的每秒处理项数和字节吞吐量。
+ *          随机数据和键序列使用固定种子生成，不同版本之间的输入完全相同。
+ *
+ *          命令行选项：
+ *          - --filter TEXT     只运行名称包含TEXT的测试
+ *          - --min-time MS     每项测试的最短累计时间
+ *          - --report FILE     把结果写入文件，扩展名为.csv时写CSV，否则写JSON
+ *
+ * @example
+ *          // 使用示例（main.cpp）
+ *          if (MicroBenchmark::isRequested(arguments)) {
+ *              return MicroBenchmark::run(arguments);
+ *          }
+ */
+class MicroBenchmark
+{
+public:
+    /**
+     * @brief   命令行是否请求微基准测试
+     * @param   arguments 命令行参数
+     * @return  包含--microbenchmark时返回true
+     */
+    static bool isRequested(const QStringList& arguments);
+
+    /**
+     * @brief   运行微基准测试
+     * @param   arguments 命令行参数
+     * @return  进程退出码，0表示所有测试都已运行
+     * @note    需要已创建QApplication
+     */
+    static int run(const QStringList& arguments);
+
+    /**
+     * @brief 运行参数
+     */
+    struct Options {
+        QString filter;
+        QString reportPath;
+        unsigned int minTimeMs = 300;
+    };
+
+    /**
+     * @brief 单项测试结果
+     */
+    struct Result {
+        QString name;
+        double items = 0.;           ///< 每次执行处理的项数（像素、键或瓦片数）
+        double bytes = 0.;           ///< 每次执行处理的字节数，不适用时为0
+        std::vector<double> samples; ///< 每次执行的耗时（纳秒），已排序
+    };
+
+private:
+    /**
+     * @brief   解析命令行
+     * @return  参数有效时返回true，否则errorMessage给出原因
+     */
+    static bool parseArguments(const QStringList& arguments, Options& options, QString& errorMessage);
+
+    /** @brief 瓦片缓存测试 */
+    static void benchmarkTileCache(const Options& options, std::vector<Result>& results);
+
+    /** @brief 瓦片图形项缓存测试 */
+    static void benchmarkItemCache(const Options& options, std::vector<Result>& results);
+
+    /** @brief 颜色查找表和单色转换测试 */
+    static void benchmarkLookupTables(const Options& options, std::vector<Result>& results);
+
+    /** @brief 预乘BGRA到RGB转换测试 */
+    static void benchmarkBGRAConversion(const Options& options, std::vector<Result>& results);
+
+    /** @brief 覆盖度网格测试 */
+    static void benchmarkCoverage(const Options& options, std::vector<Result>& results);
+
+    /**
+     * @brief   输出文本表格
+     * @param   results 测试结果
+     * @param   out 文本输出
+     */
+    static void report(const std::vector<Result>& results, QTextStream& out);
+
+    /**
+     * @brief   写入结果文件
+     * @param   results 测试结果
+     * @param   path 文件路径，扩展名为.csv时写CSV，否则写JSON
+     * @return  写入成功时返回true
+     */
+    static bool writeReport(const std::vector<Result>& results, const QString& path);
+
+    /** @brief 每项测试的最少执行次数 */
+    static const unsigned int kMinSamples = 5;
+
+    /** @brief 每项测试的最多执行次数 */
+    static const unsigned int kMaxSamples = 10000;
+};
@@ -5,6 +5,11 @@
 #include <QSizePolicy>
 #include <QMouseEvent>
 #include <QPainterPath>
+#include <QPaintEvent>
+#include <QResizeEvent>
+#include <QRegion>
+#include <algorithm>
+#include <cmath>
 #include "TileManager.h"
 
 const char* const MiniMap::coverageColors[] = { "red", "green", "yellow", "black", "purple", "orange" };
@@ -15,7 +20,9 @@ MiniMap::MiniMap(const QPixmap& overview, QWidget* parent)
     _fieldOfView(QRectF()),
     _aspectRatio(1),
     _manager(NULL),
-    _drawCoverageMap(true)
+    _drawCoverageMap(true),
+    _coverageDirty(true),
+    _placeholder(false)
 {
     QSizePolicy policy;
     policy.setHeightForWidth(true);
@@ -27,6 +34,25 @@ MiniMap::MiniMap(const QPixmap& overview, QWidget* parent)
     }
 }
 
+MiniMap::MiniMap(const QSize& overviewSize, QWidget* parent)
+    : MiniMap(QPixmap(overviewSize), parent)
+{
+    _overview.fill(Qt::lightGray);
+    _placeholder = true;
+}
+
+void MiniMap::setOverview(const QPixmap& overview) {
+    _overview = overview;
+    _placeholder = false;
+    if (!_overview.isNull()) {
+        _aspectRatio = static_cast<float>(_overview.width()) / _overview.height();
+    }
+    _coverageDirty = true;
+    rebuildRaster();
+    updateGeometry();
+    update();
+}
+
 void MiniMap::toggleCoverageMap(bool drawCoverageMap) {
     bool repaintNeeded = false;
     if (_drawCoverageMap != drawCoverageMap) {
@@ -40,15 +66,180 @@ void MiniMap::toggleCoverageMap(bool drawCoverageMap) {
 
 void MiniMap::setTileManager(TileManager* manager) {
     _manager = manager;
+    _coverageDirty = true;
 }
 
 void MiniMap::updateFieldOfView(const QRectF& fieldOfView) {
+    // 只重绘旧视场框和新视场框所在的区域，光栅和覆盖度不需要重新合成
+    const QRect previous = fieldOfViewBounds(_fieldOfView);
     _fieldOfView = fieldOfView;
-    this->update();
+    this->update(QRegion(previous) + QRegion(fieldOfViewBounds(_fieldOfView)));
 }
 
 void MiniMap::onCoverageUpdated() {
-    this->update();
+    _coverageDirty = true;
+    if (_drawCoverageMap) {
+        this->update();
+    }
+}
+
+unsigned char MiniMap::detailLevel(const QSize& source, const QSizeF& target) {
+    if ((source.width() == 1 && source.height() == 1) || target.width() <= 0. || target.height() <= 0.) {
+        return 255;
+    }
+    const double ratio = std::min(source.width() / target.width(), source.height() / target.height());
+    return static_cast<unsigned char>(std::min(255., std::floor(255. * ratio + 0.5)));
+}
+
+void MiniMap::rebuildRaster() {
+    const QSize rasterSize = (QSizeF(size()) * devicePixelRatioF()).toSize();
+    if (rasterSize.isEmpty() || _overview.isNull()) {
+        _raster = QImage();
+        _detail = QImage();
+        return;
+    }
+    QImage raster(rasterSize, QImage::Format_ARGB32_Premultiplied);
+    {
+        QPainter painter(&raster);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        painter.drawPixmap(raster.rect(), _overview);
+    }
+    const unsigned char overviewDetail = _placeholder ? 0 : detailLevel(_overview.size(), rasterSize);
+    QImage detail(rasterSize, QImage::Format_Grayscale8);
+    detail.fill(overviewDetail);
+    if (!_raster.isNull()) {
+        // 旧光栅放大后细节程度按比例降低，缩小时保持不变
+        const double scale = std::min(1., _raster.width() / static_cast<double>(rasterSize.width()));
+        const QImage previous = _raster.size() == rasterSize ? _raster : _raster.scaled(rasterSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        const QImage previousDetail = _detail.size() == rasterSize ? _detail : _detail.scaled(rasterSize, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+        for (int y = 0; y < rasterSize.height(); ++y) {
+            const QRgb* source = reinterpret_cast<const QRgb*>(previous.constScanLine(y));
+            const uchar* sourceDetail = previousDetail.constScanLine(y);
+            QRgb* line = reinterpret_cast<QRgb*>(raster.scanLine(y));
+            uchar* lineDetail = detail.scanLine(y);
+            for (int x = 0; x < rasterSize.width(); ++x) {
+                const unsigned char kept = static_cast<unsigned char>(sourceDetail[x] * scale);
+                if (kept > lineDetail[x]) {
+                    line[x] = source[x];
+                    lineDetail[x] = kept;
+                }
+            }
+        }
+    }
+    _raster = raster;
+    _detail = detail;
+}
+
+void MiniMap::onTileDisplayed(const QPixmap& tile, const QRectF& area) {
+    if (tile.isNull() || _overview.isNull()) {
+        return;
+    }
+    if (_raster.isNull()) {
+        rebuildRaster();
+        if (_raster.isNull()) {
+            return;
+        }
+    }
+    const double scaleX = _raster.width() / static_cast<double>(_overview.width());
+    const double scaleY = _raster.height() / static_cast<double>(_overview.height());
+    const QRectF target(area.left() * scaleX, area.top() * scaleY, area.width() * scaleX, area.height() * scaleY);
+    const QRect pixels = target.toAlignedRect() & _raster.rect();
+    if (pixels.isEmpty()) {
+        return;
+    }
+    // 区域内的内容都不比该瓦片粗糙时直接跳过，精细层级的瓦片大多在这里返回
+    const unsigned char tileDetail = detailLevel(tile.size(), target.size());
+    bool improves = false;
+    for (int y = pixels.top(); y <= pixels.bottom() && !improves; ++y) {
+        const uchar* line = _detail.constScanLine(y);
+        for (int x = pixels.left(); x <= pixels.right(); ++x) {
+            if (line[x] < tileDetail) {
+                improves = true;
+                break;
+            }
+        }
+    }
+    if (!improves) {
+        return;
+    }
+    // 瓦片绘制在该区域当前内容之上，部分覆盖的边缘像素与原有内容混合
+    QImage scaled = _raster.copy(pixels);
+    {
+        QPainter painter(&scaled);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        painter.drawPixmap(QRectF(target.topLeft() - QPointF(pixels.topLeft()), target.size()), tile, QRectF(tile.rect()));
+    }
+    for (int y = 0; y < pixels.height(); ++y) {
+        const QRgb* source = reinterpret_cast<const QRgb*>(scaled.constScanLine(y));
+        QRgb* line = reinterpret_cast<QRgb*>(_raster.scanLine(pixels.top() + y)) + pixels.left();
+        uchar* lineDetail = _detail.scanLine(pixels.top() + y) + pixels.left();
+        for (int x = 0; x < pixels.width(); ++x) {
+            if (lineDetail[x] < tileDetail) {
+                line[x] = source[x];
+                lineDetail[x] = tileDetail;
+            }
+        }
+    }
+    const qreal ratio = _raster.width() / static_cast<qreal>(width());
+    update(QRectF(pixels.left() / ratio + 1, pixels.top() / ratio + 1, pixels.width() / ratio, pixels.height() / ratio).toAlignedRect());
+}
+
+QRect MiniMap::fieldOfViewBounds(const QRectF& fieldOfView) const {
+    if (_overview.isNull() || !fieldOfView.isValid() || fieldOfView.isEmpty()) {
+        return QRect();
+    }
+    float rectX = width() * (fieldOfView.left() / _overview.width()) + 1;
+    float rectY = height() * (fieldOfView.top() / _overview.height()) + 1;
+    float rectW = width() * (fieldOfView.width() / _overview.width()) - 2;
+    float rectH = height() * (fieldOfView.height() / _overview.height()) - 2;
+    // 3像素宽的画笔向外延伸2像素，小视场绘制为中心的十字
+    const QPointF center(rectX + rectW / 2., rectY + rectH / 2.);
+    return QRectF(rectX, rectY, rectW, rectH).adjusted(-3, -3, 3, 3).united(QRectF(center - QPointF(8, 8), QSizeF(16, 16))).toAlignedRect();
+}
+
+void MiniMap::rebuildCoverageOverlay() {
+    _coverageOverlay = QImage(size(), QImage::Format_ARGB32_Premultiplied);
+    _coverageOverlay.fill(Qt::transparent);
+    _coverageDirty = false;
+    if (!_manager || _overview.isNull() || _coverageOverlay.isNull()) {
+        return;
+    }
+    std::vector<QImage> maps = _manager->getCoverageMaps();
+    const int w = _coverageOverlay.width();
+    const int h = _coverageOverlay.height();
+    const float scaleX = width() / static_cast<float>(_overview.width());
+    const float scaleY = height() / static_cast<float>(_overview.height());
+    QPainter overlayPainter(&_coverageOverlay);
+    for (unsigned int level = 0; level < maps.size(); ++level) {
+        const QImage& map = maps[level];
+        if (map.isNull()) {
+            continue;
+        }
+        float extent = _manager->getCoverageMapTileExtent(level);
+        QImage layer(w, h, QImage::Format_ARGB32_Premultiplied);
+        layer.fill(Qt::transparent);
+        {
+            QPainter layerPainter(&layer);
+            layerPainter.drawImage(QRectF(0, 0, map.width() * extent * scaleX, map.height() * extent * scaleY), map);
+        }
+        // 与原先按路径填充再描边的效果一致：内部为半透明白色，边界为层级颜色
+        const QRgb fill = qPremultiply(qRgba(255, 255, 255, 50 / (level + 1)));
+        const QRgb border = QColor(coverageColors[level % 6]).rgb();
+        for (int y = 0; y < h; ++y) {
+            QRgb* line = reinterpret_cast<QRgb*>(layer.scanLine(y));
+            const QRgb* above = y > 0 ? reinterpret_cast<const QRgb*>(layer.constScanLine(y - 1)) : NULL;
+            const QRgb* below = y < h - 1 ? reinterpret_cast<const QRgb*>(layer.constScanLine(y + 1)) : NULL;
+            for (int x = 0; x < w; ++x) {
+                if (qAlpha(line[x]) == 0) {
+                    continue;
+                }
+                bool edge = x == 0 || x == w - 1 || !above || !below ||
+                    qAlpha(line[x - 1]) == 0 || qAlpha(line[x + 1]) == 0 || qAlpha(above[x]) == 0 || qAlpha(below[x]) == 0;
+                line[x] = edge ? border : fill;
+            }
+        }
+        overlayPainter.drawImage(0, 0, layer);
+    }
 }
 
 void MiniMap::mousePressEvent(QMouseEvent* event) {
@@ -65,31 +256,25 @@ void MiniMap::mouseMoveEvent(QMouseEvent* event) {
 void MiniMap::paintEvent(QPaintEvent* event) {
     QPainter painter(this);
     if (!_overview.isNull()) {
-        painter.drawPixmap(1, 1, width(), height(), _overview);
+        if (_raster.isNull() || _raster.size() != (QSizeF(size()) * devicePixelRatioF()).toSize()) {
+            rebuildRaster();
+        }
+        // 只绘制事件区域内的光栅
+        const QRect target = event->rect() & QRect(1, 1, width(), height());
+        if (!target.isEmpty() && !_raster.isNull()) {
+            const qreal ratio = _raster.width() / static_cast<qreal>(width());
+            painter.drawImage(QRectF(target), _raster, QRectF((target.left() - 1) * ratio, (target.top() - 1) * ratio, target.width() * ratio, target.height() * ratio));
+        }
         painter.setPen(QPen(Qt::white, 2));
         painter.drawRect(1, 1, width() - 2, height() - 2);
         painter.setPen(QPen(Qt::black, 1));
         painter.drawRect(0, 0, width() - 1, height() - 1);
         if (_manager && _drawCoverageMap) {
-            painter.save();
-            std::vector<QPainterPath> pths = _manager->getCoverageMaps();
-            QPainterPath bck;
-            bck.addRect(QRectF(0, 0, width() - 1., height() - 1.));
-            painter.setPen(Qt::PenStyle::NoPen);
-            painter.setBrush(QBrush(QColor(0, 0, 0, 50)));
-            painter.drawPath(bck);
-            for (std::vector<QPainterPath>::const_iterator it = pths.begin(); it != pths.end(); ++it) {
-                if (!it->isEmpty()) {
-                    QTransform trans;
-                    trans = trans.scale(width() / static_cast<float>(_overview.width()), height() / static_cast<float>(_overview.height()));
-                    QPainterPath qpf2 = trans.map(*it);
-                    unsigned int colorIndex = (it - pths.begin()) % 6;
-                    painter.setPen(QPen(QColor(coverageColors[colorIndex])));
-                    painter.setBrush(QBrush(QColor(255, 255, 255, 50 / (it - pths.begin() + 1))));
-                    painter.drawPath(qpf2);
-                }
+            if (_coverageDirty || _coverageOverlay.size() != size()) {
+                rebuildCoverageOverlay();
             }
-            painter.restore();
+            painter.fillRect(QRectF(0, 0, width() - 1., height() - 1.) & QRectF(event->rect()), QColor(0, 0, 0, 50));
+            painter.drawImage(event->rect().topLeft(), _coverageOverlay, event->rect());
         }
         if (_fieldOfView.isValid() && !_fieldOfView.isEmpty()) {
             QPen blue = QPen(QColor("black"));
@@ -110,6 +295,12 @@ void MiniMap::paintEvent(QPaintEvent* event) {
     }
 }
 
+void MiniMap::resizeEvent(QResizeEvent* event) {
+    QWidget::resizeEvent(event);
+    rebuildRaster();
+    _coverageDirty = true;
+}
+
 QSize MiniMap::sizeHint() const {
     QSize size(0, 0);
     unsigned int baseSize = 250;
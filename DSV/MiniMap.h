@@ -5,10 +5,11 @@
  * @date    2025-01-19
  * @version 1.0.0
  * @details 该文件实现了DSV项目的小地图功能，包括：
- *          - 全局缩略图的显示
+ *          - 全局缩略图的显示，随更精细的瓦片到达逐步细化
  *          - 当前视场范围的高亮
  *          - 覆盖度区域的显示与切换
  *          - 与主视图的交互（点击定位、拖拽视场）
+ *          - 视场移动时只重绘新旧视场框所在的区域
  *          该类是DSV项目的全局导航组件，为用户提供
  *          快速定位和全局视野。
  *
@@ -19,8 +20,10 @@
 #pragma once
 #include <QWidget>
 #include <QPointer>
+#include <QImage>
 
 class QPixmap;
+class QResizeEvent;
 class TileManager;
 
 /**
@@ -40,6 +43,11 @@ class TileManager;
  *          - 交互操作：支持点击和拖拽定位主视图
  *          - 界面自适应：根据窗口大小自适应缩放
  *
+ *          小地图保存一张与控件物理像素同尺寸的光栅，由缩略图缩放得到；
+ *          主视图显示的瓦片通过onTileDisplayed绘入光栅，每个光栅像素记录当前内容的细节程度，
+ *          只有比已有内容更精细的瓦片才会写入，因此每个像素最多被细化有限次，
+ *          达到光栅分辨率之后的瓦片只需检查细节程度即可跳过。
+ *
  * @note   该类继承自QWidget，提供全局导航和定位功能
  * @example
  *          // 使用示例
@@ -70,6 +78,17 @@ public:
      */
     MiniMap(const QPixmap& overview, QWidget* parent);
 
+    /**
+     * @brief   以占位图构造
+     * @details 缩略图尚未读取时使用，浅灰色占位图的细节程度为0，
+     *          随后到达的缩略图和瓦片都会替换它
+     *
+     * @param   overviewSize 缩略图层级的尺寸，决定坐标映射
+     * @param   parent 父窗口指针
+     * @see     setOverview, onTileDisplayed
+     */
+    MiniMap(const QSize& overviewSize, QWidget* parent);
+
     /**
      * @brief   推荐尺寸
      * @details 返回小地图的推荐显示尺寸
@@ -98,6 +117,16 @@ public:
      */
     void setTileManager(TileManager* manager);
 
+    /**
+     * @brief   替换缩略图
+     * @details 异步读取的缩略图就绪后替换占位图，并按新宽高比更新布局
+     *
+     * @param   overview 新的缩略图像素图，尺寸应与缩略图层级一致
+     * @note    视场和覆盖度按缩略图像素坐标计算，替换前后尺寸相同时不影响显示位置；
+     *          光栅中已由瓦片细化、比缩略图更精细的像素保留
+     */
+    void setOverview(const QPixmap& overview);
+
 public slots:
     /**
      * @brief   更新视场范围
@@ -124,6 +153,16 @@ public slots:
      */
     void onCoverageUpdated();
 
+    /**
+     * @brief   瓦片显示槽
+     * @details 瓦片比光栅中对应区域已有的内容更精细时缩放绘入光栅，并只重绘该区域
+     *
+     * @param   tile 瓦片像素图，1x1的纯色瓦片视为完全精细
+     * @param   area 瓦片覆盖的区域（缩略图像素坐标）
+     * @see     TileManager::tileDisplayed
+     */
+    void onTileDisplayed(const QPixmap& tile, const QRectF& area);
+
 protected:
     /**
      * @brief   鼠标按下事件
@@ -148,10 +187,18 @@ protected:
      * @details 处理小地图的绘制，包括缩略图、视场和覆盖度
      *
      * @param   event 绘制事件对象
-     * @note    该函数会绘制所有可视元素
+     * @note    只绘制事件区域内的光栅和覆盖度
      */
     void paintEvent(QPaintEvent* event);
 
+    /**
+     * @brief   尺寸变化事件
+     * @details 按新尺寸缩放光栅和细节程度，已细化的内容不丢失
+     *
+     * @param   event 尺寸变化事件对象
+     */
+    void resizeEvent(QResizeEvent* event);
+
 private:
     /** @brief 全局缩略图像素图 */
     QPixmap _overview;
@@ -171,6 +218,53 @@ private:
     /** @brief 是否显示覆盖度区域 */
     bool _drawCoverageMap;
 
+    /** @brief 合成好的覆盖度叠加层，与控件同尺寸 */
+    QImage _coverageOverlay;
+
+    /** @brief 覆盖度是否已改变，需要在下次绘制前重建叠加层 */
+    bool _coverageDirty;
+
+    /** @brief 小地图光栅，与控件的物理像素同尺寸 */
+    QImage _raster;
+
+    /**
+     * @brief 光栅各像素的细节程度
+     * @details Format_Grayscale8，255表示内容的分辨率不低于光栅，0表示占位图
+     */
+    QImage _detail;
+
+    /** @brief 缩略图是否为占位图，占位图的细节程度为0 */
+    bool _placeholder;
+
+    /**
+     * @brief   计算像素图在光栅中的细节程度
+     * @param   source 像素图的像素尺寸
+     * @param   target 在光栅中覆盖的尺寸（光栅像素）
+     * @return  0-255，源分辨率不低于目标时为255
+     */
+    static unsigned char detailLevel(const QSize& source, const QSizeF& target);
+
+    /**
+     * @brief   按当前尺寸重建光栅
+     * @details 缩略图缩放到光栅尺寸，旧光栅中比缩略图更精细的像素缩放后保留
+     */
+    void rebuildRaster();
+
+    /**
+     * @brief   获取视场框在控件中的重绘区域
+     * @param   fieldOfView 视场（缩略图像素坐标）
+     * @return  包含视场框的矩形，含画笔宽度和十字标记
+     */
+    QRect fieldOfViewBounds(const QRectF& fieldOfView) const;
+
+    /**
+     * @brief   重建覆盖度叠加层
+     * @details 把各层级的1位覆盖度地图按最近邻放大到控件尺寸，
+     *          边界像素使用层级颜色，内部像素使用半透明白色，由低层级到高层级叠加。
+     *          开销只与控件尺寸和层级数有关，与已访问的区域大小无关
+     */
+    void rebuildCoverageOverlay();
+
 signals:
     /**
      * @brief   位置点击信号
@@ -12,168 +12,23 @@
  */
 
 #include "MultiResolutionImage.h"
+#include "DiskTileCache.h"
+#include "PipelineProfiler.h"
+#include "SlideStatistics.h"
+#include "TileBufferPool.h"
 #include <cmath>
+#include <map>
 
-/**
- * @brief 获取原始图像区域数据（float类型特化）
- * @details 从指定层级读取图像数据并转换为float类型
- * @param startX 起始X坐标
- * @param startY 起始Y坐标
- * @param width 区域宽度
- * @param height 区域高度
- * @param level 图像层级
- * @param data 输出数据指针（float类型）
- * @note 该函数会根据源数据类型进行相应的类型转换
- */
-template <> void MultiResolutionImage::getRawRegion(const long long& startX, const long long& startY, const unsigned long long& width,
-	const unsigned long long& height, const unsigned int& level, float*& data) {
-	if (level >= getNumberOfLevels()) {
-		return;
-	}
-	unsigned int nrSamples = getSamplesPerPixel();
-	if (this->getDataType() == SlideColorManagement::DataType::Float) {
-		delete[] data;
-		data = (float*)readDataFromImage(startX, startY, width, height, level);
-	}
-	else if (this->getDataType() == SlideColorManagement::DataType::UChar) {
-		unsigned char* temp = (unsigned char*)readDataFromImage(startX, startY, width, height, level);
-		std::copy(temp, temp + width * height * nrSamples, data);
-		delete[] temp;
-	}
-	else if (this->getDataType() == SlideColorManagement::DataType::UInt16) {
-		unsigned short* temp = (unsigned short*)readDataFromImage(startX, startY, width, height, level);
-		std::copy(temp, temp + width * height * nrSamples, data);
-		delete[] temp;
-	}
-	else if (this->getDataType() == SlideColorManagement::DataType::UInt32) {
-		unsigned int* temp = (unsigned int*)readDataFromImage(startX, startY, width, height, level);
-		std::transform(temp, temp + width * height * nrSamples, data, [](unsigned int a) { return static_cast<float>(a); });
-		delete[] temp;
-	}
-}
-
-/**
- * @brief 获取原始图像区域数据（unsigned char类型特化）
- * @details 从指定层级读取图像数据并转换为unsigned char类型
- * @param startX 起始X坐标
- * @param startY 起始Y坐标
- * @param width 区域宽度
- * @param height 区域高度
- * @param level 图像层级
- * @param data 输出数据指针（unsigned char类型）
- * @note 该函数会根据源数据类型进行相应的类型转换
- */
-template <> void MultiResolutionImage::getRawRegion(const long long& startX, const long long& startY, const unsigned long long& width,
-	const unsigned long long& height, const unsigned int& level, unsigned char*& data) {
-	if (level >= getNumberOfLevels()) {
-		return;
-	}
-	unsigned int nrSamples = getSamplesPerPixel();
-	if (this->getDataType() == SlideColorManagement::DataType::Float) {
-		float* temp = (float*)readDataFromImage(startX, startY, width, height, level);
-		std::transform(temp, temp + width * height * nrSamples, data, [](float a) { return static_cast<unsigned char>(a); });
-		delete[] temp;
-	}
-	else if (this->getDataType() == SlideColorManagement::DataType::UChar) {
-		unsigned char* temp = (unsigned char*)readDataFromImage(startX, startY, width, height, level);
-		if (temp) {
-			std::copy(temp, temp + width * height * nrSamples, data);
-			delete[] temp;
-		} else {
-			// 如果读取失败，填充背景色
-			for (unsigned long long i = 0; i < width * height * nrSamples; i += 3) {
-				data[i] = 255;     // R - 白色背景
-				data[i + 1] = 255; // G
-				data[i + 2] = 255; // B
-			}
-		}
-	}
-	else if (this->getDataType() == SlideColorManagement::DataType::UInt16) {
-		unsigned short* temp = (unsigned short*)readDataFromImage(startX, startY, width, height, level);
-		std::transform(temp, temp + width * height * nrSamples, data, [](unsigned short a) { return static_cast<unsigned char>(a); });
-		delete[] temp;
-	}
-	else if (this->getDataType() == SlideColorManagement::DataType::UInt32) {
-		unsigned int* temp = (unsigned int*)readDataFromImage(startX, startY, width, height, level);
-		std::copy(temp, temp + width * height * nrSamples, data);
-		delete[] temp;
-	}
-}
+const double MultiResolutionImage::kCompressedCacheShare = 0.25;
+const double MultiResolutionImage::kZPlaneCacheShare = 0.5;
+const double MultiResolutionImage::kMaxLevelGap = 4.5;
 
-/**
- * @brief 获取原始图像区域数据（unsigned short类型特化）
- * @details 从指定层级读取图像数据并转换为unsigned short类型
- * @param startX 起始X坐标
- * @param startY 起始Y坐标
- * @param width 区域宽度
- * @param height 区域高度
- * @param level 图像层级
- * @param data 输出数据指针（unsigned short类型）
- * @note 该函数会根据源数据类型进行相应的类型转换
- */
-template <> void MultiResolutionImage::getRawRegion(const long long& startX, const long long& startY, const unsigned long long& width,
-	const unsigned long long& height, const unsigned int& level, unsigned short*& data) {
-	if (level >= getNumberOfLevels()) {
-		return;
-	}
-	unsigned int nrSamples = getSamplesPerPixel();
-	if (this->getDataType() == SlideColorManagement::DataType::Float) {
-		float* temp = (float*)readDataFromImage(startX, startY, width, height, level);
-		std::transform(temp, temp + width * height * nrSamples, data, [](float a) { return static_cast<unsigned short>(a); });
-		delete[] temp;
-	}
-	else if (this->getDataType() == SlideColorManagement::DataType::UChar) {
-		unsigned char* temp = (unsigned char*)readDataFromImage(startX, startY, width, height, level);
-		std::copy(temp, temp + width * height * nrSamples, data);
-		delete[] temp;
-	}
-	else if (this->getDataType() == SlideColorManagement::DataType::UInt16) {
-		delete[] data;
-		data = (unsigned short*)readDataFromImage(startX, startY, width, height, level);
-	}
-	else if (this->getDataType() == SlideColorManagement::DataType::UInt32) {
-		unsigned int* temp = (unsigned int*)readDataFromImage(startX, startY, width, height, level);
-		std::copy(temp, temp + width * height * nrSamples, data);
-		delete[] temp;
-	}
-}
+namespace {
+	/** @brief 保护各存储实测读取延迟的互斥锁 */
+	std::mutex storageLatencyMutex;
 
-/**
- * @brief 获取原始图像区域数据（unsigned int类型特化）
- * @details 从指定层级读取图像数据并转换为unsigned int类型
- * @param startX 起始X坐标
- * @param startY 起始Y坐标
- * @param width 区域宽度
- * @param height 区域高度
- * @param level 图像层级
- * @param data 输出数据指针（unsigned int类型）
- * @note 该函数会根据源数据类型进行相应的类型转换
- */
-template <> void MultiResolutionImage::getRawRegion(const long long& startX, const long long& startY, const unsigned long long& width,
-	const unsigned long long& height, const unsigned int& level, unsigned int*& data) {
-	if (level >= getNumberOfLevels()) {
-		return;
-	}
-	unsigned int nrSamples = getSamplesPerPixel();
-	if (this->getDataType() == SlideColorManagement::DataType::Float) {
-		float* temp = (float*)readDataFromImage(startX, startY, width, height, level);
-		std::transform(temp, temp + width * height * nrSamples, data, [](float a) { return static_cast<unsigned int>(a); });
-		delete[] temp;
-	}
-	else if (this->getDataType() == SlideColorManagement::DataType::UChar) {
-		unsigned char* temp = (unsigned char*)readDataFromImage(startX, startY, width, height, level);
-		std::copy(temp, temp + width * height * nrSamples, data);
-		delete[] temp;
-	}
-	else if (this->getDataType() == SlideColorManagement::DataType::UInt16) {
-		unsigned short* temp = (unsigned short*)readDataFromImage(startX, startY, width, height, level);
-		std::copy(temp, temp + width * height * nrSamples, data);
-		delete[] temp;
-	}
-	else if (this->getDataType() == SlideColorManagement::DataType::UInt32) {
-		delete[] data;
-		data = (unsigned int*)readDataFromImage(startX, startY, width, height, level);
-	}
+	/** @brief 各存储（目录或远程地址）实测的每百万像素读取时间（毫秒） */
+	std::map<std::string, double> storageLatency;
 }
 
 /**
@@ -188,14 +43,18 @@ template <> void MultiResolutionImage::getRawRegion(const long long& startX, con
  */
 MultiResolutionImage::MultiResolutionImage()
 	:ImageSource(),
-	m_cacheSize(0),
+	m_cacheSize(256ULL * 1024 * 1024),
 	_levelDimensions(),
 	_numberOfLevels(),
 	m_filePath(),
 	 _fileType(),
 	m_numberOfZPlanes(1),
 	m_currentZPlaneIndex(0),
-	m_cache()
+	m_cache(),
+	_sampleConverters(),
+	_readNanoseconds(0),
+	_readPixels(0),
+	_nrReads(0)
 {
 	m_cacheMutex.reset(new std::mutex());//reset会先释放当前指针的对象（如果有的话），然后让指针指向一个新的对象
 	_openCloseMutex.reset(new std::shared_mutex());
@@ -225,12 +84,38 @@ ImageSource* MultiResolutionImage::clone()
  * @brief 初始化多分辨率图像
  * @param imagePath 图像文件路径
  * @return 初始化是否成功
- * @details 设置文件路径并调用initializeType进行具体初始化
+ * @details 设置文件路径并调用initializeType进行具体初始化，
+ *          成功后生成逻辑层级表，并按原生数据类型创建解码瓦片缓存
  */
 bool MultiResolutionImage::initialize(const std::string& imagePath)
 {
+	std::lock_guard<std::mutex> l(*m_cacheMutex);
+	std::atomic_store(&m_cache, std::shared_ptr<void>());
+	m_compressedCache.reset();
 	m_filePath = imagePath;
-	return initializeType(imagePath);
+	bool success = initializeType(imagePath);
+	if (success) {
+		buildPyramidLevels();
+		// 按原生类型和每像素样本数解析一次到各目标类型的转换内核
+		for (unsigned int destination = 0; destination < kNumberOfSampleConverters; ++destination) {
+			_sampleConverters[destination] = PixelConversion::sampleConverter(_dataType,
+				static_cast<SlideColorManagement::DataType>(destination), _samplesPerPixel);
+		}
+		m_compressedCache = std::make_shared<CompressedTileCache>(m_cacheSize - decodedCacheBytes(m_cacheSize));
+		if (_dataType == SlideColorManagement::DataType::UInt32) {
+			createCache<unsigned int>();
+		}
+		else if (_dataType == SlideColorManagement::DataType::UInt16) {
+			createCache<unsigned short>();
+		}
+		else if (_dataType == SlideColorManagement::DataType::UChar) {
+			createCache<unsigned char>();
+		}
+		else if (_dataType == SlideColorManagement::DataType::Float) {
+			createCache<float>();
+		}
+	}
+	return success;
 }
 
 /**
@@ -247,7 +132,7 @@ int MultiResolutionImage::getNumberOfZPlanes() const
  * @brief 设置当前Z平面索引
  * @param zPlaneIndex 要设置的Z平面索引
  * @details 获取独占锁确保线程安全，使用三元运算符确保索引在有效范围内
- *          如果索引超出范围，则设置为最大有效索引
+ *          如果索引超出范围，则设置为最大有效索引。缓存键包含Z平面，因此不清空缓存
  */
 void MultiResolutionImage::setCurrentZPlaneIndex(const unsigned int& zPlaneIndex)
 {
@@ -256,7 +141,7 @@ void MultiResolutionImage::setCurrentZPlaneIndex(const unsigned int& zPlaneIndex
 	//线程同步确保在同一时间只有一个线程可以获取这个独占锁，从而避免对共享资源的读写冲突
 	//三元运算符  A?B:C      如果A为真执行B，否则执行C
 	zPlaneIndex < m_numberOfZPlanes ? m_currentZPlaneIndex = zPlaneIndex : m_currentZPlaneIndex = m_numberOfZPlanes - 1;
-}                                                                                                 
+}
 
 /**
  * @brief 获取当前Z平面索引
@@ -267,15 +152,28 @@ unsigned int MultiResolutionImage::getCurrentZPlaneIndex() const
 	return m_currentZPlaneIndex;
 }
 
+/**
+ * @brief 换算Z平面索引
+ * @param zPlane Z平面索引或kCurrentZPlane
+ * @return 有效的Z平面索引
+ */
+unsigned int MultiResolutionImage::resolveZPlane(unsigned int zPlane) const
+{
+	if (zPlane == kCurrentZPlane) {
+		return m_currentZPlaneIndex;
+	}
+	return zPlane < m_numberOfZPlanes ? zPlane : m_numberOfZPlanes - 1;
+}
+
 /**
  * @brief 获取缓存大小
  * @return 当前缓存大小（字节数）
- * @details 根据数据类型获取对应类型缓存的当前大小
+ * @details 根据数据类型获取对应类型缓存的最大大小，加上压缩瓦片缓存的最大大小
  */
 const unsigned long long MultiResolutionImage::getCacheSize()
 {
 	unsigned long long cacheSize = 0;
-	m_cacheMutex->lock();
+	std::lock_guard<std::mutex> l(*m_cacheMutex);
 	if (m_cache && _isValid)
 	{
 		if (_dataType == SlideColorManagement::DataType::UInt32) {
@@ -290,34 +188,67 @@ const unsigned long long MultiResolutionImage::getCacheSize()
 		else if (_dataType == SlideColorManagement::DataType::Float) {
 			cacheSize = (std::static_pointer_cast<TileCache<float>>(m_cache))->maxCacheSize();
 		}
-		m_cacheMutex->unlock();
+		if (m_compressedCache) {
+			cacheSize += m_compressedCache->maxCacheSize();
+		}
 	}
 
 	return cacheSize;
 }
 
+/**
+ * @brief 获取解码瓦片缓存和压缩瓦片缓存当前占用的字节数
+ * @return 字节数
+ */
+unsigned long long MultiResolutionImage::getCacheUsage()
+{
+	std::lock_guard<std::mutex> l(*m_cacheMutex);
+	if (!m_cache || !_isValid) {
+		return 0;
+	}
+	unsigned long long usage = m_compressedCache ? m_compressedCache->currentCacheSize() : 0;
+	if (_dataType == SlideColorManagement::DataType::UInt32) {
+		usage += (std::static_pointer_cast<TileCache<unsigned int>>(m_cache))->currentCacheSize();
+	}
+	else if (_dataType == SlideColorManagement::DataType::UInt16) {
+		usage += (std::static_pointer_cast<TileCache<unsigned short>>(m_cache))->currentCacheSize();
+	}
+	else if (_dataType == SlideColorManagement::DataType::UChar) {
+		usage += (std::static_pointer_cast<TileCache<unsigned char>>(m_cache))->currentCacheSize();
+	}
+	else if (_dataType == SlideColorManagement::DataType::Float) {
+		usage += (std::static_pointer_cast<TileCache<float>>(m_cache))->currentCacheSize();
+	}
+	return usage;
+}
+
 /**
  * @brief 设置缓存大小
  * @param cacheSize 要设置的缓存大小（字节数）
- * @details 根据数据类型设置对应类型缓存的最大大小
+ * @details 按kCompressedCacheShare在解码瓦片缓存和压缩瓦片缓存之间划分，之后创建的缓存也使用该大小。
+ *          解码瓦片缓存缩小时淘汰的瓦片进入压缩瓦片缓存，因此先缩小压缩瓦片缓存
  */
 void MultiResolutionImage::setCacheSize(const unsigned long long cacheSize)
 {
-	m_cacheMutex->lock();
+	std::lock_guard<std::mutex> l(*m_cacheMutex);
+	m_cacheSize = cacheSize;
+	const unsigned long long decodedBytes = decodedCacheBytes(cacheSize);
+	if (m_compressedCache) {
+		m_compressedCache->setMaxCacheSize(cacheSize - decodedBytes);
+	}
 	if (m_cache && _isValid) {
 		if (_dataType == SlideColorManagement::DataType::UInt32) {
-			(std::static_pointer_cast<TileCache<unsigned int>>(m_cache))->setMaxCacheSize(cacheSize);
+			(std::static_pointer_cast<TileCache<unsigned int>>(m_cache))->setMaxCacheSize(decodedBytes);
 		}
 		else if (_dataType == SlideColorManagement::DataType::UInt16) {
-			(std::static_pointer_cast<TileCache<unsigned short>>(m_cache))->setMaxCacheSize(cacheSize);
+			(std::static_pointer_cast<TileCache<unsigned short>>(m_cache))->setMaxCacheSize(decodedBytes);
 		}
 		else if (_dataType == SlideColorManagement::DataType::UChar) {
-			(std::static_pointer_cast<TileCache<unsigned char>>(m_cache))->setMaxCacheSize(cacheSize);
+			(std::static_pointer_cast<TileCache<unsigned char>>(m_cache))->setMaxCacheSize(decodedBytes);
 		}
 		else if (_dataType == SlideColorManagement::DataType::Float) {
-			(std::static_pointer_cast<TileCache<float>>(m_cache))->setMaxCacheSize(cacheSize);
+			(std::static_pointer_cast<TileCache<float>>(m_cache))->setMaxCacheSize(decodedBytes);
 		}
-		m_cacheMutex->unlock();
 	}
 }
 
@@ -330,7 +261,7 @@ const int MultiResolutionImage::getNumberOfLevels() const
 {
 	if (_isValid)
 	{
-		return _numberOfLevels;
+		return static_cast<int>(_pyramidLevels.size());
 	}
 	else
 	{
@@ -338,6 +269,51 @@ const int MultiResolutionImage::getNumberOfLevels() const
 	}
 }
 
+/**
+ * @brief 判断层级是否为虚拟层级
+ * @param level 层级索引
+ * @return 虚拟层级返回true
+ */
+bool MultiResolutionImage::isVirtualLevel(const unsigned int& level) const
+{
+	return _isValid && level < _pyramidLevels.size() && _pyramidLevels[level].nativeLevel < 0;
+}
+
+/**
+ * @brief 生成逻辑层级表
+ * @details 原生层级的下采样因子与getLevelDownsample原来的算法一致；
+ *          虚拟层级的尺寸为上一个层级的一半（向上取整），下采样因子为上一个层级的2倍
+ */
+void MultiResolutionImage::buildPyramidLevels()
+{
+	_pyramidLevels.clear();
+	if (_levelDimensions.empty()) {
+		return;
+	}
+	auto addVirtualLevel = [this]() {
+		const PyramidLevel& finer = _pyramidLevels.back();
+		PyramidLevel level;
+		level.dimensions.push_back((finer.dimensions[0] + 1) / 2);
+		level.dimensions.push_back((finer.dimensions[1] + 1) / 2);
+		level.downsample = finer.downsample * 2;
+		level.nativeLevel = -1;
+		_pyramidLevels.push_back(level);
+	};
+	for (unsigned int i = 0; i < _levelDimensions.size(); ++i) {
+		PyramidLevel level;
+		level.dimensions = _levelDimensions[i];
+		level.downsample = static_cast<float>(_levelDimensions[0][0]) / _levelDimensions[i][0];
+		level.nativeLevel = static_cast<int>(i);
+		while (!_pyramidLevels.empty() && level.downsample / _pyramidLevels.back().downsample > kMaxLevelGap) {
+			addVirtualLevel();
+		}
+		_pyramidLevels.push_back(level);
+	}
+	while (std::max(_pyramidLevels.back().dimensions[0], _pyramidLevels.back().dimensions[1]) > kMaxCoarsestLevelSize) {
+		addVirtualLevel();
+	}
+}
+
 /**
  * @brief 获取图像尺寸
  * @return 图像尺寸向量（宽度、高度），如果图像无效则返回空向量
@@ -362,7 +338,24 @@ const std::vector<unsigned long long> MultiResolutionImage::getLevelDimensions(c
 {
 	std::vector<unsigned long long> dims;
 	if (_isValid && (level < getNumberOfLevels())) {
-		return _levelDimensions[level];
+		return _pyramidLevels[level].dimensions;
+	}
+	return dims;
+}
+
+/**
+ * @brief 获取指定层级的原生瓦片尺寸
+ * @param level 层级索引
+ * @return 原生瓦片尺寸向量，未知、虚拟层级或层级无效时返回空向量
+ */
+const std::vector<unsigned long long> MultiResolutionImage::getLevelTileSize(const unsigned int& level) const
+{
+	std::vector<unsigned long long> dims;
+	if (_isValid && level < _pyramidLevels.size()) {
+		const int nativeLevel = _pyramidLevels[level].nativeLevel;
+		if (nativeLevel >= 0 && static_cast<unsigned int>(nativeLevel) < _levelTileSizes.size()) {
+			return _levelTileSizes[nativeLevel];
+		}
 	}
 	return dims;
 }
@@ -371,12 +364,12 @@ const std::vector<unsigned long long> MultiResolutionImage::getLevelDimensions(c
  * @brief 获取指定层级的降采样比例
  * @param level 层级索引
  * @return 降采样比例，如果层级无效则返回-1.0
- * @details 计算指定层级相对于最高分辨率级别的降采样比例
+ * @details 返回逻辑层级表中的降采样比例，原生层级按宽度之比计算，虚拟层级为上一个层级的2倍
  */
 const double MultiResolutionImage::getLevelDownsample(const unsigned int& level) const
 {
 	if (_isValid && (level < getNumberOfLevels())) {
-		return static_cast<float>(_levelDimensions[0][0]) / _levelDimensions[level][0];
+		return _pyramidLevels[level].downsample;
 	}
 	else {
 		return -1.0;
@@ -396,9 +389,9 @@ const int MultiResolutionImage::getBestLevelForDownSample(const double& downsamp
 		if (downsample < 1.0) {
 			return 0;
 		}
-		for (int i = 1; i < _levelDimensions.size(); ++i) {
-			double currentDownSample = (double)_levelDimensions[0][0] / (double)_levelDimensions[i][0];
-			double previousDownSample = (double)_levelDimensions[0][0] / (double)_levelDimensions[i - 1][0];
+		for (int i = 1; i < _pyramidLevels.size(); ++i) {
+			double currentDownSample = _pyramidLevels[i].downsample;
+			double previousDownSample = _pyramidLevels[i - 1].downsample;
 			if (downsample < currentDownSample) {
 
 				if (std::abs(currentDownSample - downsample) > std::abs(previousDownSample - downsample)) {
@@ -428,6 +421,568 @@ const std::string MultiResolutionImage::getFileType() const
 	return  _fileType;
 }
 
+/**
+ * @brief 获取实测的读取延迟
+ * @return 每百万像素的平均读取时间（毫秒），没有实测值时返回0
+ */
+double MultiResolutionImage::getReadLatency() const
+{
+	const unsigned long long pixels = _readPixels;
+	if (_nrReads >= kMinLatencySamples && pixels > 0) {
+		// 每像素纳秒数即每百万像素毫秒数
+		return static_cast<double>(_readNanoseconds) / pixels;
+	}
+	std::lock_guard<std::mutex> l(storageLatencyMutex);
+	std::map<std::string, double>::const_iterator it = storageLatency.find(storageLocation());
+	return it != storageLatency.end() ? it->second : 0.;
+}
+
+/**
+ * @brief 记录一次格式解码的耗时
+ * @param start 开始时间
+ * @param pixels 读取的像素数
+ */
+void MultiResolutionImage::recordReadLatency(std::chrono::steady_clock::time_point start, unsigned long long pixels)
+{
+	if (pixels == 0) {
+		return;
+	}
+	const long long nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	_readNanoseconds += static_cast<unsigned long long>(std::max(0LL, nanoseconds));
+	_readPixels += pixels;
+	if (++_nrReads % kMinLatencySamples == 0) {
+		const double latency = static_cast<double>(_readNanoseconds) / _readPixels;
+		std::lock_guard<std::mutex> l(storageLatencyMutex);
+		storageLatency[storageLocation()] = latency;
+	}
+}
+
+/**
+ * @brief 获取图像所在的存储
+ * @return 文件路径去掉文件名后的部分
+ */
+std::string MultiResolutionImage::storageLocation() const
+{
+	const std::string::size_type separator = m_filePath.find_last_of("/\\");
+	return separator == std::string::npos ? std::string() : m_filePath.substr(0, separator);
+}
+
+/**
+ * @brief 直接读取预乘ARGB32区域
+ * @param startX 起始X坐标
+ * @param startY 起始Y坐标
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @param data 输出缓冲区
+ * @param zPlane Z平面索引
+ * @return 已写入数据时返回true
+ * @details 依次查找解码瓦片缓存、压缩瓦片缓存和磁盘缓存，未命中时由派生类读取并放入缓存。
+ *          虚拟层级由上一个层级的ARGB32象限合成，上一个层级不支持直接读取时返回false
+ */
+bool MultiResolutionImage::getARGB32Region(const long long& startX, const long long& startY, const unsigned long long& width,
+	const unsigned long long& height, const unsigned int& level, unsigned int* data, unsigned int zPlane)
+{
+	if (level >= getNumberOfLevels()) {
+		return false;
+	}
+	zPlane = resolveZPlane(zPlane);
+	const unsigned long long byteSize = width * height * sizeof(unsigned int);
+	TileCache<unsigned char>::keyType key;
+	bool cacheable = decodedTileKey(startX, startY, level, true, zPlane, key);
+	if (cacheable && copyFromDecodedCache(key, data, byteSize)) {
+		return true;
+	}
+	if (cacheable && readFromCompressedCache(key, data, byteSize)) {
+		storeInDecodedCache(key, data, byteSize);
+		return true;
+	}
+	if (cacheable && readFromDiskCache(key, width, height, data, byteSize)) {
+		storeInDecodedCache(key, data, byteSize);
+		return true;
+	}
+	const int nativeLevel = _pyramidLevels[level].nativeLevel;
+	if (nativeLevel >= 0) {
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if (!readARGB32DataFromImage(startX, startY, width, height, static_cast<unsigned int>(nativeLevel), data, zPlane)) {
+			return false;
+		}
+		recordReadLatency(start, width * height);
+	}
+	else {
+		const unsigned int finerLevel = level - 1;
+		// 预乘ARGB按4个8位样本逐通道平均，结果仍是有效的预乘像素
+		bool synthesized = synthesizeVirtualRegion(startX, startY, width, height, level, 4, reinterpret_cast<unsigned char*>(data),
+			[this, finerLevel, zPlane](long long x, long long y, unsigned long long w, unsigned long long h, unsigned char* fine) {
+				return getARGB32Region(x, y, w, h, finerLevel, reinterpret_cast<unsigned int*>(fine), zPlane);
+			});
+		if (!synthesized) {
+			return false;
+		}
+	}
+	if (cacheable) {
+		storeInDecodedCache(key, data, byteSize);
+		writeToDiskCache(key, width, height, data, byteSize);
+	}
+	return true;
+}
+
+/**
+ * @brief 只从内存缓存读取预乘ARGB32区域
+ * @param startX 起始X坐标
+ * @param startY 起始Y坐标
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @param data 输出缓冲区
+ * @param zPlane Z平面索引
+ * @return 命中时返回true
+ * @details 压缩瓦片缓存命中时解压后放回解码瓦片缓存，与getARGB32Region相同
+ */
+bool MultiResolutionImage::getCachedARGB32Region(const long long& startX, const long long& startY, const unsigned long long& width,
+	const unsigned long long& height, const unsigned int& level, unsigned int* data, unsigned int zPlane)
+{
+	TileCache<unsigned char>::keyType key;
+	if (level >= getNumberOfLevels() || !decodedTileKey(startX, startY, level, true, resolveZPlane(zPlane), key)) {
+		return false;
+	}
+	const unsigned long long byteSize = width * height * sizeof(unsigned int);
+	if (copyFromDecodedCache(key, data, byteSize)) {
+		return true;
+	}
+	if (readFromCompressedCache(key, data, byteSize)) {
+		storeInDecodedCache(key, data, byteSize);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * @brief 读取缩小解码的预乘ARGB32预览
+ * @param startX 起始X坐标
+ * @param startY 起始Y坐标
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @param scale 缩小倍数
+ * @param data 输出缓冲区
+ * @param zPlane Z平面索引
+ * @return 已写入预览时返回true
+ * @details 虚拟层级由上一个层级合成，合成需要完整分辨率的数据，不提供预览
+ */
+bool MultiResolutionImage::getPreviewARGB32Region(const long long& startX, const long long& startY, const unsigned long long& width,
+	const unsigned long long& height, const unsigned int& level, unsigned int scale, unsigned int* data, unsigned int zPlane)
+{
+	if (level >= getNumberOfLevels() || scale == 0 || width % scale != 0 || height % scale != 0) {
+		return false;
+	}
+	const int nativeLevel = _pyramidLevels[level].nativeLevel;
+	if (nativeLevel < 0) {
+		return false;
+	}
+	return readPreviewARGB32DataFromImage(startX, startY, width, height, static_cast<unsigned int>(nativeLevel), scale, data, resolveZPlane(zPlane));
+}
+
+/**
+ * @brief 一次读取相邻的多个预乘ARGB32瓦片
+ * @param tileX 第一列瓦片的列号
+ * @param tileY 第一行瓦片的行号
+ * @param tileSize 瓦片大小
+ * @param columns 列数
+ * @param rows 行数
+ * @param level 图像层级
+ * @param tiles 按行排列的输出缓冲区，NULL表示跳过
+ * @param zPlane Z平面索引
+ * @return 所有非NULL缓冲区都已写入时返回true
+ * @details 缓存命中的瓦片直接复制，其余瓦片的包围区域只读取一次，
+ *          拆分后按单个瓦片的缓存键放入解码瓦片缓存和磁盘缓存
+ */
+bool MultiResolutionImage::getARGB32Tiles(const long long& tileX, const long long& tileY, const unsigned int& tileSize, const unsigned int& columns,
+	const unsigned int& rows, const unsigned int& level, const std::vector<unsigned int*>& tiles, unsigned int zPlane)
+{
+	if (level >= getNumberOfLevels() || tiles.size() < static_cast<size_t>(columns) * rows) {
+		return false;
+	}
+	const double levelDownsample = getLevelDownsample(level);
+	std::vector<long long> startX(columns), startY(rows);
+	for (unsigned int c = 0; c < columns; ++c) {
+		startX[c] = std::llround((tileX + c) * levelDownsample * tileSize);
+	}
+	for (unsigned int r = 0; r < rows; ++r) {
+		startY[r] = std::llround((tileY + r) * levelDownsample * tileSize);
+	}
+	const int nativeLevel = _pyramidLevels[level].nativeLevel;
+	if (nativeLevel < 0) {
+		// 虚拟层级由上一个层级合成，没有可以合并的原生区域
+		for (unsigned int r = 0; r < rows; ++r) {
+			for (unsigned int c = 0; c < columns; ++c) {
+				unsigned int* tile = tiles[r * columns + c];
+				if (tile && !getARGB32Region(startX[c], startY[r], tileSize, tileSize, level, tile, zPlane)) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+	zPlane = resolveZPlane(zPlane);
+	const unsigned long long tileBytes = static_cast<unsigned long long>(tileSize) * tileSize * sizeof(unsigned int);
+	std::vector<TileCache<unsigned char>::keyType> keys(tiles.size());
+	std::vector<char> cacheable(tiles.size(), 0), missing(tiles.size(), 0);
+	unsigned int firstColumn = columns, lastColumn = 0, firstRow = rows, lastRow = 0;
+	for (unsigned int r = 0; r < rows; ++r) {
+		for (unsigned int c = 0; c < columns; ++c) {
+			const size_t i = r * columns + c;
+			if (!tiles[i]) {
+				continue;
+			}
+			cacheable[i] = decodedTileKey(startX[c], startY[r], level, true, zPlane, keys[i]);
+			if (cacheable[i]) {
+				if (copyFromDecodedCache(keys[i], tiles[i], tileBytes)) {
+					continue;
+				}
+				if (readFromCompressedCache(keys[i], tiles[i], tileBytes) || readFromDiskCache(keys[i], tileSize, tileSize, tiles[i], tileBytes)) {
+					storeInDecodedCache(keys[i], tiles[i], tileBytes);
+					continue;
+				}
+			}
+			missing[i] = 1;
+			firstColumn = std::min(firstColumn, c);
+			lastColumn = std::max(lastColumn, c);
+			firstRow = std::min(firstRow, r);
+			lastRow = std::max(lastRow, r);
+		}
+	}
+	if (firstColumn == columns) {
+		return true;
+	}
+	const unsigned long long regionColumns = lastColumn - firstColumn + 1;
+	const unsigned long long regionWidth = regionColumns * tileSize;
+	const unsigned long long regionHeight = static_cast<unsigned long long>(lastRow - firstRow + 1) * tileSize;
+	TileBuffer<unsigned int> region(static_cast<size_t>(regionWidth * regionHeight));
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (!readARGB32DataFromImage(startX[firstColumn], startY[firstRow], regionWidth, regionHeight, static_cast<unsigned int>(nativeLevel),
+		region.get(), zPlane)) {
+		return false;
+	}
+	recordReadLatency(start, regionWidth * regionHeight);
+	PipelineProfiler::count(PipelineProfiler::BatchedRegionRead);
+	for (unsigned int r = firstRow; r <= lastRow; ++r) {
+		for (unsigned int c = firstColumn; c <= lastColumn; ++c) {
+			const size_t i = r * columns + c;
+			if (!missing[i]) {
+				continue;
+			}
+			const unsigned int* source = region.get() + (r - firstRow) * tileSize * regionWidth + (c - firstColumn) * tileSize;
+			for (unsigned int y = 0; y < tileSize; ++y) {
+				std::memcpy(tiles[i] + y * tileSize, source + y * regionWidth, tileSize * sizeof(unsigned int));
+			}
+			PipelineProfiler::count(PipelineProfiler::BatchedTileRead);
+			if (cacheable[i]) {
+				storeInDecodedCache(keys[i], tiles[i], tileBytes);
+				writeToDiskCache(keys[i], tileSize, tileSize, tiles[i], tileBytes);
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief 设置磁盘瓦片缓存
+ * @param diskCache 磁盘缓存
+ */
+void MultiResolutionImage::setDiskCache(std::shared_ptr<DiskTileCache> diskCache)
+{
+	m_diskCache = diskCache;
+}
+
+/**
+ * @brief 获取磁盘瓦片缓存
+ * @return 磁盘缓存
+ */
+std::shared_ptr<DiskTileCache> MultiResolutionImage::getDiskCache() const
+{
+	return m_diskCache;
+}
+
+/**
+ * @brief 设置组织掩膜
+ * @param tissueMask 组织掩膜
+ */
+void MultiResolutionImage::setTissueMask(std::shared_ptr<const TissueMask> tissueMask)
+{
+	std::atomic_store(&m_tissueMask, tissueMask);
+}
+
+/**
+ * @brief 获取组织掩膜
+ * @return 组织掩膜
+ */
+std::shared_ptr<const TissueMask> MultiResolutionImage::getTissueMask() const
+{
+	return std::atomic_load(&m_tissueMask);
+}
+
+/**
+ * @brief 设置切片统计
+ * @param statistics 切片统计
+ */
+void MultiResolutionImage::setStatistics(std::shared_ptr<SlideStatistics> statistics)
+{
+	std::atomic_store(&m_statistics, statistics);
+}
+
+/**
+ * @brief 获取切片统计
+ * @return 切片统计
+ */
+std::shared_ptr<SlideStatistics> MultiResolutionImage::getStatistics() const
+{
+	return std::atomic_load(&m_statistics);
+}
+
+/**
+ * @brief 获取通道范围
+ * @param channel 通道索引
+ * @param minValue 输出最小值
+ * @param maxValue 输出最大值
+ */
+void MultiResolutionImage::getChannelRange(int channel, double& minValue, double& maxValue)
+{
+	std::shared_ptr<SlideStatistics> statistics = getStatistics();
+	if (statistics && statistics->getRange(channel, minValue, maxValue)) {
+		return;
+	}
+	minValue = getMinValue(channel);
+	maxValue = getMaxValue(channel);
+}
+
+/**
+ * @brief 从磁盘瓦片缓存读取数据
+ * @param key 缓存键
+ * @param width 瓦片宽度
+ * @param height 瓦片高度
+ * @param data 输出缓冲区
+ * @param byteSize 字节数
+ * @return 命中时返回true
+ */
+bool MultiResolutionImage::readFromDiskCache(const TileCache<unsigned char>::keyType& key, unsigned long long width, unsigned long long height,
+	void* data, unsigned long long byteSize)
+{
+	if (!m_diskCache) {
+		return false;
+	}
+	bool hit = m_diskCache->get(key, static_cast<unsigned int>(width), static_cast<unsigned int>(height), data, byteSize);
+	PipelineProfiler::count(hit ? PipelineProfiler::DiskCacheHit : PipelineProfiler::DiskCacheMiss);
+	return hit;
+}
+
+/**
+ * @brief 从压缩瓦片缓存读取数据
+ * @param key 缓存键
+ * @param data 输出缓冲区
+ * @param byteSize 字节数
+ * @return 命中时返回true
+ */
+bool MultiResolutionImage::readFromCompressedCache(const TileCache<unsigned char>::keyType& key, void* data, unsigned long long byteSize)
+{
+	if (!m_compressedCache) {
+		return false;
+	}
+	bool hit = m_compressedCache->get(key, data, byteSize);
+	PipelineProfiler::count(hit ? PipelineProfiler::CompressedCacheHit : PipelineProfiler::CompressedCacheMiss);
+	return hit;
+}
+
+/**
+ * @brief 按缓存大小计算解码瓦片缓存的上限
+ * @param cacheSize 缓存大小
+ * @return 字节数
+ */
+unsigned long long MultiResolutionImage::decodedCacheBytes(unsigned long long cacheSize)
+{
+	return cacheSize - static_cast<unsigned long long>(cacheSize * kCompressedCacheShare);
+}
+
+/**
+ * @brief 把数据写入磁盘瓦片缓存
+ * @param key 缓存键
+ * @param width 瓦片宽度
+ * @param height 瓦片高度
+ * @param data 数据
+ * @param byteSize 字节数
+ */
+void MultiResolutionImage::writeToDiskCache(const TileCache<unsigned char>::keyType& key, unsigned long long width, unsigned long long height,
+	const void* data, unsigned long long byteSize)
+{
+	if (m_diskCache) {
+		m_diskCache->put(key, static_cast<unsigned int>(width), static_cast<unsigned int>(height), data, byteSize);
+	}
+}
+
+/**
+ * @brief 读取预乘ARGB32数据
+ * @return 基类不支持直接读取，始终返回false
+ * @details 派生类的原生格式为预乘ARGB时重写该函数
+ */
+bool MultiResolutionImage::readARGB32DataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+	const unsigned long long& height, const unsigned int& level, unsigned int* data, const unsigned int& zPlane)
+{
+	return false;
+}
+
+/**
+ * @brief 缩小解码预乘ARGB32数据
+ * @return 基类不支持缩小解码，始终返回false
+ * @details 派生类的原生格式可以廉价地缩小解码时重写该函数
+ */
+bool MultiResolutionImage::readPreviewARGB32DataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+	const unsigned long long& height, const unsigned int& level, unsigned int scale, unsigned int* data, const unsigned int& zPlane)
+{
+	return false;
+}
+
+/**
+ * @brief 把原始数据解码到调用者的缓冲区（默认实现）
+ * @param startX 起始X坐标
+ * @param startY 起始Y坐标
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @param data 输出缓冲区
+ * @param zPlane Z平面索引
+ * @return 读取成功时返回true
+ * @details 调用readDataFromImage后复制，没有重写该函数的派生类仍可使用readRegion；
+ *          readDataFromImage没有Z平面参数，因此只能读取当前Z平面
+ */
+bool MultiResolutionImage::readDataIntoBuffer(const long long& startX, const long long& startY, const unsigned long long& width,
+	const unsigned long long& height, const unsigned int& level, void* data, const unsigned int& zPlane)
+{
+	void* read = readDataFromImage(startX, startY, width, height, level);
+	if (!read) {
+		return false;
+	}
+	std::memcpy(data, read, width * height * getSamplesPerPixel() * bytesPerSample());
+	TileBufferPool::release(read);
+	return true;
+}
+
+/**
+ * @brief 计算较细层级上下一个瓦片的起始坐标
+ * @param start 当前起始坐标
+ * @param extent 一个瓦片在第0层的范围
+ * @return 下一个瓦片的起始坐标
+ * @details 不是瓦片对齐的起点（如区域导出）直接加上范围
+ */
+long long MultiResolutionImage::nextGridStart(const long long& start, double extent)
+{
+	const long long index = std::llround(start / extent);
+	if (std::llround(index * extent) == start) {
+		return std::llround((index + 1) * extent);
+	}
+	return start + std::llround(extent);
+}
+
+/**
+ * @brief 获取原生数据类型的样本字节数
+ * @return 字节数，数据类型未知时返回0
+ */
+unsigned int MultiResolutionImage::bytesPerSample() const
+{
+	if (_dataType == SlideColorManagement::DataType::UChar) {
+		return sizeof(unsigned char);
+	}
+	else if (_dataType == SlideColorManagement::DataType::UInt16) {
+		return sizeof(unsigned short);
+	}
+	else if (_dataType == SlideColorManagement::DataType::UInt32) {
+		return sizeof(unsigned int);
+	}
+	else if (_dataType == SlideColorManagement::DataType::Float) {
+		return sizeof(float);
+	}
+	return 0;
+}
+
+/**
+ * @brief 生成解码瓦片缓存键
+ * @param startX 起始X坐标
+ * @param startY 起始Y坐标
+ * @param level 图像层级
+ * @param argb32 是否为ARGB32数据
+ * @param zPlane Z平面索引
+ * @param key 输出缓存键
+ * @return 坐标可以表示为键时返回true
+ * @details 层级字段的最高位标记ARGB32数据。有多个Z平面时坐标字段的高4位存放Z平面，
+ *          坐标上限降为2^24，否则不同平面的键可能相同
+ */
+bool MultiResolutionImage::decodedTileKey(const long long& startX, const long long& startY, const unsigned int& level, bool argb32,
+	unsigned int zPlane, TileCache<unsigned char>::keyType& key) const
+{
+	const long long maxCoordinate = m_numberOfZPlanes > 1 ? (1LL << 24) : (1LL << 28);
+	if (startX < 0 || startY < 0 || startX >= maxCoordinate || startY >= maxCoordinate || level >= 0x80 || zPlane > 0xFF) {
+		return false;
+	}
+	key = TileCache<unsigned char>::makeKey(static_cast<unsigned int>(startX), static_cast<unsigned int>(startY),
+		argb32 ? (level | 0x80) : level, zPlane);
+	return true;
+}
+
+/**
+ * @brief 从解码瓦片缓存复制数据
+ * @param key 缓存键
+ * @param data 输出缓冲区
+ * @param byteSize 字节数
+ * @return 命中时返回true
+ */
+bool MultiResolutionImage::copyFromDecodedCache(const TileCache<unsigned char>::keyType& key, void* data, unsigned long long byteSize)
+{
+	std::shared_ptr<void> cache = std::atomic_load(&m_cache);
+	if (!cache) {
+		return false;
+	}
+	bool hit = false;
+	if (_dataType == SlideColorManagement::DataType::UInt32) {
+		hit = copyFromTypedCache(static_cast<TileCache<unsigned int>*>(cache.get()), key, data, byteSize);
+	}
+	else if (_dataType == SlideColorManagement::DataType::UInt16) {
+		hit = copyFromTypedCache(static_cast<TileCache<unsigned short>*>(cache.get()), key, data, byteSize);
+	}
+	else if (_dataType == SlideColorManagement::DataType::UChar) {
+		hit = copyFromTypedCache(static_cast<TileCache<unsigned char>*>(cache.get()), key, data, byteSize);
+	}
+	else if (_dataType == SlideColorManagement::DataType::Float) {
+		hit = copyFromTypedCache(static_cast<TileCache<float>*>(cache.get()), key, data, byteSize);
+	}
+	PipelineProfiler::count(hit ? PipelineProfiler::DecodedCacheHit : PipelineProfiler::DecodedCacheMiss);
+	return hit;
+}
+
+/**
+ * @brief 把数据副本放入解码瓦片缓存
+ * @param key 缓存键
+ * @param data 数据
+ * @param byteSize 字节数
+ */
+void MultiResolutionImage::storeInDecodedCache(const TileCache<unsigned char>::keyType& key, const void* data, unsigned long long byteSize)
+{
+	std::shared_ptr<void> cache = std::atomic_load(&m_cache);
+	if (!cache) {
+		return;
+	}
+	if (_dataType == SlideColorManagement::DataType::UInt32) {
+		storeInTypedCache(static_cast<TileCache<unsigned int>*>(cache.get()), key, data, byteSize);
+	}
+	else if (_dataType == SlideColorManagement::DataType::UInt16) {
+		storeInTypedCache(static_cast<TileCache<unsigned short>*>(cache.get()), key, data, byteSize);
+	}
+	else if (_dataType == SlideColorManagement::DataType::UChar) {
+		storeInTypedCache(static_cast<TileCache<unsigned char>*>(cache.get()), key, data, byteSize);
+	}
+	else if (_dataType == SlideColorManagement::DataType::Float) {
+		storeInTypedCache(static_cast<TileCache<float>*>(cache.get()), key, data, byteSize);
+	}
+}
+
 /**
  * @brief 清理资源
  * @details 清理所有成员变量，将对象重置为初始状态
@@ -436,6 +991,9 @@ const std::string MultiResolutionImage::getFileType() const
 void MultiResolutionImage::cleanup()
 {
 	_levelDimensions.clear();
+	_levelTileSizes.clear();
+	_pyramidLevels.clear();
+	std::fill(_sampleConverters, _sampleConverters + kNumberOfSampleConverters, PixelConversion::SampleConverter());
 	_spacing.clear();
 	_samplesPerPixel = 0;
 	_numberOfLevels = 0;
@@ -444,4 +1002,6 @@ void MultiResolutionImage::cleanup()
 	_isValid = false;
 	 _fileType = "";
 	m_filePath = "";
+	std::atomic_store(&m_tissueMask, std::shared_ptr<const TissueMask>());
+	std::atomic_store(&m_statistics, std::shared_ptr<SlideStatistics>());
 }
@@ -23,8 +23,21 @@
 #include <mutex>
 #include <shared_mutex>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <type_traits>
 #include "TileCache.hpp"
+#include "CompressedTileCache.h"
 #include "Patch.h"
+#include "PipelineProfiler.h"
+#include "PixelConversion.h"
+#include "TileBufferPool.h"
+
+class DiskTileCache;
+class SlideStatistics;
+class TissueMask;
 
  /**
   * @class  MultiResolutionImage
@@ -48,7 +61,8 @@
   *              auto dimensions = img->getDimensions();
   *              auto levels = img->getNumberOfLevels();
   *              // 获取图像数据
-  *              unsigned char* data = new unsigned char[width * height * 3];
+  *              TileBuffer<unsigned char> buffer(width * height * 3);
+  *              unsigned char* data = buffer.get();
   *              img->getRawRegion<unsigned char>(0, 0, width, height, 0, data);
   *          }
   * @see     ImageSource, OpenSlideImage, TileCache
@@ -109,13 +123,17 @@ public:
 
     /**
      * @brief   设置当前Z平面索引
-     * @details 设置当前要访问的Z平面索引
+     * @details 设置当前要访问的Z平面索引，即读取函数的zPlane参数为kCurrentZPlane时读取的平面。
+     *          缓存键包含Z平面，切换Z平面不清空缓存，已缓存的其他平面的瓦片继续有效
      *
      * @param   zPlaneIndex Z平面索引
      * @note    索引必须在有效范围内（0到getNumberOfZPlanes()-1）
      */
     void setCurrentZPlaneIndex(const unsigned int& zPlaneIndex);
 
+    /** @brief 读取函数的zPlane参数取该值时读取当前Z平面 */
+    static const unsigned int kCurrentZPlane = 0xFFFFFFFF;
+
     /**
      * @brief   获取当前Z平面索引
      * @details 获取当前正在访问的Z平面索引
@@ -144,22 +162,51 @@ public:
 
     /**
      * @brief   设置缓存大小
-     * @details 设置图像缓存的最大大小，影响内存使用和性能
+     * @details 设置图像缓存的最大大小，影响内存使用和性能。
+     *          其中kCompressedCacheShare划给压缩瓦片缓存，其余给解码瓦片缓存
      *
      * @param   cacheSize 新的缓存大小（字节）
      * @note    较大的缓存可以提高访问速度，但会增加内存使用
      */
     virtual void setCacheSize(const unsigned long long cacheSize);
 
+    /**
+     * @brief   获取解码瓦片缓存和压缩瓦片缓存当前占用的字节数
+     * @return  字节数，缓存未创建时为0
+     * @see     MemoryGovernor
+     */
+    unsigned long long getCacheUsage();
+
+    /**
+     * @brief   获取实测的读取延迟
+     * @details 统计派生类格式解码（readDataIntoBuffer、readARGB32DataFromImage）的耗时，不含各级缓存命中。
+     *          本图像的读取次数不足kMinLatencySamples时返回同一目录（或远程地址）中此前图像的实测值，
+     *          打开同一存储上的下一张切片时即可参考
+     * @return  每百万像素的平均读取时间（毫秒），没有任何实测值时返回0
+     * @see     TileManager::levelTileSizes
+     */
+    double getReadLatency() const;
+
     /**
      * @brief   获取层级数量
      * @details 获取多分辨率图像中不同缩放级别的数量
      *
-     * @return  层级数量
+     * @return  层级数量，包含在稀疏金字塔中合成的虚拟层级
      * @note    层级0通常是最高分辨率，层级数越大分辨率越低
+     * @see     isVirtualLevel
      */
     virtual const int getNumberOfLevels() const;
 
+    /**
+     * @brief   判断层级是否为虚拟层级
+     * @details 虚拟层级不在文件中，其瓦片由上一个（更高分辨率的）层级的瓦片按2x2盒式滤波合成，
+     *          合成结果与原生层级的瓦片一样放入解码瓦片缓存
+     *
+     * @param   level 层级索引
+     * @return  虚拟层级返回true，原生层级或层级无效时返回false
+     */
+    bool isVirtualLevel(const unsigned int& level) const;
+
     /**
      * @brief   获取图像尺寸
      * @details 获取原始图像（最高分辨率）的尺寸信息
@@ -189,6 +236,16 @@ public:
      */
     virtual const double getLevelDownsample(const unsigned int& level) const;
 
+    /**
+     * @brief   获取层级的原生瓦片尺寸
+     * @details 文件中按瓦片（或DICOM帧）存储时返回单个压缩瓦片的尺寸。
+     *          读取与原生瓦片网格对齐、大小相同的区域时只需解码一个瓦片
+     *
+     * @param   level 层级索引
+     * @return  原生瓦片尺寸[宽度, 高度]，格式不分块或未知时返回空向量
+     */
+    virtual const std::vector<unsigned long long> getLevelTileSize(const unsigned int& level) const;
+
     /**
      * @brief   获取最佳层级
      * @details 根据目标下采样因子找到最合适的层级
@@ -236,6 +293,16 @@ public:
      */
     virtual const QImage getLabel() = 0;
 
+    /**
+     * @brief   获取关联图像
+     * @details 获取切片文件中与金字塔一同保存的图像，如"label"、"macro"、"thumbnail"
+     *
+     * @param   name 关联图像名称
+     * @return  QImage格式的关联图像，不存在时返回空图像
+     * @note    默认只支持"label"（即getLabel），派生类可根据文件格式重写
+     */
+    virtual const QImage getAssociatedImage(const std::string& name) { return name == "label" ? getLabel() : QImage(); }
+
     /**
      * @brief   获取图像属性列表（纯虚函数）
      * @details 获取图像的所有元数据属性
@@ -245,6 +312,25 @@ public:
      */
     virtual const std::vector<SlideColorManagement::PropertyInfo> getProperties() = 0;
 
+    /**
+     * @brief   获取切片背景色
+     * @details 扫描区域以外和玻片区域的颜色，用于组织掩膜判定和背景瓦片的合成
+     *
+     * @param   r 输出红色分量
+     * @param   g 输出绿色分量
+     * @param   b 输出蓝色分量
+     * @note    默认为白色，派生类可根据文件元数据重写
+     */
+    virtual void getBackgroundColor(unsigned char& r, unsigned char& g, unsigned char& b) const { r = 255; g = 255; b = 255; }
+
+    /**
+     * @brief   获取切片的ICC颜色配置文件
+     * @return  配置文件的原始字节，文件未嵌入配置文件时为空
+     * @details 像素数据处于扫描仪的设备颜色空间，IOThread据此编译到sRGB的3D查找表
+     * @see     IccProfile::compileToSRGB
+     */
+    virtual std::vector<unsigned char> getICCProfile() { return std::vector<unsigned char>(); }
+
     /**
      * @brief   获取图像块数据
      * @details 获取指定区域的图像数据，返回Patch对象
@@ -274,8 +360,8 @@ public:
         dims[1] = height;
         dims[2] = _samplesPerPixel;
 
-        // 分配内存并获取原始数据
-        T* data = new T[width * height * _samplesPerPixel];
+        // 从瓦片缓冲区池分配内存并获取原始数据，由Patch负责归还
+        T* data = TileBufferPool::allocateArray<T>(width * height * _samplesPerPixel);
         getRawRegion<T>(startX, startY, width, height, level, data);
 
         // 计算图像块的物理间距
@@ -312,48 +398,241 @@ public:
      * @param   height 区域高度
      * @param   level 层级索引
      * @param   data 输出数据指针，调用者负责分配足够的内存
-     * @note    调用者必须确保data指针指向足够大的内存空间
-     * @see     readDataFromImage
+     * @param   zPlane Z平面索引，默认读取当前Z平面
+     * @note    调用者必须确保data指针指向足够大的内存空间；数据总是复制到data中，不会替换该指针
+     * @see     readDataFromImage, TileBufferPool
      * @example
      *          // 使用示例
-     *          unsigned char* data = new unsigned char[width * height * 3];
+     *          TileBuffer<unsigned char> buffer(width * height * 3);
+     *          unsigned char* data = buffer.get();
      *          img->getRawRegion<unsigned char>(0, 0, width, height, 0, data);
-     *          // 使用数据...
-     *          delete[] data;
+     *          // 使用数据...，buffer析构时归还
      */
     template <typename T>
     void getRawRegion(const long long& startX, const long long& startY, const unsigned long long& width,
-        const unsigned long long& height, const unsigned int& level, T*& data) {
-        // 检查层级索引是否有效
-        if (level >= getNumberOfLevels()) {
-            return;
-        }
-
-        unsigned int nrSamples = getSamplesPerPixel();
+        const unsigned long long& height, const unsigned int& level, T*& data, unsigned int zPlane = kCurrentZPlane) {
+        readRegion<T>(startX, startY, width, height, level, data, 0, zPlane);
+    }
 
-        // 根据图像数据类型进行相应的处理
-        if (this->getDataType() == SlideColorManagement::DataType::Float) {
-            float* temp = (float*)readDataFromImage(startX, startY, width, height, level);
-            std::copy(temp, temp + width * height * nrSamples, data);
-            delete[] temp;
-        }
-        else if (this->getDataType() == SlideColorManagement::DataType::UChar) {
-            unsigned char* temp = (unsigned char*)readDataFromImage(startX, startY, width, height, level);
-            std::copy(temp, temp + width * height * nrSamples, data);
-            delete[] temp;
+    /**
+     * @brief   读取区域数据到调用者的缓冲区
+     * @details 按图像的原生数据类型读取，再在编译期选择的转换内核中转换为T：
+     *          - 解码瓦片缓存命中时在分片锁内直接从缓存转换到data（通过图像初始化时解析的转换内核）
+     *          - 未命中且T与原生类型相同、data紧密排列时，磁盘缓存和格式解码直接写入data
+     *          - 其余情况解码到一个池缓冲区后转换
+     *          不分配也不替换调用者的缓冲区。
+     *
+     * @tparam  T 目标数据类型
+     * @param   startX 起始X坐标（第0层像素）
+     * @param   startY 起始Y坐标（第0层像素）
+     * @param   width 区域宽度
+     * @param   height 区域高度
+     * @param   level 层级索引
+     * @param   data 输出缓冲区，至少height行，每行width*samplesPerPixel个样本
+     * @param   rowStride 输出缓冲区每行的样本跨距，0表示紧密排列
+     * @param   zPlane Z平面索引，默认读取当前Z平面
+     * @return  层级无效、数据类型未知或读取失败时返回false
+     * @note    读取失败时8位RGB图像的输出填充为白色背景，与getARGB32Region一致
+     * @see     getRawRegion, readDataIntoBuffer, PixelConversion::sampleConverter
+     * @example
+     *          // 使用示例：把瓦片写入更大画布的一个位置
+     *          img->readRegion<unsigned char>(x, y, 512, 512, 0, canvas + (row * canvasWidth + col) * 3, canvasWidth * 3);
+     */
+    template <typename T>
+    bool readRegion(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, T* data, unsigned long long rowStride = 0,
+        unsigned int zPlane = kCurrentZPlane) {
+        PipelineProfiler::ScopedTimer timer(PipelineProfiler::GetRawRegion);
+        if (!data || level >= getNumberOfLevels()) {
+            return false;
         }
-        else if (this->getDataType() == SlideColorManagement::DataType::UInt16) {
-            unsigned short* temp = (unsigned short*)readDataFromImage(startX, startY, width, height, level);
-            std::copy(temp, temp + width * height * nrSamples, data);
-            delete[] temp;
+        const bool read = readNativeRegionAs(startX, startY, width, height, level, data, rowStride, resolveZPlane(zPlane), false);
+        if (!read && this->getDataType() == SlideColorManagement::DataType::UChar) {
+            // 如果读取失败，填充背景色
+            const unsigned long long rowSamples = width * getSamplesPerPixel();
+            const unsigned long long stride = rowStride ? rowStride : rowSamples;
+            for (unsigned long long y = 0; y < height; ++y) {
+                std::fill(data + y * stride, data + y * stride + rowSamples, static_cast<T>(255));
+            }
         }
-        else if (this->getDataType() == SlideColorManagement::DataType::UInt32) {
-            unsigned int* temp = (unsigned int*)readDataFromImage(startX, startY, width, height, level);
-            std::copy(temp, temp + width * height * nrSamples, data);
-            delete[] temp;
+        return read;
+    }
+
+    /**
+     * @brief   只从内存缓存读取区域数据
+     * @details 与readRegion使用相同的缓存键和转换内核，但只查找解码瓦片缓存和压缩瓦片缓存；
+     *          未命中时不读取磁盘缓存，也不解码，输出缓冲区保持不变。
+     *          用于只需要重新处理已驻留瓦片的场合，例如调整显示增强参数
+     *
+     * @tparam  T 目标数据类型
+     * @param   startX 起始X坐标（第0层像素）
+     * @param   startY 起始Y坐标（第0层像素）
+     * @param   width 区域宽度
+     * @param   height 区域高度
+     * @param   level 层级索引
+     * @param   data 输出缓冲区，紧密排列
+     * @param   zPlane Z平面索引，默认读取当前Z平面
+     * @return  命中时返回true
+     * @see     readRegion, getCachedARGB32Region
+     */
+    template <typename T>
+    bool readCachedRegion(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, T* data, unsigned int zPlane = kCurrentZPlane) {
+        if (!data || level >= getNumberOfLevels()) {
+            return false;
         }
+        return readNativeRegionAs(startX, startY, width, height, level, data, 0, resolveZPlane(zPlane), true);
     }
 
+    /**
+     * @brief   直接读取预乘ARGB32格式的区域数据
+     * @details 将指定区域以QImage::Format_ARGB32_Premultiplied的内存布局直接写入调用者的缓冲区，
+     *          不经过RGB中间缓冲和格式转换。调用者通常传入QImage::bits()，
+     *          从而省去读取瓦片时的额外分配和整块拷贝。
+     *
+     * @param   startX 起始X坐标（第0层像素）
+     * @param   startY 起始Y坐标（第0层像素）
+     * @param   width 区域宽度
+     * @param   height 区域高度
+     * @param   level 层级索引
+     * @param   data 输出缓冲区，至少width*height个32位像素，行间无填充
+     * @param   zPlane Z平面索引，默认读取当前Z平面
+     * @return  true表示已写入数据；false表示该格式不支持直接读取，调用者应回退到getRawRegion
+     * @note    依次查找解码瓦片缓存、压缩瓦片缓存和磁盘缓存，未命中时调用readARGB32DataFromImage并把结果放入缓存
+     * @see     getRawRegion, readARGB32DataFromImage
+     */
+    bool getARGB32Region(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, unsigned int* data, unsigned int zPlane = kCurrentZPlane);
+
+    /**
+     * @brief   一次读取相邻的多个预乘ARGB32瓦片
+     * @details 瓦片(tileX+c, tileY+r)的起点为llround((tileX+c)*levelDownsample*tileSize)，与IOWorker的瓦片网格一致。
+     *          逐个瓦片查找缓存，未命中的瓦片合并为一次包围区域的readARGB32DataFromImage，
+     *          再按瓦片拆分写入各自的缓冲区，并以单个瓦片的缓存键放入缓存，之后getARGB32Region读取这些瓦片时直接命中。
+     *          虚拟层级逐个瓦片调用getARGB32Region
+     *
+     * @param   tileX 第一列瓦片的列号
+     * @param   tileY 第一行瓦片的行号
+     * @param   tileSize 瓦片大小（层级像素）
+     * @param   columns 列数
+     * @param   rows 行数
+     * @param   level 层级索引
+     * @param   tiles 按行排列的columns*rows个输出缓冲区，每个至少tileSize*tileSize个32位像素，NULL表示跳过该瓦片
+     * @param   zPlane Z平面索引，默认读取当前Z平面
+     * @return  true表示所有非NULL缓冲区都已写入；false表示该格式不支持直接读取，调用者应逐个瓦片回退
+     * @see     getARGB32Region
+     */
+    bool getARGB32Tiles(const long long& tileX, const long long& tileY, const unsigned int& tileSize, const unsigned int& columns,
+        const unsigned int& rows, const unsigned int& level, const std::vector<unsigned int*>& tiles, unsigned int zPlane = kCurrentZPlane);
+
+    /**
+     * @brief   只从内存缓存读取预乘ARGB32区域
+     * @details 与getARGB32Region使用相同的缓存键，只查找解码瓦片缓存和压缩瓦片缓存，
+     *          未命中时不读取磁盘缓存，也不调用readARGB32DataFromImage
+     *
+     * @param   startX 起始X坐标（第0层像素）
+     * @param   startY 起始Y坐标（第0层像素）
+     * @param   width 区域宽度
+     * @param   height 区域高度
+     * @param   level 层级索引
+     * @param   data 输出缓冲区，至少width*height个32位像素
+     * @param   zPlane Z平面索引，默认读取当前Z平面
+     * @return  命中时返回true
+     * @see     getARGB32Region, readCachedRegion
+     */
+    bool getCachedARGB32Region(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, unsigned int* data, unsigned int zPlane = kCurrentZPlane);
+
+    /**
+     * @brief   读取缩小解码的预乘ARGB32预览
+     * @details 用于在完整解码之前先显示瓦片。只有原生层级并且派生类支持缩小解码时可用，
+     *          结果不放入任何缓存，之后的getARGB32Region仍按完整分辨率读取
+     *
+     * @param   startX 起始X坐标（第0层像素）
+     * @param   startY 起始Y坐标（第0层像素）
+     * @param   width 区域宽度（层级像素）
+     * @param   height 区域高度（层级像素）
+     * @param   level 层级索引
+     * @param   scale 缩小倍数，输出为(width / scale) x (height / scale)
+     * @param   data 输出缓冲区
+     * @param   zPlane Z平面索引，默认读取当前Z平面
+     * @return  已写入预览时返回true；虚拟层级或格式不支持时返回false
+     * @see     readPreviewARGB32DataFromImage, IOThread::kPreviewScale
+     */
+    bool getPreviewARGB32Region(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, unsigned int scale, unsigned int* data, unsigned int zPlane = kCurrentZPlane);
+
+    /**
+     * @brief   设置磁盘瓦片缓存
+     * @details 磁盘缓存位于解码瓦片缓存之下：内存未命中时先查找磁盘，
+     *          从图像解码的瓦片同时写入磁盘，下次打开同一切片时直接读取
+     *
+     * @param   diskCache 磁盘缓存，空指针表示不使用
+     * @note    应在开始读取瓦片之前设置，通常由MultiResolutionImageFactory::openImage设置
+     * @see     DiskTileCache
+     */
+    void setDiskCache(std::shared_ptr<DiskTileCache> diskCache);
+
+    /**
+     * @brief   获取磁盘瓦片缓存
+     * @return  磁盘缓存，未设置时为空指针
+     */
+    std::shared_ptr<DiskTileCache> getDiskCache() const;
+
+    /**
+     * @brief   获取磁盘缓存身份
+     * @details 没有本地文件的后端（如远程切片）返回能唯一标识切片内容的字符串，
+     *          MultiResolutionImageFactory按该身份而不是文件信息打开磁盘缓存
+     *
+     * @return  缓存身份，默认返回空字符串，表示按文件路径、大小和修改时间识别
+     * @see     DiskTileCache::openIdentity
+     */
+    virtual std::string cacheIdentity() const { return std::string(); }
+
+    /**
+     * @brief   设置组织掩膜
+     * @details 掩膜中没有组织的瓦片由IOWorker直接用背景色合成，PrefetchThread跳过预取
+     *
+     * @param   tissueMask 组织掩膜，空指针表示所有瓦片都按组织处理
+     * @note    可在任意线程中调用，通常由SlideLoader在读取缩略图后设置
+     * @see     TissueMask
+     */
+    void setTissueMask(std::shared_ptr<const TissueMask> tissueMask);
+
+    /**
+     * @brief   获取组织掩膜
+     * @return  组织掩膜，尚未计算时为空指针
+     */
+    std::shared_ptr<const TissueMask> getTissueMask() const;
+
+    /**
+     * @brief   设置切片统计
+     * @details 统计由后台任务和IOWorker加载的瓦片逐步完善，getChannelRange据此给出通道范围
+     *
+     * @param   statistics 切片统计，空指针表示没有统计
+     * @note    可在任意线程中调用，通常由SlideLoader在读取缩略图后设置
+     * @see     SlideStatistics
+     */
+    void setStatistics(std::shared_ptr<SlideStatistics> statistics);
+
+    /**
+     * @brief   获取切片统计
+     * @return  切片统计，没有时为空指针
+     */
+    std::shared_ptr<SlideStatistics> getStatistics() const;
+
+    /**
+     * @brief   获取通道范围
+     * @details 切片统计已有完整层级时返回该层级的最小值和最大值，
+     *          否则返回getMinValue和getMaxValue。相对LUT和窗宽窗位按该范围归一化
+     *
+     * @param   channel 通道索引，-1表示所有通道
+     * @param   minValue 输出最小值
+     * @param   maxValue 输出最大值
+     * @see     SlideStatistics::getRange
+     */
+    void getChannelRange(int channel, double& minValue, double& maxValue);
+
 protected:
     // 线程安全相关成员
     /**
@@ -372,23 +651,78 @@ protected:
 
     /**
      * @brief 缓存对象
-     * @details 指向任意类型的void*的shared_ptr，实现一个通用的缓存接口，
-     *          支持多线程共享访问缓存对象
+     * @details 解码瓦片缓存，实际类型为TileCache<T>，T为图像的原生数据类型。
+     *          同时存放原生数据和ARGB32数据（以键区分），按字节预算淘汰。
+     *          读取线程通过std::atomic_load获取，setCacheSize和initialize在m_cacheMutex下替换
      */
     std::shared_ptr<void> m_cache;
 
+    /** @brief 磁盘瓦片缓存，可为空 */
+    std::shared_ptr<DiskTileCache> m_diskCache;
+
+    /** @brief 组织掩膜，通过std::atomic_load/std::atomic_store在线程间读写 */
+    std::shared_ptr<const TissueMask> m_tissueMask;
+
+    /** @brief 切片统计，通过std::atomic_load/std::atomic_store在线程间读写 */
+    std::shared_ptr<SlideStatistics> m_statistics;
+
+    /**
+     * @brief 内存压缩瓦片缓存
+     * @details 位于解码瓦片缓存与磁盘缓存之间，保存从m_cache淘汰的瓦片；
+     *          在initialize中创建，占缓存大小的kCompressedCacheShare
+     */
+    std::shared_ptr<CompressedTileCache> m_compressedCache;
+
+    /** @brief 缓存大小中划给压缩瓦片缓存的比例 */
+    static const double kCompressedCacheShare;
+
+    /** @brief 有多个Z平面时，每个平面最多占用解码瓦片缓存的比例 */
+    static const double kZPlaneCacheShare;
+
     // 图像数据相关成员
     /** @brief 各层级的图像尺寸，每个元素包含[宽度, 高度] */
     std::vector<std::vector<unsigned long long> > _levelDimensions;
 
+    /** @brief 各层级的原生瓦片尺寸，每个元素包含[宽度, 高度]，未知时为空向量 */
+    std::vector<std::vector<unsigned long long> > _levelTileSizes;
+
+    /**
+     * @brief 逻辑层级
+     * @details 派生类只填写_levelDimensions等原生层级信息，对外的层级索引指向_pyramidLevels。
+     *          虚拟层级的下采样因子总是上一个层级的2倍，读取时由上一个层级合成
+     */
+    struct PyramidLevel {
+        std::vector<unsigned long long> dimensions; ///< 层级尺寸[宽度, 高度]
+        double downsample;                          ///< 相对第0层的下采样因子
+        int nativeLevel;                            ///< 派生类的层级索引，虚拟层级为-1
+    };
+
+    /** @brief 逻辑层级表，在initialize中由buildPyramidLevels生成 */
+    std::vector<PyramidLevel> _pyramidLevels;
+
+    /** @brief 相邻层级下采样因子之比超过该值时按2倍插入虚拟层级 */
+    static const double kMaxLevelGap;
+
+    /** @brief 最低分辨率层级的长边超过该值时在末尾追加虚拟层级，使缩略图层级的瓦片数有限 */
+    static const unsigned long long kMaxCoarsestLevelSize = 4096;
+
+    /** @brief 转换内核表的目标类型数量，与SlideColorManagement::DataType的枚举值一致 */
+    static const unsigned int kNumberOfSampleConverters = 5;
+
+    /**
+     * @brief 原生类型到各目标类型的样本转换内核
+     * @details 按目标DataType索引，initialize成功后由PixelConversion::sampleConverter解析，cleanup时清空
+     */
+    PixelConversion::SampleConverter _sampleConverters[kNumberOfSampleConverters];
+
     /** @brief 层级数量 */
     unsigned int _numberOfLevels;
 
     /** @brief Z平面数量 */
     unsigned int m_numberOfZPlanes;
 
-    /** @brief 当前Z平面索引 */
-    unsigned int m_currentZPlaneIndex;
+    /** @brief 当前Z平面索引，读取线程可在不加锁的情况下读取 */
+    std::atomic<unsigned int> m_currentZPlaneIndex;
 
     /** @brief 图像属性信息列表 */
     std::vector<SlideColorManagement::PropertyInfo> _properties;
@@ -402,6 +736,33 @@ protected:
     /** @brief 文件路径 */
     std::string m_filePath;
 
+    /**
+     * @brief   记录一次格式解码的耗时
+     * @param   start 开始时间
+     * @param   pixels 读取的像素数
+     * @details 每kMinLatencySamples次读取把本图像的平均值登记为所在存储的实测值
+     * @see     getReadLatency
+     */
+    void recordReadLatency(std::chrono::steady_clock::time_point start, unsigned long long pixels);
+
+    /**
+     * @brief   获取图像所在的存储
+     * @return  文件路径去掉文件名后的部分
+     */
+    std::string storageLocation() const;
+
+    /** @brief 格式解码的累计耗时（纳秒） */
+    std::atomic<unsigned long long> _readNanoseconds;
+
+    /** @brief 格式解码的累计像素数 */
+    std::atomic<unsigned long long> _readPixels;
+
+    /** @brief 格式解码次数 */
+    std::atomic<unsigned int> _nrReads;
+
+    /** @brief 读取延迟以本图像实测值为准所需的最少读取次数 */
+    static const unsigned int kMinLatencySamples = 8;
+
     /**
      * @brief   清理资源（虚函数）
      * @details 清理图像相关的资源，如文件句柄、缓存等
@@ -409,6 +770,14 @@ protected:
      */
     virtual void cleanup();
 
+    /**
+     * @brief   生成逻辑层级表
+     * @details 依次加入原生层级，与上一个层级的下采样因子之比超过kMaxLevelGap时先按2倍插入虚拟层级；
+     *          最后一个层级的长边超过kMaxCoarsestLevelSize时继续按2倍追加虚拟层级
+     * @note    在initializeType成功后调用
+     */
+    void buildPyramidLevels();
+
     /**
      * @brief   从图像读取数据（纯虚函数）
      * @details 从图像中读取指定区域的原始数据
@@ -417,53 +786,447 @@ protected:
      * @param   startY 起始Y坐标
      * @param   width 区域宽度
      * @param   height 区域高度
-     * @param   level 层级索引
-     * @return  指向原始数据的void指针，调用者负责释放内存
+     * @param   level 原生层级索引（_levelDimensions的下标），不是逻辑层级
+     * @return  指向原始数据的void指针，必须从TileBufferPool分配，调用者用TileBufferPool::release释放
      * @note    该函数是纯虚函数，必须由派生类实现
      */
     virtual void* readDataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
         const unsigned long long& height, const unsigned int& level) = 0;
 
+    /**
+     * @brief   直接读取预乘ARGB32数据（虚函数）
+     * @details 由原生数据为预乘ARGB的派生类重写，输出布局与QImage::Format_ARGB32_Premultiplied相同
+     *
+     * @param   startX 起始X坐标
+     * @param   startY 起始Y坐标
+     * @param   width 区域宽度
+     * @param   height 区域高度
+     * @param   level 原生层级索引
+     * @param   data 输出缓冲区，至少width*height个32位像素
+     * @param   zPlane Z平面索引，只有一个Z平面的格式忽略该参数
+     * @return  true表示已写入数据
+     * @note    默认实现返回false
+     * @see     getARGB32Region, OpenSlideImage::readARGB32DataFromImage
+     */
+    virtual bool readARGB32DataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, unsigned int* data, const unsigned int& zPlane);
+
+    /**
+     * @brief   缩小解码预乘ARGB32数据（虚函数）
+     * @details 由可以廉价地缩小解码的派生类重写（如JPEG的DCT缩放），参数与readARGB32DataFromImage相同，
+     *          输出为(width / scale) x (height / scale)
+     *
+     * @param   scale 缩小倍数
+     * @return  true表示已写入数据
+     * @note    默认实现返回false
+     * @see     getPreviewARGB32Region, TiledTiffImage::readPreviewARGB32DataFromImage
+     */
+    virtual bool readPreviewARGB32DataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, unsigned int scale, unsigned int* data, const unsigned int& zPlane);
+
+    /**
+     * @brief   把原始数据解码到调用者的缓冲区（虚函数）
+     * @details 与readDataFromImage读取相同的数据，但写入data而不是返回新缓冲区，
+     *          readRegion在缓存未命中时调用该函数
+     *
+     * @param   startX 起始X坐标（第0层像素）
+     * @param   startY 起始Y坐标（第0层像素）
+     * @param   width 区域宽度
+     * @param   height 区域高度
+     * @param   level 原生层级索引
+     * @param   data 输出缓冲区，紧密排列的width*height*samplesPerPixel个原生类型样本
+     * @param   zPlane Z平面索引，只有一个Z平面的格式忽略该参数
+     * @return  读取成功时返回true
+     * @note    默认实现调用readDataFromImage并复制，只能读取当前Z平面；派生类应重写以直接解码
+     * @see     readRegion, readDataFromImage
+     */
+    virtual bool readDataIntoBuffer(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, void* data, const unsigned int& zPlane);
+
+    /**
+     * @brief   获取原生数据类型的样本字节数
+     * @return  数据类型未知时返回0
+     */
+    unsigned int bytesPerSample() const;
+
+    /**
+     * @brief   计算较细层级上下一个瓦片的起始坐标
+     * @details IOWorker按 llround(瓦片索引 * 范围) 计算瓦片起点。start可由此还原出索引时按同一公式取下一个起点，
+     *          使合成虚拟瓦片时读取的象限与较细层级的瓦片使用相同的缓存键
+     *
+     * @param   start 当前起始坐标（第0层像素）
+     * @param   extent 一个瓦片在第0层的范围
+     * @return  下一个瓦片的起始坐标（第0层像素）
+     */
+    static long long nextGridStart(const long long& start, double extent);
+
+    /**
+     * @brief   2x2盒式滤波下采样
+     * @tparam  S 样本类型，整数类型四舍五入
+     * @param   fine 输入数据，紧密排列
+     * @param   fineWidth 输入宽度，偶数
+     * @param   fineHeight 输入高度，偶数
+     * @param   samples 每像素样本数
+     * @param   out 输出数据
+     * @param   outRowSamples 输出缓冲区每行的样本跨距
+     */
+    template <typename S> static void downsampleBox2x(const S* fine, unsigned long long fineWidth, unsigned long long fineHeight,
+        unsigned int samples, S* out, unsigned long long outRowSamples) {
+        typedef typename std::conditional<std::is_floating_point<S>::value, double, unsigned long long>::type Accumulator;
+        const Accumulator bias = std::is_floating_point<S>::value ? 0 : 2;
+        const unsigned long long fineRowSamples = fineWidth * samples;
+        for (unsigned long long y = 0; y < fineHeight / 2; ++y) {
+            const S* top = fine + 2 * y * fineRowSamples;
+            const S* bottom = top + fineRowSamples;
+            S* row = out + y * outRowSamples;
+            for (unsigned long long x = 0; x < fineWidth / 2; ++x) {
+                for (unsigned int s = 0; s < samples; ++s) {
+                    const unsigned long long left = 2 * x * samples + s;
+                    const Accumulator sum = static_cast<Accumulator>(top[left]) + top[left + samples] + bottom[left] + bottom[left + samples];
+                    row[x * samples + s] = static_cast<S>((sum + bias) / 4);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief   由上一个层级合成虚拟层级的区域
+     * @details 输出按2x2分为四个象限，每个象限对应上一个层级上一块宽高加倍的区域。
+     *          瓦片对齐的读取中每个象限恰好是上一个层级的一个瓦片，
+     *          经readFiner读取时命中该层级的解码瓦片缓存，未命中时递归合成或解码
+     *
+     * @tparam  S 样本类型
+     * @tparam  Reader 读取函数，签名为bool(long long x, long long y, unsigned long long w, unsigned long long h, S* data)，
+     *          在上一个层级读取紧密排列的区域
+     * @param   startX 起始X坐标（第0层像素）
+     * @param   startY 起始Y坐标（第0层像素）
+     * @param   width 区域宽度
+     * @param   height 区域高度
+     * @param   level 虚拟层级索引，大于0
+     * @param   samples 每像素样本数
+     * @param   data 输出缓冲区，紧密排列
+     * @param   readFiner 读取函数
+     * @return  任一象限读取失败时返回false
+     */
+    template <typename S, typename Reader> bool synthesizeVirtualRegion(const long long& startX, const long long& startY,
+        const unsigned long long& width, const unsigned long long& height, const unsigned int& level, unsigned int samples, S* data,
+        Reader readFiner) {
+        const unsigned long long outWidths[2] = { (width + 1) / 2, width / 2 };
+        const unsigned long long outHeights[2] = { (height + 1) / 2, height / 2 };
+        const double fineDownsample = _pyramidLevels[level - 1].downsample;
+        const long long fineX[2] = { startX, nextGridStart(startX, 2 * outWidths[0] * fineDownsample) };
+        const long long fineY[2] = { startY, nextGridStart(startY, 2 * outHeights[0] * fineDownsample) };
+        TileBuffer<S> fine(4 * outWidths[0] * outHeights[0] * samples);
+        for (unsigned int qy = 0; qy < 2; ++qy) {
+            for (unsigned int qx = 0; qx < 2; ++qx) {
+                if (outWidths[qx] == 0 || outHeights[qy] == 0) {
+                    continue;
+                }
+                if (!readFiner(fineX[qx], fineY[qy], 2 * outWidths[qx], 2 * outHeights[qy], fine.get())) {
+                    return false;
+                }
+                downsampleBox2x(fine.get(), 2 * outWidths[qx], 2 * outHeights[qy], samples,
+                    data + (qy * outHeights[0] * width + qx * outWidths[0]) * samples, width * samples);
+            }
+        }
+        PipelineProfiler::count(PipelineProfiler::VirtualLevelTileSynthesized);
+        return true;
+    }
+
+    /**
+     * @brief   把zPlane参数换算为有效的Z平面索引
+     * @param   zPlane Z平面索引或kCurrentZPlane
+     * @return  kCurrentZPlane换算为当前Z平面，超出范围时取最后一个平面
+     */
+    unsigned int resolveZPlane(unsigned int zPlane) const;
+
+    /**
+     * @brief   生成解码瓦片缓存键
+     * @details 以第0层起始坐标、层级和Z平面作为键，ARGB32数据与原生数据使用不同的键。
+     *          区域尺寸不在键中，命中时通过字节数校验
+     *
+     * @param   startX 起始X坐标
+     * @param   startY 起始Y坐标
+     * @param   level 层级索引
+     * @param   argb32 是否为ARGB32格式的数据
+     * @param   zPlane 有效的Z平面索引
+     * @param   key 输出参数，缓存键
+     * @return  坐标超出键的表示范围（负数，或不小于2^28，有多个Z平面时不小于2^24）时返回false，此时不缓存
+     */
+    bool decodedTileKey(const long long& startX, const long long& startY, const unsigned int& level, bool argb32,
+        unsigned int zPlane, TileCache<unsigned char>::keyType& key) const;
+
+    /**
+     * @brief   从解码瓦片缓存复制数据
+     * @param   key 缓存键
+     * @param   data 输出缓冲区
+     * @param   byteSize 期望的字节数
+     * @return  命中且字节数一致时返回true
+     */
+    bool copyFromDecodedCache(const TileCache<unsigned char>::keyType& key, void* data, unsigned long long byteSize);
+
+    /**
+     * @brief   把数据的副本放入解码瓦片缓存
+     * @param   key 缓存键
+     * @param   data 数据
+     * @param   byteSize 字节数
+     * @note    键已存在或数据超过缓存大小时不插入
+     */
+    void storeInDecodedCache(const TileCache<unsigned char>::keyType& key, const void* data, unsigned long long byteSize);
+
+    /**
+     * @brief   从磁盘瓦片缓存读取数据
+     * @param   key 缓存键
+     * @param   width 瓦片宽度，与缓存键一起索引磁盘记录
+     * @param   height 瓦片高度
+     * @param   data 输出缓冲区
+     * @param   byteSize 期望的字节数
+     * @return  命中时返回true，未设置磁盘缓存时返回false
+     */
+    bool readFromDiskCache(const TileCache<unsigned char>::keyType& key, unsigned long long width, unsigned long long height,
+        void* data, unsigned long long byteSize);
+
+    /**
+     * @brief   从压缩瓦片缓存读取数据
+     * @param   key 缓存键
+     * @param   data 输出缓冲区
+     * @param   byteSize 期望的字节数
+     * @return  命中时返回true
+     */
+    bool readFromCompressedCache(const TileCache<unsigned char>::keyType& key, void* data, unsigned long long byteSize);
+
+    /**
+     * @brief   按缓存大小计算解码瓦片缓存的上限
+     * @param   cacheSize 缓存大小
+     * @return  扣除压缩瓦片缓存份额后的字节数
+     */
+    static unsigned long long decodedCacheBytes(unsigned long long cacheSize);
+
+    /**
+     * @brief 解码瓦片缓存
+     * @details 淘汰的瓦片先压缩放入压缩瓦片缓存再释放。
+     *          ARGB32键的数据按4通道、8位原生数据按每像素样本数编码，其余类型按字节流编码。
+     *          有多个Z平面时按键中的Z平面统计占用，一个平面超过kZPlaneCacheShare后不再插入该平面的瓦片，
+     *          预取相邻平面时不会把当前平面的瓦片全部淘汰
+     * @tparam  T 图像原生数据类型
+     */
+    template <typename T> class DecodedTileCache : public TileCache<T> {
+    public:
+        DecodedTileCache(unsigned long long cacheMaxByteSize, std::shared_ptr<CompressedTileCache> compressed, unsigned int samplesPerPixel,
+            unsigned int numberOfZPlanes) :
+            TileCache<T>(cacheMaxByteSize),
+            _compressed(compressed),
+            _samplesPerPixel(samplesPerPixel),
+            _planeBytes(numberOfZPlanes > 1 ? numberOfZPlanes : 0)
+        {
+        }
+
+        int set(const typename TileCache<T>::keyType& k, T* v, unsigned int size, bool pinned = false) {
+            const unsigned int plane = TileCache<T>::keyZPlane(k);
+            if (plane < _planeBytes.size() &&
+                _planeBytes[plane].load() + size > static_cast<unsigned long long>(this->maxCacheSize() * kZPlaneCacheShare)) {
+                return 1;
+            }
+            int result = TileCache<T>::set(k, v, size, pinned);
+            if (result == 0 && plane < _planeBytes.size()) {
+                _planeBytes[plane] += size;
+            }
+            return result;
+        }
+
+        void clear() {
+            TileCache<T>::clear();
+            for (std::atomic<unsigned long long>& bytes : _planeBytes) {
+                bytes = 0;
+            }
+        }
+
+    protected:
+        void onEntryEvicted(const typename TileCache<T>::keyType& k, T* value, unsigned int size) {
+            PipelineProfiler::count(PipelineProfiler::DecodedCacheEviction);
+            const unsigned int plane = TileCache<T>::keyZPlane(k);
+            if (plane < _planeBytes.size()) {
+                _planeBytes[plane] -= size;
+            }
+            if (_compressed) {
+                const bool argb32 = ((k >> 56) & 0x80) != 0;
+                const unsigned int channels = argb32 ? 4 : (sizeof(T) == 1 ? _samplesPerPixel : 0);
+                _compressed->put(k, value, size, channels);
+            }
+            this->releaseValue(value);
+        }
+
+    private:
+        std::shared_ptr<CompressedTileCache> _compressed;
+        unsigned int _samplesPerPixel;
+
+        /** @brief 各Z平面占用的字节数，只有一个Z平面时为空，不限制 */
+        std::vector<std::atomic<unsigned long long> > _planeBytes;
+    };
+
+    /**
+     * @brief   把数据写入磁盘瓦片缓存
+     * @param   key 缓存键
+     * @param   width 瓦片宽度，与缓存键一起索引磁盘记录
+     * @param   height 瓦片高度
+     * @param   data 数据
+     * @param   byteSize 字节数
+     */
+    void writeToDiskCache(const TileCache<unsigned char>::keyType& key, unsigned long long width, unsigned long long height,
+        const void* data, unsigned long long byteSize);
+
     /**
      * @brief   创建缓存（模板函数）
-     * @details 根据指定的数据类型创建相应的缓存对象
+     * @details 根据指定的数据类型创建相应的缓存对象，淘汰的瓦片进入m_compressedCache
      *
      * @tparam  T 缓存数据类型
-     * @note    只有当图像有效时才会创建缓存
-     * @see     TileCache
+     * @note    只有当图像有效时才会创建缓存；缓存指针以原子方式替换，读取线程无需加锁
+     * @see     TileCache, DecodedTileCache
      */
     template <typename T> void createCache() {
         if (_isValid) {
-            m_cache.reset(new TileCache<T>(m_cacheSize));
+            std::atomic_store(&m_cache, std::shared_ptr<void>(std::make_shared<DecodedTileCache<T> >(
+                decodedCacheBytes(m_cacheSize), m_compressedCache, static_cast<unsigned int>(_samplesPerPixel), m_numberOfZPlanes)));
         }
     }
-};
 
-// 模板特化声明
-/**
- * @brief   getRawRegion函数的unsigned char特化版本
- * @details 为unsigned char类型提供优化的实现
- */
-template <> void MultiResolutionImage::getRawRegion(const long long& startX, const long long& startY, const unsigned long long& width,
-    const unsigned long long& height, const unsigned int& level, unsigned char*& data);
+    /**
+     * @brief   从指定类型的缓存复制数据
+     * @tparam  T 缓存数据类型
+     */
+    template <typename T> static bool copyFromTypedCache(TileCache<T>* cache, const TileCache<unsigned char>::keyType& key,
+        void* data, unsigned long long byteSize) {
+        return cache->visit(key, [data, byteSize](T* tile, unsigned int size) {
+            if (size != byteSize) {
+                return false;
+            }
+            std::memcpy(data, tile, byteSize);
+            return true;
+        });
+    }
 
-/**
- * @brief   getRawRegion函数的unsigned short特化版本
- * @details 为unsigned short类型提供优化的实现
- */
-template <> void MultiResolutionImage::getRawRegion(const long long& startX, const long long& startY, const unsigned long long& width,
-    const unsigned long long& height, const unsigned int& level, unsigned short*& data);
+    /**
+     * @brief   把数据副本放入指定类型的缓存
+     * @tparam  T 缓存数据类型
+     */
+    template <typename T> static void storeInTypedCache(TileCache<T>* cache, const TileCache<unsigned char>::keyType& key,
+        const void* data, unsigned long long byteSize) {
+        if (byteSize > cache->maxCacheSize()) {
+            return;
+        }
+        T* copy = new T[byteSize / sizeof(T)];
+        std::memcpy(copy, data, byteSize);
+        if (cache->set(key, copy, static_cast<unsigned int>(byteSize))) {
+            delete[] copy;
+        }
+    }
 
-/**
- * @brief   getRawRegion函数的unsigned int特化版本
- * @details 为unsigned int类型提供优化的实现
- */
-template <> void MultiResolutionImage::getRawRegion(const long long& startX, const long long& startY, const unsigned long long& width,
-    const unsigned long long& height, const unsigned int& level, unsigned int*& data);
+    /**
+     * @brief   按图像的原生数据类型分派readNativeRegion
+     * @details zPlane为有效的Z平面索引，cachedOnly的含义与readNativeRegion相同
+     * @tparam  T 目标数据类型
+     */
+    template <typename T> bool readNativeRegionAs(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, T* data, unsigned long long rowStride, unsigned int zPlane, bool cachedOnly) {
+        if (this->getDataType() == SlideColorManagement::DataType::UChar) {
+            return readNativeRegion<unsigned char>(startX, startY, width, height, level, data, rowStride, zPlane, cachedOnly);
+        }
+        if (this->getDataType() == SlideColorManagement::DataType::UInt16) {
+            return readNativeRegion<unsigned short>(startX, startY, width, height, level, data, rowStride, zPlane, cachedOnly);
+        }
+        if (this->getDataType() == SlideColorManagement::DataType::UInt32) {
+            return readNativeRegion<unsigned int>(startX, startY, width, height, level, data, rowStride, zPlane, cachedOnly);
+        }
+        if (this->getDataType() == SlideColorManagement::DataType::Float) {
+            return readNativeRegion<float>(startX, startY, width, height, level, data, rowStride, zPlane, cachedOnly);
+        }
+        return false;
+    }
 
-/**
- * @brief   getRawRegion函数的float特化版本
- * @details 为float类型提供优化的实现
- */
-template <> void MultiResolutionImage::getRawRegion(const long long& startX, const long long& startY, const unsigned long long& width,
-    const unsigned long long& height, const unsigned int& level, float*& data);
\ No newline at end of file
+    /**
+     * @brief   按原生数据类型S读取区域并转换到T
+     * @details zPlane为有效的Z平面索引。cachedOnly为true时只查找解码瓦片缓存和压缩瓦片缓存，未命中时返回false。转换通过initialize时解析的_sampleConverters进行。解码瓦片缓存命中时从缓存直接转换；未命中时依次查找压缩瓦片缓存、磁盘缓存和调用readDataIntoBuffer
+     *          （虚拟层级由上一个层级合成），并把结果的副本放入缓存，从图像解码或合成的结果同时写入磁盘缓存
+     * @tparam  S 图像原生数据类型，与m_cache的实际类型一致
+     * @tparam  T 目标数据类型
+     */
+    template <typename S, typename T> bool readNativeRegion(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, T* data, unsigned long long rowStride, unsigned int zPlane, bool cachedOnly) {
+        const PixelConversion::SampleConverter convert =
+            _sampleConverters[static_cast<unsigned int>(PixelConversion::SampleDataType<T>::value)];
+        if (!convert) {
+            return false;
+        }
+        const unsigned long long rowSamples = width * getSamplesPerPixel();
+        const unsigned long long sampleCount = rowSamples * height;
+        const unsigned long long byteSize = sampleCount * sizeof(S);
+        std::shared_ptr<void> cache = std::atomic_load(&m_cache);
+        TileCache<unsigned char>::keyType key = 0;
+        TileCache<S>* typedCache = NULL;
+        if (cache && decodedTileKey(startX, startY, level, false, zPlane, key)) {
+            typedCache = static_cast<TileCache<S>*>(cache.get());
+            const bool hit = typedCache->visit(key, [&](S* tile, unsigned int size) {
+                if (size != byteSize) {
+                    return false;
+                }
+                convert(tile, data, rowSamples, height, rowStride);
+                return true;
+            });
+            PipelineProfiler::count(hit ? PipelineProfiler::DecodedCacheHit : PipelineProfiler::DecodedCacheMiss);
+            if (hit) {
+                return true;
+            }
+        }
+
+        // 同类型且紧密排列时直接写入调用者的缓冲区，否则经池缓冲区转换
+        const bool direct = std::is_same<S, T>::value && (rowStride == 0 || rowStride == rowSamples);
+        TileBuffer<S> temp(direct ? 0 : sampleCount);
+        S* target = direct ? reinterpret_cast<S*>(data) : temp.get();
+        if (typedCache && readFromCompressedCache(key, target, byteSize)) {
+            storeInTypedCache(typedCache, key, target, byteSize);
+        }
+        else if (cachedOnly) {
+            return false;
+        }
+        else if (typedCache && m_diskCache && readFromDiskCache(key, width, height, target, byteSize)) {
+            storeInTypedCache(typedCache, key, target, byteSize);
+        }
+        else if (readPyramidLevel(startX, startY, width, height, level, target, zPlane)) {
+            if (typedCache) {
+                storeInTypedCache(typedCache, key, target, byteSize);
+                writeToDiskCache(key, width, height, target, byteSize);
+            }
+        }
+        else {
+            return false;
+        }
+        if (!direct) {
+            convert(target, data, rowSamples, height, rowStride);
+        }
+        return true;
+    }
+
+    /**
+     * @brief   读取逻辑层级的原生类型数据
+     * @details 原生层级换算为派生类的层级索引后调用readDataIntoBuffer；
+     *          虚拟层级经readRegion读取上一个层级的象限后合成，上一个层级的瓦片因此也进入缓存
+     * @tparam  S 图像原生数据类型
+     */
+    template <typename S> bool readPyramidLevel(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, S* target, unsigned int zPlane) {
+        const int nativeLevel = _pyramidLevels[level].nativeLevel;
+        if (nativeLevel >= 0) {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            bool read = readDataIntoBuffer(startX, startY, width, height, static_cast<unsigned int>(nativeLevel), target, zPlane);
+            if (read) {
+                recordReadLatency(start, width * height);
+            }
+            return read;
+        }
+        const unsigned int finerLevel = level - 1;
+        return synthesizeVirtualRegion(startX, startY, width, height, level, getSamplesPerPixel(), target,
+            [this, finerLevel, zPlane](long long x, long long y, unsigned long long w, unsigned long long h, S* fine) {
+                return readRegion<S>(x, y, w, h, finerLevel, fine, 0, zPlane);
+            });
+    }
+};
@@ -13,13 +13,25 @@
 #define NOMINMAX
 #include <windows.h>
 #include "MultiResolutionImage.h"
+#include "DiskTileCache.h"
+#include "DeepZoomImage.h"
+#include "DicomWSIImage.h"
+#include "LabelMaskImage.h"
+#include "TiledTiffImage.h"
+#include "openslide/openslide.h"
+#include <QFileInfo>
 #include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
 
 /**
  * @brief 外部格式注册标志
- * @details 用于标记是否已经注册了外部文件格式
+ * @details 保证外部文件格式只注册一次
  */
-bool MultiResolutionImageFactory::_externalFormatsRegistered = false;
+std::once_flag MultiResolutionImageFactory::_externalFormatsOnce;
 
 /**
  * @brief 所有支持的扩展名集合
@@ -27,6 +39,48 @@ bool MultiResolutionImageFactory::_externalFormatsRegistered = false;
  */
 std::set<std::string> MultiResolutionImageFactory::_allSupportedExtensions;
 
+namespace {
+
+    /**
+     * @brief 探测缓存项
+     * @details 文件大小和修改时间用于判断缓存是否仍然有效
+     */
+    struct ProbeEntry {
+        qint64 size;
+        qint64 modified;
+        std::string factoryName;
+    };
+
+    /** @brief 探测缓存最多保留的文件数，超过时整体清空 */
+    const size_t kMaxProbeEntries = 4096;
+
+    std::mutex& probeMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    std::unordered_map<std::string, ProbeEntry>& probeCache() {
+        static std::unordered_map<std::string, ProbeEntry> cache;
+        return cache;
+    }
+
+    /**
+     * @brief 获取小写扩展名
+     * @param fileName 文件路径
+     * @return 不含点的小写扩展名，没有扩展名时返回空字符串
+     */
+    std::string lowerExtension(const std::string& fileName) {
+        size_t dot = fileName.find_last_of('.');
+        size_t separator = fileName.find_last_of("/\\");
+        if (dot == std::string::npos || (separator != std::string::npos && dot < separator)) {
+            return std::string();
+        }
+        std::string extension = fileName.substr(dot + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return extension;
+    }
+}
+
 /**
  * @brief 获取工厂注册表
  * @return 工厂注册表的引用
@@ -55,6 +109,7 @@ void MultiResolutionImageFactory::addSupportedExtensions(const std::set<std::str
  * @details 创建工厂对象并注册到全局注册表中，同时添加支持的扩展名
  */
 MultiResolutionImageFactory::MultiResolutionImageFactory(const std::string& factoryName, const std::set<std::string>& supported_extensions, const unsigned int priority) :
+    _supportedExtensions(supported_extensions),
     _factoryName(factoryName),
     _priority(priority)
 {
@@ -99,21 +154,164 @@ bool MultiResolutionImageFactory::operator<(const MultiResolutionImageFactory& o
     return this->_priority < other._priority;
 }
 
+/**
+ * @brief 默认的文件头魔数检查
+ * @return 始终返回false，只按扩展名预探测
+ */
+bool MultiResolutionImageFactory::matchesSignature(const unsigned char* header, size_t length) const
+{
+    return false;
+}
+
+/**
+ * @brief 按优先级排序的已注册工厂
+ * @return 工厂列表
+ */
+std::vector<MultiResolutionImageFactory*> MultiResolutionImageFactory::factoriesByPriority()
+{
+    MultiResolutionImageFactory::registerExternalFileFormats();
+    std::vector<MultiResolutionImageFactory*> factories;
+    for (auto it = registry().begin(); it != registry().end(); ++it) {
+        factories.push_back(it->second.second);
+    }
+    std::stable_sort(factories.begin(), factories.end(),
+        [](const MultiResolutionImageFactory* a, const MultiResolutionImageFactory* b) { return *a < *b; });
+    return factories;
+}
+
+/**
+ * @brief 预探测工厂
+ * @param fileName 图像文件路径
+ * @return 扩展名或文件头匹配的工厂
+ * @details 文件头只读取一次，供所有工厂的魔数检查共用
+ */
+std::vector<MultiResolutionImageFactory*> MultiResolutionImageFactory::preprobe(const std::string& fileName)
+{
+    unsigned char header[kProbeHeaderSize];
+    size_t length = 0;
+    std::ifstream file(fileName.c_str(), std::ios::binary);
+    if (file) {
+        file.read(reinterpret_cast<char*>(header), sizeof(header));
+        length = static_cast<size_t>(file.gcount());
+    }
+    const std::string extension = lowerExtension(fileName);
+    std::vector<MultiResolutionImageFactory*> candidates;
+    for (MultiResolutionImageFactory* factory : factoriesByPriority()) {
+        if ((length > 0 && factory->matchesSignature(header, length)) || factory->_supportedExtensions.count(extension) > 0) {
+            candidates.push_back(factory);
+        }
+    }
+    return candidates;
+}
+
+/**
+ * @brief 查询缓存的探测结果
+ * @param fileName 图像文件路径
+ * @param factoryName 输出缓存的工厂名称
+ * @return 缓存有效时返回true
+ */
+bool MultiResolutionImageFactory::cachedProbeResult(const std::string& fileName, std::string& factoryName)
+{
+    QFileInfo info(QString::fromStdString(fileName));
+    std::lock_guard<std::mutex> l(probeMutex());
+    auto it = probeCache().find(fileName);
+    if (it == probeCache().end() || it->second.size != info.size() || it->second.modified != info.lastModified().toMSecsSinceEpoch()) {
+        return false;
+    }
+    factoryName = it->second.factoryName;
+    return true;
+}
+
+/**
+ * @brief 记录探测结果
+ * @param fileName 图像文件路径
+ * @param factoryName 能读取该文件的工厂名称
+ */
+void MultiResolutionImageFactory::cacheProbeResult(const std::string& fileName, const std::string& factoryName)
+{
+    QFileInfo info(QString::fromStdString(fileName));
+    ProbeEntry entry = { info.size(), info.lastModified().toMSecsSinceEpoch(), factoryName };
+    std::lock_guard<std::mutex> l(probeMutex());
+    if (probeCache().size() >= kMaxProbeEntries) {
+        probeCache().clear();
+    }
+    probeCache()[fileName] = entry;
+}
+
+/**
+ * @brief 探测文件格式
+ * @param fileName 图像文件路径
+ * @return 能读取该文件的工厂名称，没有时返回空字符串
+ */
+std::string MultiResolutionImageFactory::probeImage(const std::string& fileName)
+{
+    std::string factoryName;
+    if (cachedProbeResult(fileName, factoryName)) {
+        return factoryName;
+    }
+    return probeCandidates(fileName, preprobe(fileName));
+}
+
+/**
+ * @brief 在通过预探测的工厂中探测文件格式
+ * @param fileName 图像文件路径
+ * @param candidates 通过预探测的工厂
+ * @return 能读取该文件的工厂名称，没有时返回空字符串
+ */
+std::string MultiResolutionImageFactory::probeCandidates(const std::string& fileName, const std::vector<MultiResolutionImageFactory*>& candidates)
+{
+    std::string factoryName;
+    for (MultiResolutionImageFactory* factory : candidates) {
+        if (factory->canReadImage(fileName)) {
+            factoryName = factory->_factoryName;
+            break;
+        }
+    }
+    cacheProbeResult(fileName, factoryName);
+    return factoryName;
+}
+
+/**
+ * @brief 检查文件是否为支持的图像
+ * @param fileName 图像文件路径
+ * @return 有工厂能读取该文件时返回true
+ */
+bool MultiResolutionImageFactory::canOpenImage(const std::string& fileName)
+{
+    return !probeImage(fileName).empty();
+}
+
 /**
  * @brief 打开图像文件
  * @param fileName 图像文件路径
- * @param factoryName 工厂名称（可选）
+ * @param factoryName 工厂名称（可选），为"default"或未注册的名称时自动选择
  * @return 成功时返回图像对象指针，失败时返回NULL
- * @details 使用OpenSlide工厂尝试打开图像文件
+ * @details 先使用探测到的工厂打开，失败时按优先级尝试其余通过预探测的工厂，
+ *          实际打开成功的工厂写回探测缓存；文件头只读取一次，探测和打开共用预探测结果
  */
 MultiResolutionImage* MultiResolutionImageFactory::openImage(const std::string& fileName, const std::string factoryName) {
-    MultiResolutionImageFactory* factory = new OpenSlideImageFactory();
-    MultiResolutionImage* img = MultiResolutionImageFactory::openImageWithFactory(fileName, factory);
-    if (img)
-    {
-        return img;
+    MultiResolutionImageFactory::registerExternalFileFormats();
+    auto named = registry().find(factoryName);
+    if (named != registry().end()) {
+        return MultiResolutionImageFactory::openImageWithFactory(fileName, named->second.second);
     }
 
+    std::vector<MultiResolutionImageFactory*> candidates = preprobe(fileName);
+    std::string probed;
+    if (!cachedProbeResult(fileName, probed)) {
+        probed = probeCandidates(fileName, candidates);
+    }
+    std::stable_partition(candidates.begin(), candidates.end(),
+        [&probed](const MultiResolutionImageFactory* factory) { return factory->_factoryName == probed; });
+    for (MultiResolutionImageFactory* factory : candidates) {
+        MultiResolutionImage* img = MultiResolutionImageFactory::openImageWithFactory(fileName, factory);
+        if (img) {
+            if (factory->_factoryName != probed) {
+                cacheProbeResult(fileName, factory->_factoryName);
+            }
+            return img;
+        }
+    }
     return NULL;
 }
 
@@ -122,12 +320,15 @@ MultiResolutionImage* MultiResolutionImageFactory::openImage(const std::string&
  * @param fileName 图像文件路径
  * @param factory 要使用的工厂对象
  * @return 成功时返回图像对象指针，失败时返回NULL
- * @details 使用指定的工厂对象尝试读取图像文件
+ * @details 使用指定的工厂对象尝试读取图像文件，成功后挂接该切片的磁盘瓦片缓存；
+ *          图像提供缓存身份时按身份打开，否则按文件信息打开
  */
 MultiResolutionImage* MultiResolutionImageFactory::openImageWithFactory(const std::string& fileName, const MultiResolutionImageFactory* factory)
 {
     MultiResolutionImage* img = factory->readImage(fileName);
     if (img) {
+        const std::string identity = img->cacheIdentity();
+        img->setDiskCache(identity.empty() ? DiskTileCache::open(fileName) : DiskTileCache::openIdentity(identity));
         return img;
     }
     return NULL;
@@ -141,11 +342,11 @@ typedef void (*FileFormatLoader)();
 
 /**
  * @brief 注册外部文件格式
- * @details 目前为空实现，预留接口用于未来扩展外部文件格式支持
+ * @details 首次调用时创建内置工厂的静态对象，使其注册到工厂注册表；
+ *          并发的首次调用都在call_once中等待filetypeLoad完成后才返回
  */
 void MultiResolutionImageFactory::registerExternalFileFormats() {
-    //目前这个实现也不需要了：
-    return;
+    std::call_once(_externalFormatsOnce, filetypeLoad);
 }
 
 using std::string;
@@ -210,21 +411,195 @@ MultiResolutionImage* OpenSlideImageFactory::readImage(const std::string& fileNa
  * @brief 检查是否可以读取指定文件
  * @param fileName 图像文件路径
  * @return 如果可以读取则返回true，否则返回false
- * @details 尝试创建OpenSlideImage对象并初始化，用于检查文件格式是否支持
+ * @details 使用openslide_detect_vendor识别格式，只读取文件头，不创建OpenSlideImage
  */
 bool OpenSlideImageFactory::canReadImage(const std::string& fileName) const {
-    OpenSlideImage* img = new OpenSlideImage();
-    bool canOpen = img->initialize(fileName);
-    delete img;
-    return canOpen;
+    return openslide_detect_vendor(fileName.c_str()) != NULL;
+}
+
+/**
+ * @brief 检查TIFF/BigTIFF文件头
+ * @param header 文件开头的字节
+ * @param length 字节数
+ * @return 文件头为II*\0、MM\0*、II+\0或MM\0+时返回true
+ */
+bool OpenSlideImageFactory::matchesSignature(const unsigned char* header, size_t length) const {
+    if (length < 4) {
+        return false;
+    }
+    return (header[0] == 'I' && header[1] == 'I' && (header[2] == 42 || header[2] == 43) && header[3] == 0) ||
+        (header[0] == 'M' && header[1] == 'M' && header[2] == 0 && (header[3] == 42 || header[3] == 43));
+}
+
+/**
+ * @brief DICOM图像工厂构造函数
+ * @details 创建DICOM工厂，支持dcm扩展名，优先级设置为0，先于OpenSlide工厂尝试
+ */
+DicomWSIImageFactory::DicomWSIImageFactory()
+    : MultiResolutionImageFactory("DICOM Formats", { "dcm" }, 0) {
+}
+
+/**
+ * @brief 读取图像文件
+ * @param fileName 图像文件路径
+ * @return 成功时返回DicomWSIImage对象指针，失败时返回NULL
+ */
+MultiResolutionImage* DicomWSIImageFactory::readImage(const std::string& fileName) const {
+    DicomWSIImage* img = new DicomWSIImage();
+    img->initialize(fileName);
+    if (img->valid()) {
+        return img;
+    }
+    else {
+        delete img;
+        return NULL;
+    }
+}
+
+/**
+ * @brief 检查是否可以读取指定文件
+ * @param fileName 图像文件路径
+ * @return 文件带有DICM标记时返回true
+ */
+bool DicomWSIImageFactory::canReadImage(const std::string& fileName) const {
+    return DicomWSIImage::hasDicomSignature(fileName);
+}
+
+/**
+ * @brief 检查DICOM文件头
+ * @param header 文件开头的字节
+ * @param length 字节数
+ * @return 偏移128处为"DICM"时返回true
+ */
+bool DicomWSIImageFactory::matchesSignature(const unsigned char* header, size_t length) const {
+    return length >= 132 && std::memcmp(header + 128, "DICM", 4) == 0;
+}
+
+/**
+ * @brief TIFF图像工厂构造函数
+ * @details 创建TIFF工厂，支持svs、tif和tiff扩展名，优先级设置为0，先于OpenSlide工厂尝试
+ */
+TiledTiffImageFactory::TiledTiffImageFactory()
+    : MultiResolutionImageFactory("TIFF Formats", { "svs", "tif", "tiff" }, 0) {
+}
+
+/**
+ * @brief 读取图像文件
+ * @param fileName 图像文件路径
+ * @return 成功时返回TiledTiffImage对象指针，失败时返回NULL
+ */
+MultiResolutionImage* TiledTiffImageFactory::readImage(const std::string& fileName) const {
+    TiledTiffImage* img = new TiledTiffImage();
+    img->initialize(fileName);
+    if (img->valid()) {
+        return img;
+    }
+    else {
+        delete img;
+        return NULL;
+    }
+}
+
+/**
+ * @brief 检查是否可以读取指定文件
+ * @param fileName 图像文件路径
+ * @return 可以直接读取时返回true
+ */
+bool TiledTiffImageFactory::canReadImage(const std::string& fileName) const {
+    return TiledTiffImage::canReadFile(fileName);
+}
+
+/**
+ * @brief Deep Zoom图像工厂构造函数
+ * @details 创建Deep Zoom工厂，支持dzi扩展名，优先级设置为0
+ */
+DeepZoomImageFactory::DeepZoomImageFactory()
+    : MultiResolutionImageFactory("Deep Zoom Formats", { "dzi" }, 0) {
+}
+
+/**
+ * @brief 读取图像文件
+ * @param fileName 描述文件的URL或本地路径
+ * @return 成功时返回DeepZoomImage对象指针，失败时返回NULL
+ */
+MultiResolutionImage* DeepZoomImageFactory::readImage(const std::string& fileName) const {
+    DeepZoomImage* img = new DeepZoomImage();
+    img->initialize(fileName);
+    if (img->valid()) {
+        return img;
+    }
+    else {
+        delete img;
+        return NULL;
+    }
+}
+
+/**
+ * @brief 检查是否可以读取指定文件
+ * @param fileName 描述文件的URL或本地路径
+ * @return 扩展名为dzi时返回true
+ * @details 不下载描述文件，描述无效时由readImage失败
+ */
+bool DeepZoomImageFactory::canReadImage(const std::string& fileName) const {
+    return DeepZoomImage::isDeepZoomName(fileName);
+}
+
+/**
+ * @brief 标签掩膜工厂构造函数
+ * @details 创建标签掩膜工厂，支持dlm扩展名，优先级设置为0
+ */
+LabelMaskImageFactory::LabelMaskImageFactory()
+    : MultiResolutionImageFactory("Label Mask Formats", { "dlm" }, 0) {
+}
+
+/**
+ * @brief 读取图像文件
+ * @param fileName 文件路径
+ * @return 成功时返回LabelMaskImage对象指针，失败时返回NULL
+ */
+MultiResolutionImage* LabelMaskImageFactory::readImage(const std::string& fileName) const {
+    LabelMaskImage* img = new LabelMaskImage();
+    img->initialize(fileName);
+    if (img->valid()) {
+        return img;
+    }
+    else {
+        delete img;
+        return NULL;
+    }
+}
+
+/**
+ * @brief 检查是否可以读取指定文件
+ * @param fileName 文件路径
+ * @return 文件以魔数开头时返回true
+ */
+bool LabelMaskImageFactory::canReadImage(const std::string& fileName) const {
+    unsigned char header[sizeof(LabelMaskImage::kMagic)];
+    std::ifstream file(fileName.c_str(), std::ios::binary);
+    return file.read(reinterpret_cast<char*>(header), sizeof(header)) && LabelMaskImage::matchesSignature(header, sizeof(header));
+}
+
+/**
+ * @brief 检查标签掩膜文件头
+ * @param header 文件开头的字节
+ * @param length 字节数
+ * @return 以魔数开头时返回true
+ */
+bool LabelMaskImageFactory::matchesSignature(const unsigned char* header, size_t length) const {
+    return LabelMaskImage::matchesSignature(header, length);
 }
 
 /**
  * @brief 文件类型加载函数
- * @details 静态函数，用于确保OpenSlideImageFactory被正确注册
- *          创建静态工厂对象，确保在程序启动时注册工厂
+ * @details 静态函数，用于确保内置工厂被正确注册
+ *          创建静态工厂对象，由registerExternalFileFormats在首次使用工厂时调用
  */
 void filetypeLoad()
 {
     static OpenSlideImageFactory filetypeFactory;
+    static DicomWSIImageFactory dicomFactory;
+    static TiledTiffImageFactory tiffFactory;
+    static DeepZoomImageFactory deepZoomFactory;
+    static LabelMaskImageFactory labelMaskFactory;
 }
\ No newline at end of file
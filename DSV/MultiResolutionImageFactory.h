@@ -21,6 +21,7 @@
 
 #include <string>
 #include <map>
+#include <mutex>
 #include <vector> 
 #include <set>
 
@@ -91,7 +92,8 @@ public:
      *          并自动注册支持的文件格式到工厂系统中。
      *
      * @note    该方法通常在系统初始化时调用一次
-     * @see     _externalFormatsRegistered
+     * @note    多个线程同时打开文件时只注册一次，其余线程等待注册完成
+     * @see     _externalFormatsOnce
      */
     static void registerExternalFileFormats();
 
@@ -130,6 +132,27 @@ public:
      */
     static std::set<std::string> getAllSupportedExtensions();
 
+    /**
+     * @brief   探测文件格式（静态方法）
+     * @details 按优先级依次对已注册的工厂做预探测和探测：
+     *          - 预探测：扩展名属于工厂支持的扩展名，或文件头匹配工厂的魔数
+     *          - 探测：通过预探测后调用canReadImage做轻量检查，不完整打开图像
+     *          结果按文件缓存，文件大小或修改时间变化后重新探测
+     *
+     * @param   fileName 图像文件路径
+     * @return  能读取该文件的工厂名称，没有时返回空字符串
+     * @note    线程安全，可以在浏览文件夹时频繁调用
+     */
+    static std::string probeImage(const std::string& fileName);
+
+    /**
+     * @brief   检查文件是否为支持的图像（静态方法）
+     * @param   fileName 图像文件路径
+     * @return  有工厂能读取该文件时返回true
+     * @see     probeImage
+     */
+    static bool canOpenImage(const std::string& fileName);
+
     /**
      * @brief   工厂比较操作符
      * @details 根据工厂优先级进行比较，用于工厂排序。
@@ -200,9 +223,61 @@ protected:
      */
     virtual bool canReadImage(const std::string& fileName) const = 0;
 
+    /**
+     * @brief   检查文件头魔数
+     * @details 预探测使用的魔数检查，默认不匹配，只按扩展名预探测
+     *
+     * @param   header 文件开头的字节
+     * @param   length 字节数，文件较短时小于kProbeHeaderSize
+     * @return  true表示文件头是该工厂的格式
+     */
+    virtual bool matchesSignature(const unsigned char* header, size_t length) const;
+
+    /** @brief 预探测读取的文件头字节数，覆盖DICOM的128字节前导和DICM标记 */
+    static const size_t kProbeHeaderSize = 132;
+
 private:
-    /** @brief 外部格式是否已注册的标志 */
-    static bool _externalFormatsRegistered;
+    /**
+     * @brief   按优先级排序的已注册工厂
+     * @return  工厂列表，优先级数值小的在前
+     */
+    static std::vector<MultiResolutionImageFactory*> factoriesByPriority();
+
+    /**
+     * @brief   预探测工厂
+     * @param   fileName 图像文件路径
+     * @return  通过预探测的工厂，按优先级排序
+     */
+    static std::vector<MultiResolutionImageFactory*> preprobe(const std::string& fileName);
+
+    /**
+     * @brief   在通过预探测的工厂中探测文件格式并缓存结果
+     * @param   fileName 图像文件路径
+     * @param   candidates preprobe的结果
+     * @return  第一个canReadImage通过的工厂名称，没有时返回空字符串
+     */
+    static std::string probeCandidates(const std::string& fileName, const std::vector<MultiResolutionImageFactory*>& candidates);
+
+    /**
+     * @brief   记录探测结果
+     * @param   fileName 图像文件路径
+     * @param   factoryName 能读取该文件的工厂名称，空字符串表示不支持
+     */
+    static void cacheProbeResult(const std::string& fileName, const std::string& factoryName);
+
+    /**
+     * @brief   查询缓存的探测结果
+     * @param   fileName 图像文件路径
+     * @param   factoryName 输出缓存的工厂名称
+     * @return  缓存存在且文件未变化时返回true
+     */
+    static bool cachedProbeResult(const std::string& fileName, std::string& factoryName);
+
+    /** @brief 支持的文件扩展名（小写，不含点） */
+    const std::set<std::string> _supportedExtensions;
+
+    /** @brief 外部格式只注册一次，注册完成之前其他线程在call_once中等待 */
+    static std::once_flag _externalFormatsOnce;
 
     /** @brief 所有支持的文件扩展名集合 */
     static std::set<std::string> _allSupportedExtensions;
@@ -299,9 +374,162 @@ private:
      *
      * @param   fileName 图像文件路径
      * @return  true表示可以读取，false表示不能读取
-     * @note    该函数会检查文件扩展名和文件头信息
+     * @note    使用openslide_detect_vendor只读取文件头信息，不完整打开切片
+     */
+    bool canReadImage(const std::string& fileName) const;
+
+    /**
+     * @brief   检查TIFF/BigTIFF文件头
+     * @param   header 文件开头的字节
+     * @param   length 字节数
+     * @return  文件头为TIFF或BigTIFF时返回true
+     */
+    bool matchesSignature(const unsigned char* header, size_t length) const;
+};
+
+/**
+ * @class  DicomWSIImageFactory
+ * @brief  DICOM WSI图像格式工厂
+ * @details 使用基于libdicom的DicomWSIImage读取DICOM全切片图像（VL Whole Slide Microscopy），
+ *          打开序列中任一实例文件即可加载整个金字塔
+ *
+ * @see     MultiResolutionImageFactory, DicomWSIImage
+ */
+class DicomWSIImageFactory : public MultiResolutionImageFactory {
+public:
+    /**
+     * @brief   构造函数
+     * @details 创建DICOM图像工厂，支持.dcm扩展名，优先于同样能读取DICOM的OpenSlide
+     */
+    DicomWSIImageFactory();
+
+private:
+    /**
+     * @brief   读取DICOM WSI图像文件
+     * @param   fileName 图像文件路径
+     * @return  成功时返回DicomWSIImage对象指针，失败时返回nullptr
+     */
+    MultiResolutionImage* readImage(const std::string& fileName) const;
+
+    /**
+     * @brief   检查是否可以读取DICOM WSI图像
+     * @param   fileName 图像文件路径
+     * @return  文件带有DICM标记时返回true
      */
     bool canReadImage(const std::string& fileName) const;
+
+    /**
+     * @brief   检查DICOM文件头
+     * @param   header 文件开头的字节
+     * @param   length 字节数
+     * @return  偏移128处为"DICM"时返回true
+     */
+    bool matchesSignature(const unsigned char* header, size_t length) const;
+};
+
+/**
+ * @class  TiledTiffImageFactory
+ * @brief  分块TIFF/SVS图像格式工厂
+ * @details 使用直接解析IFD的TiledTiffImage读取Aperio SVS和通用分块TIFF，
+ *          优先级高于OpenSlide；无法直接读取的TIFF变体由OpenSlide工厂处理
+ *
+ * @see     MultiResolutionImageFactory, TiledTiffImage
+ */
+class TiledTiffImageFactory : public MultiResolutionImageFactory {
+public:
+    /**
+     * @brief   构造函数
+     * @details 创建TIFF图像工厂，支持svs、tif和tiff扩展名
+     */
+    TiledTiffImageFactory();
+
+private:
+    /**
+     * @brief   读取TIFF图像文件
+     * @param   fileName 图像文件路径
+     * @return  成功时返回TiledTiffImage对象指针，失败时返回nullptr
+     */
+    MultiResolutionImage* readImage(const std::string& fileName) const;
+
+    /**
+     * @brief   检查是否可以直接读取TIFF图像
+     * @param   fileName 图像文件路径
+     * @return  文件为aperio或generic-tiff格式且第0层可解码时返回true
+     * @see     TiledTiffImage::canReadFile
+     */
+    bool canReadImage(const std::string& fileName) const;
+};
+
+/**
+ * @class  DeepZoomImageFactory
+ * @brief  Deep Zoom远程切片格式工厂
+ * @details 使用DeepZoomImage通过HTTP读取切片服务器发布的DZI金字塔，
+ *          文件名可以是http(s) URL或本地.dzi路径
+ *
+ * @see     MultiResolutionImageFactory, DeepZoomImage
+ */
+class DeepZoomImageFactory : public MultiResolutionImageFactory {
+public:
+    /**
+     * @brief   构造函数
+     * @details 创建Deep Zoom图像工厂，支持.dzi扩展名
+     */
+    DeepZoomImageFactory();
+
+private:
+    /**
+     * @brief   读取DZI图像
+     * @param   fileName 描述文件的URL或本地路径
+     * @return  成功时返回DeepZoomImage对象指针，失败时返回nullptr
+     */
+    MultiResolutionImage* readImage(const std::string& fileName) const;
+
+    /**
+     * @brief   检查是否可以读取DZI图像
+     * @param   fileName 描述文件的URL或本地路径
+     * @return  扩展名为.dzi时返回true
+     * @see     DeepZoomImage::isDeepZoomName
+     */
+    bool canReadImage(const std::string& fileName) const;
+};
+
+/**
+ * @class  LabelMaskImageFactory
+ * @brief  标签掩膜格式工厂
+ * @details 使用LabelMaskImage读取LabelMaskWriter生成的.dlm游程编码标签掩膜
+ *
+ * @see     MultiResolutionImageFactory, LabelMaskImage
+ */
+class LabelMaskImageFactory : public MultiResolutionImageFactory {
+public:
+    /**
+     * @brief   构造函数
+     * @details 创建标签掩膜工厂，支持.dlm扩展名
+     */
+    LabelMaskImageFactory();
+
+private:
+    /**
+     * @brief   读取标签掩膜文件
+     * @param   fileName 文件路径
+     * @return  成功时返回LabelMaskImage对象指针，失败时返回nullptr
+     */
+    MultiResolutionImage* readImage(const std::string& fileName) const;
+
+    /**
+     * @brief   检查是否可以读取标签掩膜文件
+     * @param   fileName 文件路径
+     * @return  文件以"DSVLMSK1"开头时返回true
+     */
+    bool canReadImage(const std::string& fileName) const;
+
+    /**
+     * @brief   检查标签掩膜文件头
+     * @param   header 文件开头的字节
+     * @param   length 字节数
+     * @return  以"DSVLMSK1"开头时返回true
+     */
+    bool matchesSignature(const unsigned char* header, size_t length) const;
 };
 
 /**
@@ -9,21 +9,30 @@
  */
 
 #include "OpenSlideImage.h"
+#include "PixelConversion.h"
+#include "PipelineProfiler.h"
+#include "PipelineTrace.h"
+#include "TileBufferPool.h"
 #include <shared_mutex>
 #include "openslide/openslide.h"
 #include <sstream>
+#include <cstdlib>
 #include <algorithm>
+#include <thread>
 
 /**
  * @brief 构造函数：初始化OpenSlide图像对象
  * @details 初始化OpenSlide相关的成员变量，包括：
  *          - 继承自MultiResolutionImage的成员
- *          - OpenSlide句柄
+ *          - OpenSlide句柄及读取句柄池
  *          - 背景颜色设置
  */
 OpenSlideImage::OpenSlideImage() 
     : MultiResolutionImage(), 
     _slide(NULL),
+    _openHandleCount(0),
+    _maxHandleCount(std::max(2u, std::thread::hardware_concurrency())),
+    _cacheSize(0),
     _bg_r(255), 
     _bg_g(255), 
     _bg_b(255) {
@@ -42,13 +51,20 @@ OpenSlideImage::~OpenSlideImage() {
 /**
  * @brief 设置OpenSlide缓存大小
  * @param cacheSize 缓存大小（字节数）
- * @details 仅在自定义OpenSlide版本时设置缓存大小
+ * @details 设置父类的解码瓦片缓存大小；仅在自定义OpenSlide版本时设置OpenSlide内部缓存大小，
+ *          同时应用到句柄池中的空闲句柄和之后打开的句柄
  */
 void OpenSlideImage::setCacheSize(const unsigned long long cacheSize) {
+	MultiResolutionImage::setCacheSize(cacheSize);
+	_cacheSize = cacheSize;
 #ifdef CUSTOM_OPENSLIDE
 	if (_slide) {
 		openslide_set_cache_size(_slide, cacheSize);
 	}
+	std::lock_guard<std::mutex> l(_handlePoolMutex);
+	for (openslide_t* handle : _idleHandles) {
+		openslide_set_cache_size(handle, cacheSize);
+	}
 #endif
 }
 
@@ -110,6 +126,17 @@ bool OpenSlideImage::initializeType(const std::string& imagePath) {
                 tmp.push_back(x);
                 tmp.push_back(y);
                 _levelDimensions.push_back(tmp);
+
+                // OpenSlide 4.0起提供层级的瓦片尺寸属性，缺失时表示不分块
+                std::vector<unsigned long long> tileSize;
+                const std::string prefix = "openslide.level[" + std::to_string(i) + "].";
+                const char* tileWidth = openslide_get_property_value(_slide, (prefix + "tile-width").c_str());
+                const char* tileHeight = openslide_get_property_value(_slide, (prefix + "tile-height").c_str());
+                if (tileWidth && tileHeight) {
+                    tileSize.push_back(std::strtoull(tileWidth, NULL, 10));
+                    tileSize.push_back(std::strtoull(tileHeight, NULL, 10));
+                }
+                _levelTileSizes.push_back(tileSize);
             }
             std::stringstream ssm;
             if (openslide_get_property_value(_slide, OPENSLIDE_PROPERTY_NAME_MPP_X)) {
@@ -163,6 +190,37 @@ std::string OpenSlideImage::getProperty(const std::string& propertyName) {
     return propertyValue;
 }
 
+/**
+ * @brief 获取切片背景色
+ * @param r 输出红色分量
+ * @param g 输出绿色分量
+ * @param b 输出蓝色分量
+ */
+void OpenSlideImage::getBackgroundColor(unsigned char& r, unsigned char& g, unsigned char& b) const {
+    r = _bg_r;
+    g = _bg_g;
+    b = _bg_b;
+}
+
+/**
+ * @brief 获取切片的ICC颜色配置文件
+ * @return 配置文件的原始字节，没有配置文件或读取失败时为空
+ */
+std::vector<unsigned char> OpenSlideImage::getICCProfile() {
+    std::vector<unsigned char> profile;
+    if (_slide) {
+        const int64_t size = openslide_get_icc_profile_size(_slide);
+        if (size > 0) {
+            profile.resize(static_cast<size_t>(size));
+            openslide_read_icc_profile(_slide, profile.data());
+            if (openslide_get_error(_slide)) {
+                profile.clear();
+            }
+        }
+    }
+    return profile;
+}
+
 /**
  * @brief 从图像中读取数据
  * @param startX 起始X坐标
@@ -187,154 +245,303 @@ std::string OpenSlideImage::getProperty(const std::string& propertyName) {
 void* OpenSlideImage::readDataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
     const unsigned long long& height, const unsigned int& level) {
 
-    if (!_isValid) {
+    unsigned char* rgb = TileBufferPool::allocateArray<unsigned char>(width * height * 3);
+    if (!readDataIntoBuffer(startX, startY, width, height, level, rgb, m_currentZPlaneIndex)) {
+        TileBufferPool::release(rgb);
         return NULL;
     }
+    return rgb;
+}
+
+/**
+ * @brief 把区域数据解码到调用者的缓冲区
+ * @param startX 起始X坐标
+ * @param startY 起始Y坐标
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @param data 输出缓冲区，width*height*3字节
+ * @param zPlane Z平面索引，单平面格式忽略
+ * @return 图像有效时返回true
+ * @details OpenSlide只输出预乘BGRA，经一个池缓冲区反预乘后写入data
+ */
+bool OpenSlideImage::readDataIntoBuffer(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level, void* data, const unsigned int& zPlane) {
+
+    if (!_isValid) {
+        return false;
+    }
 
+    PipelineProfiler::ScopedTimer timer(PipelineProfiler::ReadDataFromImage, PipelineProfiler::ReadOpenSlide);
+    PipelineTrace::ScopedEvent event("OpenSlideImage::readDataFromImage", startX, startY, level);
     std::shared_lock<std::shared_mutex> l(*_openCloseMutex);
-    unsigned int* temp = new unsigned int[width * height];
-    
+    TileBuffer<unsigned int> temp(width * height);
+    readPremultipliedRegion(startX, startY, width, height, level, temp.get());
+    PixelConversion::premultipliedBGRAToRGB(reinterpret_cast<unsigned char*>(temp.get()), static_cast<unsigned char*>(data),
+        width * height, _bg_r, _bg_g, _bg_b);
+    return true;
+}
 
-    
-    // 激进方案：智能句柄选择策略
-    openslide_t* readSlide = _slide;
-    bool usingTempSlide = false;
-    
-    // 检查主句柄是否可用
-    const char* preError = openslide_get_error(_slide);
-    if (preError) {
-        // qDebug() << "Main slide has error, trying temporary handle...";
-        readSlide = openslide_open(m_filePath.c_str());
-        if (readSlide) {
-            usingTempSlide = true;
-            // qDebug() << "Using temporary slide handle";
-        } else {
-            // qDebug() << "Failed to create temporary handle, using main slide anyway";
-            readSlide = _slide;
-        }
+/**
+ * @brief 读取预乘ARGB区域
+ * @param startX 起始X坐标
+ * @param startY 起始Y坐标
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @param data 输出缓冲区
+ * @details 全零（完全透明）的读取结果是切片的空白区域，保持透明，由调用者与背景色合成为纯色瓦片。
+ *          损坏的区域每个切片只重试一次，之后的请求直接由负缓存得到背景色
+ */
+void OpenSlideImage::readPremultipliedRegion(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level, unsigned int* data) {
+    const RegionKey key(level, startX, startY, width, height);
+    if (isBadRegion(key)) {
+        PipelineProfiler::count(PipelineProfiler::BadRegionSkipped);
+        readAroundBadTiles(startX, startY, width, height, level, data);
+        return;
     }
-    
-    // 读取数据
-    openslide_read_region(readSlide, temp, startX, startY, level, width, height);
-    
-    // 获取错误信息
-    const char* error = openslide_get_error(readSlide);
-    
+    if (tryReadRegion(startX, startY, width, height, level, data)) {
+        return;
+    }
+    recordBadRegion(key);
+    readAroundBadTiles(startX, startY, width, height, level, data);
+}
 
-    
-    // 检查数据有效性（修复后的宽松策略）
-    bool hasValidData = false;
-    int nonZeroCount = 0;
-    int opaqueCount = 0;
-    uint32_t firstNonZero = 0;
-    
-    for (unsigned long long i = 0; i < width * height; ++i) {
-        if (temp[i] != 0) {
-            if (!hasValidData) {
-                firstNonZero = temp[i];
-                hasValidData = true;
-            }
-            nonZeroCount++;
-            
-            unsigned char alpha = (temp[i] >> 24) & 0xff;
-            if (alpha == 255) opaqueCount++;
+/**
+ * @brief 用读取句柄读取一次区域
+ * @param startX 起始X坐标
+ * @param startY 起始Y坐标
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @param data 输出缓冲区
+ * @return 读取是否成功
+ * @details 只有句柄报告错误时才换句柄重试
+ */
+bool OpenSlideImage::tryReadRegion(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level, unsigned int* data) {
+    bool succeeded = false;
+
+    // 句柄的错误状态不可恢复：读取后出错的句柄在归还时被关闭，再租用一个新句柄重试一次
+    for (int attempt = 0; attempt < 2 && !succeeded; ++attempt) {
+        openslide_t* handle = acquireReadHandle();
+        if (!handle) {
+            break;
         }
+        openslide_read_region(handle, data, startX, startY, level, width, height);
+        succeeded = openslide_get_error(handle) == NULL;
+        releaseReadHandle(handle);
     }
-    
-    // 双重保障：如果没有有效数据且还没有使用临时句柄，尝试临时句柄
-    if (!hasValidData && !usingTempSlide) {
-        // qDebug() << "No valid data with main handle, trying temporary handle as fallback...";
-        
-        openslide_t* fallbackSlide = openslide_open(m_filePath.c_str());
-        if (fallbackSlide) {
-            // qDebug() << "Created fallback temporary handle, re-reading...";
-            
-            // 重新读取数据
-            memset(temp, 0, width * height * sizeof(uint32_t));
-            openslide_read_region(fallbackSlide, temp, startX, startY, level, width, height);
-            
-            // 重新检查数据
-            nonZeroCount = 0;
-            opaqueCount = 0;
-            hasValidData = false;
-            
-            for (unsigned long long i = 0; i < width * height; ++i) {
-                if (temp[i] != 0) {
-                    if (!hasValidData) {
-                        firstNonZero = temp[i];
-                        hasValidData = true;
-                    }
-                    nonZeroCount++;
-                    
-                    unsigned char alpha = (temp[i] >> 24) & 0xff;
-                    if (alpha == 255) opaqueCount++;
+    return succeeded;
+}
+
+/**
+ * @brief 绕过损坏的原生瓦片读取区域
+ * @param startX 起始X坐标
+ * @param startY 起始Y坐标
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @param data 输出缓冲区
+ * @details 分块与原生瓦片网格对齐，每块的第0层起点按层级的下采样因子换算
+ */
+void OpenSlideImage::readAroundBadTiles(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level, unsigned int* data) {
+    const unsigned int background = 0xFF000000u | (static_cast<unsigned int>(_bg_r) << 16) | (static_cast<unsigned int>(_bg_g) << 8) | _bg_b;
+    const std::vector<unsigned long long>& tileSize = _levelTileSizes[level];
+    if (tileSize.size() < 2 || tileSize[0] == 0 || tileSize[1] == 0 || (width <= tileSize[0] && height <= tileSize[1])) {
+        std::fill(data, data + width * height, background);
+        return;
+    }
+
+    const double downsample = openslide_get_level_downsample(_slide, level);
+    const long long levelX = std::llround(startX / downsample);
+    const long long levelY = std::llround(startY / downsample);
+    const long long tileWidth = static_cast<long long>(tileSize[0]);
+    const long long tileHeight = static_cast<long long>(tileSize[1]);
+    TileBuffer<unsigned int> piece(tileSize[0] * tileSize[1]);
+    for (long long top = levelY; top < levelY + static_cast<long long>(height);) {
+        const long long bottom = std::min(levelY + static_cast<long long>(height), (top / tileHeight + 1) * tileHeight);
+        for (long long left = levelX; left < levelX + static_cast<long long>(width);) {
+            const long long right = std::min(levelX + static_cast<long long>(width), (left / tileWidth + 1) * tileWidth);
+            const unsigned long long pieceWidth = static_cast<unsigned long long>(right - left);
+            const unsigned long long pieceHeight = static_cast<unsigned long long>(bottom - top);
+            const long long pieceX = startX + std::llround((left - levelX) * downsample);
+            const long long pieceY = startY + std::llround((top - levelY) * downsample);
+            const RegionKey key(level, pieceX, pieceY, pieceWidth, pieceHeight);
+            bool succeeded = !isBadRegion(key);
+            if (succeeded && !tryReadRegion(pieceX, pieceY, pieceWidth, pieceHeight, level, piece.get())) {
+                recordBadRegion(key);
+                succeeded = false;
+            }
+            for (unsigned long long y = 0; y < pieceHeight; ++y) {
+                unsigned int* row = data + (static_cast<unsigned long long>(top - levelY) + y) * width + static_cast<unsigned long long>(left - levelX);
+                if (succeeded) {
+                    std::copy(piece.get() + y * pieceWidth, piece.get() + (y + 1) * pieceWidth, row);
+                }
+                else {
+                    std::fill(row, row + pieceWidth, background);
                 }
             }
-            
-            openslide_close(fallbackSlide);
-            // qDebug() << "Closed fallback temporary handle";
-            
-            // if (hasValidData) {
-            //     qDebug() << "✅ Fallback temporary handle succeeded!";
-            // }
+            left = right;
         }
+        top = bottom;
     }
-    
-    // 清理主要的临时句柄
-    if (usingTempSlide && readSlide) {
-        openslide_close(readSlide);
-        // qDebug() << "Closed temporary slide handle";
+}
+
+/**
+ * @brief 查询区域是否已知损坏
+ * @param key 区域键
+ * @return 是否在负缓存中
+ */
+bool OpenSlideImage::isBadRegion(const RegionKey& key) {
+    std::lock_guard<std::mutex> l(_badRegionMutex);
+    return _badRegions.count(key) != 0;
+}
+
+/**
+ * @brief 把区域记入负缓存
+ * @param key 区域键
+ */
+void OpenSlideImage::recordBadRegion(const RegionKey& key) {
+    std::lock_guard<std::mutex> l(_badRegionMutex);
+    _badRegions.insert(key);
+}
+
+/**
+ * @brief 直接读取预乘ARGB32区域
+ * @param startX 起始X坐标
+ * @param startY 起始Y坐标
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @param data 输出缓冲区（通常为QImage::bits()）
+ * @param zPlane Z平面索引，单平面格式忽略
+ * @return 图像有效时返回true
+ * @details 与PixelConversion::premultipliedBGRAToRGB逐像素相同：不透明像素保持原样，
+ *          全透明像素使用背景色，半透明像素按 c * 255 / a 反预乘，输出完全不透明
+ */
+bool OpenSlideImage::readARGB32DataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level, unsigned int* data, const unsigned int& zPlane) {
+    if (!_isValid || level >= getNumberOfLevels()) {
+        return false;
     }
-    
-    // 记录结果（注释掉详细调试信息）
-    // if (error) {
-    //     qDebug() << "OpenSlide reported error:" << error;
-    // }
-    // qDebug() << "Data analysis: NonZero=" << nonZeroCount << "/" << (width * height) << ", Opaque=" << opaqueCount;
-    
-    if (hasValidData) {
-        // unsigned char a = (firstNonZero >> 24) & 0xff;
-        // unsigned char r = (firstNonZero >> 16) & 0xff;
-        // unsigned char g = (firstNonZero >> 8) & 0xff;
-        // unsigned char b = firstNonZero & 0xff;
-        // qDebug() << "First pixel ARGB:" << (int)a << (int)r << (int)g << (int)b;
-        // qDebug() << "✅ Using valid data" << (error ? " (ignoring error)" : "");
-    } else {
-        // qDebug() << "❌ No valid data found, filling with white";
-        for (unsigned long long i = 0; i < width * height; ++i) {
-            temp[i] = 0xFFFFFFFF;  // 白色ARGB
+
+    // 预乘ARGB直读路径与readDataFromImage同属格式解码阶段
+    PipelineProfiler::ScopedTimer timer(PipelineProfiler::ReadDataFromImage, PipelineProfiler::ReadOpenSlide);
+    PipelineTrace::ScopedEvent event("OpenSlideImage::readARGB32DataFromImage", startX, startY, level);
+    std::shared_lock<std::shared_mutex> l(*_openCloseMutex);
+    readPremultipliedRegion(startX, startY, width, height, level, data);
+
+    const unsigned long long nrPixels = width * height;
+    for (unsigned long long i = 0; i < nrPixels; ++i) {
+        unsigned int pixel = data[i];
+        unsigned int alpha = pixel >> 24;
+        if (alpha == 255) {
+            continue;
+        }
+        if (alpha == 0) {
+            data[i] = 0xFF000000 | (static_cast<unsigned int>(_bg_r) << 16) | (static_cast<unsigned int>(_bg_g) << 8) | _bg_b;
+            continue;
         }
+        unsigned int r = std::min(255u, (255u * ((pixel >> 16) & 0xff)) / alpha);
+        unsigned int g = std::min(255u, (255u * ((pixel >> 8) & 0xff)) / alpha);
+        unsigned int b = std::min(255u, (255u * (pixel & 0xff)) / alpha);
+        data[i] = 0xFF000000 | (r << 16) | (g << 8) | b;
     }
+    return true;
+}
 
-    unsigned char* rgb = new unsigned char[width * height * 3];
-    unsigned char* bgra = (unsigned char*)temp;
-    for (unsigned long long i = 0, j = 0; i < width * height * 4; i += 4, j += 3) {
-        if (bgra[i + 3] == 255) {
-            rgb[j] = bgra[i + 2];
-            rgb[j + 1] = bgra[i + 1];
-            rgb[j + 2] = bgra[i];
+/**
+ * @brief 租用读取句柄
+ * @return OpenSlide句柄，打开失败时返回NULL
+ * @details 打开新句柄时不持有池锁，解析元数据不会阻塞其他线程归还或租用空闲句柄
+ */
+openslide_t* OpenSlideImage::acquireReadHandle() {
+    {
+        std::unique_lock<std::mutex> l(_handlePoolMutex);
+        _handleReleased.wait(l, [this] { return !_idleHandles.empty() || _openHandleCount < _maxHandleCount; });
+        if (!_idleHandles.empty()) {
+            openslide_t* handle = _idleHandles.back();
+            _idleHandles.pop_back();
+            return handle;
         }
-        else if (bgra[i + 3] == 0) {
-            rgb[j] = _bg_r;
-            rgb[j + 1] = _bg_g;
-            rgb[j + 2] = _bg_b;
+        ++_openHandleCount;
+    }
+
+    openslide_t* handle = openReadHandle();
+    if (!handle) {
+        std::lock_guard<std::mutex> l(_handlePoolMutex);
+        --_openHandleCount;
+        _handleReleased.notify_one();
+    }
+    return handle;
+}
+
+/**
+ * @brief 归还读取句柄
+ * @param handle 读取句柄
+ * @details 错误状态的句柄被关闭并释放名额
+ */
+void OpenSlideImage::releaseReadHandle(openslide_t* handle) {
+    bool failed = openslide_get_error(handle) != NULL;
+    if (failed) {
+        openslide_close(handle);
+    }
+    {
+        std::lock_guard<std::mutex> l(_handlePoolMutex);
+        if (failed) {
+            --_openHandleCount;
         }
         else {
-            rgb[j] = (255. * bgra[i + 2]) / bgra[i + 3];
-            rgb[j + 1] = (255. * bgra[i + 1]) / bgra[i + 3];
-            rgb[j + 2] = (255. * bgra[i]) / bgra[i + 3];
+            _idleHandles.push_back(handle);
         }
     }
-    delete[] temp;
+    _handleReleased.notify_one();
+}
 
-    return rgb;
+/**
+ * @brief 打开读取句柄
+ * @return OpenSlide句柄，打开失败时返回NULL
+ */
+openslide_t* OpenSlideImage::openReadHandle() {
+    openslide_t* handle = openslide_open(m_filePath.c_str());
+#ifdef CUSTOM_OPENSLIDE
+    if (handle && _cacheSize > 0) {
+        openslide_set_cache_size(handle, _cacheSize);
+    }
+#endif
+    return handle;
+}
+
+/**
+ * @brief 关闭句柄池
+ * @details 关闭全部空闲句柄，计数只减去实际关闭的句柄数；
+ *          仍被租用的句柄归还后进入空闲列表，名额不会被重复分配
+ */
+void OpenSlideImage::closeReadHandles() {
+    {
+        std::lock_guard<std::mutex> l(_handlePoolMutex);
+        for (openslide_t* handle : _idleHandles) {
+            openslide_close(handle);
+        }
+        _openHandleCount -= static_cast<unsigned int>(_idleHandles.size());
+        _idleHandles.clear();
+    }
+    _handleReleased.notify_all();
 }
 
 /**
  * @brief 清理OpenSlide资源
- * @details 关闭OpenSlide句柄并重置为NULL
+ * @details 关闭句柄池和OpenSlide主句柄并重置为NULL，清空负缓存
  */
 void OpenSlideImage::cleanup() {
+    closeReadHandles();
+    {
+        std::lock_guard<std::mutex> l(_badRegionMutex);
+        _badRegions.clear();
+    }
     if (_slide) {
         openslide_close(_slide);
         _slide = NULL;
@@ -349,37 +556,40 @@ void OpenSlideImage::cleanup() {
  */
 const QImage OpenSlideImage::getLabel()
 {
+    return getAssociatedImage("label");
+}
+
+/**
+ * @brief 获取关联图像
+ * @param name 关联图像名称
+ * @return 关联图像，不存在或读取失败时返回空图像
+ * @details OpenSlide输出预乘ARGB，与QImage::Format_ARGB32_Premultiplied的内存布局相同，
+ *          直接读入图像缓冲区后再转换为非预乘格式
+ */
+const QImage OpenSlideImage::getAssociatedImage(const std::string& name)
+{
+    if (!_slide) {
+        return QImage();
+    }
     const char* const* names = openslide_get_associated_image_names(_slide);
-    for (int i = 0; names[i] != NULL; i++)
+    for (int i = 0; names && names[i] != NULL; i++)
     {
-        if (strcmp(names[i], "label") == 0)
+        if (name == names[i])
         {
-            int64_t w, h;
-            // 获取label图尺寸
-            openslide_get_associated_image_dimensions(_slide, "label", &w, &h);
-            // 分配内存
-            uint32_t* buffer = (uint32_t*)malloc(4 * w * h);
-            // 读取label图到内存
-            openslide_read_associated_image(_slide, "label", buffer);
-
-            // 创建 QImage 对象
-            QImage labelImage(w, h, QImage::Format_ARGB32);
-
-            for (int y = 0; y < h; ++y) {
-                for (int x = 0; x < w; ++x) {
-                    uint32_t pixel = buffer[y * w + x];
-                    // 提取 ARGB 通道
-                    unsigned char a = (pixel >> 24) & 0xff;
-                    unsigned char r = (pixel >> 16) & 0xff;
-                    unsigned char g = (pixel >> 8) & 0xff;
-                    unsigned char b = pixel & 0xff;
-                    // 存储到 QImage 中
-                    labelImage.setPixel(x, y, qRgba(r, g, b, a));
-                }
+            int64_t w = 0, h = 0;
+            openslide_get_associated_image_dimensions(_slide, names[i], &w, &h);
+            if (w <= 0 || h <= 0) {
+                return QImage();
+            }
+            QImage image(w, h, QImage::Format_ARGB32_Premultiplied);
+            if (image.isNull()) {
+                return QImage();
+            }
+            openslide_read_associated_image(_slide, names[i], reinterpret_cast<uint32_t*>(image.bits()));
+            if (openslide_get_error(_slide) != NULL) {
+                return QImage();
             }
-            free(buffer);
-            
-            return labelImage;
+            return image.convertToFormat(QImage::Format_ARGB32);
         }
     }
     return QImage();
@@ -10,6 +10,7 @@
  *          - 多分辨率图像数据的访问
  *          - 图像元数据和属性的获取
  *          - 背景色和错误状态管理
+ *          - 损坏瓦片区域的负缓存
  *          该类是DSV项目中图像数据访问的核心实现，
  *          支持Aperio、Hamamatsu、Leica等扫描仪生成的数字病理图像格式。
  *
@@ -20,6 +21,11 @@
 #pragma once
 #include "MultiResolutionImage.h"
 #include <QImage>
+#include <mutex>
+#include <condition_variable>
+#include <set>
+#include <tuple>
+#include <vector>
 
  // OpenSlide库的前向声明
 struct _openslide;
@@ -177,6 +183,16 @@ public:
      */
     const QImage getLabel();
 
+    /**
+     * @brief   获取关联图像
+     * @details 读取OpenSlide关联图像（label、macro、thumbnail等，随厂商格式不同）
+     *
+     * @param   name 关联图像名称
+     * @return  QImage格式的关联图像，不存在时返回空图像
+     * @see     openslide_get_associated_image_names
+     */
+    const QImage getAssociatedImage(const std::string& name);
+
     /**
      * @brief   获取图像属性列表
      * @details 获取OpenSlide图像的所有元数据属性，包括扫描仪信息、
@@ -195,7 +211,40 @@ public:
      */
     const std::vector<SlideColorManagement::PropertyInfo> getProperties();
 
+    /**
+     * @brief   获取切片背景色
+     * @details 来自openslide.background-color属性，未提供时为白色
+     * @see     MultiResolutionImage::getBackgroundColor
+     */
+    void getBackgroundColor(unsigned char& r, unsigned char& g, unsigned char& b) const override;
+
+    /**
+     * @brief   获取切片的ICC颜色配置文件
+     * @details 需要OpenSlide 4.0，由openslide_read_icc_profile读取
+     * @see     MultiResolutionImage::getICCProfile
+     */
+    std::vector<unsigned char> getICCProfile() override;
+
 protected:
+    /**
+     * @brief   直接读取预乘ARGB32区域
+     * @details openslide_read_region的输出本身就是预乘ARGB，与QImage::Format_ARGB32_Premultiplied
+     *          内存布局一致，因此直接写入调用者缓冲区。非不透明像素在同一遍中按RGB路径的规则处理：
+     *          全透明像素使用背景色，半透明像素反预乘，输出完全不透明，与RGB路径逐像素相同。
+     *
+     * @param   startX 起始X坐标（第0层像素）
+     * @param   startY 起始Y坐标（第0层像素）
+     * @param   width 区域宽度
+     * @param   height 区域高度
+     * @param   level 层级索引
+     * @param   data 输出缓冲区，至少width*height个32位像素
+     * @param   zPlane Z平面索引，OpenSlide只有一个Z平面，忽略该参数
+     * @return  图像有效时返回true
+     * @see     MultiResolutionImage::getARGB32Region, MultiResolutionImage::readARGB32DataFromImage
+     */
+    bool readARGB32DataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, unsigned int* data, const unsigned int& zPlane);
+
     /**
      * @brief   清理资源
      * @details 清理OpenSlide库句柄和相关资源，释放内存。
@@ -216,7 +265,7 @@ protected:
      * @param   width 区域宽度
      * @param   height 区域高度
      * @param   level 层级索引
-     * @return  指向原始数据的void指针，调用者负责释放内存
+     * @return  指向原始数据的void指针，从TileBufferPool分配，调用者负责归还
      * @note    该函数是纯虚函数的重写实现
      * @see     openslide_read_region, getRawRegion
      * @example
@@ -224,16 +273,150 @@ protected:
      *          void* data = image.readDataFromImage(0, 0, 512, 512, 0);
      *          if (data) {
      *              // 使用数据...
-     *              delete[] data;
+     *              TileBufferPool::release(data);
      *          }
      */
     void* readDataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
         const unsigned long long& height, const unsigned int& level);
 
+    /**
+     * @brief   把区域数据解码到调用者的缓冲区
+     * @details 与readDataFromImage相同，但直接写入data，省去返回缓冲区和一次复制；预乘BGRA中间数据使用池缓冲区
+     * @return  图像有效时返回true
+     */
+    bool readDataIntoBuffer(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, void* data, const unsigned int& zPlane);
+
     /** @brief OpenSlide库句柄，用于与OpenSlide库交互 */
     openslide_t* _slide;
 
 private:
+    /**
+     * @brief 区域键：层级、第0层起点、层级宽高
+     */
+    typedef std::tuple<unsigned int, long long, long long, unsigned long long, unsigned long long> RegionKey;
+
+    /**
+     * @brief   读取预乘ARGB区域到缓冲区
+     * @details 负缓存中已知损坏的区域不再读取；其余区域经tryReadRegion读取，
+     *          重试后仍失败时记入负缓存，再由readAroundBadTiles按原生瓦片读取其中完好的部分
+     *
+     * @param   startX 起始X坐标
+     * @param   startY 起始Y坐标
+     * @param   width 区域宽度
+     * @param   height 区域高度
+     * @param   level 层级索引
+     * @param   data 输出缓冲区
+     * @note    调用者需持有_openCloseMutex的共享锁
+     */
+    void readPremultipliedRegion(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, unsigned int* data);
+
+    /**
+     * @brief   用读取句柄读取一次区域
+     * @details 从句柄池租用一个句柄读取；读取后句柄进入错误状态时丢弃该句柄，用新句柄重试一次
+     *
+     * @param   startX 起始X坐标
+     * @param   startY 起始Y坐标
+     * @param   width 区域宽度
+     * @param   height 区域高度
+     * @param   level 层级索引
+     * @param   data 输出缓冲区
+     * @return  读取成功时返回true，失败时data的内容未定义
+     */
+    bool tryReadRegion(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, unsigned int* data);
+
+    /**
+     * @brief   绕过损坏的原生瓦片读取区域
+     * @details 区域不超过一个原生瓦片或原生瓦片尺寸未知时整体填充为不透明背景色；
+     *          否则按原生瓦片网格分块读取，损坏的块记入负缓存并填充背景色，
+     *          合并读取中只有一个瓦片损坏时其余瓦片仍正常显示
+     *
+     * @param   startX 起始X坐标
+     * @param   startY 起始Y坐标
+     * @param   width 区域宽度
+     * @param   height 区域高度
+     * @param   level 层级索引
+     * @param   data 输出缓冲区
+     */
+    void readAroundBadTiles(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, unsigned int* data);
+
+    /**
+     * @brief   查询区域是否已知损坏
+     * @param   key 区域键
+     * @return  区域在负缓存中时返回true
+     */
+    bool isBadRegion(const RegionKey& key);
+
+    /**
+     * @brief   把区域记入负缓存
+     * @param   key 区域键
+     */
+    void recordBadRegion(const RegionKey& key);
+
+    /**
+     * @brief   从句柄池租用读取句柄
+     * @details 优先返回空闲句柄；池未满时打开新句柄；池已满时等待其他线程归还。
+     *          每个工作线程同一时刻只持有一个句柄，并发读取互不共享OpenSlide内部锁
+     *
+     * @return  OpenSlide句柄，打开失败时返回NULL
+     * @note    调用者需持有_openCloseMutex的共享锁
+     * @see     releaseReadHandle
+     */
+    openslide_t* acquireReadHandle();
+
+    /**
+     * @brief   归还读取句柄
+     * @details 健康的句柄放回空闲列表；处于错误状态的句柄直接关闭，
+     *          空出的名额由下次租用时重新打开
+     *
+     * @param   handle 由acquireReadHandle返回的句柄
+     * @see     acquireReadHandle
+     */
+    void releaseReadHandle(openslide_t* handle);
+
+    /**
+     * @brief   打开一个新的读取句柄
+     * @return  OpenSlide句柄，打开失败时返回NULL
+     * @note    会应用setCacheSize设置的缓存大小
+     */
+    openslide_t* openReadHandle();
+
+    /**
+     * @brief   关闭句柄池中的全部句柄
+     * @note    调用者需持有_openCloseMutex的独占锁，此时没有在途读取
+     */
+    void closeReadHandles();
+
+    /** @brief 句柄池互斥锁 */
+    std::mutex _handlePoolMutex;
+
+    /** @brief 句柄归还通知 */
+    std::condition_variable _handleReleased;
+
+    /** @brief 空闲句柄列表 */
+    std::vector<openslide_t*> _idleHandles;
+
+    /** @brief 已打开（空闲+租出）的句柄数量 */
+    unsigned int _openHandleCount;
+
+    /** @brief 句柄池容量上限，默认为硬件线程数 */
+    unsigned int _maxHandleCount;
+
+    /** @brief 负缓存互斥锁 */
+    std::mutex _badRegionMutex;
+
+    /**
+     * @brief 负缓存：读取失败过的区域
+     * @details 切片重新打开前不会恢复，区域被淘汰后再次读取时直接得到背景色，不再经历出错、重开句柄和重试
+     */
+    std::set<RegionKey> _badRegions;
+
+    /** @brief OpenSlide缓存大小，0表示使用库默认值 */
+    unsigned long long _cacheSize;
+
     /** @brief OpenSlide错误状态字符串，记录最近的错误信息 */
     std::string _errorState;
 
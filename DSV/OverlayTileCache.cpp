@@ -0,0 +1,218 @@
+﻿/**
+ * @file    OverlayTileCache.cpp
+ * @brief   叠加层（前景）瓦片缓存实现
+ * @author  [JianZhang]
+ * @date    2025-01-19
+ * @version 1.0.0
+ */
+
+#include "OverlayTileCache.h"
+#include "ImageSource.h"
+#include <functional>
+
+/**
+ * @brief 计算缓存键的哈希值
+ * @param key 缓存键
+ * @return 哈希值
+ */
+size_t OverlayTileCache::KeyHash::operator()(const Key& key) const
+{
+    size_t seed = std::hash<const void*>()(key.img);
+    auto combine = [&seed](size_t value) { seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2); };
+    combine(std::hash<float>()(key.scale));
+    combine(std::hash<unsigned int>()(key.level));
+    combine(std::hash<long long>()(key.tileX));
+    combine(std::hash<long long>()(key.tileY));
+    combine(std::hash<unsigned int>()(key.tileSize));
+    return seed;
+}
+
+/**
+ * @brief 构造函数
+ * @param maxByteSize 缓存上限（字节）
+ */
+OverlayTileCache::OverlayTileCache(unsigned long long maxByteSize) :
+    _cacheSize(0),
+    _maxCacheSize(maxByteSize)
+{
+}
+
+/**
+ * @brief 析构函数
+ */
+OverlayTileCache::~OverlayTileCache()
+{
+    clear();
+}
+
+/**
+ * @brief 获取缓存的前景源数据
+ * @return 源数据，未命中时为空
+ */
+std::shared_ptr<ImageSource> OverlayTileCache::getSource(const std::shared_ptr<MultiResolutionImage>& img, float scale, unsigned int level,
+    long long tileX, long long tileY, unsigned int tileSize)
+{
+    std::lock_guard<std::mutex> locker(_mutex);
+    EntryMap::iterator it = touch(Key{ img.get(), scale, level, tileX, tileY, tileSize }, img);
+    return it == _entries.end() ? std::shared_ptr<ImageSource>() : it->second.source;
+}
+
+/**
+ * @brief 存入前景源数据
+ * @details 新条目放在LRU链表头部，随后按上限淘汰
+ */
+void OverlayTileCache::setSource(const std::shared_ptr<MultiResolutionImage>& img, float scale, unsigned int level,
+    long long tileX, long long tileY, unsigned int tileSize, std::shared_ptr<ImageSource> source)
+{
+    if (!img || !source) {
+        return;
+    }
+    std::lock_guard<std::mutex> locker(_mutex);
+    const Key key{ img.get(), scale, level, tileX, tileY, tileSize };
+    EntryMap::iterator it = touch(key, img);
+    if (it == _entries.end()) {
+        _lru.push_front(key);
+        it = _entries.emplace(key, Entry()).first;
+        it->second.img = img;
+        it->second.lruPosition = _lru.begin();
+    }
+    it->second.source = source;
+    it->second.rendered = QImage();
+    updateBytes(it->second);
+    evict();
+}
+
+/**
+ * @brief 获取缓存的渲染结果
+ * @return 是否命中
+ */
+bool OverlayTileCache::getRendered(const std::shared_ptr<MultiResolutionImage>& img, float scale, unsigned int level,
+    long long tileX, long long tileY, unsigned int tileSize, unsigned int generation, QImage& image)
+{
+    std::lock_guard<std::mutex> locker(_mutex);
+    EntryMap::iterator it = touch(Key{ img.get(), scale, level, tileX, tileY, tileSize }, img);
+    if (it == _entries.end() || it->second.rendered.isNull() || it->second.generation != generation) {
+        return false;
+    }
+    image = it->second.rendered;
+    return true;
+}
+
+/**
+ * @brief 存入渲染结果
+ * @details 只更新已有源数据的条目
+ */
+void OverlayTileCache::setRendered(const std::shared_ptr<MultiResolutionImage>& img, float scale, unsigned int level,
+    long long tileX, long long tileY, unsigned int tileSize, unsigned int generation, const QImage& image)
+{
+    if (!img || image.isNull()) {
+        return;
+    }
+    std::lock_guard<std::mutex> locker(_mutex);
+    EntryMap::iterator it = touch(Key{ img.get(), scale, level, tileX, tileY, tileSize }, img);
+    if (it == _entries.end()) {
+        return;
+    }
+    it->second.rendered = image;
+    it->second.generation = generation;
+    updateBytes(it->second);
+    evict();
+}
+
+/**
+ * @brief 设置缓存上限
+ * @param maxByteSize 上限（字节）
+ */
+void OverlayTileCache::setMaxCacheSize(unsigned long long maxByteSize)
+{
+    std::lock_guard<std::mutex> locker(_mutex);
+    _maxCacheSize = maxByteSize;
+    evict();
+}
+
+/**
+ * @brief 获取缓存上限
+ * @return 上限（字节）
+ */
+unsigned long long OverlayTileCache::getMaxCacheSize() const
+{
+    std::lock_guard<std::mutex> locker(_mutex);
+    return _maxCacheSize;
+}
+
+/**
+ * @brief 获取当前缓存的字节数
+ * @return 字节数
+ */
+unsigned long long OverlayTileCache::currentCacheSize() const
+{
+    std::lock_guard<std::mutex> locker(_mutex);
+    return _cacheSize;
+}
+
+/**
+ * @brief 清空缓存
+ */
+void OverlayTileCache::clear()
+{
+    std::lock_guard<std::mutex> locker(_mutex);
+    _entries.clear();
+    _lru.clear();
+    _cacheSize = 0;
+}
+
+/**
+ * @brief 查找存活的条目并移到LRU链表头部
+ * @param key 缓存键
+ * @param img 前景图像，用于校验条目中的弱引用
+ * @return 条目迭代器，未命中时为end()
+ */
+OverlayTileCache::EntryMap::iterator OverlayTileCache::touch(const Key& key, const std::shared_ptr<MultiResolutionImage>& img)
+{
+    EntryMap::iterator it = _entries.find(key);
+    if (it == _entries.end()) {
+        return it;
+    }
+    // 地址相同但图像已经换了一个，旧条目作废
+    if (it->second.img.lock() != img) {
+        erase(it);
+        return _entries.end();
+    }
+    _lru.splice(_lru.begin(), _lru, it->second.lruPosition);
+    return it;
+}
+
+/**
+ * @brief 重新计算条目字节数并更新总量
+ * @param entry 条目
+ */
+void OverlayTileCache::updateBytes(Entry& entry)
+{
+    _cacheSize -= entry.bytes;
+    entry.bytes = entry.source ? entry.source->getByteSize() : 0;
+    if (!entry.rendered.isNull()) {
+        entry.bytes += static_cast<unsigned long long>(entry.rendered.width()) * entry.rendered.height() * entry.rendered.depth() / 8;
+    }
+    _cacheSize += entry.bytes;
+}
+
+/**
+ * @brief 删除条目
+ * @param it 条目迭代器
+ */
+void OverlayTileCache::erase(EntryMap::iterator it)
+{
+    _cacheSize -= it->second.bytes;
+    _lru.erase(it->second.lruPosition);
+    _entries.erase(it);
+}
+
+/**
+ * @brief 淘汰最久未使用的条目直到不超过上限
+ */
+void OverlayTileCache::evict()
+{
+    while (_cacheSize > _maxCacheSize && !_lru.empty()) {
+        erase(_entries.find(_lru.back()));
+    }
+}
@@ -0,0 +1,174 @@
+﻿/**
+ * @file    OverlayTileCache.h
+ * @brief   叠加层（前景）瓦片缓存
+ * @author  [JianZhang]
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 按（前景图像，层级，瓦片坐标）缓存前景瓦片的源数据和渲染结果，
+ *          与背景瓦片的生命周期无关，供所有IOWorker共享
+ * @see     IOWorker, IOThread
+ */
+
+#pragma once
+#include <QImage>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+class MultiResolutionImage;
+class ImageSource;
+
+/**
+ * @class  OverlayTileCache
+ * @brief  线程安全的前景瓦片缓存
+ * @details 每个条目保存前景Patch和一次渲染结果，渲染结果附带叠加层外观代（前景通道或LUT改变时递增），
+ *          代不符时只需用缓存的源数据重新渲染。
+ *          条目按最近最少使用顺序淘汰，总字节数不超过上限。
+ *          因此切换前景渲染开关、调整不透明度、重新加载背景或在两个分析结果之间来回切换时，
+ *          前景瓦片不必重新读取和渲染。
+ *
+ *          条目以前景图像的地址为键，同时保存其弱引用，命中时校验图像仍然存活，
+ *          避免图像释放后地址被复用而返回错误的数据。
+ *
+ * @example
+ *          std::shared_ptr<OverlayTileCache> cache = std::make_shared<OverlayTileCache>();
+ *          std::shared_ptr<ImageSource> source = cache->getSource(img, scale, level, x, y, tileSize);
+ *          if (!source) {
+ *              cache->setSource(img, scale, level, x, y, tileSize, std::shared_ptr<ImageSource>(readTile()));
+ *          }
+ */
+class OverlayTileCache
+{
+public:
+    /**
+     * @brief   构造函数
+     * @param   maxByteSize 缓存上限（字节）
+     */
+    explicit OverlayTileCache(unsigned long long maxByteSize = kDefaultMaxByteSize);
+
+    /**
+     * @brief   析构函数
+     */
+    ~OverlayTileCache();
+
+    /**
+     * @brief   获取缓存的前景源数据
+     * @param   img      前景图像
+     * @param   scale    前景图像相对于背景图像的缩放因子
+     * @param   level    背景层级
+     * @param   tileX    瓦片X坐标
+     * @param   tileY    瓦片Y坐标
+     * @param   tileSize 背景瓦片大小
+     * @return  源数据，未命中时为空。返回的对象由多个线程共享，只能读取或clone
+     */
+    std::shared_ptr<ImageSource> getSource(const std::shared_ptr<MultiResolutionImage>& img, float scale, unsigned int level,
+        long long tileX, long long tileY, unsigned int tileSize);
+
+    /**
+     * @brief   存入前景源数据
+     * @details 已有条目时替换源数据并丢弃其渲染结果
+     * @param   source 源数据，为空时忽略
+     */
+    void setSource(const std::shared_ptr<MultiResolutionImage>& img, float scale, unsigned int level,
+        long long tileX, long long tileY, unsigned int tileSize, std::shared_ptr<ImageSource> source);
+
+    /**
+     * @brief   获取缓存的渲染结果
+     * @param   generation 叠加层外观代，与缓存的代不同时视为未命中
+     * @param   image      输出的渲染图像（隐式共享，复制开销很小）
+     * @return  是否命中
+     */
+    bool getRendered(const std::shared_ptr<MultiResolutionImage>& img, float scale, unsigned int level,
+        long long tileX, long long tileY, unsigned int tileSize, unsigned int generation, QImage& image);
+
+    /**
+     * @brief   存入渲染结果
+     * @details 只更新已有源数据的条目，没有源数据的条目无法在外观改变后重新渲染，因此不单独缓存渲染结果
+     * @param   generation 渲染所用的叠加层外观代
+     */
+    void setRendered(const std::shared_ptr<MultiResolutionImage>& img, float scale, unsigned int level,
+        long long tileX, long long tileY, unsigned int tileSize, unsigned int generation, const QImage& image);
+
+    /**
+     * @brief   设置缓存上限
+     * @param   maxByteSize 上限（字节），超出部分立即淘汰
+     */
+    void setMaxCacheSize(unsigned long long maxByteSize);
+
+    /** @brief 获取缓存上限（字节） */
+    unsigned long long getMaxCacheSize() const;
+
+    /** @brief 获取当前缓存的字节数 */
+    unsigned long long currentCacheSize() const;
+
+    /** @brief 清空缓存 */
+    void clear();
+
+    /** @brief 默认缓存上限 */
+    static const unsigned long long kDefaultMaxByteSize = 256ULL * 1024 * 1024;
+
+private:
+    /** @brief 缓存键 */
+    struct Key {
+        const MultiResolutionImage* img;
+        float scale;
+        unsigned int level;
+        long long tileX;
+        long long tileY;
+        unsigned int tileSize;
+
+        bool operator==(const Key& other) const {
+            return img == other.img && scale == other.scale && level == other.level &&
+                tileX == other.tileX && tileY == other.tileY && tileSize == other.tileSize;
+        }
+    };
+
+    /** @brief 缓存键的哈希函数 */
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    /** @brief 缓存条目 */
+    struct Entry {
+        std::weak_ptr<MultiResolutionImage> img;    ///< 用于校验图像仍然存活
+        std::shared_ptr<ImageSource> source;        ///< 前景源数据
+        QImage rendered;                            ///< 显示格式的渲染结果，可能为空；用QImage以便在工作线程之间共享
+        unsigned int generation = 0;                ///< 渲染结果对应的叠加层外观代
+        unsigned long long bytes = 0;               ///< 源数据和渲染结果的字节数
+        std::list<Key>::iterator lruPosition;       ///< 在LRU链表中的位置
+    };
+
+    typedef std::unordered_map<Key, Entry, KeyHash> EntryMap;
+
+    /**
+     * @brief   查找存活的条目并移到LRU链表头部
+     * @return  条目迭代器，未命中或图像已释放时为end()（已释放的条目同时被删除）
+     * @note    调用者必须持有_mutex
+     */
+    EntryMap::iterator touch(const Key& key, const std::shared_ptr<MultiResolutionImage>& img);
+
+    /** @brief 重新计算条目字节数并更新总量 */
+    void updateBytes(Entry& entry);
+
+    /** @brief 删除条目 */
+    void erase(EntryMap::iterator it);
+
+    /** @brief 淘汰最久未使用的条目直到不超过上限 */
+    void evict();
+
+    /** @brief 条目表 */
+    EntryMap _entries;
+
+    /** @brief LRU链表，头部为最近使用 */
+    std::list<Key> _lru;
+
+    /** @brief 当前字节数 */
+    unsigned long long _cacheSize;
+
+    /** @brief 缓存上限 */
+    unsigned long long _maxCacheSize;
+
+    /** @brief 保护所有成员 */
+    mutable std::mutex _mutex;
+};
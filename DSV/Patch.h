@@ -7,9 +7,11 @@
  * @details 该文件实现了DSV项目的图像块数据结构，包括：
  *          - 模板化图像数据容器
  *          - 多维数组支持和步长计算
- *          - 算术运算符重载
+ *          - 基于表达式模板的标量算术运算，连续运算一次遍历求值到目标缓冲区
+ *          - 移动构造和移动赋值
  *          - 内存管理和所有权控制
  *          - 图像元数据管理（最小值、最大值、间距等）
+ *          - 按通道缓存的最小值/最大值，一次SIMD遍历得到，修改数据的操作使缓存失效
  *          - 支持多种颜色类型和数据类型
  *          该类是DSV项目中图像数据处理的核心数据结构，
  *          用于封装从多分辨率图像中提取的图像块数据。
@@ -22,6 +24,121 @@
 #include <vector>
 #include "ImageSource.h"
 
+template<typename T> class Patch;
+
+/**
+ * @namespace PatchExpression
+ * @brief     图像块标量运算的表达式模板
+ * @details   Patch的 * / + - 运算符不立即计算，而是返回记录运算链的表达式对象；
+ *            表达式构造或赋值给Patch时，在一次遍历中逐元素求值并写入目标缓冲区，
+ *            不为中间结果分配缓冲区。每一步运算的结果都转换为T，
+ *            因此(p - mean) / std * 255与逐个运算符求值的结果完全相同。
+ *
+ * @note      表达式通过指针引用源图像块，只能在同一条语句中使用，不要用auto保存表达式
+ * @example
+ *            Patch<float> normalized = (patch - mean) / std * 255.f; // 一次分配、一次遍历
+ *            patch = patch * 2.f;                                      // 拥有数据时就地求值
+ * @see       Patch
+ */
+namespace PatchExpression {
+
+    /** @brief 乘法 */
+    struct Multiply {
+        template<typename T>
+        static T apply(const T& a, const T& b) { return static_cast<T>(a * b); }
+    };
+
+    /** @brief 除法 */
+    struct Divide {
+        template<typename T>
+        static T apply(const T& a, const T& b) { return static_cast<T>(a / b); }
+    };
+
+    /** @brief 加法 */
+    struct Add {
+        template<typename T>
+        static T apply(const T& a, const T& b) { return static_cast<T>(a + b); }
+    };
+
+    /** @brief 减法 */
+    struct Subtract {
+        template<typename T>
+        static T apply(const T& a, const T& b) { return static_cast<T>(a - b); }
+    };
+
+    /**
+     * @class  Terminal
+     * @brief  表达式的叶子，引用一个图像块的数据
+     * @tparam T 样本类型
+     */
+    template<typename T>
+    class Terminal {
+    public:
+        typedef T value_type;
+
+        explicit Terminal(const Patch<T>& patch) : _patch(&patch), _data(patch.getPointer()) {}
+
+        /** @brief 第i个样本 */
+        T operator[](unsigned long long i) const { return _data[i]; }
+
+        /** @brief 提供尺寸和元数据的源图像块 */
+        const Patch<T>& source() const { return *_patch; }
+
+    private:
+        const Patch<T>* _patch;
+        const T* _data;
+    };
+
+    /**
+     * @class  ScalarOperation
+     * @brief  子表达式与标量的运算
+     * @tparam E 子表达式类型，Terminal或ScalarOperation
+     * @tparam Op 运算，Multiply、Divide、Add或Subtract
+     * @details 子表达式按值保存（只有指针和标量），整条运算链在求值时内联为一个循环
+     */
+    template<typename E, typename Op>
+    class ScalarOperation {
+    public:
+        typedef typename E::value_type value_type;
+
+        ScalarOperation(const E& expression, const value_type& value) : _expression(expression), _value(value) {}
+
+        /** @brief 第i个样本的运算结果 */
+        value_type operator[](unsigned long long i) const { return Op::apply(_expression[i], _value); }
+
+        /** @brief 提供尺寸和元数据的源图像块 */
+        const Patch<value_type>& source() const { return _expression.source(); }
+
+    private:
+        E _expression;
+        value_type _value;
+    };
+
+    /** @brief 表达式乘以标量 */
+    template<typename E, typename Op>
+    ScalarOperation<ScalarOperation<E, Op>, Multiply> operator*(const ScalarOperation<E, Op>& expression, const typename E::value_type& value) {
+        return ScalarOperation<ScalarOperation<E, Op>, Multiply>(expression, value);
+    }
+
+    /** @brief 表达式除以标量 */
+    template<typename E, typename Op>
+    ScalarOperation<ScalarOperation<E, Op>, Divide> operator/(const ScalarOperation<E, Op>& expression, const typename E::value_type& value) {
+        return ScalarOperation<ScalarOperation<E, Op>, Divide>(expression, value);
+    }
+
+    /** @brief 表达式加标量 */
+    template<typename E, typename Op>
+    ScalarOperation<ScalarOperation<E, Op>, Add> operator+(const ScalarOperation<E, Op>& expression, const typename E::value_type& value) {
+        return ScalarOperation<ScalarOperation<E, Op>, Add>(expression, value);
+    }
+
+    /** @brief 表达式减标量 */
+    template<typename E, typename Op>
+    ScalarOperation<ScalarOperation<E, Op>, Subtract> operator-(const ScalarOperation<E, Op>& expression, const typename E::value_type& value) {
+        return ScalarOperation<ScalarOperation<E, Op>, Subtract>(expression, value);
+    }
+}
+
  /**
   * @class  Patch
   * @brief  图像块模板类，封装图像数据片段和元信息
@@ -46,8 +163,8 @@
   *          Patch<unsigned char> patch(dims, SlideColorManagement::ColorType::RGB);
   *          patch.fill(128); // 填充灰度值
   *
-  *          // 算术运算
-  *          Patch<unsigned char> result = patch * 2;
+  *          // 算术运算，整条运算链一次遍历求值
+  *          Patch<unsigned char> result = patch * 2 + 10;
   * @see     ImageSource, MultiResolutionImage
   */
 template<typename T>
@@ -75,6 +192,21 @@ private:
     /** @brief WSI图像各通道的最大值 */
     std::vector<double> _wsiMaxValues;
 
+    /** @brief 图像块各通道的最小值缓存，_statisticsValid为false时无效 */
+    mutable std::vector<double> _channelMinValues;
+
+    /** @brief 图像块各通道的最大值缓存 */
+    mutable std::vector<double> _channelMaxValues;
+
+    /** @brief 通道统计缓存是否有效 */
+    mutable bool _statisticsValid;
+
+    /**
+     * @brief   计算通道统计
+     * @details 缓存无效时用PixelConversion::channelMinMax一次遍历计算所有通道的最小值和最大值
+     */
+    void updateStatistics() const;
+
     /**
      * @brief   计算步长数组
      * @details 根据维度数组计算多维数组的步长，用于高效的索引计算
@@ -92,6 +224,17 @@ private:
      */
     void swap(Patch<T>& first, Patch<T>& second);
 
+    /**
+     * @brief   对表达式求值并写入当前对象
+     * @details 当前对象拥有与结果大小相同的缓冲区时就地写入（表达式的源可以是当前对象），
+     *          否则分配新缓冲区；尺寸、颜色类型等元数据取自表达式的源图像块
+     *
+     * @param   expression 表达式
+     * @note    不拥有数据的图像块不会被写入，求值后拥有新的缓冲区，与拷贝赋值一致
+     */
+    template<typename E>
+    void assign(const E& expression);
+
 public:
     /**
      * @brief   默认构造函数
@@ -114,6 +257,14 @@ public:
      */
     Patch(const Patch& rhs);
 
+    /**
+     * @brief   移动构造函数
+     * @details 接管rhs的缓冲区和元数据，不复制数据
+     *
+     * @param   rhs 要移动的Patch对象，之后为空图像块
+     */
+    Patch(Patch&& rhs) noexcept;
+
     /**
      * @brief   拷贝赋值操作符
      * @details 使用拷贝交换技术实现异常安全的赋值操作
@@ -122,7 +273,37 @@ public:
      * @return  当前对象的引用
      * @note    使用拷贝交换技术确保异常安全
      */
-    Patch& operator=(const Patch rhs);
+    Patch& operator=(const Patch& rhs);
+
+    /**
+     * @brief   移动赋值操作符
+     * @details 与rhs交换内容，原缓冲区随rhs析构释放
+     *
+     * @param   rhs 要移动的Patch对象
+     * @return  当前对象的引用
+     */
+    Patch& operator=(Patch&& rhs) noexcept;
+
+    /**
+     * @brief   从表达式构造
+     * @details 分配一个缓冲区并一次遍历求值
+     *
+     * @param   expression 运算符返回的表达式
+     * @see     PatchExpression
+     */
+    template<typename E, typename Op>
+    Patch(const PatchExpression::ScalarOperation<E, Op>& expression);
+
+    /**
+     * @brief   表达式赋值操作符
+     * @details 一次遍历求值，当前对象拥有大小相同的缓冲区时不分配内存
+     *
+     * @param   expression 运算符返回的表达式
+     * @return  当前对象的引用
+     * @see     assign
+     */
+    template<typename E, typename Op>
+    Patch& operator=(const PatchExpression::ScalarOperation<E, Op>& expression);
 
     /**
      * @brief   带参数的构造函数
@@ -134,7 +315,8 @@ public:
      * @param   ownData 数据所有权标志，默认为true
      * @param   wsiMinValues WSI图像各通道的最小值
      * @param   wsiMaxValues WSI图像各通道的最大值
-     * @note    如果data为NULL且ownData为true，会自动分配内存
+     * @note    如果data为NULL且ownData为true，会自动分配内存；
+     *          ownData为true时data必须来自TileBufferPool，析构时归还到池中
      * @see     SlideColorManagement::ColorType
      */
     Patch(const std::vector<unsigned long long>& dimensions, const SlideColorManagement::ColorType& ctype = SlideColorManagement::ColorType::Monochrome, T* data = NULL, bool ownData = true, std::vector<double> wsiMinValues = std::vector<double>(), std::vector<double> wsiMaxValues = std::vector<double>());
@@ -154,10 +336,10 @@ public:
      * @details 将图像块的所有像素值与标量相乘
      *
      * @param   val 标量值
-     * @return  新的Patch对象，包含乘法结果
+     * @return  乘法表达式，构造或赋值给Patch时求值
      * @note    原对象不会被修改
      */
-    Patch<T> operator*(const T& val);
+    PatchExpression::ScalarOperation<PatchExpression::Terminal<T>, PatchExpression::Multiply> operator*(const T& val) const;
 
     /**
      * @brief   乘法赋值运算符（标量）
@@ -173,10 +355,10 @@ public:
      * @details 将图像块的所有像素值与标量相除
      *
      * @param   val 标量值
-     * @return  新的Patch对象，包含除法结果
+     * @return  除法表达式，构造或赋值给Patch时求值
      * @note    原对象不会被修改
      */
-    Patch<T> operator/(const T& val);
+    PatchExpression::ScalarOperation<PatchExpression::Terminal<T>, PatchExpression::Divide> operator/(const T& val) const;
 
     /**
      * @brief   除法赋值运算符（标量）
@@ -192,10 +374,10 @@ public:
      * @details 将图像块的所有像素值与标量相加
      *
      * @param   val 标量值
-     * @return  新的Patch对象，包含加法结果
+     * @return  加法表达式，构造或赋值给Patch时求值
      * @note    原对象不会被修改
      */
-    Patch<T> operator+(const T& val);
+    PatchExpression::ScalarOperation<PatchExpression::Terminal<T>, PatchExpression::Add> operator+(const T& val) const;
 
     /**
      * @brief   加法赋值运算符（标量）
@@ -211,10 +393,10 @@ public:
      * @details 将图像块的所有像素值与标量相减
      *
      * @param   val 标量值
-     * @return  新的Patch对象，包含减法结果
+     * @return  减法表达式，构造或赋值给Patch时求值
      * @note    原对象不会被修改
      */
-    Patch<T> operator-(const T& val);
+    PatchExpression::ScalarOperation<PatchExpression::Terminal<T>, PatchExpression::Subtract> operator-(const T& val) const;
 
     /**
      * @brief   减法赋值运算符（标量）
@@ -274,44 +456,49 @@ public:
 
     /**
      * @brief   获取当前图像块通道最小值（非const版本）
-     * @details 计算当前图像块中指定通道的最小值
+     * @details 获取当前图像块中指定通道的最小值
      *
      * @param   channel 通道索引，-1表示所有通道
-     * @return  通道最小值
-     * @note    该函数会遍历所有数据计算最小值
+     * @return  通道最小值；图像块为空或通道不存在时返回double的最大值
+     * @note    第一次调用时一次遍历计算所有通道的统计并缓存，之后直接返回缓存值
      */
     double getMinValue(int channel = -1);
 
     /**
      * @brief   获取当前图像块通道最大值（非const版本）
-     * @details 计算当前图像块中指定通道的最大值
+     * @details 获取当前图像块中指定通道的最大值
      *
      * @param   channel 通道索引，-1表示所有通道
-     * @return  通道最大值
-     * @note    该函数会遍历所有数据计算最大值
+     * @return  通道最大值；图像块为空或通道不存在时返回std::numeric_limits<double>::min()
+     * @note    与getMinValue共用同一次遍历的缓存
      */
     double getMaxValue(int channel = -1);
 
     /**
      * @brief   获取当前图像块通道最小值（const版本）
-     * @details 计算当前图像块中指定通道的最小值
+     * @details 获取当前图像块中指定通道的最小值
      *
      * @param   channel 通道索引，-1表示所有通道
      * @return  通道最小值
-     * @note    该函数会遍历所有数据计算最小值
+     * @note    缓存是mutable成员，与其他成员一样不是线程安全的
      */
     double getMinValue(int channel = -1) const;
 
     /**
      * @brief   获取当前图像块通道最大值（const版本）
-     * @details 计算当前图像块中指定通道的最大值
+     * @details 获取当前图像块中指定通道的最大值
      *
      * @param   channel 通道索引，-1表示所有通道
      * @return  通道最大值
-     * @note    该函数会遍历所有数据计算最大值
      */
     double getMaxValue(int channel = -1) const;
 
+    /**
+     * @brief   使通道统计缓存失效
+     * @details 算术运算符、fill和setValue会自动调用；通过getPointer直接修改数据后需要手动调用
+     */
+    void invalidateStatistics();
+
     /**
      * @brief   获取指定索引位置的像素值
      * @details 根据多维索引获取对应位置的像素值
@@ -395,6 +582,12 @@ public:
      */
     const unsigned long long getBufferSize() const;
 
+    /**
+     * @brief   获取缓冲区的字节数
+     * @return  缓冲区元素个数乘以元素字节数
+     */
+    unsigned long long getByteSize() const;
+
     /**
      * @brief   获取数据类型
      * @details 返回图像数据的类型
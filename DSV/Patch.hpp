@@ -1,7 +1,10 @@
 ﻿#pragma once
 #include <algorithm>
 #include "Patch.h"
+#include "TileBufferPool.h"
+#include "PixelConversion.h"
 #include <limits>
+#include <type_traits>
 #include <QDebug>
 template<>
 inline const SlideColorManagement::DataType Patch<unsigned char>::getDataType() const {
@@ -49,7 +52,8 @@ Patch<T>::Patch() :
     ImageSource(),
     _bufferSize(0),
     _buffer(NULL),
-    _ownData(true)
+    _ownData(true),
+    _statisticsValid(false)
 {
     _isValid = true;
 }
@@ -58,7 +62,7 @@ template<typename T>
 Patch<T>::~Patch()
 {
     if (_buffer && _ownData) {
-        delete[] _buffer;
+        TileBufferPool::release(_buffer);
         _buffer = NULL;
     }
 }
@@ -89,56 +93,79 @@ double Patch<T>::getWSIMaxValue(int channel) const {
     }
 }
 
-template<typename T>
-double Patch<T>::getMinValue(int channel) {
-    double min = std::numeric_limits<double>::max();
-    if (_buffer) {
-        for (int i = 0; i < _bufferSize; ++i) {
-            if (_buffer[i] < min) {
-                min = _buffer[i];
+namespace PatchStatistics {
+
+    /**
+     * @brief 使用PixelConversion的SIMD内核统计通道最小值/最大值
+     */
+    template<typename T>
+    void channelMinMax(const T* data, unsigned long long nrPixels, unsigned int samplesPerPixel, double* minValues, double* maxValues, std::true_type) {
+        PixelConversion::channelMinMax(data, nrPixels, samplesPerPixel, minValues, maxValues);
+    }
+
+    /**
+     * @brief 内核不支持的样本类型使用标量统计
+     */
+    template<typename T>
+    void channelMinMax(const T* data, unsigned long long nrPixels, unsigned int samplesPerPixel, double* minValues, double* maxValues, std::false_type) {
+        std::fill(minValues, minValues + samplesPerPixel, std::numeric_limits<double>::max());
+        std::fill(maxValues, maxValues + samplesPerPixel, std::numeric_limits<double>::lowest());
+        for (unsigned long long i = 0; i < nrPixels; ++i) {
+            for (unsigned int c = 0; c < samplesPerPixel; ++c, ++data) {
+                const double value = static_cast<double>(*data);
+                minValues[c] = value < minValues[c] ? value : minValues[c];
+                maxValues[c] = value > maxValues[c] ? value : maxValues[c];
             }
         }
     }
-    return min;
 }
 
 template<typename T>
-double Patch<T>::getMaxValue(int channel) {
-    double max = std::numeric_limits<double>::min();
-    if (_buffer) {
-        for (int i = 0; i < _bufferSize; ++i) {
-            if (_buffer[i] > max) {
-                max = _buffer[i];
-            }
-        }
+void Patch<T>::updateStatistics() const {
+    if (_statisticsValid) {
+        return;
     }
-    return max;
+    const unsigned int samplesPerPixel = _buffer ? static_cast<unsigned int>(getSamplesPerPixel()) : 0;
+    _channelMinValues.assign(samplesPerPixel, 0.);
+    _channelMaxValues.assign(samplesPerPixel, 0.);
+    if (samplesPerPixel > 0) {
+        typedef std::integral_constant<bool, PixelConversion::SampleDataType<T>::value != SlideColorManagement::DataType::InvalidDataType> Supported;
+        PatchStatistics::channelMinMax(_buffer, _bufferSize / samplesPerPixel, samplesPerPixel, _channelMinValues.data(), _channelMaxValues.data(), Supported());
+    }
+    _statisticsValid = true;
+}
+
+template<typename T>
+void Patch<T>::invalidateStatistics() {
+    _statisticsValid = false;
+}
+
+template<typename T>
+double Patch<T>::getMinValue(int channel) {
+    return static_cast<const Patch<T>*>(this)->getMinValue(channel);
+}
+
+template<typename T>
+double Patch<T>::getMaxValue(int channel) {
+    return static_cast<const Patch<T>*>(this)->getMaxValue(channel);
 }
 
 template<typename T>
 double Patch<T>::getMinValue(int channel) const {
-    double min = std::numeric_limits<double>::max();
-    if (_buffer) {
-        for (int i = 0; i < _bufferSize; ++i) {
-            if (_buffer[i] < min) {
-                min = _buffer[i];
-            }
-        }
+    updateStatistics();
+    if (channel < 0) {
+        return _channelMinValues.empty() ? std::numeric_limits<double>::max() : *std::min_element(_channelMinValues.begin(), _channelMinValues.end());
     }
-    return min;
+    return static_cast<size_t>(channel) < _channelMinValues.size() ? _channelMinValues[channel] : std::numeric_limits<double>::max();
 }
 
 template<typename T>
 double Patch<T>::getMaxValue(int channel) const {
-    double max = std::numeric_limits<double>::min();
-    if (_buffer) {
-        for (int i = 0; i < _bufferSize; ++i) {
-            if (_buffer[i] > max) {
-                max = _buffer[i];
-            }
-        }
+    updateStatistics();
+    if (channel < 0) {
+        return _channelMaxValues.empty() ? std::numeric_limits<double>::min() : *std::max_element(_channelMaxValues.begin(), _channelMaxValues.end());
     }
-    return max;
+    return static_cast<size_t>(channel) < _channelMaxValues.size() ? _channelMaxValues[channel] : std::numeric_limits<double>::min();
 }
 
 
@@ -157,12 +184,18 @@ const unsigned long long Patch<T>::getBufferSize() const {
     return _bufferSize;
 }
 
+template<typename T>
+unsigned long long Patch<T>::getByteSize() const {
+    return _bufferSize * sizeof(T);
+}
+
 template<typename T>
 Patch<T>::Patch(const std::vector<unsigned long long>& dimensions, const SlideColorManagement::ColorType& colorType, T* data, bool ownData, std::vector<double> wsiMinValues, std::vector<double> wsiMaxValues) :
     ImageSource(),
     _dimensions(dimensions),
     _buffer(data),
-    _ownData(ownData)
+    _ownData(ownData),
+    _statisticsValid(false)
 {
     _colorType = colorType;
     if (_dimensions.empty()) {
@@ -178,7 +211,7 @@ Patch<T>::Patch(const std::vector<unsigned long long>& dimensions, const SlideCo
         _buffer = data;
     }
     else if (_bufferSize) {
-        _buffer = new T[_bufferSize];
+        _buffer = TileBufferPool::allocateArray<T>(_bufferSize);
     }
     if (!dimensions.empty()) {
         if ((_colorType == SlideColorManagement::ColorType::RGBA && dimensions.back() != 4) || (_colorType == SlideColorManagement::ColorType::RGB && dimensions.back() != 3) || (_colorType == SlideColorManagement::ColorType::Monochrome && dimensions.back() != 1)) {
@@ -200,13 +233,31 @@ Patch<T>::Patch(const Patch<T>& rhs) :
     _strides(rhs._strides),
     _buffer(NULL),
     _wsiMinValues(rhs._wsiMinValues),
-    _wsiMaxValues(rhs._wsiMaxValues)
+    _wsiMaxValues(rhs._wsiMaxValues),
+    _channelMinValues(rhs._channelMinValues),
+    _channelMaxValues(rhs._channelMaxValues),
+    _statisticsValid(rhs._statisticsValid)
 {
-    _buffer = new T[_bufferSize];
+    _buffer = TileBufferPool::allocateArray<T>(_bufferSize);
     std::copy(rhs._buffer, rhs._buffer + rhs._bufferSize, _buffer);
     _isValid = true;
 }
 
+template<typename T>
+Patch<T>::Patch(Patch<T>&& rhs) noexcept :
+    Patch()
+{
+    swap(*this, rhs);
+}
+
+template<typename T>
+template<typename E, typename Op>
+Patch<T>::Patch(const PatchExpression::ScalarOperation<E, Op>& expression) :
+    Patch()
+{
+    assign(expression);
+}
+
 template<typename T>
 void Patch<T>::swap(Patch<T>& first, Patch<T>& second) {
     ImageSource::swap(first, second);
@@ -217,14 +268,62 @@ void Patch<T>::swap(Patch<T>& first, Patch<T>& second) {
     std::swap(first._wsiMinValues, second._wsiMinValues);
     std::swap(first._wsiMaxValues, second._wsiMaxValues);
     std::swap(first._strides, second._strides);
+    std::swap(first._channelMinValues, second._channelMinValues);
+    std::swap(first._channelMaxValues, second._channelMaxValues);
+    std::swap(first._statisticsValid, second._statisticsValid);
 }
 
 template<typename T>
-Patch<T>& Patch<T>::operator=(Patch<T> rhs) {
-    this->swap(*this, const_cast <Patch<T>&>(rhs));
+Patch<T>& Patch<T>::operator=(const Patch<T>& rhs) {
+    Patch<T> copy(rhs);
+    this->swap(*this, copy);
     return *this;
 }
 
+template<typename T>
+Patch<T>& Patch<T>::operator=(Patch<T>&& rhs) noexcept {
+    this->swap(*this, rhs);
+    return *this;
+}
+
+template<typename T>
+template<typename E, typename Op>
+Patch<T>& Patch<T>::operator=(const PatchExpression::ScalarOperation<E, Op>& expression) {
+    assign(expression);
+    return *this;
+}
+
+template<typename T>
+template<typename E>
+void Patch<T>::assign(const E& expression) {
+    const Patch<T>& source = expression.source();
+    const unsigned long long size = source._bufferSize;
+    T* target = _buffer;
+    if (!_buffer || !_ownData || _bufferSize != size) {
+        target = size ? TileBufferPool::allocateArray<T>(size) : NULL;
+    }
+    // 运算链内联为逐元素的单个循环，由编译器向量化；每个元素只依赖源的同一元素，源与目标相同时也可以就地写入
+    for (unsigned long long i = 0; i < size; ++i) {
+        target[i] = expression[i];
+    }
+    if (target != _buffer) {
+        if (_buffer && _ownData) {
+            TileBufferPool::release(_buffer);
+        }
+        _buffer = target;
+        _ownData = true;
+    }
+    if (&source != this) {
+        ImageSource::operator=(source);
+        _bufferSize = size;
+        _dimensions = source._dimensions;
+        _strides = source._strides;
+        _wsiMinValues = source._wsiMinValues;
+        _wsiMaxValues = source._wsiMaxValues;
+    }
+    _statisticsValid = false;
+}
+
 template<typename T>
 ImageSource* Patch<T>::clone() {
     return new Patch<T>(*this);
@@ -277,18 +376,22 @@ void Patch<T>::setValue(const std::vector<unsigned long long>& index, const T& v
         offset += index[i] * _strides[i];
     }
     _buffer[offset] = value;
+    _statisticsValid = false;
 }
 
 template<typename T>
 void Patch<T>::fill(const T& value) {
     std::fill(_buffer, _buffer + _bufferSize, value);
+    // 填充后所有通道的最小值和最大值都是该值，不需要再次遍历
+    const unsigned int samplesPerPixel = _buffer ? static_cast<unsigned int>(getSamplesPerPixel()) : 0;
+    _channelMinValues.assign(samplesPerPixel, static_cast<double>(value));
+    _channelMaxValues.assign(samplesPerPixel, static_cast<double>(value));
+    _statisticsValid = true;
 }
 
 template<typename T>
-Patch<T> Patch<T>::operator*(const T& val) {
-    Patch<T> temp(*this);
-    temp *= val;
-    return temp;
+PatchExpression::ScalarOperation<PatchExpression::Terminal<T>, PatchExpression::Multiply> Patch<T>::operator*(const T& val) const {
+    return PatchExpression::ScalarOperation<PatchExpression::Terminal<T>, PatchExpression::Multiply>(PatchExpression::Terminal<T>(*this), val);
 }
 
 template<typename T>
@@ -298,14 +401,13 @@ Patch<T>& Patch<T>::operator*=(const T& val) {
         (*ptr) *= val;
         ++ptr;
     }
+    _statisticsValid = false;
     return *this;
 }
 
 template<typename T>
-Patch<T> Patch<T>::operator/(const T& val) {
-    Patch<T> temp(*this);
-    temp /= val;
-    return temp;
+PatchExpression::ScalarOperation<PatchExpression::Terminal<T>, PatchExpression::Divide> Patch<T>::operator/(const T& val) const {
+    return PatchExpression::ScalarOperation<PatchExpression::Terminal<T>, PatchExpression::Divide>(PatchExpression::Terminal<T>(*this), val);
 }
 
 template<typename T>
@@ -315,14 +417,13 @@ Patch<T>& Patch<T>::operator/=(const T& val) {
         (*ptr) /= val;
         ++ptr;
     }
+    _statisticsValid = false;
     return *this;
 }
 
 template<typename T>
-Patch<T> Patch<T>::operator+(const T& val) {
-    Patch<T> temp(*this);
-    temp += val;
-    return temp;
+PatchExpression::ScalarOperation<PatchExpression::Terminal<T>, PatchExpression::Add> Patch<T>::operator+(const T& val) const {
+    return PatchExpression::ScalarOperation<PatchExpression::Terminal<T>, PatchExpression::Add>(PatchExpression::Terminal<T>(*this), val);
 }
 
 template<typename T>
@@ -332,14 +433,13 @@ Patch<T>& Patch<T>::operator+=(const T& val) {
         (*ptr) += val;
         ++ptr;
     }
+    _statisticsValid = false;
     return *this;
 }
 
 template<typename T>
-Patch<T> Patch<T>::operator-(const T& val) {
-    Patch<T> temp(*this);
-    temp -= val;
-    return temp;
+PatchExpression::ScalarOperation<PatchExpression::Terminal<T>, PatchExpression::Subtract> Patch<T>::operator-(const T& val) const {
+    return PatchExpression::ScalarOperation<PatchExpression::Terminal<T>, PatchExpression::Subtract>(PatchExpression::Terminal<T>(*this), val);
 }
 
 template<typename T>
@@ -349,6 +449,7 @@ Patch<T>& Patch<T>::operator-=(const T& val) {
         (*ptr) -= val;
         ++ptr;
     }
+    _statisticsValid = false;
     return *this;
 }
 
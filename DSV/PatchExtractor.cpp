@@ -0,0 +1,628 @@
+﻿/**
+ * @file PatchExtractor.cpp
+ * @brief 图像块提取实现文件
+ * @details 该文件实现了无界面的图像块数据集导出，包括：
+ *          - 命令行解析和标注文件读取
+ *          - 网格位置的组织掩膜和标注多边形筛选
+ *          - IO线程池中的并行读取和PNG/JPEG编码
+ *          - WebDataset风格的tar分片写出
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "PatchExtractor.h"
+#include "MultiResolutionImage.h"
+#include "MultiResolutionImageFactory.h"
+#include "DiskTileCache.h"
+#include "SlideLoader.h"
+#include "TissueMask.h"
+#include "IOThread.h"
+#include "Item/AnnotationStore.h"
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPainterPath>
+#include <QTextStream>
+#include <QThread>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+namespace {
+
+    /** @brief tar块大小 */
+    const int kTarBlock = 512;
+
+    /** @brief 主线程检查进度的间隔（毫秒） */
+    const unsigned long kPollInterval = 20;
+
+    /** @brief 进度报告的间隔（毫秒） */
+    const qint64 kReportInterval = 1000;
+
+    /** @brief 用于组织掩膜的缩略图瓦片大小，与SlideLoader的默认瓦片大小一致 */
+    const unsigned int kOverviewTileSize = 512;
+
+    /** @brief tar的name字段可用的字节数（最后一个字节为NUL） */
+    const int kTarNameBytes = 99;
+
+    /**
+     * @brief 样本名前缀的最大UTF-8字节数
+     * @details 层级和坐标后缀"_l99_x<10位>_y<10位>"最多28字节，扩展名".json"为5字节，
+     *          前缀不超过66字节时条目名总在name字段内，这里取48
+     */
+    const int kSlideKeyBytes = 48;
+
+    /**
+     * @brief 按UTF-8字节数截断字符串，不截断多字节字符
+     * @param text 字符串
+     * @param maxBytes 最大字节数
+     * @return 截断后的字符串
+     */
+    QString truncateUtf8(const QString& text, int maxBytes) {
+        const QByteArray utf8 = text.toUtf8();
+        if (utf8.size() <= maxBytes) {
+            return text;
+        }
+        int end = maxBytes;
+        // 第一个被截去的字节是后续字节时，向前退到该字符的首字节
+        while (end > 0 && (static_cast<unsigned char>(utf8[end]) & 0xC0) == 0x80) {
+            --end;
+        }
+        return QString::fromUtf8(utf8.constData(), end);
+    }
+
+    /**
+     * @brief 按八进制写入tar头的数字字段，以NUL结尾
+     */
+    void writeOctal(char* field, int width, unsigned long long value) {
+        field[width - 1] = '\0';
+        for (int i = width - 2; i >= 0; --i) {
+            field[i] = static_cast<char>('0' + (value & 7));
+            value >>= 3;
+        }
+    }
+}
+
+/**
+ * @brief 命令行是否请求提取图像块
+ * @param arguments 命令行参数
+ * @return 包含--extract-patches时返回true
+ */
+bool PatchExtractor::isRequested(const QStringList& arguments)
+{
+    return arguments.contains(QStringLiteral("--extract-patches"));
+}
+
+/**
+ * @brief 解析命令行
+ * @param arguments 命令行参数，第一个为程序路径
+ * @param options 输出的运行参数
+ * @param errorMessage 错误信息
+ * @return 是否解析成功
+ */
+bool PatchExtractor::parseArguments(const QStringList& arguments, Options& options, QString& errorMessage)
+{
+    static const QStringList kNumberOptions = { QStringLiteral("--level"), QStringLiteral("--size"), QStringLiteral("--stride"),
+        QStringLiteral("--quality"), QStringLiteral("--shard-samples"), QStringLiteral("--shard-size"), QStringLiteral("--max-patches"),
+        QStringLiteral("--threads") };
+    QStringList positional;
+    for (int i = 1; i < arguments.size(); ++i) {
+        const QString& argument = arguments[i];
+        if (argument == QStringLiteral("--extract-patches")) {
+            continue;
+        }
+        else if (argument == QStringLiteral("--tissue")) {
+            options.tissueOnly = true;
+        }
+        else if (argument == QStringLiteral("--annotations") || argument == QStringLiteral("--format") || kNumberOptions.contains(argument)) {
+            if (i + 1 >= arguments.size()) {
+                errorMessage = argument + QStringLiteral(" requires a value");
+                return false;
+            }
+            const QString value = arguments[++i];
+            if (argument == QStringLiteral("--annotations")) {
+                options.annotationPath = value;
+                continue;
+            }
+            if (argument == QStringLiteral("--format")) {
+                options.format = value.toLower() == QStringLiteral("jpeg") ? QStringLiteral("jpg") : value.toLower();
+                if (options.format != QStringLiteral("png") && options.format != QStringLiteral("jpg")) {
+                    errorMessage = QStringLiteral("invalid value for --format: ") + value;
+                    return false;
+                }
+                continue;
+            }
+            bool ok = false;
+            const unsigned long long number = value.toULongLong(&ok);
+            const bool positive = argument == QStringLiteral("--size") || argument == QStringLiteral("--shard-samples") || argument == QStringLiteral("--shard-size");
+            if (!ok || (positive && number == 0) || (argument == QStringLiteral("--quality") && number > 100)) {
+                errorMessage = QStringLiteral("invalid value for ") + argument + QStringLiteral(": ") + value;
+                return false;
+            }
+            if (argument == QStringLiteral("--level")) {
+                options.level = static_cast<unsigned int>(number);
+            }
+            else if (argument == QStringLiteral("--size")) {
+                options.patchSize = static_cast<unsigned int>(number);
+            }
+            else if (argument == QStringLiteral("--stride")) {
+                options.stride = static_cast<unsigned int>(number);
+            }
+            else if (argument == QStringLiteral("--quality")) {
+                options.quality = static_cast<int>(number);
+            }
+            else if (argument == QStringLiteral("--shard-samples")) {
+                options.shardSamples = static_cast<unsigned int>(number);
+            }
+            else if (argument == QStringLiteral("--shard-size")) {
+                options.shardBytes = number * 1024 * 1024;
+            }
+            else if (argument == QStringLiteral("--max-patches")) {
+                options.maxPatches = number;
+            }
+            else {
+                options.threads = static_cast<unsigned int>(number);
+            }
+        }
+        else {
+            positional.append(argument);
+        }
+    }
+    if (positional.size() != 2) {
+        errorMessage = QStringLiteral("usage: DSV --extract-patches <slide> <output-prefix> [--level N] [--size N] [--stride N] [--tissue] "
+            "[--annotations FILE] [--format png|jpg] [--quality N] [--shard-samples N] [--shard-size MB] [--max-patches N] [--threads N]");
+        return false;
+    }
+    options.slide = positional[0];
+    options.outputPrefix = positional[1];
+    if (options.stride == 0) {
+        options.stride = options.patchSize;
+    }
+    return true;
+}
+
+/**
+ * @brief 构造函数
+ * @param img 切片
+ * @param options 运行参数
+ */
+PatchExtractor::PatchExtractor(std::shared_ptr<MultiResolutionImage> img, const Options& options) :
+    _img(img),
+    _options(options),
+    _downsample(1.),
+    _columns(0),
+    _rows(0),
+    _nextPosition(0),
+    _positionsDone(0),
+    _patchesReserved(0),
+    _patchesWritten(0),
+    _cancelled(false),
+    _shardIndex(0),
+    _shardSampleCount(0),
+    _shardByteCount(0),
+    _writeFailed(false)
+{
+    _slideKey = QFileInfo(options.slide).completeBaseName();
+    _slideKey.replace(QLatin1Char('.'), QLatin1Char('_'));
+    _slideKey.replace(QLatin1Char(' '), QLatin1Char('_'));
+    // tar的name字段按字节计长，中文等多字节文件名按UTF-8字节截断，留出坐标和扩展名的位置
+    _slideKey = truncateUtf8(_slideKey, kSlideKeyBytes);
+}
+
+/**
+ * @brief 析构函数
+ */
+PatchExtractor::~PatchExtractor()
+{
+    closeShard();
+}
+
+/**
+ * @brief 读取标注并确定网格
+ * @param errorMessage 失败原因
+ * @return 参数有效时返回true
+ * @details 只取完全位于层级范围内的图像块，不在边缘填充背景
+ */
+bool PatchExtractor::start(QString& errorMessage)
+{
+    if (_options.level >= static_cast<unsigned int>(_img->getNumberOfLevels())) {
+        errorMessage = QStringLiteral("level %1 does not exist").arg(_options.level);
+        return false;
+    }
+    const unsigned int samplesPerPixel = _img->getSamplesPerPixel();
+    if (samplesPerPixel != 1 && samplesPerPixel != 3 && samplesPerPixel != 4) {
+        errorMessage = QStringLiteral("unsupported number of channels: %1").arg(samplesPerPixel);
+        return false;
+    }
+    if (_options.tissueOnly && !_img->getTissueMask()) {
+        errorMessage = QStringLiteral("--tissue requires a bright-field RGB slide");
+        return false;
+    }
+    if (!_options.annotationPath.isEmpty() && !loadAnnotations(_options.annotationPath, errorMessage)) {
+        return false;
+    }
+    const std::vector<unsigned long long> dims = _img->getLevelDimensions(_options.level);
+    _downsample = _img->getLevelDownsample(_options.level);
+    if (dims[0] >= _options.patchSize && dims[1] >= _options.patchSize) {
+        _columns = (dims[0] - _options.patchSize) / _options.stride + 1;
+        _rows = (dims[1] - _options.patchSize) / _options.stride + 1;
+    }
+    return true;
+}
+
+/**
+ * @brief 读取标注文件中的面状标注
+ * @param path 标注文件路径
+ * @param errorMessage 失败原因
+ * @return 文件可读时返回true
+ * @details 矩形和椭圆转换为多边形；直线、文本、标尺等没有面积的标注被忽略
+ */
+bool PatchExtractor::loadAnnotations(const QString& path, QString& errorMessage)
+{
+    std::vector<AnnotationRecord> records;
+    if (path.endsWith(QStringLiteral(".dsva"), Qt::CaseInsensitive)) {
+        AnnotationStoreReader reader;
+        if (!reader.open(path)) {
+            errorMessage = QStringLiteral("cannot read annotation store ") + path;
+            return false;
+        }
+        records = reader.read(reader.getBounds());
+    }
+    else {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            errorMessage = QStringLiteral("cannot read annotations ") + path;
+            return false;
+        }
+        const QByteArray content = file.readAll();
+        QJsonParseError error;
+        const QJsonDocument document = QJsonDocument::fromJson(content, &error);
+        if (error.error == QJsonParseError::NoError && document.isArray()) {
+            for (const QJsonValue& value : document.array()) {
+                records.push_back(AnnotationRecord::fromJson(value.toObject()));
+            }
+        }
+        else if (error.error == QJsonParseError::NoError && document.isObject()) {
+            records.push_back(AnnotationRecord::fromJson(document.object()));
+        }
+        else {
+            // JSON-seq：每行一个对象，与AnnotationStoreReader::exportJsonSeq的输出相同
+            for (const QByteArray& line : content.split('\n')) {
+                const QJsonDocument item = QJsonDocument::fromJson(line.trimmed(), &error);
+                if (error.error == QJsonParseError::NoError && item.isObject()) {
+                    records.push_back(AnnotationRecord::fromJson(item.object()));
+                }
+            }
+        }
+    }
+    for (const AnnotationRecord& record : records) {
+        Region region;
+        region.label = record.name;
+        switch (record.type) {
+        case RenderElement::Rectangle:
+            if (record.points.size() >= 2) {
+                region.polygon = QPolygonF(QRectF(record.points[0], record.points[1]).normalized());
+            }
+            break;
+        case RenderElement::Ellipse:
+            if (record.points.size() >= 2) {
+                QPainterPath ellipse;
+                ellipse.addEllipse(QRectF(record.points[0], record.points[1]).normalized());
+                region.polygon = ellipse.toFillPolygon();
+            }
+            break;
+        case RenderElement::Polygon:
+        case RenderElement::Contour:
+            region.polygon = record.points;
+            break;
+        default:
+            break;
+        }
+        if (region.polygon.size() >= 3) {
+            region.bounds = region.polygon.boundingRect();
+            _regions.push_back(region);
+        }
+    }
+    if (_regions.empty()) {
+        errorMessage = QStringLiteral("no area annotations in ") + path;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 查找包含点的标注区域
+ * @param point 第0层坐标
+ * @return 区域，不存在时返回nullptr
+ */
+const PatchExtractor::Region* PatchExtractor::regionAt(const QPointF& point) const
+{
+    for (const Region& region : _regions) {
+        if (region.bounds.contains(point) && region.polygon.containsPoint(point, Qt::OddEvenFill)) {
+            return &region;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief 领取并处理下一个图像块
+ * @return 没有剩余位置时返回false
+ */
+bool PatchExtractor::processNextTile()
+{
+    const unsigned long long positions = getNumberOfPositions();
+    bool claimed = false;
+    while (!_cancelled) {
+        const unsigned long long index = _nextPosition++;
+        if (index >= positions) {
+            break;
+        }
+        claimed = true;
+        const bool written = extract(index);
+        ++_positionsDone;
+        if (written) {
+            return true;
+        }
+    }
+    return claimed;
+}
+
+/**
+ * @brief 取消提取
+ */
+void PatchExtractor::cancel()
+{
+    _cancelled = true;
+}
+
+/**
+ * @brief 获取网格位置数
+ * @return 截断到unsigned int范围的位置数
+ */
+unsigned int PatchExtractor::getNumberOfTiles() const
+{
+    return static_cast<unsigned int>(std::min<unsigned long long>(getNumberOfPositions(), UINT_MAX));
+}
+
+/**
+ * @brief 处理一个网格位置
+ * @param index 行优先的位置编号
+ * @return 写出了图像块时返回true
+ * @details 组织掩膜按整个图像块判断，标注按图像块中心判断；
+ *          JSON元数据中的坐标为第0层坐标，宽高为层级像素
+ */
+bool PatchExtractor::extract(unsigned long long index)
+{
+    const unsigned int size = _options.patchSize;
+    const unsigned long long levelX = (index % _columns) * _options.stride;
+    const unsigned long long levelY = (index / _columns) * _options.stride;
+    const long long x = static_cast<long long>(levelX * _downsample);
+    const long long y = static_cast<long long>(levelY * _downsample);
+    const double extent = size * _downsample;
+    if (_options.tissueOnly && !_img->getTissueMask()->containsTissue(static_cast<double>(x), static_cast<double>(y), extent, extent)) {
+        return false;
+    }
+    const Region* region = NULL;
+    if (!_regions.empty()) {
+        region = regionAt(QPointF(x + extent / 2., y + extent / 2.));
+        if (!region) {
+            return false;
+        }
+    }
+    if (_options.maxPatches && _patchesReserved++ >= _options.maxPatches) {
+        _cancelled = true;
+        return false;
+    }
+
+    Patch<unsigned char> patch = _img->getPatch<unsigned char>(x, y, size, size, _options.level);
+    const unsigned int samplesPerPixel = _img->getSamplesPerPixel();
+    const QImage::Format format = samplesPerPixel == 4 ? QImage::Format_RGBA8888
+        : (samplesPerPixel == 3 ? QImage::Format_RGB888 : QImage::Format_Grayscale8);
+    const QImage image(patch.getPointer(), static_cast<int>(size), static_cast<int>(size), static_cast<int>(size * samplesPerPixel), format);
+    QByteArray encoded;
+    QBuffer buffer(&encoded);
+    buffer.open(QIODevice::WriteOnly);
+    const bool jpeg = _options.format == QStringLiteral("jpg");
+    if (!image.save(&buffer, jpeg ? "JPG" : "PNG", jpeg ? _options.quality : -1)) {
+        return false;
+    }
+
+    QJsonObject metadata;
+    metadata.insert(QStringLiteral("slide"), QFileInfo(_options.slide).fileName());
+    metadata.insert(QStringLiteral("level"), static_cast<int>(_options.level));
+    metadata.insert(QStringLiteral("x"), static_cast<double>(x));
+    metadata.insert(QStringLiteral("y"), static_cast<double>(y));
+    metadata.insert(QStringLiteral("width"), static_cast<int>(size));
+    metadata.insert(QStringLiteral("height"), static_cast<int>(size));
+    metadata.insert(QStringLiteral("downsample"), _downsample);
+    const std::vector<double> spacing = _img->getSpacing();
+    if (spacing.size() >= 2) {
+        metadata.insert(QStringLiteral("mpp-x"), spacing[0] * _downsample);
+        metadata.insert(QStringLiteral("mpp-y"), spacing[1] * _downsample);
+    }
+    if (region) {
+        metadata.insert(QStringLiteral("label"), region->label);
+    }
+    const QString key = QStringLiteral("%1_l%2_x%3_y%4").arg(_slideKey).arg(_options.level).arg(x).arg(y);
+    if (!writeSample(key, encoded, QJsonDocument(metadata).toJson(QJsonDocument::Compact))) {
+        _cancelled = true;
+        return false;
+    }
+    ++_patchesWritten;
+    return true;
+}
+
+/**
+ * @brief 把一个样本追加到当前分片
+ * @param key 样本名，tar中的条目为<key>.png（或.jpg）和<key>.json
+ * @param image 编码后的图像
+ * @param metadata JSON元数据
+ * @return 写入成功时返回true
+ */
+bool PatchExtractor::writeSample(const QString& key, const QByteArray& image, const QByteArray& metadata)
+{
+    QMutexLocker locker(&_shardMutex);
+    if (_writeFailed) {
+        return false;
+    }
+    if (!_shard.isOpen()) {
+        _shard.setFileName(QStringLiteral("%1-%2.tar").arg(_options.outputPrefix).arg(_shardIndex, 6, 10, QLatin1Char('0')));
+        if (!_shard.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            _writeFailed = true;
+            return false;
+        }
+        ++_shardIndex;
+        _shardSampleCount = 0;
+        _shardByteCount = 0;
+    }
+    if (!writeTarEntry(key + QLatin1Char('.') + _options.format, image) || !writeTarEntry(key + QStringLiteral(".json"), metadata)) {
+        _writeFailed = true;
+        return false;
+    }
+    ++_shardSampleCount;
+    if (_shardSampleCount >= _options.shardSamples || _shardByteCount >= _options.shardBytes) {
+        return closeShard();
+    }
+    return true;
+}
+
+/**
+ * @brief 写一个tar条目
+ * @param name 条目名，UTF-8编码后不超过99字节
+ * @param data 条目数据
+ * @return 写入成功时返回true，条目名过长时返回false
+ * @details 调用者持有_shardMutex。条目名不截断，截断会丢掉扩展名并使不同样本的名字相同
+ */
+bool PatchExtractor::writeTarEntry(const QString& name, const QByteArray& data)
+{
+    char header[kTarBlock];
+    std::memset(header, 0, sizeof(header));
+    const QByteArray fileName = name.toUtf8();
+    if (fileName.size() > kTarNameBytes) {
+        return false;
+    }
+    std::memcpy(header, fileName.constData(), fileName.size());
+    writeOctal(header + 100, 8, 0644);
+    writeOctal(header + 108, 8, 0);
+    writeOctal(header + 116, 8, 0);
+    writeOctal(header + 124, 12, static_cast<unsigned long long>(data.size()));
+    writeOctal(header + 136, 12, static_cast<unsigned long long>(QDateTime::currentSecsSinceEpoch()));
+    header[156] = '0';
+    std::memcpy(header + 257, "ustar", 6);
+    header[263] = '0';
+    header[264] = '0';
+    // 校验和按校验和字段为8个空格时的头部字节之和计算
+    std::memset(header + 148, ' ', 8);
+    unsigned int checksum = 0;
+    for (int i = 0; i < kTarBlock; ++i) {
+        checksum += static_cast<unsigned char>(header[i]);
+    }
+    writeOctal(header + 148, 7, checksum);
+    header[155] = ' ';
+
+    const int padding = (kTarBlock - data.size() % kTarBlock) % kTarBlock;
+    static const char kZeros[kTarBlock] = { 0 };
+    if (_shard.write(header, kTarBlock) != kTarBlock || _shard.write(data) != data.size() ||
+        (padding && _shard.write(kZeros, padding) != padding)) {
+        return false;
+    }
+    _shardByteCount += kTarBlock + data.size() + padding;
+    return true;
+}
+
+/**
+ * @brief 关闭当前分片
+ * @return 写入成功或没有打开的分片时返回true
+ * @details 调用者持有_shardMutex，或已没有工作线程访问该任务
+ */
+bool PatchExtractor::closeShard()
+{
+    if (!_shard.isOpen()) {
+        return !_writeFailed;
+    }
+    static const char kZeros[2 * kTarBlock] = { 0 };
+    if (_shard.write(kZeros, sizeof(kZeros)) != static_cast<qint64>(sizeof(kZeros))) {
+        _writeFailed = true;
+    }
+    _shard.close();
+    return !_writeFailed;
+}
+
+/**
+ * @brief 关闭最后一个分片
+ * @return 所有写入都成功时返回true
+ */
+bool PatchExtractor::finish()
+{
+    QMutexLocker locker(&_shardMutex);
+    return closeShard();
+}
+
+/**
+ * @brief 运行提取
+ * @param arguments 命令行参数
+ * @return 进程退出码
+ * @details 关闭磁盘瓦片缓存：提取只顺序读取一遍，写入磁盘缓存只会挤掉查看器的缓存
+ */
+int PatchExtractor::run(const QStringList& arguments)
+{
+    QTextStream out(stdout);
+    Options options;
+    QString errorMessage;
+    if (!parseArguments(arguments, options, errorMessage)) {
+        out << errorMessage << "\n";
+        return 2;
+    }
+    DiskTileCache::setEnabled(false);
+
+    MultiResolutionImageReader imgReader;
+    std::shared_ptr<MultiResolutionImage> img(imgReader.open(options.slide.toStdString(), "default"));
+    if (!img || !img->valid()) {
+        out << "cannot open " << options.slide << "\n";
+        return 1;
+    }
+    if (options.tissueOnly) {
+        SlideLoader::loadOverview(img, kOverviewTileSize);
+    }
+    std::shared_ptr<PatchExtractor> extractor = std::make_shared<PatchExtractor>(img, options);
+    if (!extractor->start(errorMessage)) {
+        out << errorMessage << "\n";
+        return 2;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    IOThread* ioThread = new IOThread(NULL, options.threads);
+    ioThread->addTileTask(extractor);
+    qint64 lastReport = 0;
+    // 以任务计数的已处理位置判断完成；isIdle在工作线程领取任务的间隙可能短暂为true
+    while (!extractor->isFinished()) {
+        QCoreApplication::processEvents();
+        QThread::msleep(kPollInterval);
+        if (timer.elapsed() - lastReport >= kReportInterval) {
+            lastReport = timer.elapsed();
+            out << extractor->getPositionsDone() << "/" << extractor->getNumberOfPositions() << " positions, "
+                << extractor->getPatchesWritten() << " patches\n";
+            out.flush();
+        }
+    }
+    ioThread->shutdown();
+    delete ioThread;
+
+    const bool ok = extractor->finish();
+    const double seconds = timer.elapsed() / 1000.;
+    out << extractor->getPatchesWritten() << " patches in " << extractor->getNumberOfShards() << " shards, "
+        << seconds << " s (" << (seconds > 0. ? extractor->getPatchesWritten() / seconds : 0.) << " patches/s)\n";
+    if (!ok) {
+        out << "write failed for " << options.outputPrefix << "\n";
+    }
+    return ok ? 0 : 1;
+}
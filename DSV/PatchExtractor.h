@@ -0,0 +1,271 @@
+﻿/**
+ * @file    PatchExtractor.h
+ * @brief   图像块提取类，无界面地把切片切成固定大小的图像块并写成分片数据集
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该类为机器学习数据集提供与查看器相同的读取引擎，包括：
+ *          - 使用MultiResolutionImageFactory打开切片，MultiResolutionImage::getPatch读取图像块
+ *          - 在所选层级上按网格取块，可按组织掩膜或标注多边形筛选
+ *          - 作为TileTask在IO线程池的所有工作线程上并行读取和编码
+ *          - 写成WebDataset风格的tar分片，每个样本为<key>.png（或.jpg）和<key>.json
+ *
+ * @note    通过命令行启动：DSV.exe --extract-patches slide.svs out/train [--size 256] [--tissue] ...
+ * @see     TileTask, IOThread::addTileTask, TissueMask, AnnotationStoreReader
+ */
+
+#pragma once
+
+#include <QFile>
+#include <QMutex>
+#include <QPolygonF>
+#include <QRectF>
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "TileTask.h"
+
+class MultiResolutionImage;
+class QByteArray;
+
+/**
+ * @class  PatchExtractor
+ * @brief  图像块提取任务
+ * @details 网格位置按行优先编号，工作线程通过processNextTile原子地领取下一个位置，
+ *          跳过不满足筛选条件的位置，读取、编码后把样本追加到当前分片。
+ *          每个工作线程同时只持有一个图像块，分片写入在互斥锁内进行，
+ *          因此内存占用只与线程数有关，与图像块总数无关。
+ *
+ *          命令行选项：
+ *          - --level N           读取层级，默认0
+ *          - --size N            图像块边长（层级像素），默认256
+ *          - --stride N          网格步长，默认等于--size
+ *          - --tissue            只保留组织掩膜判定含有组织的图像块
+ *          - --annotations FILE  只保留中心位于标注多边形（矩形、椭圆、多边形、轮廓）内的图像块，
+ *                                文件为.dsva标注存储、JSON-seq或JSON数组，标注名称写入样本的label
+ *          - --format png|jpg    图像编码，默认png
+ *          - --quality N         JPEG质量，默认90
+ *          - --shard-samples N   每个分片的样本数上限，默认10000
+ *          - --shard-size MB     每个分片的字节数上限，默认1024
+ *          - --max-patches N     最多写出的图像块数，0表示不限
+ *          - --threads N         IO工作线程数，默认按CPU核数
+ *
+ * @example
+ *          // 使用示例（main.cpp）
+ *          if (PatchExtractor::isRequested(arguments)) {
+ *              return PatchExtractor::run(arguments);
+ *          }
+ */
+class PatchExtractor : public TileTask
+{
+public:
+    /**
+     * @brief 运行参数
+     */
+    struct Options {
+        QString slide;
+        QString outputPrefix;        ///< 分片路径前缀，分片为<prefix>-000000.tar、<prefix>-000001.tar...
+        QString annotationPath;
+        QString format = QStringLiteral("png");
+        unsigned int level = 0;
+        unsigned int patchSize = 256;
+        unsigned int stride = 0;     ///< 0表示等于patchSize
+        unsigned int threads = 0;
+        int quality = 90;
+        bool tissueOnly = false;
+        unsigned int shardSamples = 10000;
+        unsigned long long shardBytes = 1024ULL * 1024 * 1024;
+        unsigned long long maxPatches = 0;
+    };
+
+    /**
+     * @brief   命令行是否请求提取图像块
+     * @param   arguments 命令行参数
+     * @return  包含--extract-patches时返回true
+     */
+    static bool isRequested(const QStringList& arguments);
+
+    /**
+     * @brief   运行提取
+     * @param   arguments 命令行参数
+     * @return  进程退出码，0表示全部图像块都已写出
+     * @note    需要已创建QApplication
+     */
+    static int run(const QStringList& arguments);
+
+    /**
+     * @brief   构造函数
+     * @param   img 已打开的切片，使用--tissue时应已设置组织掩膜
+     * @param   options 运行参数
+     */
+    PatchExtractor(std::shared_ptr<MultiResolutionImage> img, const Options& options);
+
+    /**
+     * @brief   析构函数
+     * @details 关闭未完成的分片
+     */
+    ~PatchExtractor();
+
+    /**
+     * @brief   读取标注并确定网格
+     * @param   errorMessage 失败原因
+     * @return  参数有效时返回true
+     * @note    在投放到IO线程池之前调用
+     */
+    bool start(QString& errorMessage);
+
+    /**
+     * @brief   领取并处理下一个图像块
+     * @return  写出或跳过了至少一个位置时返回true；没有剩余位置时返回false
+     * @details 不满足筛选条件的位置在同一次调用中连续跳过，不重新投放任务
+     * @see     TileTask::processNextTile
+     */
+    bool processNextTile() override;
+
+    /**
+     * @brief   取消提取
+     * @details 尚未领取的位置不再处理，已写出的样本保留在分片中
+     */
+    void cancel() override;
+
+    /**
+     * @brief   获取网格位置数
+     * @return  位置数，超出unsigned int范围时截断，只用于限制投放的任务数
+     */
+    unsigned int getNumberOfTiles() const override;
+
+    /**
+     * @brief   关闭最后一个分片
+     * @return  所有写入都成功时返回true
+     * @note    在IO线程池处理完该任务之后调用
+     */
+    bool finish();
+
+    /** @brief 获取网格位置总数 */
+    unsigned long long getNumberOfPositions() const { return _columns * _rows; }
+
+    /** @brief 获取已处理（写出或跳过）的位置数 */
+    unsigned long long getPositionsDone() const { return _positionsDone; }
+
+    /**
+     * @brief   是否已处理完所有位置
+     * @return  所有位置都已处理或提取被取消时返回true
+     * @note    取消时仍可能有工作线程在处理已领取的位置，IOThread::shutdown等待它们结束
+     */
+    bool isFinished() const { return _cancelled || _positionsDone >= getNumberOfPositions(); }
+
+    /** @brief 获取已写出的图像块数 */
+    unsigned long long getPatchesWritten() const { return _patchesWritten; }
+
+    /** @brief 获取已创建的分片数 */
+    unsigned int getNumberOfShards() const { return _shardIndex; }
+
+private:
+    /**
+     * @brief 筛选用的标注区域
+     */
+    struct Region {
+        QPolygonF polygon;   ///< 第0层坐标
+        QRectF bounds;
+        QString label;
+    };
+
+    /**
+     * @brief   解析命令行
+     * @return  参数完整时返回true，否则errorMessage给出原因
+     */
+    static bool parseArguments(const QStringList& arguments, Options& options, QString& errorMessage);
+
+    /**
+     * @brief   读取标注文件中的面状标注
+     * @param   path .dsva标注存储、JSON-seq或JSON数组文件
+     * @return  文件可读时返回true
+     */
+    bool loadAnnotations(const QString& path, QString& errorMessage);
+
+    /**
+     * @brief   查找包含点的标注区域
+     * @param   point 第0层坐标
+     * @return  第一个包含该点的区域，不存在时返回nullptr
+     */
+    const Region* regionAt(const QPointF& point) const;
+
+    /**
+     * @brief   处理一个网格位置
+     * @param   index 行优先的位置编号
+     * @return  写出了图像块时返回true，被筛选掉时返回false
+     */
+    bool extract(unsigned long long index);
+
+    /**
+     * @brief   把一个样本追加到当前分片
+     * @details 当前分片达到样本数或字节数上限后关闭，下一个样本写入新的分片
+     */
+    bool writeSample(const QString& key, const QByteArray& image, const QByteArray& metadata);
+
+    /**
+     * @brief   写一个tar条目（ustar头、数据和对齐到512字节的填充）
+     */
+    bool writeTarEntry(const QString& name, const QByteArray& data);
+
+    /**
+     * @brief   关闭当前分片，写出tar结束标记
+     */
+    bool closeShard();
+
+    /** @brief 切片 */
+    std::shared_ptr<MultiResolutionImage> _img;
+
+    /** @brief 运行参数 */
+    Options _options;
+
+    /** @brief 样本名前缀，由切片文件名得到，不含'.' */
+    QString _slideKey;
+
+    /** @brief 层级的降采样比例 */
+    double _downsample;
+
+    /** @brief 网格列数 */
+    unsigned long long _columns;
+
+    /** @brief 网格行数 */
+    unsigned long long _rows;
+
+    /** @brief 标注区域，为空时不按标注筛选 */
+    std::vector<Region> _regions;
+
+    /** @brief 下一个待领取的位置 */
+    std::atomic<unsigned long long> _nextPosition;
+
+    /** @brief 已处理的位置数 */
+    std::atomic<unsigned long long> _positionsDone;
+
+    /** @brief 已预留的图像块数，用于--max-patches */
+    std::atomic<unsigned long long> _patchesReserved;
+
+    /** @brief 已写出的图像块数 */
+    std::atomic<unsigned long long> _patchesWritten;
+
+    /** @brief 取消或写入失败后为true */
+    std::atomic<bool> _cancelled;
+
+    /** @brief 保护分片文件和计数 */
+    QMutex _shardMutex;
+
+    /** @brief 当前分片文件 */
+    QFile _shard;
+
+    /** @brief 下一个分片的编号 */
+    unsigned int _shardIndex;
+
+    /** @brief 当前分片的样本数 */
+    unsigned int _shardSampleCount;
+
+    /** @brief 当前分片的字节数 */
+    unsigned long long _shardByteCount;
+
+    /** @brief 分片写入是否失败 */
+    bool _writeFailed;
+};
@@ -10,6 +10,8 @@
 #include "PathologyViewer.h"
 
 #include <iostream>
+#include <cmath>
+#include <algorithm>
 
 #include <QAction>
 #include <QApplication>
@@ -17,7 +19,8 @@
 #include <QMessageBox>
 #include <QResizeEvent>
 //#include <QGLWidget>
-#include <QTimeLine>
+#include <QOpenGLWidget>
+#include <QSurfaceFormat>
 #include <QScrollBar>
 #include <QHBoxLayout>
 //#include <QSettings>
@@ -25,17 +28,31 @@
 #include <QMainWindow>
 #include <QStatusBar>
 #include <QLineEdit>
+#include <QFileInfo>
+#include <QFontDatabase>
 
 #include "MiniMap.h"
 #include "ScaleBar.h"
 #include "IOThread.h"
 #include "PrefetchThread.h"
+#include "SlideLoader.h"
 #include "MultiResolutionImage.h"
 #include "SlideColorManagement.h"
 #include "WSITileGraphicsItem.h"
 #include "WSITileGraphicsItemCache.h"
 #include "TileManager.h"
 #include "IOWorker.h"
+#include "MemoryGovernor.h"
+#include "OverlayTileCache.h"
+#include "DiskTileCache.h"
+#include "ViewerSnapshot.h"
+#include "RegionAnalysis.h"
+#include "RegionExport.h"
+#include "SlideStatistics.h"
+#include "PipelineProfiler.h"
+#include "PointDensityImage.h"
+#include "ViewSnapshotService.h"
+#include "ViewAnimationDriver.h"
 //#include "CenteredToolBar.h"
 #include <QGraphicsItem>
 #include <QGraphicsLineItem>
@@ -51,6 +68,8 @@
 #include "Item/EllipseRenderElement.h"
 #include "Item/TextRenderElement.h"
 #include "Item/ContourRenderElement.h"
+#include "Item/AnnotationLayerItem.h"
+#include "Item/AnnotationStore.h"
 #include <QMenu>
 
 using std::vector;
@@ -71,11 +90,20 @@ PathologyViewer::PathologyViewer(QWidget* parent) :
     _prevPan(0, 0),
     _map(NULL),
     _cache(NULL),
+    _annotationLayer(NULL),
+    _annotationStore(NULL),
     _cacheSize(1000 * 512 * 512 * 3),
+    _pixmapBudgetId(0),
+    _decodedBudgetId(0),
+    _overlayBudgetId(0),
+    _ioThreadCount(0),
+    _enhancement{ 0.f, 1.f, 0.f, 1.f },
+    _tileSize(512),
     _sceneScale(1.),
     _manager(NULL),
     _scaleBar(NULL),
     _renderForeground(true),
+    _openGLViewport(false),
     _isFirstRightClick(false),
     _opacity(1.),
     m_frameCount(0)
@@ -89,6 +117,11 @@ PathologyViewer::PathologyViewer(QWidget* parent) :
     setAutoFillBackground(true);                           // 自动填充背景
     setViewportUpdateMode(ViewportUpdateMode::FullViewportUpdate);  // 设置视口更新模式
     setInteractive(true);                                  // 启用交互
+    setOptimizationFlag(QGraphicsView::DontAdjustForAntialiasing, true);  // 瓦片不抗锯齿，无需扩大重绘区域
+    // 缩放和复位动画按屏幕刷新推进，每帧只更新一次视场；OpenGL视口作为帧源
+    _animationDriver = new ViewAnimationDriver(this);
+    connect(_animationDriver, &ViewAnimationDriver::frameAdvanced, this, &PathologyViewer::onAnimationFrame);
+    setOpenGLViewport(true);                               // 使用OpenGL视口
 
     // 创建图形场景
     m_pGraphicsScene = new QImageGraphicScene(this);
@@ -109,6 +142,10 @@ PathologyViewer::PathologyViewer(QWidget* parent) :
 
     createContextMenu();  // 创建上下文菜单
 
+    // 截图窗口的快照在离屏图像上渲染，合并同一轮事件循环中的请求
+    _snapshotService = new ViewSnapshotService(this);
+    connect(_snapshotService, &ViewSnapshotService::snapshotReady, this, &PathologyViewer::viewShow);
+
     // 设置实时绘制画笔
     m_penRealTime.setColor(Qt::green);
     m_penRealTime.setWidth(5);
@@ -135,6 +172,9 @@ PathologyViewer::PathologyViewer(QWidget* parent) :
     // 设置FPS计时器
     m_fpsTimer.start(1000);
     connect(&m_fpsTimer, &QTimer::timeout, this, &PathologyViewer::updateFPS);
+
+    _statisticsOverlayTimer.setInterval(kStatisticsOverlayInterval);
+    connect(&_statisticsOverlayTimer, &QTimer::timeout, this, [this]() { viewport()->update(); });
 }
 
 /**
@@ -144,6 +184,8 @@ PathologyViewer::PathologyViewer(QWidget* parent) :
 void PathologyViewer::setLabelMapVisible()
 {
     qDebug() << "setLabelMapVisible called";
+    if (!_labelWin)
+        return;
     if (_labelWin->isHidden())
     {
         _labelWin->show(); 
@@ -154,7 +196,7 @@ void PathologyViewer::setLabelMapVisible()
     }
    
     //changeViewPosWithAnimation();
-    emit viewShow(this->grab());
+    _snapshotService->requestSnapshot();
 }
 
 /**
@@ -163,6 +205,13 @@ void PathologyViewer::setLabelMapVisible()
  */
 void PathologyViewer::setDetailVisible()
 {
+    if (!_detailDialog)
+    {
+        if (!_img)
+            return;
+        // 属性尚未异步读取完成，同步读取
+        _detailDialog = new DetailDialog(this, _img->getProperties());
+    }
     if (_detailDialog->isHidden())
     {
         _detailDialog->show();
@@ -199,14 +248,30 @@ unsigned long long PathologyViewer::getCacheSize() {
 /**
  * @brief 设置缓存大小
  * @param maxCacheSize 新的缓存大小（字节）
- * @details 设置瓦片缓存的最大大小
+ * @details 设置瓦片缓存的期望上限，实际上限由MemoryGovernor在全局预算内分配
  */
 void PathologyViewer::setCacheSize(unsigned long long& maxCacheSize) {
-    if (_cache) {
+    _cacheSize = maxCacheSize;
+    if (_pixmapBudgetId) {
+        MemoryGovernor::instance()->setPreferredBytes(_pixmapBudgetId, maxCacheSize);
+    }
+    else if (_cache) {
         _cache->setMaxCacheSize(maxCacheSize);
     }
 }
 
+/**
+ * @brief 设置IO工作线程数量
+ * @param nrThreads 线程数量，0表示按CPU核数自动确定
+ * @details 瓦片信号由IOThread发出，调整线程数不需要重新连接
+ */
+void PathologyViewer::setIOThreadCount(unsigned int nrThreads) {
+    _ioThreadCount = nrThreads;
+    if (_ioThread) {
+        _ioThread->setNumberOfThreads(nrThreads);
+    }
+}
+
 /**
  * @brief 窗口大小改变事件处理
  * @param event 大小改变事件对象
@@ -259,42 +324,71 @@ void PathologyViewer::zoom(float numSteps) {
         _numScheduledScalings = numSteps;
     }
 
-    QTimeLine* anim = new QTimeLine(300, this);
-    anim->setUpdateInterval(5);
+    if (_activeZoomAnimations == 0) {
+        _zoomStartLevel = _img->getBestLevelForDownSample((1. / this->_sceneScale) / this->transform().m11());
+    }
+    ++_activeZoomAnimations;
 
-    connect(anim, SIGNAL(valueChanged(qreal)), SLOT(scalingTime(qreal)));
-    connect(anim, SIGNAL(finished()), SLOT(zoomFinished()));
-    anim->start();
+    _animationDriver->start(300, [this](qreal x, qreal frameTime) { scalingTime(x, frameTime); }, [this]() { zoomFinished(); });
 }
 
 /**
  * @brief 缩放动画时间处理
  * @param x 动画进度值
- * @details 在缩放动画过程中更新变换矩阵
+ * @param frameTime 距上一帧的毫秒数
+ * @details 原来每kLegacyZoomInterval毫秒乘一次1 + n * x / 300，这里按帧长换算为等效的幂，
+ *          缩放速度与帧率无关；同一帧的多个缩放动画累乘后由onAnimationFrame一次应用
  */
-void PathologyViewer::scalingTime(qreal x)
+void PathologyViewer::scalingTime(qreal x, qreal frameTime)
 {
-    qreal factor = 1.0 + qreal(_numScheduledScalings) * x / 300.;
-    float maxDownsample = 1. / this->_sceneScale;
-    QRectF FOV = this->mapToScene(this->rect()).boundingRect();
-    QRectF FOVImage = QRectF(FOV.left() / this->_sceneScale, FOV.top() / this->_sceneScale, FOV.width() / this->_sceneScale, FOV.height() / this->_sceneScale);
-    float scaleX = static_cast<float>(_img->getDimensions()[0]) / FOVImage.width();
-    float scaleY = static_cast<float>(_img->getDimensions()[1]) / FOVImage.height();
-    float minScale = scaleX > scaleY ? scaleY : scaleX;
-    float maxScale = scaleX > scaleY ? scaleX : scaleY;
-    if ((factor < 1.0 && maxScale < 0.5) || (factor > 1.0 && minScale > 2 * maxDownsample)) {
+    const qreal factor = 1.0 + qreal(_numScheduledScalings) * x / 300.;
+    if (factor > 0.) {
+        _frameZoomFactor *= std::pow(factor, frameTime / kLegacyZoomInterval);
+    }
+}
+void PathologyViewer::onAnimationFrame()
+{
+    if (!_img) {
+        _frameZoomFactor = 1.;
         return;
     }
-    scale(factor, factor);
-    centerOn(_zoomToScenePos);
-    QPointF delta_viewport_pos = _zoomToViewPos - QPointF(width() / 2.0, height() / 2.0);
-    QPointF viewport_center = mapFromScene(_zoomToScenePos) - delta_viewport_pos;
-    centerOn(mapToScene(viewport_center.toPoint()));
-    float tm11 = this->transform().m11();
-    emit fieldOfViewChanged(FOVImage, _img->getBestLevelForDownSample((1. / this->_sceneScale) / this->transform().m11()));
-    emit updateBBox(FOV);
+    const qreal factor = _frameZoomFactor;
+    _frameZoomFactor = 1.;
+    if (factor != 1.) {
+        float maxDownsample = 1. / this->_sceneScale;
+        QRectF FOV = this->mapToScene(this->rect()).boundingRect();
+        QRectF FOVImage = QRectF(FOV.left() / this->_sceneScale, FOV.top() / this->_sceneScale, FOV.width() / this->_sceneScale, FOV.height() / this->_sceneScale);
+        float scaleX = static_cast<float>(_img->getDimensions()[0]) / FOVImage.width();
+        float scaleY = static_cast<float>(_img->getDimensions()[1]) / FOVImage.height();
+        float minScale = scaleX > scaleY ? scaleY : scaleX;
+        float maxScale = scaleX > scaleY ? scaleX : scaleY;
+        if (!((factor < 1.0 && maxScale < 0.5) || (factor > 1.0 && minScale > 2 * maxDownsample))) {
+            scale(factor, factor);
+            centerOn(_zoomToScenePos);
+            QPointF delta_viewport_pos = _zoomToViewPos - QPointF(width() / 2.0, height() / 2.0);
+            QPointF viewport_center = mapFromScene(_zoomToScenePos) - delta_viewport_pos;
+            centerOn(mapToScene(viewport_center.toPoint()));
+        }
+    }
+    // 本帧所有动画都已推进，视场、小地图和比例因子只更新一次
+    updateFieldOfView();
+    emit updateBBox(this->mapToScene(this->rect()).boundingRect());
     emit factorTrans(float(transform().m11()));
 }
+void PathologyViewer::updateFieldOfView()
+{
+    if (!_img) {
+        return;
+    }
+    QRectF FOV = this->mapToScene(this->rect()).boundingRect();
+    QRectF FOVImage = QRectF(FOV.left() / this->_sceneScale, FOV.top() / this->_sceneScale, FOV.width() / this->_sceneScale, FOV.height() / this->_sceneScale);
+    unsigned int level = _img->getBestLevelForDownSample((1. / this->_sceneScale) / this->transform().m11());
+    if (_activeZoomAnimations > 0 && level < _zoomStartLevel) {
+        // 中间层级只显示几帧，放大过程中沿用动画开始前的层级
+        level = _zoomStartLevel;
+    }
+    emit fieldOfViewChanged(FOVImage, level);
+}
 void PathologyViewer::setChangedMpp(float mpp)
 {
     _scaleBar->setResolution(mpp);
@@ -310,14 +404,14 @@ void PathologyViewer::zoomFinished()
         _numScheduledScalings--;
     else
         _numScheduledScalings++;
-    emit factorTrans(float(transform().m11()));
-    
-    if (m_zoomTimer.isValid()) {
-        qint64 zoomTime = m_zoomTimer.elapsed();
-        qDebug() << "🔍 Zoom delay:" << zoomTime << "ms";
+    // 最后一个缩放动画结束后，本帧的onAnimationFrame按目标层级请求瓦片
+    if (_activeZoomAnimations > 0) {
+        --_activeZoomAnimations;
+    }
+
+    if (m_zoomTimer.isValid() && _activeZoomAnimations == 0) {
+        PipelineProfiler::record(PipelineProfiler::ZoomInteraction, m_zoomTimer.nsecsElapsed());
     }
-    
-    sender()->~QObject();
 }
 void PathologyViewer::handleItemSelection(QGraphicsItem* item)
 {
@@ -344,54 +438,105 @@ void PathologyViewer::moveTo(const QPointF& pos) {
     QRectF FOVImage = QRectF(FOV.left() / this->_sceneScale, FOV.top() / this->_sceneScale, FOV.width() / this->_sceneScale, FOV.height() / this->_sceneScale);
     emit fieldOfViewChanged(FOVImage, _img->getBestLevelForDownSample(maxDownsample / this->transform().m11()));
     emit updateBBox(FOV);
+    if (_annotationStore) {
+        instantiateStoredAnnotations(FOVImage);
+    }
+}
+double PathologyViewer::getMicronsPerPixel() const {
+    if (!_img) {
+        return 0.;
+    }
+    const std::vector<double> spacing = _img->getSpacing();
+    return spacing.empty() ? 0. : spacing[0];
+}
+QPointF PathologyViewer::getViewCenter() const {
+    return this->mapToScene(this->viewport()->rect().center()) / this->_sceneScale;
+}
+double PathologyViewer::getViewScale() const {
+    const QTransform& t = this->transform();
+    return std::sqrt(t.m11() * t.m11() + t.m12() * t.m12()) * this->_sceneScale;
+}
+void PathologyViewer::setView(const QPointF& center, double viewScale) {
+    if (!_img || viewScale <= 0.) {
+        return;
+    }
+    const double currentScale = getViewScale();
+    if (currentScale > 0. && std::abs(viewScale / currentScale - 1.) > 1e-6) {
+        this->scale(viewScale / currentScale, viewScale / currentScale);
+    }
+    moveTo(center * this->_sceneScale);
+    emit factorTrans(float(transform().m11()));
 }
 void PathologyViewer::onFieldOfViewChanged(const QRectF& FOV, const unsigned int level) {
     if (_manager) {
-        _manager->loadTilesForFieldOfView(FOV, level);
+        if (this->transform().isRotating()) {
+            // 旋转后外接矩形远大于视口，只请求与实际视口相交的瓦片
+            QPolygonF viewport = this->mapToScene(this->rect());
+            _manager->loadTilesForFieldOfView(QTransform::fromScale(1. / this->_sceneScale, 1. / this->_sceneScale).map(viewport), level);
+        }
+        else {
+            _manager->loadTilesForFieldOfView(FOV, level);
+        }
+        if (_prefetchthread) {
+            _prefetchthread->FOVChanged(_img, FOV, level, _manager->getLevelTileSizes(), _ioThread->getZPlane());
+        }
     }
 }
 void PathologyViewer::initialize(std::shared_ptr<MultiResolutionImage> img) {
     if (m_isFirstLoad) {
         m_loadTimer.start();
-        qDebug() << "🚀 Image loading started...";
     }
     close();
     setEnabled(true);
     _img = img;
-    unsigned int tileSize = 512;
-    unsigned int lastLevel = _img->getNumberOfLevels() - 1;
-    for (int i = lastLevel; i >= 0; --i) {
-        std::vector<unsigned long long> lastLevelDimensions = _img->getLevelDimensions(i);
-        if (lastLevelDimensions[0] > tileSize && lastLevelDimensions[1] > tileSize) {
-            lastLevel = i;
-            break;
-        }
-    }
-    if (!_img->getLabel().isNull())
-    {
-        _labelWin = new LabelWin(this, _img->getLabel());
-        _labelWin->hide();
-    }
-
-    _detailDialog = new DetailDialog(this, _img->getProperties());
-    _detailDialog->hide();
+    // 瓦片网格与文件的原生瓦片对齐，每个瓦片任务只解码一个压缩瓦片；
+    // 粗层级用更大的瓦片，慢速存储上的细层级用更小的瓦片
+    unsigned int tileSize = TileManager::alignedTileSize(_img, _tileSize);
+    unsigned int lastLevel = SlideLoader::getOverviewLevel(_img, tileSize);
+    std::vector<unsigned int> levelTileSizes = TileManager::levelTileSizes(_img, _tileSize, lastLevel, _img->getReadLatency());
+    // 标签图像和属性由SlideLoader在首屏显示后读取，见setAssociatedData
+    _labelWin = new LabelWin(this);
+    _labelWin->hide();
+    _snapshotService->addOverlay(_labelWin);
 
     _cache = new WSITileGraphicsItemCache();
     _cache->setMaxCacheSize(_cacheSize);
-    _ioThread = new IOThread(this);
+    // 像素图缓存和解码瓦片缓存的上限由全局内存预算统一分配，多个切片同时打开时总用量不超过预算
+    WSITileGraphicsItemCache* cache = _cache;
+    std::weak_ptr<MultiResolutionImage> weakImg = _img;
+    MemoryGovernor* governor = MemoryGovernor::instance();
+    _pixmapBudgetId = governor->registerConsumer(MemoryGovernor::TilePixmaps,
+        [cache]() { return cache->currentCacheSize(); },
+        [cache](unsigned long long limit) { cache->setMaxCacheSize(limit); }, _cacheSize,
+        [this]() { return _manager ? _manager->getForegroundSourceBytes() : 0ULL; });
+    _decodedBudgetId = governor->registerConsumer(MemoryGovernor::DecodedTiles,
+        [weakImg]() { std::shared_ptr<MultiResolutionImage> img = weakImg.lock(); return img ? img->getCacheUsage() : 0ULL; },
+        [weakImg](unsigned long long limit) { if (std::shared_ptr<MultiResolutionImage> img = weakImg.lock()) { img->setCacheSize(limit); } },
+        _img->getCacheSize());
+    _ioThread = new IOThread(this, _ioThreadCount);
     _ioThread->setBackgroundImage(img);
-    _manager = new TileManager(_img, tileSize, lastLevel, _ioThread, _cache, scene());
+    _ioThread->setZPlane(_img->getCurrentZPlaneIndex());
+    _ioThread->setEnhancement(_enhancement[0], _enhancement[1], _enhancement[2], _enhancement[3]);
+    // 前景瓦片缓存同样保存像素图，与场景瓦片缓存一起分配像素图预算
+    std::shared_ptr<OverlayTileCache> overlayCache = _ioThread->getOverlayCache();
+    _overlayBudgetId = governor->registerConsumer(MemoryGovernor::TilePixmaps,
+        [overlayCache]() { return overlayCache->currentCacheSize(); },
+        [overlayCache](unsigned long long limit) { overlayCache->setMaxCacheSize(limit); }, OverlayTileCache::kDefaultMaxByteSize);
+    _manager = new TileManager(_img, levelTileSizes, lastLevel, _ioThread, _cache, scene());
+    _prefetchthread = new PrefetchThread(this);
     setMouseTracking(true);
-    std::vector<IOWorker*> workers = _ioThread->getWorkers();
-    for (int i = 0; i < workers.size(); ++i) {
-        QObject::connect(workers[i], SIGNAL(tileLoaded(QPixmap*, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, ImageSource*, QPixmap*)), _manager, SLOT(onTileLoaded(QPixmap*, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, ImageSource*, QPixmap*)));
-        QObject::connect(workers[i], SIGNAL(foregroundTileRendered(QPixmap*, unsigned int, unsigned int, unsigned int)), _manager, SLOT(onForegroundTileRendered(QPixmap*, unsigned int, unsigned int, unsigned int)));
-    }
+    QObject::connect(_ioThread, SIGNAL(tileLoaded(QPixmap*, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, ImageSource*, QPixmap*, unsigned int, unsigned int)), _manager, SLOT(onTileLoaded(QPixmap*, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, ImageSource*, QPixmap*, unsigned int, unsigned int)));
+    QObject::connect(_ioThread, SIGNAL(foregroundTileRendered(QPixmap*, unsigned int, unsigned int, unsigned int, unsigned int)), _manager, SLOT(onForegroundTileRendered(QPixmap*, unsigned int, unsigned int, unsigned int, unsigned int)));
+    QObject::connect(_ioThread, SIGNAL(backgroundTileRendered(QPixmap*, unsigned int, unsigned int, unsigned int, unsigned int)), _manager, SLOT(onBackgroundTileRendered(QPixmap*, unsigned int, unsigned int, unsigned int, unsigned int)));
+    QObject::connect(_ioThread, SIGNAL(tilePreviewLoaded(QPixmap*, unsigned int, unsigned int, unsigned int, unsigned int)), _manager, SLOT(onTilePreviewLoaded(QPixmap*, unsigned int, unsigned int, unsigned int, unsigned int)));
+    _manager->setProgressiveDecoding(true);
     initializeImage(scene(), tileSize, lastLevel);
     initializeGUIComponents(lastLevel);
     QObject::connect(this, SIGNAL(backgroundChannelChanged(int)), _ioThread, SLOT(onBackgroundChannelChanged(int)));
     QObject::connect(_cache, SIGNAL(itemEvicted(WSITileGraphicsItem*)), _manager, SLOT(onTileRemoved(WSITileGraphicsItem*)));
     QObject::connect(this, SIGNAL(fieldOfViewChanged(const QRectF, const unsigned int)), this, SLOT(onFieldOfViewChanged(const QRectF, const unsigned int)));
+    restoreViewerSnapshot();
+    _statisticsBuilder = startStatistics(_img, false);
     QRectF FOV = this->mapToScene(this->rect()).boundingRect();
     QRectF FOVImage = QRectF(FOV.left() / this->_sceneScale, FOV.top() / this->_sceneScale, FOV.width() / this->_sceneScale, FOV.height() / this->_sceneScale);
     emit fieldOfViewChanged(FOVImage, _img->getBestLevelForDownSample((1. / this->_sceneScale) / this->transform().m11()));
@@ -401,13 +546,169 @@ void PathologyViewer::initialize(std::shared_ptr<MultiResolutionImage> img) {
     // 记录初始图像中心
     _initialCenter = this->mapToScene(this->viewport()->rect().center());
     // 记录初始_sceneScale
-    emit viewShow(this->grab());
+    _snapshotService->invalidateScene();
+    _snapshotService->requestSnapshot();
+}
+void PathologyViewer::saveViewerSnapshot() {
+    if (!_img || !_manager || !_cache || !_ioThread) {
+        return;
+    }
+    std::shared_ptr<DiskTileCache> diskCache = _img->getDiskCache();
+    if (!diskCache) {
+        return;
+    }
+    ViewerSnapshot snapshot;
+    snapshot.center = getViewCenter();
+    snapshot.viewScale = getViewScale();
+    snapshot.zPlane = _ioThread->getZPlane();
+    snapshot.foregroundChannel = _ioThread->getForegroundChannel();
+    snapshot.foregroundOpacity = _opacity;
+    snapshot.renderForeground = _renderForeground;
+    // 只保存视场内的瓦片，细层级在前，恢复时首屏最先需要的瓦片最先排队
+    const QPolygonF viewport = this->mapToScene(this->rect());
+    const QRectF FOV = QTransform::fromScale(1. / this->_sceneScale, 1. / this->_sceneScale).map(viewport).boundingRect();
+    for (WSITileGraphicsItem* item : _cache->getAllItems()) {
+        const unsigned int level = item->getTileLevel();
+        if (_manager->providesCoverage(level, item->getTileX(), item->getTileY()) != 2) {
+            continue;
+        }
+        const unsigned int tileSize = _manager->getTileSize(level);
+        const double tileExtent = tileSize * _img->getLevelDownsample(level);
+        if (QRectF(item->getTileX() * tileExtent, item->getTileY() * tileExtent, tileExtent, tileExtent).intersects(FOV)) {
+            snapshot.tiles.push_back({ level, item->getTileX(), item->getTileY(), tileSize });
+        }
+    }
+    std::stable_sort(snapshot.tiles.begin(), snapshot.tiles.end(), [](const ViewerSnapshot::TileKey& a, const ViewerSnapshot::TileKey& b) {
+        return a.level < b.level;
+    });
+    snapshot.save(diskCache->sidecarPath(ViewerSnapshot::kFileSuffix));
+}
+bool PathologyViewer::restoreViewerSnapshot() {
+    std::shared_ptr<DiskTileCache> diskCache = _img ? _img->getDiskCache() : std::shared_ptr<DiskTileCache>();
+    if (!diskCache || !_manager || !_ioThread) {
+        return false;
+    }
+    ViewerSnapshot snapshot;
+    if (!snapshot.load(diskCache->sidecarPath(ViewerSnapshot::kFileSuffix))) {
+        return false;
+    }
+    if (_img->getNumberOfZPlanes() > 1) {
+        setZPlane(static_cast<int>(snapshot.zPlane));
+    }
+    _ioThread->onForegroundChannelChanged(snapshot.foregroundChannel);
+    setForegroundOpacity(snapshot.foregroundOpacity);
+    setEnableForegroundRendering(snapshot.renderForeground);
+    // 快照中的瓦片先于视场内的其余瓦片排队，视场请求时它们已标记为加载中，不会重复排队；
+    // 层级的瓦片大小与保存时不同（读取延迟变化）时瓦片索引已不对应，跳过
+    for (const ViewerSnapshot::TileKey& tile : snapshot.tiles) {
+        if (tile.tileSize == _manager->getTileSize(tile.level)) {
+            _manager->loadTile(tile.level, static_cast<int>(tile.x), static_cast<int>(tile.y));
+        }
+    }
+    setView(snapshot.center, snapshot.viewScale);
+    return true;
+}
+std::shared_ptr<SlideStatisticsBuilder> PathologyViewer::startStatistics(const std::shared_ptr<MultiResolutionImage>& img, bool foreground) {
+    if (!img || !_ioThread) {
+        return std::shared_ptr<SlideStatisticsBuilder>();
+    }
+    std::shared_ptr<DiskTileCache> diskCache = img->getDiskCache();
+    const QString path = diskCache ? diskCache->sidecarPath(SlideStatistics::kFileSuffix) : QString();
+    std::shared_ptr<SlideStatistics> statistics = img->getStatistics();
+    if (!statistics) {
+        // 前景图像不经过SlideLoader，在这里读取或创建统计
+        if (img->getColorType() == SlideColorManagement::ColorType::RGB || img->getColorType() == SlideColorManagement::ColorType::RGBA) {
+            return std::shared_ptr<SlideStatisticsBuilder>();
+        }
+        if (!path.isEmpty()) {
+            statistics = SlideStatistics::load(path, img.get());
+        }
+        if (!statistics) {
+            statistics = SlideStatistics::create(img.get());
+        }
+        if (!statistics) {
+            return std::shared_ptr<SlideStatisticsBuilder>();
+        }
+        img->setStatistics(statistics);
+    }
+    std::shared_ptr<SlideStatisticsBuilder> builder = std::make_shared<SlideStatisticsBuilder>(img, statistics, path);
+    if (builder->getNumberOfTiles() == 0) {
+        return std::shared_ptr<SlideStatisticsBuilder>();
+    }
+    // 范围层级变化后已显示的瓦片按新的范围就地重新转换，不重新读取
+    QObject::connect(builder.get(), &SlideStatisticsBuilder::rangeChanged, this, [this, foreground]() {
+        if (!_manager) {
+            return;
+        }
+        if (foreground) {
+            _manager->updateTileForegounds();
+        }
+        else {
+            _manager->updateTileBackgrounds(true);
+        }
+    }, Qt::QueuedConnection);
+    _ioThread->addTileTask(builder, 1);
+    return builder;
+}
+void PathologyViewer::stopStatistics(std::shared_ptr<SlideStatisticsBuilder>& builder, const std::shared_ptr<MultiResolutionImage>& img) {
+    if (builder) {
+        builder->cancel();
+        QObject::disconnect(builder.get(), nullptr, this, nullptr);
+        builder.reset();
+    }
+    std::shared_ptr<SlideStatistics> statistics = img ? img->getStatistics() : std::shared_ptr<SlideStatistics>();
+    std::shared_ptr<DiskTileCache> diskCache = img ? img->getDiskCache() : std::shared_ptr<DiskTileCache>();
+    if (statistics && diskCache) {
+        statistics->save(diskCache->sidecarPath(SlideStatistics::kFileSuffix));
+    }
 }
 void PathologyViewer::onForegroundImageChanged(std::weak_ptr<MultiResolutionImage> for_img, float scale) {
+    stopStatistics(_foregroundStatisticsBuilder, _for_img.lock());
     _for_img = for_img;
     if (_ioThread) {
+        _foregroundStatisticsBuilder = startStatistics(_for_img.lock(), true);
         _ioThread->setForegroundImage(_for_img, scale);
-        _manager->refresh();
+        // 只重新加载前景，背景瓦片保留在场景中，前景瓦片缓存命中时切换几乎没有延迟
+        _manager->reloadForegrounds();
+    }
+}
+bool PathologyViewer::setPointDensityOverlay(const QString& pointsPath, bool kernelDensity) {
+    if (!_img || !_ioThread) {
+        return false;
+    }
+    std::shared_ptr<PointDensityImage> overlay = std::make_shared<PointDensityImage>(*_img,
+        kernelDensity ? PointDensityImage::KernelDensity : PointDensityImage::BinCount);
+    if (!overlay->initialize(pointsPath.toStdString())) {
+        return false;
+    }
+    _pointOverlay = overlay;
+    // 查找表在切换前景之前设置，只重新加载一次前景
+    _ioThread->onLUTChanged(SlideColorManagement::DefaultColorLUT["Heatmap"]);
+    onForegroundImageChanged(_pointOverlay, 1.);
+    return true;
+}
+void PathologyViewer::setOverview(const QImage& overview) {
+    _overview = overview;
+    if (_map) {
+        _map->setOverview(QPixmap::fromImage(overview));
+    }
+    updateOverviewBase();
+}
+void PathologyViewer::updateOverviewBase() {
+    if (!_manager || !_ioThread || _overview.isNull()) {
+        return;
+    }
+    // 与背景瓦片一样经过ICC转换和增强，瓦片被淘汰后露出的缩略图颜色不变
+    QImage base = IOWorker::postProcessTile(_overview.convertToFormat(QImage::Format_ARGB32_Premultiplied), *_ioThread->getSettings());
+    _manager->setOverview(QPixmap::fromImage(base));
+}
+void PathologyViewer::setAssociatedData(const QImage& label, const std::vector<SlideColorManagement::PropertyInfo>& properties) {
+    if (_labelWin) {
+        _labelWin->setLabel(label);
+    }
+    if (_img && !_detailDialog) {
+        _detailDialog = new DetailDialog(this, properties);
+        _detailDialog->hide();
     }
 }
 void PathologyViewer::setForegroundLUT(const SlideColorManagement::LUT& LUT)
@@ -427,6 +728,103 @@ void PathologyViewer::setForegroundChannel(unsigned int channel) {
         }
     }
 }
+void PathologyViewer::setChannelComposite(const std::vector<SlideColorManagement::ChannelDisplay>& channels) {
+    if (_ioThread) {
+        _ioThread->setChannelComposite(channels);
+        if (_manager) {
+            _manager->updateTileBackgrounds();
+        }
+    }
+}
+bool PathologyViewer::autoContrastChannels(std::vector<SlideColorManagement::ChannelDisplay>& channels, double lowPercentile, double highPercentile) {
+    std::shared_ptr<SlideStatistics> statistics = _img ? _img->getStatistics() : std::shared_ptr<SlideStatistics>();
+    if (!statistics) {
+        return false;
+    }
+    // 视野瓦片可能已经补全了更精细的层级
+    statistics->updateRange();
+    std::vector<SlideColorManagement::ChannelDisplay> adjusted = channels;
+    for (unsigned int i = 0; i < adjusted.size() && i < statistics->getNumberOfChannels(); ++i) {
+        if (!statistics->getAutoWindow(i, lowPercentile, highPercentile, adjusted[i].windowMin, adjusted[i].windowMax)) {
+            return false;
+        }
+    }
+    channels.swap(adjusted);
+    setChannelComposite(channels);
+    return true;
+}
+void PathologyViewer::setEnhancement(float sharpness, float gamma, float brightness, float contrast) {
+    _enhancement[0] = sharpness;
+    _enhancement[1] = gamma;
+    _enhancement[2] = brightness;
+    _enhancement[3] = contrast;
+    if (_ioThread) {
+        _ioThread->setEnhancement(sharpness, gamma, brightness, contrast);
+        if (_manager) {
+            _manager->updateTileBackgrounds(true);
+        }
+        updateOverviewBase();
+    }
+}
+void PathologyViewer::setZPlane(int zPlane) {
+    if (!_img || !_ioThread || !_manager) {
+        return;
+    }
+    zPlane = std::max(0, std::min(zPlane, _img->getNumberOfZPlanes() - 1));
+    if (static_cast<unsigned int>(zPlane) == _ioThread->getZPlane()) {
+        return;
+    }
+    // 区域导出和分析读取当前平面，与显示保持一致
+    _img->setCurrentZPlaneIndex(zPlane);
+    _ioThread->setZPlane(zPlane);
+    _manager->updateTileBackgrounds();
+    // 重新通知预取线程，预取新平面的相邻平面
+    updateCurrentFieldOfView();
+}
+int PathologyViewer::getZPlane() const {
+    return _ioThread ? static_cast<int>(_ioThread->getZPlane()) : 0;
+}
+void PathologyViewer::setStatisticsOverlayVisible(bool visible) {
+    if (visible == _statisticsOverlayVisible) {
+        return;
+    }
+    _statisticsOverlayVisible = visible;
+    PipelineProfiler::setEnabled(visible);
+    if (visible) {
+        _statisticsOverlayTimer.start();
+    }
+    else {
+        _statisticsOverlayTimer.stop();
+    }
+    viewport()->update();
+}
+bool PathologyViewer::isStatisticsOverlayVisible() const {
+    return _statisticsOverlayVisible;
+}
+void PathologyViewer::setOpenGLViewport(bool enable) {
+    if (enable == _openGLViewport) {
+        return;
+    }
+    if (enable) {
+        QOpenGLWidget* glViewport = new QOpenGLWidget();
+        QSurfaceFormat format = glViewport->format();
+        format.setSwapInterval(1);
+        glViewport->setFormat(format);
+        setViewport(glViewport);
+        _animationDriver->setFrameSource(glViewport);
+    }
+    else {
+        _animationDriver->setFrameSource(NULL);
+        setViewport(new QWidget());
+    }
+    // GPU上双线性过滤几乎没有代价，光栅视口下保持最近邻以免缩放动画占满CPU
+    setRenderHint(QPainter::SmoothPixmapTransform, enable);
+    viewport()->setMouseTracking(true);
+    _openGLViewport = enable;
+}
+bool PathologyViewer::isOpenGLViewport() const {
+    return _openGLViewport;
+}
 void PathologyViewer::setEnableForegroundRendering(bool enableForegroundRendering)
 {
     _renderForeground = enableForegroundRendering;
@@ -449,39 +847,28 @@ void PathologyViewer::initializeImage(QGraphicsScene* scn, unsigned int tileSize
     QRectF FOVImage = QRectF(FOV.left() / this->_sceneScale, FOV.top() / this->_sceneScale, FOV.width() / this->_sceneScale, FOV.height() / this->_sceneScale);
     emit fieldOfViewChanged(FOVImage, _img->getBestLevelForDownSample(maxDownsample / this->transform().m11()));
     emit factorTrans(transform().m11());
-    emit mppTrans(float(_detailDialog->retMpp()));
+    // 像素间距在打开时已从元数据读取，无需等待属性列表
+    const std::vector<double> spacing = _img->getSpacing();
+    const double mpp = spacing.empty() ? 0. : spacing[0];
+    emit mppTrans(float(mpp));
     
-    double fac = _detailDialog->retMpp()/_sceneScale;
+    double fac = mpp/_sceneScale;
     m_pGraphicsScene->setPixelSize(fac);
-    while (_ioThread->numberOfJobs() > 0) {
-    }
-    
+    // 缩略图层级的瓦片由IOThread异步加载并逐个显示，这里不再等待队列清空
+
     if (m_isFirstLoad) {
-        qint64 loadTime = m_loadTimer.elapsed();
-        qDebug() << "⏱️ First To View:" << loadTime << "ms";
+        PipelineProfiler::record(PipelineProfiler::FirstView, m_loadTimer.nsecsElapsed());
         m_isFirstLoad = false;
     }
 }
 void PathologyViewer::initializeGUIComponents(unsigned int level) {
-    // Initialize the minimap
+    // Initialize the minimap，缩略图由SlideLoader在后台读取，先以同尺寸占位图保证坐标映射正确
     std::vector<unsigned long long> overviewDimensions = _img->getLevelDimensions(level);
-    unsigned int size = overviewDimensions[0] * overviewDimensions[1] * _img->getSamplesPerPixel();
-    unsigned char* overview = new unsigned char[size];
-    _img->getRawRegion<unsigned char>(0, 0, overviewDimensions[0], overviewDimensions[1], level, overview);
-    QImage ovImg;
-    if (_img->getColorType() == SlideColorManagement::ColorType::RGBA) {
-        ovImg = QImage(overview, overviewDimensions[0], overviewDimensions[1], overviewDimensions[0] * 4, QImage::Format_RGBA8888).convertToFormat(QImage::Format_RGB888);
-    }
-    else if (_img->getColorType() == SlideColorManagement::ColorType::RGB) {
-        ovImg = QImage(overview, overviewDimensions[0], overviewDimensions[1], overviewDimensions[0] * 3, QImage::Format_RGB888);
-    }
-    QPixmap ovPixMap = QPixmap(QPixmap::fromImage(ovImg));
-    delete[] overview;
     if (_map) {
         _map->deleteLater();
         _map = NULL;
     }
-    _map = new MiniMap(ovPixMap, this);
+    _map = new MiniMap(QSize(overviewDimensions[0], overviewDimensions[1]), this);
     QWidget* parent = this->parentWidget();
     if (_scaleBar) {
         _scaleBar->deleteLater();
@@ -517,6 +904,10 @@ void PathologyViewer::initializeGUIComponents(unsigned int level) {
     _map->toggleCoverageMap(false);
     QObject::connect(this, SIGNAL(updateBBox(const QRectF&)), _map, SLOT(updateFieldOfView(const QRectF&)));
     QObject::connect(_manager, SIGNAL(coverageUpdated()), _map, SLOT(onCoverageUpdated()));
+    QObject::connect(_manager, SIGNAL(tileDisplayed(const QPixmap&, const QRectF&)), _map, SLOT(onTileDisplayed(const QPixmap&, const QRectF&)));
+    QObject::connect(_manager, SIGNAL(tileDisplayed(const QPixmap&, const QRectF&)), _snapshotService, SLOT(invalidateScene()));
+    _snapshotService->addOverlay(_map);
+    _snapshotService->addOverlay(_scaleBar);
     QObject::connect(_map, SIGNAL(positionClicked(QPointF)), this, SLOT(moveTo(const QPointF&)));
     QObject::connect(this, SIGNAL(fieldOfViewChanged(const QRectF&, const unsigned int)), _scaleBar, SLOT(updateForFieldOfView(const QRectF&)));
     _map->show();
@@ -526,14 +917,187 @@ void PathologyViewer::initializeGUIComponents(unsigned int level) {
 }
 
 
+AnnotationLayerItem* PathologyViewer::getAnnotationLayer() {
+    if (!_annotationLayer) {
+        _annotationLayer = new AnnotationLayerItem();
+        scene()->addItem(_annotationLayer);
+    }
+    return _annotationLayer;
+}
+
+bool PathologyViewer::loadAnnotations(const QString& path) {
+    AnnotationStoreReader* store = new AnnotationStoreReader();
+    if (!store->open(path)) {
+        delete store;
+        return false;
+    }
+    delete _annotationStore;
+    _annotationStore = store;
+    _loadedAnnotationChunks.assign(store->getNumberOfChunks(), false);
+    if (_img) {
+        updateCurrentFieldOfView();
+    }
+    return true;
+}
+
+void PathologyViewer::instantiateStoredAnnotations(const QRectF& FOV) {
+    std::vector<AnnotationRecord> records;
+    for (int chunk : _annotationStore->chunksInRect(FOV)) {
+        if (_loadedAnnotationChunks[chunk]) {
+            continue;
+        }
+        _loadedAnnotationChunks[chunk] = true;
+        records.clear();
+        _annotationStore->readChunk(chunk, records);
+        for (const AnnotationRecord& record : records) {
+            if (QGraphicsItem* item = record.createElement(_sceneScale)) {
+                scene()->addItem(item);
+            }
+        }
+    }
+}
+
+bool PathologyViewer::saveAnnotations(const QString& path) {
+    if (_annotationStore && QFileInfo(path) == QFileInfo(_annotationStore->fileName())) {
+        qDebug() << "PathologyViewer: cannot overwrite the open annotation store" << path;
+        return false;
+    }
+    AnnotationStoreWriter writer;
+    if (!writer.open(path)) {
+        return false;
+    }
+    bool ok = true;
+    AnnotationRecord record;
+    const QList<QGraphicsItem*> items = scene()->items();
+    for (QGraphicsItem* item : items) {
+        if (item != m_pTempItem && AnnotationRecord::fromElement(item, _sceneScale, record)) {
+            ok = ok && writer.add(record);
+        }
+    }
+    // 未创建图形项的数据块直接从原存储复制
+    if (_annotationStore) {
+        std::vector<AnnotationRecord> records;
+        for (int chunk = 0; chunk < _annotationStore->getNumberOfChunks() && ok; ++chunk) {
+            if (_loadedAnnotationChunks[chunk]) {
+                continue;
+            }
+            records.clear();
+            ok = _annotationStore->readChunk(chunk, records);
+            for (const AnnotationRecord& stored : records) {
+                ok = ok && writer.add(stored);
+            }
+        }
+    }
+    return writer.close() && ok;
+}
+
+std::shared_ptr<RegionAnalysis> PathologyViewer::analyzeRegion(const QPolygonF& scenePolygon, int level) {
+    if (!_img || !_ioThread) {
+        return std::shared_ptr<RegionAnalysis>();
+    }
+    if (level < 0) {
+        level = _img->getBestLevelForDownSample(1. / this->_sceneScale / this->transform().m11());
+    }
+    QPolygonF polygon;
+    polygon.reserve(scenePolygon.size());
+    for (const QPointF& point : scenePolygon) {
+        polygon.append(point / this->_sceneScale);
+    }
+    std::shared_ptr<RegionAnalysis> analysis = std::make_shared<RegionAnalysis>(_img, polygon, level, _tileSize);
+    _ioThread->addTileTask(analysis);
+    return analysis;
+}
+
+std::shared_ptr<RegionExport> PathologyViewer::exportRegion(const QRectF& sceneRect, unsigned int level, const QString& path,
+    bool includeAnnotations, TiledTiffWriter::Compression compression) {
+    if (!_img || !_ioThread) {
+        return std::shared_ptr<RegionExport>();
+    }
+    const QRectF rect(sceneRect.left() / _sceneScale, sceneRect.top() / _sceneScale, sceneRect.width() / _sceneScale, sceneRect.height() / _sceneScale);
+    std::shared_ptr<RegionExport> regionExport = std::make_shared<RegionExport>(_img, rect, level, path);
+    regionExport->setCompression(compression);
+    regionExport->setBackgroundRendering(_ioThread->getBackgroundChannel(), _ioThread->getChannelComposite());
+    if (_renderForeground) {
+        regionExport->setForeground(_ioThread->getForegroundImage(), _ioThread->getForegroundImageScale(),
+            _ioThread->getForegroundChannel(), _ioThread->getLUT(), _opacity);
+    }
+    if (includeAnnotations) {
+        // 标注在GUI线程中转换为第0层坐标的记录，工作线程只读取记录
+        std::vector<AnnotationRecord> annotations;
+        AnnotationRecord record;
+        const QList<QGraphicsItem*> items = scene()->items(sceneRect);
+        for (QGraphicsItem* item : items) {
+            if (item != m_pTempItem && AnnotationRecord::fromElement(item, _sceneScale, record)) {
+                annotations.push_back(record);
+            }
+        }
+        if (_annotationLayer) {
+            for (int id : _annotationLayer->annotationsInRect(sceneRect)) {
+                AnnotationRecord polygon;
+                polygon.type = RenderElement::Contour;
+                polygon.color = _annotationLayer->getColor(id);
+                polygon.lineWidth = 1;
+                for (const QPointF& point : _annotationLayer->getPolygon(id)) {
+                    polygon.points.append(point / _sceneScale);
+                }
+                annotations.push_back(polygon);
+            }
+        }
+        if (_annotationStore) {
+            std::vector<AnnotationRecord> records;
+            for (int chunk : _annotationStore->chunksInRect(rect)) {
+                if (_loadedAnnotationChunks[chunk]) {
+                    continue;
+                }
+                records.clear();
+                _annotationStore->readChunk(chunk, records);
+                annotations.insert(annotations.end(), records.begin(), records.end());
+            }
+        }
+        regionExport->setAnnotations(annotations);
+    }
+    if (!regionExport->start()) {
+        return std::shared_ptr<RegionExport>();
+    }
+    _ioThread->addTileTask(regionExport);
+    return regionExport;
+}
+
 void PathologyViewer::close() {
     if (this->window()) {
     }
+    saveViewerSnapshot();
+    stopStatistics(_statisticsBuilder, _img);
+    stopStatistics(_foregroundStatisticsBuilder, _for_img.lock());
+    _animationDriver->stopAll();
+    _activeZoomAnimations = 0;
+    _numScheduledScalings = 0;
+    _frameZoomFactor = 1.;
     if (_prefetchthread) {
-        _prefetchthread->deleteLater();
+        // 同步停止预取线程，保证其不再访问即将释放的图像
+        delete _prefetchthread;
         _prefetchthread = NULL;
     }
+    if (_pixmapBudgetId) {
+        MemoryGovernor::instance()->unregisterConsumer(_pixmapBudgetId);
+        _pixmapBudgetId = 0;
+    }
+    if (_decodedBudgetId) {
+        MemoryGovernor::instance()->unregisterConsumer(_decodedBudgetId);
+        _decodedBudgetId = 0;
+    }
+    if (_overlayBudgetId) {
+        MemoryGovernor::instance()->unregisterConsumer(_overlayBudgetId);
+        _overlayBudgetId = 0;
+    }
     scene()->clear();
+    _annotationLayer = NULL;
+    if (_annotationStore) {
+        delete _annotationStore;
+        _annotationStore = NULL;
+    }
+    _loadedAnnotationChunks.clear();
+    _overview = QImage();
     if (_manager) {
         _manager->clear();
         delete _manager;
@@ -550,6 +1114,7 @@ void PathologyViewer::close() {
         _ioThread->deleteLater();
         _ioThread = NULL;
     }
+    _pointOverlay.reset();
     if (_map) {
         _map->setHidden(true);
         _map->deleteLater();
@@ -595,8 +1160,7 @@ void PathologyViewer::togglePan(bool pan, const QPoint& startPos) {
         setCursor(Qt::ArrowCursor);
         
         if (m_panTimer.isValid()) {
-            qint64 panTime = m_panTimer.elapsed();
-            qDebug() << "🖱️ Pan delay:" << panTime << "ms";
+            PipelineProfiler::record(PipelineProfiler::PanInteraction, m_panTimer.nsecsElapsed());
         }
     }
 }
@@ -634,7 +1198,7 @@ float PathologyViewer::getForegroundOpacity() const {
 void PathologyViewer::setMiniMapVisible(bool state)
 {
     _map->setVisible(state);
-    emit viewShow(this->grab());
+    _snapshotService->requestSnapshot();
 }
 void PathologyViewer::setCoverageArea(bool state)
 {
@@ -643,11 +1207,12 @@ void PathologyViewer::setCoverageArea(bool state)
 void PathologyViewer::setScaleBar(bool state)
 {
     _scaleBar->setVisible(state);
-    emit viewShow(this->grab());
+    _snapshotService->requestSnapshot();
 }
 void PathologyViewer::updateSnap()
 {
-    emit viewShow(this->grab());
+    _snapshotService->invalidateScene();
+    _snapshotService->requestSnapshot();
 
 }
 void PathologyViewer::setFileWidgetState(bool state)
@@ -687,12 +1252,12 @@ float PathologyViewer::getZoomSensitivity() const {
 };
 void PathologyViewer::reset()
 {
-    QTimeLine* anim = new QTimeLine(400, this);
-    anim->setUpdateInterval(10);
-
-    connect(anim, &QTimeLine::valueChanged, this, &PathologyViewer::resetTime);
-    connect(anim, &QTimeLine::finished, this, &PathologyViewer::resetFinished);
-    anim->start();
+    _animationDriver->start(400, [this](qreal x, qreal frameTime) { resetTime(legacyStepFraction(x, frameTime)); });
+}
+qreal PathologyViewer::legacyStepFraction(qreal x, qreal frameTime)
+{
+    // 原来每kLegacyAnimationInterval毫秒把剩余距离乘以(1 - x)，按帧长换算为等效的比例
+    return x >= 1. ? 1. : 1. - std::pow(1. - x, frameTime / kLegacyAnimationInterval);
 }
 void PathologyViewer::resetTime(qreal x)
 {
@@ -729,23 +1294,9 @@ void PathologyViewer::resetTime(qreal x)
         currentCenter.y() + (targetCenter.y() - currentCenter.y()) * x
     );
     this->centerOn(interpolatedCenter);
-    // 计算边缘变化信号
-    float maxDownsample = 1. / _sceneScale;
-    QRectF FOV = this->mapToScene(this->rect()).boundingRect();
-    QRectF FOVImage = QRectF(FOV.left() / _sceneScale, FOV.top() / _sceneScale, FOV.width() / _sceneScale, FOV.height() / _sceneScale);
-    emit fieldOfViewChanged(FOVImage, _img->getBestLevelForDownSample(maxDownsample / this->transform().m11()));
-    emit updateBBox(FOV);
-    emit factorTrans(float(transform().m11()));
-}
-void PathologyViewer::resetFinished()
-{
-    emit factorTrans(float(transform().m11()));
-    sender()->deleteLater();
+    // 视场、小地图和比例因子由本帧的onAnimationFrame统一更新
 }
 void PathologyViewer::zoomToFixedMagnification(float targetMagnification) {
-    QTimeLine* anim = new QTimeLine(450, this);
-    anim->setUpdateInterval(10);
-
     _initialCenterFixedScale = this->mapToScene(this->viewport()->rect().center());
 
     const qreal m11 = targetMagnification;
@@ -763,9 +1314,7 @@ void PathologyViewer::zoomToFixedMagnification(float targetMagnification) {
         m21,m22,m23,
         m31,m32,m33
     );
-    connect(anim, &QTimeLine::valueChanged, this, &PathologyViewer::zoomToFixedScaleTime);
-    connect(anim, &QTimeLine::finished, this, &PathologyViewer::zoomToFixedScaleFinished);
-    anim->start();
+    _animationDriver->start(450, [this](qreal x, qreal frameTime) { zoomToFixedScaleTime(legacyStepFraction(x, frameTime)); });
 }
 void PathologyViewer::zoomToFixedScaleTime(qreal x)
 {
@@ -802,18 +1351,7 @@ void PathologyViewer::zoomToFixedScaleTime(qreal x)
         currentCenter.y() + (targetCenter.y() - currentCenter.y()) * x
     );
     this->centerOn(interpolatedCenter);
-    // 计算边缘变化信号
-    float maxDownsample = 1. / _sceneScale;
-    QRectF FOV = this->mapToScene(this->rect()).boundingRect();
-    QRectF FOVImage = QRectF(FOV.left() / _sceneScale, FOV.top() / _sceneScale, FOV.width() / _sceneScale, FOV.height() / _sceneScale);
-    emit fieldOfViewChanged(FOVImage, _img->getBestLevelForDownSample(maxDownsample / this->transform().m11()));
-    emit updateBBox(FOV);
-    emit factorTrans(float(transform().m11()));
-}
-void PathologyViewer::zoomToFixedScaleFinished()
-{
-    emit factorTrans(float(transform().m11()));
-    sender()->deleteLater();
+    // 视场、小地图和比例因子由本帧的onAnimationFrame统一更新
 }
 
 void PathologyViewer::setPaintState(bool state)
@@ -975,6 +1513,8 @@ void PathologyViewer::mousePressEvent(QMouseEvent* event)
                 m_pTempItem = new ContourRenderElement("ContourRenderElement");
                 m_pGraphicsScene->addItem(m_pTempItem);
                 static_cast<ContourRenderElement*>(m_pTempItem)->setPen(m_penRealTime);
+                // 简化误差在当前缩放下不超过半个屏幕像素
+                static_cast<ContourRenderElement*>(m_pTempItem)->setSimplifyTolerance(0.5 / transform().m11());
             }
             break;
         default:
@@ -1056,7 +1596,8 @@ void PathologyViewer::mouseReleaseEvent(QMouseEvent* event)
         {
             return;
         }
-        emit areaAndPerimeterUpdated(static_cast<LineRenderElement*>(m_pTempItem)->getPerimeter(), static_cast<LineRenderElement*>(m_pTempItem)->getArea());
+        static_cast<ContourRenderElement*>(m_pTempItem)->finishContour();
+        emit areaAndPerimeterUpdated(static_cast<ContourRenderElement*>(m_pTempItem)->getPerimeter(), static_cast<ContourRenderElement*>(m_pTempItem)->getArea());
         if (static_cast<QGraphicsItem*>(m_pTempItem)->boundingRect().width() < 3)
         delete m_pTempItem;
         m_pTempItem = nullptr;
@@ -1145,9 +1686,9 @@ void PathologyViewer::mouseMoveEvent(QMouseEvent* event)
             return;
         }
             m_ptMove = event->pos();
-            m_polygon.push_back(mapToScene(m_ptMove));
-            static_cast<ContourRenderElement*>(m_pTempItem)->updateContour(m_polygon);
-            emit areaAndPerimeterUpdated(static_cast<LineRenderElement*>(m_pTempItem)->getPerimeter(), static_cast<LineRenderElement*>(m_pTempItem)->getArea());
+            ContourRenderElement* contour = static_cast<ContourRenderElement*>(m_pTempItem);
+            contour->addPoint(mapToScene(m_ptMove));
+            emit areaAndPerimeterUpdated(contour->getPerimeter(), contour->getArea());
         }
 
 }
@@ -1322,8 +1863,72 @@ void PathologyViewer::changeViewPosWithAnimation(bool clockwise)
 
 void PathologyViewer::paintEvent(QPaintEvent* event)
 {
-    QPainter painter(viewport());
-    painter.fillRect(viewport()->rect(), Qt::black);
-    QGraphicsView::paintEvent(event);
+    {
+        // 同一设备上不能同时有两个活动的QPainter，OpenGL视口下尤其如此
+        QPainter painter(viewport());
+        painter.fillRect(viewport()->rect(), Qt::black);
+    }
+    {
+        PipelineProfiler::ScopedTimer timer(PipelineProfiler::FramePaint);
+        QGraphicsView::paintEvent(event);
+    }
+    if (_statisticsOverlayVisible) {
+        QPainter painter(viewport());
+        drawStatisticsOverlay(painter);
+    }
     m_frameCount++; // 每帧计数增加
 }
+
+/**
+ * @brief 绘制性能统计浮层
+ * @param painter 视口上的绘制器
+ * @details 只列出已有记录的阶段，时间单位为毫秒；命中率在有访问时显示
+ */
+void PathologyViewer::drawStatisticsOverlay(QPainter& painter)
+{
+    auto hitRate = [](PipelineProfiler::Counter hit, PipelineProfiler::Counter miss) {
+        const unsigned long long hits = PipelineProfiler::counter(hit);
+        const unsigned long long total = hits + PipelineProfiler::counter(miss);
+        return total == 0 ? QStringLiteral("-") : QString::number(100. * hits / total, 'f', 1) + QLatin1Char('%');
+    };
+
+    QStringList lines;
+    lines << QStringLiteral("FPS %1   IO queue %2 (max %3)").arg(m_currentFPS)
+        .arg(PipelineProfiler::gauge(PipelineProfiler::IOQueueDepth))
+        .arg(PipelineProfiler::gaugeMax(PipelineProfiler::IOQueueDepth));
+    lines << QStringLiteral("%1 %2 %3 %4 %5").arg(QStringLiteral("stage (ms)"), -28).arg(QStringLiteral("calls"), 8)
+        .arg(QStringLiteral("p50"), 8).arg(QStringLiteral("p99"), 8).arg(QStringLiteral("max"), 8);
+    for (int i = 0; i < PipelineProfiler::NumberOfStages; ++i) {
+        const PipelineProfiler::Stage stage = static_cast<PipelineProfiler::Stage>(i);
+        const PipelineProfiler::StageSummary summary = PipelineProfiler::summarize(stage);
+        if (summary.calls == 0) {
+            continue;
+        }
+        lines << QStringLiteral("%1 %2 %3 %4 %5").arg(QString::fromLatin1(PipelineProfiler::stageName(stage)), -28)
+            .arg(summary.calls, 8).arg(summary.p50, 8, 'f', 2).arg(summary.p99, 8, 'f', 2).arg(summary.max, 8, 'f', 2);
+    }
+    lines << QStringLiteral("decoded cache %1  evicted %2").arg(hitRate(PipelineProfiler::DecodedCacheHit, PipelineProfiler::DecodedCacheMiss))
+        .arg(PipelineProfiler::counter(PipelineProfiler::DecodedCacheEviction));
+    lines << QStringLiteral("compressed cache %1  disk cache %2").arg(hitRate(PipelineProfiler::CompressedCacheHit, PipelineProfiler::CompressedCacheMiss))
+        .arg(hitRate(PipelineProfiler::DiskCacheHit, PipelineProfiler::DiskCacheMiss));
+    lines << QStringLiteral("tile item cache %1  evicted %2").arg(hitRate(PipelineProfiler::TileItemCacheHit, PipelineProfiler::TileItemCacheMiss))
+        .arg(PipelineProfiler::counter(PipelineProfiler::TileItemCacheEviction));
+
+    QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+    font.setPointSize(9);
+    painter.setFont(font);
+    const QFontMetrics metrics(font);
+    int width = 0;
+    for (const QString& line : lines) {
+        width = std::max(width, metrics.horizontalAdvance(line));
+    }
+    const int margin = 6;
+    const QRect panel(margin, margin, width + 2 * margin, lines.size() * metrics.lineSpacing() + 2 * margin);
+    painter.fillRect(panel, QColor(0, 0, 0, 170));
+    painter.setPen(Qt::white);
+    int y = panel.top() + margin + metrics.ascent();
+    for (const QString& line : lines) {
+        painter.drawText(panel.left() + margin, y, line);
+        y += metrics.lineSpacing();
+    }
+}
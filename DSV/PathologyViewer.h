@@ -30,6 +30,7 @@
 #include <QDebug>
 #include <QElapsedTimer>
 #include <QList>
+#include "TiledTiffWriter.h"
 
  // 前向声明
 class MultiResolutionImage;
@@ -50,6 +51,13 @@ class QListWidget;
 class QListWidgetItem;
 class ItemDialog;
 class QImageGraphicScene;
+class AnnotationLayerItem;
+class AnnotationStoreReader;
+class RegionAnalysis;
+class RegionExport;
+class SlideStatisticsBuilder;
+class ViewSnapshotService;
+class ViewAnimationDriver;
 class QMenu;
 
 /**
@@ -70,6 +78,8 @@ enum MouseType {
 
 namespace SlideColorManagement {
     struct LUT; // 前向声明LUT结构体
+    struct ChannelDisplay; // 前向声明通道显示设置结构体
+    struct PropertyInfo; // 前向声明属性信息结构体
 }
 
 /**
@@ -144,7 +154,7 @@ public:
 
     /**
      * @brief   初始化查看器
-     * @details 使用多分辨率图像初始化查看器
+     * @details 使用多分辨率图像初始化查看器，切片有上次关闭时保存的快照时恢复到上次的视场
      *
      * @param   img 多分辨率图像对象的共享指针
      * @note    该函数会设置图像、初始化瓦片管理器等组件
@@ -154,7 +164,7 @@ public:
 
     /**
      * @brief   关闭查看器
-     * @details 关闭当前图像并清理相关资源
+     * @details 保存查看器状态快照后关闭当前图像并清理相关资源
      * @note    该函数会停止所有线程并清理图像资源
      * @see     initialize
      */
@@ -240,6 +250,56 @@ public:
      */
     void setForegroundChannel(unsigned int channel);
 
+    /**
+     * @brief   以点检测结果的密度热图作为前景
+     * @details 读取点文件，按当前切片的层级建立PointDensityImage，使用"Heatmap"查找表显示；
+     *          热图瓦片在IO工作线程中按需栅格化，透明度仍由setForegroundOpacity控制
+     *
+     * @param   pointsPath 点文件路径，每行为第0层像素坐标x、y和可选的权重
+     * @param   kernelDensity true时为高斯核密度估计，false时为格子计数
+     * @return  没有打开切片或点文件无效时返回false，原有前景保持不变
+     * @see     PointDensityImage, onForegroundImageChanged
+     */
+    bool setPointDensityOverlay(const QString& pointsPath, bool kernelDensity = true);
+
+    /**
+     * @brief   设置荧光多通道合成
+     * @details 按各通道的颜色、窗口和伽马加性合成单色和多通道背景图像，
+     *          已显示的瓦片从解码瓦片缓存中的原始数据就地重新合成，不清空场景
+     *
+     * @param   channels 各通道的显示设置，第i项对应第i个通道；为空时恢复单通道灰度显示
+     * @note    切换通道可见性只需修改对应项的visible后再次调用
+     * @see     IOThread::setChannelComposite, TileManager::updateTileBackgrounds
+     */
+    void setChannelComposite(const std::vector<SlideColorManagement::ChannelDisplay>& channels);
+
+    /**
+     * @brief   按切片统计自动设置通道窗口
+     * @details 各通道的窗口设为切片统计中最精细完整层级的百分位数，然后调用setChannelComposite；
+     *          只使用已统计的低分辨率层级，不读取第0层
+     *
+     * @param   channels 各通道的显示设置，窗口被更新，其余设置保持不变
+     * @param   lowPercentile 窗口下限的百分位
+     * @param   highPercentile 窗口上限的百分位
+     * @return  没有切片统计或统计尚无完整层级时返回false，channels不变
+     * @see     SlideStatistics::getAutoWindow
+     */
+    bool autoContrastChannels(std::vector<SlideColorManagement::ChannelDisplay>& channels, double lowPercentile = 0.1, double highPercentile = 99.9);
+
+    /**
+     * @brief   设置背景瓦片增强
+     * @details 反锐化掩模和亮度/对比度/伽马在工作线程中作为背景瓦片的后处理执行，
+     *          已显示的瓦片只从内存缓存中的原始数据重新处理，不重新读取切片；
+     *          原始数据已被淘汰的瓦片保留当前显示，下次加载时按新参数处理
+     *
+     * @param   sharpness 反锐化掩模强度，-1到2，0为不锐化，负值为平滑
+     * @param   gamma 伽马指数，1为不变
+     * @param   brightness 亮度偏移，0为不变
+     * @param   contrast 对比度，1为不变
+     * @see     IOThread::setEnhancement, TileManager::updateTileBackgrounds
+     */
+    void setEnhancement(float sharpness, float gamma = 1.f, float brightness = 0.f, float contrast = 1.f);
+
     /**
      * @brief   设置前景渲染开关
      * @details 启用或禁用前景图像的渲染
@@ -249,6 +309,55 @@ public:
      */
     void setEnableForegroundRendering(bool enableForegroundRendering);
 
+    /**
+     * @brief   设置显示的Z平面（焦平面）
+     * @details 已显示的瓦片保留到新平面的背景到达，相邻平面已由PrefetchThread预取时直接命中解码瓦片缓存。
+     *          键盘PageUp/PageDown逐层切换
+     *
+     * @param   zPlane Z平面索引，超出范围时取最近的有效平面
+     * @see     MultiResolutionImage::getNumberOfZPlanes, IOThread::setZPlane
+     */
+    void setZPlane(int zPlane);
+
+    /**
+     * @brief   获取显示的Z平面
+     * @return  Z平面索引，未加载图像时为0
+     */
+    int getZPlane() const;
+
+    /**
+     * @brief   显示或隐藏性能统计浮层
+     * @details 浮层列出FPS、IO队列深度、各阶段耗时分位数和缓存命中率，每kStatisticsOverlayInterval刷新一次。
+     *          显示时打开PipelineProfiler，隐藏时关闭
+     *
+     * @param   visible 是否显示
+     * @see     PipelineProfiler
+     */
+    void setStatisticsOverlayVisible(bool visible);
+
+    /**
+     * @brief   性能统计浮层是否显示
+     */
+    bool isStatisticsOverlayVisible() const;
+
+    /**
+     * @brief   切换OpenGL视口
+     * @details 启用时以QOpenGLWidget作为视口并开启垂直同步，瓦片像素图由Qt的OpenGL绘制引擎
+     *          上传为纹理并缓存，缩放和平移时的重绘由GPU完成；禁用时恢复光栅视口
+     *
+     * @param   enable 是否使用OpenGL视口，构造时默认启用
+     * @note    替换视口会重建视口控件，一般只在启动时或驱动不兼容时切换
+     * @see     isOpenGLViewport
+     */
+    void setOpenGLViewport(bool enable);
+
+    /**
+     * @brief   是否使用OpenGL视口
+     * @return  true表示当前视口为QOpenGLWidget
+     * @see     setOpenGLViewport
+     */
+    bool isOpenGLViewport() const;
+
     /**
      * @brief   切换平移模式
      * @details 启用或禁用平移模式
@@ -312,11 +421,127 @@ public:
      * @details 设置瓦片缓存的最大大小
      *
      * @param   maxCacheSize 最大缓存大小（字节）
-     * @note    缓存大小设置会影响内存使用和性能
-     * @see     getCacheSize
+     * @note    该值是期望上限，实际上限由MemoryGovernor按全局预算分配
+     * @see     getCacheSize, MemoryGovernor
      */
     void setCacheSize(unsigned long long& maxCacheSize);
 
+    /**
+     * @brief   获取IO工作线程数量配置
+     * @return  配置的线程数量，0表示按CPU核数自动确定
+     * @see     setIOThreadCount
+     */
+    unsigned int getIOThreadCount() { return _ioThreadCount; }
+
+    /**
+     * @brief   获取首选瓦片大小
+     * @return  首选瓦片边长（像素），实际使用的瓦片大小按原生瓦片网格对齐
+     * @see     SlideLoader::getOverviewLevel, TileManager::alignedTileSize
+     */
+    unsigned int getTileSize() const { return _tileSize; }
+
+    /**
+     * @brief   是否已加载切片
+     * @return  initialize之后、close之前返回true
+     */
+    bool hasImage() const { return _img != nullptr; }
+
+    /**
+     * @brief   获取第0层的像素间距
+     * @return  微米/像素，切片没有像素间距时返回0
+     */
+    double getMicronsPerPixel() const;
+
+    /**
+     * @brief   获取视图中心
+     * @return  视口中心对应的第0层像素坐标
+     * @see     setView
+     */
+    QPointF getViewCenter() const;
+
+    /**
+     * @brief   获取视图缩放
+     * @return  每个第0层像素对应的屏幕像素数，与视图旋转无关
+     * @see     setView
+     */
+    double getViewScale() const;
+
+    /**
+     * @brief   设置视图中心和缩放
+     * @details 保持当前旋转，更新后发出fieldOfViewChanged加载新视场的瓦片。
+     *          由ViewSynchronizer用来让多个视图同步平移和缩放
+     *
+     * @param   center 视口中心对应的第0层像素坐标
+     * @param   viewScale 每个第0层像素对应的屏幕像素数
+     * @see     getViewCenter, getViewScale, ViewSynchronizer
+     */
+    void setView(const QPointF& center, double viewScale);
+
+    /**
+     * @brief   获取标注图层
+     * @details 首次调用时创建并加入场景，关闭图像时随场景一起删除
+     * @return  标注图层，用于显示大批量的分割或检测结果
+     * @see     AnnotationLayerItem
+     */
+    AnnotationLayerItem* getAnnotationLayer();
+
+    /**
+     * @brief   打开标注存储
+     * @details 只读取索引，视场变化时创建与视场相交的数据块中的标注，已创建的数据块不再读取
+     *
+     * @param   path 标注存储文件路径
+     * @return  文件无效时返回false
+     * @see     AnnotationStoreReader, saveAnnotations
+     */
+    bool loadAnnotations(const QString& path);
+
+    /**
+     * @brief   保存标注存储
+     * @details 保存场景中的渲染元素，以及已打开的标注存储中尚未创建的数据块
+     *
+     * @param   path 输出文件路径，不能与已打开的标注存储相同
+     * @return  成功时返回true
+     * @see     AnnotationStoreWriter, loadAnnotations
+     */
+    bool saveAnnotations(const QString& path);
+
+    /**
+     * @brief   在后台分析标注区域
+     * @details 在IO线程池中按瓦片统计区域内的直方图、平均强度和组织比例，
+     *          结果通过RegionAnalysis的进度信号逐步更新，不阻塞GUI线程
+     *
+     * @param   scenePolygon 分析区域（场景坐标），例如轮廓的mapToScene(polygon())
+     * @param   level 读取的层级，-1表示当前显示所用的层级
+     * @return  区域分析对象，未加载图像时返回空指针
+     * @see     RegionAnalysis, IOThread::addTileTask
+     */
+    std::shared_ptr<RegionAnalysis> analyzeRegion(const QPolygonF& scenePolygon, int level = -1);
+
+    /**
+     * @brief   在后台把区域导出为金字塔BigTIFF
+     * @details 在IO线程池中按所选层级的原生分辨率逐瓦片渲染背景、前景叠加和标注并写入文件，
+     *          不受屏幕分辨率限制，也不在内存中保留整幅图像
+     *
+     * @param   sceneRect 导出区域（场景坐标）
+     * @param   level 读取的层级，0为最高分辨率
+     * @param   path 输出文件路径
+     * @param   includeAnnotations 是否叠加标注（场景中的渲染元素、标注图层和标注存储）
+     * @param   compression 瓦片压缩方式
+     * @return  区域导出对象，未加载图像或无法创建文件时返回空指针
+     * @see     RegionExport, IOThread::addTileTask
+     */
+    std::shared_ptr<RegionExport> exportRegion(const QRectF& sceneRect, unsigned int level, const QString& path,
+        bool includeAnnotations = true, TiledTiffWriter::Compression compression = TiledTiffWriter::JPEG);
+
+    /**
+     * @brief   设置IO工作线程数量
+     * @details 保存配置，已加载图像时立即调整线程数。工作线程由所有视图共享，修改对所有视图生效
+     *
+     * @param   nrThreads 线程数量，0表示按CPU核数自动确定
+     * @see     getIOThreadCount, IOThread::setNumberOfThreads
+     */
+    void setIOThreadCount(unsigned int nrThreads);
+
     /**
      * @brief   更新当前视场
      * @details 更新当前显示的视场信息
@@ -327,57 +552,41 @@ public:
     /**
      * @brief   重置视图
      * @details 将视图重置到初始状态
-     * @note    该函数会重置缩放、平移等视图变换
-     * @see     resetTime, resetFinished
+     * @note    该函数会重置缩放、平移等视图变换，动画由ViewAnimationDriver按帧推进
+     * @see     resetTime
      */
     void reset();
 
     /**
      * @brief   重置动画时间
-     * @details 重置视图的动画时间参数
+     * @details 把视图变换和中心向初始状态移动剩余距离的x倍
      *
-     * @param   x 时间参数
-     * @note    该函数用于重置动画的进度
-     * @see     reset, resetFinished
+     * @param   x 本帧移动的剩余距离比例，动画最后一帧为1
+     * @note    视场由同一帧的onAnimationFrame更新
+     * @see     reset
      */
     void resetTime(qreal x);
 
-    /**
-     * @brief   重置完成
-     * @details 重置操作完成后的处理
-     * @note    该函数在重置动画完成后调用
-     * @see     reset, resetTime
-     */
-    void resetFinished();
-
     /**
      * @brief   缩放到固定倍率
      * @details 将视图缩放到指定的固定倍率
      *
      * @param   targetMagnification 目标倍率
-     * @note    该函数会执行平滑的缩放动画
-     * @see     zoomToFixedScaleTime, zoomToFixedScaleFinished
+     * @note    该函数会执行平滑的缩放动画，动画由ViewAnimationDriver按帧推进
+     * @see     zoomToFixedScaleTime
      */
     void zoomToFixedMagnification(float targetMagnification);
 
     /**
      * @brief   固定缩放动画时间
-     * @details 固定缩放动画的时间参数
+     * @details 把视图变换和中心向目标移动剩余距离的x倍
      *
-     * @param   x 时间参数
-     * @note    该函数用于控制缩放动画的进度
-     * @see     zoomToFixedMagnification, zoomToFixedScaleFinished
+     * @param   x 本帧移动的剩余距离比例，动画最后一帧为1
+     * @note    视场由同一帧的onAnimationFrame更新
+     * @see     zoomToFixedMagnification
      */
     void zoomToFixedScaleTime(qreal x);
 
-    /**
-     * @brief   固定缩放完成
-     * @details 固定缩放操作完成后的处理
-     * @note    该函数在固定缩放动画完成后调用
-     * @see     zoomToFixedMagnification, zoomToFixedScaleTime
-     */
-    void zoomToFixedScaleFinished();
-
     /**
      * @brief   设置绘制状态
      * @details 启用或禁用绘制模式
@@ -523,7 +732,8 @@ public slots:
 
     /**
      * @brief   视场改变槽函数
-     * @details 当视场改变时调用此槽函数
+     * @details 当视场改变时调用此槽函数。视图旋转时按实际视口多边形加载瓦片，
+     *          预取仍使用外接矩形
      *
      * @param   FOV 新的视场矩形
      * @param   level 当前层级
@@ -541,6 +751,28 @@ public slots:
      */
     void onForegroundImageChanged(std::weak_ptr<MultiResolutionImage> for_img, float scale);
 
+    /**
+     * @brief   缩略图就绪槽函数
+     * @details 用异步读取的缩略图替换小地图的占位图，缩略图经过与背景瓦片相同的后处理后
+     *          作为瓦片图层的最底层，最后渲染层级的瓦片随后不再固定在缓存中
+     *
+     * @param   overview 缩略图层级的完整图像
+     * @note    应在initialize之后调用，小地图尚未创建时忽略
+     * @see     SlideLoader::overviewLoaded
+     */
+    void setOverview(const QImage& overview);
+
+    /**
+     * @brief   关联数据就绪槽函数
+     * @details 显示异步读取的标签图像，并以属性创建详情对话框
+     *
+     * @param   label 标签图像，可为空
+     * @param   properties 图像属性
+     * @note    应在initialize之后调用；在此之前打开详情对话框时同步读取属性
+     * @see     SlideLoader::associatedDataLoaded
+     */
+    void setAssociatedData(const QImage& label, const std::vector<SlideColorManagement::PropertyInfo>& properties);
+
     /**
      * @brief   设置文件窗口状态
      * @details 设置文件窗口的显示状态
@@ -665,14 +897,27 @@ private:
      */
     virtual void resizeEvent(QResizeEvent* event);
 
+    /**
+     * @brief   重新生成瓦片图层最底层的缩略图
+     * @details 按IO线程当前的设置快照对缩略图做ICC转换和增强，与背景瓦片颜色一致后交给瓦片管理器
+     * @note    没有缩略图或尚未打开切片时忽略
+     * @see     IOWorker::postProcessTile, TileManager::setOverview
+     */
+    void updateOverviewBase();
+
     /**
      * @brief   键盘按下事件处理
-     * @details 处理键盘按下事件，忽略方向键
+     * @details 处理键盘按下事件，忽略方向键，PageUp/PageDown切换Z平面
      *
      * @param   event 键盘事件对象
      * @note    该函数会忽略方向键事件，其他按键按默认方式处理
      */
     void keyPressEvent(QKeyEvent* event) override {
+        if (event->key() == Qt::Key_PageUp || event->key() == Qt::Key_PageDown) {
+            setZPlane(getZPlane() + (event->key() == Qt::Key_PageUp ? 1 : -1));
+            event->accept();
+            return;
+        }
         // 检查按键是否为方向键
         if (event->key() == Qt::Key_Left ||
             event->key() == Qt::Key_Right ||
@@ -707,10 +952,10 @@ private:
     // 小地图相关函数
     /**
      * @brief   初始化GUI组件
-     * @details 根据层级初始化GUI组件
+     * @details 根据层级初始化GUI组件，小地图先以占位图显示，缩略图由setOverview异步替换
      *
      * @param   level 层级索引
-     * @note    该函数会初始化小地图等GUI组件
+     * @note    该函数会初始化小地图等GUI组件，不在GUI线程读取图像数据
      */
     void initializeGUIComponents(unsigned int level);
 
@@ -739,12 +984,18 @@ private:
     /** @brief 前景图像的弱引用 */
     std::weak_ptr<MultiResolutionImage> _for_img;
 
+    /** @brief 由setPointDensityOverlay创建的点密度前景，视图持有其所有权 */
+    std::shared_ptr<MultiResolutionImage> _pointOverlay;
+
     /** @brief 小地图组件指针 */
     MiniMap* _map;
 
     /** @brief 比例尺组件指针 */
     ScaleBar* _scaleBar;
 
+    /** @brief 截图窗口使用的离屏快照服务 */
+    ViewSnapshotService* _snapshotService;
+
     // 平移和缩放跟踪成员
     /** @brief 缩放灵敏度 */
     float _zoomSensitivity;
@@ -752,6 +1003,24 @@ private:
     /** @brief 计划缩放次数 */
     float _numScheduledScalings;
 
+    /** @brief 正在运行的缩放动画数，连续滚动滚轮时多个动画同时运行 */
+    int _activeZoomAnimations = 0;
+
+    /** @brief 缩放动画开始前的渲染层级，动画期间只请求不比它更精细的层级 */
+    unsigned int _zoomStartLevel = 0;
+
+    /** @brief 按屏幕刷新推进缩放和复位动画的驱动，同一帧的多个动画合并为一次视场更新 */
+    ViewAnimationDriver* _animationDriver;
+
+    /** @brief 本帧各缩放动画累乘的缩放因子，由onAnimationFrame应用 */
+    qreal _frameZoomFactor = 1.;
+
+    /** @brief 原QTimeLine缩放动画的更新间隔（毫秒），缩放速度按它换算 */
+    static const int kLegacyZoomInterval = 5;
+
+    /** @brief 原QTimeLine复位和固定倍率动画的更新间隔（毫秒） */
+    static const int kLegacyAnimationInterval = 10;
+
     /** @brief 平移灵敏度 */
     float _panSensitivity;
 
@@ -783,18 +1052,99 @@ private:
     /** @brief 是否渲染前景 */
     bool _renderForeground;
 
+    /** @brief 当前视口是否为QOpenGLWidget */
+    bool _openGLViewport;
+
     /** @brief 预取线程指针 */
     PrefetchThread* _prefetchthread;
 
     /** @brief 瓦片管理器指针 */
     TileManager* _manager;
 
-    /** @brief 缓存大小 */
+    /** @brief 缓存大小（期望上限） */
     unsigned long long _cacheSize;
 
+    /** @brief 瓦片像素图缓存在MemoryGovernor中的消费者标识，0表示未注册 */
+    int _pixmapBudgetId;
+
+    /** @brief 解码瓦片缓存在MemoryGovernor中的消费者标识，0表示未注册 */
+    int _decodedBudgetId;
+
+    /** @brief 前景瓦片缓存在MemoryGovernor中的消费者标识，0表示未注册 */
+    int _overlayBudgetId;
+
+    /** @brief IO工作线程数量配置，0表示按CPU核数自动确定 */
+    unsigned int _ioThreadCount;
+
+    /** @brief 背景瓦片增强参数（锐化、伽马、亮度、对比度），打开新切片时交给新的IO线程 */
+    float _enhancement[4];
+
+    /** @brief 未经后处理的缩略图，增强参数改变时据此重新生成瓦片图层的最底层 */
+    QImage _overview;
+
+    /** @brief 瓦片大小 */
+    unsigned int _tileSize;
+
     /** @brief 瓦片图形项缓存指针 */
     WSITileGraphicsItemCache* _cache;
 
+    /** @brief 标注图层指针，由场景拥有 */
+    AnnotationLayerItem* _annotationLayer;
+
+    /** @brief 已打开的标注存储 */
+    AnnotationStoreReader* _annotationStore;
+
+    /** @brief 标注存储中已创建图形项的数据块 */
+    std::vector<bool> _loadedAnnotationChunks;
+
+    /**
+     * @brief   创建与视场相交的已存储标注
+     * @param   FOV 视场（第0层坐标）
+     */
+    void instantiateStoredAnnotations(const QRectF& FOV);
+
+    /**
+     * @brief   保存查看器状态快照
+     * @details 关闭切片前调用，把视场、叠加层设置和视场内已加载的瓦片写入磁盘缓存旁的快照文件；
+     *          未使用磁盘缓存时不保存
+     * @see     ViewerSnapshot, restoreViewerSnapshot
+     */
+    void saveViewerSnapshot();
+
+    /**
+     * @brief   恢复查看器状态快照
+     * @details 打开切片时在第一次请求视场之前调用：恢复Z平面和叠加层设置，
+     *          先为快照中的瓦片排队任务（这些瓦片命中磁盘缓存），再移动到保存的视场
+     * @return  找到有效快照并已恢复视场时返回true
+     * @see     ViewerSnapshot, saveViewerSnapshot
+     */
+    bool restoreViewerSnapshot();
+
+    /**
+     * @brief   开始后台统计
+     * @details 图像还没有统计时先从磁盘缓存读取或新建（RGB图像除外），
+     *          再为尚未统计的低分辨率层级投放统计任务；范围层级变化时重新渲染背景或前景瓦片
+     * @param   img 背景或前景图像
+     * @param   foreground 是否为前景图像
+     * @return  统计任务，没有需要统计的单元时为空指针
+     * @see     SlideStatisticsBuilder
+     */
+    std::shared_ptr<SlideStatisticsBuilder> startStatistics(const std::shared_ptr<MultiResolutionImage>& img, bool foreground);
+
+    /**
+     * @brief   停止后台统计
+     * @details 取消任务并断开信号，图像的统计写入磁盘缓存旁的附属文件
+     * @param   builder 统计任务，调用后为空指针
+     * @param   img 统计所属的图像，可为空
+     */
+    void stopStatistics(std::shared_ptr<SlideStatisticsBuilder>& builder, const std::shared_ptr<MultiResolutionImage>& img);
+
+    /** @brief 背景图像的统计任务 */
+    std::shared_ptr<SlideStatisticsBuilder> _statisticsBuilder;
+
+    /** @brief 前景图像的统计任务 */
+    std::shared_ptr<SlideStatisticsBuilder> _foregroundStatisticsBuilder;
+
     // 初始状态
     /** @brief 初始变换矩阵 */
     QTransform _initialTransform;
@@ -816,7 +1166,7 @@ private:
     /** @brief 标签窗口指针 */
     LabelWin* _labelWin;
 
-    /** @brief 详情对话框指针 */
+    /** @brief 详情对话框指针，属性就绪或首次打开时创建 */
     DetailDialog* _detailDialog;
 
     /** @brief 绘制状态 */
@@ -855,7 +1205,7 @@ private:
 
     /**
      * @brief   绘制事件处理
-     * @details 处理绘制事件，实现自定义绘制
+     * @details 处理绘制事件，实现自定义绘制；统计打开时记录帧绘制耗时，并在左上角叠加性能统计浮层
      *
      * @param   event 绘制事件对象
      * @note    该函数用于实现自定义的绘制功能
@@ -869,6 +1219,29 @@ private:
      */
     void createContextMenu();
 
+    /**
+     * @brief   把原来按固定间隔逼近的动画进度换算为本帧的步长
+     * @param   x 缓动后的进度
+     * @param   frameTime 距上一帧的毫秒数
+     * @return  本帧移动的剩余距离比例，进度为1时返回1
+     */
+    static qreal legacyStepFraction(qreal x, qreal frameTime);
+
+    /**
+     * @brief   绘制性能统计浮层
+     * @param   painter 视口上的绘制器
+     */
+    void drawStatisticsOverlay(QPainter& painter);
+
+    /** @brief 是否显示性能统计浮层 */
+    bool _statisticsOverlayVisible = false;
+
+    /** @brief 性能统计浮层刷新定时器 */
+    QTimer _statisticsOverlayTimer{ this };
+
+    /** @brief 性能统计浮层刷新间隔（毫秒） */
+    static const int kStatisticsOverlayInterval = 500;
+
     /** @brief FPS定时器 */
     QTimer m_fpsTimer{ this };
 
@@ -889,20 +1262,37 @@ private:
 private slots:
     /**
      * @brief   缩放动画时间槽函数
-     * @details 处理缩放动画的时间参数
+     * @details 把本动画在这一帧的缩放因子乘入_frameZoomFactor
      *
-     * @param   x 时间参数
-     * @note    该槽函数用于控制缩放动画的进度
+     * @param   x 缓动后的进度
+     * @param   frameTime 距上一帧的毫秒数
+     * @note    该槽函数由ViewAnimationDriver每帧调用
      */
-    void scalingTime(qreal x);
+    void scalingTime(qreal x, qreal frameTime);
 
     /**
      * @brief   缩放完成槽函数
      * @details 缩放操作完成后的处理
-     * @note    该槽函数在缩放动画完成后调用
+     * @note    该槽函数在缩放动画完成后、同一帧的onAnimationFrame之前调用
      */
     void zoomFinished();
 
+    /**
+     * @brief   动画帧槽函数
+     * @details 应用本帧累乘的缩放因子，然后只更新一次视场、小地图和比例因子
+     * @see     ViewAnimationDriver::frameAdvanced
+     */
+    void onAnimationFrame();
+
+    /**
+     * @brief   视场更新槽函数
+     * @details 按当前变换计算视场并发出fieldOfViewChanged。缩放动画期间请求的层级
+     *          不比动画开始前更精细，中间帧只加载代价低的粗层级瓦片；
+     *          最后一个动画结束后的一帧按目标层级重新请求
+     * @see     onAnimationFrame
+     */
+    void updateFieldOfView();
+
     /**
      * @brief   点击选中操作
      * @details 细分选中Item的内容是什么
@@ -0,0 +1,512 @@
+﻿/**
+ * @file PipelineProfiler.cpp
+ * @brief 瓦片管线性能统计实现文件
+ * @details 该文件实现了按阶段记录耗时直方图、保存精确样本、计算分位数和导出JSON的功能
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "PipelineProfiler.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+    /**
+     * @brief 单个阶段的统计
+     * @details 直方图、调用次数、总和和最大值均为原子量，记录时不加锁；
+     *          精确样本只在打开采样时加锁追加
+     */
+    struct StageSamples {
+        std::atomic<unsigned long long> calls{ 0 };
+        std::atomic<unsigned long long> total{ 0 };
+        std::atomic<long long> max{ 0 };
+        std::atomic<unsigned long long> buckets[PipelineProfiler::kHistogramBuckets];
+        std::mutex mutex;
+        std::vector<long long> nanoseconds;
+    };
+
+    /** @brief 单个瞬时量 */
+    struct GaugeValue {
+        std::atomic<long long> value{ 0 };
+        std::atomic<long long> max{ 0 };
+    };
+
+    /** @brief 统计开关 */
+    std::atomic<bool> profilerEnabled(false);
+
+    /** @brief 精确采样开关 */
+    std::atomic<bool> samplingEnabled(false);
+
+    /** @brief 各阶段的统计 */
+    StageSamples stageSamples[PipelineProfiler::NumberOfStages];
+
+    /** @brief 各计数器 */
+    std::atomic<unsigned long long> counters[PipelineProfiler::NumberOfCounters];
+
+    /** @brief 各瞬时量 */
+    GaugeValue gauges[PipelineProfiler::NumberOfGauges];
+
+    /**
+     * @brief 全局单调时钟，首次使用时启动
+     */
+    const QElapsedTimer& monotonicClock() {
+        static QElapsedTimer timer = []() {
+            QElapsedTimer t;
+            t.start();
+            return t;
+        }();
+        return timer;
+    }
+
+    /**
+     * @brief 原子地把最大值更新为value
+     */
+    void updateMax(std::atomic<long long>& max, long long value) {
+        long long current = max.load(std::memory_order_relaxed);
+        while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    /**
+     * @brief 耗时所在的直方图桶
+     */
+    unsigned int bucketIndex(long long nanoseconds) {
+        unsigned int index = 0;
+        unsigned long long value = nanoseconds > 0 ? static_cast<unsigned long long>(nanoseconds) : 0;
+        while (value > 1 && index + 1 < PipelineProfiler::kHistogramBuckets) {
+            value >>= 1;
+            ++index;
+        }
+        return index;
+    }
+
+    /**
+     * @brief 取已排序样本的分位数（最近秩）
+     */
+    double percentile(const std::vector<long long>& sorted, double fraction) {
+        size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+        return sorted[std::min(index, sorted.size() - 1)] / 1e6;
+    }
+
+    /**
+     * @brief 由直方图估计分位数
+     * @details 找到累计计数达到目标的桶，在桶的上下界之间线性插值，结果不超过最大值
+     */
+    double histogramPercentile(const unsigned long long* buckets, unsigned long long calls, double fraction, long long max) {
+        const double target = fraction * calls;
+        unsigned long long cumulative = 0;
+        for (unsigned int i = 0; i < PipelineProfiler::kHistogramBuckets; ++i) {
+            if (buckets[i] == 0) {
+                continue;
+            }
+            if (cumulative + buckets[i] >= target) {
+                const double lower = i == 0 ? 0. : static_cast<double>(1ull << i);
+                const double upper = static_cast<double>(1ull << (i + 1));
+                const double position = (target - cumulative) / buckets[i];
+                return std::min(lower + (upper - lower) * position, static_cast<double>(max)) / 1e6;
+            }
+            cumulative += buckets[i];
+        }
+        return max / 1e6;
+    }
+}
+
+/**
+ * @brief 打开或关闭统计
+ * @param enabled 是否记录
+ */
+void PipelineProfiler::setEnabled(bool enabled)
+{
+    profilerEnabled = enabled;
+}
+
+/**
+ * @brief 统计是否打开
+ * @return 打开时返回true
+ */
+bool PipelineProfiler::isEnabled()
+{
+    return profilerEnabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief 打开或关闭精确采样
+ * @param enabled 是否保留样本
+ */
+void PipelineProfiler::setSampling(bool enabled)
+{
+    samplingEnabled = enabled;
+}
+
+/**
+ * @brief 获取单调时间戳
+ * @return 纳秒时间戳，统计关闭时返回0
+ * @details 时间戳从1开始，0保留表示“未记录”
+ */
+long long PipelineProfiler::timestamp()
+{
+    return isEnabled() ? monotonicClock().nsecsElapsed() + 1 : 0;
+}
+
+/**
+ * @brief 记录一个样本
+ * @param stage 阶段
+ * @param nanoseconds 耗时（纳秒）
+ */
+void PipelineProfiler::record(Stage stage, long long nanoseconds)
+{
+    if (stage >= NumberOfStages) {
+        return;
+    }
+    nanoseconds = std::max(nanoseconds, 0LL);
+    StageSamples& samples = stageSamples[stage];
+    samples.calls.fetch_add(1, std::memory_order_relaxed);
+    samples.total.fetch_add(static_cast<unsigned long long>(nanoseconds), std::memory_order_relaxed);
+    samples.buckets[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    updateMax(samples.max, nanoseconds);
+    if (samplingEnabled.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> l(samples.mutex);
+        if (samples.nanoseconds.size() < kMaxSamples) {
+            samples.nanoseconds.push_back(nanoseconds);
+        }
+    }
+}
+
+/**
+ * @brief 计数器增加
+ * @param counter 计数器
+ * @param amount 增量
+ */
+void PipelineProfiler::count(Counter counter, unsigned long long amount)
+{
+    if (counter < NumberOfCounters && isEnabled()) {
+        counters[counter].fetch_add(amount, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief 获取计数器的值
+ * @param counter 计数器
+ * @return 计数
+ */
+unsigned long long PipelineProfiler::counter(Counter counter)
+{
+    return counter < NumberOfCounters ? counters[counter].load() : 0;
+}
+
+/**
+ * @brief 设置瞬时量的当前值
+ * @param gauge 瞬时量
+ * @param value 当前值
+ */
+void PipelineProfiler::setGauge(Gauge gauge, long long value)
+{
+    if (gauge < NumberOfGauges && isEnabled()) {
+        gauges[gauge].value.store(value, std::memory_order_relaxed);
+        updateMax(gauges[gauge].max, value);
+    }
+}
+
+/**
+ * @brief 获取瞬时量的当前值
+ * @param gauge 瞬时量
+ * @return 当前值
+ */
+long long PipelineProfiler::gauge(Gauge gauge)
+{
+    return gauge < NumberOfGauges ? gauges[gauge].value.load() : 0;
+}
+
+/**
+ * @brief 获取瞬时量的最大值
+ * @param gauge 瞬时量
+ * @return 最大值
+ */
+long long PipelineProfiler::gaugeMax(Gauge gauge)
+{
+    return gauge < NumberOfGauges ? gauges[gauge].max.load() : 0;
+}
+
+/**
+ * @brief 统计阶段耗时
+ * @param stage 阶段
+ * @return 统计结果（毫秒）
+ * @details 有精确样本时复制样本后排序，不阻塞并发记录太久；否则只读取原子直方图
+ */
+PipelineProfiler::StageSummary PipelineProfiler::summarize(Stage stage)
+{
+    StageSummary summary;
+    if (stage >= NumberOfStages) {
+        return summary;
+    }
+    StageSamples& samples = stageSamples[stage];
+    std::vector<long long> sorted;
+    {
+        std::lock_guard<std::mutex> l(samples.mutex);
+        sorted = samples.nanoseconds;
+    }
+    summary.calls = samples.calls.load();
+    if (!sorted.empty()) {
+        std::sort(sorted.begin(), sorted.end());
+        long double total = 0;
+        for (long long value : sorted) {
+            total += value;
+        }
+        summary.samples = sorted.size();
+        summary.mean = static_cast<double>(total / sorted.size()) / 1e6;
+        summary.p50 = percentile(sorted, 0.50);
+        summary.p99 = percentile(sorted, 0.99);
+        summary.max = sorted.back() / 1e6;
+        return summary;
+    }
+    if (summary.calls == 0) {
+        return summary;
+    }
+    unsigned long long buckets[kHistogramBuckets];
+    unsigned long long histogramCalls = 0;
+    for (unsigned int i = 0; i < kHistogramBuckets; ++i) {
+        buckets[i] = samples.buckets[i].load(std::memory_order_relaxed);
+        histogramCalls += buckets[i];
+    }
+    if (histogramCalls == 0) {
+        return summary;
+    }
+    const long long max = samples.max.load();
+    summary.mean = static_cast<double>(samples.total.load()) / summary.calls / 1e6;
+    summary.p50 = histogramPercentile(buckets, histogramCalls, 0.50, max);
+    summary.p99 = histogramPercentile(buckets, histogramCalls, 0.99, max);
+    summary.max = max / 1e6;
+    return summary;
+}
+
+/**
+ * @brief 获取阶段名称
+ * @param stage 阶段
+ * @return 名称字符串
+ */
+const char* PipelineProfiler::stageName(Stage stage)
+{
+    switch (stage) {
+    case ReadDataFromImage:
+        return "readDataFromImage";
+    case GetRawRegion:
+        return "getRawRegion";
+    case RenderBackgroundImage:
+        return "renderBackgroundImage";
+    case ConvertMonochromeToRGB:
+        return "convertMonochromeToRGB";
+    case PaintTile:
+        return "WSITileGraphicsItem::paint";
+    case FieldOfViewUpdate:
+        return "fieldOfViewUpdate";
+    case JobQueueWait:
+        return "jobQueueWait";
+    case JobExecute:
+        return "jobExecute";
+    case JobReadStage:
+        return "jobStage.read";
+    case JobConvertStage:
+        return "jobStage.convert";
+    case JobOverlayStage:
+        return "jobStage.overlay";
+    case JobDeliverStage:
+        return "jobStage.deliver";
+    case ReadOpenSlide:
+        return "read.openslide";
+    case ReadTiledTiff:
+        return "read.tiledtiff";
+    case ReadDicomWSI:
+        return "read.dicom";
+    case ReadDeepZoom:
+        return "read.deepzoom";
+    case ReadPointDensity:
+        return "read.points";
+    case ReadLabelMask:
+        return "read.labelmask";
+    case FramePaint:
+        return "framePaint";
+    case FirstView:
+        return "firstView";
+    case ZoomInteraction:
+        return "zoomInteraction";
+    case PanInteraction:
+        return "panInteraction";
+    case EnhanceTile:
+        return "enhanceTile";
+    case ColorTransformTile:
+        return "colorTransformTile";
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * @brief 获取计数器名称
+ * @param counter 计数器
+ * @return 名称字符串
+ */
+const char* PipelineProfiler::counterName(Counter counter)
+{
+    switch (counter) {
+    case DecodedCacheHit:
+        return "decodedCacheHit";
+    case DecodedCacheMiss:
+        return "decodedCacheMiss";
+    case DiskCacheHit:
+        return "diskCacheHit";
+    case DiskCacheMiss:
+        return "diskCacheMiss";
+    case CompressedCacheHit:
+        return "compressedCacheHit";
+    case CompressedCacheMiss:
+        return "compressedCacheMiss";
+    case BufferPoolHit:
+        return "bufferPoolHit";
+    case BufferPoolMiss:
+        return "bufferPoolMiss";
+    case BackgroundTileSynthesized:
+        return "backgroundTileSynthesized";
+    case SolidTile:
+        return "solidTile";
+    case DecodedCacheEviction:
+        return "decodedCacheEviction";
+    case TileItemCacheHit:
+        return "tileItemCacheHit";
+    case TileItemCacheMiss:
+        return "tileItemCacheMiss";
+    case TileItemCacheEviction:
+        return "tileItemCacheEviction";
+    case VirtualLevelTileSynthesized:
+        return "virtualLevelTileSynthesized";
+    case AsyncFileRead:
+        return "asyncFileRead";
+    case JobCancelled:
+        return "jobCancelled";
+    case BatchedRegionRead:
+        return "batchedRegionRead";
+    case BatchedTileRead:
+        return "batchedTileRead";
+    case ResidentTileMiss:
+        return "residentTileMiss";
+    case BadRegionSkipped:
+        return "badRegionSkipped";
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * @brief 获取瞬时量名称
+ * @param gauge 瞬时量
+ * @return 名称字符串
+ */
+const char* PipelineProfiler::gaugeName(Gauge gauge)
+{
+    switch (gauge) {
+    case IOQueueDepth:
+        return "ioQueueDepth";
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * @brief 导出所有统计
+ * @return JSON文档
+ * @details 时间单位为毫秒，直方图以纳秒为单位给出桶下界和计数，省略空桶
+ */
+QByteArray PipelineProfiler::toJson()
+{
+    QJsonObject stages;
+    for (int i = 0; i < NumberOfStages; ++i) {
+        const Stage stage = static_cast<Stage>(i);
+        const StageSummary summary = summarize(stage);
+        if (summary.calls == 0) {
+            continue;
+        }
+        QJsonArray histogram;
+        for (unsigned int b = 0; b < kHistogramBuckets; ++b) {
+            const unsigned long long count = stageSamples[i].buckets[b].load(std::memory_order_relaxed);
+            if (count > 0) {
+                histogram.append(QJsonArray{ static_cast<double>(b == 0 ? 0ull : 1ull << b), static_cast<double>(count) });
+            }
+        }
+        QJsonObject object;
+        object["calls"] = static_cast<double>(summary.calls);
+        object["samples"] = static_cast<double>(summary.samples);
+        object["mean"] = summary.mean;
+        object["p50"] = summary.p50;
+        object["p99"] = summary.p99;
+        object["max"] = summary.max;
+        object["histogram"] = histogram;
+        stages[QString::fromLatin1(stageName(stage))] = object;
+    }
+    QJsonObject counterValues;
+    for (int i = 0; i < NumberOfCounters; ++i) {
+        const Counter c = static_cast<Counter>(i);
+        counterValues[QString::fromLatin1(counterName(c))] = static_cast<double>(counter(c));
+    }
+    QJsonObject gaugeValues;
+    for (int i = 0; i < NumberOfGauges; ++i) {
+        const Gauge g = static_cast<Gauge>(i);
+        QJsonObject object;
+        object["value"] = static_cast<double>(gauge(g));
+        object["max"] = static_cast<double>(gaugeMax(g));
+        gaugeValues[QString::fromLatin1(gaugeName(g))] = object;
+    }
+    QJsonObject root;
+    root["enabled"] = isEnabled();
+    root["stages"] = stages;
+    root["counters"] = counterValues;
+    root["gauges"] = gaugeValues;
+    return QJsonDocument(root).toJson(QJsonDocument::Indented);
+}
+
+/**
+ * @brief 把统计写入文件
+ * @param fileName 文件路径
+ * @return 写入成功返回true
+ */
+bool PipelineProfiler::exportJson(const QString& fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    const QByteArray json = toJson();
+    return file.write(json) == json.size();
+}
+
+/**
+ * @brief 清空所有样本、直方图、计数器和瞬时量
+ */
+void PipelineProfiler::reset()
+{
+    for (auto& samples : stageSamples) {
+        {
+            std::lock_guard<std::mutex> l(samples.mutex);
+            samples.nanoseconds.clear();
+        }
+        samples.calls = 0;
+        samples.total = 0;
+        samples.max = 0;
+        for (auto& bucket : samples.buckets) {
+            bucket = 0;
+        }
+    }
+    for (auto& value : counters) {
+        value = 0;
+    }
+    for (auto& value : gauges) {
+        value.value = 0;
+        value.max = 0;
+    }
+}
@@ -0,0 +1,261 @@
+﻿/**
+ * @file    PipelineProfiler.h
+ * @brief   瓦片管线性能统计类，记录各阶段耗时和缓存命中
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了瓦片管线（排队→读取→转换→渲染→绘制）的轻量级计时，包括：
+ *          - 按阶段记录调用耗时，以对数直方图统计平均值、p50和p99
+ *          - 解码瓦片缓存、瓦片图形项缓存、压缩瓦片缓存和磁盘缓存的命中/未命中/淘汰计数
+ *          - IO任务队列深度等瞬时量
+ *          - 全局开关，关闭时计时点只有一次原子读取的开销
+ *          - 导出为JSON，供查看器的统计浮层和离线分析使用
+ *
+ * @note    该类是线程安全的，IOWorker、PrefetchThread和GUI线程可以同时记录，记录路径不加锁
+ * @see     SlideBenchmark, PathologyViewer::setStatisticsOverlayVisible
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+
+/**
+ * @class  PipelineProfiler
+ * @brief  瓦片管线性能统计
+ * @details 所有接口均为静态函数。默认关闭，由SlideBenchmark在回放前或查看器显示统计浮层时打开。
+ *          每个阶段用kHistogramBuckets个按2的幂划分的原子桶记录耗时，分位数由直方图估计；
+ *          打开精确采样后另外保留最多kMaxSamples个样本（加锁），分位数按样本计算。
+ *
+ * @example
+ *          // 使用示例
+ *          void* OpenSlideImage::readDataFromImage(...) {
+ *              PipelineProfiler::ScopedTimer timer(PipelineProfiler::ReadDataFromImage);
+ *              ...
+ *          }
+ *          PipelineProfiler::StageSummary summary = PipelineProfiler::summarize(PipelineProfiler::ReadDataFromImage);
+ */
+class PipelineProfiler
+{
+public:
+    /**
+     * @brief 计时阶段
+     */
+    enum Stage {
+        ReadDataFromImage,      ///< 格式解码（所有后端的readDataFromImage）
+        GetRawRegion,           ///< 原始区域读取（含解码瓦片缓存和磁盘缓存）
+        RenderBackgroundImage,  ///< 背景瓦片渲染（读取和转换为QPixmap）
+        ConvertMonochromeToRGB, ///< 单色/多通道数据到ARGB32的转换
+        PaintTile,              ///< WSITileGraphicsItem::drawContent
+        FieldOfViewUpdate,      ///< 视场变化到瓦片全部加载并绘制完成
+        JobQueueWait,           ///< IO任务从入队到被工作线程取出
+        JobExecute,             ///< IO任务在工作线程中的执行
+        JobReadStage,           ///< IO任务的读取阶段（缓存查找或格式解码）
+        JobConvertStage,        ///< IO任务的颜色转换阶段
+        JobOverlayStage,        ///< IO任务的前景读取、查表和叠加阶段
+        JobDeliverStage,        ///< IO任务的投递阶段
+        ReadOpenSlide,          ///< OpenSlideImage的格式解码
+        ReadTiledTiff,          ///< TiledTiffImage的格式解码
+        ReadDicomWSI,           ///< DicomWSIImage的格式解码
+        ReadDeepZoom,           ///< DeepZoomImage的瓦片下载和解码
+        ReadPointDensity,       ///< PointDensityImage的点栅格化
+        ReadLabelMask,          ///< LabelMaskImage的游程解码
+        FramePaint,             ///< PathologyViewer绘制一帧
+        FirstView,              ///< 首次打开切片到显示缩略图层级
+        ZoomInteraction,        ///< 滚轮缩放到缩放动画结束
+        PanInteraction,         ///< 按下中键平移到松开
+        EnhanceTile,            ///< 背景瓦片的锐化和亮度/对比度/伽马增强
+        ColorTransformTile,     ///< 背景瓦片的ICC颜色配置文件转换
+        NumberOfStages
+    };
+
+    /**
+     * @brief 计数器
+     */
+    enum Counter {
+        DecodedCacheHit,        ///< 解码瓦片缓存命中
+        DecodedCacheMiss,       ///< 解码瓦片缓存未命中
+        DiskCacheHit,           ///< 磁盘缓存命中
+        DiskCacheMiss,          ///< 磁盘缓存未命中
+        CompressedCacheHit,     ///< 压缩瓦片缓存命中
+        CompressedCacheMiss,    ///< 压缩瓦片缓存未命中
+        BufferPoolHit,          ///< 瓦片缓冲区池复用
+        BufferPoolMiss,         ///< 瓦片缓冲区池向系统分配
+        BackgroundTileSynthesized, ///< 组织掩膜判定为背景、直接填充背景色的瓦片
+        SolidTile,              ///< 以1x1纯色像素图表示的瓦片
+        DecodedCacheEviction,   ///< 解码瓦片缓存淘汰
+        TileItemCacheHit,       ///< 瓦片图形项缓存命中
+        TileItemCacheMiss,      ///< 瓦片图形项缓存未命中（瓦片已被淘汰）
+        TileItemCacheEviction,  ///< 瓦片图形项缓存淘汰
+        VirtualLevelTileSynthesized, ///< 由上一个层级合成的虚拟层级区域
+        AsyncFileRead,          ///< 通过AsyncFileReader发出的读请求
+        JobCancelled,           ///< 执行中离开视野、在阶段之间放弃的IO任务
+        BatchedRegionRead,      ///< 合并相邻瓦片的区域读取
+        BatchedTileRead,        ///< 由合并区域读取得到的瓦片
+        ResidentTileMiss,       ///< 只处理驻留瓦片的背景重新合成中原始数据已不在内存缓存的瓦片
+        BadRegionSkipped,       ///< 负缓存中已知损坏、不再重试读取的区域
+        NumberOfCounters
+    };
+
+    /**
+     * @brief 瞬时量，保存当前值和统计打开以来的最大值
+     */
+    enum Gauge {
+        IOQueueDepth,           ///< 全局IO线程池中等待执行的任务数
+        NumberOfGauges
+    };
+
+    /**
+     * @brief 阶段统计结果，时间单位为毫秒
+     */
+    struct StageSummary {
+        unsigned long long calls = 0;   ///< 调用次数
+        unsigned long long samples = 0; ///< 参与统计的样本数
+        double mean = 0.;
+        double p50 = 0.;
+        double p99 = 0.;
+        double max = 0.;
+    };
+
+    /**
+     * @brief   作用域计时器
+     * @details 构造时开始计时，析构时把耗时记入阶段；统计关闭时不计时。
+     *          给出detail时同一耗时还记入该阶段，用于在汇总阶段之外区分各后端
+     */
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(Stage stage, Stage detail = NumberOfStages) : _stage(stage), _detail(detail), _active(PipelineProfiler::isEnabled()) {
+            if (_active) {
+                _timer.start();
+            }
+        }
+        ~ScopedTimer() {
+            if (_active) {
+                const long long nanoseconds = _timer.nsecsElapsed();
+                PipelineProfiler::record(_stage, nanoseconds);
+                if (_detail != NumberOfStages) {
+                    PipelineProfiler::record(_detail, nanoseconds);
+                }
+            }
+        }
+
+    private:
+        ScopedTimer(const ScopedTimer&);
+        ScopedTimer& operator=(const ScopedTimer&);
+
+        Stage _stage;
+        Stage _detail;
+        bool _active;
+        QElapsedTimer _timer;
+    };
+
+    /**
+     * @brief   打开或关闭统计
+     * @param   enabled 是否记录
+     */
+    static void setEnabled(bool enabled);
+
+    /**
+     * @brief   统计是否打开
+     */
+    static bool isEnabled();
+
+    /**
+     * @brief   打开或关闭精确采样
+     * @param   enabled 是否在直方图之外保留样本
+     * @details 精确采样需要加锁，只在基准测试等需要准确分位数的场合打开
+     */
+    static void setSampling(bool enabled);
+
+    /**
+     * @brief   获取单调时间戳
+     * @return  纳秒时间戳，统计关闭时返回0
+     * @details 用于跨线程计算间隔，例如任务入队和取出的时间差
+     */
+    static long long timestamp();
+
+    /**
+     * @brief   记录一个样本
+     * @param   stage 阶段
+     * @param   nanoseconds 耗时（纳秒）
+     */
+    static void record(Stage stage, long long nanoseconds);
+
+    /**
+     * @brief   计数器增加，统计关闭时忽略
+     * @param   counter 计数器
+     * @param   amount 增量，默认为1
+     */
+    static void count(Counter counter, unsigned long long amount = 1);
+
+    /**
+     * @brief   获取计数器的值
+     */
+    static unsigned long long counter(Counter counter);
+
+    /**
+     * @brief   设置瞬时量的当前值，统计关闭时忽略
+     * @param   gauge 瞬时量
+     * @param   value 当前值
+     */
+    static void setGauge(Gauge gauge, long long value);
+
+    /**
+     * @brief   获取瞬时量的当前值
+     */
+    static long long gauge(Gauge gauge);
+
+    /**
+     * @brief   获取瞬时量在统计打开以来的最大值
+     */
+    static long long gaugeMax(Gauge gauge);
+
+    /**
+     * @brief   统计阶段耗时
+     * @param   stage 阶段
+     * @return  调用次数、平均值和分位数
+     * @details 有精确样本时按样本计算，否则由直方图估计分位数
+     */
+    static StageSummary summarize(Stage stage);
+
+    /**
+     * @brief   获取阶段名称，用于报告
+     */
+    static const char* stageName(Stage stage);
+
+    /**
+     * @brief   获取计数器名称，用于报告
+     */
+    static const char* counterName(Counter counter);
+
+    /**
+     * @brief   获取瞬时量名称，用于报告
+     */
+    static const char* gaugeName(Gauge gauge);
+
+    /**
+     * @brief   导出所有阶段、计数器和瞬时量
+     * @return  JSON文档（UTF-8），阶段包含统计结果和直方图
+     */
+    static QByteArray toJson();
+
+    /**
+     * @brief   把toJson的结果写入文件
+     * @param   fileName 文件路径
+     * @return  写入成功返回true
+     */
+    static bool exportJson(const QString& fileName);
+
+    /**
+     * @brief   清空所有样本、直方图、计数器和瞬时量
+     */
+    static void reset();
+
+    /** @brief 每个阶段最多保留的精确样本数 */
+    static const unsigned int kMaxSamples = 1u << 20;
+
+    /** @brief 直方图桶数，第i个桶记录[2^i, 2^(i+1))纳秒的样本 */
+    static const unsigned int kHistogramBuckets = 40;
+};
@@ -0,0 +1,272 @@
+﻿/**
+ * @file PipelineTrace.cpp
+ * @brief 瓦片管线时间线记录实现文件
+ * @details 该文件实现了按线程缓冲事件和输出Chrome trace JSON的功能
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "PipelineTrace.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+    /** @brief 单个事件 */
+    struct TraceEvent {
+        const char* name;
+        char phase;             ///< 'X'完整事件，'i'瞬时事件，'s'/'t'/'f'流事件
+        long long start;
+        long long end;
+        long long x;
+        long long y;
+        int level;
+    };
+
+    /** @brief 单个线程的事件缓冲区，线程结束后仍保留到导出 */
+    struct ThreadBuffer {
+        std::mutex mutex;
+        std::vector<TraceEvent> events;
+        unsigned long long dropped = 0;
+        unsigned int tid = 0;
+        QByteArray name;
+    };
+
+    /** @brief 记录开关 */
+    std::atomic<bool> traceEnabled(false);
+
+    /** @brief 所有线程的缓冲区 */
+    std::mutex buffersMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+    /** @brief 本线程的缓冲区 */
+    thread_local ThreadBuffer* currentBuffer = NULL;
+
+    /**
+     * @brief 全局单调时钟，首次使用时启动
+     */
+    const QElapsedTimer& monotonicClock() {
+        static QElapsedTimer timer = []() {
+            QElapsedTimer t;
+            t.start();
+            return t;
+        }();
+        return timer;
+    }
+
+    /**
+     * @brief 获取本线程的缓冲区，首次调用时注册
+     * @details 线程名取QThread派生类的类名，如IOWorker、PrefetchThread；GUI线程单独命名
+     */
+    ThreadBuffer* threadBuffer() {
+        if (!currentBuffer) {
+            std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer);
+            QThread* thread = QThread::currentThread();
+            if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()) {
+                buffer->name = "GUI";
+            }
+            else if (thread && !thread->objectName().isEmpty()) {
+                buffer->name = thread->objectName().toUtf8();
+            }
+            else if (thread) {
+                buffer->name = thread->metaObject()->className();
+            }
+            else {
+                buffer->name = "thread";
+            }
+            std::lock_guard<std::mutex> l(buffersMutex);
+            buffer->tid = static_cast<unsigned int>(buffers.size()) + 1;
+            if (buffer->name != "GUI") {
+                buffer->name += " " + QByteArray::number(buffer->tid);
+            }
+            currentBuffer = buffer.get();
+            buffers.push_back(std::move(buffer));
+        }
+        return currentBuffer;
+    }
+
+    /**
+     * @brief 追加一个事件到本线程的缓冲区
+     */
+    void append(const TraceEvent& event) {
+        ThreadBuffer* buffer = threadBuffer();
+        std::lock_guard<std::mutex> l(buffer->mutex);
+        if (buffer->events.size() < PipelineTrace::kMaxEventsPerThread) {
+            buffer->events.push_back(event);
+        }
+        else {
+            ++buffer->dropped;
+        }
+    }
+
+    /**
+     * @brief 纳秒时间戳转换为微秒文本
+     */
+    QByteArray microseconds(long long nanoseconds) {
+        return QByteArray::number(nanoseconds / 1000.0, 'f', 3);
+    }
+
+    /**
+     * @brief 瓦片的流标识
+     */
+    unsigned long long flowId(const TraceEvent& event) {
+        return (static_cast<unsigned long long>(event.level & 0xFF) << 56) ^ (static_cast<unsigned long long>(event.x & 0xFFFFFFF) << 28)
+            ^ static_cast<unsigned long long>(event.y & 0xFFFFFFF);
+    }
+}
+
+/**
+ * @brief 打开或关闭记录
+ * @param enabled 是否记录
+ */
+void PipelineTrace::setEnabled(bool enabled)
+{
+    traceEnabled = enabled;
+}
+
+/**
+ * @brief 记录是否打开
+ * @return 打开时返回true
+ */
+bool PipelineTrace::isEnabled()
+{
+    return traceEnabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief 获取时间戳
+ * @return 纳秒时间戳，记录关闭时返回0
+ * @details 时间戳从1开始，0保留表示“未记录”
+ */
+long long PipelineTrace::timestamp()
+{
+    return isEnabled() ? monotonicClock().nsecsElapsed() + 1 : 0;
+}
+
+/**
+ * @brief 记录一个完整事件
+ */
+void PipelineTrace::complete(const char* name, long long start, long long end, long long x, long long y, int level)
+{
+    if (start == 0 || end == 0) {
+        return;
+    }
+    append(TraceEvent{ name, 'X', start, end, x, y, level });
+}
+
+/**
+ * @brief 记录一个瞬时事件
+ */
+void PipelineTrace::instant(const char* name, long long x, long long y, int level)
+{
+    const long long now = timestamp();
+    if (now != 0) {
+        append(TraceEvent{ name, 'i', now, now, x, y, level });
+    }
+}
+
+/**
+ * @brief 记录瓦片的流事件
+ */
+void PipelineTrace::flow(FlowPhase phase, long long x, long long y, int level)
+{
+    const long long now = timestamp();
+    if (now != 0) {
+        const char phases[] = { 's', 't', 'f' };
+        append(TraceEvent{ "tile", phases[phase], now, now, x, y, level });
+    }
+}
+
+/**
+ * @brief 导出所有线程的事件
+ * @return Chrome trace JSON
+ * @details 先输出线程名元数据事件；事件名均为程序内的常量，不需要转义
+ */
+QByteArray PipelineTrace::toJson()
+{
+    QByteArray json("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    auto separator = [&json, &first]() {
+        if (!first) {
+            json += ",\n";
+        }
+        first = false;
+    };
+    std::lock_guard<std::mutex> registryLock(buffersMutex);
+    for (const std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+        separator();
+        json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + QByteArray::number(buffer->tid)
+            + ",\"args\":{\"name\":\"" + buffer->name + "\"}}";
+
+        std::lock_guard<std::mutex> l(buffer->mutex);
+        const QByteArray tid = QByteArray::number(buffer->tid);
+        for (const TraceEvent& event : buffer->events) {
+            separator();
+            json += "{\"name\":\"";
+            json += event.name;
+            json += "\",\"cat\":\"tile\",\"ph\":\"";
+            json += event.phase;
+            json += "\",\"pid\":1,\"tid\":" + tid + ",\"ts\":" + microseconds(event.start);
+            if (event.phase == 'X') {
+                json += ",\"dur\":" + microseconds(event.end - event.start);
+            }
+            else if (event.phase == 'i') {
+                json += ",\"s\":\"t\"";
+            }
+            else {
+                json += ",\"id\":" + QByteArray::number(flowId(event));
+                if (event.phase == 'f') {
+                    json += ",\"bp\":\"e\"";
+                }
+            }
+            if (event.x >= 0) {
+                json += ",\"args\":{\"x\":" + QByteArray::number(event.x) + ",\"y\":" + QByteArray::number(event.y)
+                    + ",\"level\":" + QByteArray::number(event.level) + "}";
+            }
+            json += "}";
+        }
+        if (buffer->dropped > 0) {
+            separator();
+            json += "{\"name\":\"dropped events\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":" + tid + ",\"ts\":0,\"args\":{\"count\":"
+                + QByteArray::number(buffer->dropped) + "}}";
+        }
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+/**
+ * @brief 把事件写入文件
+ * @param fileName 文件路径
+ * @return 写入成功返回true
+ */
+bool PipelineTrace::exportJson(const QString& fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    const QByteArray json = toJson();
+    return file.write(json) == json.size();
+}
+
+/**
+ * @brief 清空所有线程的事件
+ * @details 缓冲区本身保留，线程继续写入原来的缓冲区
+ */
+void PipelineTrace::clear()
+{
+    std::lock_guard<std::mutex> registryLock(buffersMutex);
+    for (const std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+        std::lock_guard<std::mutex> l(buffer->mutex);
+        buffer->events.clear();
+        buffer->dropped = 0;
+    }
+}
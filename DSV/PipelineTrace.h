@@ -0,0 +1,144 @@
+﻿/**
+ * @file    PipelineTrace.h
+ * @brief   瓦片管线时间线记录类，导出Chrome trace格式
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了瓦片管线事件的时间线记录，包括：
+ *          - 作用域事件，记录请求、排队、读取、转换、投递和绘制各步骤的起止时间
+ *          - 以瓦片坐标为标识的流事件，在时间线上把同一瓦片的各步骤连接起来
+ *          - 按线程分别缓冲，导出为Chrome trace JSON，可在chrome://tracing或Perfetto中查看
+ *
+ * @note    关闭时每个记录点只有一次原子读取的开销；与PipelineProfiler的聚合统计互补
+ * @see     PipelineProfiler
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+/**
+ * @class  PipelineTrace
+ * @brief  瓦片管线时间线
+ * @details 所有接口均为静态函数。每个线程首次记录时分配自己的事件缓冲区，记录时只锁本线程的缓冲区，
+ *          导出时才与记录线程竞争。每个线程最多保留kMaxEventsPerThread个事件，超出的事件计入丢弃数。
+ *          事件名必须是生命周期为整个程序的字符串常量。
+ *
+ * @example
+ *          // 使用示例
+ *          void* OpenSlideImage::readDataFromImage(...) {
+ *              PipelineTrace::ScopedEvent event("OpenSlideImage::readDataFromImage", startX, startY, level);
+ *              ...
+ *          }
+ *          PipelineTrace::setEnabled(true);
+ *          ...
+ *          PipelineTrace::exportJson("pipeline_trace.json");
+ */
+class PipelineTrace
+{
+public:
+    /**
+     * @brief 流事件阶段
+     */
+    enum FlowPhase {
+        FlowBegin,              ///< 瓦片被请求
+        FlowStep,               ///< 瓦片经过的中间步骤
+        FlowEnd                 ///< 瓦片首次绘制
+    };
+
+    /**
+     * @brief   作用域事件
+     * @details 构造时取时间戳，析构时记录一个完整事件；记录关闭时不取时间戳
+     */
+    class ScopedEvent
+    {
+    public:
+        explicit ScopedEvent(const char* name, long long x = -1, long long y = -1, int level = -1) :
+            _name(name), _x(x), _y(y), _level(level), _start(PipelineTrace::timestamp()) {
+        }
+        ~ScopedEvent() {
+            if (_start != 0) {
+                PipelineTrace::complete(_name, _start, PipelineTrace::timestamp(), _x, _y, _level);
+            }
+        }
+
+    private:
+        ScopedEvent(const ScopedEvent&);
+        ScopedEvent& operator=(const ScopedEvent&);
+
+        const char* _name;
+        long long _x;
+        long long _y;
+        int _level;
+        long long _start;
+    };
+
+    /**
+     * @brief   打开或关闭记录
+     * @param   enabled 是否记录
+     */
+    static void setEnabled(bool enabled);
+
+    /**
+     * @brief   记录是否打开
+     */
+    static bool isEnabled();
+
+    /**
+     * @brief   获取时间戳
+     * @return  纳秒时间戳，记录关闭时返回0
+     */
+    static long long timestamp();
+
+    /**
+     * @brief   记录一个完整事件
+     * @param   name  事件名
+     * @param   start 开始时间戳
+     * @param   end   结束时间戳
+     * @param   x     瓦片X坐标，-1表示无
+     * @param   y     瓦片Y坐标
+     * @param   level 层级
+     */
+    static void complete(const char* name, long long start, long long end, long long x = -1, long long y = -1, int level = -1);
+
+    /**
+     * @brief   记录一个瞬时事件
+     * @param   name  事件名
+     * @param   x     瓦片X坐标，-1表示无
+     * @param   y     瓦片Y坐标
+     * @param   level 层级
+     */
+    static void instant(const char* name, long long x = -1, long long y = -1, int level = -1);
+
+    /**
+     * @brief   记录瓦片的流事件
+     * @param   phase 阶段
+     * @param   x     瓦片X坐标
+     * @param   y     瓦片Y坐标
+     * @param   level 层级
+     * @details 流的标识由瓦片坐标和层级得出，应在对应的作用域事件内调用，查看器据此连接各步骤
+     */
+    static void flow(FlowPhase phase, long long x, long long y, int level);
+
+    /**
+     * @brief   导出所有线程的事件
+     * @return  Chrome trace JSON（UTF-8），时间单位为微秒
+     */
+    static QByteArray toJson();
+
+    /**
+     * @brief   把toJson的结果写入文件
+     * @param   fileName 文件路径
+     * @return  写入成功返回true
+     */
+    static bool exportJson(const QString& fileName);
+
+    /**
+     * @brief   清空所有线程的事件
+     */
+    static void clear();
+
+    /** @brief 每个线程最多保留的事件数 */
+    static const unsigned int kMaxEventsPerThread = 1u << 18;
+};
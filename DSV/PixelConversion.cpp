@@ -0,0 +1,1439 @@
+﻿/**
+ * @file PixelConversion.cpp
+ * @brief 像素格式转换内核实现文件
+ * @details 实现预乘BGRA到RGB888的标量、SSE4.1、AVX2和NEON内核，
+ *          窗宽窗位映射的标量、SSE4.1和AVX2内核，多通道加性合成，前景重采样，
+ *          瓦片增强的标量、SSE4.1和AVX2锐化内核，3D颜色查找表的标量和AVX2四面体插值内核，以及运行时内核选择。
+ *          x86内核使用MSVC/GCC的按函数目标指令集编译，不要求整个工程开启/arch选项。
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "PixelConversion.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PIXEL_CONVERSION_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_SSE41
+#define TARGET_AVX2
+#else
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define PIXEL_CONVERSION_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+    /**
+     * @brief 窗宽窗位内核类型
+     * @details data已偏移到所用通道，stride为每像素样本数，level = (v - offset) * scale
+     */
+    template<typename T>
+    struct WindowLevelKernel {
+        typedef void (*Type)(const T* data, unsigned long long nrPixels, unsigned int stride, float offset, float scale, const unsigned int* palette, unsigned int* argb);
+    };
+
+    /**
+     * @brief 窗宽窗位标量内核
+     * @details 比较顺序保证NaN映射为255
+     */
+    template<typename T>
+    void windowLevelScalar(const T* data, unsigned long long nrPixels, unsigned int stride, float offset, float scale, const unsigned int* palette, unsigned int* argb)
+    {
+        for (unsigned long long i = 0; i < nrPixels; ++i, data += stride) {
+            float level = (static_cast<float>(*data) - offset) * scale;
+            level = level < 255.f ? level : 255.f;
+            level = level > 0.f ? level : 0.f;
+            unsigned int index = static_cast<unsigned int>(level);
+            argb[i] = palette ? palette[index] : (0xFF000000u | index * 0x010101u);
+        }
+    }
+
+    typedef void (*ConversionKernel)(const unsigned char*, unsigned char*, unsigned long long, const unsigned char*);
+
+    /**
+     * @brief 标量内核
+     * @details 整数除法与原先的双精度除法后截断结果相同
+     */
+    void convertScalar(const unsigned char* bgra, unsigned char* rgb, unsigned long long nrPixels, const unsigned char* bg)
+    {
+        for (unsigned long long i = 0; i < nrPixels; ++i, bgra += 4, rgb += 3) {
+            unsigned int alpha = bgra[3];
+            if (alpha == 255) {
+                rgb[0] = bgra[2];
+                rgb[1] = bgra[1];
+                rgb[2] = bgra[0];
+            }
+            else if (alpha == 0) {
+                rgb[0] = bg[0];
+                rgb[1] = bg[1];
+                rgb[2] = bg[2];
+            }
+            else {
+                rgb[0] = std::min(255u, (255u * bgra[2]) / alpha);
+                rgb[1] = std::min(255u, (255u * bgra[1]) / alpha);
+                rgb[2] = std::min(255u, (255u * bgra[0]) / alpha);
+            }
+        }
+    }
+
+#if defined(PIXEL_CONVERSION_X86)
+
+    /**
+     * @brief SSE4.1内核，每次处理4个像素
+     * @details 4个像素全不透明时只做一次字节重排；否则逐通道转为浮点做 c*255/a，
+     *          alpha为0的通道由blend替换为背景色
+     */
+    TARGET_SSE41 void convertSSE41(const unsigned char* bgra, unsigned char* rgb, unsigned long long nrPixels, const unsigned char* bg)
+    {
+        const __m128i mask8 = _mm_set1_epi32(0xff);
+        const __m128i opaque = _mm_set1_epi32(0xff);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 scale = _mm_set1_ps(255.f);
+        const __m128i bgR = _mm_set1_epi32(bg[0]);
+        const __m128i bgG = _mm_set1_epi32(bg[1]);
+        const __m128i bgB = _mm_set1_epi32(bg[2]);
+        // BGRA -> RGB，直接从输入重排
+        const __m128i swizzleOpaque = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+        // 每个32位通道中[R G B 0] -> 紧密RGB
+        const __m128i packRGB = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+        unsigned long long i = 0;
+        for (; i + 4 <= nrPixels; i += 4, bgra += 16, rgb += 12) {
+            __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bgra));
+            __m128i a = _mm_srli_epi32(px, 24);
+            __m128i out;
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(a, opaque)) == 0xFFFF) {
+                out = _mm_shuffle_epi8(px, swizzleOpaque);
+            }
+            else {
+                __m128 af = _mm_cvtepi32_ps(a);
+                __m128i transparent = _mm_cmpeq_epi32(a, zero);
+                __m128i r = _mm_and_si128(_mm_srli_epi32(px, 16), mask8);
+                __m128i g = _mm_and_si128(_mm_srli_epi32(px, 8), mask8);
+                __m128i b = _mm_and_si128(px, mask8);
+                r = _mm_min_epi32(_mm_cvttps_epi32(_mm_div_ps(_mm_mul_ps(_mm_cvtepi32_ps(r), scale), af)), mask8);
+                g = _mm_min_epi32(_mm_cvttps_epi32(_mm_div_ps(_mm_mul_ps(_mm_cvtepi32_ps(g), scale), af)), mask8);
+                b = _mm_min_epi32(_mm_cvttps_epi32(_mm_div_ps(_mm_mul_ps(_mm_cvtepi32_ps(b), scale), af)), mask8);
+                r = _mm_blendv_epi8(r, bgR, transparent);
+                g = _mm_blendv_epi8(g, bgG, transparent);
+                b = _mm_blendv_epi8(b, bgB, transparent);
+                out = _mm_or_si128(r, _mm_or_si128(_mm_slli_epi32(g, 8), _mm_slli_epi32(b, 16)));
+                out = _mm_shuffle_epi8(out, packRGB);
+            }
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(rgb), out);
+            int tail = _mm_extract_epi32(out, 2);
+            std::memcpy(rgb + 8, &tail, 4);
+        }
+        convertScalar(bgra, rgb, nrPixels - i, bg);
+    }
+
+    /**
+     * @brief AVX2内核，每次处理8个像素
+     * @details 算法与SSE4.1内核相同，重排在两个128位通道内分别完成
+     */
+    TARGET_AVX2 void convertAVX2(const unsigned char* bgra, unsigned char* rgb, unsigned long long nrPixels, const unsigned char* bg)
+    {
+        const __m256i mask8 = _mm256_set1_epi32(0xff);
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256 scale = _mm256_set1_ps(255.f);
+        const __m256i bgR = _mm256_set1_epi32(bg[0]);
+        const __m256i bgG = _mm256_set1_epi32(bg[1]);
+        const __m256i bgB = _mm256_set1_epi32(bg[2]);
+        const __m256i swizzleOpaque = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+        const __m256i packRGB = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+        unsigned long long i = 0;
+        for (; i + 8 <= nrPixels; i += 8, bgra += 32, rgb += 24) {
+            __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bgra));
+            __m256i a = _mm256_srli_epi32(px, 24);
+            __m256i out;
+            if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(a, mask8)) == -1) {
+                out = _mm256_shuffle_epi8(px, swizzleOpaque);
+            }
+            else {
+                __m256 af = _mm256_cvtepi32_ps(a);
+                __m256i transparent = _mm256_cmpeq_epi32(a, zero);
+                __m256i r = _mm256_and_si256(_mm256_srli_epi32(px, 16), mask8);
+                __m256i g = _mm256_and_si256(_mm256_srli_epi32(px, 8), mask8);
+                __m256i b = _mm256_and_si256(px, mask8);
+                r = _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_div_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(r), scale), af)), mask8);
+                g = _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_div_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(g), scale), af)), mask8);
+                b = _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_div_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(b), scale), af)), mask8);
+                r = _mm256_blendv_epi8(r, bgR, transparent);
+                g = _mm256_blendv_epi8(g, bgG, transparent);
+                b = _mm256_blendv_epi8(b, bgB, transparent);
+                out = _mm256_or_si256(r, _mm256_or_si256(_mm256_slli_epi32(g, 8), _mm256_slli_epi32(b, 16)));
+                out = _mm256_shuffle_epi8(out, packRGB);
+            }
+            __m128i low = _mm256_castsi256_si128(out);
+            __m128i high = _mm256_extracti128_si256(out, 1);
+            int tail = _mm_extract_epi32(low, 2);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(rgb), low);
+            std::memcpy(rgb + 8, &tail, 4);
+            tail = _mm_extract_epi32(high, 2);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(rgb + 12), high);
+            std::memcpy(rgb + 20, &tail, 4);
+        }
+        convertScalar(bgra, rgb, nrPixels - i, bg);
+    }
+
+    /**
+     * @brief 按通道读取8个（AVX2）或4个（SSE4.1）样本并转为浮点
+     * @details 通用版本先按步长收集到临时数组；单通道的8位、16位和浮点数据直接向量加载
+     * @tparam  S 编译期每像素样本数，0表示使用运行时stride
+     */
+    template<typename T, unsigned int S>
+    struct ChannelLoader {
+        static TARGET_AVX2 __m256 load8(const T* data, unsigned int stride)
+        {
+            const unsigned int step = S ? S : stride;
+            alignas(32) float values[8];
+            for (int k = 0; k < 8; ++k) {
+                values[k] = static_cast<float>(data[k * step]);
+            }
+            return _mm256_load_ps(values);
+        }
+
+        static TARGET_SSE41 __m128 load4(const T* data, unsigned int stride)
+        {
+            const unsigned int step = S ? S : stride;
+            alignas(16) float values[4];
+            for (int k = 0; k < 4; ++k) {
+                values[k] = static_cast<float>(data[k * step]);
+            }
+            return _mm_load_ps(values);
+        }
+    };
+
+    template<>
+    struct ChannelLoader<unsigned char, 1> {
+        static TARGET_AVX2 __m256 load8(const unsigned char* data, unsigned int)
+        {
+            return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(data))));
+        }
+
+        static TARGET_SSE41 __m128 load4(const unsigned char* data, unsigned int)
+        {
+            int packed;
+            std::memcpy(&packed, data, 4);
+            return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed)));
+        }
+    };
+
+    template<>
+    struct ChannelLoader<unsigned short, 1> {
+        static TARGET_AVX2 __m256 load8(const unsigned short* data, unsigned int)
+        {
+            return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data))));
+        }
+
+        static TARGET_SSE41 __m128 load4(const unsigned short* data, unsigned int)
+        {
+            return _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(data))));
+        }
+    };
+
+    template<>
+    struct ChannelLoader<float, 1> {
+        static TARGET_AVX2 __m256 load8(const float* data, unsigned int)
+        {
+            return _mm256_loadu_ps(data);
+        }
+
+        static TARGET_SSE41 __m128 load4(const float* data, unsigned int)
+        {
+            return _mm_loadu_ps(data);
+        }
+    };
+
+    /**
+     * @brief 窗宽窗位AVX2内核，每次处理8个像素
+     * @details min在前、max在后，使NaN经_mm256_min_ps得到255；调色板用gather查表
+     */
+    template<typename T, unsigned int S>
+    TARGET_AVX2 void windowLevelAVX2Impl(const T* data, unsigned long long nrPixels, unsigned int stride, float offset, float scale, const unsigned int* palette, unsigned int* argb)
+    {
+        const unsigned int step = S ? S : stride;
+        const __m256 vOffset = _mm256_set1_ps(offset);
+        const __m256 vScale = _mm256_set1_ps(scale);
+        const __m256 vMax = _mm256_set1_ps(255.f);
+        const __m256 vZero = _mm256_setzero_ps();
+        const __m256i gray = _mm256_set1_epi32(0x010101);
+        const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+
+        unsigned long long i = 0;
+        for (; i + 8 <= nrPixels; i += 8, data += 8 * step) {
+            __m256 level = _mm256_mul_ps(_mm256_sub_ps(ChannelLoader<T, S>::load8(data, step), vOffset), vScale);
+            level = _mm256_max_ps(_mm256_min_ps(level, vMax), vZero);
+            __m256i index = _mm256_cvttps_epi32(level);
+            __m256i out = palette ? _mm256_i32gather_epi32(reinterpret_cast<const int*>(palette), index, 4)
+                : _mm256_or_si256(_mm256_mullo_epi32(index, gray), alpha);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(argb + i), out);
+        }
+        windowLevelScalar(data, nrPixels - i, step, offset, scale, palette, argb + i);
+    }
+
+    /**
+     * @brief 窗宽窗位SSE4.1内核，每次处理4个像素
+     * @details 没有gather指令，调色板按4个索引逐个查表
+     */
+    template<typename T, unsigned int S>
+    TARGET_SSE41 void windowLevelSSE41Impl(const T* data, unsigned long long nrPixels, unsigned int stride, float offset, float scale, const unsigned int* palette, unsigned int* argb)
+    {
+        const unsigned int step = S ? S : stride;
+        const __m128 vOffset = _mm_set1_ps(offset);
+        const __m128 vScale = _mm_set1_ps(scale);
+        const __m128 vMax = _mm_set1_ps(255.f);
+        const __m128 vZero = _mm_setzero_ps();
+        const __m128i gray = _mm_set1_epi32(0x010101);
+        const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+
+        unsigned long long i = 0;
+        for (; i + 4 <= nrPixels; i += 4, data += 4 * step) {
+            __m128 level = _mm_mul_ps(_mm_sub_ps(ChannelLoader<T, S>::load4(data, step), vOffset), vScale);
+            level = _mm_max_ps(_mm_min_ps(level, vMax), vZero);
+            __m128i index = _mm_cvttps_epi32(level);
+            if (palette) {
+                alignas(16) unsigned int indices[4];
+                _mm_store_si128(reinterpret_cast<__m128i*>(indices), index);
+                argb[i] = palette[indices[0]];
+                argb[i + 1] = palette[indices[1]];
+                argb[i + 2] = palette[indices[2]];
+                argb[i + 3] = palette[indices[3]];
+            }
+            else {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(argb + i), _mm_or_si128(_mm_mullo_epi32(index, gray), alpha));
+            }
+        }
+        windowLevelScalar(data, nrPixels - i, step, offset, scale, palette, argb + i);
+    }
+
+    /**
+     * @brief 按每像素样本数分派到展开的AVX2内核
+     */
+    template<typename T>
+    TARGET_AVX2 void windowLevelAVX2(const T* data, unsigned long long nrPixels, unsigned int stride, float offset, float scale, const unsigned int* palette, unsigned int* argb)
+    {
+        switch (stride) {
+        case 1: windowLevelAVX2Impl<T, 1>(data, nrPixels, stride, offset, scale, palette, argb); break;
+        case 2: windowLevelAVX2Impl<T, 2>(data, nrPixels, stride, offset, scale, palette, argb); break;
+        case 3: windowLevelAVX2Impl<T, 3>(data, nrPixels, stride, offset, scale, palette, argb); break;
+        case 4: windowLevelAVX2Impl<T, 4>(data, nrPixels, stride, offset, scale, palette, argb); break;
+        default: windowLevelAVX2Impl<T, 0>(data, nrPixels, stride, offset, scale, palette, argb); break;
+        }
+    }
+
+    /**
+     * @brief 按每像素样本数分派到展开的SSE4.1内核
+     */
+    template<typename T>
+    TARGET_SSE41 void windowLevelSSE41(const T* data, unsigned long long nrPixels, unsigned int stride, float offset, float scale, const unsigned int* palette, unsigned int* argb)
+    {
+        switch (stride) {
+        case 1: windowLevelSSE41Impl<T, 1>(data, nrPixels, stride, offset, scale, palette, argb); break;
+        case 2: windowLevelSSE41Impl<T, 2>(data, nrPixels, stride, offset, scale, palette, argb); break;
+        case 3: windowLevelSSE41Impl<T, 3>(data, nrPixels, stride, offset, scale, palette, argb); break;
+        case 4: windowLevelSSE41Impl<T, 4>(data, nrPixels, stride, offset, scale, palette, argb); break;
+        default: windowLevelSSE41Impl<T, 0>(data, nrPixels, stride, offset, scale, palette, argb); break;
+        }
+    }
+
+    /**
+     * @brief 检测CPU是否支持指定指令集
+     */
+    bool cpuSupportsSSE41()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 19)) != 0;
+#else
+        return __builtin_cpu_supports("sse4.1");
+#endif
+    }
+
+    bool cpuSupportsAVX2()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return false;
+        }
+        __cpuid(info, 1);
+        bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+        __cpuidex(info, 7, 0);
+        return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+#elif defined(PIXEL_CONVERSION_NEON)
+
+    /**
+     * @brief 对16个通道值做 c*255/a 反预乘，饱和收窄到8位
+     */
+    inline uint8x16_t unpremultiplyNEON(uint8x16_t c, const float32x4_t af[4])
+    {
+        const float32x4_t scale = vdupq_n_f32(255.f);
+        uint16x8_t c16[2] = { vmovl_u8(vget_low_u8(c)), vmovl_u8(vget_high_u8(c)) };
+        uint32x4_t r32[4];
+        for (int k = 0; k < 4; ++k) {
+            uint32x4_t c32 = (k % 2 == 0) ? vmovl_u16(vget_low_u16(c16[k / 2])) : vmovl_u16(vget_high_u16(c16[k / 2]));
+            r32[k] = vcvtq_u32_f32(vdivq_f32(vmulq_f32(vcvtq_f32_u32(c32), scale), af[k]));
+        }
+        uint16x8_t low = vcombine_u16(vqmovn_u32(r32[0]), vqmovn_u32(r32[1]));
+        uint16x8_t high = vcombine_u16(vqmovn_u32(r32[2]), vqmovn_u32(r32[3]));
+        return vcombine_u8(vqmovn_u16(low), vqmovn_u16(high));
+    }
+
+    /**
+     * @brief NEON内核（AArch64），每次处理16个像素
+     * @details vld4q_u8解交错BGRA，全不透明时直接vst3q_u8交换写出
+     */
+    void convertNEON(const unsigned char* bgra, unsigned char* rgb, unsigned long long nrPixels, const unsigned char* bg)
+    {
+        const uint8x16_t bgR = vdupq_n_u8(bg[0]);
+        const uint8x16_t bgG = vdupq_n_u8(bg[1]);
+        const uint8x16_t bgB = vdupq_n_u8(bg[2]);
+
+        unsigned long long i = 0;
+        for (; i + 16 <= nrPixels; i += 16, bgra += 64, rgb += 48) {
+            uint8x16x4_t px = vld4q_u8(bgra);
+            uint8x16_t a = px.val[3];
+            uint8x16x3_t out;
+            if (vminvq_u8(a) == 255) {
+                out.val[0] = px.val[2];
+                out.val[1] = px.val[1];
+                out.val[2] = px.val[0];
+            }
+            else {
+                uint16x8_t a16[2] = { vmovl_u8(vget_low_u8(a)), vmovl_u8(vget_high_u8(a)) };
+                float32x4_t af[4] = {
+                    vcvtq_f32_u32(vmovl_u16(vget_low_u16(a16[0]))), vcvtq_f32_u32(vmovl_u16(vget_high_u16(a16[0]))),
+                    vcvtq_f32_u32(vmovl_u16(vget_low_u16(a16[1]))), vcvtq_f32_u32(vmovl_u16(vget_high_u16(a16[1])))
+                };
+                uint8x16_t transparent = vceqq_u8(a, vdupq_n_u8(0));
+                out.val[0] = vbslq_u8(transparent, bgR, unpremultiplyNEON(px.val[2], af));
+                out.val[1] = vbslq_u8(transparent, bgG, unpremultiplyNEON(px.val[1], af));
+                out.val[2] = vbslq_u8(transparent, bgB, unpremultiplyNEON(px.val[0], af));
+            }
+            vst3q_u8(rgb, out);
+        }
+        convertScalar(bgra, rgb, nrPixels - i, bg);
+    }
+
+#endif
+
+    /**
+     * @brief 行插值内核类型
+     * @details out[i] = a[i] + (b[i] - a[i]) * weight
+     */
+    typedef void (*BlendRowsKernel)(const float* a, const float* b, float weight, float* out, unsigned long long count);
+
+    /**
+     * @brief 行插值标量内核
+     */
+    void blendRowsScalar(const float* a, const float* b, float weight, float* out, unsigned long long count)
+    {
+        for (unsigned long long i = 0; i < count; ++i) {
+            out[i] = a[i] + (b[i] - a[i]) * weight;
+        }
+    }
+
+#if defined(PIXEL_CONVERSION_X86)
+
+    /**
+     * @brief 行插值SSE4.1内核，每次处理4个样本
+     */
+    TARGET_SSE41 void blendRowsSSE41(const float* a, const float* b, float weight, float* out, unsigned long long count)
+    {
+        const __m128 w = _mm_set1_ps(weight);
+        unsigned long long i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 va = _mm_loadu_ps(a + i);
+            __m128 vb = _mm_loadu_ps(b + i);
+            _mm_storeu_ps(out + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), w)));
+        }
+        blendRowsScalar(a + i, b + i, weight, out + i, count - i);
+    }
+
+    /**
+     * @brief 行插值AVX2内核，每次处理8个样本
+     */
+    TARGET_AVX2 void blendRowsAVX2(const float* a, const float* b, float weight, float* out, unsigned long long count)
+    {
+        const __m256 w = _mm256_set1_ps(weight);
+        unsigned long long i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256 va = _mm256_loadu_ps(a + i);
+            __m256 vb = _mm256_loadu_ps(b + i);
+            _mm256_storeu_ps(out + i, _mm256_add_ps(va, _mm256_mul_ps(_mm256_sub_ps(vb, va), w)));
+        }
+        blendRowsScalar(a + i, b + i, weight, out + i, count - i);
+    }
+
+#elif defined(PIXEL_CONVERSION_NEON)
+
+    /**
+     * @brief 行插值NEON内核，每次处理4个样本
+     */
+    void blendRowsNEON(const float* a, const float* b, float weight, float* out, unsigned long long count)
+    {
+        unsigned long long i = 0;
+        for (; i + 4 <= count; i += 4) {
+            float32x4_t va = vld1q_f32(a + i);
+            float32x4_t vb = vld1q_f32(b + i);
+            vst1q_f32(out + i, vmlaq_n_f32(va, vsubq_f32(vb, va), weight));
+        }
+        blendRowsScalar(a + i, b + i, weight, out + i, count - i);
+    }
+
+#endif
+
+    /**
+     * @brief 根据CPU能力选择行插值内核
+     */
+    BlendRowsKernel selectBlendRowsKernel()
+    {
+#if defined(PIXEL_CONVERSION_X86)
+        if (cpuSupportsAVX2()) {
+            return blendRowsAVX2;
+        }
+        if (cpuSupportsSSE41()) {
+            return blendRowsSSE41;
+        }
+#elif defined(PIXEL_CONVERSION_NEON)
+        return blendRowsNEON;
+#endif
+        return blendRowsScalar;
+    }
+
+    /**
+     * @brief 锐化行内核类型
+     * @details center为原始行的字节，above/middle/below为上一行、本行、下一行的水平1-2-1和，
+     *          count为字节数（像素数乘4），结果写入out，out可以与center相同
+     */
+    typedef void (*SharpenRowKernel)(const unsigned char* center, const unsigned short* above, const unsigned short* middle,
+        const unsigned short* below, short sharpness, unsigned char* out, unsigned long long count);
+
+    /**
+     * @brief 锐化行标量内核
+     * @details delta = ((16c - g) * sharpness) >> 16，与SIMD内核的_mm_mulhi_epi16逐位一致
+     */
+    void sharpenRowScalar(const unsigned char* center, const unsigned short* above, const unsigned short* middle,
+        const unsigned short* below, short sharpness, unsigned char* out, unsigned long long count)
+    {
+        for (unsigned long long i = 0; i + 4 <= count; i += 4) {
+            const int alpha = center[i + 3];
+            for (unsigned int k = 0; k < 3; ++k) {
+                const int c = center[i + k];
+                const int d = 16 * c - (above[i + k] + 2 * middle[i + k] + below[i + k]);
+                int v = c + ((d * sharpness) >> 16);
+                v = v < 0 ? 0 : (v > 255 ? 255 : v);
+                out[i + k] = static_cast<unsigned char>(v < alpha ? v : alpha);
+            }
+            out[i + 3] = static_cast<unsigned char>(alpha);
+        }
+    }
+
+#if defined(PIXEL_CONVERSION_X86)
+
+    /**
+     * @brief 锐化行SSE4.1内核，每次处理4个像素
+     */
+    TARGET_SSE41 void sharpenRowSSE41(const unsigned char* center, const unsigned short* above, const unsigned short* middle,
+        const unsigned short* below, short sharpness, unsigned char* out, unsigned long long count)
+    {
+        const __m128i k = _mm_set1_epi16(sharpness);
+        const __m128i sixteen = _mm_set1_epi16(16);
+        const __m128i alphaShuffle = _mm_setr_epi8(3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+        const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+        unsigned long long i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(center + i));
+            __m128i cLo = _mm_cvtepu8_epi16(c);
+            __m128i cHi = _mm_cvtepu8_epi16(_mm_srli_si128(c, 8));
+            __m128i mLo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(middle + i));
+            __m128i mHi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(middle + i + 8));
+            __m128i gLo = _mm_add_epi16(_mm_add_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(above + i)), _mm_add_epi16(mLo, mLo)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + i)));
+            __m128i gHi = _mm_add_epi16(_mm_add_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(above + i + 8)), _mm_add_epi16(mHi, mHi)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + i + 8)));
+            __m128i rLo = _mm_add_epi16(cLo, _mm_mulhi_epi16(_mm_sub_epi16(_mm_mullo_epi16(cLo, sixteen), gLo), k));
+            __m128i rHi = _mm_add_epi16(cHi, _mm_mulhi_epi16(_mm_sub_epi16(_mm_mullo_epi16(cHi, sixteen), gHi), k));
+            __m128i result = _mm_min_epu8(_mm_packus_epi16(rLo, rHi), _mm_shuffle_epi8(c, alphaShuffle));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_blendv_epi8(result, c, alphaMask));
+        }
+        sharpenRowScalar(center + i, above + i, middle + i, below + i, sharpness, out + i, count - i);
+    }
+
+    /**
+     * @brief 锐化行AVX2内核，每次处理8个像素
+     * @details packus按128位通道交错，之后用permute4x64恢复像素顺序
+     */
+    TARGET_AVX2 void sharpenRowAVX2(const unsigned char* center, const unsigned short* above, const unsigned short* middle,
+        const unsigned short* below, short sharpness, unsigned char* out, unsigned long long count)
+    {
+        const __m256i k = _mm256_set1_epi16(sharpness);
+        const __m256i sixteen = _mm256_set1_epi16(16);
+        const __m256i alphaShuffle = _mm256_setr_epi8(3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15,
+            3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+        const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+        unsigned long long i = 0;
+        for (; i + 32 <= count; i += 32) {
+            __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(center + i));
+            __m256i cLo = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(center + i)));
+            __m256i cHi = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(center + i + 16)));
+            __m256i mLo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(middle + i));
+            __m256i mHi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(middle + i + 16));
+            __m256i gLo = _mm256_add_epi16(_mm256_add_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + i)), _mm256_add_epi16(mLo, mLo)),
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(below + i)));
+            __m256i gHi = _mm256_add_epi16(_mm256_add_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + i + 16)), _mm256_add_epi16(mHi, mHi)),
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(below + i + 16)));
+            __m256i rLo = _mm256_add_epi16(cLo, _mm256_mulhi_epi16(_mm256_sub_epi16(_mm256_mullo_epi16(cLo, sixteen), gLo), k));
+            __m256i rHi = _mm256_add_epi16(cHi, _mm256_mulhi_epi16(_mm256_sub_epi16(_mm256_mullo_epi16(cHi, sixteen), gHi), k));
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(rLo, rHi), 0xD8);
+            __m256i result = _mm256_min_epu8(packed, _mm256_shuffle_epi8(c, alphaShuffle));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_blendv_epi8(result, c, alphaMask));
+        }
+        sharpenRowScalar(center + i, above + i, middle + i, below + i, sharpness, out + i, count - i);
+    }
+
+#endif
+
+    /**
+     * @brief 根据CPU能力选择锐化行内核
+     */
+    SharpenRowKernel selectSharpenRowKernel()
+    {
+#if defined(PIXEL_CONVERSION_X86)
+        if (cpuSupportsAVX2()) {
+            return sharpenRowAVX2;
+        }
+        if (cpuSupportsSSE41()) {
+            return sharpenRowSSE41;
+        }
+#endif
+        return sharpenRowScalar;
+    }
+
+    /**
+     * @brief 计算一行的水平1-2-1和
+     * @details 每个字节分量与左右相邻像素的同一分量组合，首尾像素复制自身作为边界
+     */
+    void horizontalGaussianRow(const unsigned char* row, unsigned int width, unsigned short* sums)
+    {
+        for (unsigned int x = 0; x < width; ++x) {
+            const unsigned char* left = row + (x > 0 ? x - 1 : x) * 4;
+            const unsigned char* pixel = row + x * 4;
+            const unsigned char* right = row + (x + 1 < width ? x + 1 : x) * 4;
+            for (unsigned int k = 0; k < 4; ++k) {
+                sums[x * 4 + k] = static_cast<unsigned short>(left[k] + 2 * pixel[k] + right[k]);
+            }
+        }
+    }
+
+    /** @brief 3D查找表R方向的节点跨距 */
+    const unsigned int kLUTStrideR = PixelConversion::ColorLUT3D::kGridSize * PixelConversion::ColorLUT3D::kGridSize;
+
+    /** @brief 3D查找表G方向的节点跨距 */
+    const unsigned int kLUTStrideG = PixelConversion::ColorLUT3D::kGridSize;
+
+    /** @brief 格内从(0,0,0)角到(1,1,1)角的节点偏移 */
+    const unsigned int kLUTDiagonal = kLUTStrideR + kLUTStrideG + 1;
+
+    /**
+     * @brief 3D查找表内核类型
+     */
+    typedef void (*ColorLUTKernel)(unsigned int* argb, unsigned long long nrPixels, const unsigned int* cells, const unsigned int* nodes);
+
+    /**
+     * @brief 按四面体插值变换一个像素
+     * @details 四面体由格内位置从大到小经过的三个坐标轴确定：最大轴先取r、g、b中靠前者，
+     *          最小轴取靠后者，因此两者在位置相等时也不会相同。输出为
+     *          c000 + (cA - c000) * fmax + (cB - cA) * fmid + (c111 - cB) * fmin
+     */
+    inline unsigned int colorLUTPixel(unsigned int pixel, const unsigned int* cells, const unsigned int* nodes)
+    {
+        if ((pixel >> 24) != 255) {
+            return pixel;
+        }
+        const unsigned int cr = cells[(pixel >> 16) & 0xFF];
+        const unsigned int cg = cells[(pixel >> 8) & 0xFF];
+        const unsigned int cb = cells[pixel & 0xFF];
+        const int fr = cr & 511, fg = cg & 511, fb = cb & 511;
+        const unsigned int base = (cr >> 9) * kLUTStrideR + (cg >> 9) * kLUTStrideG + (cb >> 9);
+        const unsigned int maxStride = (fr >= fg && fr >= fb) ? kLUTStrideR : (fg >= fb ? kLUTStrideG : 1);
+        const unsigned int minStride = (fb <= fg && fb <= fr) ? 1 : (fg <= fr ? kLUTStrideG : kLUTStrideR);
+        const int fmax = std::max(std::max(fr, fg), fb);
+        const int fmin = std::min(std::min(fr, fg), fb);
+        const int fmid = fr + fg + fb - fmax - fmin;
+        const unsigned int c0 = nodes[base], cA = nodes[base + maxStride], cB = nodes[base + kLUTDiagonal - minStride], c1 = nodes[base + kLUTDiagonal];
+        unsigned int result = 0xFF000000u;
+        for (unsigned int channel = 0; channel < 3; ++channel) {
+            const unsigned int shift = channel * 10;
+            const int v0 = (c0 >> shift) & 1023, vA = (cA >> shift) & 1023, vB = (cB >> shift) & 1023, v1 = (c1 >> shift) & 1023;
+            const int sum = v0 * 256 + (vA - v0) * fmax + (vB - vA) * fmid + (v1 - vB) * fmin;
+            result |= static_cast<unsigned int>((sum + 512) >> 10) << (channel * 8);
+        }
+        return result;
+    }
+
+    /**
+     * @brief 3D查找表标量内核
+     */
+    void colorLUTScalar(unsigned int* argb, unsigned long long nrPixels, const unsigned int* cells, const unsigned int* nodes)
+    {
+        for (unsigned long long i = 0; i < nrPixels; ++i) {
+            argb[i] = colorLUTPixel(argb[i], cells, nodes);
+        }
+    }
+
+#if defined(PIXEL_CONVERSION_X86)
+
+    /**
+     * @brief 取出3D查找表节点的一个10位分量并与三个差值加权
+     */
+    TARGET_AVX2 inline __m256i colorLUTChannelAVX2(__m256i c0, __m256i cA, __m256i cB, __m256i c1, __m128i shift,
+        __m256i fmax, __m256i fmid, __m256i fmin)
+    {
+        const __m256i mask = _mm256_set1_epi32(1023);
+        __m256i v0 = _mm256_and_si256(_mm256_srl_epi32(c0, shift), mask);
+        __m256i vA = _mm256_and_si256(_mm256_srl_epi32(cA, shift), mask);
+        __m256i vB = _mm256_and_si256(_mm256_srl_epi32(cB, shift), mask);
+        __m256i v1 = _mm256_and_si256(_mm256_srl_epi32(c1, shift), mask);
+        __m256i sum = _mm256_add_epi32(_mm256_slli_epi32(v0, 8), _mm256_mullo_epi32(_mm256_sub_epi32(vA, v0), fmax));
+        sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_sub_epi32(vB, vA), fmid));
+        sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_sub_epi32(v1, vB), fmin));
+        return _mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(512)), 10);
+    }
+
+    /**
+     * @brief 3D查找表AVX2内核，每次处理8个像素
+     * @details 格和节点用gather读取，四面体的选择用比较掩码和blendv完成，不含分支
+     */
+    TARGET_AVX2 void colorLUTAVX2(unsigned int* argb, unsigned long long nrPixels, const unsigned int* cells, const unsigned int* nodes)
+    {
+        const int* cellTable = reinterpret_cast<const int*>(cells);
+        const int* nodeTable = reinterpret_cast<const int*>(nodes);
+        const __m256i byteMask = _mm256_set1_epi32(0xFF);
+        const __m256i fractionMask = _mm256_set1_epi32(511);
+        const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+        const __m256i allOnes = _mm256_set1_epi32(-1);
+        const __m256i strideR = _mm256_set1_epi32(kLUTStrideR);
+        const __m256i strideG = _mm256_set1_epi32(kLUTStrideG);
+        const __m256i strideB = _mm256_set1_epi32(1);
+        const __m256i diagonal = _mm256_set1_epi32(kLUTDiagonal);
+        unsigned long long i = 0;
+        for (; i + 8 <= nrPixels; i += 8) {
+            __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(argb + i));
+            __m256i opaque = _mm256_cmpeq_epi32(_mm256_and_si256(p, alpha), alpha);
+            if (_mm256_movemask_epi8(opaque) == 0) {
+                continue;
+            }
+            __m256i cr = _mm256_i32gather_epi32(cellTable, _mm256_and_si256(_mm256_srli_epi32(p, 16), byteMask), 4);
+            __m256i cg = _mm256_i32gather_epi32(cellTable, _mm256_and_si256(_mm256_srli_epi32(p, 8), byteMask), 4);
+            __m256i cb = _mm256_i32gather_epi32(cellTable, _mm256_and_si256(p, byteMask), 4);
+            __m256i fr = _mm256_and_si256(cr, fractionMask);
+            __m256i fg = _mm256_and_si256(cg, fractionMask);
+            __m256i fb = _mm256_and_si256(cb, fractionMask);
+            __m256i base = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(cr, 9), strideR),
+                _mm256_mullo_epi32(_mm256_srli_epi32(cg, 9), strideG)), _mm256_srli_epi32(cb, 9));
+            __m256i rGeG = _mm256_xor_si256(_mm256_cmpgt_epi32(fg, fr), allOnes);
+            __m256i rGeB = _mm256_xor_si256(_mm256_cmpgt_epi32(fb, fr), allOnes);
+            __m256i gGeB = _mm256_xor_si256(_mm256_cmpgt_epi32(fb, fg), allOnes);
+            __m256i maxStride = _mm256_blendv_epi8(_mm256_blendv_epi8(strideB, strideG, gGeB), strideR, _mm256_and_si256(rGeG, rGeB));
+            __m256i minStride = _mm256_blendv_epi8(_mm256_blendv_epi8(strideR, strideG, rGeG), strideB, _mm256_and_si256(gGeB, rGeB));
+            __m256i fmax = _mm256_max_epi32(_mm256_max_epi32(fr, fg), fb);
+            __m256i fmin = _mm256_min_epi32(_mm256_min_epi32(fr, fg), fb);
+            __m256i fmid = _mm256_sub_epi32(_mm256_sub_epi32(_mm256_add_epi32(_mm256_add_epi32(fr, fg), fb), fmax), fmin);
+            __m256i c0 = _mm256_i32gather_epi32(nodeTable, base, 4);
+            __m256i cA = _mm256_i32gather_epi32(nodeTable, _mm256_add_epi32(base, maxStride), 4);
+            __m256i cB = _mm256_i32gather_epi32(nodeTable, _mm256_sub_epi32(_mm256_add_epi32(base, diagonal), minStride), 4);
+            __m256i c1 = _mm256_i32gather_epi32(nodeTable, _mm256_add_epi32(base, diagonal), 4);
+            __m256i blue = colorLUTChannelAVX2(c0, cA, cB, c1, _mm_cvtsi32_si128(0), fmax, fmid, fmin);
+            __m256i green = colorLUTChannelAVX2(c0, cA, cB, c1, _mm_cvtsi32_si128(10), fmax, fmid, fmin);
+            __m256i red = colorLUTChannelAVX2(c0, cA, cB, c1, _mm_cvtsi32_si128(20), fmax, fmid, fmin);
+            __m256i result = _mm256_or_si256(_mm256_or_si256(alpha, _mm256_slli_epi32(red, 16)), _mm256_or_si256(_mm256_slli_epi32(green, 8), blue));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(argb + i), _mm256_blendv_epi8(p, result, opaque));
+        }
+        colorLUTScalar(argb + i, nrPixels - i, cells, nodes);
+    }
+
+#endif
+
+    /**
+     * @brief 根据CPU能力选择3D查找表内核
+     * @details 四面体插值依赖gather，SSE4.1和NEON平台使用标量实现
+     */
+    ColorLUTKernel selectColorLUTKernel()
+    {
+#if defined(PIXEL_CONVERSION_X86)
+        if (cpuSupportsAVX2()) {
+            return colorLUTAVX2;
+        }
+#endif
+        return colorLUTScalar;
+    }
+
+    /**
+     * @brief 根据CPU能力选择内核
+     */
+    ConversionKernel selectKernel(const char*& name)
+    {
+#if defined(PIXEL_CONVERSION_X86)
+        if (cpuSupportsAVX2()) {
+            name = "AVX2";
+            return convertAVX2;
+        }
+        if (cpuSupportsSSE41()) {
+            name = "SSE4.1";
+            return convertSSE41;
+        }
+#elif defined(PIXEL_CONVERSION_NEON)
+        name = "NEON";
+        return convertNEON;
+#endif
+        name = "Scalar";
+        return convertScalar;
+    }
+
+    /**
+     * @brief 已选内核，函数内静态变量保证线程安全的一次性初始化
+     */
+    struct KernelSelection {
+        const char* name;
+        ConversionKernel kernel;
+        KernelSelection() : name(""), kernel(selectKernel(name)) {}
+    };
+
+    const KernelSelection& kernelSelection()
+    {
+        static const KernelSelection selection;
+        return selection;
+    }
+
+    /**
+     * @brief 根据CPU能力选择窗宽窗位内核
+     */
+    template<typename T>
+    typename WindowLevelKernel<T>::Type selectWindowLevelKernel()
+    {
+#if defined(PIXEL_CONVERSION_X86)
+        if (cpuSupportsAVX2()) {
+            return windowLevelAVX2<T>;
+        }
+        if (cpuSupportsSSE41()) {
+            return windowLevelSSE41<T>;
+        }
+#endif
+        return windowLevelScalar<T>;
+    }
+
+    /**
+     * @brief 样本类型转换内核
+     * @details N为每像素样本数，内层循环在编译期展开；N为0时按连续样本转换，
+     *          同类型时为memcpy。目标行紧密排列时整块作为一行处理
+     */
+    template<typename S, typename D, unsigned int N>
+    void convertKernel(const void* src, void* dst, unsigned long long rowSamples, unsigned long long rows, unsigned long long dstRowStride)
+    {
+        const S* in = static_cast<const S*>(src);
+        D* out = static_cast<D*>(dst);
+        if (dstRowStride == 0 || dstRowStride == rowSamples) {
+            rowSamples *= rows;
+            dstRowStride = rowSamples;
+            rows = 1;
+        }
+        for (unsigned long long y = 0; y < rows; ++y, in += rowSamples, out += dstRowStride) {
+            if (N == 0) {
+                PixelConversion::convertSamples(in, out, rowSamples);
+                continue;
+            }
+            const unsigned long long nrPixels = rowSamples / (N ? N : 1);
+            for (unsigned long long i = 0; i < nrPixels; ++i) {
+                for (unsigned int c = 0; c < N; ++c) {
+                    out[i * N + c] = static_cast<D>(in[i * N + c]);
+                }
+            }
+        }
+    }
+
+    /** @brief 数据类型数量，与SlideColorManagement::DataType的枚举值一致 */
+    const unsigned int kNumberOfDataTypes = 5;
+
+    /** @brief 专门展开内核的最大每像素样本数 */
+    const unsigned int kMaxUnrolledSamples = 4;
+
+    /**
+     * @brief 转换内核表
+     * @details 按[源类型][目标类型][每像素样本数]索引，样本数0为通用内核，无效类型为NULL
+     */
+    struct ConverterTable {
+        PixelConversion::SampleConverter kernels[kNumberOfDataTypes][kNumberOfDataTypes][kMaxUnrolledSamples + 1];
+
+        ConverterTable() : kernels() {
+            addSource<unsigned char>();
+            addSource<unsigned short>();
+            addSource<unsigned int>();
+            addSource<float>();
+        }
+
+        template<typename S> void addSource() {
+            addPair<S, unsigned char>();
+            addPair<S, unsigned short>();
+            addPair<S, unsigned int>();
+            addPair<S, float>();
+        }
+
+        template<typename S, typename D> void addPair() {
+            PixelConversion::SampleConverter* row = kernels[static_cast<unsigned int>(PixelConversion::SampleDataType<S>::value)]
+                [static_cast<unsigned int>(PixelConversion::SampleDataType<D>::value)];
+            row[0] = convertKernel<S, D, 0>;
+            // 同类型时各样本数都使用memcpy
+            const bool same = std::is_same<S, D>::value;
+            row[1] = same ? convertKernel<S, D, 0> : convertKernel<S, D, 1>;
+            row[2] = same ? convertKernel<S, D, 0> : convertKernel<S, D, 2>;
+            row[3] = same ? convertKernel<S, D, 0> : convertKernel<S, D, 3>;
+            row[4] = same ? convertKernel<S, D, 0> : convertKernel<S, D, 4>;
+        }
+    };
+
+    /**
+     * @brief 最近邻重采样
+     * @details 输出像素中心(d + 0.5)映射到源像素floor((d + 0.5) * src / dst)，用整数运算避免浮点误差
+     */
+    template<typename T>
+    void resampleNearest(const T* src, unsigned int srcWidth, unsigned int srcHeight, unsigned int samplesPerPixel,
+        T* dst, unsigned int dstWidth, unsigned int dstHeight)
+    {
+        std::vector<unsigned long long> columns(dstWidth);
+        for (unsigned int x = 0; x < dstWidth; ++x) {
+            const unsigned long long sx = (2ULL * x + 1) * srcWidth / (2ULL * dstWidth);
+            columns[x] = std::min<unsigned long long>(sx, srcWidth - 1) * samplesPerPixel;
+        }
+        const unsigned long long dstRowSamples = static_cast<unsigned long long>(dstWidth) * samplesPerPixel;
+        unsigned long long previousRow = srcHeight;
+        for (unsigned int y = 0; y < dstHeight; ++y) {
+            const unsigned long long sy = std::min<unsigned long long>((2ULL * y + 1) * srcHeight / (2ULL * dstHeight), srcHeight - 1);
+            T* row = dst + y * dstRowSamples;
+            if (sy == previousRow) {
+                std::memcpy(row, row - dstRowSamples, dstRowSamples * sizeof(T));
+                continue;
+            }
+            const T* in = src + sy * srcWidth * samplesPerPixel;
+            if (samplesPerPixel == 1) {
+                for (unsigned int x = 0; x < dstWidth; ++x) {
+                    row[x] = in[columns[x]];
+                }
+            }
+            else {
+                for (unsigned int x = 0; x < dstWidth; ++x) {
+                    std::memcpy(row + x * samplesPerPixel, in + columns[x], samplesPerPixel * sizeof(T));
+                }
+            }
+            previousRow = sy;
+        }
+    }
+
+    /**
+     * @brief 双线性插值的一个抽头
+     */
+    struct BilinearTap {
+        unsigned int first;     ///< 第一个源像素
+        unsigned int second;    ///< 第二个源像素
+        float weight;           ///< 第二个源像素的权重
+    };
+
+    /**
+     * @brief 计算双线性抽头
+     * @details 源坐标为(d + 0.5) * src / dst - 0.5，超出边缘时取边缘像素
+     */
+    std::vector<BilinearTap> bilinearTaps(unsigned int srcSize, unsigned int dstSize)
+    {
+        std::vector<BilinearTap> taps(dstSize);
+        const double scale = static_cast<double>(srcSize) / dstSize;
+        for (unsigned int d = 0; d < dstSize; ++d) {
+            double s = (d + 0.5) * scale - 0.5;
+            s = std::max(0., std::min(s, static_cast<double>(srcSize - 1)));
+            const unsigned int first = static_cast<unsigned int>(s);
+            taps[d].first = first;
+            taps[d].second = std::min(first + 1, srcSize - 1);
+            taps[d].weight = static_cast<float>(s - first);
+        }
+        return taps;
+    }
+
+    /**
+     * @brief 浮点样本写回目标类型，整数类型四舍五入并饱和
+     * @details 在double中比较，uint32的最大值在float中会进位到2^32；NaN写为0。
+     *          只有落在目标范围内的值才做static_cast，超出范围的转换是未定义行为
+     */
+    template<typename T>
+    void storeSamples(const float* in, T* out, unsigned long long count, std::true_type)
+    {
+        const double maxValue = static_cast<double>(std::numeric_limits<T>::max());
+        for (unsigned long long i = 0; i < count; ++i) {
+            const double value = static_cast<double>(in[i]) + 0.5;
+            if (!(value > 0.)) {
+                out[i] = 0;
+            }
+            else if (value >= maxValue) {
+                out[i] = std::numeric_limits<T>::max();
+            }
+            else {
+                out[i] = static_cast<T>(value);
+            }
+        }
+    }
+
+    template<typename T>
+    void storeSamples(const float* in, T* out, unsigned long long count, std::false_type)
+    {
+        for (unsigned long long i = 0; i < count; ++i) {
+            out[i] = static_cast<T>(in[i]);
+        }
+    }
+
+    /**
+     * @brief 双线性重采样
+     * @details 保留最近两个水平插值后的源行，向下推进时复用，每个源行只水平插值一次
+     */
+    template<typename T>
+    void resampleBilinear(const T* src, unsigned int srcWidth, unsigned int srcHeight, unsigned int samplesPerPixel,
+        T* dst, unsigned int dstWidth, unsigned int dstHeight)
+    {
+        static const BlendRowsKernel blendRows = selectBlendRowsKernel();
+        const std::vector<BilinearTap> columns = bilinearTaps(srcWidth, dstWidth);
+        const std::vector<BilinearTap> rows = bilinearTaps(srcHeight, dstHeight);
+        const unsigned long long rowSamples = static_cast<unsigned long long>(dstWidth) * samplesPerPixel;
+        std::vector<float> horizontal[2] = { std::vector<float>(rowSamples), std::vector<float>(rowSamples) };
+        std::vector<float> blended(rowSamples);
+        unsigned int cached[2] = { srcHeight, srcHeight };
+
+        auto interpolateRow = [&](unsigned int sy, std::vector<float>& out) {
+            const T* in = src + static_cast<unsigned long long>(sy) * srcWidth * samplesPerPixel;
+            for (unsigned int x = 0; x < dstWidth; ++x) {
+                const T* first = in + columns[x].first * samplesPerPixel;
+                const T* second = in + columns[x].second * samplesPerPixel;
+                const float weight = columns[x].weight;
+                for (unsigned int c = 0; c < samplesPerPixel; ++c) {
+                    const float a = static_cast<float>(first[c]);
+                    out[x * samplesPerPixel + c] = a + (static_cast<float>(second[c]) - a) * weight;
+                }
+            }
+        };
+
+        for (unsigned int y = 0; y < dstHeight; ++y) {
+            const BilinearTap& tap = rows[y];
+            if (cached[0] != tap.first) {
+                if (cached[1] == tap.first) {
+                    std::swap(horizontal[0], horizontal[1]);
+                    std::swap(cached[0], cached[1]);
+                }
+                else {
+                    interpolateRow(tap.first, horizontal[0]);
+                    cached[0] = tap.first;
+                }
+            }
+            if (cached[1] != tap.second) {
+                interpolateRow(tap.second, horizontal[1]);
+                cached[1] = tap.second;
+            }
+            blendRows(horizontal[0].data(), horizontal[1].data(), tap.weight, blended.data(), rowSamples);
+            storeSamples(blended.data(), dst + y * rowSamples, rowSamples, std::is_integral<T>());
+        }
+    }
+
+    /**
+     * @brief 通道最小值/最大值内核类型
+     * @details mins和maxs由调用者初始化，内核只在其上合并
+     */
+    template<typename T>
+    struct MinMaxKernel {
+        typedef void (*Type)(const T* data, unsigned long long nrPixels, unsigned int samplesPerPixel, T* mins, T* maxs);
+    };
+
+    /**
+     * @brief 通道最小值/最大值标量内核
+     * @details 比较顺序使NaN被忽略
+     */
+    template<typename T>
+    void minMaxScalar(const T* data, unsigned long long nrPixels, unsigned int samplesPerPixel, T* mins, T* maxs)
+    {
+        for (unsigned long long i = 0; i < nrPixels; ++i) {
+            for (unsigned int c = 0; c < samplesPerPixel; ++c, ++data) {
+                const T value = *data;
+                if (value < mins[c]) {
+                    mins[c] = value;
+                }
+                if (value > maxs[c]) {
+                    maxs[c] = value;
+                }
+            }
+        }
+    }
+
+#if defined(PIXEL_CONVERSION_X86)
+    /** @brief AVX2最小值/最大值内核支持的最大每像素样本数 */
+    const unsigned int kMaxMinMaxSamples = 8;
+
+    /**
+     * @brief 按样本类型封装的AVX2最小值/最大值操作
+     */
+    template<typename T>
+    struct MinMaxVector;
+
+    template<>
+    struct MinMaxVector<unsigned char> {
+        typedef __m256i Type;
+        static const unsigned int kLanes = 32;
+        static TARGET_AVX2 Type load(const unsigned char* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+        static TARGET_AVX2 Type fill(unsigned char v) { return _mm256_set1_epi8(static_cast<char>(v)); }
+        static TARGET_AVX2 Type min(Type v, Type acc) { return _mm256_min_epu8(v, acc); }
+        static TARGET_AVX2 Type max(Type v, Type acc) { return _mm256_max_epu8(v, acc); }
+        static TARGET_AVX2 void store(unsigned char* p, Type v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+    };
+
+    template<>
+    struct MinMaxVector<unsigned short> {
+        typedef __m256i Type;
+        static const unsigned int kLanes = 16;
+        static TARGET_AVX2 Type load(const unsigned short* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+        static TARGET_AVX2 Type fill(unsigned short v) { return _mm256_set1_epi16(static_cast<short>(v)); }
+        static TARGET_AVX2 Type min(Type v, Type acc) { return _mm256_min_epu16(v, acc); }
+        static TARGET_AVX2 Type max(Type v, Type acc) { return _mm256_max_epu16(v, acc); }
+        static TARGET_AVX2 void store(unsigned short* p, Type v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+    };
+
+    template<>
+    struct MinMaxVector<unsigned int> {
+        typedef __m256i Type;
+        static const unsigned int kLanes = 8;
+        static TARGET_AVX2 Type load(const unsigned int* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+        static TARGET_AVX2 Type fill(unsigned int v) { return _mm256_set1_epi32(static_cast<int>(v)); }
+        static TARGET_AVX2 Type min(Type v, Type acc) { return _mm256_min_epu32(v, acc); }
+        static TARGET_AVX2 Type max(Type v, Type acc) { return _mm256_max_epu32(v, acc); }
+        static TARGET_AVX2 void store(unsigned int* p, Type v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+    };
+
+    template<>
+    struct MinMaxVector<float> {
+        typedef __m256 Type;
+        static const unsigned int kLanes = 8;
+        static TARGET_AVX2 Type load(const float* p) { return _mm256_loadu_ps(p); }
+        static TARGET_AVX2 Type fill(float v) { return _mm256_set1_ps(v); }
+        // MINPS/MAXPS在任一操作数为NaN时返回第二个操作数，累加值放在第二个操作数上以忽略NaN
+        static TARGET_AVX2 Type min(Type v, Type acc) { return _mm256_min_ps(v, acc); }
+        static TARGET_AVX2 Type max(Type v, Type acc) { return _mm256_max_ps(v, acc); }
+        static TARGET_AVX2 void store(float* p, Type v) { _mm256_storeu_ps(p, v); }
+    };
+
+    /**
+     * @brief 通道最小值/最大值AVX2内核
+     * @details 每次处理samplesPerPixel个向量，共kLanes个像素；第j个累加向量的第k个分量
+     *          对应通道(j * kLanes + k) % samplesPerPixel，只在最后按通道归约一次。
+     *          一次遍历同时得到所有通道的最小值和最大值，余下的像素使用标量内核
+     */
+    template<typename T>
+    TARGET_AVX2 void minMaxAVX2(const T* data, unsigned long long nrPixels, unsigned int samplesPerPixel, T* mins, T* maxs)
+    {
+        typedef MinMaxVector<T> V;
+        unsigned long long pixel = 0;
+        if (samplesPerPixel <= kMaxMinMaxSamples && nrPixels >= V::kLanes) {
+            typename V::Type lo[kMaxMinMaxSamples], hi[kMaxMinMaxSamples];
+            for (unsigned int j = 0; j < samplesPerPixel; ++j) {
+                lo[j] = V::fill(std::numeric_limits<T>::max());
+                hi[j] = V::fill(std::numeric_limits<T>::lowest());
+            }
+            for (; pixel + V::kLanes <= nrPixels; pixel += V::kLanes) {
+                const T* group = data + pixel * samplesPerPixel;
+                for (unsigned int j = 0; j < samplesPerPixel; ++j) {
+                    const typename V::Type v = V::load(group + j * V::kLanes);
+                    lo[j] = V::min(v, lo[j]);
+                    hi[j] = V::max(v, hi[j]);
+                }
+            }
+            T lanes[V::kLanes];
+            for (unsigned int j = 0; j < samplesPerPixel; ++j) {
+                V::store(lanes, lo[j]);
+                for (unsigned int k = 0; k < V::kLanes; ++k) {
+                    T& m = mins[(j * V::kLanes + k) % samplesPerPixel];
+                    m = lanes[k] < m ? lanes[k] : m;
+                }
+                V::store(lanes, hi[j]);
+                for (unsigned int k = 0; k < V::kLanes; ++k) {
+                    T& m = maxs[(j * V::kLanes + k) % samplesPerPixel];
+                    m = lanes[k] > m ? lanes[k] : m;
+                }
+            }
+        }
+        minMaxScalar(data + pixel * samplesPerPixel, nrPixels - pixel, samplesPerPixel, mins, maxs);
+    }
+#endif
+
+    /**
+     * @brief 选择通道最小值/最大值内核
+     */
+    template<typename T>
+    typename MinMaxKernel<T>::Type selectMinMaxKernel()
+    {
+#if defined(PIXEL_CONVERSION_X86)
+        if (cpuSupportsAVX2()) {
+            return &minMaxAVX2<T>;
+        }
+#endif
+        return &minMaxScalar<T>;
+    }
+}
+
+namespace PixelConversion {
+
+    SampleConverter sampleConverter(SlideColorManagement::DataType source, SlideColorManagement::DataType destination, unsigned int samplesPerPixel)
+    {
+        static const ConverterTable table;
+        const unsigned int s = static_cast<unsigned int>(source);
+        const unsigned int d = static_cast<unsigned int>(destination);
+        if (s >= kNumberOfDataTypes || d >= kNumberOfDataTypes) {
+            return NULL;
+        }
+        return table.kernels[s][d][samplesPerPixel <= kMaxUnrolledSamples ? samplesPerPixel : 0];
+    }
+
+
+    void premultipliedBGRAToRGB(const unsigned char* bgra, unsigned char* rgb, unsigned long long nrPixels,
+        unsigned char bgR, unsigned char bgG, unsigned char bgB)
+    {
+        const unsigned char bg[3] = { bgR, bgG, bgB };
+        kernelSelection().kernel(bgra, rgb, nrPixels, bg);
+    }
+
+    template<typename T>
+    void windowLevelToARGB32(const T* data, unsigned long long nrPixels, unsigned int channel, unsigned int samplesPerPixel,
+        double windowMin, double windowMax, const unsigned int* palette, unsigned int* argb)
+    {
+        static const typename WindowLevelKernel<T>::Type kernel = selectWindowLevelKernel<T>();
+        float scale = windowMax > windowMin ? static_cast<float>(255. / (windowMax - windowMin)) : FLT_MAX;
+        kernel(data + channel, nrPixels, samplesPerPixel, static_cast<float>(windowMin), scale, palette, argb);
+    }
+
+    template void windowLevelToARGB32<unsigned char>(const unsigned char*, unsigned long long, unsigned int, unsigned int, double, double, const unsigned int*, unsigned int*);
+    template void windowLevelToARGB32<unsigned short>(const unsigned short*, unsigned long long, unsigned int, unsigned int, double, double, const unsigned int*, unsigned int*);
+    template void windowLevelToARGB32<unsigned int>(const unsigned int*, unsigned long long, unsigned int, unsigned int, double, double, const unsigned int*, unsigned int*);
+    template void windowLevelToARGB32<float>(const float*, unsigned long long, unsigned int, unsigned int, double, double, const unsigned int*, unsigned int*);
+
+    void buildCompositeChannel(CompositeChannel& out, unsigned int channel, double windowMin, double windowMax, float gamma,
+        unsigned char r, unsigned char g, unsigned char b)
+    {
+        out.channel = channel;
+        out.offset = static_cast<float>(windowMin);
+        out.scale = windowMax > windowMin ? static_cast<float>(255. / (windowMax - windowMin)) : FLT_MAX;
+        double exponent = gamma > 0.f ? gamma : 1.;
+        for (unsigned int level = 0; level < 256; ++level) {
+            double intensity = std::pow(level / 255., exponent);
+            unsigned long long red = static_cast<unsigned long long>(intensity * r + 0.5);
+            unsigned long long green = static_cast<unsigned long long>(intensity * g + 0.5);
+            unsigned long long blue = static_cast<unsigned long long>(intensity * b + 0.5);
+            out.contribution[level] = blue | (green << 16) | (red << 32);
+        }
+    }
+
+    template<typename T>
+    void compositeChannelsToARGB32(const T* data, unsigned long long nrPixels, unsigned int samplesPerPixel,
+        const CompositeChannel* channels, unsigned int nrChannels, unsigned int* argb)
+    {
+        for (unsigned long long i = 0; i < nrPixels; ++i, data += samplesPerPixel) {
+            unsigned long long sum = 0;
+            for (unsigned int c = 0; c < nrChannels; ++c) {
+                const CompositeChannel& channel = channels[c];
+                // 与windowLevelScalar相同的比较顺序，NaN映射为255
+                float level = (static_cast<float>(data[channel.channel]) - channel.offset) * channel.scale;
+                level = level < 255.f ? level : 255.f;
+                level = level > 0.f ? level : 0.f;
+                sum += channel.contribution[static_cast<unsigned int>(level)];
+            }
+            unsigned int blue = std::min<unsigned int>(static_cast<unsigned int>(sum & 0xFFFF), 255u);
+            unsigned int green = std::min<unsigned int>(static_cast<unsigned int>((sum >> 16) & 0xFFFF), 255u);
+            unsigned int red = std::min<unsigned int>(static_cast<unsigned int>((sum >> 32) & 0xFFFF), 255u);
+            argb[i] = 0xFF000000u | (red << 16) | (green << 8) | blue;
+        }
+    }
+
+    template void compositeChannelsToARGB32<unsigned char>(const unsigned char*, unsigned long long, unsigned int, const CompositeChannel*, unsigned int, unsigned int*);
+    template void compositeChannelsToARGB32<unsigned short>(const unsigned short*, unsigned long long, unsigned int, const CompositeChannel*, unsigned int, unsigned int*);
+    template void compositeChannelsToARGB32<unsigned int>(const unsigned int*, unsigned long long, unsigned int, const CompositeChannel*, unsigned int, unsigned int*);
+    template void compositeChannelsToARGB32<float>(const float*, unsigned long long, unsigned int, const CompositeChannel*, unsigned int, unsigned int*);
+
+    void buildEnhancement(Enhancement& out, float sharpness, float gamma, float brightness, float contrast)
+    {
+        const double amount = std::max(-1., std::min(static_cast<double>(sharpness), 2.));
+        out.sharpness = static_cast<int>(std::lround(amount * 4096.));
+        const double exponent = gamma > 0.f ? gamma : 1.;
+        out.identityLUT = true;
+        for (unsigned int level = 0; level < 256; ++level) {
+            double value = (std::pow(level / 255., exponent) - 0.5) * contrast + 0.5 + brightness;
+            value = std::max(0., std::min(value, 1.));
+            out.lut[level] = static_cast<unsigned char>(value * 255. + 0.5);
+            out.identityLUT = out.identityLUT && out.lut[level] == level;
+        }
+    }
+
+    void enhanceARGB32(unsigned int* argb, unsigned int width, unsigned int height, unsigned int rowStride, const Enhancement& enhancement)
+    {
+        if (!argb || width == 0 || height == 0 || isIdentity(enhancement)) {
+            return;
+        }
+        static const SharpenRowKernel sharpenRow = selectSharpenRowKernel();
+        const unsigned long long rowBytes = static_cast<unsigned long long>(width) * 4;
+        // 三行水平和轮换使用：计算第y行之前先求第y+1行的和，因此可以就地写回
+        std::vector<unsigned short> sums(enhancement.sharpness != 0 ? rowBytes * 3 : 0);
+        unsigned short* above = sums.empty() ? NULL : sums.data();
+        unsigned short* middle = sums.empty() ? NULL : sums.data() + rowBytes;
+        unsigned short* below = sums.empty() ? NULL : sums.data() + rowBytes * 2;
+        if (middle) {
+            horizontalGaussianRow(reinterpret_cast<const unsigned char*>(argb), width, middle);
+            std::memcpy(above, middle, rowBytes * sizeof(unsigned short));
+        }
+        for (unsigned int y = 0; y < height; ++y) {
+            unsigned char* row = reinterpret_cast<unsigned char*>(argb + static_cast<unsigned long long>(y) * rowStride);
+            if (middle) {
+                if (y + 1 < height) {
+                    horizontalGaussianRow(reinterpret_cast<const unsigned char*>(argb + static_cast<unsigned long long>(y + 1) * rowStride), width, below);
+                }
+                else {
+                    std::memcpy(below, middle, rowBytes * sizeof(unsigned short));
+                }
+                sharpenRow(row, above, middle, below, static_cast<short>(enhancement.sharpness), row, rowBytes);
+                std::swap(above, middle);
+                std::swap(middle, below);
+            }
+            if (!enhancement.identityLUT) {
+                for (unsigned long long i = 0; i < rowBytes; i += 4) {
+                    const unsigned char alpha = row[i + 3];
+                    for (unsigned int k = 0; k < 3; ++k) {
+                        row[i + k] = std::min(enhancement.lut[row[i + k]], alpha);
+                    }
+                }
+            }
+        }
+    }
+
+    void buildColorLUT3D(ColorLUT3D& out, const std::function<void(const double* rgb, double* result)>& transform)
+    {
+        const unsigned int n = ColorLUT3D::kGridSize;
+        for (unsigned int v = 0; v < 256; ++v) {
+            const unsigned int position = v * (n - 1);
+            unsigned int index = position / 255;
+            unsigned int fraction = ((position % 255) * 256 + 127) / 255;
+            if (index >= n - 1) {
+                index = n - 2;
+                fraction = 256;
+            }
+            out.cells[v] = index << 9 | fraction;
+        }
+        out.nodes.resize(static_cast<size_t>(n) * n * n);
+        for (unsigned int r = 0; r < n; ++r) {
+            for (unsigned int g = 0; g < n; ++g) {
+                for (unsigned int b = 0; b < n; ++b) {
+                    const double rgb[3] = { r / (n - 1.), g / (n - 1.), b / (n - 1.) };
+                    double result[3] = { rgb[0], rgb[1], rgb[2] };
+                    transform(rgb, result);
+                    unsigned int node = 0;
+                    for (unsigned int c = 0; c < 3; ++c) {
+                        const double value = std::max(0., std::min(result[c], 1.));
+                        node |= static_cast<unsigned int>(value * 1020. + 0.5) << (20 - c * 10);
+                    }
+                    out.nodes[(static_cast<size_t>(r) * n + g) * n + b] = node;
+                }
+            }
+        }
+    }
+
+    bool isIdentity(const ColorLUT3D& lut)
+    {
+        const unsigned int n = ColorLUT3D::kGridSize;
+        if (lut.nodes.size() != static_cast<size_t>(n) * n * n) {
+            return false;
+        }
+        for (size_t i = 0; i < lut.nodes.size(); ++i) {
+            const unsigned int coordinates[3] = { static_cast<unsigned int>(i / (n * n)), static_cast<unsigned int>(i / n % n), static_cast<unsigned int>(i % n) };
+            for (unsigned int c = 0; c < 3; ++c) {
+                const int expected = static_cast<int>(coordinates[c] * 1020. / (n - 1) + 0.5);
+                const int value = static_cast<int>((lut.nodes[i] >> (20 - c * 10)) & 1023);
+                if (std::abs(value - expected) > 4) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void applyColorLUT3D(unsigned int* argb, unsigned long long nrPixels, const ColorLUT3D& lut)
+    {
+        if (!argb || lut.nodes.size() != static_cast<size_t>(ColorLUT3D::kGridSize) * ColorLUT3D::kGridSize * ColorLUT3D::kGridSize) {
+            return;
+        }
+        static const ColorLUTKernel kernel = selectColorLUTKernel();
+        kernel(argb, nrPixels, lut.cells, lut.nodes.data());
+    }
+
+    template<typename T>
+    void resample(const T* src, unsigned int srcWidth, unsigned int srcHeight, unsigned int samplesPerPixel,
+        T* dst, unsigned int dstWidth, unsigned int dstHeight, Interpolation interpolation)
+    {
+        if (srcWidth == 0 || srcHeight == 0 || dstWidth == 0 || dstHeight == 0 || samplesPerPixel == 0) {
+            return;
+        }
+        if (interpolation == Bilinear) {
+            resampleBilinear(src, srcWidth, srcHeight, samplesPerPixel, dst, dstWidth, dstHeight);
+        }
+        else {
+            resampleNearest(src, srcWidth, srcHeight, samplesPerPixel, dst, dstWidth, dstHeight);
+        }
+    }
+
+    template void resample<unsigned char>(const unsigned char*, unsigned int, unsigned int, unsigned int, unsigned char*, unsigned int, unsigned int, Interpolation);
+    template void resample<unsigned short>(const unsigned short*, unsigned int, unsigned int, unsigned int, unsigned short*, unsigned int, unsigned int, Interpolation);
+    template void resample<unsigned int>(const unsigned int*, unsigned int, unsigned int, unsigned int, unsigned int*, unsigned int, unsigned int, Interpolation);
+    template void resample<float>(const float*, unsigned int, unsigned int, unsigned int, float*, unsigned int, unsigned int, Interpolation);
+
+    template<typename T>
+    void channelMinMax(const T* data, unsigned long long nrPixels, unsigned int samplesPerPixel, double* minValues, double* maxValues)
+    {
+        static const typename MinMaxKernel<T>::Type kernel = selectMinMaxKernel<T>();
+        std::vector<T> mins(samplesPerPixel, std::numeric_limits<T>::max());
+        std::vector<T> maxs(samplesPerPixel, std::numeric_limits<T>::lowest());
+        kernel(data, nrPixels, samplesPerPixel, mins.data(), maxs.data());
+        for (unsigned int c = 0; c < samplesPerPixel; ++c) {
+            minValues[c] = mins[c];
+            maxValues[c] = maxs[c];
+        }
+    }
+
+    template void channelMinMax<unsigned char>(const unsigned char*, unsigned long long, unsigned int, double*, double*);
+    template void channelMinMax<unsigned short>(const unsigned short*, unsigned long long, unsigned int, double*, double*);
+    template void channelMinMax<unsigned int>(const unsigned int*, unsigned long long, unsigned int, double*, double*);
+    template void channelMinMax<float>(const float*, unsigned long long, unsigned int, double*, double*);
+
+    const char* activeKernelName()
+    {
+        return kernelSelection().name;
+    }
+}
@@ -0,0 +1,416 @@
+﻿/**
+ * @file    PixelConversion.h
+ * @brief   像素格式转换内核，提供带SIMD加速的预乘BGRA到RGB转换
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件声明了瓦片读取路径上使用的像素格式转换函数：
+ *          - 预乘BGRA（OpenSlide原生输出）到RGB888的反预乘转换
+ *          - 单色/多通道数据按窗宽窗位映射到ARGB32，可选256色调色板
+ *          - 荧光多通道数据按通道颜色、窗口和伽马一次遍历加性合成到ARGB32
+ *          - 原始样本在数据类型之间的转换：按（源类型，目标类型，每像素样本数）实例化的内核表，
+ *            每个图像初始化时解析一次，之后通过函数指针调用
+ *          - 前景叠加层在查表之前的最近邻/双线性重采样
+ *          - 显示瓦片的后处理增强：3x3高斯反锐化掩模（或平滑）加亮度/对比度/伽马查找表
+ *          - 按预编译3D查找表（四面体插值）的颜色管理，用于把切片ICC配置文件转换到sRGB显示
+ *          - 交错样本各通道最小值/最大值的单次遍历统计
+ *          - 运行时根据CPU能力选择AVX2/SSE4.1/NEON内核，否则使用标量实现
+ *          各内核对不透明、全透明（填充背景色）和半透明三种像素给出完全一致的结果，
+ *          半透明像素按 c * 255 / a 截断并限制在255以内。
+ *
+ * @note    所有函数都是线程安全的，支持多线程并发调用
+ * @see     OpenSlideImage
+ */
+
+#pragma once
+
+#include "SlideColorManagement.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+namespace PixelConversion {
+
+    /**
+     * @brief   原始样本类型转换
+     * @details 同类型时直接内存复制，否则逐个样本static_cast。
+     *          与getRawRegion历史上的转换结果一致（浮点数转整数按截断处理）
+     *
+     * @tparam  S 源样本类型
+     * @tparam  D 目标样本类型
+     * @param   src 源样本
+     * @param   dst 目标样本，调用者负责分配count个样本
+     * @param   count 样本数量
+     */
+    template<typename S, typename D>
+    inline void convertSamples(const S* src, D* dst, unsigned long long count, std::true_type) {
+        std::memcpy(dst, src, count * sizeof(S));
+    }
+
+    template<typename S, typename D>
+    inline void convertSamples(const S* src, D* dst, unsigned long long count, std::false_type) {
+        std::transform(src, src + count, dst, [](S a) { return static_cast<D>(a); });
+    }
+
+    template<typename S, typename D>
+    inline void convertSamples(const S* src, D* dst, unsigned long long count) {
+        convertSamples(src, dst, count, std::is_same<S, D>());
+    }
+
+    /**
+     * @brief   按行转换样本到带行跨距的缓冲区
+     * @tparam  S 源样本类型
+     * @tparam  D 目标样本类型
+     * @param   src 紧密排列的源样本
+     * @param   dst 目标缓冲区
+     * @param   rowSamples 每行样本数（宽度乘以每像素样本数）
+     * @param   rows 行数
+     * @param   dstRowStride 目标每行的样本跨距，为0或等于rowSamples时按紧密排列一次转换
+     */
+    template<typename S, typename D>
+    inline void convertRows(const S* src, D* dst, unsigned long long rowSamples, unsigned long long rows, unsigned long long dstRowStride) {
+        if (dstRowStride == 0 || dstRowStride == rowSamples) {
+            convertSamples(src, dst, rowSamples * rows);
+            return;
+        }
+        for (unsigned long long y = 0; y < rows; ++y) {
+            convertSamples(src + y * rowSamples, dst + y * dstRowStride, rowSamples);
+        }
+    }
+
+    /**
+     * @brief   样本类型对应的数据类型
+     * @tparam  T 样本类型，不支持的类型为InvalidDataType
+     */
+    template<typename T>
+    struct SampleDataType {
+        static const SlideColorManagement::DataType value = SlideColorManagement::DataType::InvalidDataType;
+    };
+
+    template<> struct SampleDataType<unsigned char> {
+        static const SlideColorManagement::DataType value = SlideColorManagement::DataType::UChar;
+    };
+
+    template<> struct SampleDataType<unsigned short> {
+        static const SlideColorManagement::DataType value = SlideColorManagement::DataType::UInt16;
+    };
+
+    template<> struct SampleDataType<unsigned int> {
+        static const SlideColorManagement::DataType value = SlideColorManagement::DataType::UInt32;
+    };
+
+    template<> struct SampleDataType<float> {
+        static const SlideColorManagement::DataType value = SlideColorManagement::DataType::Float;
+    };
+
+    /**
+     * @brief   样本转换内核
+     * @param   src 紧密排列的源样本
+     * @param   dst 目标缓冲区
+     * @param   rowSamples 每行样本数
+     * @param   rows 行数
+     * @param   dstRowStride 目标每行的样本跨距，0表示紧密排列
+     * @see     sampleConverter, convertRows
+     */
+    typedef void (*SampleConverter)(const void* src, void* dst, unsigned long long rowSamples, unsigned long long rows, unsigned long long dstRowStride);
+
+    /**
+     * @brief   查找样本转换内核
+     * @details 内核表按（源类型，目标类型，每像素样本数）为每种组合实例化一个模板，
+     *          每像素样本数1-4的内核内层循环在编译期展开，其余样本数使用通用内核；
+     *          源类型与目标类型相同时为memcpy。与convertRows的结果完全一致
+     *
+     * @param   source 源数据类型
+     * @param   destination 目标数据类型
+     * @param   samplesPerPixel 每像素样本数
+     * @return  转换内核，任一类型无效时返回NULL
+     * @note    查表本身很廉价，但应在图像初始化时解析一次并保存，见MultiResolutionImage::initialize
+     * @example
+     *          // 使用示例
+     *          PixelConversion::SampleConverter convert = PixelConversion::sampleConverter(
+     *              SlideColorManagement::DataType::UInt16, SlideColorManagement::DataType::Float, 3);
+     *          convert(src, dst, width * 3, height, 0);
+     */
+    SampleConverter sampleConverter(SlideColorManagement::DataType source, SlideColorManagement::DataType destination, unsigned int samplesPerPixel);
+
+    /**
+     * @brief   预乘BGRA转换为RGB888
+     * @details 将OpenSlide输出的预乘BGRA像素（小端序ARGB32）反预乘并转换为紧密排列的RGB888。
+     *          alpha为255的像素直接交换通道顺序，alpha为0的像素使用背景色，
+     *          其余像素按 c * 255 / a 反预乘。
+     *
+     * @param   bgra 输入像素，每像素4字节
+     * @param   rgb 输出像素，每像素3字节，调用者负责分配nrPixels*3字节
+     * @param   nrPixels 像素数量
+     * @param   bgR 背景色红色分量
+     * @param   bgG 背景色绿色分量
+     * @param   bgB 背景色蓝色分量
+     * @note    首次调用时检测CPU能力并缓存所选内核
+     * @see     activeKernelName
+     * @example
+     *          // 使用示例
+     *          unsigned char* rgb = new unsigned char[width * height * 3];
+     *          PixelConversion::premultipliedBGRAToRGB((unsigned char*)argb, rgb, width * height, 255, 255, 255);
+     */
+    void premultipliedBGRAToRGB(const unsigned char* bgra, unsigned char* rgb, unsigned long long nrPixels,
+        unsigned char bgR, unsigned char bgG, unsigned char bgB);
+
+    /**
+     * @brief   窗宽窗位映射到ARGB32
+     * @details 取交错数据中的一个通道，按 (v - windowMin) * 255 / (windowMax - windowMin)
+     *          截断并限制到0-255得到灰阶，再生成ARGB32像素：
+     *          palette为空时输出不透明灰度，否则输出palette[灰阶]。
+     *          输出可直接写入QImage::Format_ARGB32_Premultiplied的扫描行。
+     *
+     * @tparam  T 像素数据类型，支持unsigned char、unsigned short、unsigned int、float
+     * @param   data 输入数据，每像素samplesPerPixel个交错样本
+     * @param   nrPixels 像素数量
+     * @param   channel 使用的通道索引
+     * @param   samplesPerPixel 每像素样本数，1-4有专门展开的内核
+     * @param   windowMin 窗口下限，映射为灰阶0
+     * @param   windowMax 窗口上限，映射为灰阶255；不大于windowMin时按windowMin阈值化
+     * @param   palette 256项预乘ARGB32调色板，可为nullptr
+     * @param   argb 输出像素，调用者负责分配nrPixels个32位像素
+     * @note    NaN映射为灰阶255，与applyLUT对超出范围值取最后一个颜色的行为一致。
+     *          AVX2内核使用gather查调色板；NEON平台使用标量实现
+     * @see     convertMonochromeToRGB
+     * @example
+     *          // 使用示例
+     *          QImage img(512, 512, QImage::Format_ARGB32_Premultiplied);
+     *          PixelConversion::windowLevelToARGB32(data, 512 * 512, 0, 1, minValue, maxValue, nullptr, reinterpret_cast<unsigned int*>(img.bits()));
+     */
+    template<typename T>
+    void windowLevelToARGB32(const T* data, unsigned long long nrPixels, unsigned int channel, unsigned int samplesPerPixel,
+        double windowMin, double windowMax, const unsigned int* palette, unsigned int* argb);
+
+    /**
+     * @struct  CompositeChannel
+     * @brief   编译后的单通道合成参数
+     * @details 由buildCompositeChannel生成。contribution按灰阶存放该通道对B、G、R的贡献，
+     *          每个分量占一个16位字段（位0、16、32），合成时各通道的贡献直接整数相加，
+     *          不会在不超过257个通道时溢出
+     */
+    struct CompositeChannel {
+        /** @brief 使用的通道索引 */
+        unsigned int channel;
+
+        /** @brief 窗口下限 */
+        float offset;
+
+        /** @brief 灰阶缩放，255 / (windowMax - windowMin) */
+        float scale;
+
+        /** @brief 灰阶到颜色贡献的表 */
+        unsigned long long contribution[256];
+    };
+
+    /**
+     * @brief   编译单通道合成参数
+     * @details 按窗宽窗位得到灰阶l后，该通道的显示强度为 (l / 255) ^ gamma，
+     *          贡献为强度乘以通道颜色并四舍五入
+     *
+     * @param   out 输出的合成参数
+     * @param   channel 通道索引
+     * @param   windowMin 窗口下限
+     * @param   windowMax 窗口上限，不大于windowMin时按windowMin阈值化
+     * @param   gamma 伽马指数，不大于0时按1处理
+     * @param   r 通道颜色红色分量
+     * @param   g 通道颜色绿色分量
+     * @param   b 通道颜色蓝色分量
+     * @see     compositeChannelsToARGB32
+     */
+    void buildCompositeChannel(CompositeChannel& out, unsigned int channel, double windowMin, double windowMax, float gamma,
+        unsigned char r, unsigned char g, unsigned char b);
+
+    /**
+     * @brief   多通道加性合成到ARGB32
+     * @details 对每个像素依次累加各通道在其灰阶下的贡献，饱和到255后输出不透明像素。
+     *          每个像素的所有样本只读取一次，输出可直接写入QImage::Format_ARGB32_Premultiplied的扫描行
+     *
+     * @tparam  T 像素数据类型，支持unsigned char、unsigned short、unsigned int、float
+     * @param   data 输入数据，每像素samplesPerPixel个交错样本
+     * @param   nrPixels 像素数量
+     * @param   samplesPerPixel 每像素样本数
+     * @param   channels 参与合成的通道，通道索引必须小于samplesPerPixel
+     * @param   nrChannels 通道数量，为0时输出全黑
+     * @param   argb 输出像素，调用者负责分配nrPixels个32位像素
+     * @note    NaN映射为灰阶255，与windowLevelToARGB32一致
+     * @see     buildCompositeChannel, SlideColorManagement::ChannelDisplay
+     */
+    template<typename T>
+    void compositeChannelsToARGB32(const T* data, unsigned long long nrPixels, unsigned int samplesPerPixel,
+        const CompositeChannel* channels, unsigned int nrChannels, unsigned int* argb);
+
+    /**
+     * @struct  Enhancement
+     * @brief   编译后的瓦片增强参数
+     * @details 由buildEnhancement生成。锐化系数为定点数amount * 4096，
+     *          输出为 c + amount * (c - g)，g为3x3高斯（1-2-1）模糊；lut在锐化之后逐颜色分量查表
+     */
+    struct Enhancement {
+        /** @brief 锐化系数，amount * 4096；负值为平滑，-4096时输出高斯模糊结果 */
+        int sharpness;
+
+        /** @brief lut是否为恒等映射，为true时跳过查表 */
+        bool identityLUT;
+
+        /** @brief 颜色分量的亮度/对比度/伽马查找表 */
+        unsigned char lut[256];
+    };
+
+    /**
+     * @brief   编译瓦片增强参数
+     * @details 查找表按 x = (v / 255) ^ gamma，y = (x - 0.5) * contrast + 0.5 + brightness
+     *          限制到0-1后四舍五入到0-255，伽马的含义与buildCompositeChannel一致
+     *
+     * @param   out 输出的增强参数
+     * @param   sharpness 反锐化掩模强度，限制在-1到2之间，0为不锐化，负值为平滑
+     * @param   gamma 伽马指数，不大于0时按1处理
+     * @param   brightness 亮度偏移，按满量程的比例，0为不变
+     * @param   contrast 对比度，围绕0.5缩放，1为不变
+     * @see     enhanceARGB32, isIdentity
+     */
+    void buildEnhancement(Enhancement& out, float sharpness, float gamma, float brightness, float contrast);
+
+    /**
+     * @brief   判断增强参数是否不改变图像
+     * @param   enhancement 增强参数
+     * @return  不锐化且查找表为恒等映射时返回true
+     */
+    inline bool isIdentity(const Enhancement& enhancement) {
+        return enhancement.sharpness == 0 && enhancement.identityLUT;
+    }
+
+    /**
+     * @brief   就地增强ARGB32瓦片
+     * @details 每行先计算水平1-2-1和，再与上下两行组合成3x3高斯和，图像边缘按复制边界像素处理。
+     *          锐化在16位整数上计算，结果饱和到0-255；alpha不变，颜色分量不超过alpha，
+     *          因此预乘像素仍然有效（半透明像素的查找表按预乘值近似）。
+     *          锐化内核有AVX2和SSE4.1实现，各实现的结果完全一致
+     *
+     * @param   argb 瓦片像素，QImage::Format_ARGB32_Premultiplied或Format_RGB32
+     * @param   width 宽度
+     * @param   height 高度
+     * @param   rowStride 每行的像素跨距
+     * @param   enhancement 增强参数
+     * @note    1x1纯色瓦片只受查找表影响
+     * @example
+     *          // 使用示例
+     *          PixelConversion::Enhancement enhancement;
+     *          PixelConversion::buildEnhancement(enhancement, 0.8f, 1.f, 0.f, 1.2f);
+     *          PixelConversion::enhanceARGB32(reinterpret_cast<unsigned int*>(tile.bits()), tile.width(), tile.height(),
+     *              tile.bytesPerLine() / 4, enhancement);
+     */
+    void enhanceARGB32(unsigned int* argb, unsigned int width, unsigned int height, unsigned int rowStride, const Enhancement& enhancement);
+
+    /**
+     * @struct  ColorLUT3D
+     * @brief   编译后的RGB到RGB颜色变换3D查找表
+     * @details 由buildColorLUT3D生成，kGridSize^3个网格节点按(r * n + g) * n + b排列，
+     *          每个节点把输出的R、G、B以0-1020（8位值乘4）存放在位20、10、0开始的10位字段中。
+     *          cells按8位输入值给出所在格的起始索引（高位）和格内位置0-256（低9位）
+     */
+    struct ColorLUT3D {
+        /** @brief 每个方向的网格点数 */
+        static const unsigned int kGridSize = 33;
+
+        /** @brief 8位输入值所在的格：index << 9 | fraction */
+        unsigned int cells[256];
+
+        /** @brief 网格节点 */
+        std::vector<unsigned int> nodes;
+    };
+
+    /**
+     * @brief   编译颜色变换3D查找表
+     * @details 在每个网格点上调用一次transform，颜色变换本身（例如ICC配置文件求值）因此只在编译时执行
+     *
+     * @param   out 输出的查找表
+     * @param   transform 颜色变换，输入和输出均为0-1的R、G、B，输出超出范围时被限制
+     * @see     applyColorLUT3D, IccProfile::compileToSRGB
+     */
+    void buildColorLUT3D(ColorLUT3D& out, const std::function<void(const double* rgb, double* result)>& transform);
+
+    /**
+     * @brief   判断查找表是否近似恒等变换
+     * @param   lut 查找表
+     * @return  所有网格点与恒等变换的差不超过1个8位灰阶时返回true，例如sRGB配置文件
+     */
+    bool isIdentity(const ColorLUT3D& lut);
+
+    /**
+     * @brief   按3D查找表就地变换ARGB32像素
+     * @details 每个像素按格内位置的大小顺序选择格中的一个四面体，由4个节点插值，
+     *          插值在整数上进行并四舍五入。只变换不透明像素，半透明和透明像素保持不变。
+     *          AVX2内核使用gather每次处理8个像素，结果与标量实现完全一致
+     *
+     * @param   argb 像素，QImage::Format_ARGB32_Premultiplied或Format_RGB32，紧密排列
+     * @param   nrPixels 像素数量
+     * @param   lut 查找表
+     * @example
+     *          // 使用示例
+     *          PixelConversion::applyColorLUT3D(reinterpret_cast<unsigned int*>(tile.bits()), tile.width() * tile.height(), *lut);
+     */
+    void applyColorLUT3D(unsigned int* argb, unsigned long long nrPixels, const ColorLUT3D& lut);
+
+    /**
+     * @brief 重采样插值方式
+     */
+    enum Interpolation {
+        Nearest,    ///< 最近邻，用于标签图，不会产生原图中没有的标签值
+        Bilinear    ///< 双线性，用于概率图等连续值
+    };
+
+    /**
+     * @brief   重采样交错样本
+     * @details 按像素中心对齐（与QImage::scaled一致）把srcWidth x srcHeight的图像重采样到dstWidth x dstHeight，
+     *          每像素的所有样本一起处理：
+     *          - 最近邻预先计算列索引，相邻输出行来自同一源行时直接复制上一输出行
+     *          - 双线性按行分离，每个源行只水平插值一次并缓存，竖直插值在浮点行上由AVX2/SSE4.1/NEON内核完成，
+     *            整数类型四舍五入并饱和
+     *          32位预乘ARGB像素可作为unsigned int、每像素1个样本做最近邻重采样
+     *
+     * @tparam  T 样本类型，支持unsigned char、unsigned short、unsigned int、float
+     * @param   src 输入数据，紧密排列
+     * @param   srcWidth 输入宽度
+     * @param   srcHeight 输入高度
+     * @param   samplesPerPixel 每像素样本数
+     * @param   dst 输出数据，调用者负责分配dstWidth*dstHeight*samplesPerPixel个样本
+     * @param   dstWidth 输出宽度
+     * @param   dstHeight 输出高度
+     * @param   interpolation 插值方式
+     * @note    双线性在单精度浮点上计算，unsigned int样本超过2^24时有舍入误差
+     * @example
+     *          // 4倍放大标签图的渲染结果
+     *          PixelConversion::resample(reinterpret_cast<const unsigned int*>(small.constBits()), 128, 128, 1,
+     *              reinterpret_cast<unsigned int*>(tile.bits()), 512, 512, PixelConversion::Nearest);
+     */
+    template<typename T>
+    void resample(const T* src, unsigned int srcWidth, unsigned int srcHeight, unsigned int samplesPerPixel,
+        T* dst, unsigned int dstWidth, unsigned int dstHeight, Interpolation interpolation);
+
+    /**
+     * @brief   统计交错样本各通道的最小值和最大值
+     * @details 一次遍历同时得到所有通道的最小值和最大值；AVX2内核按通道交错的周期保持多个累加向量，
+     *          最后按通道归约，结果与标量实现完全相同。浮点NaN被忽略
+     *
+     * @tparam  T 样本类型，支持unsigned char、unsigned short、unsigned int、float
+     * @param   data 交错样本，紧密排列
+     * @param   nrPixels 像素数
+     * @param   samplesPerPixel 每像素样本数
+     * @param   minValues 输出各通道最小值，调用者分配samplesPerPixel个元素；没有有效样本时为类型最大值
+     * @param   maxValues 输出各通道最大值；没有有效样本时为类型最小值（lowest）
+     * @see     Patch::getMinValue
+     */
+    template<typename T>
+    void channelMinMax(const T* data, unsigned long long nrPixels, unsigned int samplesPerPixel, double* minValues, double* maxValues);
+
+    /**
+     * @brief   获取当前使用的转换内核名称
+     * @return  "AVX2"、"SSE4.1"、"NEON"或"Scalar"
+     * @note    用于日志和性能分析
+     */
+    const char* activeKernelName();
+}
@@ -0,0 +1,414 @@
+﻿/**
+ * @file PointDensityImage.cpp
+ * @brief 点检测密度图像实现文件
+ * @details 该文件实现了点检测结果的按需栅格化，包括：
+ *          - 点文件的解析
+ *          - 规则网格空间索引的计数排序建立
+ *          - 按层级像素累加后的高斯核密度估计和格子计数
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "PointDensityImage.h"
+#include "PipelineProfiler.h"
+#include "TileBufferPool.h"
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <shared_mutex>
+
+namespace {
+
+    /**
+     * @brief 向下取整的整数除法
+     * @param value 被除数，可以为负
+     * @param divisor 除数，大于0
+     * @return floor(value / divisor)
+     */
+    long long floorDivide(long long value, long long divisor)
+    {
+        return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+    }
+}
+
+const double PointDensityImage::kDensityArea = 1000000.;
+
+/**
+ * @brief 构造函数
+ * @param reference 背景切片
+ * @param mode 栅格化方式
+ * @param bandwidth 高斯核标准差或格子边长（层级像素）
+ */
+PointDensityImage::PointDensityImage(const MultiResolutionImage& reference, Mode mode, double bandwidth)
+    : MultiResolutionImage(),
+    _mode(mode),
+    _bandwidth(std::max(bandwidth, 1.)),
+    _indexColumns(0),
+    _indexRows(0),
+    _maxDensity(0.)
+{
+    for (int level = 0; level < reference.getNumberOfLevels(); ++level) {
+        _referenceDimensions.push_back(reference.getLevelDimensions(level));
+        _downsamples.push_back(reference.getLevelDownsample(level));
+    }
+    _referenceSpacing = reference.getSpacing();
+}
+
+/**
+ * @brief 析构函数
+ */
+PointDensityImage::~PointDensityImage()
+{
+    std::unique_lock<std::shared_mutex> l(*_openCloseMutex);
+    cleanup();
+    MultiResolutionImage::cleanup();
+}
+
+/**
+ * @brief 读取点文件并建立空间索引
+ * @param imagePath 点文件路径
+ * @return 初始化是否成功
+ */
+bool PointDensityImage::initializeType(const std::string& imagePath)
+{
+    std::unique_lock<std::shared_mutex> l(*_openCloseMutex);
+    cleanup();
+
+    QFile file(QString::fromStdString(imagePath));
+    if (_referenceDimensions.empty() || !file.open(QIODevice::ReadOnly)) {
+        _isValid = false;
+        return false;
+    }
+    const std::vector<Point> points = parsePoints(file.readAll());
+    file.close();
+
+    _levelDimensions = _referenceDimensions;
+    _levelTileSizes.assign(_levelDimensions.size(), std::vector<unsigned long long>());
+    _numberOfLevels = static_cast<unsigned int>(_levelDimensions.size());
+    _spacing = _referenceSpacing;
+    buildIndex(points);
+    if (_points.empty()) {
+        cleanup();
+        _isValid = false;
+        return false;
+    }
+
+    _dataType = SlideColorManagement::DataType::Float;
+    _samplesPerPixel = 1;
+    _colorType = SlideColorManagement::ColorType::Monochrome;
+    _fileType = "points";
+
+    _properties.emplace_back("points.count", true, static_cast<double>(_points.size()));
+    _properties.emplace_back("points.mode", false, 0.0, std::string(_mode == KernelDensity ? "kernel-density" : "bin-count"));
+    _properties.emplace_back("points.bandwidth", true, _bandwidth);
+    _properties.emplace_back("points.max-density", true, _maxDensity);
+
+    _isValid = true;
+    return _isValid;
+}
+
+/**
+ * @brief 清理资源
+ * @details 清空点、空间索引、层级和属性
+ */
+void PointDensityImage::cleanup()
+{
+    _points.clear();
+    _cellStart.clear();
+    _indexColumns = 0;
+    _indexRows = 0;
+    _maxDensity = 0.;
+    _levelDimensions.clear();
+    _levelTileSizes.clear();
+    _spacing.clear();
+    _properties.clear();
+}
+
+/**
+ * @brief 解析点文件内容
+ * @param content 文件内容
+ * @return 解析到的点
+ * @details 逐行读取前三个数字，分隔符为逗号、分号、制表符或空格；
+ *          第一个字段不是数字、少于两个数字或数值不是有限值的行被跳过
+ */
+std::vector<PointDensityImage::Point> PointDensityImage::parsePoints(const QByteArray& content)
+{
+    std::vector<Point> points;
+    const char* line = content.constData();
+    const char* end = line + content.size();
+    while (line < end) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', end - line));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+        double values[3] = { 0., 0., 1. };
+        int count = 0;
+        const char* cursor = line;
+        while (count < 3 && cursor < lineEnd) {
+            while (cursor < lineEnd && (*cursor == ',' || *cursor == ';' || *cursor == ' ' || *cursor == '\t' || *cursor == '\r')) {
+                ++cursor;
+            }
+            if (cursor >= lineEnd) {
+                break;
+            }
+            char* next = NULL;
+            const double value = std::strtod(cursor, &next);
+            if (next == cursor || next > lineEnd) {
+                break;
+            }
+            values[count++] = value;
+            cursor = next;
+        }
+        if (count >= 2 && std::isfinite(values[0]) && std::isfinite(values[1]) && std::isfinite(values[2])) {
+            Point point = { static_cast<float>(values[0]), static_cast<float>(values[1]), static_cast<float>(values[2]) };
+            points.push_back(point);
+        }
+        line = lineEnd + 1;
+    }
+    return points;
+}
+
+/**
+ * @brief 按网格排序点并建立索引
+ * @param points 未排序的点
+ */
+void PointDensityImage::buildIndex(const std::vector<Point>& points)
+{
+    const unsigned long long width = _levelDimensions[0][0];
+    const unsigned long long height = _levelDimensions[0][1];
+    _indexColumns = (width + kIndexCellSize - 1) / kIndexCellSize;
+    _indexRows = (height + kIndexCellSize - 1) / kIndexCellSize;
+    const unsigned long long cells = _indexColumns * _indexRows;
+
+    std::vector<unsigned long long> pointCells(points.size(), cells);
+    _cellStart.assign(cells + 1, 0);
+    for (size_t i = 0; i < points.size(); ++i) {
+        const Point& point = points[i];
+        if (point.x < 0.f || point.y < 0.f || point.x >= width || point.y >= height) {
+            continue;
+        }
+        const unsigned long long cell = static_cast<unsigned long long>(point.y / kIndexCellSize) * _indexColumns +
+            static_cast<unsigned long long>(point.x / kIndexCellSize);
+        pointCells[i] = cell;
+        ++_cellStart[cell + 1];
+    }
+    for (unsigned long long cell = 0; cell < cells; ++cell) {
+        _cellStart[cell + 1] += _cellStart[cell];
+    }
+
+    _points.resize(_cellStart[cells]);
+    std::vector<unsigned int> cursor(_cellStart.begin(), _cellStart.end() - 1);
+    std::vector<double> cellWeights(cells, 0.);
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (pointCells[i] < cells) {
+            _points[cursor[pointCells[i]]++] = points[i];
+            cellWeights[pointCells[i]] += points[i].weight;
+        }
+    }
+    const double cellArea = static_cast<double>(kIndexCellSize) * kIndexCellSize;
+    _maxDensity = cellWeights.empty() ? 0. : *std::max_element(cellWeights.begin(), cellWeights.end()) * kDensityArea / cellArea;
+}
+
+/**
+ * @brief 把区域内的点累加到层级像素网格
+ * @param originX 网格左上角的X坐标（层级像素）
+ * @param originY 网格左上角的Y坐标（层级像素）
+ * @param columns 网格列数
+ * @param rows 网格行数
+ * @param cellSize 网格单元的边长（层级像素）
+ * @param downsample 层级的下采样因子
+ * @param grid 输出网格
+ * @details 只遍历与区域相交的索引网格，点按所在层级像素的左上角归入网格单元
+ */
+void PointDensityImage::accumulate(long long originX, long long originY, unsigned long long columns, unsigned long long rows,
+    unsigned long long cellSize, double downsample, float* grid) const
+{
+    const double left = originX * downsample;
+    const double top = originY * downsample;
+    const double right = (originX + static_cast<long long>(columns * cellSize)) * downsample;
+    const double bottom = (originY + static_cast<long long>(rows * cellSize)) * downsample;
+    if (right <= 0. || bottom <= 0. || _indexColumns == 0 || _indexRows == 0) {
+        return;
+    }
+    const unsigned long long firstColumn = static_cast<unsigned long long>(std::max(left, 0.) / kIndexCellSize);
+    const unsigned long long firstRow = static_cast<unsigned long long>(std::max(top, 0.) / kIndexCellSize);
+    const unsigned long long lastColumn = std::min(static_cast<unsigned long long>(right / kIndexCellSize), _indexColumns - 1);
+    const unsigned long long lastRow = std::min(static_cast<unsigned long long>(bottom / kIndexCellSize), _indexRows - 1);
+    const long long extentX = static_cast<long long>(columns * cellSize);
+    const long long extentY = static_cast<long long>(rows * cellSize);
+    for (unsigned long long row = firstRow; row <= lastRow; ++row) {
+        for (unsigned long long column = firstColumn; column <= lastColumn; ++column) {
+            const unsigned long long cell = row * _indexColumns + column;
+            for (unsigned int i = _cellStart[cell]; i < _cellStart[cell + 1]; ++i) {
+                const Point& point = _points[i];
+                const long long x = static_cast<long long>(std::floor(point.x / downsample)) - originX;
+                const long long y = static_cast<long long>(std::floor(point.y / downsample)) - originY;
+                if (x >= 0 && y >= 0 && x < extentX && y < extentY) {
+                    grid[(y / cellSize) * columns + x / cellSize] += point.weight;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief 栅格化区域
+ * @param startX 起始X坐标（第0层坐标）
+ * @param startY 起始Y坐标（第0层坐标）
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @return 密度数据，图像无效时返回NULL
+ */
+void* PointDensityImage::readDataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level)
+{
+    float* density = TileBufferPool::allocateArray<float>(width * height);
+    if (!readDataIntoBuffer(startX, startY, width, height, level, density, m_currentZPlaneIndex)) {
+        TileBufferPool::release(density);
+        return NULL;
+    }
+    return density;
+}
+
+/**
+ * @brief 把区域栅格化到调用者的缓冲区
+ * @param startX 起始X坐标（第0层坐标）
+ * @param startY 起始Y坐标（第0层坐标）
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @param data 输出缓冲区，width*height个float
+ * @param zPlane Z平面索引，点文件只有一个平面，忽略
+ * @return 图像有效时返回true
+ * @details KernelDensity把区域四周扩展3倍标准差后累加，再依次做水平和垂直的一维高斯卷积；
+ *          区域及其扩展范围内没有点时直接输出0
+ */
+bool PointDensityImage::readDataIntoBuffer(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level, void* data, const unsigned int& zPlane)
+{
+    if (!_isValid || level >= _numberOfLevels) {
+        return false;
+    }
+
+    PipelineProfiler::ScopedTimer timer(PipelineProfiler::ReadDataFromImage, PipelineProfiler::ReadPointDensity);
+    std::shared_lock<std::shared_mutex> l(*_openCloseMutex);
+    float* density = static_cast<float*>(data);
+    std::fill(density, density + width * height, 0.f);
+    const double downsample = _downsamples[level];
+    const long long originX = std::llround(startX / downsample);
+    const long long originY = std::llround(startY / downsample);
+
+    if (_mode == BinCount) {
+        const long long bin = std::llround(_bandwidth);
+        const long long firstBinX = floorDivide(originX, bin);
+        const long long firstBinY = floorDivide(originY, bin);
+        const unsigned long long binColumns = static_cast<unsigned long long>(floorDivide(originX + static_cast<long long>(width) - 1, bin) - firstBinX + 1);
+        const unsigned long long binRows = static_cast<unsigned long long>(floorDivide(originY + static_cast<long long>(height) - 1, bin) - firstBinY + 1);
+        TileBuffer<float> bins(binColumns * binRows);
+        std::fill(bins.get(), bins.get() + binColumns * binRows, 0.f);
+        accumulate(firstBinX * bin, firstBinY * bin, binColumns, binRows, bin, downsample, bins.get());
+        const float scale = static_cast<float>(kDensityArea / (static_cast<double>(bin) * bin * downsample * downsample));
+        for (unsigned long long y = 0; y < height; ++y) {
+            const float* binRow = bins.get() + (floorDivide(originY + static_cast<long long>(y), bin) - firstBinY) * binColumns;
+            float* row = density + y * width;
+            for (unsigned long long x = 0; x < width; ++x) {
+                row[x] = binRow[floorDivide(originX + static_cast<long long>(x), bin) - firstBinX] * scale;
+            }
+        }
+        return true;
+    }
+
+    const unsigned long long radius = static_cast<unsigned long long>(std::ceil(3. * _bandwidth));
+    const unsigned long long gridWidth = width + 2 * radius;
+    const unsigned long long gridHeight = height + 2 * radius;
+    TileBuffer<float> grid(gridWidth * gridHeight);
+    std::fill(grid.get(), grid.get() + gridWidth * gridHeight, 0.f);
+    accumulate(originX - static_cast<long long>(radius), originY - static_cast<long long>(radius), gridWidth, gridHeight, 1, downsample, grid.get());
+    if (std::all_of(grid.get(), grid.get() + gridWidth * gridHeight, [](float value) { return value == 0.f; })) {
+        return true;
+    }
+
+    // 核的和归一化为1，累加值为每层级像素的点数，再换算为每kDensityArea个第0层像素的点数
+    std::vector<float> kernel(2 * radius + 1);
+    double kernelSum = 0.;
+    for (unsigned long long i = 0; i < kernel.size(); ++i) {
+        const double offset = static_cast<double>(i) - static_cast<double>(radius);
+        kernel[i] = static_cast<float>(std::exp(-offset * offset / (2. * _bandwidth * _bandwidth)));
+        kernelSum += kernel[i];
+    }
+    const double scale = kDensityArea / (downsample * downsample);
+    for (float& weight : kernel) {
+        weight = static_cast<float>(weight / kernelSum);
+    }
+    TileBuffer<float> horizontal(width * gridHeight);
+    for (unsigned long long y = 0; y < gridHeight; ++y) {
+        const float* source = grid.get() + y * gridWidth;
+        float* row = horizontal.get() + y * width;
+        for (unsigned long long x = 0; x < width; ++x) {
+            float sum = 0.f;
+            for (unsigned long long i = 0; i < kernel.size(); ++i) {
+                sum += source[x + i] * kernel[i];
+            }
+            row[x] = sum;
+        }
+    }
+    for (unsigned long long y = 0; y < height; ++y) {
+        float* row = density + y * width;
+        for (unsigned long long i = 0; i < kernel.size(); ++i) {
+            const float* source = horizontal.get() + (y + i) * width;
+            const float weight = static_cast<float>(kernel[i] * scale);
+            for (unsigned long long x = 0; x < width; ++x) {
+                row[x] += source[x] * weight;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 获取属性
+ * @param propertyName 属性名称
+ * @return 属性值字符串
+ */
+std::string PointDensityImage::getProperty(const std::string& propertyName)
+{
+    for (const auto& property : _properties) {
+        if (property.name == propertyName) {
+            return property.isNumeric ? std::to_string(property.numericValue) : property.stringValue;
+        }
+    }
+    return std::string();
+}
+
+/**
+ * @brief 获取标签图
+ * @return 空图像
+ */
+const QImage PointDensityImage::getLabel()
+{
+    return QImage();
+}
+
+/**
+ * @brief 获取图像属性
+ * @return 属性列表
+ */
+const std::vector<SlideColorManagement::PropertyInfo> PointDensityImage::getProperties()
+{
+    return _properties;
+}
+
+/**
+ * @brief 获取点数
+ * @return 点数
+ */
+unsigned long long PointDensityImage::getNumberOfPoints() const
+{
+    return _points.size();
+}
@@ -0,0 +1,208 @@
+﻿/**
+ * @file    PointDensityImage.h
+ * @brief   点检测密度图像类，把细胞中心等点检测结果按需栅格化为单通道密度金字塔
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了以点检测结果作为前景图像的功能，包括：
+ *          - 从CSV文件读取点坐标（第0层像素）和可选的权重
+ *          - 按规则网格建立一次空间索引，读取区域时只访问相交的网格
+ *          - 按读取层级栅格化为核密度估计或格子计数
+ *          - 层级与背景切片一一对应，作为前景经IOWorker的查表和透明度路径显示
+ *
+ * @note    模型每次运行只需输出点列表，不必为每次结果写出金字塔TIFF
+ * @see     MultiResolutionImage, IOWorker::getForegroundTile, PathologyViewer::setPointDensityOverlay
+ */
+
+#pragma once
+#include "MultiResolutionImage.h"
+#include <QImage>
+#include <string>
+#include <vector>
+
+/**
+ * @class  PointDensityImage
+ * @brief  点检测密度图像类
+ * @details 层级尺寸和下采样因子复制自背景切片的逻辑层级，前景缩放为1时IOWorker读取与背景相同的层级。
+ *          每个像素的值为该位置每kDensityArea个第0层像素面积内的点数（按权重计），不同层级的值可以直接比较：
+ *          - KernelDensity：先把点累加到层级像素，再做标准差为bandwidth个层级像素的可分离高斯模糊
+ *          - BinCount：按层级像素网格上边长为bandwidth的格子计数，格子与瓦片边界无关，相邻瓦片一致
+ *
+ *          读取的结果经MultiResolutionImage写入解码瓦片缓存，由IO工作线程池并发栅格化。
+ *
+ * @note   只提供一个float通道；点文件每行至少包含x、y两列，第三列为权重，
+ *         以逗号、制表符或空格分隔，无法解析为数字的行（如表头）被跳过
+ * @example
+ *          // 使用示例
+ *          std::shared_ptr<PointDensityImage> density = std::make_shared<PointDensityImage>(*slide);
+ *          if (density->initialize("cells.csv")) {
+ *              viewer->onForegroundImageChanged(density, 1.);
+ *          }
+ * @see     MultiResolutionImage, PathologyViewer::setPointDensityOverlay
+ */
+class PointDensityImage : public MultiResolutionImage
+{
+public:
+    /**
+     * @brief 栅格化方式
+     */
+    enum Mode {
+        KernelDensity,  ///< 高斯核密度估计
+        BinCount        ///< 格子计数
+    };
+
+    /**
+     * @brief   构造函数
+     * @param   reference 背景切片，复制其逻辑层级的尺寸和下采样因子
+     * @param   mode 栅格化方式
+     * @param   bandwidth KernelDensity时为高斯核的标准差，BinCount时为格子边长，单位为层级像素
+     * @note    构造函数不读取点文件，需要调用initialize
+     */
+    explicit PointDensityImage(const MultiResolutionImage& reference, Mode mode = KernelDensity, double bandwidth = 8.);
+
+    /**
+     * @brief   析构函数
+     */
+    ~PointDensityImage();
+
+    /**
+     * @brief   读取点文件并建立空间索引
+     * @param   imagePath 点文件路径
+     * @return  文件可读、至少有一个点且背景切片有效时返回true
+     */
+    bool initializeType(const std::string& imagePath);
+
+    /**
+     * @brief   获取通道最小值
+     * @return  密度的最小值，始终为0
+     */
+    double getMinValue(int channel = -1) { return 0.; }
+
+    /**
+     * @brief   获取通道最大值
+     * @return  空间索引网格中最密集的网格的密度
+     * @note    核较窄时局部密度可能更高，查表时被截断；切片统计建立后按统计范围查表
+     */
+    double getMaxValue(int channel = -1) { return _maxDensity; }
+
+    /**
+     * @brief   获取属性
+     * @param   propertyName 属性名称，与getProperties返回的名称相同
+     * @return  属性值，不存在时返回空字符串
+     */
+    std::string getProperty(const std::string& propertyName);
+
+    /**
+     * @brief   获取标签图
+     * @return  点文件没有标签图，始终返回空图像
+     */
+    const QImage getLabel();
+
+    /**
+     * @brief   获取图像属性
+     * @details 包括点数、栅格化方式和带宽
+     * @return  属性列表
+     */
+    const std::vector<SlideColorManagement::PropertyInfo> getProperties();
+
+    /**
+     * @brief   获取点数
+     * @return  读取到的点数
+     */
+    unsigned long long getNumberOfPoints() const;
+
+    /** @brief 密度的面积单位（第0层像素的平方数），即每1000x1000个第0层像素 */
+    static const double kDensityArea;
+
+protected:
+    /**
+     * @brief   清理资源
+     * @details 清空点、空间索引和属性，保留构造时复制的层级
+     */
+    void cleanup();
+
+    /**
+     * @brief   栅格化区域
+     * @return  从TileBufferPool分配的float数据（1通道），调用者负责归还
+     */
+    void* readDataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level);
+
+    /**
+     * @brief   把区域栅格化到调用者的缓冲区
+     * @details 与readDataFromImage相同，但直接写入data
+     * @return  图像有效时返回true
+     */
+    bool readDataIntoBuffer(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, void* data, const unsigned int& zPlane);
+
+private:
+    /**
+     * @brief 点，坐标为第0层像素
+     */
+    struct Point {
+        float x;
+        float y;
+        float weight;
+    };
+
+    /**
+     * @brief   解析点文件内容
+     * @param   content 文件内容
+     * @return  解析到的点
+     */
+    static std::vector<Point> parsePoints(const QByteArray& content);
+
+    /**
+     * @brief   按网格排序点并建立索引
+     * @param   points 未排序的点，坐标位于图像以外的点被丢弃
+     * @details 计数排序，每个网格的点在_points中连续存放，_cellStart记录各网格的起点
+     */
+    void buildIndex(const std::vector<Point>& points);
+
+    /**
+     * @brief   把区域内的点累加到层级像素网格
+     * @param   originX 网格左上角的X坐标（层级像素）
+     * @param   originY 网格左上角的Y坐标（层级像素）
+     * @param   columns 网格列数
+     * @param   rows 网格行数
+     * @param   cellSize 网格单元的边长（层级像素）
+     * @param   downsample 层级的下采样因子
+     * @param   grid 输出网格，调用前清零
+     */
+    void accumulate(long long originX, long long originY, unsigned long long columns, unsigned long long rows,
+        unsigned long long cellSize, double downsample, float* grid) const;
+
+    /** @brief 栅格化方式 */
+    Mode _mode;
+
+    /** @brief 高斯核标准差或格子边长（层级像素） */
+    double _bandwidth;
+
+    /** @brief 背景切片逻辑层级的尺寸，initializeType时作为本图像的层级 */
+    std::vector<std::vector<unsigned long long> > _referenceDimensions;
+
+    /** @brief 背景切片的像素间距 */
+    std::vector<double> _referenceSpacing;
+
+    /** @brief 各层级的下采样因子，与背景切片的逻辑层级相同 */
+    std::vector<double> _downsamples;
+
+    /** @brief 按网格排序的点 */
+    std::vector<Point> _points;
+
+    /** @brief 各网格第一个点在_points中的下标，最后一项为点数 */
+    std::vector<unsigned int> _cellStart;
+
+    /** @brief 空间索引的网格列数 */
+    unsigned long long _indexColumns;
+
+    /** @brief 空间索引的网格行数 */
+    unsigned long long _indexRows;
+
+    /** @brief 最密集的索引网格的密度 */
+    double _maxDensity;
+
+    /** @brief 空间索引网格的边长（第0层像素） */
+    static const unsigned int kIndexCellSize = 256;
+};
@@ -4,7 +4,11 @@
  * @details 该文件实现了多分辨率图像的预取功能，包括：
  *          - 基于当前视野范围的智能预取
  *          - 多层级数据的预加载
- *          - 8连通邻域的瓦片预取
+ *          - 基于平移速度和缩放趋势的运动预测预取
+ *          - 光栅扫描的下一行（列）预取
+ *          - 视场静止时的8连通邻域预取
+ *          - 相邻Z平面的当前视场预取
+ *          - 按瓦片网格读取并填充解码瓦片缓存
  *          - 线程安全的预取管理
  * @author [JianZhang] ([])
  * @date    2025-01-19
@@ -15,14 +19,16 @@
 
 #include <QPixmap>
 #include <QElapsedTimer>
-#include <QDebug>
 
 #include "MultiResolutionImage.h"
+#include "TissueMask.h"
+#include <cmath>
+#include <algorithm>
 
 /**
  * @brief 构造函数：初始化预取线程
  * @param parent 父对象
- * @details 初始化预取线程的成员变量，包括控制标志、视野范围等
+ * @details 初始化预取线程的成员变量，包括控制标志、视野范围和预取预算
  */
 PrefetchThread::PrefetchThread(QObject* parent) :
     QThread(parent),
@@ -30,8 +36,13 @@ PrefetchThread::PrefetchThread(QObject* parent) :
     _abort(false),
     _FOV(QRectF()),
     _level(0),
-    _img(NULL)
+    _levelTileSizes(),
+    _zPlane(0),
+    _maxTiles(96),
+    _maxBytes(96ULL * 1024 * 1024),
+    _img()
 {
+    _clock.start();
 }
 
 /**
@@ -55,18 +66,32 @@ PrefetchThread::~PrefetchThread()
  * @param img 多分辨率图像对象
  * @param FOV 新的视野范围
  * @param level 图像层级
- * @details 更新预取参数并启动或重启预取线程
+ * @param levelTileSizes 各层级的瓦片大小
+ * @param zPlane 显示的Z平面
+ * @details 记录视场历史，更新预取参数并启动或重启预取线程。
+ *          更换图像时清空历史。预取以低优先级运行，不与IOWorker争抢CPU
  */
-void PrefetchThread::FOVChanged(MultiResolutionImage* img, const QRectF& FOV, const unsigned int level)
+void PrefetchThread::FOVChanged(std::shared_ptr<MultiResolutionImage> img, const QRectF& FOV, const unsigned int level, const std::vector<unsigned int>& levelTileSizes,
+    const unsigned int zPlane)
 {
     QMutexLocker locker(&_mutex);
 
+    if (_img.lock() != img) {
+        _history.clear();
+    }
     _img = img;
     _level = level;
     _FOV = FOV;
+    _levelTileSizes = levelTileSizes;
+    _zPlane = zPlane;
+    FOVSample sample = { FOV, level, _clock.elapsed() };
+    _history.push_back(sample);
+    while (_history.size() > kMaxHistory) {
+        _history.pop_front();
+    }
 
     if (!isRunning()) {
-        start(HighPriority);
+        start(LowPriority);
     }
     else {
         _restart = true;
@@ -74,72 +99,258 @@ void PrefetchThread::FOVChanged(MultiResolutionImage* img, const QRectF& FOV, co
     }
 }
 
+/**
+ * @brief 设置预取预算
+ * @param maxTiles 最大瓦片数
+ * @param maxBytes 最大字节数
+ */
+void PrefetchThread::setPrefetchBudget(unsigned int maxTiles, unsigned long long maxBytes)
+{
+    QMutexLocker locker(&_mutex);
+    _maxTiles = maxTiles;
+    _maxBytes = maxBytes;
+}
+
+/**
+ * @brief 获取最大预取瓦片数
+ * @return 瓦片数
+ */
+unsigned int PrefetchThread::getMaxPrefetchTiles() const
+{
+    return _maxTiles;
+}
+
+/**
+ * @brief 获取最大预取字节数
+ * @return 字节数
+ */
+unsigned long long PrefetchThread::getMaxPrefetchBytes() const
+{
+    return _maxBytes;
+}
+
 /**
  * @brief 预取线程主循环
- * @details 基于当前视野范围和层级进行智能预取：
- *          - 缓存当前层级上下各一级的数据
- *          - 在8连通邻域内预取相同大小的瓦片
- *          - 考虑降采样比例进行坐标转换
+ * @details 每次视场变化后根据视场历史生成预取目标并依次预取，
+ *          有多个Z平面时相邻平面的当前视场排在最前。预取结果保存在图像的解码瓦片缓存中，
+ *          解码瓦片缓存限制每个平面的占用，相邻平面的预取不会淘汰当前平面的全部瓦片
  */
 void PrefetchThread::run()
 {
     forever{
-      if (_img) {
         _mutex.lock();
-        QRectF FOV = _FOV;
-        int level = _level;
-        MultiResolutionImage* img = _img;
-        std::vector<unsigned long long> L0Dims = img->getDimensions();
-        QRectF maxFOV(0, 0, L0Dims[0], L0Dims[1]);
-        int levelDownsample = img->getLevelDownsample(level);
+        if (_abort) {
+            _mutex.unlock();
+            return;
+        }
+        _restart = false;
+        std::deque<FOVSample> history = _history;
+        std::vector<unsigned int> levelTileSizes = _levelTileSizes;
+        unsigned int zPlane = _zPlane;
+        unsigned int tilesLeft = _maxTiles;
+        unsigned long long bytesLeft = _maxBytes;
+        std::shared_ptr<MultiResolutionImage> img = _img.lock();
         _mutex.unlock();
 
-        if (img) {
-          if (_abort) {
-            return;
-          }
-          // 缓存下一级（更高分辨率）
-          if (level - 1 >= 0 && !_restart) {
-            unsigned int width = FOV.width() / img->getLevelDownsample(level - 1);
-            unsigned int height = FOV.height() / img->getLevelDownsample(level - 1);
-            unsigned char* data = NULL;
-            data = new unsigned char[width * height * img->getSamplesPerPixel()];
-            img->getRawRegion(FOV.left(), FOV.top(), width, height, level - 1, data);
-            delete[] data;
-          }
-          // 在当前视野范围周围进行8连通预取
-          for (int x = -1; x < 2; ++x) {
-            if (_restart) {
-              break;
+        if (img && !levelTileSizes.empty() && !history.empty()) {
+            // 预取量不超过解码瓦片缓存的一半，避免预取的瓦片互相淘汰
+            bytesLeft = std::min(bytesLeft, img->getCacheSize() / 2);
+            std::vector<PrefetchTarget> targets;
+            const unsigned int nrZPlanes = img->getNumberOfZPlanes() > 0 ? static_cast<unsigned int>(img->getNumberOfZPlanes()) : 1;
+            const FOVSample& last = history.back();
+            if (zPlane + 1 < nrZPlanes) {
+                PrefetchTarget above = { last.FOV, QRectF(), last.level, zPlane + 1 };
+                targets.push_back(above);
+            }
+            if (zPlane > 0) {
+                PrefetchTarget below = { last.FOV, QRectF(), last.level, zPlane - 1 };
+                targets.push_back(below);
             }
-            for (int y = -1; y < 2; ++y) {
-              if (_restart) {
-                break;
-              }
-              if (x == 0 && y == 0) {
-                continue; // 跳过中心位置（当前视野范围）
-              }
-              QRectF cur(FOV.left() + x * FOV.width(), FOV.top() + y * FOV.height(), FOV.width(), FOV.height());
-              cur = cur.intersected(maxFOV); // 确保不超出图像边界
-              unsigned int width = cur.width() / levelDownsample;
-              unsigned int height = cur.height() / levelDownsample;
-              unsigned char* data = new unsigned char[width * height * img->getSamplesPerPixel()];
-              img->getRawRegion(cur.left(), cur.top(), width, height, level, data);
-              delete[] data;
+            for (PrefetchTarget target : predictTargets(img.get(), history)) {
+                target.zPlane = zPlane;
+                targets.push_back(target);
+            }
+            for (const PrefetchTarget& target : targets) {
+                const unsigned int tileSize = levelTileSizes[std::min<size_t>(target.level, levelTileSizes.size() - 1)];
+                if (tileSize == 0 || !prefetchTiles(img.get(), target.region, target.exclude, target.level, tileSize, target.zPlane, tilesLeft, bytesLeft)) {
+                    break;
+                }
             }
-          }
         }
+        img.reset();
 
         _mutex.lock();
-        if (!_restart) {
-          qDebug() << "Prefetching finished!";
-          _condition.wait(&_mutex); // 等待新的视野范围变化
+        if (!_restart && !_abort) {
+            _condition.wait(&_mutex); // 等待新的视野范围变化
         }
-        _restart = false;
         _mutex.unlock();
-        if (_abort) {
-          return;
+    }
+}
+
+/**
+ * @brief 根据视场历史生成预取目标
+ * @param img 图像对象
+ * @param history 视场历史
+ * @return 预取目标
+ * @details 速度以视场中心的第0层像素/秒计，缩放速度为视场宽度对数的变化率；
+ *          当前视场由IOThread加载，因此所有目标都排除当前视场
+ */
+std::vector<PrefetchThread::PrefetchTarget> PrefetchThread::predictTargets(MultiResolutionImage* img, const std::deque<FOVSample>& history)
+{
+    const qint64 velocityWindow = 500;
+    const double horizons[] = { 0.25, 0.5, 1.0 };
+
+    std::vector<PrefetchTarget> targets;
+    const FOVSample& last = history.back();
+    const QRectF& FOV = last.FOV;
+    if (FOV.isEmpty()) {
+        return targets;
+    }
+
+    // 取窗口内最早的样本估计运动；层级跳变不影响中心和宽度的估计
+    const FOVSample* first = &last;
+    for (auto it = history.rbegin(); it != history.rend(); ++it) {
+        if (last.time - it->time > velocityWindow) {
+            break;
+        }
+        first = &(*it);
+    }
+    double dt = (last.time - first->time) / 1000.;
+    QPointF velocity(0, 0);
+    double zoomRate = 0;
+    if (dt > 0 && !first->FOV.isEmpty()) {
+        velocity = (FOV.center() - first->FOV.center()) / dt;
+        zoomRate = std::log(FOV.width() / first->FOV.width()) / dt;
+    }
+
+    // 速度低于每秒0.05个视场且缩放低于每秒5%时视为静止
+    bool panning = std::abs(velocity.x()) > 0.05 * FOV.width() || std::abs(velocity.y()) > 0.05 * FOV.height();
+    bool zooming = std::abs(zoomRate) > 0.05;
+    if (!panning && !zooming) {
+        PrefetchTarget ring = { QRectF(FOV.left() - FOV.width(), FOV.top() - FOV.height(), 3 * FOV.width(), 3 * FOV.height()), FOV, last.level, 0 };
+        targets.push_back(ring);
+        if (last.level > 0) {
+            PrefetchTarget finer = { FOV, QRectF(), last.level - 1, 0 };
+            targets.push_back(finer);
+        }
+        return targets;
+    }
+
+    const double lastDownsample = img->getLevelDownsample(last.level);
+    QRectF path = FOV;
+    for (double horizon : horizons) {
+        double scale = std::exp(zoomRate * horizon);
+        QPointF center = FOV.center() + velocity * horizon;
+        QRectF predicted(0, 0, FOV.width() * scale, FOV.height() * scale);
+        predicted.moveCenter(center);
+        int level = img->getBestLevelForDownSample(lastDownsample * scale);
+        if (level < 0) {
+            level = last.level;
+        }
+        PrefetchTarget target = { predicted, level == static_cast<int>(last.level) ? FOV : QRectF(), static_cast<unsigned int>(level), 0 };
+        targets.push_back(target);
+        path = path.united(predicted);
+    }
+
+    // 光栅扫描：水平扫视时预取下一行，方向沿用历史中最近一次的垂直移动，默认向下
+    if (panning && !zooming) {
+        bool horizontalSweep = std::abs(velocity.x()) > 2 * std::abs(velocity.y());
+        bool verticalSweep = std::abs(velocity.y()) > 2 * std::abs(velocity.x());
+        if (horizontalSweep || verticalSweep) {
+            double step = 1.;
+            for (auto it = history.rbegin(); it + 1 != history.rend(); ++it) {
+                QPointF delta = it->FOV.center() - (it + 1)->FOV.center();
+                double across = horizontalSweep ? delta.y() : delta.x();
+                double extent = horizontalSweep ? FOV.height() : FOV.width();
+                if (std::abs(across) > 0.5 * extent) {
+                    step = across > 0 ? 1. : -1.;
+                    break;
+                }
+            }
+            // 下一行覆盖整条扫视路径加回扫的起点
+            QRectF nextRow = horizontalSweep ?
+                QRectF(path.left() - 2 * FOV.width(), FOV.top() + step * FOV.height(), path.width() + 4 * FOV.width(), FOV.height()) :
+                QRectF(FOV.left() + step * FOV.width(), path.top() - 2 * FOV.height(), FOV.width(), path.height() + 4 * FOV.height());
+            PrefetchTarget target = { nextRow, FOV, last.level, 0 };
+            targets.push_back(target);
+        }
+    }
+    return targets;
+}
+
+/**
+ * @brief 预取区域内的瓦片
+ * @param img 图像对象
+ * @param region 预取区域
+ * @param exclude 跳过的区域
+ * @param level 层级
+ * @param tileSize 瓦片大小
+ * @param zPlane Z平面
+ * @param tilesLeft 剩余瓦片预算
+ * @param bytesLeft 剩余字节预算
+ * @return 可以继续预取时返回true
+ * @details 起始坐标的计算方式与IOWorker::readBackgroundImage完全相同，保证缓存键一致；
+ *          瓦片按到区域中心的距离由近到远读取
+ */
+bool PrefetchThread::prefetchTiles(MultiResolutionImage* img, const QRectF& region, const QRectF& exclude, unsigned int level, unsigned int tileSize,
+    unsigned int zPlane, unsigned int& tilesLeft, unsigned long long& bytesLeft)
+{
+    if (level >= static_cast<unsigned int>(img->getNumberOfLevels())) {
+        return true;
+    }
+    std::vector<unsigned long long> L0Dims = img->getDimensions();
+    QRectF area = region.intersected(QRectF(0, 0, L0Dims[0], L0Dims[1]));
+    if (area.isEmpty()) {
+        return true;
+    }
+    float levelDownsample = img->getLevelDownsample(level);
+    float tileExtent = levelDownsample * tileSize;
+    unsigned int firstX = area.left() / tileExtent;
+    unsigned int firstY = area.top() / tileExtent;
+    unsigned int lastX = std::ceil(area.right() / tileExtent);
+    unsigned int lastY = std::ceil(area.bottom() / tileExtent);
+
+    // 只有玻片背景的瓦片由IOWorker直接合成，预取它们只会浪费IO和缓存
+    std::shared_ptr<const TissueMask> tissueMask = img->getTissueMask();
+    std::vector<QPoint> tiles;
+    for (unsigned int tileY = firstY; tileY < lastY; ++tileY) {
+        for (unsigned int tileX = firstX; tileX < lastX; ++tileX) {
+            QRectF tileRect(tileX * tileExtent, tileY * tileExtent, tileExtent, tileExtent);
+            if (tissueMask && !tissueMask->containsTissue(tileRect.x(), tileRect.y(), tileRect.width(), tileRect.height())) {
+                continue;
+            }
+            if (exclude.isEmpty() || !exclude.contains(tileRect)) {
+                tiles.push_back(QPoint(tileX, tileY));
+            }
+        }
+    }
+    QPointF center = region.center() / tileExtent;
+    std::sort(tiles.begin(), tiles.end(), [&center](const QPoint& a, const QPoint& b) {
+        QPointF da = QPointF(a) + QPointF(0.5, 0.5) - center;
+        QPointF db = QPointF(b) + QPointF(0.5, 0.5) - center;
+        return da.x() * da.x() + da.y() * da.y() < db.x() * db.x() + db.y() * db.y();
+    });
+
+    const bool argb32 = img->getColorType() == SlideColorManagement::ColorType::RGB && img->getDataType() == SlideColorManagement::DataType::UChar;
+    const unsigned long long tileBytes = static_cast<unsigned long long>(tileSize) * tileSize * (argb32 ? 4 : img->getSamplesPerPixel());
+    _argbBuffer.resize(static_cast<size_t>(tileSize) * tileSize);
+    for (const QPoint& tile : tiles) {
+        if (_restart || _abort) {
+            return false;
+        }
+        if (tilesLeft == 0 || bytesLeft < tileBytes) {
+            return false;
+        }
+        --tilesLeft;
+        bytesLeft -= tileBytes;
+        long long startX = tile.x() * levelDownsample * tileSize;
+        long long startY = tile.y() * levelDownsample * tileSize;
+        if (argb32 && img->getARGB32Region(startX, startY, tileSize, tileSize, level, _argbBuffer.data(), zPlane)) {
+            continue;
         }
-      }
+        _rawBuffer.resize(static_cast<size_t>(tileSize) * tileSize * img->getSamplesPerPixel());
+        unsigned char* data = _rawBuffer.data();
+        img->getRawRegion(startX, startY, tileSize, tileSize, level, data, zPlane);
     }
+    return true;
 }
\ No newline at end of file
@@ -21,6 +21,11 @@
 #include <QMutex>
 #include <QWaitCondition>
 #include <QRect>
+#include <QElapsedTimer>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
 
 class MultiResolutionImage;
 
@@ -30,18 +35,26 @@ class MultiResolutionImage;
  *          当用户改变视场（FOV）或缩放级别时，该线程会智能地预取
  *          周围区域的瓦片，以提供流畅的浏览体验。
  *
+ *          预取按IOWorker相同的瓦片网格和读取接口进行，结果存入
+ *          MultiResolutionImage的解码瓦片缓存，之后IOWorker加载这些瓦片时直接命中缓存。
+ *
+ *          线程记录最近的视场历史，估计平移速度和缩放趋势：
+ *          - 沿外推路径预取未来0.25s、0.5s、1s的视场，层级随缩放趋势变化
+ *          - 以水平（垂直）平移为主时按光栅扫描习惯预取下一行（列）
+ *          - 视场静止时回退为8连通邻域加下一级的固定策略
+ *          - 有多个Z平面时先预取当前视场在相邻两个平面上的瓦片，切换焦平面时直接命中缓存
+ *          每次视场变化的预取量受瓦片数和字节数预算限制。
+ *
  * @note    该线程采用生产者-消费者模式，通过信号槽机制接收
  *          视场变化通知，并在后台异步执行预取任务
  *
  * @example
  * @code
- * // 创建预取线程
+ * // 创建预取线程，首次调用FOVChanged时自动启动
  * PrefetchThread* prefetchThread = new PrefetchThread(this);
- * prefetchThread->start();
  *
- * // 连接视场变化信号
- * connect(viewer, &PathologyViewer::FOVChanged,
- *         prefetchThread, &PrefetchThread::FOVChanged);
+ * // 视场变化时通知预取线程
+ * prefetchThread->FOVChanged(img, FOV, level, tileSize);
  * @endcode
  */
 class PrefetchThread : public QThread
@@ -68,6 +81,8 @@ public slots:
      * @param   img     多分辨率图像对象指针
      * @param   FOV     新的视场矩形（浮点坐标）
      * @param   level   目标分辨率级别
+     * @param   levelTileSizes 各层级的瓦片大小，与TileManager使用的瓦片网格一致
+     * @param   zPlane  显示的Z平面
      * @details 当用户改变视场或缩放级别时，该槽函数会被调用。
      *          线程会根据新的视场信息，在后台预取相关的图像瓦片。
      *          支持多分辨率级别的智能预取策略。
@@ -75,7 +90,29 @@ public slots:
      * @note    该函数是线程安全的，使用互斥锁保护共享数据
      * @see     MultiResolutionImage::getTilesInRect
      */
-    void FOVChanged(MultiResolutionImage* img, const QRectF& FOV, const unsigned int level);
+    void FOVChanged(std::shared_ptr<MultiResolutionImage> img, const QRectF& FOV, const unsigned int level, const std::vector<unsigned int>& levelTileSizes,
+        const unsigned int zPlane = 0);
+
+public:
+    /**
+     * @brief   设置预取预算
+     * @param   maxTiles 每次视场变化最多预取的瓦片数（IO预算）
+     * @param   maxBytes 每次视场变化最多预取的字节数（内存预算），另受解码瓦片缓存大小的一半限制
+     * @details 预算在下一次视场变化时生效
+     */
+    void setPrefetchBudget(unsigned int maxTiles, unsigned long long maxBytes);
+
+    /**
+     * @brief   获取每次视场变化最多预取的瓦片数
+     * @return  瓦片数
+     */
+    unsigned int getMaxPrefetchTiles() const;
+
+    /**
+     * @brief   获取每次视场变化最多预取的字节数
+     * @return  字节数
+     */
+    unsigned long long getMaxPrefetchBytes() const;
 
 protected:
     /**
@@ -91,11 +128,59 @@ protected:
     void run();
 
 private:
+    /**
+     * @brief 视场历史样本
+     */
+    struct FOVSample {
+        QRectF FOV;          ///< 视场（第0层坐标）
+        unsigned int level;  ///< 层级
+        qint64 time;         ///< 时间戳（毫秒）
+    };
+
+    /**
+     * @brief 预取目标
+     * @details region中除exclude以外的瓦片按给定层级和Z平面预取
+     */
+    struct PrefetchTarget {
+        QRectF region;
+        QRectF exclude;
+        unsigned int level;
+        unsigned int zPlane;
+    };
+
+    /**
+     * @brief   根据视场历史生成预取目标
+     * @param   img     图像对象
+     * @param   history 视场历史，至少包含一个样本
+     * @return  按优先级排序的预取目标，Z平面为0，由调用者设置
+     * @details 使用最近500ms内的样本估计视场中心速度和对数缩放速度并外推；
+     *          运动很小时返回8连通邻域和下一级视野
+     */
+    static std::vector<PrefetchTarget> predictTargets(MultiResolutionImage* img, const std::deque<FOVSample>& history);
+
+    /**
+     * @brief   预取区域内的瓦片
+     * @param   img     图像对象
+     * @param   region  预取区域（第0层坐标）
+     * @param   exclude 跳过完全位于该区域内的瓦片（第0层坐标），可为空
+     * @param   level   层级
+     * @param   tileSize 该层级的瓦片大小
+     * @param   zPlane  Z平面
+     * @details 逐个瓦片调用getARGB32Region，不支持时回退到getRawRegion，
+     *          与IOWorker::readBackgroundImage的读取方式一致，从而使用同一缓存键。
+     *          视场再次变化、线程中止或预算耗尽时提前返回
+     * @param   tilesLeft 剩余瓦片预算，每读取一个瓦片减一
+     * @param   bytesLeft 剩余字节预算
+     * @return  预算耗尽或需要重启时返回false
+     */
+    bool prefetchTiles(MultiResolutionImage* img, const QRectF& region, const QRectF& exclude, unsigned int level, unsigned int tileSize,
+        unsigned int zPlane, unsigned int& tilesLeft, unsigned long long& bytesLeft);
+
     /** @brief 线程重启标志，用于重新启动预取任务 */
-    bool _restart;
+    std::atomic<bool> _restart;
 
     /** @brief 线程中止标志，用于安全停止线程 */
-    bool _abort;
+    std::atomic<bool> _abort;
 
     /** @brief 互斥锁，保护共享数据的线程安全 */
     QMutex _mutex;
@@ -109,6 +194,33 @@ private:
     /** @brief 当前分辨率级别，记录用户选择的缩放级别 */
     unsigned int _level;
 
-    /** @brief 多分辨率图像对象指针，用于访问图像数据和瓦片 */
-    MultiResolutionImage* _img;
+    /** @brief 各层级的瓦片大小 */
+    std::vector<unsigned int> _levelTileSizes;
+
+    /** @brief 显示的Z平面 */
+    unsigned int _zPlane;
+
+    /** @brief 最近的视场历史，最多保留kMaxHistory个样本 */
+    std::deque<FOVSample> _history;
+
+    /** @brief 视场历史的计时器 */
+    QElapsedTimer _clock;
+
+    /** @brief 每次视场变化最多预取的瓦片数 */
+    unsigned int _maxTiles;
+
+    /** @brief 每次视场变化最多预取的字节数 */
+    unsigned long long _maxBytes;
+
+    /** @brief 视场历史最大样本数 */
+    static const unsigned int kMaxHistory = 16;
+
+    /** @brief 多分辨率图像对象，弱引用避免延长图像生命周期 */
+    std::weak_ptr<MultiResolutionImage> _img;
+
+    /** @brief ARGB32读取缓冲区，在瓦片之间复用 */
+    std::vector<unsigned int> _argbBuffer;
+
+    /** @brief 原始数据读取缓冲区，在瓦片之间复用 */
+    std::vector<unsigned char> _rawBuffer;
 };
\ No newline at end of file
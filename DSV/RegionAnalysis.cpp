@@ -0,0 +1,261 @@
+﻿/**
+ * @file RegionAnalysis.cpp
+ * @brief 区域分析类实现文件
+ * @details 该文件实现了标注区域的后台像素统计，包括：
+ *          - 分析瓦片列表的计算
+ *          - 多边形扫描线区间的计算
+ *          - 直方图、平均强度和组织比例的累计与合并
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "RegionAnalysis.h"
+#include "MultiResolutionImage.h"
+#include "TileBufferPool.h"
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief 构造函数
+ * @param img 图像
+ * @param polygon 分析区域（第0层坐标）
+ * @param level 读取的层级
+ * @param tileSize 分析瓦片的边长
+ * @details 区域包围盒覆盖的瓦片都加入列表，与多边形不相交的瓦片在processTile中跳过读取
+ */
+RegionAnalysis::RegionAnalysis(std::weak_ptr<MultiResolutionImage> img, const QPolygonF& polygon, unsigned int level, unsigned int tileSize) :
+    QObject(),
+    _img(img),
+    _level(level),
+    _tileSize(tileSize ? tileSize : 512),
+    _downsample(1.),
+    _levelWidth(0),
+    _levelHeight(0),
+    _channels(0),
+    _luminanceThreshold(220. / 255.),
+    _chromaThreshold(15. / 255.),
+    _nextTile(0),
+    _tilesDone(0),
+    _cancelled(false)
+{
+    std::shared_ptr<MultiResolutionImage> local_img = _img.lock();
+    if (!local_img || level >= static_cast<unsigned int>(local_img->getNumberOfLevels()) || polygon.size() < 3) {
+        return;
+    }
+    _downsample = local_img->getLevelDownsample(level);
+    const std::vector<unsigned long long> dims = local_img->getLevelDimensions(level);
+    _levelWidth = dims[0];
+    _levelHeight = dims[1];
+    _levelPolygon.reserve(polygon.size());
+    for (const QPointF& point : polygon) {
+        _levelPolygon.append(point / _downsample);
+    }
+
+    _channels = local_img->getSamplesPerPixel();
+    for (unsigned int c = 0; c < _channels; ++c) {
+        const double minValue = local_img->getMinValue(c);
+        const double maxValue = local_img->getMaxValue(c);
+        _channelMin.push_back(minValue);
+        _channelScale.push_back(maxValue > minValue ? 1. / (maxValue - minValue) : 1.);
+    }
+    _statistics.channels = _channels;
+    _statistics.histograms.assign(static_cast<size_t>(_channels) * RegionStatistics::kHistogramBins, 0);
+    _statistics.sums.assign(_channels, 0.);
+    _statistics.tissueSums.assign(_channels, 0.);
+
+    const QRectF bounds = _levelPolygon.boundingRect();
+    const long long firstX = std::max(0LL, static_cast<long long>(std::floor(bounds.left() / _tileSize)));
+    const long long firstY = std::max(0LL, static_cast<long long>(std::floor(bounds.top() / _tileSize)));
+    const long long lastX = std::min(static_cast<long long>((_levelWidth + _tileSize - 1) / _tileSize) - 1, static_cast<long long>(std::floor(bounds.right() / _tileSize)));
+    const long long lastY = std::min(static_cast<long long>((_levelHeight + _tileSize - 1) / _tileSize) - 1, static_cast<long long>(std::floor(bounds.bottom() / _tileSize)));
+    for (long long y = firstY; y <= lastY; ++y) {
+        for (long long x = firstX; x <= lastX; ++x) {
+            _tiles.push_back(std::make_pair(x, y));
+        }
+    }
+}
+
+/**
+ * @brief 设置组织判定阈值
+ * @param luminance 亮度阈值
+ * @param chroma 色度阈值
+ */
+void RegionAnalysis::setTissueThresholds(double luminance, double chroma)
+{
+    _luminanceThreshold = luminance;
+    _chromaThreshold = chroma;
+}
+
+/**
+ * @brief 领取并处理下一个瓦片
+ * @return 没有剩余瓦片时返回false
+ */
+bool RegionAnalysis::processNextTile()
+{
+    const unsigned int index = _nextTile++;
+    if (index >= _tiles.size()) {
+        return false;
+    }
+    processTile(_tiles[index].first, _tiles[index].second);
+    return true;
+}
+
+/**
+ * @brief 取消分析
+ */
+void RegionAnalysis::cancel()
+{
+    _cancelled = true;
+}
+
+/**
+ * @brief 获取当前的统计结果
+ * @return 统计结果副本
+ */
+RegionStatistics RegionAnalysis::getStatistics() const
+{
+    QMutexLocker locker(&_mutex);
+    return _statistics;
+}
+
+/**
+ * @brief 完成一个瓦片
+ */
+void RegionAnalysis::tileDone()
+{
+    const unsigned int done = ++_tilesDone;
+    const unsigned int total = static_cast<unsigned int>(_tiles.size());
+    emit progressChanged(done, total);
+    if (done == total) {
+        emit finished();
+    }
+}
+
+/**
+ * @brief 计算多边形在瓦片内每一行的像素区间
+ * @return 是否有像素在多边形内
+ * @details 先筛选与瓦片行范围相交的边，再对每行像素中心求交点；
+ *          像素中心落在交点对之间的像素属于多边形（奇偶规则）
+ */
+bool RegionAnalysis::computeSpans(double x0, double y0, int width, int height,
+    std::vector<std::pair<int, int> >& spans, std::vector<unsigned int>& rowStart) const
+{
+    std::vector<std::pair<QPointF, QPointF> > edges;
+    const int nrPoints = _levelPolygon.size();
+    for (int i = 0; i < nrPoints; ++i) {
+        const QPointF& a = _levelPolygon.at(i);
+        const QPointF& b = _levelPolygon.at((i + 1) % nrPoints);
+        if (std::max(a.y(), b.y()) >= y0 && std::min(a.y(), b.y()) <= y0 + height && a.y() != b.y()) {
+            edges.push_back(std::make_pair(a, b));
+        }
+    }
+    spans.clear();
+    rowStart.assign(height + 1, 0);
+    std::vector<double> crossings;
+    for (int row = 0; row < height; ++row) {
+        const double yc = y0 + row + 0.5;
+        crossings.clear();
+        for (const auto& edge : edges) {
+            const QPointF& a = edge.first;
+            const QPointF& b = edge.second;
+            if ((a.y() <= yc) != (b.y() <= yc)) {
+                crossings.push_back(a.x() + (yc - a.y()) * (b.x() - a.x()) / (b.y() - a.y()));
+            }
+        }
+        std::sort(crossings.begin(), crossings.end());
+        for (size_t k = 0; k + 1 < crossings.size(); k += 2) {
+            const int start = std::max(0, static_cast<int>(std::ceil(crossings[k] - x0 - 0.5)));
+            const int end = std::min(width, static_cast<int>(std::ceil(crossings[k + 1] - x0 - 0.5)));
+            if (start < end) {
+                spans.push_back(std::make_pair(start, end));
+            }
+        }
+        rowStart[row + 1] = static_cast<unsigned int>(spans.size());
+    }
+    return !spans.empty();
+}
+
+/**
+ * @brief 处理一个瓦片
+ * @param tileX 瓦片X坐标
+ * @param tileY 瓦片Y坐标
+ * @details 以float读取使各数据类型共用一套统计代码；统计先在本地累计，最后一次性合并，
+ *          互斥锁只在合并时持有
+ */
+void RegionAnalysis::processTile(long long tileX, long long tileY)
+{
+    std::shared_ptr<MultiResolutionImage> local_img = _img.lock();
+    if (_cancelled || !local_img || _channels == 0) {
+        tileDone();
+        return;
+    }
+    const long long x0 = tileX * _tileSize;
+    const long long y0 = tileY * _tileSize;
+    const int width = static_cast<int>(std::min<long long>(_tileSize, static_cast<long long>(_levelWidth) - x0));
+    const int height = static_cast<int>(std::min<long long>(_tileSize, static_cast<long long>(_levelHeight) - y0));
+    std::vector<std::pair<int, int> > spans;
+    std::vector<unsigned int> rowStart;
+    if (width <= 0 || height <= 0 || !computeSpans(static_cast<double>(x0), static_cast<double>(y0), width, height, spans, rowStart)) {
+        tileDone();
+        return;
+    }
+
+    TileBuffer<float> buffer(static_cast<size_t>(width) * height * _channels);
+    float* data = buffer.get();
+    if (!local_img->readRegion<float>(static_cast<long long>(x0 * _downsample), static_cast<long long>(y0 * _downsample), width, height, _level, data)) {
+        tileDone();
+        return;
+    }
+
+    const unsigned int bins = RegionStatistics::kHistogramBins;
+    std::vector<unsigned long long> histograms(static_cast<size_t>(_channels) * bins, 0);
+    std::vector<double> sums(_channels, 0.), tissueSums(_channels, 0.);
+    std::vector<double> normalized(_channels);
+    unsigned long long pixels = 0, tissuePixels = 0;
+    for (int row = 0; row < height; ++row) {
+        for (unsigned int s = rowStart[row]; s < rowStart[row + 1]; ++s) {
+            const float* sample = data + (static_cast<size_t>(row) * width + spans[s].first) * _channels;
+            for (int column = spans[s].first; column < spans[s].second; ++column, sample += _channels) {
+                for (unsigned int c = 0; c < _channels; ++c) {
+                    const double value = std::min(1., std::max(0., (sample[c] - _channelMin[c]) * _channelScale[c]));
+                    normalized[c] = value;
+                    sums[c] += value;
+                    ++histograms[c * bins + std::min(bins - 1, static_cast<unsigned int>(value * bins))];
+                }
+                bool tissue;
+                if (_channels >= 3) {
+                    const double luminance = 0.299 * normalized[0] + 0.587 * normalized[1] + 0.114 * normalized[2];
+                    const double chroma = std::max(normalized[0], std::max(normalized[1], normalized[2])) -
+                        std::min(normalized[0], std::min(normalized[1], normalized[2]));
+                    tissue = luminance < _luminanceThreshold || chroma > _chromaThreshold;
+                }
+                else {
+                    tissue = normalized[0] < _luminanceThreshold;
+                }
+                if (tissue) {
+                    ++tissuePixels;
+                    for (unsigned int c = 0; c < _channels; ++c) {
+                        tissueSums[c] += normalized[c];
+                    }
+                }
+                ++pixels;
+            }
+        }
+    }
+
+    {
+        QMutexLocker locker(&_mutex);
+        _statistics.pixels += pixels;
+        _statistics.tissuePixels += tissuePixels;
+        for (size_t i = 0; i < histograms.size(); ++i) {
+            _statistics.histograms[i] += histograms[i];
+        }
+        for (unsigned int c = 0; c < _channels; ++c) {
+            _statistics.sums[c] += sums[c];
+            _statistics.tissueSums[c] += tissueSums[c];
+        }
+    }
+    tileDone();
+}
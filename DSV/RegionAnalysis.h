@@ -0,0 +1,228 @@
+﻿/**
+ * @file    RegionAnalysis.h
+ * @brief   区域分析类，在IO线程池中统计标注区域内的像素
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了标注区域的后台像素分析，包括：
+ *          - 按所选层级的瓦片网格把区域拆分为IO线程池中的分析任务
+ *          - 扫描线判断多边形内的像素，只读取与多边形相交的瓦片
+ *          - 统计各通道直方图、平均强度和组织/背景比例
+ *          - 每完成一个瓦片合并一次结果并发出进度信号
+ *
+ * @note    分析任务排在视野瓦片任务之后，不与显示争抢工作线程；读取经过解码瓦片缓存
+ * @see     IOThread, TileTask, MultiResolutionImage::readRegion
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QPolygonF>
+#include <QMutex>
+#include "TileTask.h"
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
+class MultiResolutionImage;
+
+/**
+ * @struct RegionStatistics
+ * @brief  区域统计结果
+ * @details 强度按通道的最小值和最大值归一化到[0, 1]，直方图在该范围内等分kHistogramBins个区间
+ */
+struct RegionStatistics
+{
+    /** @brief 直方图区间数 */
+    static const unsigned int kHistogramBins = 256;
+
+    /** @brief 通道数 */
+    unsigned int channels = 0;
+
+    /** @brief 区域内的像素数 */
+    unsigned long long pixels = 0;
+
+    /** @brief 区域内被判为组织的像素数 */
+    unsigned long long tissuePixels = 0;
+
+    /** @brief 各通道直方图，channels x kHistogramBins */
+    std::vector<unsigned long long> histograms;
+
+    /** @brief 各通道归一化强度之和 */
+    std::vector<double> sums;
+
+    /** @brief 组织像素各通道归一化强度之和 */
+    std::vector<double> tissueSums;
+
+    /**
+     * @brief   获取通道平均强度
+     * @param   channel 通道索引
+     * @return  归一化平均强度
+     */
+    double mean(unsigned int channel) const { return pixels && channel < channels ? sums[channel] / pixels : 0.; }
+
+    /**
+     * @brief   获取组织像素的通道平均强度
+     * @param   channel 通道索引
+     * @return  归一化平均强度
+     */
+    double tissueMean(unsigned int channel) const { return tissuePixels && channel < channels ? tissueSums[channel] / tissuePixels : 0.; }
+
+    /**
+     * @brief   获取组织比例
+     * @return  组织像素占区域像素的比例
+     */
+    double tissueFraction() const { return pixels ? static_cast<double>(tissuePixels) / pixels : 0.; }
+
+    /**
+     * @brief   获取直方图计数
+     * @param   channel 通道索引
+     * @param   bin 区间索引
+     * @return  像素数
+     */
+    unsigned long long histogram(unsigned int channel, unsigned int bin) const { return histograms[channel * kHistogramBins + bin]; }
+};
+
+/**
+ * @class  RegionAnalysis
+ * @brief  一次区域分析
+ * @details 构造时确定分析的瓦片列表，由IOThread::addTileTask投放到工作线程；
+ *          工作线程通过processNextTile按列表顺序领取瓦片，结果合并到共享的统计中。
+ *          所有瓦片完成后发出finished，取消后未处理的瓦片直接跳过。
+ *
+ *          组织判定：RGB图像亮度低于亮度阈值或色度高于色度阈值，单通道图像强度低于亮度阈值。
+ *          默认阈值对应明场切片的白色背景（220/255和15/255）。
+ *
+ * @example
+ *          std::shared_ptr<RegionAnalysis> analysis = viewer->analyzeRegion(contour->mapToScene(contour->polygon()), level);
+ *          connect(analysis.get(), &RegionAnalysis::progressChanged, this, [analysis](unsigned int done, unsigned int total) {
+ *              RegionStatistics statistics = analysis->getStatistics();
+ *              // 显示statistics.tissueFraction()等
+ *          });
+ * @see     IOThread, RegionStatistics
+ */
+class RegionAnalysis : public QObject, public TileTask
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief   构造函数
+     * @param   img 图像
+     * @param   polygon 分析区域（第0层坐标）
+     * @param   level 读取的层级
+     * @param   tileSize 分析瓦片的边长（该层级像素）
+     */
+    RegionAnalysis(std::weak_ptr<MultiResolutionImage> img, const QPolygonF& polygon, unsigned int level, unsigned int tileSize = 512);
+
+    /**
+     * @brief   设置组织判定阈值
+     * @param   luminance 亮度阈值（归一化）
+     * @param   chroma 色度阈值（归一化）
+     * @note    应在投放任务之前调用
+     */
+    void setTissueThresholds(double luminance, double chroma);
+
+    /**
+     * @brief   获取需要分析的瓦片
+     * @return  瓦片坐标（该层级的瓦片网格）
+     */
+    const std::vector<std::pair<long long, long long> >& getTiles() const { return _tiles; }
+
+    /** @brief 获取读取的层级 */
+    unsigned int getLevel() const { return _level; }
+
+    /** @brief 获取分析瓦片的边长 */
+    unsigned int getTileSize() const { return _tileSize; }
+
+    /**
+     * @brief   领取并处理下一个瓦片
+     * @return  没有剩余瓦片时返回false
+     * @see     TileTask::processNextTile
+     */
+    bool processNextTile() override;
+
+    /**
+     * @brief   取消分析
+     * @details 尚未处理的瓦片直接计为完成，不再读取数据
+     */
+    void cancel() override;
+
+    /** @brief 获取瓦片总数 */
+    unsigned int getNumberOfTiles() const override { return static_cast<unsigned int>(_tiles.size()); }
+
+    /** @brief 是否已取消 */
+    bool isCancelled() const { return _cancelled; }
+
+    /** @brief 是否已处理全部瓦片 */
+    bool isFinished() const { return _tilesDone >= _tiles.size(); }
+
+    /**
+     * @brief   获取当前的统计结果
+     * @return  已处理瓦片的统计结果的副本
+     */
+    RegionStatistics getStatistics() const;
+
+signals:
+    /**
+     * @brief   进度信号
+     * @param   tilesDone 已完成的瓦片数
+     * @param   nrTiles 瓦片总数
+     * @details 从工作线程发出，跨线程连接时以队列方式送达
+     */
+    void progressChanged(unsigned int tilesDone, unsigned int nrTiles);
+
+    /**
+     * @brief   完成信号
+     * @details 所有瓦片处理完（包括取消后跳过）时发出一次
+     */
+    void finished();
+
+private:
+    /**
+     * @brief   处理一个瓦片
+     * @param   tileX 瓦片X坐标
+     * @param   tileY 瓦片Y坐标
+     * @details 在工作线程中调用；先计算多边形在瓦片内的扫描线区间，没有像素在多边形内时不读取数据
+     */
+    void processTile(long long tileX, long long tileY);
+
+    /**
+     * @brief   计算多边形在瓦片内每一行的像素区间
+     * @param   x0 瓦片左上角X（该层级像素）
+     * @param   y0 瓦片左上角Y（该层级像素）
+     * @param   width 瓦片宽度
+     * @param   height 瓦片高度
+     * @param   spans 输出，每行的[起始, 结束)区间列表，按行依次存放
+     * @param   rowStart 输出，每行在spans中的起始位置，长度height+1
+     * @return  是否有像素在多边形内（奇偶规则）
+     */
+    bool computeSpans(double x0, double y0, int width, int height,
+        std::vector<std::pair<int, int> >& spans, std::vector<unsigned int>& rowStart) const;
+
+    /**
+     * @brief   完成一个瓦片，更新进度并在最后一个瓦片时发出完成信号
+     */
+    void tileDone();
+
+    std::weak_ptr<MultiResolutionImage> _img;
+    QPolygonF _levelPolygon;
+    unsigned int _level;
+    unsigned int _tileSize;
+    double _downsample;
+    unsigned long long _levelWidth;
+    unsigned long long _levelHeight;
+    unsigned int _channels;
+    std::vector<double> _channelMin;
+    std::vector<double> _channelScale;
+    double _luminanceThreshold;
+    double _chromaThreshold;
+    std::vector<std::pair<long long, long long> > _tiles;
+
+    mutable QMutex _mutex;
+    RegionStatistics _statistics;
+    std::atomic<unsigned int> _nextTile;
+    std::atomic<unsigned int> _tilesDone;
+    std::atomic<bool> _cancelled;
+};
@@ -0,0 +1,477 @@
+﻿/**
+ * @file RegionExport.cpp
+ * @brief 区域导出类实现文件
+ * @details 该文件实现了导出区域的瓦片渲染和金字塔合成，包括：
+ *          - 输出瓦片和金字塔层级的计算
+ *          - 背景、前景和标注的逐瓦片渲染
+ *          - 低分辨率层级瓦片的边写边合成
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "RegionExport.h"
+#include "MultiResolutionImage.h"
+#include "TileBufferPool.h"
+#include <QMutexLocker>
+#include <QPainter>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief 构造函数
+ * @param img 图像
+ * @param rect 导出区域（第0层坐标）
+ * @param level 读取的层级
+ * @param fileName 输出文件路径
+ * @param tileSize 输出瓦片边长
+ */
+RegionExport::RegionExport(std::weak_ptr<MultiResolutionImage> img, const QRectF& rect, unsigned int level, const QString& fileName, unsigned int tileSize) :
+    QObject(),
+    _img(img),
+    _rect(rect),
+    _level(level),
+    _fileName(fileName),
+    _tileSize(tileSize >= 16 ? tileSize / 16 * 16 : 256),
+    _downsample(1.),
+    _x0(0),
+    _y0(0),
+    _width(0),
+    _height(0),
+    _tilesAcross(0),
+    _tilesDown(0),
+    _backgroundColor(Qt::white),
+    _compression(TiledTiffWriter::JPEG),
+    _jpegQuality(90),
+    _pyramid(true),
+    _nrLevels(0),
+    _backgroundChannel(0),
+    _foregroundScale(1.),
+    _foregroundChannel(0),
+    _foregroundOpacity(1.),
+    _nextTile(0),
+    _tilesDone(0),
+    _cancelled(false),
+    _failed(false)
+{
+}
+
+/**
+ * @brief 设置压缩方式
+ */
+void RegionExport::setCompression(TiledTiffWriter::Compression compression, int jpegQuality)
+{
+    _compression = compression;
+    _jpegQuality = jpegQuality;
+}
+
+/**
+ * @brief 设置是否写出低分辨率层级
+ */
+void RegionExport::setPyramid(bool pyramid)
+{
+    _pyramid = pyramid;
+}
+
+/**
+ * @brief 设置非RGB背景的渲染方式
+ */
+void RegionExport::setBackgroundRendering(int channel, std::shared_ptr<const std::vector<PixelConversion::CompositeChannel> > composite)
+{
+    _backgroundChannel = channel;
+    _channelComposite = composite;
+}
+
+/**
+ * @brief 设置前景叠加
+ */
+void RegionExport::setForeground(std::weak_ptr<MultiResolutionImage> img, float scale, int channel, const SlideColorManagement::LUT& LUT, float opacity)
+{
+    _foregroundImage = img;
+    _foregroundScale = scale;
+    _foregroundChannel = channel;
+    _LUT = LUT;
+    _foregroundOpacity = opacity;
+}
+
+/**
+ * @brief 设置叠加的标注
+ * @details 包围盒按线宽在start中换算到第0层后外扩
+ */
+void RegionExport::setAnnotations(const std::vector<AnnotationRecord>& annotations)
+{
+    _annotations.clear();
+    for (const AnnotationRecord& annotation : annotations) {
+        if (!annotation.points.isEmpty()) {
+            _annotations.push_back(annotation);
+        }
+    }
+}
+
+/**
+ * @brief 创建输出文件并确定瓦片
+ * @details 区域对齐到所选层级的像素并裁剪到层级范围；
+ *          金字塔每级宽高减半（向上取整），直到一个瓦片能容纳整层
+ */
+bool RegionExport::start()
+{
+    std::shared_ptr<MultiResolutionImage> local_img = _img.lock();
+    if (!local_img || _level >= static_cast<unsigned int>(local_img->getNumberOfLevels())) {
+        return false;
+    }
+    _downsample = local_img->getLevelDownsample(_level);
+    const std::vector<unsigned long long> dims = local_img->getLevelDimensions(_level);
+    _x0 = std::max(0LL, static_cast<long long>(std::floor(_rect.left() / _downsample)));
+    _y0 = std::max(0LL, static_cast<long long>(std::floor(_rect.top() / _downsample)));
+    const long long x1 = std::min(static_cast<long long>(dims[0]), static_cast<long long>(std::ceil(_rect.right() / _downsample)));
+    const long long y1 = std::min(static_cast<long long>(dims[1]), static_cast<long long>(std::ceil(_rect.bottom() / _downsample)));
+    if (x1 <= _x0 || y1 <= _y0) {
+        return false;
+    }
+    _width = x1 - _x0;
+    _height = y1 - _y0;
+    _tilesAcross = (_width + _tileSize - 1) / _tileSize;
+    _tilesDown = (_height + _tileSize - 1) / _tileSize;
+
+    unsigned char bgR, bgG, bgB;
+    local_img->getBackgroundColor(bgR, bgG, bgB);
+    _backgroundColor = QColor(bgR, bgG, bgB);
+
+    std::shared_ptr<MultiResolutionImage> local_for_img = _foregroundImage.lock();
+    if (local_for_img && _foregroundOpacity > 0.0001) {
+        const int channel = std::max(0, _foregroundChannel);
+        double channelMin, channelMax;
+        local_for_img->getChannelRange(channel, channelMin, channelMax);
+        switch (local_for_img->getDataType()) {
+        case SlideColorManagement::DataType::UChar: _foregroundTable.compile<unsigned char>(_LUT, channelMin, channelMax, 0); break;
+        case SlideColorManagement::DataType::UInt16: _foregroundTable.compile<unsigned short>(_LUT, channelMin, channelMax, 0); break;
+        case SlideColorManagement::DataType::UInt32: _foregroundTable.compile<unsigned int>(_LUT, channelMin, channelMax, 0); break;
+        case SlideColorManagement::DataType::Float: _foregroundTable.compile<float>(_LUT, channelMin, channelMax, 0); break;
+        default: _foregroundImage.reset(); break;
+        }
+    }
+    else {
+        _foregroundImage.reset();
+    }
+
+    _annotationBounds.clear();
+    for (const AnnotationRecord& annotation : _annotations) {
+        const double margin = (annotation.lineWidth + 2) * _downsample;
+        QRectF bounds = annotation.bounds().adjusted(-margin, -margin, margin, margin);
+        if (annotation.type == RenderElement::Text || annotation.type == RenderElement::Comment) {
+            // 文字以屏幕像素大小绘制，包围盒按一个瓦片估计
+            bounds = QRectF(annotation.points.first(), QSizeF(_tileSize * _downsample, _tileSize * _downsample));
+        }
+        _annotationBounds.push_back(bounds);
+    }
+
+    if (!_writer.open(_fileName, _compression, _jpegQuality)) {
+        return false;
+    }
+    const std::vector<double> spacing = local_img->getSpacing();
+    double mpp = spacing.empty() ? 0. : spacing[0] * _downsample;
+    unsigned long long levelWidth = _width;
+    unsigned long long levelHeight = _height;
+    _levelTilesAcross.clear();
+    _levelTilesDown.clear();
+    do {
+        _writer.addLevel(levelWidth, levelHeight, _tileSize, mpp);
+        _levelTilesAcross.push_back((levelWidth + _tileSize - 1) / _tileSize);
+        _levelTilesDown.push_back((levelHeight + _tileSize - 1) / _tileSize);
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+        mpp *= 2.;
+    } while (_pyramid && std::max(_levelTilesAcross.back(), _levelTilesDown.back()) > 1);
+    _nrLevels = static_cast<int>(_levelTilesAcross.size());
+    _writer.setDescription(QStringLiteral("DSV region export|level = %1|x = %2|y = %3|downsample = %4")
+        .arg(_level).arg(_x0).arg(_y0).arg(_downsample));
+    return true;
+}
+
+/**
+ * @brief 领取并处理下一个输出瓦片
+ * @details 按行优先顺序领取，使上一层级待合成的瓦片最多约一行
+ */
+bool RegionExport::processNextTile()
+{
+    const unsigned int index = _nextTile++;
+    if (index >= getNumberOfTiles()) {
+        return false;
+    }
+    const unsigned long long tileX = index % _tilesAcross;
+    const unsigned long long tileY = index / _tilesAcross;
+    if (!_cancelled && !_failed) {
+        const QImage tile = renderTile(tileX, tileY);
+        if (!_writer.writeTile(0, tileX, tileY, tile)) {
+            _failed = true;
+        }
+        else {
+            addToPyramid(0, tileX, tileY, tile);
+        }
+    }
+    tileDone();
+    return true;
+}
+
+/**
+ * @brief 取消导出
+ */
+void RegionExport::cancel()
+{
+    _cancelled = true;
+}
+
+/**
+ * @brief 完成一个第0层瓦片
+ * @details 金字塔合成在写入第0层瓦片的同一线程中同步完成，
+ *          因此最后一个瓦片完成时所有层级都已写入
+ */
+void RegionExport::tileDone()
+{
+    const unsigned int done = ++_tilesDone;
+    const unsigned int total = getNumberOfTiles();
+    emit progressChanged(done, total);
+    if (done == total) {
+        {
+            QMutexLocker locker(&_pyramidMutex);
+            _pending.clear();
+        }
+        bool success = false;
+        if (_cancelled || _failed) {
+            _writer.abort();
+        }
+        else {
+            success = _writer.close();
+            if (!success) {
+                _writer.abort();
+            }
+        }
+        emit finished(success);
+    }
+}
+
+/**
+ * @brief 渲染一个第0层输出瓦片
+ */
+QImage RegionExport::renderTile(unsigned long long tileX, unsigned long long tileY)
+{
+    QImage tile(_tileSize, _tileSize, QImage::Format_ARGB32_Premultiplied);
+    tile.fill(_backgroundColor);
+    std::shared_ptr<MultiResolutionImage> local_img = _img.lock();
+    if (!local_img) {
+        _failed = true;
+        return tile;
+    }
+    const long long x = _x0 + static_cast<long long>(tileX * _tileSize);
+    const long long y = _y0 + static_cast<long long>(tileY * _tileSize);
+    const int width = static_cast<int>(std::min<unsigned long long>(_tileSize, _width - tileX * _tileSize));
+    const int height = static_cast<int>(std::min<unsigned long long>(_tileSize, _height - tileY * _tileSize));
+
+    QImage background;
+    switch (local_img->getDataType()) {
+    case SlideColorManagement::DataType::UChar: background = renderBackground<unsigned char>(local_img.get(), x, y, width, height); break;
+    case SlideColorManagement::DataType::UInt16: background = renderBackground<unsigned short>(local_img.get(), x, y, width, height); break;
+    case SlideColorManagement::DataType::UInt32: background = renderBackground<unsigned int>(local_img.get(), x, y, width, height); break;
+    case SlideColorManagement::DataType::Float: background = renderBackground<float>(local_img.get(), x, y, width, height); break;
+    default: break;
+    }
+
+    QPainter painter(&tile);
+    painter.setClipRect(0, 0, width, height);
+    if (!background.isNull()) {
+        painter.drawImage(0, 0, background);
+    }
+    if (std::shared_ptr<MultiResolutionImage> local_for_img = _foregroundImage.lock()) {
+        QImage foreground;
+        switch (local_for_img->getDataType()) {
+        case SlideColorManagement::DataType::UChar: foreground = renderForeground<unsigned char>(local_for_img.get(), x, y, width, height); break;
+        case SlideColorManagement::DataType::UInt16: foreground = renderForeground<unsigned short>(local_for_img.get(), x, y, width, height); break;
+        case SlideColorManagement::DataType::UInt32: foreground = renderForeground<unsigned int>(local_for_img.get(), x, y, width, height); break;
+        case SlideColorManagement::DataType::Float: foreground = renderForeground<float>(local_for_img.get(), x, y, width, height); break;
+        default: break;
+        }
+        if (!foreground.isNull()) {
+            painter.setOpacity(_foregroundOpacity);
+            painter.drawImage(QRect(0, 0, width, height), foreground);
+            painter.setOpacity(1.);
+        }
+    }
+    paintAnnotations(painter, x, y, width, height);
+    return tile;
+}
+
+template<typename T>
+QImage RegionExport::renderBackground(MultiResolutionImage* img, long long x, long long y, int width, int height) const
+{
+    const long long startX = std::llround(x * _downsample);
+    const long long startY = std::llround(y * _downsample);
+    const SlideColorManagement::ColorType colorType = img->getColorType();
+    if (colorType == SlideColorManagement::ColorType::RGB && img->getDataType() == SlideColorManagement::DataType::UChar) {
+        QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+        if (img->getARGB32Region(startX, startY, width, height, _level, reinterpret_cast<unsigned int*>(image.bits()))) {
+            return image;
+        }
+    }
+    const unsigned int samplesPerPixel = img->getSamplesPerPixel();
+    const unsigned long long nrPixels = static_cast<unsigned long long>(width) * height;
+    TileBuffer<T> buffer(static_cast<size_t>(nrPixels) * samplesPerPixel);
+    T* data = buffer.get();
+    img->getRawRegion(startX, startY, width, height, _level, data);
+    if (colorType == SlideColorManagement::ColorType::RGB) {
+        return QImage(reinterpret_cast<unsigned char*>(data), width, height, width * 3, QImage::Format_RGB888).convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+    if (colorType == SlideColorManagement::ColorType::RGBA) {
+        return QImage(reinterpret_cast<unsigned char*>(data), width, height, width * 4, QImage::Format_RGBA8888).convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+    QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+    if (_channelComposite) {
+        PixelConversion::compositeChannelsToARGB32(data, nrPixels, samplesPerPixel,
+            _channelComposite->data(), static_cast<unsigned int>(_channelComposite->size()), reinterpret_cast<unsigned int*>(image.bits()));
+    }
+    else {
+        double channelMin, channelMax;
+        img->getChannelRange(_backgroundChannel, channelMin, channelMax);
+        PixelConversion::windowLevelToARGB32(data, nrPixels, _backgroundChannel, samplesPerPixel,
+            channelMin, channelMax, nullptr, reinterpret_cast<unsigned int*>(image.bits()));
+    }
+    return image;
+}
+
+template<typename T>
+QImage RegionExport::renderForeground(MultiResolutionImage* img, long long x, long long y, int width, int height) const
+{
+    std::shared_ptr<MultiResolutionImage> local_bck_img = _img.lock();
+    if (!local_bck_img) {
+        return QImage();
+    }
+    const int levelDifference = local_bck_img->getBestLevelForDownSample(_foregroundScale);
+    int fgLevel = static_cast<int>(_level) - levelDifference;
+    if (fgLevel >= img->getNumberOfLevels()) {
+        fgLevel = img->getNumberOfLevels() - 1;
+    }
+    else if (fgLevel < 0) {
+        fgLevel = 0;
+    }
+    const double extraScaling = img->getLevelDimensions(fgLevel)[0] / static_cast<double>(local_bck_img->getLevelDimensions(_level)[0]);
+    const double fgDownsample = img->getLevelDownsample(fgLevel);
+    const int fgWidth = std::max(1, static_cast<int>(std::ceil(width * extraScaling)));
+    const int fgHeight = std::max(1, static_cast<int>(std::ceil(height * extraScaling)));
+    const unsigned int samplesPerPixel = img->getSamplesPerPixel();
+    TileBuffer<T> buffer(static_cast<size_t>(fgWidth) * fgHeight * samplesPerPixel);
+    img->getRawRegion(static_cast<long long>(x * extraScaling * fgDownsample), static_cast<long long>(y * extraScaling * fgDownsample),
+        fgWidth, fgHeight, fgLevel, buffer.get());
+    return convertMonochromeToRGB(buffer.get(), fgWidth, fgHeight, std::max(0, _foregroundChannel), samplesPerPixel, _foregroundTable);
+}
+
+/**
+ * @brief 绘制与区域相交的标注
+ * @details 坐标从第0层换算到瓦片像素；线宽与屏幕显示一样为输出像素，不随层级缩放
+ */
+void RegionExport::paintAnnotations(QPainter& painter, long long x, long long y, int width, int height) const
+{
+    if (_annotations.empty()) {
+        return;
+    }
+    const QRectF tileRect(x * _downsample, y * _downsample, width * _downsample, height * _downsample);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    for (size_t i = 0; i < _annotations.size(); ++i) {
+        if (!_annotationBounds[i].intersects(tileRect)) {
+            continue;
+        }
+        const AnnotationRecord& annotation = _annotations[i];
+        QPolygonF points;
+        points.reserve(annotation.points.size());
+        for (const QPointF& point : annotation.points) {
+            points.append(QPointF(point.x() / _downsample - x, point.y() / _downsample - y));
+        }
+        QPen pen(annotation.color, annotation.lineWidth);
+        painter.setPen(pen);
+        painter.setBrush(Qt::NoBrush);
+        switch (annotation.type) {
+        case RenderElement::Rectangle:
+            if (points.size() >= 2) {
+                painter.drawRect(QRectF(points[0], points[1]).normalized());
+            }
+            break;
+        case RenderElement::Ellipse:
+            if (points.size() >= 2) {
+                painter.drawEllipse(QRectF(points[0], points[1]).normalized());
+            }
+            break;
+        case RenderElement::Polygon:
+        case RenderElement::Contour:
+            painter.drawPolygon(points);
+            break;
+        case RenderElement::Text:
+        case RenderElement::Comment:
+            painter.drawText(points.first(), annotation.text);
+            break;
+        case RenderElement::Arrow:
+            painter.drawPolyline(points);
+            if (points.size() >= 2) {
+                const QPointF tip = points.last();
+                const QPointF direction = tip - points[points.size() - 2];
+                const double length = std::hypot(direction.x(), direction.y());
+                if (length > 0.) {
+                    const double headLength = 6. + 3. * annotation.lineWidth;
+                    const double angle = std::atan2(direction.y(), direction.x());
+                    QPolygonF head;
+                    head << tip
+                        << tip - QPointF(std::cos(angle - M_PI / 6.), std::sin(angle - M_PI / 6.)) * headLength
+                        << tip - QPointF(std::cos(angle + M_PI / 6.), std::sin(angle + M_PI / 6.)) * headLength;
+                    painter.setBrush(annotation.color);
+                    painter.drawPolygon(head);
+                }
+            }
+            break;
+        default:
+            painter.drawPolyline(points);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief 把瓦片缩小一半放入上一层级
+ */
+void RegionExport::addToPyramid(int level, unsigned long long tileX, unsigned long long tileY, const QImage& tile)
+{
+    if (level + 1 >= _nrLevels || _cancelled || _failed) {
+        return;
+    }
+    const int half = static_cast<int>(_tileSize / 2);
+    const QImage reduced = tile.scaled(half, half, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    const unsigned long long parentX = tileX / 2;
+    const unsigned long long parentY = tileY / 2;
+    QImage complete;
+    {
+        QMutexLocker locker(&_pyramidMutex);
+        const auto key = std::make_tuple(level + 1, parentX, parentY);
+        auto it = _pending.find(key);
+        if (it == _pending.end()) {
+            PendingTile pending;
+            pending.image = QImage(_tileSize, _tileSize, QImage::Format_ARGB32_Premultiplied);
+            pending.image.fill(_backgroundColor);
+            pending.received = 0;
+            const unsigned long long childrenAcross = std::min<unsigned long long>(2, _levelTilesAcross[level] - parentX * 2);
+            const unsigned long long childrenDown = std::min<unsigned long long>(2, _levelTilesDown[level] - parentY * 2);
+            pending.expected = static_cast<unsigned int>(childrenAcross * childrenDown);
+            it = _pending.insert(std::make_pair(key, pending)).first;
+        }
+        QPainter painter(&it->second.image);
+        painter.drawImage(static_cast<int>(tileX % 2) * half, static_cast<int>(tileY % 2) * half, reduced);
+        painter.end();
+        if (++it->second.received == it->second.expected) {
+            complete = it->second.image;
+            _pending.erase(it);
+        }
+    }
+    if (!complete.isNull()) {
+        if (!_writer.writeTile(level + 1, parentX, parentY, complete)) {
+            _failed = true;
+            return;
+        }
+        addToPyramid(level + 1, parentX, parentY, complete);
+    }
+}
@@ -0,0 +1,264 @@
+﻿/**
+ * @file    RegionExport.h
+ * @brief   区域导出类，在IO线程池中把任意区域渲染为金字塔BigTIFF
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了高分辨率区域导出，包括：
+ *          - 在任意层级按原生分辨率读取区域，与显示相同的背景渲染（RGB、窗宽窗位、通道合成）
+ *          - 叠加前景图像（LUT和透明度）和矢量标注
+ *          - 按行优先顺序逐瓦片渲染并编码，随写随落盘
+ *          - 边写边合成低分辨率层级，只在内存中保留每层一行未完成的瓦片
+ *
+ * @note    导出与区域分析一样是IO线程池中的后台任务，不与显示争抢工作线程
+ * @see     TiledTiffWriter, TileTask, PathologyViewer::exportRegion
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QColor>
+#include <QImage>
+#include <QMutex>
+#include <QRectF>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+#include "TileTask.h"
+#include "TiledTiffWriter.h"
+#include "SlideColorManagement.h"
+#include "PixelConversion.h"
+#include "UtilityFunctions.h"
+#include "Item/AnnotationStore.h"
+
+class MultiResolutionImage;
+class QPainter;
+
+/**
+ * @class  RegionExport
+ * @brief  一次区域导出
+ * @details 导出区域为第0层矩形，按所选层级的像素输出。start打开文件并确定金字塔层级后，
+ *          由IOThread::addTileTask投放到工作线程；工作线程按行优先顺序领取输出瓦片，
+ *          每个瓦片渲染后立即编码写入，同时缩小一半放入上一层级待合成的瓦片，
+ *          上一层级的瓦片收齐四个子瓦片后同样写入并继续向上合成。
+ *          所有瓦片写完后写出IFD并发出finished。
+ *
+ * @example
+ *          std::shared_ptr<RegionExport> job = viewer->exportRegion(sceneRect, 0, "region.tif");
+ *          connect(job.get(), &RegionExport::progressChanged, progressBar, [progressBar](unsigned int done, unsigned int total) {
+ *              progressBar->setMaximum(total);
+ *              progressBar->setValue(done);
+ *          });
+ * @see     TiledTiffWriter, IOThread::addTileTask
+ */
+class RegionExport : public QObject, public TileTask
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief   构造函数
+     * @param   img 图像
+     * @param   rect 导出区域（第0层坐标）
+     * @param   level 读取的层级，输出分辨率为该层级的分辨率
+     * @param   fileName 输出文件路径
+     * @param   tileSize 输出瓦片边长，必须是16的倍数
+     */
+    RegionExport(std::weak_ptr<MultiResolutionImage> img, const QRectF& rect, unsigned int level, const QString& fileName, unsigned int tileSize = 256);
+
+    /**
+     * @brief   设置压缩方式
+     * @param   compression 压缩方式
+     * @param   jpegQuality JPEG质量（0-100）
+     */
+    void setCompression(TiledTiffWriter::Compression compression, int jpegQuality = 90);
+
+    /**
+     * @brief   设置是否写出低分辨率层级
+     * @param   pyramid true时逐级缩小一半，直到一个瓦片能容纳整层
+     */
+    void setPyramid(bool pyramid);
+
+    /**
+     * @brief   设置非RGB背景的渲染方式
+     * @param   channel 窗宽窗位使用的通道
+     * @param   composite 通道合成设置，非空时优先使用
+     * @see     IOThread::getChannelComposite
+     */
+    void setBackgroundRendering(int channel, std::shared_ptr<const std::vector<PixelConversion::CompositeChannel> > composite);
+
+    /**
+     * @brief   设置前景叠加
+     * @param   img 前景图像，为空时不叠加
+     * @param   scale 前景图像相对背景图像的缩放因子
+     * @param   channel 前景通道
+     * @param   LUT 前景颜色查找表
+     * @param   opacity 前景透明度
+     */
+    void setForeground(std::weak_ptr<MultiResolutionImage> img, float scale, int channel, const SlideColorManagement::LUT& LUT, float opacity);
+
+    /**
+     * @brief   设置叠加的标注
+     * @param   annotations 标注，坐标为第0层坐标
+     */
+    void setAnnotations(const std::vector<AnnotationRecord>& annotations);
+
+    /**
+     * @brief   创建输出文件并确定瓦片
+     * @return  区域有效且文件创建成功时返回true
+     * @note    在投放到IO线程池之前调用，之后不应再修改设置
+     */
+    bool start();
+
+    /**
+     * @brief   领取并处理下一个输出瓦片
+     * @return  没有剩余瓦片时返回false
+     * @see     TileTask::processNextTile
+     */
+    bool processNextTile() override;
+
+    /**
+     * @brief   取消导出
+     * @details 尚未渲染的瓦片直接计为完成，最后删除输出文件
+     */
+    void cancel() override;
+
+    /** @brief 获取第0层的瓦片数 */
+    unsigned int getNumberOfTiles() const override { return static_cast<unsigned int>(_tilesAcross * _tilesDown); }
+
+    /** @brief 获取输出文件路径 */
+    QString getFileName() const { return _fileName; }
+
+    /** @brief 获取输出宽度（像素） */
+    unsigned long long getWidth() const { return _width; }
+
+    /** @brief 获取输出高度（像素） */
+    unsigned long long getHeight() const { return _height; }
+
+    /** @brief 获取输出层级数 */
+    int getNumberOfLevels() const { return _nrLevels; }
+
+signals:
+    /**
+     * @brief   进度信号
+     * @param   tilesDone 已完成的第0层瓦片数
+     * @param   nrTiles 第0层瓦片总数
+     * @details 从工作线程发出，跨线程连接时以队列方式送达
+     */
+    void progressChanged(unsigned int tilesDone, unsigned int nrTiles);
+
+    /**
+     * @brief   完成信号
+     * @param   success 文件完整写出时为true；取消或写入失败时为false，输出文件已删除
+     */
+    void finished(bool success);
+
+private:
+    /** @brief 等待子瓦片的上一层级瓦片 */
+    struct PendingTile {
+        QImage image;
+        unsigned int received;
+        unsigned int expected;
+    };
+
+    /**
+     * @brief   渲染一个第0层输出瓦片
+     * @param   tileX 瓦片X坐标
+     * @param   tileY 瓦片Y坐标
+     * @return  tileSize x tileSize的图像，区域以外填充背景色
+     */
+    QImage renderTile(unsigned long long tileX, unsigned long long tileY);
+
+    /**
+     * @brief   读取背景
+     * @param   img 图像
+     * @param   x 区域左边（层级像素）
+     * @param   y 区域上边（层级像素）
+     * @param   width 区域宽度
+     * @param   height 区域高度
+     * @return  ARGB32_Premultiplied图像，失败时为空
+     * @details 8位RGB优先直接读取ARGB32，其余与IOWorker::convertBackgroundImage相同
+     */
+    template<typename T>
+    QImage renderBackground(MultiResolutionImage* img, long long x, long long y, int width, int height) const;
+
+    /**
+     * @brief   读取并渲染前景
+     * @return  与背景区域大小相同的图像，失败时为空
+     * @details 前景层级的选择与IOWorker::getForegroundTile相同
+     */
+    template<typename T>
+    QImage renderForeground(MultiResolutionImage* img, long long x, long long y, int width, int height) const;
+
+    /**
+     * @brief   绘制与区域相交的标注
+     * @param   painter 绘制在瓦片图像上的绘制器
+     * @param   x 瓦片左边（层级像素）
+     * @param   y 瓦片上边（层级像素）
+     * @param   width 瓦片宽度
+     * @param   height 瓦片高度
+     */
+    void paintAnnotations(QPainter& painter, long long x, long long y, int width, int height) const;
+
+    /**
+     * @brief   把瓦片缩小一半放入上一层级
+     * @param   level 瓦片所在层级
+     * @param   tileX 瓦片X坐标
+     * @param   tileY 瓦片Y坐标
+     * @param   tile 瓦片图像
+     * @details 上一层级的瓦片收齐后写入文件并递归向上合成
+     */
+    void addToPyramid(int level, unsigned long long tileX, unsigned long long tileY, const QImage& tile);
+
+    /**
+     * @brief   完成一个第0层瓦片，最后一个瓦片完成时关闭文件并发出完成信号
+     */
+    void tileDone();
+
+    std::weak_ptr<MultiResolutionImage> _img;
+    QRectF _rect;
+    unsigned int _level;
+    QString _fileName;
+    unsigned int _tileSize;
+    double _downsample;
+    long long _x0;
+    long long _y0;
+    unsigned long long _width;
+    unsigned long long _height;
+    unsigned long long _tilesAcross;
+    unsigned long long _tilesDown;
+    QColor _backgroundColor;
+
+    TiledTiffWriter::Compression _compression;
+    int _jpegQuality;
+    bool _pyramid;
+    int _nrLevels;
+    std::vector<unsigned long long> _levelTilesAcross;
+    std::vector<unsigned long long> _levelTilesDown;
+
+    int _backgroundChannel;
+    std::shared_ptr<const std::vector<PixelConversion::CompositeChannel> > _channelComposite;
+
+    std::weak_ptr<MultiResolutionImage> _foregroundImage;
+    float _foregroundScale;
+    int _foregroundChannel;
+    SlideColorManagement::LUT _LUT;
+    float _foregroundOpacity;
+    /** @brief 按前景数据类型在start中编译，之后只读 */
+    DenseLUT _foregroundTable;
+
+    std::vector<AnnotationRecord> _annotations;
+    /** @brief 标注的第0层包围盒，已按线宽外扩 */
+    std::vector<QRectF> _annotationBounds;
+
+    TiledTiffWriter _writer;
+    QMutex _pyramidMutex;
+    std::map<std::tuple<int, unsigned long long, unsigned long long>, PendingTile> _pending;
+
+    std::atomic<unsigned int> _nextTile;
+    std::atomic<unsigned int> _tilesDone;
+    std::atomic<bool> _cancelled;
+    std::atomic<bool> _failed;
+};
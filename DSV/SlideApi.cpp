@@ -0,0 +1,285 @@
+﻿/**
+ * @file SlideApi.cpp
+ * @brief 切片读取C接口实现文件
+ * @details 用MultiResolutionImageReader打开切片，按原生数据类型把区域读入TileBufferPool的池缓冲区，
+ *          区域句柄持有切片的共享指针和缓冲区，释放时归还缓冲区。
+ *          每个导出函数都经过guarded，异常不会越过C ABI，而是转换为失败的返回值和dsv_last_error
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "SlideApi.h"
+#include "MultiResolutionImage.h"
+#include "MultiResolutionImageFactory.h"
+#include "TileBufferPool.h"
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <string>
+
+/**
+ * @brief 切片句柄
+ */
+struct DsvSlide {
+    std::shared_ptr<MultiResolutionImage> img;
+};
+
+/**
+ * @brief 区域句柄
+ * @details 持有切片的引用，关闭切片后区域仍然有效
+ */
+struct DsvRegion {
+    std::shared_ptr<MultiResolutionImage> img;
+    void* data = NULL;
+    unsigned long long shape[3] = { 0, 0, 0 };
+    int dataType = 0;
+};
+
+namespace {
+
+    /** @brief 单次读取的最大字节数，防止错误的参数耗尽内存 */
+    const unsigned long long kMaxRegionBytes = 4ULL * 1024 * 1024 * 1024;
+
+    /**
+     * @brief 当前线程最近一次失败的原因
+     */
+    std::string& lastError() {
+        thread_local std::string error;
+        return error;
+    }
+
+    /**
+     * @brief 执行导出函数的函数体并拦截异常
+     * @param failure 发生异常时的返回值
+     * @param body 函数体
+     * @return 函数体的返回值，发生异常时返回failure并记录原因
+     */
+    template <typename R, typename F>
+    R guarded(R failure, F body) {
+        try {
+            return body();
+        }
+        catch (const std::exception& e) {
+            lastError() = e.what();
+        }
+        catch (...) {
+            lastError() = "unknown error";
+        }
+        return failure;
+    }
+
+    /**
+     * @brief 执行没有返回值的导出函数的函数体并拦截异常
+     * @param body 函数体
+     */
+    template <typename F>
+    void guardedVoid(F body) {
+        guarded(0, [&]() { body(); return 0; });
+    }
+
+    /**
+     * @brief 按数据类型读取区域到池缓冲区
+     * @details 类型与原生类型相同，readRegion在缓存未命中时把解码结果直接写入该缓冲区；
+     *          读取失败或抛出异常时先归还缓冲区，失败时返回NULL并记录原因，
+     *          不把白色填充或未初始化的池内存交给调用者
+     */
+    template <typename T>
+    void* readInto(MultiResolutionImage* img, long long x, long long y, unsigned long long width, unsigned long long height, unsigned int level) {
+        T* data = TileBufferPool::allocateArray<T>(static_cast<size_t>(width * height * img->getSamplesPerPixel()));
+        bool read = false;
+        try {
+            read = img->readRegion<T>(x, y, width, height, level, data);
+        }
+        catch (...) {
+            TileBufferPool::release(data);
+            throw;
+        }
+        if (!read) {
+            TileBufferPool::release(data);
+            lastError() = "cannot read region";
+            return NULL;
+        }
+        return data;
+    }
+
+    /**
+     * @brief 获取数据类型的字节数
+     */
+    unsigned int itemSize(SlideColorManagement::DataType dataType) {
+        switch (dataType) {
+        case SlideColorManagement::DataType::UChar:
+            return 1;
+        case SlideColorManagement::DataType::UInt16:
+            return 2;
+        case SlideColorManagement::DataType::UInt32:
+        case SlideColorManagement::DataType::Float:
+            return 4;
+        default:
+            return 0;
+        }
+    }
+}
+
+DsvSlide* dsv_open(const char* path)
+{
+    return guarded<DsvSlide*>(NULL, [&]() -> DsvSlide* {
+        if (!path) {
+            lastError() = "path is NULL";
+            return NULL;
+        }
+        MultiResolutionImageReader reader;
+        std::shared_ptr<MultiResolutionImage> img(reader.open(path));
+        if (!img || !img->valid()) {
+            lastError() = std::string("cannot open ") + path;
+            return NULL;
+        }
+        std::unique_ptr<DsvSlide> slide(new DsvSlide());
+        slide->img = img;
+        return slide.release();
+    });
+}
+
+void dsv_close(DsvSlide* slide)
+{
+    guardedVoid([&]() { delete slide; });
+}
+
+int dsv_level_count(const DsvSlide* slide)
+{
+    return guarded(0, [&]() { return slide ? slide->img->getNumberOfLevels() : 0; });
+}
+
+int dsv_level_dimensions(const DsvSlide* slide, int level, unsigned long long* width, unsigned long long* height)
+{
+    return guarded(0, [&]() {
+        if (!slide || level < 0 || level >= slide->img->getNumberOfLevels()) {
+            return 0;
+        }
+        const std::vector<unsigned long long> dims = slide->img->getLevelDimensions(level);
+        if (width) {
+            *width = dims[0];
+        }
+        if (height) {
+            *height = dims[1];
+        }
+        return 1;
+    });
+}
+
+double dsv_level_downsample(const DsvSlide* slide, int level)
+{
+    return guarded(-1., [&]() {
+        if (!slide || level < 0 || level >= slide->img->getNumberOfLevels()) {
+            return -1.;
+        }
+        return slide->img->getLevelDownsample(level);
+    });
+}
+
+int dsv_samples_per_pixel(const DsvSlide* slide)
+{
+    return guarded(0, [&]() { return slide ? static_cast<int>(slide->img->getSamplesPerPixel()) : 0; });
+}
+
+int dsv_data_type(const DsvSlide* slide)
+{
+    return guarded(0, [&]() { return slide ? static_cast<int>(slide->img->getDataType()) : 0; });
+}
+
+size_t dsv_get_property(DsvSlide* slide, const char* name, char* buffer, size_t size)
+{
+    return guarded<size_t>(0, [&]() -> size_t {
+        if (!slide || !name) {
+            return 0;
+        }
+        const std::string value = slide->img->getProperty(name);
+        if (buffer && size > 0) {
+            const size_t n = std::min(value.size(), size - 1);
+            std::memcpy(buffer, value.data(), n);
+            buffer[n] = '\0';
+        }
+        return value.size();
+    });
+}
+
+DsvRegion* dsv_read_region(DsvSlide* slide, long long x, long long y, unsigned long long width, unsigned long long height, int level)
+{
+    return guarded<DsvRegion*>(NULL, [&]() -> DsvRegion* {
+        if (!slide) {
+            lastError() = "slide is NULL";
+            return NULL;
+        }
+        MultiResolutionImage* img = slide->img.get();
+        if (level < 0 || level >= img->getNumberOfLevels() || width == 0 || height == 0) {
+            lastError() = "invalid level or region size";
+            return NULL;
+        }
+        const SlideColorManagement::DataType dataType = img->getDataType();
+        const unsigned long long samplesPerPixel = img->getSamplesPerPixel();
+        const unsigned int bytes = itemSize(dataType);
+        if (bytes == 0 || width > kMaxRegionBytes / height / samplesPerPixel / bytes) {
+            lastError() = bytes == 0 ? "unsupported data type" : "region too large";
+            return NULL;
+        }
+
+        std::unique_ptr<DsvRegion> region(new DsvRegion());
+        region->img = slide->img;
+        region->shape[0] = height;
+        region->shape[1] = width;
+        region->shape[2] = samplesPerPixel;
+        region->dataType = static_cast<int>(dataType);
+        switch (dataType) {
+        case SlideColorManagement::DataType::UChar:
+            region->data = readInto<unsigned char>(img, x, y, width, height, level);
+            break;
+        case SlideColorManagement::DataType::UInt16:
+            region->data = readInto<unsigned short>(img, x, y, width, height, level);
+            break;
+        case SlideColorManagement::DataType::UInt32:
+            region->data = readInto<unsigned int>(img, x, y, width, height, level);
+            break;
+        default:
+            region->data = readInto<float>(img, x, y, width, height, level);
+            break;
+        }
+        if (!region->data) {
+            return NULL;
+        }
+        return region.release();
+    });
+}
+
+void* dsv_region_data(const DsvRegion* region)
+{
+    return region ? region->data : NULL;
+}
+
+void dsv_region_shape(const DsvRegion* region, unsigned long long shape[3])
+{
+    for (unsigned int i = 0; i < 3; ++i) {
+        shape[i] = region ? region->shape[i] : 0;
+    }
+}
+
+int dsv_region_data_type(const DsvRegion* region)
+{
+    return region ? region->dataType : 0;
+}
+
+void dsv_release_region(DsvRegion* region)
+{
+    guardedVoid([&]() {
+        if (region) {
+            TileBufferPool::release(region->data);
+            delete region;
+        }
+    });
+}
+
+const char* dsv_last_error(void)
+{
+    return lastError().c_str();
+}
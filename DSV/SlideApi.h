@@ -0,0 +1,137 @@
+﻿/**
+ * @file    SlideApi.h
+ * @brief   切片读取C接口，供Python等外部语言直接使用查看器的解码引擎
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该接口以C ABI导出MultiResolutionImage的读取功能，包括：
+ *          - 打开切片、查询层级尺寸、降采样、通道数、数据类型和属性
+ *          - 按原生数据类型读取区域，结果位于TileBufferPool的池缓冲区中，
+ *            解码直接写入该缓冲区，调用者通过指针和形状访问，不再复制
+ *          - 解码经过与查看器相同的解码瓦片缓存、压缩瓦片缓存和磁盘瓦片缓存
+ *
+ * @note    所有函数都是线程安全的，可以在多个线程中同时读取同一切片。
+ *          python/dsv.py通过ctypes调用这些函数，ctypes在调用期间释放GIL，
+ *          因此解码不持有GIL；返回的缓冲区由NumPy数组直接引用。
+ *          动态库由DSVSlideApi.vcxproj构建（DSVSlideApi.dll），该项目定义DSV_SLIDE_API_EXPORTS。
+ *          函数内部的C++异常（如内存不足）不会越过接口，按各函数的失败返回值返回，原因见dsv_last_error。
+ * @see     MultiResolutionImage::getRawRegion, TileBufferPool
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#if defined(_WIN32) && defined(DSV_SLIDE_API_EXPORTS)
+#define DSV_SLIDE_API __declspec(dllexport)
+#else
+#define DSV_SLIDE_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief 已打开的切片 */
+typedef struct DsvSlide DsvSlide;
+
+/** @brief 区域读取结果，持有一个池缓冲区 */
+typedef struct DsvRegion DsvRegion;
+
+/**
+ * @brief   打开切片
+ * @param   path UTF-8编码的文件路径
+ * @return  切片句柄，失败时返回NULL，原因见dsv_last_error
+ */
+DSV_SLIDE_API DsvSlide* dsv_open(const char* path);
+
+/**
+ * @brief   关闭切片
+ * @param   slide 切片句柄，可以为NULL
+ * @note    尚未释放的区域仍然有效，它们持有切片的引用
+ */
+DSV_SLIDE_API void dsv_close(DsvSlide* slide);
+
+/**
+ * @brief   获取层级数
+ */
+DSV_SLIDE_API int dsv_level_count(const DsvSlide* slide);
+
+/**
+ * @brief   获取层级尺寸
+ * @param   width 输出宽度
+ * @param   height 输出高度
+ * @return  层级存在时返回1，否则返回0
+ */
+DSV_SLIDE_API int dsv_level_dimensions(const DsvSlide* slide, int level, unsigned long long* width, unsigned long long* height);
+
+/**
+ * @brief   获取层级降采样比例
+ * @return  降采样比例，层级不存在时返回-1
+ */
+DSV_SLIDE_API double dsv_level_downsample(const DsvSlide* slide, int level);
+
+/**
+ * @brief   获取每像素的通道数
+ */
+DSV_SLIDE_API int dsv_samples_per_pixel(const DsvSlide* slide);
+
+/**
+ * @brief   获取原生数据类型
+ * @return  SlideColorManagement::DataType的枚举值：1为uint8，2为uint16，3为uint32，4为float32
+ */
+DSV_SLIDE_API int dsv_data_type(const DsvSlide* slide);
+
+/**
+ * @brief   读取属性
+ * @param   name 属性名称，与MultiResolutionImage::getProperty相同
+ * @param   buffer 输出缓冲区，可以为NULL
+ * @param   size 缓冲区大小
+ * @return  属性值的字节数（不含结尾的NUL），属性不存在时返回0；大于等于size时输出被截断
+ */
+DSV_SLIDE_API size_t dsv_get_property(DsvSlide* slide, const char* name, char* buffer, size_t size);
+
+/**
+ * @brief   按原生数据类型读取区域
+ * @param   x 区域左边（第0层像素）
+ * @param   y 区域上边（第0层像素）
+ * @param   width 区域宽度（层级像素）
+ * @param   height 区域高度（层级像素）
+ * @param   level 层级
+ * @return  区域句柄，参数无效或读取失败时返回NULL；数据按行优先、通道交错的height x width x samplesPerPixel排列
+ */
+DSV_SLIDE_API DsvRegion* dsv_read_region(DsvSlide* slide, long long x, long long y, unsigned long long width, unsigned long long height, int level);
+
+/**
+ * @brief   获取区域数据指针
+ * @return  池缓冲区的首地址，在dsv_release_region之前有效
+ */
+DSV_SLIDE_API void* dsv_region_data(const DsvRegion* region);
+
+/**
+ * @brief   获取区域形状
+ * @param   shape 输出高度、宽度和通道数
+ */
+DSV_SLIDE_API void dsv_region_shape(const DsvRegion* region, unsigned long long shape[3]);
+
+/**
+ * @brief   获取区域的数据类型
+ * @return  与dsv_data_type相同的枚举值
+ */
+DSV_SLIDE_API int dsv_region_data_type(const DsvRegion* region);
+
+/**
+ * @brief   释放区域，缓冲区归还TileBufferPool
+ * @param   region 区域句柄，可以为NULL
+ */
+DSV_SLIDE_API void dsv_release_region(DsvRegion* region);
+
+/**
+ * @brief   获取当前线程最近一次失败的原因
+ * @return  UTF-8字符串，在该线程下一次调用之前有效
+ */
+DSV_SLIDE_API const char* dsv_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
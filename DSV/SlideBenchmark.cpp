@@ -0,0 +1,444 @@
+﻿/**
+ * @file SlideBenchmark.cpp
+ * @brief 切片浏览基准测试实现文件
+ * @details 该文件实现了无界面的平移/缩放脚本回放，包括：
+ *          - 命令行和脚本解析
+ *          - 按PathologyViewer的方式搭建IOThread、TileManager和瓦片缓存
+ *          - 逐步加载视场、离屏绘制并记录耗时
+ *          - 文本和CSV格式的统计报告
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "SlideBenchmark.h"
+#include "PipelineProfiler.h"
+#include "MultiResolutionImage.h"
+#include "MultiResolutionImageFactory.h"
+#include "DiskTileCache.h"
+#include "SlideLoader.h"
+#include "IOThread.h"
+#include "IOWorker.h"
+#include "TileManager.h"
+#include "WSITileGraphicsItemCache.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGraphicsScene>
+#include <QImage>
+#include <QPainter>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+    /** @brief 默认视口大小 */
+    const QSize kDefaultViewport(1920, 1080);
+
+    /** @brief 单步等待瓦片加载的最长时间（毫秒），超时的步骤仍计入统计 */
+    const qint64 kStepTimeout = 60000;
+
+    /** @brief 瓦片图形项缓存大小，与PathologyViewer的默认值一致 */
+    const unsigned long long kTileCacheSize = 1000ULL * 512 * 512 * 3;
+
+    /** @brief repeat块的最大重复次数 */
+    const double kMaxRepeat = 100000.;
+
+    /** @brief 展开后的最大命令数，防止嵌套的repeat块耗尽内存 */
+    const size_t kMaxCommands = 1000000;
+
+    /**
+     * @brief 等待IO线程处理完所有任务，并把结果送达TileManager
+     * @param ioThread IO线程
+     * @param timer 本步计时器，用于超时判断
+     */
+    void waitForTiles(IOThread* ioThread, const QElapsedTimer& timer) {
+        while (!ioThread->isIdle() || ioThread->hasPendingDeliveries()) {
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 1);
+            if (timer.elapsed() > kStepTimeout) {
+                break;
+            }
+        }
+        QCoreApplication::processEvents();
+    }
+
+    /**
+     * @brief 计算命中率（百分比）
+     */
+    double hitRate(unsigned long long hits, unsigned long long misses) {
+        unsigned long long lookups = hits + misses;
+        return lookups ? 100. * hits / lookups : 0.;
+    }
+}
+
+/**
+ * @brief 命令行是否请求基准测试
+ * @param arguments 命令行参数
+ * @return 包含--benchmark时返回true
+ */
+bool SlideBenchmark::isRequested(const QStringList& arguments)
+{
+    return arguments.contains(QStringLiteral("--benchmark"));
+}
+
+/**
+ * @brief 解析命令行
+ * @param arguments 命令行参数，第一个为程序路径
+ * @param options 输出的运行参数
+ * @param errorMessage 错误信息
+ * @return 是否解析成功
+ */
+bool SlideBenchmark::parseArguments(const QStringList& arguments, Options& options, QString& errorMessage)
+{
+    QStringList positional;
+    for (int i = 1; i < arguments.size(); ++i) {
+        const QString& argument = arguments[i];
+        if (argument == QStringLiteral("--benchmark")) {
+            continue;
+        }
+        else if (argument == QStringLiteral("--no-disk-cache")) {
+            options.diskCache = false;
+        }
+        else if (argument == QStringLiteral("--threads") || argument == QStringLiteral("--tile-size") || argument == QStringLiteral("--report")) {
+            if (i + 1 >= arguments.size()) {
+                errorMessage = argument + QStringLiteral(" requires a value");
+                return false;
+            }
+            const QString value = arguments[++i];
+            if (argument == QStringLiteral("--report")) {
+                options.reportPath = value;
+                continue;
+            }
+            bool ok = false;
+            unsigned int number = value.toUInt(&ok);
+            if (!ok || (argument == QStringLiteral("--tile-size") && number == 0)) {
+                errorMessage = QStringLiteral("invalid value for ") + argument + QStringLiteral(": ") + value;
+                return false;
+            }
+            if (argument == QStringLiteral("--threads")) {
+                options.threads = number;
+            }
+            else {
+                options.tileSize = number;
+            }
+        }
+        else {
+            positional.append(argument);
+        }
+    }
+    if (positional.size() < 2) {
+        errorMessage = QStringLiteral("usage: DSV --benchmark <trace> <slide> [<slide> ...] [--threads N] [--tile-size N] [--no-disk-cache] [--report FILE]");
+        return false;
+    }
+    options.tracePath = positional.takeFirst();
+    options.slides = positional;
+    return true;
+}
+
+/**
+ * @brief 读取并展开脚本
+ * @param path 脚本路径
+ * @param commands 输出的命令序列
+ * @param errorMessage 错误信息
+ * @return 是否读取成功
+ * @details repeat块可以嵌套，展开后的序列只包含视口和视场命令；
+ *          数值必须是有限值，重复次数不超过kMaxRepeat，展开后不超过kMaxCommands条命令
+ */
+bool SlideBenchmark::readTrace(const QString& path, std::vector<Command>& commands, QString& errorMessage)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        errorMessage = QStringLiteral("cannot open trace ") + path;
+        return false;
+    }
+    // 每个未结束的repeat块记录重复次数和块内命令的起始位置
+    std::vector<std::pair<unsigned int, size_t> > repeats;
+    QTextStream in(&file);
+    unsigned int lineNumber = 0;
+    while (!in.atEnd()) {
+        QString line = in.readLine().trimmed();
+        ++lineNumber;
+        int comment = line.indexOf(QLatin1Char('#'));
+        if (comment >= 0) {
+            line = line.left(comment).trimmed();
+        }
+        if (line.isEmpty()) {
+            continue;
+        }
+        QStringList tokens = line.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+        const QString name = tokens.takeFirst().toLower();
+        Command command = { Command::Fit, { 0., 0., 0. } };
+        int expected = 0;
+        if (name == QStringLiteral("viewport")) {
+            command.type = Command::Viewport;
+            expected = 2;
+        }
+        else if (name == QStringLiteral("fit")) {
+            command.type = Command::Fit;
+        }
+        else if (name == QStringLiteral("goto")) {
+            command.type = Command::Goto;
+            expected = 3;
+        }
+        else if (name == QStringLiteral("pan")) {
+            command.type = Command::Pan;
+            expected = 2;
+        }
+        else if (name == QStringLiteral("zoom")) {
+            command.type = Command::Zoom;
+            expected = 1;
+        }
+        else if (name == QStringLiteral("repeat")) {
+            command.type = Command::Repeat;
+            expected = 1;
+        }
+        else if (name == QStringLiteral("end")) {
+            command.type = Command::End;
+        }
+        else {
+            errorMessage = QStringLiteral("%1:%2: unknown command %3").arg(path).arg(lineNumber).arg(name);
+            return false;
+        }
+        if (tokens.size() != expected) {
+            errorMessage = QStringLiteral("%1:%2: %3 expects %4 values").arg(path).arg(lineNumber).arg(name).arg(expected);
+            return false;
+        }
+        for (int i = 0; i < expected; ++i) {
+            bool ok = false;
+            command.values[i] = tokens[i].toDouble(&ok);
+            if (!ok || !std::isfinite(command.values[i])) {
+                errorMessage = QStringLiteral("%1:%2: invalid number %3").arg(path).arg(lineNumber).arg(tokens[i]);
+                return false;
+            }
+        }
+        if ((command.type == Command::Viewport && (command.values[0] < 1. || command.values[1] < 1.)) ||
+            (command.type == Command::Goto && command.values[2] <= 0.) ||
+            (command.type == Command::Zoom && command.values[0] <= 0.) ||
+            (command.type == Command::Repeat && (command.values[0] < 0. || command.values[0] > kMaxRepeat))) {
+            errorMessage = QStringLiteral("%1:%2: value out of range").arg(path).arg(lineNumber);
+            return false;
+        }
+        if (command.type == Command::Repeat) {
+            repeats.push_back(std::make_pair(static_cast<unsigned int>(command.values[0]), commands.size()));
+        }
+        else if (command.type == Command::End) {
+            if (repeats.empty()) {
+                errorMessage = QStringLiteral("%1:%2: end without repeat").arg(path).arg(lineNumber);
+                return false;
+            }
+            std::pair<unsigned int, size_t> block = repeats.back();
+            repeats.pop_back();
+            std::vector<Command> body(commands.begin() + block.second, commands.end());
+            if (!body.empty() && block.first > (kMaxCommands - block.second) / body.size()) {
+                errorMessage = QStringLiteral("%1:%2: repeat expands to more than %3 commands").arg(path).arg(lineNumber).arg(kMaxCommands);
+                return false;
+            }
+            commands.resize(block.second);
+            for (unsigned int i = 0; i < block.first; ++i) {
+                commands.insert(commands.end(), body.begin(), body.end());
+            }
+        }
+        else {
+            if (commands.size() >= kMaxCommands) {
+                errorMessage = QStringLiteral("%1:%2: more than %3 commands").arg(path).arg(lineNumber).arg(kMaxCommands);
+                return false;
+            }
+            commands.push_back(command);
+        }
+    }
+    if (!repeats.empty()) {
+        errorMessage = path + QStringLiteral(": repeat without end");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 对一张切片回放脚本
+ * @param slide 切片路径
+ * @param commands 命令序列
+ * @param options 运行参数
+ * @return 回放结果
+ * @details 打开切片后与PathologyViewer::initialize相同地搭建加载管线并先加载缩略图层级，
+ *          之后每条视场命令计为一步：加载视场、等待瓦片送达、把场景绘制到视口大小的离屏图像
+ */
+SlideBenchmark::SlideResult SlideBenchmark::replay(const QString& slide, const std::vector<Command>& commands, const Options& options)
+{
+    SlideResult result;
+    result.slide = slide;
+    MultiResolutionImageReader imgReader;
+    std::shared_ptr<MultiResolutionImage> img(imgReader.open(slide.toStdString(), "default"));
+    if (!img || !img->valid()) {
+        return result;
+    }
+    result.opened = true;
+
+    const unsigned int tileSize = options.tileSize ? options.tileSize : TileManager::alignedTileSize(img, 512);
+    const unsigned int lastLevel = SlideLoader::getOverviewLevel(img, tileSize);
+    const std::vector<unsigned int> levelTileSizes = options.tileSize ? std::vector<unsigned int>(1, tileSize)
+        : TileManager::levelTileSizes(img, 512, lastLevel, img->getReadLatency());
+    const double sceneScale = 1. / img->getLevelDownsample(lastLevel);
+    const std::vector<unsigned long long> dims = img->getDimensions();
+
+    QGraphicsScene scene;
+    WSITileGraphicsItemCache* cache = new WSITileGraphicsItemCache();
+    cache->setMaxCacheSize(kTileCacheSize);
+    IOThread* ioThread = new IOThread(NULL, options.threads);
+    ioThread->setBackgroundImage(img);
+    TileManager* manager = new TileManager(img, levelTileSizes, lastLevel, ioThread, cache, &scene);
+    QObject::connect(ioThread, SIGNAL(tileLoaded(QPixmap*, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, ImageSource*, QPixmap*, unsigned int, unsigned int)), manager, SLOT(onTileLoaded(QPixmap*, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, ImageSource*, QPixmap*, unsigned int, unsigned int)));
+    QObject::connect(ioThread, SIGNAL(foregroundTileRendered(QPixmap*, unsigned int, unsigned int, unsigned int, unsigned int)), manager, SLOT(onForegroundTileRendered(QPixmap*, unsigned int, unsigned int, unsigned int, unsigned int)));
+    QObject::connect(ioThread, SIGNAL(backgroundTileRendered(QPixmap*, unsigned int, unsigned int, unsigned int, unsigned int)), manager, SLOT(onBackgroundTileRendered(QPixmap*, unsigned int, unsigned int, unsigned int, unsigned int)));
+    QObject::connect(cache, SIGNAL(itemEvicted(WSITileGraphicsItem*)), manager, SLOT(onTileRemoved(WSITileGraphicsItem*)));
+
+    PipelineProfiler::reset();
+    PipelineProfiler::setSampling(true);
+    PipelineProfiler::setEnabled(true);
+    QElapsedTimer total;
+    total.start();
+
+    QElapsedTimer step;
+    step.start();
+    manager->loadAllTilesForLevel(lastLevel);
+    waitForTiles(ioThread, step);
+
+    QSize viewport = kDefaultViewport;
+    QPointF center(dims[0] / 2., dims[1] / 2.);
+    double downsample = std::max(dims[0] / static_cast<double>(viewport.width()), dims[1] / static_cast<double>(viewport.height()));
+    for (const Command& command : commands) {
+        switch (command.type) {
+        case Command::Viewport:
+            viewport = QSize(static_cast<int>(command.values[0]), static_cast<int>(command.values[1]));
+            continue;
+        case Command::Fit:
+            center = QPointF(dims[0] / 2., dims[1] / 2.);
+            downsample = std::max(dims[0] / static_cast<double>(viewport.width()), dims[1] / static_cast<double>(viewport.height()));
+            break;
+        case Command::Goto:
+            center = QPointF(command.values[0] * dims[0], command.values[1] * dims[1]);
+            downsample = command.values[2];
+            break;
+        case Command::Pan:
+            center += QPointF(command.values[0] * downsample, command.values[1] * downsample);
+            break;
+        case Command::Zoom:
+            downsample /= command.values[0];
+            break;
+        default:
+            continue;
+        }
+        const QRectF FOV(center.x() - viewport.width() * downsample / 2., center.y() - viewport.height() * downsample / 2.,
+            viewport.width() * downsample, viewport.height() * downsample);
+        step.restart();
+        manager->loadTilesForFieldOfView(FOV, img->getBestLevelForDownSample(downsample));
+        waitForTiles(ioThread, step);
+        QImage frame(viewport, QImage::Format_ARGB32_Premultiplied);
+        frame.fill(Qt::white);
+        QPainter painter(&frame);
+        scene.render(&painter, QRectF(frame.rect()), QRectF(FOV.left() * sceneScale, FOV.top() * sceneScale, FOV.width() * sceneScale, FOV.height() * sceneScale), Qt::IgnoreAspectRatio);
+        painter.end();
+        PipelineProfiler::record(PipelineProfiler::FieldOfViewUpdate, step.nsecsElapsed());
+        ++result.steps;
+    }
+    result.totalSeconds = total.elapsed() / 1000.;
+    PipelineProfiler::setEnabled(false);
+    PipelineProfiler::setSampling(false);
+
+    manager->clear();
+    delete manager;
+    cache->clear();
+    delete cache;
+    ioThread->shutdown();
+    delete ioThread;
+    return result;
+}
+
+/**
+ * @brief 输出一张切片的统计结果
+ * @param result 回放结果
+ * @param out 文本报告
+ * @param csv CSV报告
+ */
+void SlideBenchmark::report(const SlideResult& result, QTextStream& out, QTextStream* csv)
+{
+    out << "Slide: " << result.slide << "\n";
+    if (!result.opened) {
+        out << "  failed to open\n\n";
+        return;
+    }
+    out << QStringLiteral("  %1 steps in %2 s\n").arg(result.steps).arg(result.totalSeconds, 0, 'f', 2);
+    out << QStringLiteral("  %1 %2 %3 %4 %5 %6\n").arg(QStringLiteral("stage"), -28).arg(QStringLiteral("calls"), 10)
+        .arg(QStringLiteral("p50 ms"), 10).arg(QStringLiteral("p99 ms"), 10).arg(QStringLiteral("mean ms"), 10).arg(QStringLiteral("max ms"), 10);
+    for (int i = 0; i < PipelineProfiler::NumberOfStages; ++i) {
+        PipelineProfiler::Stage stage = static_cast<PipelineProfiler::Stage>(i);
+        PipelineProfiler::StageSummary summary = PipelineProfiler::summarize(stage);
+        out << QStringLiteral("  %1 %2 %3 %4 %5 %6\n").arg(QString::fromLatin1(PipelineProfiler::stageName(stage)), -28).arg(summary.calls, 10)
+            .arg(summary.p50, 10, 'f', 3).arg(summary.p99, 10, 'f', 3).arg(summary.mean, 10, 'f', 3).arg(summary.max, 10, 'f', 3);
+        if (csv) {
+            *csv << result.slide << "," << PipelineProfiler::stageName(stage) << "," << summary.calls << ","
+                << summary.p50 << "," << summary.p99 << "," << summary.mean << "," << summary.max << "\n";
+        }
+    }
+    const unsigned long long decodedHits = PipelineProfiler::counter(PipelineProfiler::DecodedCacheHit);
+    const unsigned long long decodedMisses = PipelineProfiler::counter(PipelineProfiler::DecodedCacheMiss);
+    const unsigned long long diskHits = PipelineProfiler::counter(PipelineProfiler::DiskCacheHit);
+    const unsigned long long diskMisses = PipelineProfiler::counter(PipelineProfiler::DiskCacheMiss);
+    const unsigned long long compressedHits = PipelineProfiler::counter(PipelineProfiler::CompressedCacheHit);
+    const unsigned long long compressedMisses = PipelineProfiler::counter(PipelineProfiler::CompressedCacheMiss);
+    out << QStringLiteral("  decoded tile cache: %1% hit (%2 of %3)\n").arg(hitRate(decodedHits, decodedMisses), 0, 'f', 1).arg(decodedHits).arg(decodedHits + decodedMisses);
+    const unsigned long long poolHits = PipelineProfiler::counter(PipelineProfiler::BufferPoolHit);
+    const unsigned long long poolMisses = PipelineProfiler::counter(PipelineProfiler::BufferPoolMiss);
+    out << QStringLiteral("  compressed tiles:   %1% hit (%2 of %3)\n").arg(hitRate(compressedHits, compressedMisses), 0, 'f', 1).arg(compressedHits).arg(compressedHits + compressedMisses);
+    out << QStringLiteral("  disk tile cache:    %1% hit (%2 of %3)\n").arg(hitRate(diskHits, diskMisses), 0, 'f', 1).arg(diskHits).arg(diskHits + diskMisses);
+    out << QStringLiteral("  tile buffer pool:   %1% reused (%2 of %3)\n\n").arg(hitRate(poolHits, poolMisses), 0, 'f', 1).arg(poolHits).arg(poolHits + poolMisses);
+    if (csv) {
+        *csv << result.slide << ",decodedCacheHitRate," << (decodedHits + decodedMisses) << "," << hitRate(decodedHits, decodedMisses) << ",,,\n";
+        *csv << result.slide << ",compressedCacheHitRate," << (compressedHits + compressedMisses) << "," << hitRate(compressedHits, compressedMisses) << ",,,\n";
+        *csv << result.slide << ",diskCacheHitRate," << (diskHits + diskMisses) << "," << hitRate(diskHits, diskMisses) << ",,,\n";
+        *csv << result.slide << ",bufferPoolReuseRate," << (poolHits + poolMisses) << "," << hitRate(poolHits, poolMisses) << ",,,\n";
+    }
+}
+
+/**
+ * @brief 运行基准测试
+ * @param arguments 命令行参数
+ * @return 进程退出码
+ */
+int SlideBenchmark::run(const QStringList& arguments)
+{
+    QTextStream out(stdout);
+    Options options;
+    QString errorMessage;
+    std::vector<Command> commands;
+    if (!parseArguments(arguments, options, errorMessage) || !readTrace(options.tracePath, commands, errorMessage)) {
+        out << errorMessage << "\n";
+        return 2;
+    }
+    DiskTileCache::setEnabled(options.diskCache);
+
+    QFile reportFile;
+    QTextStream csvStream;
+    QTextStream* csv = NULL;
+    if (!options.reportPath.isEmpty()) {
+        reportFile.setFileName(options.reportPath);
+        if (!reportFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+            out << "cannot write report " << options.reportPath << "\n";
+            return 2;
+        }
+        csvStream.setDevice(&reportFile);
+        csvStream << "slide,stage,calls,p50_ms,p99_ms,mean_ms,max_ms\n";
+        csv = &csvStream;
+    }
+
+    int exitCode = 0;
+    for (const QString& slide : options.slides) {
+        SlideResult result = replay(slide, commands, options);
+        if (!result.opened) {
+            exitCode = 1;
+        }
+        report(result, out, csv);
+        out.flush();
+    }
+    return exitCode;
+}
@@ -0,0 +1,133 @@
+﻿/**
+ * @file    SlideBenchmark.h
+ * @brief   切片浏览基准测试类，无界面回放平移/缩放脚本并报告瓦片管线耗时
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该类实现了DSV的可重复性能测量，包括：
+ *          - 读取平移/缩放脚本，对一组参考切片逐一回放
+ *          - 使用与PathologyViewer相同的IOThread、TileManager和瓦片缓存加载视场
+ *          - 每一步等待瓦片全部加载后把场景绘制到离屏图像
+ *          - 按PipelineProfiler的阶段报告p50/p99耗时和缓存命中率
+ *
+ * @note    通过命令行启动：DSV.exe --benchmark trace.txt slide1.svs [slide2.ndpi ...]
+ * @see     PipelineProfiler, PathologyViewer, TileManager
+ */
+
+#pragma once
+
+#include <QRectF>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <memory>
+#include <vector>
+
+class MultiResolutionImage;
+class QTextStream;
+
+/**
+ * @class  SlideBenchmark
+ * @brief  切片浏览基准测试
+ * @details 脚本为文本文件，每行一条命令，#开头为注释：
+ *          - viewport W H      视口大小（屏幕像素），默认1920 1080
+ *          - fit               显示整张切片
+ *          - goto CX CY DS     视口中心移到归一化坐标(CX, CY)，DS为每屏幕像素对应的第0层像素数
+ *          - pan DX DY         按屏幕像素平移
+ *          - zoom F            放大F倍（F<1为缩小）
+ *          - repeat N          重复其后直到end的命令N次
+ *          - end               结束repeat块
+ *
+ *          命令行选项：
+ *          - --threads N       IO工作线程数，默认按CPU核数
+ *          - --tile-size N     瓦片大小，默认与原生瓦片网格对齐（无法对齐时为512）
+ *          - --no-disk-cache   关闭磁盘瓦片缓存，测量冷启动
+ *          - --report FILE     同时把报告以CSV格式写入文件
+ *
+ * @example
+ *          // 使用示例（main.cpp）
+ *          if (SlideBenchmark::isRequested(arguments)) {
+ *              return SlideBenchmark::run(arguments);
+ *          }
+ */
+class SlideBenchmark
+{
+public:
+    /**
+     * @brief   命令行是否请求基准测试
+     * @param   arguments 命令行参数
+     * @return  包含--benchmark时返回true
+     */
+    static bool isRequested(const QStringList& arguments);
+
+    /**
+     * @brief   运行基准测试
+     * @param   arguments 命令行参数
+     * @return  进程退出码，0表示所有切片都已完成回放
+     * @note    需要已创建QApplication
+     */
+    static int run(const QStringList& arguments);
+
+private:
+    /**
+     * @brief 脚本命令
+     */
+    struct Command {
+        enum Type { Viewport, Fit, Goto, Pan, Zoom, Repeat, End };
+        Type type;
+        double values[3];
+    };
+
+    /**
+     * @brief 运行参数
+     */
+    struct Options {
+        QString tracePath;
+        QStringList slides;
+        QString reportPath;
+        unsigned int threads = 0;
+        unsigned int tileSize = 0;  ///< 非0时所有层级使用该大小，0表示与PathologyViewer相同，使用TileManager::levelTileSizes
+        bool diskCache = true;
+    };
+
+    /**
+     * @brief 单张切片的回放结果
+     */
+    struct SlideResult {
+        QString slide;
+        bool opened = false;
+        unsigned int steps = 0;
+        double totalSeconds = 0.;
+    };
+
+    /**
+     * @brief   解析命令行
+     * @return  参数完整时返回true，否则errorMessage给出原因
+     */
+    static bool parseArguments(const QStringList& arguments, Options& options, QString& errorMessage);
+
+    /**
+     * @brief   读取并展开脚本
+     * @param   path 脚本路径
+     * @param   commands 输出的命令序列，repeat块已展开
+     * @return  脚本可读且语法正确时返回true
+     */
+    static bool readTrace(const QString& path, std::vector<Command>& commands, QString& errorMessage);
+
+    /**
+     * @brief   对一张切片回放脚本
+     * @param   slide 切片路径
+     * @param   commands 命令序列
+     * @param   options 运行参数
+     * @return  回放结果
+     */
+    static SlideResult replay(const QString& slide, const std::vector<Command>& commands, const Options& options);
+
+    /**
+     * @brief   输出一张切片的统计结果
+     * @param   result 回放结果
+     * @param   out 文本报告
+     * @param   csv CSV报告，可为NULL
+     */
+    static void report(const SlideResult& result, QTextStream& out, QTextStream* csv);
+};
@@ -40,7 +40,13 @@ namespace SlideColorManagement
 		//ڱǲͬıǩڲͼУͬɫԱʾͬ֯ͻ򲡱(29������ֵ����������)
 		{ std::string("Traffic Light (0 - 255)"), { {0.0, 10., 127, 255.},  { { 0, 0, 0, 0 },  { 0, 255, 0, 255 },  { 255, 255, 0, 255 },  { 255, 0, 0, 255 } }, false } },
 		//ڽͨɫӳ䣬ֵӳ䵽ͨƵɫ̡ơ죩ԱʾΧ 0  2550.0-10.127,255
-		{ std::string("Traffic Light (0 - 1)"), { {0.0, 10 / 255., 127 / 255., 1.},  { { 0, 0, 0, 0 },  { 0, 255, 0, 255 },  { 255, 255, 0, 255 },  { 255, 0, 0, 255 } }, false } }
+		{ std::string("Traffic Light (0 - 1)"), { {0.0, 10 / 255., 127 / 255., 1.},  { { 0, 0, 0, 0 },  { 0, 255, 0, 255 },  { 255, 255, 0, 255 },  { 255, 0, 0, 255 } }, false } },
+		/**
+		 * @brief 热图颜色映射
+		 * @details 用于点检测密度等连续值，按前景的数值范围相对映射，
+		 *          最小值透明，由低到高依次为半透明的蓝、绿、黄和不透明的红
+		 */
+		{ std::string("Heatmap"), { {0.0, 0.02, 0.33, 0.66, 1.},  { { 0, 0, 0, 0 },  { 0, 0, 255, 96 },  { 0, 255, 0, 160 },  { 255, 255, 0, 208 },  { 255, 0, 0, 255 } }, true } }
 		//һֵֵ0-1
 	};
 }
\ No newline at end of file
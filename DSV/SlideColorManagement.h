@@ -77,6 +77,38 @@ namespace SlideColorManagement
      */
     extern std::map<std::string, LUT> DefaultColorLUT;
 
+    /**
+     * @struct   ChannelDisplay
+     * @brief    荧光多通道合成中单个通道的显示设置
+     * @details  通道按窗宽窗位映射到0-1，经伽马校正后乘以通道颜色，
+     *           所有可见通道的结果按加性混合叠加并饱和到255
+     *
+     * @example
+     *           // DAPI显示为蓝色、FITC显示为绿色
+     *           std::vector<ChannelDisplay> channels(2);
+     *           channels[0].color = { 0, 0, 255, 255 };
+     *           channels[0].windowMax = 4095;
+     *           channels[1].color = { 0, 255, 0, 255 };
+     *           channels[1].windowMax = 4095;
+     *           channels[1].gamma = 0.8f;
+     */
+    struct ChannelDisplay {
+        /** @brief 是否参与合成 */
+        bool visible = true;
+
+        /** @brief 通道颜色，RGB分量范围0-255，alpha分量不使用 */
+        rgbaArray color = { { 255, 255, 255, 255 } };
+
+        /** @brief 窗口下限，映射为强度0 */
+        double windowMin = 0.;
+
+        /** @brief 窗口上限，映射为强度1；不大于windowMin时按windowMin阈值化 */
+        double windowMax = 255.;
+
+        /** @brief 伽马指数，显示强度 = 窗口归一化值 ^ gamma，1为线性 */
+        float gamma = 1.f;
+    };
+
     /**
      * @enum     ColorType
      * @brief    图像颜色类型枚举
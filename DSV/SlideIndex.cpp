@@ -0,0 +1,396 @@
+﻿/**
+ * @file SlideIndex.cpp
+ * @brief 切片索引实现文件
+ * @details 实现文件夹的后台扫描、切片元数据读取和索引文件的读写
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "SlideIndex.h"
+#include "MultiResolutionImage.h"
+#include "MultiResolutionImageFactory.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+namespace {
+    /** @brief 索引文件魔数 */
+    const quint32 kIndexMagic = 0x44535649;
+
+    /** @brief 索引文件版本 */
+    const quint32 kIndexVersion = 1;
+
+    /**
+     * @brief 读取数值属性
+     * @param img 图像对象
+     * @param names 依次尝试的属性名称
+     * @return 第一个能解析为正数的属性值，没有时返回0
+     */
+    double numericProperty(MultiResolutionImage* img, std::initializer_list<const char*> names)
+    {
+        for (const char* name : names) {
+            bool ok = false;
+            const double value = QString::fromStdString(img->getProperty(name)).toDouble(&ok);
+            if (ok && value > 0.) {
+                return value;
+            }
+        }
+        return 0.;
+    }
+}
+
+/**
+ * @brief 文件夹扫描任务
+ * @details 开始执行时先领取文件夹，文件夹已被丢弃时直接返回
+ */
+class SlideIndex::Task : public QRunnable
+{
+public:
+    Task(SlideIndex* index, const QString& directory) :
+        _index(index), _directory(directory)
+    {
+    }
+
+    void run() override
+    {
+        if (_index->claim(_directory)) {
+            _index->scan(_directory);
+        }
+    }
+
+private:
+    SlideIndex* _index;
+    QString _directory;
+};
+
+/**
+ * @brief 获取元数据描述
+ * @return 描述文本
+ */
+QString SlideIndex::Entry::description() const
+{
+    if (!slide) {
+        return QString();
+    }
+    QStringList lines;
+    lines << QStringLiteral("尺寸：%1 x %2").arg(width).arg(height);
+    if (!vendor.isEmpty()) {
+        lines << QStringLiteral("厂商：%1").arg(vendor);
+    }
+    if (mpp > 0.) {
+        lines << QStringLiteral("每像素微米数：%1").arg(mpp, 0, 'g', 4);
+    }
+    if (magnification > 0.) {
+        lines << QStringLiteral("倍率：%1x").arg(magnification, 0, 'g', 3);
+    }
+    return lines.join("\n");
+}
+
+/**
+ * @brief 构造函数
+ * @param parent 父对象指针
+ */
+SlideIndex::SlideIndex(QObject* parent) :
+    QObject(parent),
+    _dirty(false),
+    _abort(false),
+    _sequence(0)
+{
+    _pool.setMaxThreadCount(1);
+    load();
+}
+
+/**
+ * @brief 析构函数
+ * @details 之后不会再有任务访问该对象
+ */
+SlideIndex::~SlideIndex()
+{
+    {
+        QMutexLocker locker(&_mutex);
+        _queued.clear();
+    }
+    _abort = true;
+    _pool.clear();
+    _pool.waitForDone();
+    save();
+}
+
+/**
+ * @brief 获取索引文件路径
+ * @return 索引文件路径
+ */
+QString SlideIndex::indexFilePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/slideindex.dat";
+}
+
+/**
+ * @brief 扫描文件夹
+ * @param directory 文件夹路径
+ */
+void SlideIndex::scanDirectory(const QString& directory)
+{
+    const QString path = QDir(directory).absolutePath();
+    {
+        QMutexLocker locker(&_mutex);
+        if (_queued.contains(path)) {
+            return;
+        }
+        _queued.insert(path);
+    }
+    _pool.start(new Task(this, path), _sequence++);
+}
+
+/**
+ * @brief 领取文件夹
+ * @param directory 文件夹绝对路径
+ * @return 文件夹仍在排队时返回true
+ */
+bool SlideIndex::claim(const QString& directory)
+{
+    QMutexLocker locker(&_mutex);
+    return _queued.remove(directory);
+}
+
+/**
+ * @brief 查询索引条目
+ * @param filePath 文件路径
+ * @param entry 输出条目
+ * @return 条目存在且未过期时返回true
+ */
+bool SlideIndex::lookup(const QString& filePath, Entry& entry) const
+{
+    const QFileInfo info(filePath);
+    {
+        QMutexLocker locker(&_mutex);
+        auto directory = _directories.constFind(info.absolutePath());
+        if (directory == _directories.constEnd()) {
+            return false;
+        }
+        auto found = directory->constFind(info.fileName());
+        if (found == directory->constEnd()) {
+            return false;
+        }
+        entry = *found;
+    }
+    return entry.size == info.size() && entry.modified == info.lastModified().toMSecsSinceEpoch();
+}
+
+/**
+ * @brief 搜索已索引的切片
+ * @param text 搜索文本
+ * @param maxResults 最多返回的结果数
+ * @return 匹配的切片路径
+ */
+QStringList SlideIndex::search(const QString& text, int maxResults) const
+{
+    QStringList results;
+    const QString needle = text.trimmed();
+    if (needle.isEmpty() || maxResults <= 0) {
+        return results;
+    }
+    {
+        QMutexLocker locker(&_mutex);
+        for (auto directory = _directories.constBegin(); directory != _directories.constEnd(); ++directory) {
+            for (auto entry = directory->constBegin(); entry != directory->constEnd(); ++entry) {
+                if (entry->slide && (entry.key().contains(needle, Qt::CaseInsensitive) || entry->vendor.compare(needle, Qt::CaseInsensitive) == 0)) {
+                    results << entry->filePath;
+                }
+            }
+        }
+    }
+    std::sort(results.begin(), results.end());
+    if (results.size() > maxResults) {
+        results.erase(results.begin() + maxResults, results.end());
+    }
+    return results;
+}
+
+/**
+ * @brief 扫描文件夹
+ * @param directory 文件夹绝对路径
+ * @details 目录读取和切片探测都在锁外进行，锁只保护索引的读写
+ */
+void SlideIndex::scan(const QString& directory)
+{
+    QStringList nameFilters;
+    for (const std::string& extension : MultiResolutionImageFactory::getAllSupportedExtensions()) {
+        nameFilters << QStringLiteral("*.") + QString::fromStdString(extension);
+    }
+    const QFileInfoList files = QDir(directory).entryInfoList(nameFilters, QDir::Files);
+    QHash<QString, Entry> known;
+    {
+        QMutexLocker locker(&_mutex);
+        known = _directories.value(directory);
+    }
+    QHash<QString, Entry> scanned;
+    QStringList updated;
+    for (const QFileInfo& info : files) {
+        if (_abort) {
+            return;
+        }
+        const QString fileName = info.fileName();
+        auto found = known.constFind(fileName);
+        const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+        if (found != known.constEnd() && found->size == info.size() && found->modified == modified) {
+            scanned.insert(fileName, *found);
+            continue;
+        }
+        Entry entry;
+        entry.filePath = info.absoluteFilePath();
+        entry.size = info.size();
+        entry.modified = modified;
+        probe(entry);
+        scanned.insert(fileName, entry);
+        {
+            QMutexLocker locker(&_mutex);
+            _directories[directory].insert(fileName, entry);
+            _dirty = true;
+        }
+        updated << entry.filePath;
+        if (updated.size() >= kBatchSize) {
+            QMetaObject::invokeMethod(this, "onEntriesScanned", Qt::QueuedConnection, Q_ARG(QStringList, updated));
+            updated.clear();
+        }
+    }
+    {
+        // 已删除的文件从索引中移除
+        QMutexLocker locker(&_mutex);
+        if (_directories.value(directory).size() != scanned.size()) {
+            _dirty = true;
+        }
+        if (scanned.isEmpty()) {
+            _directories.remove(directory);
+        }
+        else {
+            _directories.insert(directory, scanned);
+        }
+    }
+    if (!updated.isEmpty()) {
+        QMetaObject::invokeMethod(this, "onEntriesScanned", Qt::QueuedConnection, Q_ARG(QStringList, updated));
+    }
+    save();
+    QMetaObject::invokeMethod(this, "directoryIndexed", Qt::QueuedConnection, Q_ARG(QString, directory));
+}
+
+/**
+ * @brief 读取文件的元数据
+ * @param entry 条目
+ * @details 先用探测缓存排除不支持的文件，再打开切片读取头部，不读取任何瓦片
+ */
+void SlideIndex::probe(Entry& entry)
+{
+    const std::string fileName = entry.filePath.toStdString();
+    const std::string factoryName = MultiResolutionImageFactory::probeImage(fileName);
+    if (factoryName.empty()) {
+        return;
+    }
+    std::unique_ptr<MultiResolutionImage> img(MultiResolutionImageFactory::openImage(fileName));
+    if (!img || !img->valid()) {
+        return;
+    }
+    entry.slide = true;
+    const std::vector<unsigned long long> dims = img->getDimensions();
+    if (dims.size() >= 2) {
+        entry.width = dims[0];
+        entry.height = dims[1];
+    }
+    const std::vector<double> spacing = img->getSpacing();
+    if (!spacing.empty()) {
+        entry.mpp = spacing[0];
+    }
+    entry.vendor = QString::fromStdString(img->getProperty("openslide.vendor"));
+    if (entry.vendor.isEmpty()) {
+        entry.vendor = QString::fromStdString(factoryName);
+    }
+    entry.magnification = numericProperty(img.get(), { "openslide.objective-power", "aperio.AppMag" });
+}
+
+/**
+ * @brief 转发工作线程的更新
+ * @param filePaths 新增或更新的文件路径
+ */
+void SlideIndex::onEntriesScanned(const QStringList& filePaths)
+{
+    emit entriesUpdated(filePaths);
+}
+
+/**
+ * @brief 读取索引文件
+ * @details 文件不存在、魔数或版本不匹配时从空索引开始
+ */
+void SlideIndex::load()
+{
+    QFile file(indexFilePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_15);
+    quint32 magic = 0, version = 0, count = 0;
+    stream >> magic >> version >> count;
+    if (magic != kIndexMagic || version != kIndexVersion) {
+        return;
+    }
+    QHash<QString, QHash<QString, Entry> > directories;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        Entry entry;
+        stream >> entry.filePath >> entry.size >> entry.modified >> entry.slide >> entry.vendor
+            >> entry.width >> entry.height >> entry.mpp >> entry.magnification;
+        const QFileInfo info(entry.filePath);
+        directories[info.absolutePath()].insert(info.fileName(), entry);
+    }
+    if (stream.status() != QDataStream::Ok) {
+        return;
+    }
+    QMutexLocker locker(&_mutex);
+    _directories = directories;
+}
+
+/**
+ * @brief 索引有变化时写回索引文件
+ * @details 先写临时文件再替换，程序中途退出时不会留下不完整的索引
+ */
+void SlideIndex::save()
+{
+    QHash<QString, QHash<QString, Entry> > directories;
+    {
+        QMutexLocker locker(&_mutex);
+        if (!_dirty) {
+            return;
+        }
+        directories = _directories;
+        _dirty = false;
+    }
+    quint32 count = 0;
+    for (const QHash<QString, Entry>& entries : directories) {
+        count += entries.size();
+    }
+    QDir().mkpath(QFileInfo(indexFilePath()).absolutePath());
+    QSaveFile file(indexFilePath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << kIndexMagic << kIndexVersion << count;
+    for (const QHash<QString, Entry>& entries : directories) {
+        for (const Entry& entry : entries) {
+            stream << entry.filePath << entry.size << entry.modified << entry.slide << entry.vendor
+                << entry.width << entry.height << entry.mpp << entry.magnification;
+        }
+    }
+    file.commit();
+}
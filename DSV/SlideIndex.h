@@ -0,0 +1,196 @@
+﻿/**
+ * @file    SlideIndex.h
+ * @brief   切片索引类，在后台扫描文件夹并缓存切片元数据
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了文件浏览时的切片索引功能，包括：
+ *          - 单线程后台逐个文件夹扫描，网络共享上的目录读取不阻塞GUI线程
+ *          - 探测文件格式，对支持的切片读取尺寸、厂商、MPP和物镜倍率
+ *          - 索引按文件身份（大小、修改时间）判断是否过期，未变化的文件不再打开
+ *          - 索引保存在本地缓存目录中，重新启动后浏览和搜索直接使用已有结果
+ *
+ * @note    该类的公有接口只能在GUI线程中调用
+ * @see     FileWidget, ThumbnailService, MultiResolutionImageFactory::probeImage
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <atomic>
+
+/**
+ * @class  SlideIndex
+ * @brief  切片索引
+ * @details scanDirectory()把文件夹放入后台队列，工作线程列出文件夹中的文件，
+ *          对新增或修改过的文件先做轻量探测，能读取时再打开切片读取头部元数据，
+ *          每处理kBatchSize个文件通过entriesUpdated通知一次视图。
+ *          文件夹扫描完成后删除已不存在的文件并在索引有变化时写回磁盘。
+ *
+ *          lookup()和search()只查询内存中的索引，不访问文件系统。
+ *
+ * @example
+ *          // 使用示例
+ *          SlideIndex* index = new SlideIndex(this);
+ *          connect(model, &QFileSystemModel::directoryLoaded, index, &SlideIndex::scanDirectory);
+ *
+ *          SlideIndex::Entry entry;
+ *          if (index->lookup(filePath, entry) && entry.slide) {
+ *              qDebug() << entry.description();
+ *          }
+ * @see     FileWidget
+ */
+class SlideIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief 索引条目
+     */
+    struct Entry {
+        QString filePath;            ///< 文件绝对路径
+        qint64 size = 0;             ///< 文件大小（字节）
+        qint64 modified = 0;         ///< 修改时间（毫秒）
+        bool slide = false;          ///< 是否为可以打开的切片
+        QString vendor;              ///< 厂商，没有厂商属性时为读取该文件的工厂名称
+        quint64 width = 0;           ///< 第0层宽度
+        quint64 height = 0;          ///< 第0层高度
+        double mpp = 0.;             ///< 每像素微米数，未知时为0
+        double magnification = 0.;   ///< 物镜倍率，未知时为0
+
+        /**
+         * @brief   获取元数据描述
+         * @return  多行描述文本，不是切片时返回空字符串
+         */
+        QString description() const;
+    };
+
+    /**
+     * @brief   构造函数
+     * @param   parent 父对象指针
+     * @details 读取磁盘上的索引文件
+     */
+    explicit SlideIndex(QObject* parent = 0);
+
+    /**
+     * @brief   析构函数
+     * @details 丢弃排队的文件夹，等待正在扫描的文件夹中止，并保存索引
+     */
+    ~SlideIndex();
+
+    /**
+     * @brief   查询索引条目
+     * @param   filePath 文件路径
+     * @param   entry 输出条目
+     * @return  文件已被索引且大小、修改时间与索引一致时返回true
+     * @note    只比较文件身份时访问一次文件系统，不读取文件内容
+     */
+    bool lookup(const QString& filePath, Entry& entry) const;
+
+    /**
+     * @brief   搜索已索引的切片
+     * @param   text 搜索文本，匹配文件名或厂商，不区分大小写
+     * @param   maxResults 最多返回的结果数
+     * @return  匹配的切片路径，按路径排序
+     */
+    QStringList search(const QString& text, int maxResults) const;
+
+    /**
+     * @brief   获取索引文件路径
+     * @return  QStandardPaths::CacheLocation下的slideindex.dat
+     */
+    static QString indexFilePath();
+
+public slots:
+    /**
+     * @brief   扫描文件夹
+     * @param   directory 文件夹路径，只扫描该文件夹中的文件，不递归
+     * @details 文件夹已在队列中时忽略；后提交的文件夹先扫描
+     */
+    void scanDirectory(const QString& directory);
+
+signals:
+    /**
+     * @brief   索引条目更新信号
+     * @param   filePaths 新增或更新的文件路径
+     */
+    void entriesUpdated(const QStringList& filePaths);
+
+    /**
+     * @brief   文件夹扫描完成信号
+     * @param   directory 文件夹绝对路径
+     */
+    void directoryIndexed(const QString& directory);
+
+private slots:
+    /**
+     * @brief   转发工作线程的更新
+     * @param   filePaths 新增或更新的文件路径
+     */
+    void onEntriesScanned(const QStringList& filePaths);
+
+private:
+    class Task;
+
+    /**
+     * @brief   扫描文件夹
+     * @param   directory 文件夹绝对路径
+     * @note    由工作线程调用
+     */
+    void scan(const QString& directory);
+
+    /**
+     * @brief   读取文件的元数据
+     * @param   entry 条目，调用前需设置路径、大小和修改时间
+     * @note    可在任意线程中调用
+     */
+    static void probe(Entry& entry);
+
+    /**
+     * @brief   领取文件夹
+     * @param   directory 文件夹绝对路径
+     * @return  文件夹仍在排队时返回true
+     */
+    bool claim(const QString& directory);
+
+    /**
+     * @brief   读取索引文件
+     */
+    void load();
+
+    /**
+     * @brief   索引有变化时写回索引文件
+     */
+    void save();
+
+    /** @brief 按文件夹分组的索引，文件夹绝对路径 -> 文件名 -> 条目，由_mutex保护 */
+    QHash<QString, QHash<QString, Entry> > _directories;
+
+    /** @brief 排队的文件夹，由_mutex保护 */
+    QSet<QString> _queued;
+
+    /** @brief 索引自上次保存后是否有变化，由_mutex保护 */
+    bool _dirty;
+
+    /** @brief 保护索引和队列的互斥锁 */
+    mutable QMutex _mutex;
+
+    /** @brief 中止标志，析构时中止正在扫描的文件夹 */
+    std::atomic<bool> _abort;
+
+    /** @brief 索引线程池，只有一个线程，同一时间只访问一个文件夹 */
+    QThreadPool _pool;
+
+    /** @brief 请求序号，作为线程池优先级使后提交的文件夹先扫描 */
+    int _sequence;
+
+    /** @brief 每处理多少个文件通知一次视图 */
+    static const int kBatchSize = 32;
+};
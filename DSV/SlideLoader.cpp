@@ -0,0 +1,185 @@
+﻿/**
+ * @file SlideLoader.cpp
+ * @brief 切片异步打开线程实现文件
+ * @details 在后台线程中打开切片并读取缩略图层级，分阶段通知GUI线程
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "SlideLoader.h"
+#include "MultiResolutionImage.h"
+#include "MultiResolutionImageFactory.h"
+#include "DiskTileCache.h"
+#include "SlideStatistics.h"
+#include "TileManager.h"
+#include "TissueMask.h"
+#include <vector>
+
+/**
+ * @brief 构造函数
+ * @param fileName 切片文件路径
+ * @param tileSize 瓦片大小
+ * @param parent 父对象指针
+ */
+SlideLoader::SlideLoader(const QString& fileName, unsigned int tileSize, QObject* parent) :
+    QThread(parent),
+    _fileName(fileName),
+    _tileSize(tileSize)
+{
+}
+
+/**
+ * @brief 析构函数
+ * @details 等待打开或缩略图读取结束
+ */
+SlideLoader::~SlideLoader()
+{
+    wait();
+}
+
+/**
+ * @brief 获取切片文件路径
+ * @return 文件路径
+ */
+QString SlideLoader::getFileName() const
+{
+    return _fileName;
+}
+
+/**
+ * @brief 获取已打开的图像
+ * @return 图像对象
+ */
+std::shared_ptr<MultiResolutionImage> SlideLoader::getImage() const
+{
+    return _img;
+}
+
+/**
+ * @brief 获取标签图像
+ * @return 标签图像
+ */
+QImage SlideLoader::getLabel() const
+{
+    return _label;
+}
+
+/**
+ * @brief 获取图像属性
+ * @return 属性列表
+ */
+std::vector<SlideColorManagement::PropertyInfo> SlideLoader::getProperties() const
+{
+    return _properties;
+}
+
+/**
+ * @brief 确定缩略图层级
+ * @param img 图像对象
+ * @param tileSize 瓦片大小
+ * @return 第一个宽高都大于瓦片大小的层级（从低分辨率开始）
+ */
+unsigned int SlideLoader::getOverviewLevel(const std::shared_ptr<MultiResolutionImage>& img, unsigned int tileSize)
+{
+    unsigned int lastLevel = img->getNumberOfLevels() - 1;
+    for (int i = lastLevel; i >= 0; --i) {
+        std::vector<unsigned long long> levelDimensions = img->getLevelDimensions(i);
+        if (levelDimensions[0] > tileSize && levelDimensions[1] > tileSize) {
+            return i;
+        }
+    }
+    return lastLevel;
+}
+
+/**
+ * @brief 读取缩略图并设置组织掩膜或切片统计
+ * @param img 图像对象
+ * @param tileSize 对齐后的瓦片大小
+ * @return 缩略图
+ */
+QImage SlideLoader::loadOverview(const std::shared_ptr<MultiResolutionImage>& img, unsigned int tileSize)
+{
+    unsigned int level = getOverviewLevel(img, tileSize);
+    std::vector<unsigned long long> overviewDimensions = img->getLevelDimensions(level);
+    unsigned long long size = overviewDimensions[0] * overviewDimensions[1] * img->getSamplesPerPixel();
+    unsigned char* overview = new unsigned char[size];
+    img->getRawRegion<unsigned char>(0, 0, overviewDimensions[0], overviewDimensions[1], level, overview);
+    // 组织掩膜只对明场RGB切片有意义，荧光等多通道图像的背景不是玻片颜色
+    if (img->getColorType() == SlideColorManagement::ColorType::RGB || img->getColorType() == SlideColorManagement::ColorType::RGBA) {
+        unsigned char bgR, bgG, bgB;
+        img->getBackgroundColor(bgR, bgG, bgB);
+        img->setTissueMask(TissueMask::fromPixels(overview, overviewDimensions[0], overviewDimensions[1], img->getSamplesPerPixel(),
+            img->getLevelDownsample(level), bgR, bgG, bgB));
+    }
+    // 其余图像使用通道范围，上次打开时保存的统计直接可用，否则创建空统计由PathologyViewer在后台补全
+    else if (!img->getStatistics()) {
+        std::shared_ptr<SlideStatistics> statistics;
+        if (std::shared_ptr<DiskTileCache> diskCache = img->getDiskCache()) {
+            statistics = SlideStatistics::load(diskCache->sidecarPath(SlideStatistics::kFileSuffix), img.get());
+        }
+        img->setStatistics(statistics ? statistics : SlideStatistics::create(img.get()));
+    }
+    QImage ovImg;
+    if (img->getColorType() == SlideColorManagement::ColorType::RGBA) {
+        ovImg = QImage(overview, overviewDimensions[0], overviewDimensions[1], overviewDimensions[0] * 4, QImage::Format_RGBA8888).convertToFormat(QImage::Format_RGB888);
+    }
+    else if (img->getColorType() == SlideColorManagement::ColorType::RGB) {
+        ovImg = QImage(overview, overviewDimensions[0], overviewDimensions[1], overviewDimensions[0] * 3, QImage::Format_RGB888).copy();
+    }
+    delete[] overview;
+    return ovImg;
+}
+
+/**
+ * @brief 使用预加载完成的切片
+ * @param slide 预加载结果
+ */
+void SlideLoader::setPreloadedSlide(const PreloadedSlide& slide)
+{
+    _preloaded = slide;
+}
+
+/**
+ * @brief 线程运行函数
+ * @details 第一阶段打开切片并发出slideOpened，第二阶段读取缩略图，
+ *          由缩略图计算组织掩膜设置到图像后发出overviewLoaded，
+ *          第三阶段读取标签图像和属性后发出associatedDataLoaded
+ */
+void SlideLoader::run()
+{
+    if (_preloaded.image) {
+        _img = _preloaded.image;
+        emit slideOpened();
+        if (!_preloaded.overview.isNull()) {
+            emit overviewLoaded(_preloaded.overview);
+        }
+        _label = _preloaded.label;
+        _properties = _preloaded.properties;
+        _preloaded = PreloadedSlide();
+        emit associatedDataLoaded();
+        return;
+    }
+    MultiResolutionImageReader imgReader;
+    std::shared_ptr<MultiResolutionImage> img(imgReader.open(_fileName.toStdString(), "default"));
+    if (!img) {
+        emit openFailed(QStringLiteral("InValid File"));
+        return;
+    }
+    if (!img->valid()) {
+        emit openFailed(QStringLiteral("Unsupport Format"));
+        return;
+    }
+    _img = img;
+    emit slideOpened();
+
+    // 与PathologyViewer使用相同的对齐瓦片大小，使缩略图层级与最后渲染层级一致
+    QImage ovImg = loadOverview(img, TileManager::alignedTileSize(img, _tileSize));
+    if (!ovImg.isNull()) {
+        emit overviewLoaded(ovImg);
+    }
+
+    _label = img->getLabel();
+    _properties = img->getProperties();
+    emit associatedDataLoaded();
+}
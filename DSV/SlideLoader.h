@@ -0,0 +1,181 @@
+﻿/**
+ * @file    SlideLoader.h
+ * @brief   切片异步打开线程类，负责在后台打开切片并读取缩略图
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了DSV项目的异步切片打开功能，打开过程分为以下阶段：
+ *          - 打开文件并读取元数据（层级、尺寸、间距等）
+ *          - 读取缩略图层级，用于小地图显示
+ *          - 读取标签图像和全部属性，用于标签窗口和详情对话框
+ *          每个阶段完成后立即通过信号通知GUI线程，GUI线程据此逐步显示，
+ *          首批瓦片由IOThread在元数据就绪后随即开始加载。
+ *
+ * @note    打开大文件或网络存储上的文件时，GUI线程保持响应
+ * @see     MainWin, PathologyViewer, MultiResolutionImageReader
+ */
+
+#pragma once
+
+#include <QThread>
+#include <QImage>
+#include <QString>
+#include <memory>
+#include <vector>
+#include "SlideColorManagement.h"
+#include "SlidePreloader.h"
+
+class MultiResolutionImage;
+
+/**
+ * @brief   切片异步打开线程类
+ * @details 每次打开文件创建一个SlideLoader对象，run()中依次完成打开、缩略图读取和关联数据读取，
+ *          通过slideOpened、overviewLoaded、associatedDataLoaded、openFailed信号报告各阶段结果。
+ *          信号以排队方式送达GUI线程，按发出顺序处理。
+ *          标签图像和属性不在首屏显示的关键路径上，因此最后读取。
+ *
+ *          用户在打开过程中再次打开其他文件时，调用方断开旧对象的信号即可丢弃其结果；
+ *          旧对象在线程结束后自行释放。
+ *
+ * @note    析构函数会等待线程结束，底层打开调用无法中途取消
+ *
+ * @example
+ * @code
+ * SlideLoader* loader = new SlideLoader(fileName, tileSize, this);
+ * connect(loader, SIGNAL(slideOpened()), this, SLOT(onSlideOpened()));
+ * connect(loader, SIGNAL(overviewLoaded(const QImage&)), this, SLOT(onOverviewLoaded(const QImage&)));
+ * connect(loader, SIGNAL(finished()), loader, SLOT(deleteLater()));
+ * loader->start();
+ * @endcode
+ */
+class SlideLoader : public QThread
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief   构造函数
+     * @param   fileName 切片文件路径
+     * @param   tileSize 瓦片大小，用于确定缩略图层级
+     * @param   parent   父对象指针
+     */
+    SlideLoader(const QString& fileName, unsigned int tileSize, QObject* parent = 0);
+
+    /**
+     * @brief   析构函数
+     * @details 等待线程结束后释放资源
+     */
+    ~SlideLoader();
+
+    /**
+     * @brief   获取切片文件路径
+     * @return  文件路径
+     */
+    QString getFileName() const;
+
+    /**
+     * @brief   获取已打开的图像
+     * @return  图像对象，打开完成前或打开失败时为空指针
+     * @note    应在slideOpened信号之后调用
+     */
+    std::shared_ptr<MultiResolutionImage> getImage() const;
+
+    /**
+     * @brief   获取标签图像
+     * @return  标签图像，切片没有标签时为空图像
+     * @note    应在associatedDataLoaded信号之后调用
+     */
+    QImage getLabel() const;
+
+    /**
+     * @brief   获取图像属性
+     * @return  属性列表
+     * @note    应在associatedDataLoaded信号之后调用
+     */
+    std::vector<SlideColorManagement::PropertyInfo> getProperties() const;
+
+    /**
+     * @brief   确定缩略图层级
+     * @details 从最低分辨率层级开始，返回第一个宽高都大于瓦片大小的层级，
+     *          所有层级都不满足时返回最低分辨率层级
+     *
+     * @param   img      图像对象
+     * @param   tileSize 瓦片大小
+     * @return  层级索引
+     * @note    PathologyViewer以该层级作为场景坐标和小地图的基准层级
+     */
+    static unsigned int getOverviewLevel(const std::shared_ptr<MultiResolutionImage>& img, unsigned int tileSize);
+
+    /**
+     * @brief   读取缩略图并设置组织掩膜
+     * @details 读取getOverviewLevel层级的整幅图像，明场RGB切片由其计算组织掩膜并设置到图像；
+     *          其余图像从磁盘缓存读取或新建切片统计并设置到图像
+     *
+     * @param   img      图像对象
+     * @param   tileSize 对齐后的瓦片大小
+     * @return  RGB888缩略图，非RGB图像返回空图像
+     * @see     SlidePreloader
+     */
+    static QImage loadOverview(const std::shared_ptr<MultiResolutionImage>& img, unsigned int tileSize);
+
+    /**
+     * @brief   使用预加载完成的切片
+     * @details 应在start()之前调用。run()不再打开文件，直接依次发出各阶段的信号
+     *
+     * @param   slide 预加载结果
+     * @see     SlidePreloader::take
+     */
+    void setPreloadedSlide(const PreloadedSlide& slide);
+
+signals:
+    /**
+     * @brief   切片打开完成信号
+     * @details 元数据已可用，通过getImage()获取图像
+     */
+    void slideOpened();
+
+    /**
+     * @brief   缩略图读取完成信号
+     * @param   overview 缩略图层级的完整图像
+     */
+    void overviewLoaded(const QImage& overview);
+
+    /**
+     * @brief   关联数据读取完成信号
+     * @details 标签图像和属性已可用，通过getLabel()、getProperties()获取
+     */
+    void associatedDataLoaded();
+
+    /**
+     * @brief   打开失败信号
+     * @param   message 状态栏显示的错误信息
+     */
+    void openFailed(const QString& message);
+
+protected:
+    /**
+     * @brief   线程运行函数
+     * @details 打开切片，发出slideOpened后读取缩略图层级并发出overviewLoaded，
+     *          最后读取标签图像和属性并发出associatedDataLoaded；有预加载结果时直接发出这些信号
+     */
+    void run();
+
+private:
+    /** @brief 切片文件路径 */
+    QString _fileName;
+
+    /** @brief 瓦片大小 */
+    unsigned int _tileSize;
+
+    /** @brief 已打开的图像，slideOpened之后不再修改 */
+    std::shared_ptr<MultiResolutionImage> _img;
+
+    /** @brief 标签图像，associatedDataLoaded之后不再修改 */
+    QImage _label;
+
+    /** @brief 图像属性，associatedDataLoaded之后不再修改 */
+    std::vector<SlideColorManagement::PropertyInfo> _properties;
+
+    /** @brief 预加载结果，image为空表示没有 */
+    PreloadedSlide _preloaded;
+};
@@ -0,0 +1,248 @@
+﻿/**
+ * @file SlidePreloader.cpp
+ * @brief 工作列表预加载线程实现文件
+ * @details 在后台打开后续切片，读取缩略图、标签和缩略图层级的瓦片
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "SlidePreloader.h"
+#include "MultiResolutionImage.h"
+#include "MultiResolutionImageFactory.h"
+#include "SlideLoader.h"
+#include "TileManager.h"
+#include "TissueMask.h"
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief 构造函数
+ * @param parent 父对象指针
+ */
+SlidePreloader::SlidePreloader(QObject* parent) :
+    QThread(parent),
+    _tileSize(0),
+    _maxSlides(kDefaultMaxSlides),
+    _maxTilesPerSlide(kDefaultMaxTiles),
+    _maxBytesPerSlide(kDefaultMaxBytes),
+    _cancelActive(false),
+    _abort(false)
+{
+}
+
+/**
+ * @brief 析构函数
+ * @details 中止当前的预加载并等待线程结束
+ */
+SlidePreloader::~SlidePreloader()
+{
+    _mutex.lock();
+    _abort = true;
+    _condition.wakeOne();
+    _mutex.unlock();
+    wait();
+}
+
+/**
+ * @brief 设置需要预加载的切片
+ * @param files 按阅片顺序排列的后续切片
+ * @param tileSize 瓦片大小
+ */
+void SlidePreloader::setWorklist(const QStringList& files, unsigned int tileSize)
+{
+    QMutexLocker locker(&_mutex);
+    _worklist = files.mid(0, static_cast<int>(_maxSlides));
+    _tileSize = tileSize;
+    for (std::map<QString, PreloadedSlide>::iterator it = _ready.begin(); it != _ready.end();) {
+        it = _worklist.contains(it->first) ? std::next(it) : _ready.erase(it);
+    }
+    _pending.clear();
+    for (const QString& file : _worklist) {
+        if (file != _active && _ready.find(file) == _ready.end()) {
+            _pending.push_back(file);
+        }
+    }
+    _cancelActive = !_active.isEmpty() && !_worklist.contains(_active);
+    if (_pending.empty()) {
+        return;
+    }
+    if (!isRunning()) {
+        start(LowestPriority);
+    }
+    else {
+        _condition.wakeOne();
+    }
+}
+
+/**
+ * @brief 取走预加载完成的切片
+ * @param fileName 切片文件路径
+ * @param slide 输出预加载结果
+ * @return 已预加载完成时返回true
+ */
+bool SlidePreloader::take(const QString& fileName, PreloadedSlide& slide)
+{
+    QMutexLocker locker(&_mutex);
+    std::map<QString, PreloadedSlide>::iterator it = _ready.find(fileName);
+    if (it == _ready.end()) {
+        return false;
+    }
+    slide = it->second;
+    _ready.erase(it);
+    return true;
+}
+
+/**
+ * @brief 设置预加载预算
+ * @param maxSlides 最多预加载的切片数
+ * @param maxTilesPerSlide 每张切片最多读取的瓦片数
+ * @param maxBytesPerSlide 每张切片最多读取的字节数
+ * @details 在下一次setWorklist时生效
+ */
+void SlidePreloader::setBudget(unsigned int maxSlides, unsigned int maxTilesPerSlide, unsigned long long maxBytesPerSlide)
+{
+    QMutexLocker locker(&_mutex);
+    _maxSlides = maxSlides;
+    _maxTilesPerSlide = maxTilesPerSlide;
+    _maxBytesPerSlide = maxBytesPerSlide;
+}
+
+/**
+ * @brief 获取最多预加载的切片数
+ * @return 切片数
+ */
+unsigned int SlidePreloader::getMaxSlides() const
+{
+    QMutexLocker locker(&_mutex);
+    return _maxSlides;
+}
+
+/**
+ * @brief 是否仍需要预加载该切片
+ * @param fileName 切片文件路径
+ * @return 属于当前工作列表时返回true
+ */
+bool SlidePreloader::isWanted(const QString& fileName) const
+{
+    return _worklist.contains(fileName);
+}
+
+/**
+ * @brief 线程运行函数
+ * @details 没有待预加载的切片时等待setWorklist唤醒
+ */
+void SlidePreloader::run()
+{
+    forever {
+        QString fileName;
+        {
+            QMutexLocker locker(&_mutex);
+            while (!_abort && _pending.empty()) {
+                _condition.wait(&_mutex);
+            }
+            if (_abort) {
+                return;
+            }
+            fileName = _pending.front();
+            _pending.pop_front();
+            _active = fileName;
+            _cancelActive = false;
+        }
+        PreloadedSlide slide;
+        const bool loaded = preload(fileName, slide);
+        QMutexLocker locker(&_mutex);
+        _active.clear();
+        if (loaded && !_cancelActive && isWanted(fileName)) {
+            _ready[fileName] = slide;
+        }
+    }
+}
+
+/**
+ * @brief 预加载一张切片
+ * @param fileName 切片文件路径
+ * @param slide 输出预加载结果
+ * @return 预加载完成时返回true
+ * @details 与SlideLoader的三个阶段相同，之后按预算读取缩略图层级和下一层级的瓦片
+ */
+bool SlidePreloader::preload(const QString& fileName, PreloadedSlide& slide)
+{
+    unsigned int preferred, tilesLeft;
+    unsigned long long bytesLeft;
+    {
+        QMutexLocker locker(&_mutex);
+        preferred = _tileSize;
+        tilesLeft = _maxTilesPerSlide;
+        bytesLeft = _maxBytesPerSlide;
+    }
+    MultiResolutionImageReader imgReader;
+    std::shared_ptr<MultiResolutionImage> img(imgReader.open(fileName.toStdString(), "default"));
+    if (!img || !img->valid() || _abort || _cancelActive) {
+        return false;
+    }
+    // 查看器接管前解码瓦片缓存只占预加载预算，不与正在阅读的切片争抢内存
+    img->setCacheSize(std::min(img->getCacheSize(), bytesLeft));
+    const unsigned int tileSize = TileManager::alignedTileSize(img, preferred);
+    slide.overview = SlideLoader::loadOverview(img, tileSize);
+    slide.label = img->getLabel();
+    slide.properties = img->getProperties();
+    const unsigned int overviewLevel = SlideLoader::getOverviewLevel(img, tileSize);
+    // 首屏显示缩略图层级的全部瓦片，适应窗口的视场通常落在下一层级
+    bool complete = preloadLevel(img.get(), overviewLevel, tileSize, tilesLeft, bytesLeft);
+    if (complete && overviewLevel > 0) {
+        // 下一层级可能是放大瓦片的粗层级，按查看器的瓦片网格读取才能命中缓存
+        const std::vector<unsigned int> levelTileSizes = TileManager::levelTileSizes(img, preferred, overviewLevel, img->getReadLatency());
+        preloadLevel(img.get(), overviewLevel - 1, levelTileSizes[overviewLevel - 1], tilesLeft, bytesLeft);
+    }
+    if (_abort || _cancelActive) {
+        return false;
+    }
+    slide.image = img;
+    return true;
+}
+
+/**
+ * @brief 读取一个层级的全部瓦片
+ * @param img 图像对象
+ * @param level 层级
+ * @param tileSize 该层级的瓦片大小，与查看器的瓦片网格一致
+ * @param tilesLeft 剩余瓦片预算
+ * @param bytesLeft 剩余字节预算
+ * @return 预算耗尽或需要放弃时返回false
+ */
+bool SlidePreloader::preloadLevel(MultiResolutionImage* img, unsigned int level, unsigned int tileSize, unsigned int& tilesLeft,
+    unsigned long long& bytesLeft)
+{
+    const std::vector<unsigned long long> dimensions = img->getLevelDimensions(level);
+    const double levelDownsample = img->getLevelDownsample(level);
+    const double tileExtent = levelDownsample * tileSize;
+    const bool argb32 = img->getColorType() == SlideColorManagement::ColorType::RGB && img->getDataType() == SlideColorManagement::DataType::UChar;
+    const unsigned long long tileBytes = static_cast<unsigned long long>(tileSize) * tileSize * (argb32 ? 4 : img->getSamplesPerPixel());
+    std::shared_ptr<const TissueMask> tissueMask = img->getTissueMask();
+    _buffer.resize(static_cast<size_t>(tileSize) * tileSize * std::max<unsigned int>(1, (img->getSamplesPerPixel() + 3) / 4));
+    for (unsigned long long tileY = 0; tileY * tileSize < dimensions[1]; ++tileY) {
+        for (unsigned long long tileX = 0; tileX * tileSize < dimensions[0]; ++tileX) {
+            if (_abort || _cancelActive) {
+                return false;
+            }
+            const long long startX = std::llround(tileX * tileExtent);
+            const long long startY = std::llround(tileY * tileExtent);
+            if (tissueMask && !tissueMask->containsTissue(startX, startY, tileExtent, tileExtent)) {
+                continue;
+            }
+            if (tilesLeft == 0 || bytesLeft < tileBytes) {
+                return false;
+            }
+            --tilesLeft;
+            bytesLeft -= tileBytes;
+            if (argb32 && img->getARGB32Region(startX, startY, tileSize, tileSize, level, _buffer.data())) {
+                continue;
+            }
+            unsigned char* data = reinterpret_cast<unsigned char*>(_buffer.data());
+            img->getRawRegion(startX, startY, tileSize, tileSize, level, data);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,196 @@
+﻿/**
+ * @file    SlidePreloader.h
+ * @brief   工作列表预加载线程，在阅片时后台打开后续切片
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了按工作列表顺序预加载后续切片的功能，包括：
+ *          - 打开切片并读取元数据、缩略图、标签图像
+ *          - 读取缩略图层级及下一层级的瓦片，结果进入解码瓦片缓存和磁盘缓存
+ *          - 按切片数、每张切片的瓦片数和字节数限制预加载量
+ *          切换到下一张切片时SlideLoader直接使用已打开的图像，首屏显示无需等待打开和解码。
+ *
+ * @note    预加载线程以最低优先级运行，工作列表改变时放弃不再需要的切片
+ * @see     SlideLoader, FileWidget::nextSlides, MainWin::onOpenFile
+ */
+
+#pragma once
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QImage>
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+#include "SlideColorManagement.h"
+
+class MultiResolutionImage;
+
+/**
+ * @struct  PreloadedSlide
+ * @brief   预加载完成的切片
+ * @details 与SlideLoader各阶段的结果一致，SlideLoader据此一次发出全部信号
+ */
+struct PreloadedSlide {
+    /** @brief 已打开的图像，组织掩膜已设置 */
+    std::shared_ptr<MultiResolutionImage> image;
+
+    /** @brief 缩略图 */
+    QImage overview;
+
+    /** @brief 标签图像 */
+    QImage label;
+
+    /** @brief 图像属性 */
+    std::vector<SlideColorManagement::PropertyInfo> properties;
+};
+
+/**
+ * @class  SlidePreloader
+ * @brief  工作列表预加载线程
+ * @details 每次打开切片后，MainWin把工作列表中紧随其后的切片交给setWorklist。
+ *          线程依次预加载这些切片，完成的结果保存到被take取走或不再属于工作列表为止。
+ *          预加载图像的解码瓦片缓存限制为每张切片的字节预算，由查看器接管后按全局内存预算重新分配
+ *
+ * @example
+ * @code
+ * SlidePreloader* preloader = new SlidePreloader(this);
+ * PreloadedSlide slide;
+ * if (preloader->take(fileName, slide)) {
+ *     loader->setPreloadedSlide(slide);
+ * }
+ * preloader->setWorklist(fileWidget->nextSlides(fileName, preloader->getMaxSlides()), tileSize);
+ * @endcode
+ */
+class SlidePreloader : public QThread
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief   构造函数
+     * @param   parent 父对象指针
+     */
+    SlidePreloader(QObject* parent = 0);
+
+    /**
+     * @brief   析构函数
+     * @details 中止当前切片的预加载并等待线程结束
+     */
+    ~SlidePreloader();
+
+    /**
+     * @brief   设置需要预加载的切片
+     * @param   files 按阅片顺序排列的后续切片，超出getMaxSlides的部分被忽略
+     * @param   tileSize 查看器的瓦片大小，与TileManager的瓦片网格一致
+     * @details 已完成但不在列表中的结果被释放；正在预加载的切片不在列表中时放弃
+     */
+    void setWorklist(const QStringList& files, unsigned int tileSize);
+
+    /**
+     * @brief   取走预加载完成的切片
+     * @param   fileName 切片文件路径
+     * @param   slide 输出预加载结果
+     * @return  该切片已预加载完成时返回true
+     */
+    bool take(const QString& fileName, PreloadedSlide& slide);
+
+    /**
+     * @brief   设置预加载预算
+     * @param   maxSlides 最多预加载的切片数，0表示关闭预加载
+     * @param   maxTilesPerSlide 每张切片最多读取的瓦片数（IO预算）
+     * @param   maxBytesPerSlide 每张切片最多读取的瓦片字节数，同时是预加载期间解码瓦片缓存的上限
+     */
+    void setBudget(unsigned int maxSlides, unsigned int maxTilesPerSlide, unsigned long long maxBytesPerSlide);
+
+    /**
+     * @brief   获取最多预加载的切片数
+     * @return  切片数
+     */
+    unsigned int getMaxSlides() const;
+
+protected:
+    /**
+     * @brief   线程运行函数
+     * @details 依次取出待预加载的切片，预加载完成且仍属于工作列表时保存结果
+     */
+    void run();
+
+private:
+    /**
+     * @brief   预加载一张切片
+     * @param   fileName 切片文件路径
+     * @param   slide 输出预加载结果
+     * @return  切片无法打开或预加载被放弃时返回false
+     */
+    bool preload(const QString& fileName, PreloadedSlide& slide);
+
+    /**
+     * @brief   读取一个层级的全部瓦片
+     * @param   img 图像对象
+     * @param   level 层级
+     * @param   tileSize 该层级的瓦片大小，与TileManager::levelTileSizes一致
+     * @param   tilesLeft 剩余瓦片预算
+     * @param   bytesLeft 剩余字节预算
+     * @return  预算耗尽或需要放弃时返回false
+     * @details 与IOWorker::readBackgroundImage的读取方式和瓦片网格一致，从而使用同一缓存键；
+     *          组织掩膜判定为背景的瓦片跳过
+     */
+    bool preloadLevel(MultiResolutionImage* img, unsigned int level, unsigned int tileSize, unsigned int& tilesLeft, unsigned long long& bytesLeft);
+
+    /** @brief 是否仍需要预加载该切片，调用时需持有_mutex */
+    bool isWanted(const QString& fileName) const;
+
+    /** @brief 保护以下成员的互斥锁 */
+    mutable QMutex _mutex;
+
+    /** @brief 等待新的工作列表 */
+    QWaitCondition _condition;
+
+    /** @brief 当前工作列表 */
+    QStringList _worklist;
+
+    /** @brief 待预加载的切片 */
+    std::deque<QString> _pending;
+
+    /** @brief 预加载完成的切片 */
+    std::map<QString, PreloadedSlide> _ready;
+
+    /** @brief 正在预加载的切片 */
+    QString _active;
+
+    /** @brief 瓦片大小 */
+    unsigned int _tileSize;
+
+    /** @brief 最多预加载的切片数 */
+    unsigned int _maxSlides;
+
+    /** @brief 每张切片最多读取的瓦片数 */
+    unsigned int _maxTilesPerSlide;
+
+    /** @brief 每张切片最多读取的字节数 */
+    unsigned long long _maxBytesPerSlide;
+
+    /** @brief 正在预加载的切片已不在工作列表中 */
+    std::atomic<bool> _cancelActive;
+
+    /** @brief 线程中止标志 */
+    std::atomic<bool> _abort;
+
+    /** @brief 瓦片读取缓冲区，在瓦片之间复用 */
+    std::vector<unsigned int> _buffer;
+
+    /** @brief 默认最多预加载的切片数 */
+    static const unsigned int kDefaultMaxSlides = 2;
+
+    /** @brief 默认每张切片最多读取的瓦片数 */
+    static const unsigned int kDefaultMaxTiles = 256;
+
+    /** @brief 默认每张切片最多读取的字节数 */
+    static const unsigned long long kDefaultMaxBytes = 128ULL * 1024 * 1024;
+};
@@ -0,0 +1,576 @@
+﻿/**
+ * @file SlideStatistics.cpp
+ * @brief 切片统计金字塔实现文件
+ * @details 该文件实现了切片统计的累计、查询和持久化，包括：
+ *          - 单元的占用、直方图计算与合并
+ *          - 范围层级的选择和百分位数计算
+ *          - 附属文件的QDataStream序列化
+ *          - 从低分辨率层级开始的后台统计任务
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "SlideStatistics.h"
+#include "MultiResolutionImage.h"
+#include "TileBufferPool.h"
+#include <QByteArray>
+#include <QDataStream>
+#include <QFile>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+const char* const SlideStatistics::kFileSuffix = ".stats";
+
+namespace {
+
+/** @brief 文件魔数 */
+const quint32 kStatisticsMagic = 0x44535653; // "DSVS"
+
+/** @brief 文件格式版本 */
+const quint32 kStatisticsVersion = 1;
+
+/**
+ * @brief 配置数据流的字节序和浮点精度，保证文件跨平台一致
+ */
+void setupStream(QDataStream& stream)
+{
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::DoublePrecision);
+}
+
+}
+
+/**
+ * @brief 构造函数
+ * @param img 图像
+ * @param lowerBound 直方图下限
+ * @param binWidth 区间宽度
+ * @param bins 区间数
+ * @details 按图像的层级尺寸划分单元，所有层级的直方图清零
+ */
+SlideStatistics::SlideStatistics(MultiResolutionImage* img, double lowerBound, double binWidth, unsigned int bins) :
+    _dataType(static_cast<int>(img->getDataType())),
+    _channels(img->getSamplesPerPixel()),
+    _lowerBound(lowerBound),
+    _binWidth(binWidth),
+    _bins(bins),
+    _rangeLevel(-1)
+{
+    _levels.resize(img->getNumberOfLevels());
+    for (unsigned int i = 0; i < _levels.size(); ++i) {
+        Level& level = _levels[i];
+        const std::vector<unsigned long long> dims = img->getLevelDimensions(i);
+        level.width = dims[0];
+        level.height = dims[1];
+        level.cellsX = static_cast<unsigned int>((level.width + kCellSize - 1) / kCellSize);
+        level.cellsY = static_cast<unsigned int>((level.height + kCellSize - 1) / kCellSize);
+        level.claimed.assign(static_cast<size_t>(level.cellsX) * level.cellsY, 0);
+        level.histograms.assign(static_cast<size_t>(_channels) * _bins, 0);
+        level.minValues.assign(_channels, std::numeric_limits<double>::max());
+        level.maxValues.assign(_channels, std::numeric_limits<double>::lowest());
+    }
+}
+
+/**
+ * @brief 为图像创建空的统计
+ * @param img 图像
+ * @return 统计对象，失败时返回空指针
+ */
+std::shared_ptr<SlideStatistics> SlideStatistics::create(MultiResolutionImage* img)
+{
+    if (!img || !img->valid() || img->getSamplesPerPixel() == 0 || img->getNumberOfLevels() <= 0) {
+        return std::shared_ptr<SlideStatistics>();
+    }
+    switch (img->getDataType()) {
+    case SlideColorManagement::DataType::UChar:
+        return std::shared_ptr<SlideStatistics>(new SlideStatistics(img, 0., 1., 256));
+    case SlideColorManagement::DataType::UInt16:
+        return std::shared_ptr<SlideStatistics>(new SlideStatistics(img, 0., 65536. / kHistogramBins, kHistogramBins));
+    case SlideColorManagement::DataType::UInt32:
+    case SlideColorManagement::DataType::Float:
+        break;
+    default:
+        return std::shared_ptr<SlideStatistics>();
+    }
+
+    // 值域未知的类型先读取最低分辨率层级确定直方图范围，读取的数据直接作为该层级的统计
+    const unsigned int lastLevel = img->getNumberOfLevels() - 1;
+    const std::vector<unsigned long long> dims = img->getLevelDimensions(lastLevel);
+    const unsigned int channels = img->getSamplesPerPixel();
+    TileBuffer<float> buffer(static_cast<size_t>(dims[0]) * dims[1] * channels);
+    if (!img->readRegion<float>(0, 0, dims[0], dims[1], lastLevel, buffer.get(), 0, 0)) {
+        return std::shared_ptr<SlideStatistics>();
+    }
+    float minValue = std::numeric_limits<float>::max();
+    float maxValue = std::numeric_limits<float>::lowest();
+    const float* data = buffer.get();
+    for (size_t i = 0, n = static_cast<size_t>(dims[0]) * dims[1] * channels; i < n; ++i) {
+        if (data[i] == data[i]) {
+            minValue = std::min(minValue, data[i]);
+            maxValue = std::max(maxValue, data[i]);
+        }
+    }
+    if (!(maxValue >= minValue)) {
+        minValue = 0.f;
+        maxValue = 1.f;
+    }
+    const double span = maxValue > minValue ? static_cast<double>(maxValue) - minValue : 1.;
+    std::shared_ptr<SlideStatistics> statistics(new SlideStatistics(img, minValue, span / kHistogramBins, kHistogramBins));
+    statistics->accumulate(lastLevel, 0, 0, dims[0], dims[1], data);
+    statistics->updateRange();
+    return statistics;
+}
+
+/**
+ * @brief 提交一块层级数据
+ * @param level 层级
+ * @param x 数据左边
+ * @param y 数据上边
+ * @param width 数据宽度
+ * @param height 数据高度
+ * @param data 样本数据
+ * @details 先在锁内占用完整覆盖且未统计的单元，再在锁外计算这些单元的直方图，最后在锁内合并
+ */
+template<typename T>
+void SlideStatistics::accumulate(unsigned int level, long long x, long long y, unsigned long long width, unsigned long long height, const T* data)
+{
+    if (!data || level >= _levels.size() || x < 0 || y < 0) {
+        return;
+    }
+    Level& target = _levels[level];
+    const unsigned long long right = std::min(static_cast<unsigned long long>(x) + width, target.width);
+    const unsigned long long bottom = std::min(static_cast<unsigned long long>(y) + height, target.height);
+    const unsigned int firstCellX = static_cast<unsigned int>((x + kCellSize - 1) / kCellSize);
+    const unsigned int firstCellY = static_cast<unsigned int>((y + kCellSize - 1) / kCellSize);
+    std::vector<unsigned int> cells;
+    {
+        QMutexLocker locker(&_mutex);
+        for (unsigned int cy = firstCellY; cy < target.cellsY && std::min(static_cast<unsigned long long>(cy + 1) * kCellSize, target.height) <= bottom; ++cy) {
+            for (unsigned int cx = firstCellX; cx < target.cellsX && std::min(static_cast<unsigned long long>(cx + 1) * kCellSize, target.width) <= right; ++cx) {
+                const unsigned int index = cy * target.cellsX + cx;
+                if (!target.claimed[index]) {
+                    target.claimed[index] = 1;
+                    cells.push_back(index);
+                }
+            }
+        }
+    }
+    if (cells.empty()) {
+        return;
+    }
+
+    std::vector<unsigned int> histograms(static_cast<size_t>(_channels) * _bins, 0);
+    std::vector<double> minValues(_channels, std::numeric_limits<double>::max());
+    std::vector<double> maxValues(_channels, std::numeric_limits<double>::lowest());
+    const double binScale = 1. / _binWidth;
+    const long long lastBin = static_cast<long long>(_bins) - 1;
+    for (unsigned int index : cells) {
+        const unsigned long long cellX = static_cast<unsigned long long>(index % target.cellsX) * kCellSize;
+        const unsigned long long cellY = static_cast<unsigned long long>(index / target.cellsX) * kCellSize;
+        const unsigned long long cellWidth = std::min<unsigned long long>(kCellSize, target.width - cellX);
+        const unsigned long long cellHeight = std::min<unsigned long long>(kCellSize, target.height - cellY);
+        for (unsigned long long row = 0; row < cellHeight; ++row) {
+            const T* samples = data + ((cellY + row - y) * width + (cellX - x)) * _channels;
+            for (unsigned long long column = 0; column < cellWidth; ++column, samples += _channels) {
+                for (unsigned int c = 0; c < _channels; ++c) {
+                    const double value = static_cast<double>(samples[c]);
+                    if (value != value) {
+                        continue;
+                    }
+                    minValues[c] = std::min(minValues[c], value);
+                    maxValues[c] = std::max(maxValues[c], value);
+                    const long long bin = std::max(0LL, std::min(lastBin, static_cast<long long>((value - _lowerBound) * binScale)));
+                    ++histograms[c * _bins + bin];
+                }
+            }
+        }
+    }
+
+    QMutexLocker locker(&_mutex);
+    for (size_t i = 0; i < histograms.size(); ++i) {
+        target.histograms[i] += histograms[i];
+    }
+    for (unsigned int c = 0; c < _channels; ++c) {
+        target.minValues[c] = std::min(target.minValues[c], minValues[c]);
+        target.maxValues[c] = std::max(target.maxValues[c], maxValues[c]);
+    }
+    target.cellsDone += static_cast<unsigned int>(cells.size());
+}
+
+/**
+ * @brief 重新选择范围层级
+ * @return 范围层级变化时返回true
+ * @details 选择最精细的完整层级
+ */
+bool SlideStatistics::updateRange()
+{
+    QMutexLocker locker(&_mutex);
+    int rangeLevel = -1;
+    for (unsigned int i = 0; i < _levels.size(); ++i) {
+        if (_levels[i].cellsDone == _levels[i].claimed.size()) {
+            rangeLevel = static_cast<int>(i);
+            break;
+        }
+    }
+    if (rangeLevel == _rangeLevel) {
+        return false;
+    }
+    _rangeLevel = rangeLevel;
+    return true;
+}
+
+/**
+ * @brief 获取范围层级
+ * @return 层级索引，没有时返回-1
+ */
+int SlideStatistics::getRangeLevel() const
+{
+    QMutexLocker locker(&_mutex);
+    return _rangeLevel;
+}
+
+/**
+ * @brief 获取通道在范围层级中的最小值和最大值
+ * @param channel 通道索引，-1表示所有通道
+ * @param minValue 输出最小值
+ * @param maxValue 输出最大值
+ * @return 成功时返回true
+ */
+bool SlideStatistics::getRange(int channel, double& minValue, double& maxValue) const
+{
+    QMutexLocker locker(&_mutex);
+    if (_rangeLevel < 0 || channel >= static_cast<int>(_channels)) {
+        return false;
+    }
+    const Level& level = _levels[_rangeLevel];
+    if (channel >= 0) {
+        minValue = level.minValues[channel];
+        maxValue = level.maxValues[channel];
+    }
+    else {
+        minValue = *std::min_element(level.minValues.begin(), level.minValues.end());
+        maxValue = *std::max_element(level.maxValues.begin(), level.maxValues.end());
+    }
+    return maxValue >= minValue;
+}
+
+/**
+ * @brief 获取通道在范围层级中的百分位数
+ * @param channel 通道索引
+ * @param percentile 百分位
+ * @param value 输出值
+ * @return 成功时返回true
+ */
+bool SlideStatistics::getPercentile(unsigned int channel, double percentile, double& value) const
+{
+    QMutexLocker locker(&_mutex);
+    if (_rangeLevel < 0 || channel >= _channels) {
+        return false;
+    }
+    const Level& level = _levels[_rangeLevel];
+    const unsigned long long* histogram = level.histograms.data() + static_cast<size_t>(channel) * _bins;
+    unsigned long long total = 0;
+    for (unsigned int bin = 0; bin < _bins; ++bin) {
+        total += histogram[bin];
+    }
+    if (total == 0) {
+        return false;
+    }
+    const double target = std::max(0., std::min(100., percentile)) / 100. * total;
+    double cumulative = 0.;
+    unsigned int bin = 0;
+    for (; bin + 1 < _bins && cumulative + histogram[bin] < target; ++bin) {
+        cumulative += histogram[bin];
+    }
+    const double fraction = histogram[bin] ? (target - cumulative) / histogram[bin] : 0.;
+    value = _lowerBound + (bin + fraction) * _binWidth;
+    value = std::max(level.minValues[channel], std::min(level.maxValues[channel], value));
+    return true;
+}
+
+/**
+ * @brief 计算自动窗宽窗位
+ * @param channel 通道索引
+ * @param lowPercentile 窗口下限的百分位
+ * @param highPercentile 窗口上限的百分位
+ * @param windowMin 输出窗口下限
+ * @param windowMax 输出窗口上限
+ * @return 成功时返回true
+ */
+bool SlideStatistics::getAutoWindow(unsigned int channel, double lowPercentile, double highPercentile, double& windowMin, double& windowMax) const
+{
+    if (!getPercentile(channel, lowPercentile, windowMin) || !getPercentile(channel, highPercentile, windowMax)) {
+        return false;
+    }
+    windowMax = std::max(windowMin, windowMax);
+    return true;
+}
+
+/**
+ * @brief 层级是否已完整统计
+ * @param level 层级
+ * @return 完整时返回true
+ */
+bool SlideStatistics::isLevelComplete(unsigned int level) const
+{
+    QMutexLocker locker(&_mutex);
+    return level < _levels.size() && _levels[level].cellsDone == _levels[level].claimed.size();
+}
+
+/**
+ * @brief 获取层级中尚未占用的单元
+ * @param level 层级
+ * @return 单元索引
+ */
+std::vector<unsigned int> SlideStatistics::getPendingCells(unsigned int level) const
+{
+    QMutexLocker locker(&_mutex);
+    std::vector<unsigned int> cells;
+    if (level < _levels.size()) {
+        const std::vector<unsigned char>& claimed = _levels[level].claimed;
+        for (unsigned int i = 0; i < claimed.size(); ++i) {
+            if (!claimed[i]) {
+                cells.push_back(i);
+            }
+        }
+    }
+    return cells;
+}
+
+/**
+ * @brief 写入附属文件
+ * @param path 文件路径
+ * @return 写入成功时返回true
+ * @details 只保存已合并的单元；已占用但尚未合并的单元按未统计保存，下次打开时重新统计
+ */
+bool SlideStatistics::save(const QString& path) const
+{
+    QByteArray payload;
+    {
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        setupStream(stream);
+        QMutexLocker locker(&_mutex);
+        stream << static_cast<qint32>(_dataType) << static_cast<quint32>(_channels) << _lowerBound << _binWidth << static_cast<quint32>(_bins)
+            << static_cast<quint32>(_levels.size());
+        for (const Level& level : _levels) {
+            // 合并未完成时占用标记多于已合并的单元，这种层级只保存尺寸，读取后重新统计
+            const bool consistent = level.cellsDone == static_cast<unsigned int>(std::count(level.claimed.begin(), level.claimed.end(), 1));
+            stream << static_cast<quint64>(level.width) << static_cast<quint64>(level.height) << static_cast<quint8>(consistent ? 1 : 0);
+            if (!consistent) {
+                continue;
+            }
+            stream << QByteArray(reinterpret_cast<const char*>(level.claimed.data()), static_cast<int>(level.claimed.size()))
+                << static_cast<quint32>(level.cellsDone);
+            for (unsigned int c = 0; c < _channels; ++c) {
+                stream << level.minValues[c] << level.maxValues[c];
+            }
+            for (unsigned long long count : level.histograms) {
+                stream << static_cast<quint64>(count);
+            }
+        }
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    setupStream(stream);
+    stream << kStatisticsMagic << kStatisticsVersion << qCompress(payload);
+    if (stream.status() != QDataStream::Ok) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+/**
+ * @brief 从附属文件读取统计
+ * @param path 文件路径
+ * @param img 图像
+ * @return 统计对象，失败时返回空指针
+ */
+std::shared_ptr<SlideStatistics> SlideStatistics::load(const QString& path, MultiResolutionImage* img)
+{
+    QFile file(path);
+    if (!img || !file.open(QIODevice::ReadOnly)) {
+        return std::shared_ptr<SlideStatistics>();
+    }
+    QDataStream fileStream(&file);
+    setupStream(fileStream);
+    quint32 magic = 0, version = 0;
+    QByteArray compressed;
+    fileStream >> magic >> version >> compressed;
+    if (fileStream.status() != QDataStream::Ok || magic != kStatisticsMagic || version != kStatisticsVersion) {
+        return std::shared_ptr<SlideStatistics>();
+    }
+    const QByteArray payload = qUncompress(compressed);
+    QDataStream stream(payload);
+    setupStream(stream);
+    qint32 dataType;
+    quint32 channels, bins, nrLevels;
+    double lowerBound, binWidth;
+    stream >> dataType >> channels >> lowerBound >> binWidth >> bins >> nrLevels;
+    if (stream.status() != QDataStream::Ok || dataType != static_cast<qint32>(img->getDataType()) || channels != img->getSamplesPerPixel()
+        || nrLevels != static_cast<quint32>(img->getNumberOfLevels()) || bins == 0 || bins > 65536 || !(binWidth > 0.)) {
+        return std::shared_ptr<SlideStatistics>();
+    }
+    std::shared_ptr<SlideStatistics> statistics(new SlideStatistics(img, lowerBound, binWidth, bins));
+    for (Level& level : statistics->_levels) {
+        quint64 width, height;
+        quint8 stored;
+        stream >> width >> height >> stored;
+        if (stream.status() != QDataStream::Ok || width != level.width || height != level.height) {
+            return std::shared_ptr<SlideStatistics>();
+        }
+        if (!stored) {
+            continue;
+        }
+        QByteArray claimed;
+        quint32 cellsDone;
+        stream >> claimed >> cellsDone;
+        if (stream.status() != QDataStream::Ok || static_cast<size_t>(claimed.size()) != level.claimed.size()) {
+            return std::shared_ptr<SlideStatistics>();
+        }
+        std::copy(claimed.constBegin(), claimed.constEnd(), level.claimed.begin());
+        level.cellsDone = cellsDone;
+        for (unsigned int c = 0; c < channels; ++c) {
+            stream >> level.minValues[c] >> level.maxValues[c];
+        }
+        for (unsigned long long& count : level.histograms) {
+            quint64 value;
+            stream >> value;
+            count = value;
+        }
+    }
+    if (stream.status() != QDataStream::Ok) {
+        return std::shared_ptr<SlideStatistics>();
+    }
+    statistics->updateRange();
+    return statistics;
+}
+
+template void SlideStatistics::accumulate<unsigned char>(unsigned int, long long, long long, unsigned long long, unsigned long long, const unsigned char*);
+template void SlideStatistics::accumulate<unsigned short>(unsigned int, long long, long long, unsigned long long, unsigned long long, const unsigned short*);
+template void SlideStatistics::accumulate<unsigned int>(unsigned int, long long, long long, unsigned long long, unsigned long long, const unsigned int*);
+template void SlideStatistics::accumulate<float>(unsigned int, long long, long long, unsigned long long, unsigned long long, const float*);
+
+/**
+ * @brief 构造函数
+ * @param img 图像
+ * @param statistics 图像的统计
+ * @param savePath 附属文件路径
+ * @param pixelBudget 像素预算
+ * @details 从最低分辨率层级向上收集尚未占用的单元，跳过虚拟层级；
+ *          加入某层级后像素总数超出预算时停止，有多个层级时不加入第0层
+ */
+SlideStatisticsBuilder::SlideStatisticsBuilder(std::weak_ptr<MultiResolutionImage> img, std::shared_ptr<SlideStatistics> statistics, const QString& savePath,
+    unsigned long long pixelBudget) :
+    QObject(),
+    _img(img),
+    _statistics(statistics),
+    _savePath(savePath),
+    _nextCell(0),
+    _cellsDone(0),
+    _cancelled(false)
+{
+    std::shared_ptr<MultiResolutionImage> local_img = _img.lock();
+    if (!local_img || !_statistics) {
+        return;
+    }
+    const int nrLevels = static_cast<int>(_statistics->getNumberOfLevels());
+    unsigned long long pixels = 0;
+    for (int level = nrLevels - 1; level >= 0; --level) {
+        if (level == 0 && nrLevels > 1) {
+            break;
+        }
+        if (local_img->isVirtualLevel(level)) {
+            continue;
+        }
+        pixels += _statistics->getLevelWidth(level) * _statistics->getLevelHeight(level);
+        if (pixels > pixelBudget && !_cells.empty()) {
+            break;
+        }
+        for (unsigned int index : _statistics->getPendingCells(level)) {
+            _cells.push_back({ static_cast<unsigned int>(level), index });
+        }
+    }
+}
+
+/**
+ * @brief 领取并处理下一个单元
+ * @return 没有剩余单元时返回false
+ */
+bool SlideStatisticsBuilder::processNextTile()
+{
+    const unsigned int index = _nextCell++;
+    if (index >= _cells.size()) {
+        return false;
+    }
+    std::shared_ptr<MultiResolutionImage> local_img = _img.lock();
+    if (!_cancelled && local_img) {
+        switch (local_img->getDataType()) {
+        case SlideColorManagement::DataType::UChar: processCell<unsigned char>(_cells[index]); break;
+        case SlideColorManagement::DataType::UInt16: processCell<unsigned short>(_cells[index]); break;
+        case SlideColorManagement::DataType::UInt32: processCell<unsigned int>(_cells[index]); break;
+        case SlideColorManagement::DataType::Float: processCell<float>(_cells[index]); break;
+        default: break;
+        }
+    }
+    cellDone();
+    return true;
+}
+
+/**
+ * @brief 取消任务
+ */
+void SlideStatisticsBuilder::cancel()
+{
+    _cancelled = true;
+}
+
+/**
+ * @brief 读取并统计一个单元
+ * @param cell 单元
+ * @details 读取第0个Z平面；单元已被视野瓦片统计时跳过读取
+ */
+template<typename T>
+void SlideStatisticsBuilder::processCell(const Cell& cell)
+{
+    std::shared_ptr<MultiResolutionImage> local_img = _img.lock();
+    if (!local_img) {
+        return;
+    }
+    const unsigned int cellsX = _statistics->getCellsX(cell.level);
+    const unsigned long long x = static_cast<unsigned long long>(cell.index % cellsX) * SlideStatistics::kCellSize;
+    const unsigned long long y = static_cast<unsigned long long>(cell.index / cellsX) * SlideStatistics::kCellSize;
+    const unsigned long long width = std::min<unsigned long long>(SlideStatistics::kCellSize, _statistics->getLevelWidth(cell.level) - x);
+    const unsigned long long height = std::min<unsigned long long>(SlideStatistics::kCellSize, _statistics->getLevelHeight(cell.level) - y);
+    const double downsample = local_img->getLevelDownsample(cell.level);
+    TileBuffer<T> buffer(static_cast<size_t>(width) * height * local_img->getSamplesPerPixel());
+    if (local_img->readRegion<T>(std::llround(x * downsample), std::llround(y * downsample), width, height, cell.level, buffer.get(), 0, 0)) {
+        _statistics->accumulate(cell.level, static_cast<long long>(x), static_cast<long long>(y), width, height, buffer.get());
+    }
+    if (_statistics->updateRange()) {
+        emit rangeChanged();
+    }
+}
+
+/**
+ * @brief 完成一个单元
+ * @details 最后一个单元完成时写入附属文件
+ */
+void SlideStatisticsBuilder::cellDone()
+{
+    if (++_cellsDone == _cells.size()) {
+        if (!_savePath.isEmpty()) {
+            _statistics->save(_savePath);
+        }
+        emit finished();
+    }
+}
@@ -0,0 +1,311 @@
+﻿/**
+ * @file    SlideStatistics.h
+ * @brief   切片统计金字塔，按层级保存各通道直方图
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了切片级别的通道统计，包括：
+ *          - 每个层级一组按通道的直方图和最小、最大值
+ *          - 层级按kCellSize见方的单元累计，每个单元只计入一次
+ *          - 后台任务从低分辨率层级开始逐级统计，不读取完整的第0层
+ *          - IOWorker加载的瓦片顺带计入对应层级，后台任务跳过已统计的单元
+ *          - 统计结果保存为磁盘缓存的附属文件，再次打开切片时直接使用
+ *          相对LUT的归一化范围、荧光通道的自动窗宽窗位都由最精细的完整层级给出。
+ *
+ * @note    只为非RGB图像创建，明场RGB切片不使用通道范围
+ * @see     MultiResolutionImage::setStatistics, SlideLoader, DiskTileCache::sidecarPath
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QMutex>
+#include <QString>
+#include "TileTask.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class MultiResolutionImage;
+
+/**
+ * @class  SlideStatistics
+ * @brief  切片统计金字塔
+ * @details 直方图在[图像下限, 图像上限]内等分：8位图像每个值一个区间，
+ *          16位图像4096个区间（每区间16个值），32位整数和浮点图像按最低分辨率层级的范围等分4096个区间，
+ *          范围以外的值计入两端区间，每个层级另外记录精确的最小值和最大值，NaN不计入。
+ *
+ *          层级被划分为kCellSize见方的单元，accumulate只计入被数据完整覆盖且尚未统计的单元，
+ *          所以后台统计和视野瓦片可以按任意顺序、任意瓦片大小重叠地提交数据。
+ *          所有单元都统计完成的层级为完整层级，updateRange选择最精细的完整层级作为范围层级，
+ *          getRange和getPercentile都基于范围层级，范围只在updateRange时变化，不随每个瓦片抖动。
+ *
+ * @note    该类是线程安全的
+ *
+ * @example
+ *          std::shared_ptr<SlideStatistics> statistics = img->getStatistics();
+ *          double windowMin, windowMax;
+ *          if (statistics && statistics->getAutoWindow(channel, 0.1, 99.9, windowMin, windowMax)) {
+ *              display.windowMin = windowMin;
+ *              display.windowMax = windowMax;
+ *          }
+ * @see     SlideStatisticsBuilder
+ */
+class SlideStatistics
+{
+public:
+    /** @brief 统计单元的边长（层级像素） */
+    static const unsigned int kCellSize = 256;
+
+    /** @brief 非8位图像的直方图区间数 */
+    static const unsigned int kHistogramBins = 4096;
+
+    /** @brief 附属文件后缀 */
+    static const char* const kFileSuffix;
+
+    /**
+     * @brief   为图像创建空的统计
+     * @param   img 图像
+     * @return  统计对象，图像无效或数据类型不支持时返回空指针
+     * @details 32位整数和浮点图像读取最低分辨率层级确定直方图范围，该层级的数据同时计入统计
+     */
+    static std::shared_ptr<SlideStatistics> create(MultiResolutionImage* img);
+
+    /**
+     * @brief   从附属文件读取统计
+     * @param   path 文件路径
+     * @param   img 图像，用于校验数据类型、通道数和层级尺寸
+     * @return  统计对象，文件不存在、格式错误或与图像不一致时返回空指针
+     */
+    static std::shared_ptr<SlideStatistics> load(const QString& path, MultiResolutionImage* img);
+
+    /**
+     * @brief   写入附属文件
+     * @param   path 文件路径
+     * @return  写入成功时返回true
+     * @note    直方图经zlib压缩，通过QSaveFile写入
+     */
+    bool save(const QString& path) const;
+
+    /**
+     * @brief   提交一块层级数据
+     * @tparam  T 样本类型，与图像的原生数据类型一致
+     * @param   level 层级
+     * @param   x 数据左边（层级像素）
+     * @param   y 数据上边（层级像素）
+     * @param   width 数据宽度
+     * @param   height 数据高度
+     * @param   data 交错排列的样本，行间无填充
+     * @details 只统计被数据完整覆盖（在层级边界处裁剪）且尚未统计的单元；
+     *          单元在统计前被占用，直方图在锁外计算后合并
+     */
+    template<typename T>
+    void accumulate(unsigned int level, long long x, long long y, unsigned long long width, unsigned long long height, const T* data);
+
+    /**
+     * @brief   重新选择范围层级
+     * @return  范围层级变化时返回true
+     */
+    bool updateRange();
+
+    /**
+     * @brief   获取范围层级
+     * @return  最近一次updateRange选择的层级，没有完整层级时返回-1
+     */
+    int getRangeLevel() const;
+
+    /**
+     * @brief   获取通道在范围层级中的最小值和最大值
+     * @param   channel 通道索引，-1表示所有通道
+     * @param   minValue 输出最小值
+     * @param   maxValue 输出最大值
+     * @return  没有范围层级或通道无效时返回false
+     */
+    bool getRange(int channel, double& minValue, double& maxValue) const;
+
+    /**
+     * @brief   获取通道在范围层级中的百分位数
+     * @param   channel 通道索引
+     * @param   percentile 百分位，0-100
+     * @param   value 输出值，在区间内线性插值并限制在最小值和最大值之间
+     * @return  没有范围层级或通道无效时返回false
+     */
+    bool getPercentile(unsigned int channel, double percentile, double& value) const;
+
+    /**
+     * @brief   计算自动窗宽窗位
+     * @param   channel 通道索引
+     * @param   lowPercentile 窗口下限的百分位
+     * @param   highPercentile 窗口上限的百分位
+     * @param   windowMin 输出窗口下限
+     * @param   windowMax 输出窗口上限，不小于windowMin
+     * @return  没有范围层级或通道无效时返回false
+     */
+    bool getAutoWindow(unsigned int channel, double lowPercentile, double highPercentile, double& windowMin, double& windowMax) const;
+
+    /**
+     * @brief   层级是否已完整统计
+     * @param   level 层级
+     * @return  所有单元都已统计时返回true
+     */
+    bool isLevelComplete(unsigned int level) const;
+
+    /**
+     * @brief   获取层级中尚未占用的单元
+     * @param   level 层级
+     * @return  单元索引（行优先）
+     */
+    std::vector<unsigned int> getPendingCells(unsigned int level) const;
+
+    /** @brief 获取层级数 */
+    unsigned int getNumberOfLevels() const { return static_cast<unsigned int>(_levels.size()); }
+
+    /** @brief 获取通道数 */
+    unsigned int getNumberOfChannels() const { return _channels; }
+
+    /** @brief 获取层级每行的单元数 */
+    unsigned int getCellsX(unsigned int level) const { return _levels[level].cellsX; }
+
+    /** @brief 获取层级宽度 */
+    unsigned long long getLevelWidth(unsigned int level) const { return _levels[level].width; }
+
+    /** @brief 获取层级高度 */
+    unsigned long long getLevelHeight(unsigned int level) const { return _levels[level].height; }
+
+private:
+    /**
+     * @brief   构造函数
+     * @param   img 图像
+     * @param   lowerBound 直方图下限
+     * @param   binWidth 区间宽度
+     * @param   bins 区间数
+     */
+    SlideStatistics(MultiResolutionImage* img, double lowerBound, double binWidth, unsigned int bins);
+
+    /**
+     * @brief 一个层级的统计
+     */
+    struct Level {
+        unsigned long long width = 0;                 ///< 层级宽度
+        unsigned long long height = 0;                ///< 层级高度
+        unsigned int cellsX = 0;                      ///< 每行单元数
+        unsigned int cellsY = 0;                      ///< 每列单元数
+        std::vector<unsigned char> claimed;           ///< 单元是否已被占用（统计中或已统计）
+        unsigned int cellsDone = 0;                   ///< 已合并的单元数
+        std::vector<unsigned long long> histograms;   ///< 各通道直方图，通道数 x 区间数
+        std::vector<double> minValues;                ///< 各通道最小值
+        std::vector<double> maxValues;                ///< 各通道最大值
+    };
+
+    /** @brief 图像数据类型，与SlideColorManagement::DataType一致 */
+    int _dataType;
+
+    /** @brief 通道数 */
+    unsigned int _channels;
+
+    /** @brief 直方图下限 */
+    double _lowerBound;
+
+    /** @brief 区间宽度 */
+    double _binWidth;
+
+    /** @brief 区间数 */
+    unsigned int _bins;
+
+    /** @brief 各层级统计，层级数在构造后不变 */
+    std::vector<Level> _levels;
+
+    /** @brief 范围层级，-1表示没有 */
+    int _rangeLevel;
+
+    /** @brief 保护层级统计和范围层级的互斥锁 */
+    mutable QMutex _mutex;
+};
+
+/**
+ * @class  SlideStatisticsBuilder
+ * @brief  后台统计任务
+ * @details 从最低分辨率的原生层级开始，依次读取尚未统计的单元，
+ *          直到下一层级的像素数超出预算；有多个层级时从不读取第0层，虚拟层级也跳过（它们由更精细的层级合成）。
+ *          范围层级变化时发出rangeChanged，全部单元完成后保存附属文件并发出finished。
+ *
+ * @note    通常只投放一个TileTaskJob，不与视野瓦片争抢工作线程
+ * @see     SlideStatistics, IOThread::addTileTask
+ */
+class SlideStatisticsBuilder : public QObject, public TileTask
+{
+    Q_OBJECT
+
+public:
+    /** @brief 默认的像素预算，按需后台统计的层级像素总数 */
+    static const unsigned long long kDefaultPixelBudget = 64ULL * 1024 * 1024;
+
+    /**
+     * @brief   构造函数
+     * @param   img 图像
+     * @param   statistics 图像的统计
+     * @param   savePath 完成后写入的附属文件路径，空表示不写入
+     * @param   pixelBudget 按需统计的层级像素总数上限
+     */
+    SlideStatisticsBuilder(std::weak_ptr<MultiResolutionImage> img, std::shared_ptr<SlideStatistics> statistics, const QString& savePath,
+        unsigned long long pixelBudget = kDefaultPixelBudget);
+
+    /**
+     * @brief   领取并处理下一个单元
+     * @return  没有剩余单元时返回false
+     */
+    bool processNextTile() override;
+
+    /** @brief 取消任务 */
+    void cancel() override;
+
+    /** @brief 获取单元总数 */
+    unsigned int getNumberOfTiles() const override { return static_cast<unsigned int>(_cells.size()); }
+
+signals:
+    /** @brief 范围层级变化，应重新渲染依赖通道范围的瓦片 */
+    void rangeChanged();
+
+    /** @brief 所有单元处理完成 */
+    void finished();
+
+private:
+    /**
+     * @brief 待统计的单元
+     */
+    struct Cell {
+        unsigned int level;
+        unsigned int index;
+    };
+
+    /**
+     * @brief   读取并统计一个单元
+     * @param   cell 单元
+     */
+    template<typename T>
+    void processCell(const Cell& cell);
+
+    /** @brief 完成一个单元 */
+    void cellDone();
+
+    /** @brief 图像 */
+    std::weak_ptr<MultiResolutionImage> _img;
+
+    /** @brief 统计 */
+    std::shared_ptr<SlideStatistics> _statistics;
+
+    /** @brief 附属文件路径 */
+    QString _savePath;
+
+    /** @brief 按处理顺序排列的单元，低分辨率层级在前 */
+    std::vector<Cell> _cells;
+
+    /** @brief 下一个领取的单元 */
+    std::atomic<unsigned int> _nextCell;
+
+    /** @brief 已完成的单元数 */
+    std::atomic<unsigned int> _cellsDone;
+
+    /** @brief 是否已取消 */
+    std::atomic<bool> _cancelled;
+};
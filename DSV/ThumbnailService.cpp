@@ -0,0 +1,274 @@
+﻿/**
+ * @file ThumbnailService.cpp
+ * @brief 缩略图服务实现文件
+ * @details 实现切片缩略图的后台生成、磁盘缓存和内存缓存
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "ThumbnailService.h"
+#include "MultiResolutionImage.h"
+#include "MultiResolutionImageFactory.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief 缩略图生成任务
+ * @details 开始执行时先领取请求，请求已被丢弃时直接返回
+ */
+class ThumbnailService::Task : public QRunnable
+{
+public:
+    Task(ThumbnailService* service, const QString& filePath, int size) :
+        _service(service), _filePath(filePath), _size(size)
+    {
+    }
+
+    void run() override
+    {
+        if (!_service->claim(_filePath)) {
+            return;
+        }
+        QImage image;
+        const QString cachePath = ThumbnailService::cacheFilePath(_filePath, _size);
+        if (!cachePath.isEmpty() && QFileInfo::exists(cachePath)) {
+            image.load(cachePath, "JPG");
+        }
+        if (image.isNull()) {
+            image = ThumbnailService::generateThumbnail(_filePath, _size);
+            if (!image.isNull() && !cachePath.isEmpty()) {
+                // 先写临时文件再替换，其他进程不会读到不完整的缓存文件
+                QSaveFile file(cachePath);
+                if (file.open(QIODevice::WriteOnly) && image.save(&file, "JPG", 85)) {
+                    file.commit();
+                }
+            }
+        }
+        QMetaObject::invokeMethod(_service, "onThumbnailGenerated", Qt::QueuedConnection,
+            Q_ARG(QString, _filePath), Q_ARG(QImage, image), Q_ARG(int, _size));
+    }
+
+private:
+    ThumbnailService* _service;
+    QString _filePath;
+    int _size;
+};
+
+/**
+ * @brief 构造函数
+ * @param parent 父对象指针
+ * @details 创建缓存目录并设置线程池大小
+ */
+ThumbnailService::ThumbnailService(QObject* parent) :
+    QObject(parent),
+    _pixmaps(kMaxCachedPixmaps),
+    _size(96),
+    _sequence(0)
+{
+    _pool.setMaxThreadCount(std::max(1, std::min(kMaxThreads, QThread::idealThreadCount() / 2)));
+    QDir().mkpath(cacheDirectory());
+}
+
+/**
+ * @brief 析构函数
+ * @details 丢弃排队的请求并等待正在执行的任务完成，之后不会再有任务访问该对象
+ */
+ThumbnailService::~ThumbnailService()
+{
+    {
+        QMutexLocker locker(&_mutex);
+        _queued.clear();
+    }
+    _pool.clear();
+    _pool.waitForDone();
+}
+
+/**
+ * @brief 获取缩略图
+ * @param filePath 切片文件路径
+ * @param pixmap 输出缩略图
+ * @param request 未命中时是否提交请求
+ * @return 结果已知时返回true，否则提交请求并返回false
+ * @details 排队请求达到上限时清空队列：这些请求对应的行多半已滚出视野，
+ *          再次绘制时会重新提交
+ */
+bool ThumbnailService::thumbnail(const QString& filePath, QPixmap& pixmap, bool request)
+{
+    if (QPixmap* cached = _pixmaps.object(filePath)) {
+        pixmap = *cached;
+        return true;
+    }
+    if (!request || _inFlight.contains(filePath)) {
+        return false;
+    }
+    {
+        QMutexLocker locker(&_mutex);
+        if (_queued.size() >= kMaxQueued) {
+            for (const QString& queued : _queued) {
+                _inFlight.remove(queued);
+            }
+            _queued.clear();
+        }
+        _queued.insert(filePath);
+    }
+    _inFlight.insert(filePath);
+    _pool.start(new Task(this, filePath, _size), _sequence++);
+    return false;
+}
+
+/**
+ * @brief 设置缩略图的最大边长
+ * @param size 像素数
+ */
+void ThumbnailService::setThumbnailSize(int size)
+{
+    if (size <= 0 || size == _size) {
+        return;
+    }
+    _size = size;
+    _pixmaps.clear();
+}
+
+/**
+ * @brief 获取缩略图的最大边长
+ * @return 像素数
+ */
+int ThumbnailService::getThumbnailSize() const
+{
+    return _size;
+}
+
+/**
+ * @brief 获取磁盘缓存目录
+ * @return 缓存目录
+ */
+QString ThumbnailService::cacheDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/thumbnails";
+}
+
+/**
+ * @brief 获取磁盘缓存文件路径
+ * @param filePath 切片文件路径
+ * @param size 最大边长
+ * @return 缓存文件路径
+ * @details 文件名为（绝对路径、大小、修改时间、边长）的SHA1，切片被修改后自动重新生成
+ */
+QString ThumbnailService::cacheFilePath(const QString& filePath, int size)
+{
+    QFileInfo info(filePath);
+    if (!info.exists()) {
+        return QString();
+    }
+    QString identity = info.absoluteFilePath() + "|" + QString::number(info.size()) + "|" +
+        QString::number(info.lastModified().toMSecsSinceEpoch()) + "|" + QString::number(size);
+    return cacheDirectory() + "/" + QString::fromLatin1(QCryptographicHash::hash(identity.toUtf8(), QCryptographicHash::Sha1).toHex()) + ".jpg";
+}
+
+/**
+ * @brief 领取请求
+ * @param filePath 切片文件路径
+ * @return 请求仍在排队时返回true
+ */
+bool ThumbnailService::claim(const QString& filePath)
+{
+    QMutexLocker locker(&_mutex);
+    return _queued.remove(filePath);
+}
+
+/**
+ * @brief 后台生成完成槽函数
+ * @param filePath 切片文件路径
+ * @param image 缩略图
+ * @param size 生成时的最大边长
+ * @details 生成期间边长已改变时丢弃结果，下次绘制会按新边长重新请求
+ */
+void ThumbnailService::onThumbnailGenerated(const QString& filePath, const QImage& image, int size)
+{
+    _inFlight.remove(filePath);
+    if (size != _size) {
+        return;
+    }
+    _pixmaps.insert(filePath, new QPixmap(QPixmap::fromImage(image)));
+    emit thumbnailReady(filePath);
+}
+
+/**
+ * @brief 生成缩略图
+ * @param filePath 切片文件路径
+ * @param size 最大边长
+ * @return 缩略图
+ * @details 关联缩略图和宏观图由扫描仪预先生成，读取代价很小；
+ *          都不存在时读取最低分辨率层级
+ */
+QImage ThumbnailService::generateThumbnail(const QString& filePath, int size)
+{
+    std::unique_ptr<MultiResolutionImage> img(MultiResolutionImageFactory::openImage(filePath.toStdString()));
+    if (!img || !img->valid()) {
+        return QImage();
+    }
+    QImage image = img->getAssociatedImage("thumbnail");
+    if (image.isNull()) {
+        image = img->getAssociatedImage("macro");
+    }
+    if (image.isNull()) {
+        image = readLowestLevel(img.get());
+    }
+    if (image.isNull()) {
+        return image;
+    }
+    if (image.width() > size || image.height() > size) {
+        image = image.scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    return image.convertToFormat(QImage::Format_RGB888);
+}
+
+/**
+ * @brief 读取最低分辨率层级
+ * @param img 图像对象
+ * @return RGB或灰度图像
+ */
+QImage ThumbnailService::readLowestLevel(MultiResolutionImage* img)
+{
+    if (img->getDataType() != SlideColorManagement::DataType::UChar || img->getNumberOfLevels() <= 0) {
+        return QImage();
+    }
+    const SlideColorManagement::ColorType colorType = img->getColorType();
+    QImage::Format format;
+    if (colorType == SlideColorManagement::ColorType::RGB) {
+        format = QImage::Format_RGB888;
+    }
+    else if (colorType == SlideColorManagement::ColorType::RGBA) {
+        format = QImage::Format_RGBA8888;
+    }
+    else if (colorType == SlideColorManagement::ColorType::Monochrome) {
+        format = QImage::Format_Grayscale8;
+    }
+    else {
+        return QImage();
+    }
+    const unsigned int samplesPerPixel = img->getSamplesPerPixel();
+    if (samplesPerPixel != (format == QImage::Format_Grayscale8 ? 1u : format == QImage::Format_RGB888 ? 3u : 4u)) {
+        return QImage();
+    }
+    const unsigned int level = img->getNumberOfLevels() - 1;
+    const std::vector<unsigned long long> dims = img->getLevelDimensions(level);
+    if (dims.size() < 2 || dims[0] == 0 || dims[1] == 0 || dims[0] * dims[1] > kMaxLevelPixels) {
+        return QImage();
+    }
+    std::vector<unsigned char> pixels(dims[0] * dims[1] * samplesPerPixel);
+    unsigned char* data = pixels.data();
+    img->getRawRegion<unsigned char>(0, 0, dims[0], dims[1], level, data);
+    return QImage(data, dims[0], dims[1], dims[0] * samplesPerPixel, format).copy();
+}
@@ -0,0 +1,182 @@
+﻿/**
+ * @file    ThumbnailService.h
+ * @brief   缩略图服务类，在后台生成切片缩略图并缓存到磁盘
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了文件浏览时的切片预览功能，包括：
+ *          - 有界线程池中打开切片并提取关联缩略图或宏观图，没有时读取最低分辨率层级
+ *          - 缩略图以JPEG保存在磁盘缓存中，按文件身份（绝对路径、大小、修改时间）区分
+ *          - GUI线程中的QPixmap内存缓存
+ *          - 最新的请求优先处理，排队过多时丢弃已滚出视野的旧请求
+ *
+ * @note    该类的公有接口只能在GUI线程中调用
+ * @see     FileWidget, MultiResolutionImage::getAssociatedImage, DiskTileCache
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QPixmap>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+
+class MultiResolutionImage;
+
+/**
+ * @class  ThumbnailService
+ * @brief  切片缩略图服务
+ * @details thumbnail()命中内存缓存时立即返回，否则把请求放入线程池并返回false；
+ *          工作线程先查磁盘缓存，未命中时打开切片生成缩略图并写入磁盘缓存，
+ *          完成后通过thumbnailReady通知视图重绘。
+ *
+ *          视图只在绘制行时请求缩略图，因此只有滚动到视野中的行才会生成；
+ *          请求按提交顺序倒序执行，排队请求超过kMaxQueued时清空队列，
+ *          快速滚动经过的行不会阻塞当前可见的行。
+ *
+ * @example
+ *          // 使用示例
+ *          ThumbnailService* service = new ThumbnailService(this);
+ *          connect(service, &ThumbnailService::thumbnailReady, view->viewport(), [=]() { view->viewport()->update(); });
+ *
+ *          QPixmap pixmap;
+ *          if (service->thumbnail(filePath, pixmap) && !pixmap.isNull()) {
+ *              painter->drawPixmap(rect, pixmap);
+ *          }
+ * @see     FileWidget
+ */
+class ThumbnailService : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief   构造函数
+     * @param   parent 父对象指针
+     * @details 线程池大小为CPU核心数的一半，限制在[1, kMaxThreads]
+     */
+    explicit ThumbnailService(QObject* parent = 0);
+
+    /**
+     * @brief   析构函数
+     * @details 丢弃排队的请求并等待正在生成的缩略图完成
+     */
+    ~ThumbnailService();
+
+    /**
+     * @brief   获取缩略图
+     * @param   filePath 切片文件路径
+     * @param   pixmap 输出缩略图，切片无法生成缩略图时为空
+     * @param   request 未命中时是否提交后台请求，为false时只查询内存缓存
+     * @return  结果已知时返回true；否则（按需提交后台请求）返回false，完成后发出thumbnailReady
+     */
+    bool thumbnail(const QString& filePath, QPixmap& pixmap, bool request = true);
+
+    /**
+     * @brief   设置缩略图的最大边长
+     * @param   size 像素数
+     * @note    清空内存缓存，磁盘缓存按边长区分
+     */
+    void setThumbnailSize(int size);
+
+    /**
+     * @brief   获取缩略图的最大边长
+     * @return  像素数
+     */
+    int getThumbnailSize() const;
+
+    /**
+     * @brief   获取磁盘缓存目录
+     * @return  QStandardPaths::CacheLocation下的thumbnails目录
+     */
+    static QString cacheDirectory();
+
+    /**
+     * @brief   生成缩略图
+     * @param   filePath 切片文件路径
+     * @param   size 最大边长
+     * @return  缩略图，切片无法打开或没有可用的图像时返回空图像
+     * @details 依次尝试关联图像"thumbnail"、"macro"和最低分辨率层级，不读取磁盘缓存
+     * @note    可在任意线程中调用
+     */
+    static QImage generateThumbnail(const QString& filePath, int size);
+
+signals:
+    /**
+     * @brief   缩略图就绪信号
+     * @param   filePath 切片文件路径
+     */
+    void thumbnailReady(const QString& filePath);
+
+private slots:
+    /**
+     * @brief   后台生成完成槽函数
+     * @param   filePath 切片文件路径
+     * @param   image 缩略图，生成失败时为空
+     * @param   size 生成时的最大边长
+     */
+    void onThumbnailGenerated(const QString& filePath, const QImage& image, int size);
+
+private:
+    class Task;
+
+    /**
+     * @brief   读取最低分辨率层级
+     * @param   img 图像对象
+     * @return  RGB图像，层级过大或不是8位图像时返回空图像
+     */
+    static QImage readLowestLevel(MultiResolutionImage* img);
+
+    /**
+     * @brief   获取磁盘缓存文件路径
+     * @param   filePath 切片文件路径
+     * @param   size 最大边长
+     * @return  缓存文件路径，切片文件不存在时返回空字符串
+     */
+    static QString cacheFilePath(const QString& filePath, int size);
+
+    /**
+     * @brief   领取请求
+     * @param   filePath 切片文件路径
+     * @return  请求仍在排队时返回true，已被丢弃时返回false
+     * @note    由工作线程调用
+     */
+    bool claim(const QString& filePath);
+
+    /** @brief 缩略图线程池 */
+    QThreadPool _pool;
+
+    /** @brief 缩略图内存缓存，失败的文件保存为空缩略图 */
+    QCache<QString, QPixmap> _pixmaps;
+
+    /** @brief 已提交但尚未完成的请求（GUI线程） */
+    QSet<QString> _inFlight;
+
+    /** @brief 已提交但尚未开始的请求，由_mutex保护 */
+    QSet<QString> _queued;
+
+    /** @brief 保护_queued的互斥锁 */
+    QMutex _mutex;
+
+    /** @brief 缩略图的最大边长 */
+    int _size;
+
+    /** @brief 请求序号，作为线程池优先级使后提交的请求先执行 */
+    int _sequence;
+
+    /** @brief 线程池最大线程数 */
+    static const int kMaxThreads = 4;
+
+    /** @brief 排队请求数上限 */
+    static const int kMaxQueued = 64;
+
+    /** @brief 内存缓存的缩略图数 */
+    static const int kMaxCachedPixmaps = 512;
+
+    /** @brief 读取最低分辨率层级时的最大像素数 */
+    static const unsigned long long kMaxLevelPixels = 4096ULL * 4096ULL;
+};
@@ -0,0 +1,264 @@
+﻿/**
+ * @file TileBufferPool.cpp
+ * @brief 瓦片缓冲区池实现文件
+ * @details 该文件实现了按大小分级的每线程缓冲区复用
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "TileBufferPool.h"
+#include "PipelineProfiler.h"
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace {
+
+    /**
+     * @brief 缓冲区头部
+     * @details 放在返回给调用者的地址之前，大小为16字节以保持对齐
+     */
+    struct alignas(16) BufferHeader {
+        unsigned int sizeClass;   ///< 大小等级，kLargeClass表示直接分配
+        size_t bytes;             ///< 实际占用的字节数，含头部
+    };
+
+    /** @brief 直接向系统分配的缓冲区的等级标记 */
+    const unsigned int kLargeClass = 0xFFFFFFFF;
+
+    /** @brief 已分配未归还的字节数 */
+    std::atomic<unsigned long long> g_outstandingBytes(0);
+
+    /** @brief 所有线程空闲链表中的字节数 */
+    std::atomic<unsigned long long> g_cachedBytes(0);
+
+    /** @brief 释放请求的代数，线程发现代数变化时释放空闲链表 */
+    std::atomic<unsigned int> g_trimEpoch(0);
+
+    /**
+     * @brief 共享的溢出空闲链表
+     * @details 保存在不从该等级分配的线程上归还的缓冲区，以及线程本地链表已满时归还的缓冲区，
+     *          线程本地链表为空时从这里取用
+     */
+    struct SharedCache {
+        std::mutex mutex;
+        std::vector<BufferHeader*> freeLists[TileBufferPool::kMaxClass + 1];
+        size_t freeBytes = 0;
+
+        void trim() {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& list : freeLists) {
+                for (BufferHeader* header : list) {
+                    ::operator delete(header);
+                }
+                list.clear();
+            }
+            g_cachedBytes -= freeBytes;
+            freeBytes = 0;
+        }
+
+        /**
+         * @brief 取出一个空闲缓冲区
+         * @return 缓冲区，没有时返回NULL
+         */
+        BufferHeader* take(unsigned int sizeClass) {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<BufferHeader*>& list = freeLists[sizeClass];
+            if (list.empty()) {
+                return NULL;
+            }
+            BufferHeader* header = list.back();
+            list.pop_back();
+            const size_t classBytes = static_cast<size_t>(1) << sizeClass;
+            freeBytes -= classBytes;
+            g_cachedBytes -= classBytes;
+            return header;
+        }
+
+        /**
+         * @brief 放入一个空闲缓冲区
+         * @return 链表已满或超过字节数上限时返回false，调用者直接释放
+         */
+        bool put(BufferHeader* header, unsigned int sizeClass) {
+            const size_t classBytes = static_cast<size_t>(1) << sizeClass;
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<BufferHeader*>& list = freeLists[sizeClass];
+            if (list.size() >= TileBufferPool::kMaxBuffersPerClass || freeBytes + classBytes > TileBufferPool::kMaxSharedBytes) {
+                return false;
+            }
+            list.push_back(header);
+            freeBytes += classBytes;
+            g_cachedBytes += classBytes;
+            return true;
+        }
+    };
+
+    SharedCache& sharedCache() {
+        // 不析构：其他静态对象和线程在进程退出时仍可能归还缓冲区
+        static SharedCache* cache = new SharedCache();
+        return *cache;
+    }
+
+    /**
+     * @brief 线程本地的空闲链表
+     * @details allocated记录该线程是否从各等级分配过，只有分配过的等级才保留在本地
+     */
+    struct ThreadCache {
+        std::vector<BufferHeader*> freeLists[TileBufferPool::kMaxClass + 1];
+        bool allocated[TileBufferPool::kMaxClass + 1] = {};
+        size_t freeBytes = 0;
+        unsigned int trimEpoch = g_trimEpoch.load();
+
+        ~ThreadCache() {
+            trim();
+        }
+
+        void trim() {
+            for (auto& list : freeLists) {
+                for (BufferHeader* header : list) {
+                    ::operator delete(header);
+                }
+                list.clear();
+            }
+            g_cachedBytes -= freeBytes;
+            freeBytes = 0;
+        }
+    };
+
+    ThreadCache& threadCache() {
+        thread_local ThreadCache cache;
+        const unsigned int epoch = g_trimEpoch.load(std::memory_order_relaxed);
+        if (cache.trimEpoch != epoch) {
+            cache.trimEpoch = epoch;
+            cache.trim();
+        }
+        return cache;
+    }
+
+    /**
+     * @brief 计算大小等级
+     * @param bytes 包含头部的字节数
+     * @return 不小于bytes的2的幂的指数，超过kMaxClass时返回kLargeClass
+     */
+    unsigned int sizeClassFor(size_t bytes) {
+        unsigned int sizeClass = TileBufferPool::kMinClass;
+        while ((static_cast<size_t>(1) << sizeClass) < bytes) {
+            if (++sizeClass > TileBufferPool::kMaxClass) {
+                return kLargeClass;
+            }
+        }
+        return sizeClass;
+    }
+}
+
+/**
+ * @brief 分配缓冲区
+ * @param bytes 字节数
+ * @return 缓冲区
+ * @details 先从当前线程对应等级的空闲链表取用，其次从共享的溢出链表取用，都没有时向系统分配整个等级大小
+ */
+void* TileBufferPool::allocate(size_t bytes)
+{
+    const size_t total = bytes + sizeof(BufferHeader);
+    const unsigned int sizeClass = sizeClassFor(total);
+    BufferHeader* header = NULL;
+    size_t bytesUsed = total;
+    if (sizeClass == kLargeClass) {
+        header = static_cast<BufferHeader*>(::operator new(total));
+    }
+    else {
+        bytesUsed = static_cast<size_t>(1) << sizeClass;
+        ThreadCache& cache = threadCache();
+        cache.allocated[sizeClass] = true;
+        std::vector<BufferHeader*>& list = cache.freeLists[sizeClass];
+        if (!list.empty()) {
+            header = list.back();
+            list.pop_back();
+            cache.freeBytes -= bytesUsed;
+            g_cachedBytes -= bytesUsed;
+            PipelineProfiler::count(PipelineProfiler::BufferPoolHit);
+        }
+        else if ((header = sharedCache().take(sizeClass)) != NULL) {
+            PipelineProfiler::count(PipelineProfiler::BufferPoolHit);
+        }
+        else {
+            header = static_cast<BufferHeader*>(::operator new(bytesUsed));
+            PipelineProfiler::count(PipelineProfiler::BufferPoolMiss);
+        }
+    }
+    header->sizeClass = sizeClass;
+    header->bytes = bytesUsed;
+    g_outstandingBytes += bytesUsed;
+    return header + 1;
+}
+
+/**
+ * @brief 归还缓冲区
+ * @param buffer 缓冲区
+ * @details 当前线程从该等级分配过时放入线程本地链表；否则（如GUI线程释放Patch、缓存淘汰线程释放解码瓦片）
+ *          或本地链表已满时放入共享的溢出链表，供工作线程取用；溢出链表也已满时直接释放
+ */
+void TileBufferPool::release(void* buffer)
+{
+    if (!buffer) {
+        return;
+    }
+    BufferHeader* header = static_cast<BufferHeader*>(buffer) - 1;
+    const unsigned int sizeClass = header->sizeClass;
+    g_outstandingBytes -= header->bytes;
+    if (sizeClass == kLargeClass) {
+        ::operator delete(header);
+        return;
+    }
+    ThreadCache& cache = threadCache();
+    const size_t classBytes = static_cast<size_t>(1) << sizeClass;
+    std::vector<BufferHeader*>& list = cache.freeLists[sizeClass];
+    if (!cache.allocated[sizeClass] || list.size() >= kMaxBuffersPerClass || cache.freeBytes + classBytes > kMaxThreadBytes) {
+        if (!sharedCache().put(header, sizeClass)) {
+            ::operator delete(header);
+        }
+        return;
+    }
+    list.push_back(header);
+    cache.freeBytes += classBytes;
+    g_cachedBytes += classBytes;
+}
+
+/**
+ * @brief 释放当前线程保留的所有空闲缓冲区
+ */
+void TileBufferPool::trimThreadCache()
+{
+    threadCache().trim();
+}
+
+/**
+ * @brief 请求所有线程释放空闲缓冲区
+ * @details 增加释放代数，当前线程和共享的溢出链表立即释放，其他线程在下一次访问池时释放
+ */
+void TileBufferPool::requestTrim()
+{
+    ++g_trimEpoch;
+    threadCache();
+    sharedCache().trim();
+}
+
+/**
+ * @brief 获取已分配且尚未归还的字节数
+ * @return 字节数
+ */
+unsigned long long TileBufferPool::outstandingBytes()
+{
+    return g_outstandingBytes.load();
+}
+
+/**
+ * @brief 获取所有线程空闲链表和共享溢出链表中保留的字节数
+ * @return 字节数
+ */
+unsigned long long TileBufferPool::cachedBytes()
+{
+    return g_cachedBytes.load();
+}
@@ -0,0 +1,173 @@
+﻿/**
+ * @file    TileBufferPool.h
+ * @brief   瓦片缓冲区池，按大小分级复用瓦片管线中的临时缓冲区
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了瓦片读取和渲染过程中临时缓冲区的复用，包括：
+ *          - 按2的幂分级的每线程空闲链表，分配和归还不需要加锁
+ *          - 缓冲区头部记录大小等级，归还时不需要调用者提供大小
+ *          - TileBuffer<T>句柄，析构时自动归还
+ *
+ * @note    解码结果（readDataFromImage的返回值）、getRawRegion的临时数据、
+ *          IOWorker的瓦片缓冲区和Patch<T>的数据都来自该池，
+ *          必须用TileBufferPool::release释放，不能使用delete[]
+ * @see     MultiResolutionImage, Patch, IOWorker
+ */
+
+#pragma once
+
+#include <cstddef>
+
+/**
+ * @class  TileBufferPool
+ * @brief  瓦片缓冲区池
+ * @details 所有接口均为静态函数。大小等级从4KB到64MB，每个线程每个等级最多保留
+ *          kMaxBuffersPerClass个空闲缓冲区，单线程保留的空闲字节数不超过kMaxThreadBytes；
+ *          超过64MB的请求直接向系统分配。缓冲区可以在其他线程归还：归还线程从该等级分配过时
+ *          放入该线程的空闲链表，否则放入共享的溢出链表（最多kMaxSharedBytes），
+ *          线程本地链表为空时从溢出链表取用，只释放不分配的线程不会囤积空闲缓冲区。
+ *
+ *          同一会话中瓦片大小基本固定，稳定后每个瓦片的读取不再向系统分配内存，
+ *          避免长时间浏览时的堆碎片和工作集增长。
+ *
+ * @example
+ *          // 使用示例
+ *          TileBuffer<unsigned char> buffer(512 * 512 * 3);
+ *          unsigned char* data = buffer.get();
+ *          img->getRawRegion<unsigned char>(0, 0, 512, 512, 0, data);
+ *          // buffer析构时归还
+ */
+class TileBufferPool
+{
+public:
+    /**
+     * @brief   分配缓冲区
+     * @param   bytes 字节数
+     * @return  至少bytes字节、16字节对齐的缓冲区，bytes为0时也返回有效指针
+     */
+    static void* allocate(size_t bytes);
+
+    /**
+     * @brief   归还缓冲区
+     * @param   buffer 由allocate分配的缓冲区，可为NULL
+     */
+    static void release(void* buffer);
+
+    /**
+     * @brief   分配指定类型的数组
+     * @tparam  T 元素类型，只用于平凡类型（图像样本）
+     * @param   count 元素个数
+     * @return  未初始化的数组
+     */
+    template <typename T>
+    static T* allocateArray(size_t count) {
+        return static_cast<T*>(allocate(count * sizeof(T)));
+    }
+
+    /**
+     * @brief   释放当前线程保留的所有空闲缓冲区
+     * @details 线程退出时自动调用
+     */
+    static void trimThreadCache();
+
+    /**
+     * @brief   请求所有线程释放空闲缓冲区
+     * @details 共享的溢出链表立即释放，各线程在下一次分配或归还时释放自己的空闲链表，用于内存紧张时
+     * @see     MemoryGovernor
+     */
+    static void requestTrim();
+
+    /**
+     * @brief   获取已分配且尚未归还的字节数
+     * @return  按大小等级计算的字节数，包括Patch数据和正在使用的临时缓冲区
+     */
+    static unsigned long long outstandingBytes();
+
+    /**
+     * @brief   获取所有线程空闲链表和共享溢出链表中保留的字节数
+     */
+    static unsigned long long cachedBytes();
+
+    /** @brief 最小的大小等级（2^12 = 4KB） */
+    static const unsigned int kMinClass = 12;
+
+    /** @brief 最大的大小等级（2^26 = 64MB） */
+    static const unsigned int kMaxClass = 26;
+
+    /** @brief 每个线程每个等级最多保留的空闲缓冲区数 */
+    static const unsigned int kMaxBuffersPerClass = 16;
+
+    /** @brief 每个线程最多保留的空闲字节数 */
+    static const size_t kMaxThreadBytes = 256ull * 1024 * 1024;
+
+    /** @brief 共享的溢出链表最多保留的空闲字节数 */
+    static const size_t kMaxSharedBytes = 256ull * 1024 * 1024;
+};
+
+/**
+ * @class  TileBuffer
+ * @brief  池缓冲区句柄
+ * @details 只能移动不能复制，析构时把缓冲区归还到TileBufferPool
+ * @tparam  T 元素类型
+ */
+template <typename T>
+class TileBuffer
+{
+public:
+    /**
+     * @brief   分配count个元素的缓冲区
+     */
+    explicit TileBuffer(size_t count = 0) :
+        _data(count ? TileBufferPool::allocateArray<T>(count) : NULL),
+        _count(count)
+    {
+    }
+
+    ~TileBuffer() {
+        TileBufferPool::release(_data);
+    }
+
+    TileBuffer(TileBuffer&& rhs) :
+        _data(rhs._data),
+        _count(rhs._count)
+    {
+        rhs._data = NULL;
+        rhs._count = 0;
+    }
+
+    TileBuffer& operator=(TileBuffer&& rhs) {
+        if (this != &rhs) {
+            TileBufferPool::release(_data);
+            _data = rhs._data;
+            _count = rhs._count;
+            rhs._data = NULL;
+            rhs._count = 0;
+        }
+        return *this;
+    }
+
+    TileBuffer(const TileBuffer&) = delete;
+    TileBuffer& operator=(const TileBuffer&) = delete;
+
+    /** @brief 缓冲区指针 */
+    T* get() const { return _data; }
+
+    /** @brief 元素个数 */
+    size_t size() const { return _count; }
+
+    /**
+     * @brief   放弃所有权
+     * @return  缓冲区指针，调用者负责用TileBufferPool::release归还
+     */
+    T* take() {
+        T* data = _data;
+        _data = NULL;
+        _count = 0;
+        return data;
+    }
+
+private:
+    T* _data;
+    size_t _count;
+};
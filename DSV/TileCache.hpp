@@ -9,7 +9,8 @@
  *          - 模板化设计，支持任意数据类型
  *          - 自动内存管理和垃圾回收
  *          - 缓存大小限制和动态调整
- *          - 高效的缓存查找和更新机制
+ *          - 以64位整数（层级、X、Y）为键的开放寻址哈希表
+ *          - 分片加锁，不同分片上的查找和插入互不阻塞
  *          该缓存系统专门为数字病理图像的大规模瓦片数据设计，
  *          提供高效的内存管理和数据访问性能。
  *
@@ -18,9 +19,8 @@
  */
 
 #pragma once
-#include <list>
-#include <map>
-#include <string>
+#include <atomic>
+#include <mutex>
 #include <vector>
 
  /**
@@ -32,37 +32,44 @@
   *
   *          主要特性：
   *          - 模板化设计，支持任意数据类型的瓦片
-  *          - LRU算法确保最常用的数据保留在缓存中
-  *          - 自动内存管理，防止内存泄漏
-  *          - 可配置的缓存大小限制
-  *          - 高效的O(1)查找和更新操作
+  *          - 键由makeKey把层级、X、Y打包为64位整数，查找和插入不分配内存
+  *          - 按键的哈希值分为kShardCount个分片，每个分片有独立的互斥锁、
+  *            线性探测哈希表和侵入式LRU链表
+  *          - 字节预算为全局预算：空间不足时先淘汰本分片最旧的数据，
+  *            本分片没有可淘汰数据时再依次淘汰其他分片
+  *          - 固定项（pinned）不进入LRU链表，永远不会被淘汰
   *
   * @tparam T 瓦片数据类型模板参数
-  * @note   该类是线程不安全的，多线程使用时需要外部同步
+  * @note   该类是线程安全的；LRU顺序在分片内精确，在分片间近似
   * @example
   *          // 使用示例
   *          TileCache<unsigned char> cache(1024 * 1024); // 1MB缓存
   *          unsigned char* data = new unsigned char[1024];
-  *          cache.set("tile_1", data, 1024);
+  *          TileCache<unsigned char>::keyType key = TileCache<unsigned char>::makeKey(x, y, level);
+  *          cache.set(key, data, 1024);
   *
   *          unsigned char* retrieved_data;
   *          unsigned int size;
-  *          cache.get("tile_1", retrieved_data, size);
+  *          cache.get(key, retrieved_data, size);
   * @see     MultiResolutionImage, WSITileGraphicsItem
   */
 template <typename T>
 class TileCache {
 public:
+    /** @brief 缓存键类型定义：高8位为层级，其后28位为X，低28位为Y；Z平面非0时X、Y各取高4位存放Z平面 */
+    typedef unsigned long long keyType;
+
+    /** @brief 分片数量，必须为2的幂 */
+    static const unsigned int kShardCount = 16;
+
     /**
      * @brief   默认构造函数
      * @details 创建瓦片缓存对象，设置默认的缓存大小限制
      * @note    默认缓存大小为0，需要调用setMaxCacheSize设置有效大小
      */
     TileCache() :
-        _cacheMaxByteSize(0),
         _cacheCurrentByteSize(0),
-        _LRU(),
-        _cache()
+        _cacheMaxByteSize(0)
     {
     }
 
@@ -73,43 +80,59 @@ public:
      * @param   cacheMaxByteSize 最大缓存字节大小
      * @note    当缓存数据超过此大小时，会自动淘汰最久未使用的数据
      */
-    TileCache(unsigned int cacheMaxByteSize) :
-        _cacheMaxByteSize(cacheMaxByteSize),
+    TileCache(unsigned long long cacheMaxByteSize) :
         _cacheCurrentByteSize(0),
-        _LRU(),
-        _cache()
+        _cacheMaxByteSize(cacheMaxByteSize)
     {
     }
 
     /**
      * @brief   虚析构函数
      * @details 清理缓存中存储的所有动态分配的内存。
-     *          遍历_cache映射，使用delete[]释放每个瓦片数据的内存。
-     * @note    该析构函数确保不会发生内存泄漏
+     *          遍历所有分片，使用delete[]释放每个瓦片数据的内存。
+     * @note    派生类如需自定义释放方式，应在自身析构函数中调用clear()
      */
     virtual ~TileCache()
     {
-        for (key_iterator it = _cache.begin(); it != _cache.end(); ++it) {
-            delete[] it->second.first.first;
+        for (unsigned int s = 0; s < kShardCount; ++s) {
+            for (const Entry& entry : _shards[s].entries) {
+                if (entry.value) {
+                    delete[] entry.value;
+                }
+            }
         }
     }
 
-    /** @brief 缓存键类型定义，使用字符串作为瓦片的唯一标识 */
-    typedef std::string keyType;
-
-    /** @brief LRU列表类型定义，用于存储键的列表以实现LRU顺序 */
-    typedef std::list<keyType> keyTypeList;
+    /**
+     * @brief   由瓦片坐标生成缓存键
+     * @details 将层级、X、Y打包为一个64位整数，代替原先的"x_y_level"字符串。
+     *          Z平面的高4位放在X字段、低4位放在Y字段的最高4位，Z平面为0时与只含层级、X、Y的键相同
+     *
+     * @param   x 瓦片X坐标（小于2^28，Z平面非0时小于2^24）
+     * @param   y 瓦片Y坐标（小于2^28，Z平面非0时小于2^24）
+     * @param   level 层级（小于256）
+     * @param   zPlane Z平面索引（小于256）
+     * @return  缓存键
+     */
+    static keyType makeKey(unsigned int x, unsigned int y, unsigned int level, unsigned int zPlane = 0) {
+        return (static_cast<keyType>(level & 0xFF) << 56) |
+            (static_cast<keyType>((x & 0xFFFFFFF) | ((zPlane & 0xF0) << 20)) << 28) |
+            static_cast<keyType>((y & 0xFFFFFFF) | ((zPlane & 0x0F) << 24));
+    }
 
     /**
-     * @brief 缓存迭代器类型定义
-     * @details 定义为std::map的迭代器类型，用于遍历_cache映射
+     * @brief   取出缓存键中的Z平面索引
+     * @param   k 由makeKey生成的键，坐标小于2^24
+     * @return  Z平面索引
      */
-    typedef typename std::map<keyType, std::pair<std::pair<T*, unsigned int>, std::list<keyType>::iterator> >::iterator key_iterator;
+    static unsigned int keyZPlane(keyType k) {
+        return static_cast<unsigned int>(((k >> 48) & 0xF0) | ((k >> 24) & 0x0F));
+    }
 
     /**
      * @brief   从缓存中获取指定键对应的瓦片数据
      * @details 根据键查找缓存中的数据，如果找到则将数据移动到LRU列表末尾
-     *          （表示最近使用），并返回数据指针和大小。
+     *          （表示最近使用），并返回数据指针和大小。只锁定键所在的分片。
      *
      * @param   k 瓦片的唯一标识键
      * @param   tile 输出参数，指向瓦片数据的指针
@@ -120,32 +143,60 @@ public:
      *          // 使用示例
      *          unsigned char* data;
      *          unsigned int size;
-     *          cache.get("tile_1", data, size);
+     *          cache.get(TileCache<unsigned char>::makeKey(x, y, level), data, size);
      *          if (data != NULL) {
      *              // 使用数据
      *          }
      */
     virtual void get(const keyType& k, T*& tile, unsigned int& size) {
-        // 在缓存中查找键k是否存在
-        key_iterator it = _cache.find(k);
+        const unsigned long long hash = hashKey(k);
+        Shard& shard = shardFor(hash);
+        std::lock_guard<std::mutex> l(shard.mutex);
 
-        if (it == _cache.end()) {
-            // 如果键不存在，将tile设置为NULL并返回
+        int slot = findSlot(shard, k, hash);
+        if (slot < 0) {
             tile = NULL;
             return;
         }
-        else {
-            // 使用_LRU.splice将对应元素移动到_LRU列表末尾，
-            // 表示该元素是最近使用的。然后返回数据指针和大小
-            _LRU.splice(
-                _LRU.end(),
-                _LRU,
-                it->second.second
-            );
-            tile = it->second.first.first;
-            size = it->second.first.second;
-            return;
+        int index = shard.buckets[slot];
+        Entry& entry = shard.entries[index];
+        if (!entry.pinned) {
+            // 移动到LRU链表末尾，表示最近使用
+            unlinkEntry(shard, index);
+            linkEntry(shard, index);
         }
+        tile = entry.value;
+        size = entry.size;
+    }
+
+    /**
+     * @brief   在分片锁内访问缓存数据
+     * @details 查找方式与get()相同并更新LRU位置；命中时在持有分片锁的情况下调用f，
+     *          保证访问期间数据不会被其他线程淘汰释放。
+     *
+     * @tparam  F 可调用对象，签名为bool(T* tile, unsigned int size)
+     * @param   k 瓦片的唯一标识键
+     * @param   f 访问函数，不应在其中访问同一缓存
+     * @return  未命中时返回false，命中时返回f的返回值
+     * @see     get
+     */
+    template <typename F>
+    bool visit(const keyType& k, F f) {
+        const unsigned long long hash = hashKey(k);
+        Shard& shard = shardFor(hash);
+        std::lock_guard<std::mutex> l(shard.mutex);
+
+        int slot = findSlot(shard, k, hash);
+        if (slot < 0) {
+            return false;
+        }
+        int index = shard.buckets[slot];
+        Entry& entry = shard.entries[index];
+        if (!entry.pinned) {
+            unlinkEntry(shard, index);
+            linkEntry(shard, index);
+        }
+        return f(entry.value, entry.size);
     }
 
     /**
@@ -156,39 +207,159 @@ public:
      * @param   k 瓦片的唯一标识键
      * @param   v 瓦片数据指针
      * @param   size 瓦片数据大小（字节）
+     * @param   pinned 是否为固定项，固定项不会被淘汰
      * @return  0表示插入成功，1表示插入失败
      * @note    插入失败的原因可能是：键已存在或数据大小超过最大缓存大小
      * @see     get, evict
      * @example
      *          // 使用示例
      *          unsigned char* data = new unsigned char[1024];
-     *          int result = cache.set("tile_1", data, 1024);
+     *          int result = cache.set(key, data, 1024);
      *          if (result == 0) {
      *              // 插入成功
      *          }
      */
-    virtual int set(const keyType& k, T* v, unsigned int size) {
-
-        if (_cache.find(k) != _cache.end()) {
-            // 首先检查k是否已经存在于缓存中，如果存在则返回1表示插入失败
+    virtual int set(const keyType& k, T* v, unsigned int size, bool pinned = false) {
+        const unsigned long long hash = hashKey(k);
+        Shard& shard = shardFor(hash);
+        if (size > _cacheMaxByteSize.load()) {
             return 1;
         }
-        if (size > _cacheMaxByteSize) {
-            // 然后检查数据的大小是否超过最大缓存字节大小，如果超过则返回1表示插入失败
+        {
+            std::lock_guard<std::mutex> l(shard.mutex);
+            if (findSlot(shard, k, hash) >= 0) {
+                return 1;
+            }
+        }
+        // 淘汰时不持有本分片锁，淘汰回调中可以安全地访问缓存
+        while (_cacheCurrentByteSize.load() + size > _cacheMaxByteSize.load() && _cacheCurrentByteSize.load() != 0) {
+            if (!evictFrom(shardIndex(hash))) {
+                break;
+            }
+        }
+
+        std::lock_guard<std::mutex> l(shard.mutex);
+        if (findSlot(shard, k, hash) >= 0) {
             return 1;
         }
-        while (_cacheCurrentByteSize + size > _cacheMaxByteSize && _cacheCurrentByteSize != 0) {
-            // 如果缓存空间不足，调用evict()淘汰最久未使用的数据，直到有足够的空间
-            evict();
+        int index;
+        if (!shard.freeEntries.empty()) {
+            index = shard.freeEntries.back();
+            shard.freeEntries.pop_back();
+        }
+        else {
+            index = static_cast<int>(shard.entries.size());
+            shard.entries.push_back(Entry());
+        }
+        Entry& entry = shard.entries[index];
+        entry.key = k;
+        entry.value = v;
+        entry.size = size;
+        entry.pinned = pinned;
+        entry.prev = -1;
+        entry.next = -1;
+        insertSlot(shard, index, hash);
+        if (!pinned) {
+            linkEntry(shard, index);
         }
-        // 将k插入到_LRU列表末尾，然后将数据指针、大小和_LRU列表中的迭代器存储到_cache映射中
-        keyTypeList::iterator it = _LRU.insert(_LRU.end(), k);
-        _cache[k] = std::make_pair(std::make_pair(v, size), it);
-        // 更新当前使用的字节大小，返回0表示插入成功
         _cacheCurrentByteSize += size;
         return 0;
     }
 
+    /**
+     * @brief   更新缓存项的大小
+     * @details 缓存项的实际内存占用改变后（如前景被替换或释放）调用，
+     *          调整当前使用的字节大小；超出最大缓存大小时淘汰最久未使用的数据，
+     *          被更新的项本身也可能被淘汰。
+     *
+     * @param   k 瓦片的唯一标识键
+     * @param   size 新的数据大小（字节）
+     * @return  键存在时返回true
+     * @see     set
+     */
+    bool resize(const keyType& k, unsigned int size) {
+        const unsigned long long hash = hashKey(k);
+        Shard& shard = shardFor(hash);
+        {
+            std::lock_guard<std::mutex> l(shard.mutex);
+            int slot = findSlot(shard, k, hash);
+            if (slot < 0) {
+                return false;
+            }
+            Entry& entry = shard.entries[shard.buckets[slot]];
+            _cacheCurrentByteSize += size;
+            _cacheCurrentByteSize -= entry.size;
+            entry.size = size;
+        }
+        while (_cacheCurrentByteSize.load() > _cacheMaxByteSize.load()) {
+            if (!evictFrom(shardIndex(hash))) {
+                break;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief   修改缓存项是否固定
+     * @details 取消固定的项作为最近使用的项加入LRU链表，之后可以被淘汰；
+     *          固定的项从LRU链表中摘除。本身不触发淘汰
+     *
+     * @param   k 瓦片的唯一标识键
+     * @param   pinned 是否固定
+     * @return  键存在时返回true
+     * @see     set
+     */
+    bool setPinned(const keyType& k, bool pinned) {
+        const unsigned long long hash = hashKey(k);
+        Shard& shard = shardFor(hash);
+        std::lock_guard<std::mutex> l(shard.mutex);
+        int slot = findSlot(shard, k, hash);
+        if (slot < 0) {
+            return false;
+        }
+        int index = shard.buckets[slot];
+        Entry& entry = shard.entries[index];
+        if (entry.pinned != pinned) {
+            if (pinned) {
+                unlinkEntry(shard, index);
+            }
+            entry.pinned = pinned;
+            if (!pinned) {
+                linkEntry(shard, index);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief   移除缓存项
+     * @details 从缓存中移除指定键，不调用releaseValue()和onEvicted()，
+     *          数据的所有权交还调用者
+     *
+     * @param   k 瓦片的唯一标识键
+     * @return  被移除的数据指针，键不存在时返回NULL
+     */
+    T* remove(const keyType& k) {
+        const unsigned long long hash = hashKey(k);
+        Shard& shard = shardFor(hash);
+        std::lock_guard<std::mutex> l(shard.mutex);
+        int slot = findSlot(shard, k, hash);
+        if (slot < 0) {
+            return NULL;
+        }
+        int index = shard.buckets[slot];
+        Entry& entry = shard.entries[index];
+        if (!entry.pinned) {
+            unlinkEntry(shard, index);
+        }
+        eraseSlot(shard, slot);
+        _cacheCurrentByteSize -= entry.size;
+        T* value = entry.value;
+        entry = Entry();
+        shard.freeEntries.push_back(index);
+        return value;
+    }
+
     /**
      * @brief   获取当前缓存使用的字节大小
      * @details 返回缓存当前占用的内存字节数
@@ -196,7 +367,7 @@ public:
      * @return  当前缓存使用的字节大小
      * @see     maxCacheSize, setMaxCacheSize
      */
-    unsigned long long currentCacheSize() const { return _cacheCurrentByteSize; }
+    unsigned long long currentCacheSize() const { return _cacheCurrentByteSize.load(); }
 
     /**
      * @brief   获取缓存的最大字节大小
@@ -205,7 +376,7 @@ public:
      * @return  缓存的最大字节大小
      * @see     currentCacheSize, setMaxCacheSize
      */
-    unsigned long long maxCacheSize() const { return _cacheMaxByteSize; }
+    unsigned long long maxCacheSize() const { return _cacheMaxByteSize.load(); }
 
     /**
      * @brief   设置缓存的最大字节大小
@@ -213,7 +384,7 @@ public:
      *          超过新的最大字节大小，会调用evict()淘汰数据直到满足要求。
      *
      * @param   cacheMaxByteSize 新的最大缓存字节大小
-     * @note    该操作可能会导致部分缓存数据被淘汰
+     * @note    该操作可能会导致部分缓存数据被淘汰；只剩固定项时停止淘汰
      * @see     currentCacheSize, maxCacheSize, evict
      * @example
      *          // 使用示例
@@ -221,64 +392,290 @@ public:
      */
     void setMaxCacheSize(const unsigned long long& cacheMaxByteSize) {
         _cacheMaxByteSize = cacheMaxByteSize;
-        while (_cacheCurrentByteSize > _cacheMaxByteSize) {
-            evict();
+        while (_cacheCurrentByteSize.load() > _cacheMaxByteSize.load()) {
+            if (!evict()) {
+                break;
+            }
         }
     }
 
+    /**
+     * @brief   获取缓存中的所有数据
+     * @return  所有瓦片数据指针（包括固定项）
+     * @note    返回的是快照，调用期间其他线程插入的数据不保证包含在内
+     */
+    std::vector<T*> getAllValues() {
+        std::vector<T*> values;
+        for (unsigned int s = 0; s < kShardCount; ++s) {
+            std::lock_guard<std::mutex> l(_shards[s].mutex);
+            for (const Entry& entry : _shards[s].entries) {
+                if (entry.value) {
+                    values.push_back(entry.value);
+                }
+            }
+        }
+        return values;
+    }
+
     /**
      * @brief   清空缓存
-     * @details 清空所有缓存数据。释放缓存中存储的所有动态分配的内存，
-     *          然后清空_cache映射和_LRU列表，最后将当前使用的字节大小设为0。
+     * @details 清空所有缓存数据。对每个数据调用releaseValue()，
+     *          然后清空所有分片，最后将当前使用的字节大小设为0。
      * @note    该操作会释放所有缓存的数据，请谨慎使用
-     * @see     evict
+     * @see     evict, releaseValue
      * @example
      *          // 使用示例
      *          cache.clear(); // 清空所有缓存数据
      */
     virtual void clear() {
-        for (key_iterator it = _cache.begin(); it != _cache.end(); ++it) {
-            delete[] it->second.first.first;
+        for (unsigned int s = 0; s < kShardCount; ++s) {
+            Shard& shard = _shards[s];
+            std::vector<T*> values;
+            {
+                std::lock_guard<std::mutex> l(shard.mutex);
+                for (const Entry& entry : shard.entries) {
+                    if (entry.value) {
+                        values.push_back(entry.value);
+                        _cacheCurrentByteSize -= entry.size;
+                    }
+                }
+                shard.entries.clear();
+                shard.freeEntries.clear();
+                shard.buckets.clear();
+                shard.count = 0;
+                shard.lruHead = -1;
+                shard.lruTail = -1;
+            }
+            for (T* value : values) {
+                releaseValue(value);
+            }
         }
-        _cache.clear();
-        _LRU.clear();
-        _cacheCurrentByteSize = 0;
     }
 
 protected:
+    /**
+     * @brief 缓存项
+     * @details 存放在分片的entries数组中，prev/next为LRU链表中相邻项的下标
+     */
+    struct Entry {
+        keyType key = 0;
+        T* value = NULL;
+        unsigned int size = 0;
+        int prev = -1;
+        int next = -1;
+        bool pinned = false;
+    };
+
+    /**
+     * @brief 缓存分片
+     * @details buckets为线性探测哈希表（存放entries下标，-1表示空槽，容量为2的幂），
+     *          lruHead为最久未使用项，lruTail为最近使用项
+     */
+    struct Shard {
+        std::mutex mutex;
+        std::vector<Entry> entries;
+        std::vector<int> freeEntries;
+        std::vector<int> buckets;
+        unsigned int count = 0;
+        int lruHead = -1;
+        int lruTail = -1;
+    };
+
     /** @brief 表示当前缓存使用的字节大小 */
-    unsigned long long _cacheCurrentByteSize;
+    std::atomic<unsigned long long> _cacheCurrentByteSize;
 
     /** @brief 表示缓存的最大字节大小 */
-    unsigned long long _cacheMaxByteSize;
+    std::atomic<unsigned long long> _cacheMaxByteSize;
+
+    /** @brief 缓存分片 */
+    Shard _shards[kShardCount];
+
+    /**
+     * @brief   释放一个缓存数据
+     * @details 默认使用delete[]释放；派生类可重写以改变所有权语义
+     * @param   value 数据指针
+     */
+    virtual void releaseValue(T* value) {
+        delete[] value;
+    }
 
-    /** @brief 用于存储键的列表，实现LRU顺序 */
-    std::list<keyType> _LRU;
+    /**
+     * @brief   数据被淘汰时的回调
+     * @details 默认调用releaseValue()。调用时不持有任何分片锁
+     * @param   value 被淘汰的数据指针
+     */
+    virtual void onEvicted(T* value) {
+        releaseValue(value);
+    }
 
     /**
-     * @brief 缓存映射表
-     * @details _cache是一个std::map，用于存储瓦片数据，键为keyType，
-     *          值为一个std::pair，包含数据指针、大小和_LRU列表中的迭代器
+     * @brief   缓存项被淘汰时的回调（带键和大小）
+     * @details 默认调用onEvicted(value)。需要根据键或大小处理被淘汰数据的派生类重写该函数，
+     *          调用时不持有任何分片锁
+     * @param   k 被淘汰项的键
+     * @param   value 被淘汰的数据指针
+     * @param   size 被淘汰数据的大小（字节）
      */
-    std::map<keyType, std::pair<std::pair<T*, unsigned int>, keyTypeList::iterator> > _cache;
+    virtual void onEntryEvicted(const keyType& /*k*/, T* value, unsigned int /*size*/) {
+        onEvicted(value);
+    }
 
     /**
      * @brief   淘汰最久未使用的瓦片数据
-     * @details 实现LRU算法的核心函数，淘汰最久未使用的数据。
-     *          找到_LRU列表的第一个元素（最久未使用的键），
-     *          然后在_cache映射中查找该键对应的数据。
+     * @details 实现LRU算法的核心函数，从第一个有可淘汰数据的分片中
+     *          淘汰其最久未使用的数据。
      *
+     * @return  true表示淘汰了一项，false表示只剩固定项或缓存为空
      * @note    该函数是protected的，只能由类内部调用
      * @see     set, clear
      */
-    virtual void evict() {
-        // 首先找到_LRU列表的第一个元素，即最久未使用的键，然后在_cache映射中查找该键对应的数据
-        key_iterator it = _cache.find(_LRU.front());
-
-        // 释放该瓦片数据的内存，更新当前使用的字节大小，从_cache映射中删除该数据，然后从_LRU列表中删除该键
-        _cacheCurrentByteSize -= it->second.first.second;
-        delete[] it->second.first.first;
-        _cache.erase(it);
-        _LRU.pop_front();
+    bool evict() {
+        return evictFrom(0);
+    }
+
+    /**
+     * @brief   从指定分片开始淘汰一项
+     * @param   firstShard 首先尝试的分片
+     * @return  true表示淘汰了一项
+     */
+    bool evictFrom(unsigned int firstShard) {
+        for (unsigned int i = 0; i < kShardCount; ++i) {
+            Shard& shard = _shards[(firstShard + i) & (kShardCount - 1)];
+            T* evicted = NULL;
+            keyType evictedKey = 0;
+            unsigned int evictedSize = 0;
+            {
+                std::lock_guard<std::mutex> l(shard.mutex);
+                int index = shard.lruHead;
+                if (index < 0) {
+                    continue;
+                }
+                Entry& entry = shard.entries[index];
+                unlinkEntry(shard, index);
+                eraseSlot(shard, findSlot(shard, entry.key, hashKey(entry.key)));
+                _cacheCurrentByteSize -= entry.size;
+                evicted = entry.value;
+                evictedKey = entry.key;
+                evictedSize = entry.size;
+                entry = Entry();
+                shard.freeEntries.push_back(index);
+            }
+            onEntryEvicted(evictedKey, evicted, evictedSize);
+            return true;
+        }
+        return false;
+    }
+
+private:
+    /** @brief 64位整数混合哈希（splitmix64终结函数） */
+    static unsigned long long hashKey(keyType k) {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ULL;
+        k ^= k >> 33;
+        return k;
+    }
+
+    /** @brief 由哈希值的高位选择分片，低位用于分片内探测 */
+    static unsigned int shardIndex(unsigned long long hash) {
+        return static_cast<unsigned int>(hash >> 60) & (kShardCount - 1);
+    }
+
+    Shard& shardFor(unsigned long long hash) {
+        return _shards[shardIndex(hash)];
+    }
+
+    /** @brief 查找键所在的槽位，不存在时返回-1 */
+    static int findSlot(const Shard& shard, const keyType& k, unsigned long long hash) {
+        if (shard.buckets.empty()) {
+            return -1;
+        }
+        const size_t mask = shard.buckets.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            int index = shard.buckets[i];
+            if (index < 0) {
+                return -1;
+            }
+            if (shard.entries[index].key == k) {
+                return static_cast<int>(i);
+            }
+        }
+    }
+
+    /** @brief 插入槽位，负载因子超过1/2时扩容 */
+    static void insertSlot(Shard& shard, int index, unsigned long long hash) {
+        if ((shard.count + 1) * 2 > shard.buckets.size()) {
+            std::vector<int> oldBuckets(shard.buckets.size() < 16 ? 16 : shard.buckets.size() * 2, -1);
+            oldBuckets.swap(shard.buckets);
+            const size_t mask = shard.buckets.size() - 1;
+            for (int oldIndex : oldBuckets) {
+                if (oldIndex >= 0) {
+                    size_t i = hashKey(shard.entries[oldIndex].key) & mask;
+                    while (shard.buckets[i] >= 0) {
+                        i = (i + 1) & mask;
+                    }
+                    shard.buckets[i] = oldIndex;
+                }
+            }
+        }
+        const size_t mask = shard.buckets.size() - 1;
+        size_t i = hash & mask;
+        while (shard.buckets[i] >= 0) {
+            i = (i + 1) & mask;
+        }
+        shard.buckets[i] = index;
+        ++shard.count;
+    }
+
+    /** @brief 删除槽位，使用后移删除保持探测链连续，无需墓碑 */
+    static void eraseSlot(Shard& shard, int slot) {
+        const size_t mask = shard.buckets.size() - 1;
+        size_t hole = static_cast<size_t>(slot);
+        shard.buckets[hole] = -1;
+        for (size_t j = (hole + 1) & mask; shard.buckets[j] >= 0; j = (j + 1) & mask) {
+            size_t home = hashKey(shard.entries[shard.buckets[j]].key) & mask;
+            // home不在(hole, j]区间内时，该项可以移动到空洞处
+            bool movable = (hole <= j) ? (home <= hole || home > j) : (home <= hole && home > j);
+            if (movable) {
+                shard.buckets[hole] = shard.buckets[j];
+                shard.buckets[j] = -1;
+                hole = j;
+            }
+        }
+        --shard.count;
+    }
+
+    /** @brief 将项追加到LRU链表末尾 */
+    static void linkEntry(Shard& shard, int index) {
+        Entry& entry = shard.entries[index];
+        entry.prev = shard.lruTail;
+        entry.next = -1;
+        if (shard.lruTail >= 0) {
+            shard.entries[shard.lruTail].next = index;
+        }
+        else {
+            shard.lruHead = index;
+        }
+        shard.lruTail = index;
+    }
+
+    /** @brief 将项从LRU链表中摘除 */
+    static void unlinkEntry(Shard& shard, int index) {
+        Entry& entry = shard.entries[index];
+        if (entry.prev >= 0) {
+            shard.entries[entry.prev].next = entry.next;
+        }
+        else {
+            shard.lruHead = entry.next;
+        }
+        if (entry.next >= 0) {
+            shard.entries[entry.next].prev = entry.prev;
+        }
+        else {
+            shard.lruTail = entry.prev;
+        }
+        entry.prev = -1;
+        entry.next = -1;
     }
 };
\ No newline at end of file
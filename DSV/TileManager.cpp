@@ -17,6 +17,36 @@
 #include "ImageSource.h"
 #include "WSITileGraphicsItem.h"
 #include "WSITileGraphicsItemCache.h"
+#include "WSITileLayerItem.h"
+#include "TileCache.hpp"
+#include "PipelineTrace.h"
+#include <algorithm>
+
+const double TileManager::kForegroundShare = 0.5;
+
+/**
+ * @brief 前景缓存
+ * @details 不拥有瓦片图形项，淘汰时通知TileManager释放该瓦片的前景
+ */
+class TileManager::ForegroundCache : public TileCache<WSITileGraphicsItem> {
+public:
+    explicit ForegroundCache(TileManager* manager) : _manager(manager) {}
+
+    ~ForegroundCache() {
+        clear();
+    }
+
+protected:
+    void releaseValue(WSITileGraphicsItem* value) {
+    }
+
+    void onEvicted(WSITileGraphicsItem* value) {
+        _manager->onForegroundEvicted(value);
+    }
+
+private:
+    TileManager* _manager;
+};
 
 /**
  * @brief 构造函数：初始化瓦片管理器
@@ -31,31 +61,199 @@
  *          - 瓦片大小和渲染层级
  *          - 层级降采样比例和尺寸信息
  *          - 覆盖状态管理
+ *          - 加入场景的瓦片图层
  */
 TileManager::TileManager(std::shared_ptr<MultiResolutionImage> img, unsigned int tileSize, unsigned int lastRenderLevel, IOThread* ioThread, WSITileGraphicsItemCache* cache, QGraphicsScene* scene) :
+    TileManager(img, std::vector<unsigned int>(1, tileSize), lastRenderLevel, ioThread, cache, scene)
+{
+}
+
+/**
+ * @brief 构造函数：按层级的瓦片大小初始化瓦片管理器
+ * @param img 多分辨率图像对象
+ * @param levelTileSizes 各层级的瓦片大小
+ * @param lastRenderLevel 最后渲染层级
+ * @param ioThread IO线程对象
+ * @param cache 瓦片缓存对象
+ * @param scene Qt图形场景对象
+ */
+TileManager::TileManager(std::shared_ptr<MultiResolutionImage> img, const std::vector<unsigned int>& levelTileSizes, unsigned int lastRenderLevel, IOThread* ioThread, WSITileGraphicsItemCache* cache, QGraphicsScene* scene) :
     _ioThread(ioThread),
-    _tileSize(tileSize),
+    _tileSize(0),
+    _levelTileSizes(levelTileSizes),
     _lastRenderLevel(lastRenderLevel),
     _lastFOV(),
     _lastLevel(),
     _coverage(),
     _cache(cache),
     _scene(scene),
+    _layer(),
     _coverageMaps(),
     _coverageMapCacheMode(false),
-    _renderForeground(true)
+    _renderForeground(true),
+    _progressiveDecoding(false),
+    _foregroundCache(new ForegroundCache(this))
 {
     for (unsigned int i = 0; i < img->getNumberOfLevels(); ++i) {
         _levelDownsamples.push_back(img->getLevelDownsample(i));
         _levelDimensions.push_back(img->getLevelDimensions(i));
     }
+    if (_levelTileSizes.empty()) {
+        _levelTileSizes.push_back(512);
+    }
+    _levelTileSizes.resize(std::max<size_t>(_levelTileSizes.size(), _levelDimensions.size()), _levelTileSizes.back());
+    _tileSize = getTileSize(_lastRenderLevel);
+    _coverage.resize(_levelDimensions.size());
+    for (unsigned int i = 0; i < _coverage.size(); ++i) {
+        QPoint nrTiles = getLevelTiles(i);
+        _coverage[i].resize(nrTiles.x(), nrTiles.y());
+    }
+    _coverageMaps.resize(_coverage.size());
+    for (unsigned int i = 0; i < _coverage.size() && i < _lastRenderLevel; ++i) {
+        QImage map(_coverage[i].width, _coverage[i].height, QImage::Format_MonoLSB);
+        map.setColorTable(QVector<QRgb>() << qRgba(0, 0, 0, 0) << qRgba(255, 255, 255, 255));
+        map.fill(0);
+        _coverageMaps[i] = map;
+    }
+    if (_scene && _lastRenderLevel < _levelDimensions.size()) {
+        // 多留一行一列，各层级尺寸取整不同，边缘的瓦片可能略超出最后渲染层级的网格
+        QPoint nrTiles = getLevelTiles(_lastRenderLevel);
+        _layer = new WSITileLayerItem(_levelDownsamples, _lastRenderLevel, _levelTileSizes, QRectF(0, 0, (nrTiles.x() + 1.) * _tileSize, (nrTiles.y() + 1.) * _tileSize));
+        _scene->addItem(_layer);
+    }
+}
+
+/**
+ * @brief 分配覆盖度网格
+ * @param gridWidth 网格宽度
+ * @param gridHeight 网格高度
+ */
+void TileManager::CoverageGrid::resize(int gridWidth, int gridHeight) {
+    width = std::max(gridWidth, 0);
+    height = std::max(gridHeight, 0);
+    cells.assign((static_cast<size_t>(width) * height + 3) / 4, 0);
+    nrCovered = 0;
+}
+
+/**
+ * @brief 清零覆盖度网格
+ */
+void TileManager::CoverageGrid::reset() {
+    std::fill(cells.begin(), cells.end(), 0);
+    nrCovered = 0;
+}
+
+/**
+ * @brief 获取瓦片覆盖度
+ * @param x 瓦片X坐标
+ * @param y 瓦片Y坐标
+ * @return 覆盖度
+ */
+unsigned char TileManager::CoverageGrid::get(int x, int y) const {
+    if (x < 0 || y < 0 || x >= width || y >= height) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(y) * width + x;
+    return (cells[index >> 2] >> ((index & 3) * 2)) & 3;
+}
+
+/**
+ * @brief 设置瓦片覆盖度
+ * @param x 瓦片X坐标
+ * @param y 瓦片Y坐标
+ * @param covers 覆盖度
+ */
+void TileManager::CoverageGrid::set(int x, int y, unsigned char covers) {
+    if (x < 0 || y < 0 || x >= width || y >= height) {
+        return;
+    }
+    size_t index = static_cast<size_t>(y) * width + x;
+    unsigned int shift = (index & 3) * 2;
+    unsigned char& cell = cells[index >> 2];
+    unsigned char previous = (cell >> shift) & 3;
+    covers &= 3;
+    cell = static_cast<unsigned char>((cell & ~(3u << shift)) | (covers << shift));
+    if (previous == 2 && covers != 2) {
+        --nrCovered;
+    }
+    else if (previous != 2 && covers == 2) {
+        ++nrCovered;
+    }
+}
+
+/**
+ * @brief 选择与原生瓦片网格对齐的瓦片大小
+ * @param img 多分辨率图像对象
+ * @param preferred 首选瓦片大小
+ * @return 瓦片大小
+ * @details 没有原生瓦片信息的层级（如条带存储的小层级）不参与判断
+ */
+unsigned int TileManager::alignedTileSize(const std::shared_ptr<MultiResolutionImage>& img, unsigned int preferred) {
+    if (!img) {
+        return preferred;
+    }
+    unsigned long long nativeSize = 0;
+    for (unsigned int level = 0; level < img->getNumberOfLevels(); ++level) {
+        std::vector<unsigned long long> tileSize = img->getLevelTileSize(level);
+        if (tileSize.size() < 2) {
+            continue;
+        }
+        if (tileSize[0] == 0 || tileSize[0] != tileSize[1] || (nativeSize != 0 && tileSize[0] != nativeSize)) {
+            return preferred;
+        }
+        nativeSize = tileSize[0];
+    }
+    if (nativeSize == 0 || nativeSize > kMaxAlignedTileSize) {
+        return preferred;
+    }
+    unsigned long long multiple = (kMinAlignedTileSize + nativeSize - 1) / nativeSize;
+    return static_cast<unsigned int>(nativeSize * multiple);
+}
+
+/**
+ * @brief 为每个层级选择瓦片大小
+ * @param img 多分辨率图像对象
+ * @param preferred 首选瓦片大小
+ * @param lastRenderLevel 最后渲染层级
+ * @param readLatency 每百万像素的读取时间（毫秒）
+ * @return 各层级的瓦片大小
+ * @details 读取时间按像素数线性估计，慢速存储上减半的瓦片约在四分之一的时间内到达
+ */
+std::vector<unsigned int> TileManager::levelTileSizes(const std::shared_ptr<MultiResolutionImage>& img, unsigned int preferred,
+    unsigned int lastRenderLevel, double readLatency) {
+    const unsigned int aligned = alignedTileSize(img, preferred);
+    if (!img) {
+        return std::vector<unsigned int>(1, aligned);
+    }
+    const double alignedRead = readLatency * aligned * aligned / 1e6;
+    std::vector<unsigned int> sizes(img->getNumberOfLevels(), aligned);
+    for (unsigned int level = 0; level < sizes.size() && level < lastRenderLevel; ++level) {
+        const double downsample = img->getLevelDownsample(level);
+        if (downsample >= kCoarseDownsample && aligned * 2 <= kMaxLevelTileSize) {
+            sizes[level] = aligned * 2;
+        }
+        else if (downsample < kFineDownsample && alignedRead > kSlowTileRead && aligned / 2 >= kMinAlignedTileSize) {
+            std::vector<unsigned long long> nativeSize = img->getLevelTileSize(level);
+            const unsigned int half = aligned / 2;
+            if (nativeSize.size() < 2 || nativeSize[0] == 0 || half % nativeSize[0] == 0) {
+                sizes[level] = half;
+            }
+        }
+    }
+    return sizes;
 }
 
 /**
  * @brief 析构函数：清理瓦片管理器资源
- * @details 清理所有指针引用，但不删除对象（由外部管理）
+ * @details 删除瓦片图层及其中的瓦片，其余指针只清理引用，不删除对象（由外部管理）
  */
 TileManager::~TileManager() {
+    if (_layer) {
+        if (_layer->scene()) {
+            _layer->scene()->removeItem(_layer);
+        }
+        delete _layer;
+    }
     _ioThread = NULL;
     _cache = NULL;
     _scene = NULL;
@@ -64,12 +262,14 @@ TileManager::~TileManager() {
 /**
  * @brief 重置指定层级的覆盖状态
  * @param level 要重置的层级
- * @details 清空指定层级的覆盖状态映射和覆盖路径
+ * @details 清空指定层级的覆盖度网格和覆盖度地图
  */
 void TileManager::resetCoverage(unsigned int level) {
-    _coverage[level] = std::map<int, std::map<int, unsigned char> >();
+    if (level < _coverage.size()) {
+        _coverage[level].reset();
+    }
     if (_coverageMaps.size() > level) {
-        _coverageMaps[level] = QPainterPath();
+        _coverageMaps[level].fill(0);
     }
 }
 
@@ -82,7 +282,8 @@ void TileManager::resetCoverage(unsigned int level) {
  */
 QPoint TileManager::pixelCoordinatesToTileCoordinates(QPointF coordinate, unsigned int level) {
     if (level < _levelDownsamples.size()) {
-        return QPoint(std::floor((coordinate.x() / _levelDownsamples[level]) / this->_tileSize), std::floor((coordinate.y() / _levelDownsamples[level]) / this->_tileSize));
+        const unsigned int tileSize = getTileSize(level);
+        return QPoint(std::floor((coordinate.x() / _levelDownsamples[level]) / tileSize), std::floor((coordinate.y() / _levelDownsamples[level]) / tileSize));
     }
     else {
         return QPoint();
@@ -98,7 +299,8 @@ QPoint TileManager::pixelCoordinatesToTileCoordinates(QPointF coordinate, unsign
  */
 QPointF TileManager::tileCoordinatesToPixelCoordinates(QPoint coordinate, unsigned int level) {
     if (level < _levelDownsamples.size()) {
-        return QPointF(coordinate.x() * _levelDownsamples[level] * this->_tileSize, coordinate.y() * _levelDownsamples[level] * this->_tileSize);
+        const unsigned int tileSize = getTileSize(level);
+        return QPointF(coordinate.x() * _levelDownsamples[level] * tileSize, coordinate.y() * _levelDownsamples[level] * tileSize);
     }
     else {
         return QPoint();
@@ -114,7 +316,8 @@ QPointF TileManager::tileCoordinatesToPixelCoordinates(QPoint coordinate, unsign
 QPoint TileManager::getLevelTiles(unsigned int level) {
     if (level < _levelDimensions.size()) {
         std::vector<unsigned long long> dims = _levelDimensions[level];
-        return QPoint(std::ceil(dims[0] / static_cast<float>(_tileSize)), std::ceil(dims[1] / static_cast<float>(_tileSize)));
+        const float tileSize = static_cast<float>(getTileSize(level));
+        return QPoint(std::ceil(dims[0] / tileSize), std::ceil(dims[1] / tileSize));
     }
     else {
         return QPoint();
@@ -130,19 +333,106 @@ void TileManager::loadAllTilesForLevel(unsigned int level) {
     if (_ioThread) {
         if (level < _levelDownsamples.size()) {
             std::vector<unsigned long long> baseLevelDims = _levelDimensions[0];
-            this->loadTilesForFieldOfView(QRectF(0, 0, baseLevelDims[0], baseLevelDims[1]), level);
+            this->loadTilesForFieldOfView(QRectF(0, 0, baseLevelDims[0], baseLevelDims[1]), level, true);
         }
     }
 }
 
+/**
+ * @brief 计算多边形在水平带内的横向范围
+ * @param polygon 多边形（首尾顶点不必重复）
+ * @param y0 水平带上边界
+ * @param y1 水平带下边界
+ * @param minX 输出最小X
+ * @param maxX 输出最大X
+ * @return 多边形与水平带相交时返回true
+ * @details 把每条边裁剪到水平带内，取裁剪后端点的X范围；
+ *          水平线穿过多边形内部时必然与左右两侧的边相交，因此范围等于多边形在带内的范围
+ */
+static bool polygonRowSpan(const QPolygonF& polygon, double y0, double y1, double& minX, double& maxX)
+{
+    bool found = false;
+    for (int i = 0; i < polygon.size(); ++i) {
+        const QPointF& p = polygon[i];
+        const QPointF& q = polygon[(i + 1) % polygon.size()];
+        if ((p.y() < y0 && q.y() < y0) || (p.y() > y1 && q.y() > y1)) {
+            continue;
+        }
+        double t0 = 0., t1 = 1.;
+        const double dy = q.y() - p.y();
+        if (dy != 0.) {
+            const double ta = (y0 - p.y()) / dy;
+            const double tb = (y1 - p.y()) / dy;
+            t0 = std::max(0., std::min(ta, tb));
+            t1 = std::min(1., std::max(ta, tb));
+        }
+        const double xa = p.x() + t0 * (q.x() - p.x());
+        const double xb = p.x() + t1 * (q.x() - p.x());
+        if (!found) {
+            minX = std::min(xa, xb);
+            maxX = std::max(xa, xb);
+            found = true;
+        }
+        else {
+            minX = std::min(minX, std::min(xa, xb));
+            maxX = std::max(maxX, std::max(xa, xb));
+        }
+    }
+    return found;
+}
+
 /**
  * @brief 为指定视野范围加载瓦片
  * @param FOV 视野范围（像素坐标）
  * @param level 图像层级
+ * @param batchMissing 视场内已有瓦片时也合并缺失的相邻瓦片
  * @details 计算视野范围内的瓦片坐标，并为未加载的瓦片创建加载任务
- *          避免重复加载已存在的瓦片
+ *          避免重复加载已存在的瓦片；视野变化时先让IOThread剔除已离开视野的排队任务。
+ *          冷加载时整块缺失的相邻瓦片合并为一个任务，由一次区域读取加载
+ */
+void TileManager::loadTilesForFieldOfView(const QRectF& FOV, const unsigned int level, bool batchMissing) {
+    loadTiles(FOV, QPolygonF(), level, batchMissing);
+}
+
+/**
+ * @brief 按实际视口多边形加载瓦片
+ * @param viewport 视口多边形（第0层像素坐标）
+ * @param level 图像层级
+ * @details 旋转视图时只请求与视口相交的瓦片
+ */
+void TileManager::loadTilesForFieldOfView(const QPolygonF& viewport, const unsigned int level) {
+    loadTiles(viewport.boundingRect(), viewport, level, false);
+}
+
+/**
+ * @brief 请求加载单个瓦片
+ * @param level 图像层级
+ * @param tileX 瓦片列号
+ * @param tileY 瓦片行号
+ */
+void TileManager::loadTile(unsigned int level, int tileX, int tileY) {
+    if (!_ioThread || level > _lastRenderLevel) {
+        return;
+    }
+    QPoint nrTiles = getLevelTiles(level);
+    if (tileX < 0 || tileY < 0 || tileX >= nrTiles.x() || tileY >= nrTiles.y() || providesCoverage(level, tileX, tileY) >= 1) {
+        return;
+    }
+    setCoverage(level, tileX, tileY, 1);
+    PipelineTrace::flow(PipelineTrace::FlowBegin, tileX, tileY, level);
+    _ioThread->addJob(getTileSize(level), tileX, tileY, level);
+}
+
+/**
+ * @brief 为视场内缺失的瓦片排队加载任务
+ * @param FOV 视场外接矩形
+ * @param viewport 视口多边形，为空表示整个FOV
+ * @param level 图像层级
+ * @param batchMissing 视场内已有瓦片时也合并缺失的相邻瓦片
+ * @details 有视口多边形时逐行计算多边形覆盖的瓦片列范围，范围之外的瓦片不请求，
+ *          也不计入冷加载的判断
  */
-void TileManager::loadTilesForFieldOfView(const QRectF& FOV, const unsigned int level) {
+void TileManager::loadTiles(const QRectF& FOV, const QPolygonF& viewport, const unsigned int level, bool batchMissing) {
     if (level > _lastRenderLevel) {
         return;
     }
@@ -152,19 +442,86 @@ void TileManager::loadTilesForFieldOfView(const QRectF& FOV, const unsigned int
         QRect FOVTile = QRect(topLeftTile, bottomRightTile);
         QPoint nrTiles = getLevelTiles(level);
         float levelDownsample = _levelDownsamples[level];
-        if (FOVTile != _lastFOV || level != _lastLevel) {
+        const unsigned int tileSize = getTileSize(level);
+        if (FOVTile != _lastFOV || level != _lastLevel || viewport != _lastViewport) {
+            PipelineTrace::ScopedEvent event("TileManager::loadTilesForFieldOfView");
             _lastLevel = level;
             _lastFOV = FOVTile;
-            for (int x = topLeftTile.x(); x <= bottomRightTile.x(); ++x) {
-                if (x >= 0 && x <= nrTiles.x()) {
-                    for (int y = topLeftTile.y(); y <= bottomRightTile.y(); ++y) {
-                        if (y >= 0 && y <= nrTiles.y()) {
-                            if (providesCoverage(level, x, y) < 1) {
-                                setCoverage(level, x, y, 1);
-                                _ioThread->addJob(_tileSize, x, y, level);
+            _lastViewport = viewport;
+            _ioThread->setFieldOfView(FOV, _lastRenderLevel);
+            const int firstX = std::max(topLeftTile.x(), 0);
+            const int lastX = std::min(bottomRightTile.x(), nrTiles.x() - 1);
+            const int firstY = std::max(topLeftTile.y(), 0);
+            const int lastY = std::min(bottomRightTile.y(), nrTiles.y() - 1);
+            if (firstX > lastX || firstY > lastY) {
+                return;
+            }
+            const int columns = lastX - firstX + 1;
+            std::vector<char> missing(static_cast<size_t>(columns) * (lastY - firstY + 1), 0);
+            size_t nrMissing = 0;
+            size_t nrCandidates = 0;
+            const double tileExtent = static_cast<double>(levelDownsample) * tileSize;
+            for (int y = firstY; y <= lastY; ++y) {
+                int rowFirstX = firstX;
+                int rowLastX = lastX;
+                if (!viewport.isEmpty()) {
+                    double minX = 0., maxX = 0.;
+                    if (!polygonRowSpan(viewport, y * tileExtent, (y + 1) * tileExtent, minX, maxX)) {
+                        continue;
+                    }
+                    rowFirstX = std::max(firstX, static_cast<int>(std::floor(minX / tileExtent)));
+                    rowLastX = std::min(lastX, static_cast<int>(std::floor(maxX / tileExtent)));
+                }
+                for (int x = rowFirstX; x <= rowLastX; ++x) {
+                    ++nrCandidates;
+                    if (providesCoverage(level, x, y) < 1) {
+                        missing[(y - firstY) * columns + (x - firstX)] = 1;
+                        ++nrMissing;
+                    }
+                }
+            }
+            const auto queueTile = [this, level](int x, int y) {
+                setCoverage(level, x, y, 1);
+                PipelineTrace::flow(PipelineTrace::FlowBegin, x, y, level);
+            };
+            if (!batchMissing && nrMissing != nrCandidates) {
+                for (int x = firstX; x <= lastX; ++x) {
+                    for (int y = firstY; y <= lastY; ++y) {
+                        if (missing[(y - firstY) * columns + (x - firstX)]) {
+                            queueTile(x, y);
+                            _ioThread->addJob(tileSize, x, y, level, NULL, needsPreview(level, x, y));
+                        }
+                    }
+                }
+                return;
+            }
+            // 冷加载：整块缺失的相邻瓦片由一次区域读取加载，其余按单个瓦片排队
+            for (int blockY = firstY; blockY <= lastY; blockY += kMaxBatchTiles) {
+                const int blockRows = std::min<int>(kMaxBatchTiles, lastY - blockY + 1);
+                for (int blockX = firstX; blockX <= lastX; blockX += kMaxBatchTiles) {
+                    const int blockColumns = std::min<int>(kMaxBatchTiles, lastX - blockX + 1);
+                    bool complete = true;
+                    bool preview = false;
+                    for (int y = blockY; y < blockY + blockRows && complete; ++y) {
+                        for (int x = blockX; x < blockX + blockColumns && complete; ++x) {
+                            complete = missing[(y - firstY) * columns + (x - firstX)] != 0;
+                        }
+                    }
+                    for (int y = blockY; y < blockY + blockRows; ++y) {
+                        for (int x = blockX; x < blockX + blockColumns; ++x) {
+                            if (missing[(y - firstY) * columns + (x - firstX)]) {
+                                queueTile(x, y);
+                                const bool tilePreview = needsPreview(level, x, y);
+                                if (!complete) {
+                                    _ioThread->addJob(tileSize, x, y, level, NULL, tilePreview);
+                                }
+                                preview = preview || tilePreview;
                             }
                         }
                     }
+                    if (complete) {
+                        _ioThread->addBatchJob(tileSize, blockX, blockY, blockColumns, blockRows, level, preview);
+                    }
                 }
             }
         }
@@ -173,13 +530,10 @@ void TileManager::loadTilesForFieldOfView(const QRectF& FOV, const unsigned int
 
 /**
  * @brief 更新瓦片前景
- * @details 清空当前任务队列，等待所有工作线程完成，然后为已加载的瓦片创建前景渲染任务
+ * @details 为已加载的瓦片创建当前渲染代的前景渲染任务，不清空队列也不等待工作线程；
+ *          过期的任务和结果按渲染代丢弃
  */
 void TileManager::updateTileForegounds() {
-    _ioThread->clearJobs();
-    while (_ioThread->getWaitingThreads() != _ioThread->getWorkers().size()) {
-    }
-    QCoreApplication::processEvents();
     if (_cache) {
         std::vector<WSITileGraphicsItem*> cachedTiles = _cache->getAllItems();
         for (auto item : cachedTiles) {
@@ -187,7 +541,7 @@ void TileManager::updateTileForegounds() {
             unsigned int tileLevel = item->getTileLevel();
             unsigned int tileX = item->getTileX();
             unsigned int tileY = item->getTileY();
-            if (providesCoverage(tileLevel, tileX, tileY) == 2) {
+            if (providesCoverage(tileLevel, tileX, tileY) == 2 && item->getForegroundTile()) {
                 ImageSource* foregroundTile = item->getForegroundTile()->clone();
                 _ioThread->addJob(tileSize, tileX, tileY, tileLevel, foregroundTile);
             }
@@ -195,29 +549,74 @@ void TileManager::updateTileForegounds() {
     }
 }
 
+/**
+ * @brief 更新瓦片背景
+ * @details 为所有已覆盖的缓存瓦片提交背景重新合成任务，图形项保留到新背景到达
+ */
+void TileManager::updateTileBackgrounds(bool residentOnly) {
+    if (_cache) {
+        std::vector<WSITileGraphicsItem*> cachedTiles = _cache->getAllItems();
+        for (auto item : cachedTiles) {
+            unsigned int tileLevel = item->getTileLevel();
+            unsigned int tileX = item->getTileX();
+            unsigned int tileY = item->getTileY();
+            if (providesCoverage(tileLevel, tileX, tileY) == 2) {
+                _ioThread->addBackgroundRenderJob(item->getTileSize(), tileX, tileY, tileLevel, residentOnly);
+            }
+        }
+    }
+}
+
+/**
+ * @brief 背景瓦片重新合成完成回调
+ * @param tile 重新渲染的背景瓦片
+ * @param tileX 瓦片X坐标
+ * @param tileY 瓦片Y坐标
+ * @param tileLevel 瓦片层级
+ * @param backgroundGeneration 背景渲染代
+ * @details 过期代的结果和已被移出缓存的瓦片直接丢弃，不改变覆盖状态
+ */
+void TileManager::onBackgroundTileRendered(QPixmap* tile, unsigned int tileX, unsigned int tileY, unsigned int tileLevel, unsigned int backgroundGeneration) {
+    WSITileGraphicsItem* item = NULL;
+    if (_cache && backgroundGeneration == _ioThread->getBackgroundGeneration()) {
+        unsigned int size = 0;
+        _cache->get(WSITileGraphicsItemCache::makeKey(tileX, tileY, tileLevel), item, size);
+    }
+    if (item && tile) {
+        item->setBackgroundPixmap(tile);
+        updateCachedSize(item);
+    }
+    else {
+        delete tile;
+    }
+}
+
 /**
  * @brief 前景瓦片渲染完成回调
  * @param tile 渲染的前景瓦片
  * @param tileX 瓦片X坐标
  * @param tileY 瓦片Y坐标
  * @param tileLevel 瓦片层级
- * @details 将渲染完成的前景瓦片设置到对应的瓦片图形项中
+ * @param renderGeneration 渲染代
+ * @details 将渲染完成的前景瓦片设置到对应的瓦片图形项中，过期代的结果直接丢弃
  */
-void TileManager::onForegroundTileRendered(QPixmap* tile, unsigned int tileX, unsigned int tileY, unsigned int tileLevel) {
+void TileManager::onForegroundTileRendered(QPixmap* tile, unsigned int tileX, unsigned int tileY, unsigned int tileLevel, unsigned int renderGeneration) {
+    if (renderGeneration != _ioThread->getRenderGeneration()) {
+        delete tile;
+        return;
+    }
     if (_cache) {
-        std::stringstream ss;
-        ss << tileX << "_" << tileY << "_" << tileLevel;
-        std::string key;
-        ss >> key;
+        WSITileGraphicsItemCache::keyType key = WSITileGraphicsItemCache::makeKey(tileX, tileY, tileLevel);
 
         WSITileGraphicsItem* item = NULL;
         unsigned int size = 0;
         _cache->get(key, item, size);
         if (item) {
+            setCoverage(tileLevel, tileX, tileY, 2);
             if (tile) {
                 item->setForegroundPixmap(tile);
+                updateCachedSize(item);
             }
-            setCoverage(tileLevel, tileX, tileY, 2);
         }
         else {
             setCoverage(tileLevel, tileX, tileY, 0);
@@ -235,45 +634,249 @@ void TileManager::onForegroundTileRendered(QPixmap* tile, unsigned int tileX, un
  * @param tileLevel 瓦片层级
  * @param foregroundTile 前景瓦片
  * @param foregroundPixmap 前景像素图
- * @details 创建瓦片图形项并添加到场景中，同时更新缓存和覆盖状态
+ * @param renderGeneration 前景渲染代
+ * @param backgroundGeneration 背景渲染代
+ * @details 创建瓦片图形项并加入瓦片图层，同时更新缓存和覆盖状态，缓存按图形项的实际内存占用计费；
+ *          该位置的瓦片已在图层中时丢弃新的背景，若已有瓦片的前景曾被单独释放则恢复其前景
  */
-void TileManager::onTileLoaded(QPixmap* tile, unsigned int tileX, unsigned int tileY, unsigned int tileSize, unsigned int tileByteSize, unsigned int tileLevel, ImageSource* foregroundTile, QPixmap* foregroundPixmap) {
+void TileManager::onTileLoaded(QPixmap* tile, unsigned int tileX, unsigned int tileY, unsigned int tileSize, unsigned int tileByteSize, unsigned int tileLevel, ImageSource* foregroundTile, QPixmap* foregroundPixmap, unsigned int renderGeneration, unsigned int backgroundGeneration) {
+    PipelineTrace::ScopedEvent event("TileManager::onTileLoaded", tileX, tileY, tileLevel);
+    PipelineTrace::flow(PipelineTrace::FlowStep, tileX, tileY, tileLevel);
     if (tile) {
-        WSITileGraphicsItem* item = new WSITileGraphicsItem(tile, tileX, tileY, tileSize, tileByteSize, tileLevel, _lastRenderLevel, _levelDownsamples, this, foregroundPixmap, foregroundTile, _foregroundOpacity, _renderForeground);
-        std::stringstream ss;
-        ss << tileX << "_" << tileY << "_" << tileLevel;
-        std::string key;
-        ss >> key;
-        if (_scene) {
+        if (foregroundTile && renderGeneration != _ioThread->getRenderGeneration()) {
+            // 前景按旧设置渲染，先显示旧结果，同时提交当前代的重新渲染
+            _ioThread->addJob(tileSize, tileX, tileY, tileLevel, foregroundTile->clone());
+        }
+        if (backgroundGeneration != _ioThread->getBackgroundGeneration()) {
+            // 背景按旧的合成设置渲染，同样先显示并提交重新合成
+            _ioThread->addBackgroundRenderJob(tileSize, tileX, tileY, tileLevel);
+        }
+        WSITileGraphicsItem* existing = _layer ? _layer->getTile(tileX, tileY, tileLevel) : NULL;
+        if (existing && existing->isPreview()) {
+            // 完整解码就地替换预览，图形项不离开图层，替换时不会闪烁
             setCoverage(tileLevel, tileX, tileY, 2);
-            float tileDownsample = _levelDownsamples[tileLevel];
-            float maxDownsample = _levelDownsamples[_lastRenderLevel];
-            float posX = (tileX * tileDownsample * tileSize) / maxDownsample + ((tileSize * tileDownsample) / (2 * maxDownsample));
-            float posY = (tileY * tileDownsample * tileSize) / maxDownsample + ((tileSize * tileDownsample) / (2 * maxDownsample));
-            _scene->addItem(item);
-            item->setPos(posX, posY);
-            item->setZValue(1. / ((float)tileLevel + 1.));
+            existing->setBackgroundPixmap(tile);
+            if (foregroundTile || foregroundPixmap) {
+                existing->setForeground(foregroundTile, foregroundPixmap);
+            }
+            emit tileDisplayed(*tile, tileArea(tileX, tileY, tileSize, tileLevel));
+            updateCachedSize(existing);
+            return;
+        }
+        if (existing && foregroundTile && !existing->getForegroundTile()) {
+            setCoverage(tileLevel, tileX, tileY, 2);
+            existing->setBackgroundPixmap(tile);
+            existing->setForeground(foregroundTile, foregroundPixmap);
+            updateCachedSize(existing);
+            return;
         }
-        if (_cache) {
-            _cache->set(key, item, tileByteSize, tileLevel == _lastRenderLevel);
+        WSITileGraphicsItem* item = new WSITileGraphicsItem(tile, tileX, tileY, tileSize, tileByteSize, tileLevel, _lastRenderLevel, _levelDownsamples, this, foregroundPixmap, foregroundTile, _foregroundOpacity, _renderForeground);
+        WSITileGraphicsItemCache::keyType key = WSITileGraphicsItemCache::makeKey(tileX, tileY, tileLevel);
+        if (!_layer || existing) {
+            if (existing) {
+                // 前景图像已被移除，已有的瓦片保持显示
+                setCoverage(tileLevel, tileX, tileY, 2);
+            }
+            delete item;
+            return;
+        }
+        setCoverage(tileLevel, tileX, tileY, 2);
+        const QRectF area = tileArea(tileX, tileY, tileSize, tileLevel);
+        item->setPos(area.center());
+        _layer->addTile(item);
+        emit tileDisplayed(*tile, area);
+        if (_cache && _cache->set(key, item, item->getByteSize(), pinsTile(tileLevel)) == 0) {
+            updateCachedSize(item);
         }
     }
     else {
+        WSITileGraphicsItem* existing = _layer ? _layer->getTile(tileX, tileY, tileLevel) : NULL;
+        if (existing && existing->isPreview()) {
+            // 任务被取消，预览不会再被替换；移除后瓦片再次进入视野时重新加载
+            if (_cache) {
+                _cache->remove(WSITileGraphicsItemCache::makeKey(tileX, tileY, tileLevel));
+            }
+            onTileRemoved(existing);
+            return;
+        }
         setCoverage(tileLevel, tileX, tileY, 0);
     }
 }
 
+/**
+ * @brief 瓦片预览加载完成回调
+ * @param tile 预览像素图
+ * @param tileX 瓦片X坐标
+ * @param tileY 瓦片Y坐标
+ * @param tileSize 完整瓦片的大小
+ * @param tileLevel 瓦片层级
+ * @details 预览与完整瓦片占用同一个图形项和缓存项，不发出tileDisplayed，MiniMap只使用完整瓦片
+ */
+void TileManager::onTilePreviewLoaded(QPixmap* tile, unsigned int tileX, unsigned int tileY, unsigned int tileSize, unsigned int tileLevel) {
+    if (!tile) {
+        return;
+    }
+    if (!_layer || _layer->getTile(tileX, tileY, tileLevel) || providesCoverage(tileLevel, tileX, tileY) != 1) {
+        delete tile;
+        return;
+    }
+    PipelineTrace::ScopedEvent event("TileManager::onTilePreviewLoaded", tileX, tileY, tileLevel);
+    WSITileGraphicsItem* item = new WSITileGraphicsItem(NULL, tileX, tileY, tileSize, 0, tileLevel, _lastRenderLevel, _levelDownsamples, this,
+        NULL, NULL, _foregroundOpacity, _renderForeground);
+    item->setBackgroundPixmap(tile, true);
+    item->setPos(tileArea(tileX, tileY, tileSize, tileLevel).center());
+    _layer->addTile(item);
+    if (_cache) {
+        _cache->set(WSITileGraphicsItemCache::makeKey(tileX, tileY, tileLevel), item, item->getByteSize(), pinsTile(tileLevel));
+    }
+}
+
+/**
+ * @brief 判断加载瓦片时是否需要先显示预览
+ * @param level 层级
+ * @param tileX 瓦片X坐标
+ * @param tileY 瓦片Y坐标
+ * @return 是否需要预览
+ * @details 预览本身不算作已显示的粗层级瓦片
+ */
+bool TileManager::needsPreview(unsigned int level, int tileX, int tileY) {
+    if (!_progressiveDecoding || !_layer || level >= _levelDownsamples.size()) {
+        return false;
+    }
+    const double tileExtent = static_cast<double>(_levelDownsamples[level]) * getTileSize(level);
+    const double centerX = (tileX + 0.5) * tileExtent;
+    const double centerY = (tileY + 0.5) * tileExtent;
+    const double previewDownsample = static_cast<double>(_levelDownsamples[level]) * IOThread::kPreviewScale;
+    for (unsigned int coarser = level + 1; coarser < _levelDownsamples.size() && _levelDownsamples[coarser] <= previewDownsample; ++coarser) {
+        const double coarserExtent = static_cast<double>(_levelDownsamples[coarser]) * getTileSize(coarser);
+        WSITileGraphicsItem* tile = _layer->getTile(static_cast<unsigned int>(centerX / coarserExtent), static_cast<unsigned int>(centerY / coarserExtent), coarser);
+        if (tile && !tile->isPreview()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 计算瓦片在最低分辨率层级像素坐标中的区域
+ * @param tileX 瓦片X坐标
+ * @param tileY 瓦片Y坐标
+ * @param tileSize 瓦片大小
+ * @param tileLevel 瓦片层级
+ * @return 瓦片区域
+ */
+QRectF TileManager::tileArea(unsigned int tileX, unsigned int tileY, unsigned int tileSize, unsigned int tileLevel) const {
+    const float tileDownsample = _levelDownsamples[tileLevel];
+    const float maxDownsample = _levelDownsamples[_lastRenderLevel];
+    const float extent = tileSize * tileDownsample / maxDownsample;
+    return QRectF(tileX * extent, tileY * extent, extent, extent);
+}
+
+/**
+ * @brief 判断瓦片是否固定
+ * @param level 瓦片层级
+ * @return 是否固定
+ */
+bool TileManager::pinsTile(unsigned int level) const {
+    return level == _lastRenderLevel && !(_layer && _layer->hasOverview());
+}
+
+/**
+ * @brief 设置是否渐进解码
+ * @param enabled 是否开启
+ */
+void TileManager::setProgressiveDecoding(bool enabled) {
+    _progressiveDecoding = enabled;
+}
+
+/**
+ * @brief 设置瓦片图层最底层的缩略图
+ * @param overview 缩略图
+ * @details 按覆盖度网格遍历最后渲染层级，取消已加载瓦片的固定；前景缓存的固定方式不变
+ */
+void TileManager::setOverview(const QPixmap& overview) {
+    if (!_layer || _lastRenderLevel >= _levelDimensions.size()) {
+        return;
+    }
+    const std::vector<unsigned long long>& dimensions = _levelDimensions[_lastRenderLevel];
+    _layer->setOverview(overview, QRectF(0, 0, static_cast<qreal>(dimensions[0]), static_cast<qreal>(dimensions[1])));
+    if (!_cache) {
+        return;
+    }
+    const bool pinned = pinsTile(_lastRenderLevel);
+    const CoverageGrid& grid = _coverage[_lastRenderLevel];
+    for (int y = 0; y < grid.height; ++y) {
+        for (int x = 0; x < grid.width; ++x) {
+            if (_layer->getTile(x, y, _lastRenderLevel)) {
+                _cache->setPinned(WSITileGraphicsItemCache::makeKey(x, y, _lastRenderLevel), pinned);
+            }
+        }
+    }
+}
+
 /**
  * @brief 瓦片移除回调
  * @param tile 要移除的瓦片
- * @details 从场景中移除瓦片图形项，更新覆盖状态并删除对象
+ * @details 从瓦片图层中移除瓦片图形项，更新覆盖状态并删除对象
  */
 void TileManager::onTileRemoved(WSITileGraphicsItem* tile) {
-    _scene->removeItem(tile);
+    _foregroundCache->remove(WSITileGraphicsItemCache::makeKey(tile->getTileX(), tile->getTileY(), tile->getTileLevel()));
+    if (_layer) {
+        _layer->removeTile(tile);
+    }
     setCoverage(tile->getTileLevel(), tile->getTileX(), tile->getTileY(), 0);
     delete tile;
 }
 
+/**
+ * @brief 更新瓦片在缓存中的大小
+ * @param item 瓦片图形项
+ * @details 先在前景缓存中登记或更新前景字节数（可能立即释放该瓦片的前景），
+ *          再按实际内存占用更新瓦片缓存（可能淘汰该瓦片）
+ */
+void TileManager::updateCachedSize(WSITileGraphicsItem* item) {
+    if (!_cache) {
+        return;
+    }
+    WSITileGraphicsItemCache::keyType key = WSITileGraphicsItemCache::makeKey(item->getTileX(), item->getTileY(), item->getTileLevel());
+    _foregroundCache->setMaxCacheSize(static_cast<unsigned long long>(_cache->maxCacheSize() * kForegroundShare));
+    unsigned long long foregroundBytes = item->getForegroundByteSize();
+    if (foregroundBytes == 0) {
+        _foregroundCache->remove(key);
+    }
+    else if (!_foregroundCache->resize(key, foregroundBytes)) {
+        _foregroundCache->set(key, item, foregroundBytes, item->getTileLevel() == _lastRenderLevel);
+    }
+    _cache->resize(key, item->getByteSize());
+}
+
+/**
+ * @brief 前景被淘汰
+ * @param item 瓦片图形项
+ * @details 只释放前景，瓦片的背景和在瓦片缓存中的位置保持不变
+ */
+void TileManager::onForegroundEvicted(WSITileGraphicsItem* item) {
+    item->releaseForeground();
+    setCoverage(item->getTileLevel(), item->getTileX(), item->getTileY(), 0);
+    if (_cache) {
+        _cache->resize(WSITileGraphicsItemCache::makeKey(item->getTileX(), item->getTileY(), item->getTileLevel()), item->getByteSize());
+    }
+}
+
+/**
+ * @brief 获取缓存瓦片的前景数据源字节数
+ * @return 字节数
+ */
+unsigned long long TileManager::getForegroundSourceBytes() const {
+    unsigned long long bytes = 0;
+    for (WSITileGraphicsItem* item : _foregroundCache->getAllValues()) {
+        if (item->getForegroundTile()) {
+            bytes += item->getForegroundTile()->getByteSize();
+        }
+    }
+    return bytes;
+}
+
 /**
  * @brief 前景透明度改变回调
  * @param opacity 新的透明度值
@@ -322,26 +925,18 @@ void TileManager::setCoverageMapModeToVisited() {
  * @param tile_x 瓦片X坐标
  * @param tile_y 瓦片Y坐标
  * @return 覆盖状态（0=未覆盖，1=加载中，2=已覆盖）
- * @details 返回指定瓦片的覆盖状态，如果坐标为负数则检查整个层级
+ * @details 返回指定瓦片的覆盖状态，如果坐标为负数则按已覆盖计数检查整个层级
  */
 unsigned char TileManager::providesCoverage(unsigned int level, int tile_x, int tile_y) {
-    std::map<int, std::map<int, unsigned char> >& cover_level = _coverage[level];
-    if (cover_level.empty()) {
+    if (level >= _coverage.size()) {
         return 0;
     }
-
+    const CoverageGrid& grid = _coverage[level];
     if (tile_x < 0 || tile_y < 0) {
-        for (std::map<int, std::map<int, unsigned char> >::iterator it_x = cover_level.begin(); it_x != cover_level.end(); ++it_x) {
-            for (std::map<int, unsigned char>::iterator it_y = it_x->second.begin(); it_y != it_x->second.end(); ++it_y) {
-                if (it_y->second != 2) {
-                    return 0;
-                }
-            }
-        }
-        return 2;
+        unsigned long long nrTiles = static_cast<unsigned long long>(grid.width) * grid.height;
+        return nrTiles > 0 && grid.nrCovered == nrTiles ? 2 : 0;
     }
-
-    return cover_level[tile_x][tile_y];
+    return grid.get(tile_x, tile_y);
 }
 
 /**
@@ -350,7 +945,8 @@ unsigned char TileManager::providesCoverage(unsigned int level, int tile_x, int
  * @param tile_x 瓦片X坐标
  * @param tile_y 瓦片Y坐标
  * @return 是否被覆盖
- * @details 检查指定瓦片是否被覆盖，对于非0层级会检查下级瓦片的覆盖状态
+ * @details 检查指定瓦片是否被覆盖，对于非0层级会检查下级瓦片的覆盖状态；
+ *          两个层级的瓦片大小可能不同，按该瓦片在下级的范围求出下级瓦片的行列范围
  */
 bool TileManager::isCovered(unsigned int level, int tile_x, int tile_y) {
     if (level > 0) {
@@ -358,14 +954,21 @@ bool TileManager::isCovered(unsigned int level, int tile_x, int tile_y) {
             return providesCoverage(level) == 2;
         }
         else {
-            bool covered = true;
-            unsigned int downsample = _levelDownsamples[level] / _levelDownsamples[level - 1];
-            for (unsigned int x = 0; x < downsample; ++x) {
-                for (unsigned int y = 0; y < downsample; ++y) {
-                    covered &= providesCoverage(level - 1, downsample * tile_x + x, downsample * tile_y + y) == 2;
+            // 瓦片在下级像素坐标中的边长，除以下级瓦片大小即每个方向的下级瓦片数
+            const double extent = getTileSize(level) * (_levelDownsamples[level] / _levelDownsamples[level - 1]);
+            const double fineTileSize = getTileSize(level - 1);
+            const int firstX = static_cast<int>(std::floor(tile_x * extent / fineTileSize + 1e-3));
+            const int firstY = static_cast<int>(std::floor(tile_y * extent / fineTileSize + 1e-3));
+            const int lastX = static_cast<int>(std::ceil((tile_x + 1) * extent / fineTileSize - 1e-3)) - 1;
+            const int lastY = static_cast<int>(std::ceil((tile_y + 1) * extent / fineTileSize - 1e-3)) - 1;
+            for (int x = firstX; x <= lastX; ++x) {
+                for (int y = firstY; y <= lastY; ++y) {
+                    if (providesCoverage(level - 1, x, y) != 2) {
+                        return false;
+                    }
                 }
             }
-            return covered;
+            return true;
         }
     }
     else {
@@ -379,25 +982,20 @@ bool TileManager::isCovered(unsigned int level, int tile_x, int tile_y) {
  * @param tile_x 瓦片X坐标
  * @param tile_y 瓦片Y坐标
  * @param covers 覆盖状态
- * @details 设置指定瓦片的覆盖状态，并更新覆盖图路径
+ * @details 设置指定瓦片的覆盖状态，并以O(1)更新覆盖度地图中对应的像素
  */
 void TileManager::setCoverage(unsigned int level, int tile_x, int tile_y, unsigned char covers) {
-    _coverage[level][tile_x][tile_y] = covers;
-    if (_coverageMaps.empty()) {
-        _coverageMaps.resize(_lastRenderLevel + 1);
-    }
-    if (level != _lastRenderLevel) {
-        if (covers == 2 || covers == 0) {
-            float rectSize = _tileSize / (_levelDownsamples[_lastRenderLevel] / _levelDownsamples[level]);
-            QPainterPath rect;
-            rect.addRect(QRectF(tile_x * rectSize - 1, tile_y * rectSize - 1, rectSize + 1, rectSize + 1));
+    if (level < _coverage.size()) {
+        _coverage[level].set(tile_x, tile_y, covers);
+    }
+    if (level < _coverageMaps.size() && level != _lastRenderLevel) {
+        QImage& map = _coverageMaps[level];
+        if (map.valid(tile_x, tile_y)) {
             if (covers == 2) {
-                _coverageMaps[level] = _coverageMaps[level].united(rect);
+                map.setPixel(tile_x, tile_y, 1);
             }
-            else if (covers == 0) {
-                if (_coverageMapCacheMode) {
-                    _coverageMaps[level] = _coverageMaps[level].subtracted(rect);
-                }
+            else if (covers == 0 && _coverageMapCacheMode) {
+                map.setPixel(tile_x, tile_y, 0);
             }
         }
     }
@@ -405,36 +1003,80 @@ void TileManager::setCoverage(unsigned int level, int tile_x, int tile_y, unsign
 }
 
 /**
- * @brief 获取覆盖图路径
- * @return 覆盖图路径向量
- * @details 返回所有层级的覆盖图路径，用于可视化显示
+ * @brief 获取覆盖度地图
+ * @return 覆盖度地图向量
+ * @details 返回所有层级的覆盖度地图，用于可视化显示
  */
-std::vector<QPainterPath> TileManager::getCoverageMaps() {
+std::vector<QImage> TileManager::getCoverageMaps() {
     return _coverageMaps;
 }
 
+/**
+ * @brief 获取覆盖度地图像素的边长
+ * @param level 层级索引
+ * @return 最后渲染层级像素坐标下的瓦片边长
+ */
+float TileManager::getCoverageMapTileExtent(unsigned int level) const {
+    if (level >= _levelDownsamples.size() || _lastRenderLevel >= _levelDownsamples.size()) {
+        return 0.f;
+    }
+    return getTileSize(level) / (_levelDownsamples[_lastRenderLevel] / _levelDownsamples[level]);
+}
+
+/**
+ * @brief 获取瓦片大小
+ * @return 瓦片大小（像素）
+ */
+unsigned int TileManager::getTileSize() const {
+    return _tileSize;
+}
+
+/**
+ * @brief 获取指定层级的瓦片大小
+ * @param level 层级索引
+ * @return 瓦片大小（像素）
+ */
+unsigned int TileManager::getTileSize(unsigned int level) const {
+    if (_levelTileSizes.empty()) {
+        return _tileSize;
+    }
+    return _levelTileSizes[std::min<size_t>(level, _levelTileSizes.size() - 1)];
+}
+
+/**
+ * @brief 获取各层级的瓦片大小
+ * @return 按层级索引的瓦片大小
+ */
+const std::vector<unsigned int>& TileManager::getLevelTileSizes() const {
+    return _levelTileSizes;
+}
+
 /**
  * @brief 清空所有瓦片
- * @details 清空任务队列、缓存、场景中的所有瓦片，并重置覆盖状态
+ * @details 清空任务队列、缓存、瓦片图层中的所有瓦片，并重置覆盖状态
  */
 void TileManager::clear() {
     _ioThread->clearJobs();
-    while (_ioThread->getWaitingThreads() != _ioThread->getWorkers().size()) {
+    // 等待期间同时收拢已完成的结果，完成队列满时工作线程不会一直等待GUI线程
+    while (!_ioThread->isIdle()) {
+        _ioThread->flushTileDeliveries();
     }
+    // 已完成但尚未投递的结果先收拢，随后与其他瓦片一起清除
+    _ioThread->flushTileDeliveries();
     QCoreApplication::processEvents();
+    _foregroundCache->clear();
     if (_cache) {
         _cache->clear();
     }
-    QList<QGraphicsItem*> itms = _scene->items();
-    for (QList<QGraphicsItem*>::iterator it = itms.begin(); it != itms.end(); ++it) {
-        WSITileGraphicsItem* itm = dynamic_cast<WSITileGraphicsItem*>((*it));
-        if (itm) {
-            _scene->removeItem(itm);
-            delete itm;
-        }
+    if (_layer) {
+        _layer->clearTiles();
+    }
+    for (auto& grid : _coverage) {
+        grid.reset();
+    }
+    for (auto& map : _coverageMaps) {
+        map.fill(0);
     }
-    _coverage.clear();
-    _coverageMaps.clear();
     emit coverageUpdated();
 }
 
@@ -447,6 +1089,21 @@ void TileManager::refresh() {
     this->reloadLastFOV();
 }
 
+/**
+ * @brief 重新加载前景
+ * @details 背景像素图保持不变，重新请求的瓦片在onTileLoaded中只替换前景
+ */
+void TileManager::reloadForegrounds() {
+    if (_cache) {
+        for (WSITileGraphicsItem* item : _cache->getAllItems()) {
+            item->releaseForeground();
+            setCoverage(item->getTileLevel(), item->getTileX(), item->getTileY(), 0);
+            updateCachedSize(item);
+        }
+    }
+    this->reloadLastFOV();
+}
+
 /**
  * @brief 重新加载最后的视野范围
  * @details 保存当前的视野范围，清空后重新加载所有层级和指定视野范围的瓦片
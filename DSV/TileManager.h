@@ -24,10 +24,15 @@
 #include <QRect>
 #include <QGraphicsScene>
 #include <QPainterPath>
+#include <QPolygonF>
+#include <QImage>
+#include <QPixmap>
 #include <cmath>
+#include <vector>
 #include <QCoreApplication>
 #include <sstream>
 #include <QPointer>
+#include <memory>
 
  // 前向声明
 class IOThread;
@@ -35,6 +40,7 @@ class MultiResolutionImage;
 class ImageSource;
 class WSITileGraphicsItem;
 class WSITileGraphicsItemCache;
+class WSITileLayerItem;
 
 /**
  * @class  TileManager
@@ -72,12 +78,39 @@ private:
     /** @brief 各层级的图像尺寸数组，每个元素包含[宽度, 高度] */
     std::vector<std::vector<unsigned long long> > _levelDimensions;
 
-    /** @brief 瓦片大小（像素） */
+    /** @brief 最后渲染层级的瓦片大小（像素），图层边界按该大小留出边缘 */
     unsigned int _tileSize;
 
+    /** @brief 各层级的瓦片大小（像素） */
+    std::vector<unsigned int> _levelTileSizes;
+
+    /** @brief 对齐瓦片大小的下限，原生瓦片更小时取整数倍；也是按层级缩小瓦片的下限 */
+    static const unsigned int kMinAlignedTileSize = 128;
+
+    /** @brief 对齐瓦片大小的上限，原生瓦片更大时不对齐 */
+    static const unsigned int kMaxAlignedTileSize = 2048;
+
+    /** @brief 按层级放大瓦片的上限 */
+    static const unsigned int kMaxLevelTileSize = 1024;
+
+    /** @brief 降采样不小于该值的层级为粗层级，瓦片加倍 */
+    static const unsigned int kCoarseDownsample = 16;
+
+    /** @brief 降采样小于该值的层级为细层级，读取较慢时瓦片减半 */
+    static const unsigned int kFineDownsample = 4;
+
+    /** @brief 对齐大小的瓦片预计读取时间超过该值（毫秒）时视为慢速存储 */
+    static const unsigned int kSlowTileRead = 40;
+
+    /** @brief 合并IO任务每个方向最多包含的瓦片数 */
+    static const unsigned int kMaxBatchTiles = 4;
+
     /** @brief 最后一个视场（Field of View）的矩形区域 */
     QRect _lastFOV;
 
+    /** @brief 最后一个视场的视口多边形，矩形视场时为空 */
+    QPolygonF _lastViewport;
+
     /** @brief 最后一个请求的层级 */
     unsigned int _lastLevel;
 
@@ -85,11 +118,54 @@ private:
     unsigned int _lastRenderLevel;
 
     /**
-     * @brief 瓦片覆盖度映射表
-     * @details 三级映射：层级 -> X坐标 -> Y坐标 -> 覆盖度值
+     * @struct  CoverageGrid
+     * @brief   单个层级的稠密覆盖度网格
+     * @details 每个瓦片占2位（0未覆盖，1加载中，2已覆盖），按行优先紧密存放，
+     *          同时维护已覆盖瓦片计数，整层查询为O(1)。网格大小与getLevelTiles相同，
+     *          loadTilesForFieldOfView也只遍历这个范围内的瓦片，整层全部加载后才报告为已覆盖
+     */
+    struct CoverageGrid {
+        /** @brief 网格宽度（瓦片数） */
+        int width = 0;
+
+        /** @brief 网格高度（瓦片数） */
+        int height = 0;
+
+        /** @brief 2位覆盖度数组，每字节4个瓦片 */
+        std::vector<unsigned char> cells;
+
+        /** @brief 覆盖度为2的瓦片数 */
+        unsigned int nrCovered = 0;
+
+        /**
+         * @brief   按尺寸分配网格并清零
+         * @param   gridWidth 网格宽度
+         * @param   gridHeight 网格高度
+         */
+        void resize(int gridWidth, int gridHeight);
+
+        /** @brief 清零所有瓦片的覆盖度 */
+        void reset();
+
+        /**
+         * @brief   获取瓦片覆盖度
+         * @return  覆盖度，网格之外的坐标返回0
+         */
+        unsigned char get(int x, int y) const;
+
+        /**
+         * @brief   设置瓦片覆盖度并更新计数
+         * @note    网格之外的坐标被忽略
+         */
+        void set(int x, int y, unsigned char covers);
+    };
+
+    /**
+     * @brief 瓦片覆盖度网格
+     * @details 按层级索引，构造时按各层级的瓦片数分配，
      *          用于跟踪每个瓦片的加载和渲染状态
      */
-    std::map<unsigned int, std::map<int, std::map<int, unsigned char> > > _coverage;
+    std::vector<CoverageGrid> _coverage;
 
     /** @brief IO线程指针，用于异步瓦片加载 */
     QPointer<IOThread> _ioThread;
@@ -100,8 +176,18 @@ private:
     /** @brief Qt图形场景指针 */
     QPointer<QGraphicsScene> _scene;
 
-    /** @brief 覆盖度地图的绘制路径数组 */
-    std::vector<QPainterPath> _coverageMaps;
+    /**
+     * @brief 瓦片图层
+     * @details 场景中代表全部瓦片的唯一图形项，按层级网格索引并拥有已加载的瓦片
+     */
+    QPointer<WSITileLayerItem> _layer;
+
+    /**
+     * @brief 覆盖度地图
+     * @details 每层一幅1位图（QImage::Format_MonoLSB），一个像素对应一个瓦片，
+     *          与_coverage的网格尺寸相同；最后渲染层级不生成地图（空图像）
+     */
+    std::vector<QImage> _coverageMaps;
 
     /** @brief 覆盖度地图缓存模式标志 */
     bool _coverageMapCacheMode;
@@ -112,6 +198,78 @@ private:
     /** @brief 是否渲染前景瓦片标志 */
     bool _renderForeground;
 
+    /** @brief 是否为附近没有足够精细瓦片的加载任务请求预览 */
+    bool _progressiveDecoding;
+
+    /** @brief 前景的LRU缓存，淘汰时只释放瓦片图形项的前景 */
+    class ForegroundCache;
+
+    /**
+     * @brief 前景缓存
+     * @details 与_cache使用相同的键，记录带前景的瓦片和其前景字节数；
+     *          前景总量超过_cache上限的kForegroundShare时释放最久未使用瓦片的前景，背景瓦片留在_cache中
+     */
+    std::unique_ptr<ForegroundCache> _foregroundCache;
+
+    /** @brief 前景可占用的瓦片缓存比例 */
+    static const double kForegroundShare;
+
+    /**
+     * @brief   更新瓦片在缓存中的大小
+     * @details 背景或前景改变后调用，按瓦片的实际内存占用更新_cache，
+     *          并在_foregroundCache中登记、更新或移除其前景；调用后瓦片可能已被淘汰删除
+     * @param   item 瓦片图形项，必须已在_cache中
+     */
+    void updateCachedSize(WSITileGraphicsItem* item);
+
+    /**
+     * @brief   为视场内缺失的瓦片排队加载任务
+     * @param   FOV 视场外接矩形（第0层像素坐标）
+     * @param   viewport 实际视口多边形（第0层像素坐标），为空表示整个FOV
+     * @param   level 层级索引
+     * @param   batchMissing 视场内已有瓦片时也合并缺失的相邻瓦片
+     * @details 视口多边形按瓦片行光栅化，只有与多边形相交的瓦片参与加载
+     * @see     loadTilesForFieldOfView
+     */
+    void loadTiles(const QRectF& FOV, const QPolygonF& viewport, const unsigned int level, bool batchMissing);
+
+    /**
+     * @brief   判断加载瓦片时是否需要先显示预览
+     * @param   level 层级索引
+     * @param   tileX 瓦片X坐标
+     * @param   tileY 瓦片Y坐标
+     * @return  开启渐进解码，且瓦片中心处降采样不超过预览kPreviewScale倍的较粗层级都没有完整瓦片时返回true
+     * @details 平移时上一级瓦片通常已显示，比1/kPreviewScale的预览更清晰，不再请求预览；
+     *          跳转到未加载过的区域时只有最低分辨率层级，预览明显更清晰
+     * @see     IOThread::kPreviewScale
+     */
+    bool needsPreview(unsigned int level, int tileX, int tileY);
+
+    /**
+     * @brief   计算瓦片在最低分辨率层级像素坐标中的区域
+     * @param   tileX 瓦片X坐标
+     * @param   tileY 瓦片Y坐标
+     * @param   tileSize 瓦片大小
+     * @param   tileLevel 瓦片层级
+     * @return  瓦片区域，中心即瓦片图形项的位置
+     */
+    QRectF tileArea(unsigned int tileX, unsigned int tileY, unsigned int tileSize, unsigned int tileLevel) const;
+
+    /**
+     * @brief   判断瓦片是否以固定项加入缓存
+     * @param   level 瓦片层级
+     * @return  最后渲染层级的瓦片在图层没有缩略图时固定，有缩略图时与其他层级一样可以被淘汰
+     */
+    bool pinsTile(unsigned int level) const;
+
+    /**
+     * @brief   前景被淘汰
+     * @details 释放瓦片的前景并更新其缓存大小，覆盖度置为0，
+     *          瓦片再次进入视野时重新加载并只恢复前景
+     * @param   item 被淘汰前景的瓦片图形项
+     */
+    void onForegroundEvicted(WSITileGraphicsItem* item);
+
     /**
      * @brief   将像素坐标转换为瓦片坐标
      * @details 根据指定的层级将像素坐标转换为对应的瓦片坐标
@@ -160,6 +318,14 @@ signals:
      */
     void coverageUpdated();
 
+    /**
+     * @brief   瓦片显示信号
+     * @param   tile 新显示的背景瓦片
+     * @param   area 瓦片在最低分辨率层级像素坐标中的区域
+     * @details 新瓦片加入场景时发出，MiniMap据此逐步提高缩略图的清晰度
+     */
+    void tileDisplayed(const QPixmap& tile, const QRectF& area);
+
 public:
     /**
      * @brief   构造函数
@@ -176,6 +342,20 @@ public:
      */
     TileManager(std::shared_ptr<MultiResolutionImage> img, unsigned int tileSize, unsigned int lastRenderLevel, IOThread* renderThread, WSITileGraphicsItemCache* _cache, QGraphicsScene* scene);
 
+    /**
+     * @brief   构造函数
+     * @details 每个层级使用各自的瓦片大小，覆盖度网格、任务和图形项都按所在层级的大小划分
+     *
+     * @param   img 多分辨率图像对象的共享指针
+     * @param   levelTileSizes 各层级的瓦片大小（像素），缺少的层级使用最后一个值
+     * @param   lastRenderLevel 最后渲染层级
+     * @param   renderThread IO渲染线程指针
+     * @param   _cache 瓦片图形项缓存指针
+     * @param   scene Qt图形场景指针
+     * @see     levelTileSizes
+     */
+    TileManager(std::shared_ptr<MultiResolutionImage> img, const std::vector<unsigned int>& levelTileSizes, unsigned int lastRenderLevel, IOThread* renderThread, WSITileGraphicsItemCache* _cache, QGraphicsScene* scene);
+
     /**
      * @brief   析构函数
      * @details 清理瓦片管理器资源，包括瓦片缓存和IO线程
@@ -183,35 +363,109 @@ public:
      */
     ~TileManager();
 
+    /**
+     * @brief   选择与原生瓦片网格对齐的瓦片大小
+     * @details 各层级的原生瓦片为相同的正方形时采用原生瓦片尺寸，
+     *          过小的原生瓦片取其不小于kMinAlignedTileSize的最小整数倍，
+     *          使每个瓦片任务恰好对应一个（或整数个）压缩瓦片，不必拼接相邻瓦片。
+     *          原生瓦片未知、非正方形、各层级不一致或过大时返回preferred
+     *
+     * @param   img 多分辨率图像对象
+     * @param   preferred 首选瓦片大小
+     * @return  瓦片大小（像素）
+     * @see     MultiResolutionImage::getLevelTileSize
+     */
+    static unsigned int alignedTileSize(const std::shared_ptr<MultiResolutionImage>& img, unsigned int preferred);
+
+    /**
+     * @brief   为每个层级选择瓦片大小
+     * @details 各层级从alignedTileSize出发：
+     *          - 比最后渲染层级细、降采样不小于kCoarseDownsample的粗层级加倍（不超过kMaxLevelTileSize），
+     *            同一视场的图形项和IO任务减为四分之一
+     *          - 降采样小于kFineDownsample的细层级在读取较慢（对齐大小的瓦片预计超过kSlowTileRead毫秒）时减半，
+     *            首个瓦片更早显示；减半后仍须是该层级原生瓦片的整数倍且不小于kMinAlignedTileSize
+     *          最后渲染层级保持对齐大小，与SlideLoader::getOverviewLevel和缩略图一致。
+     *          层级按逻辑像素选择，每屏的瓦片数与设备像素比无关，因此不参与选择
+     *
+     * @param   img 多分辨率图像对象
+     * @param   preferred 首选瓦片大小
+     * @param   lastRenderLevel 最后渲染层级
+     * @param   readLatency 每百万像素的读取时间（毫秒），0表示未知，见MultiResolutionImage::getReadLatency
+     * @return  各层级的瓦片大小（像素）
+     */
+    static std::vector<unsigned int> levelTileSizes(const std::shared_ptr<MultiResolutionImage>& img, unsigned int preferred,
+        unsigned int lastRenderLevel, double readLatency);
+
     /**
      * @brief   加载指定层级的所有瓦片
      * @details 预加载指定层级的所有瓦片，用于全图预览或离线处理
      *
      * @param   level 要加载的层级索引
-     * @note    该操作会消耗大量内存，请谨慎使用
+     * @note    该操作会消耗大量内存，请谨慎使用；缺失的相邻瓦片合并为IOThread::addBatchJob任务
      * @see     loadTilesForFieldOfView
      */
     void loadAllTilesForLevel(unsigned int level);
 
     /**
      * @brief   加载指定视场的瓦片
-     * @details 根据视场矩形和层级加载相应的瓦片，实现视场相关的瓦片调度
+     * @details 根据视场矩形和层级加载相应的瓦片，实现视场相关的瓦片调度。
+     *          冷加载（视场内该层级还没有任何瓦片）或batchMissing为true时，按kMaxBatchTiles x kMaxBatchTiles分块，
+     *          整块缺失的瓦片合并为一个IOThread::addBatchJob任务，由一次区域读取加载；其余瓦片逐个排队
      *
      * @param   FOV 视场矩形（像素坐标）
      * @param   level 层级索引
+     * @param   batchMissing 视场内已有瓦片时也合并缺失的相邻瓦片
      * @note    该函数会智能调度瓦片加载，优先加载视场内的瓦片
      * @see     loadAllTilesForLevel, reloadLastFOV
      */
-    void loadTilesForFieldOfView(const QRectF& FOV, const unsigned int level);
+    void loadTilesForFieldOfView(const QRectF& FOV, const unsigned int level, bool batchMissing = false);
+
+    /**
+     * @brief   按实际视口多边形加载瓦片
+     * @details 视图旋转后视口在第0层坐标中是斜置的四边形，其外接矩形在45°时约为视口面积的两倍。
+     *          多边形按该层级的瓦片行逐行光栅化，只请求与多边形相交的瓦片；
+     *          剔除排队任务仍按外接矩形进行，其余规则与矩形视场相同
+     *
+     * @param   viewport 视口多边形（第0层像素坐标），通常为mapToScene(rect())换算到第0层坐标的结果
+     * @param   level 层级索引
+     * @see     loadTilesForFieldOfView(const QRectF&, const unsigned int, bool)
+     */
+    void loadTilesForFieldOfView(const QPolygonF& viewport, const unsigned int level);
+
+    /**
+     * @brief   请求加载单个瓦片
+     * @details 瓦片尚未覆盖时标记为加载中并排队IO任务，用于按保存的瓦片列表恢复上次的视场
+     *
+     * @param   level 层级索引，高于最后渲染层级时忽略
+     * @param   tileX 瓦片列号
+     * @param   tileY 瓦片行号
+     * @see     PathologyViewer::initialize, ViewerSnapshot
+     */
+    void loadTile(unsigned int level, int tileX, int tileY);
 
     /**
      * @brief   更新瓦片前景
-     * @details 更新所有已加载瓦片的前景渲染，应用当前的透明度设置
-     * @note    该函数会遍历所有瓦片并更新其前景显示
-     * @see     onForegroundOpacityChanged
+     * @details 为所有已加载瓦片提交当前渲染代的前景渲染任务，立即返回。
+     *          过期的渲染任务由工作线程跳过，过期的结果在onForegroundTileRendered中丢弃
+     * @note    应在IOThread的前景设置（LUT、通道、前景图像）改变之后调用
+     * @see     onForegroundOpacityChanged, IOThread::getRenderGeneration
      */
     void updateTileForegounds();
 
+    /**
+     * @brief   更新瓦片背景
+     * @details 为所有已加载瓦片提交当前背景渲染代的重新合成任务，立即返回。
+     *          瓦片在新结果到达前保持旧的背景，不会闪烁；原始数据通常命中解码瓦片缓存。
+     *          任务按与视场中心的距离排序，可见瓦片先处理
+     * @param   residentOnly 为true时只处理原始数据仍在内存缓存中的瓦片，其余瓦片保留当前背景，
+     *          用于只改变后处理参数（增强）的场合，不读取图像
+     * @note    应在IOThread的背景设置（通道合成、背景通道、Z平面）改变之后调用。
+     *          覆盖状态只对应显示的Z平面：切换平面时覆盖状态不变，瓦片在新平面的背景到达前显示原平面，
+     *          排队中的加载任务由工作线程改为读取新平面
+     * @see     onBackgroundTileRendered, IOThread::getBackgroundGeneration, IOThread::setZPlane
+     */
+    void updateTileBackgrounds(bool residentOnly = false);
+
     /**
      * @brief   重置指定层级的覆盖度
      * @details 清除指定层级的所有瓦片覆盖度信息
@@ -229,8 +483,8 @@ public:
      * @param   level 层级索引
      * @param   tile_x 瓦片X坐标，-1表示查询整个层级
      * @param   tile_y 瓦片Y坐标，-1表示查询整个层级
-     * @return  覆盖度值，0表示未覆盖，255表示完全覆盖
-     * @note    该函数用于查询瓦片的加载和渲染状态
+     * @return  覆盖度值，0表示未覆盖，1表示加载中，2表示已覆盖；查询整个层级时所有瓦片都已覆盖才返回2
+     * @note    单个瓦片和整个层级的查询都是O(1)
      * @see     setCoverage, isCovered
      */
     unsigned char providesCoverage(unsigned int level, int tile_x = -1, int tile_y = -1);
@@ -263,13 +517,42 @@ public:
 
     /**
      * @brief   获取覆盖度地图
-     * @details 获取所有层级的覆盖度地图绘制路径，用于可视化显示
+     * @details 获取所有层级的覆盖度地图，用于可视化显示
      *
-     * @return  覆盖度地图的绘制路径数组
-     * @note    返回的路径可以用于在UI中绘制覆盖度可视化
-     * @see     setCoverageMapModeToCache, setCoverageMapModeToVisited
+     * @return  覆盖度地图数组，按层级索引；像素索引1表示该瓦片已覆盖
+     * @note    QImage隐式共享，返回副本不复制像素数据；
+     *          每个像素在最后渲染层级坐标下的边长由getCoverageMapTileExtent给出
+     * @see     setCoverageMapModeToCache, setCoverageMapModeToVisited, getCoverageMapTileExtent
+     */
+    std::vector<QImage> getCoverageMaps();
+
+    /**
+     * @brief   获取覆盖度地图像素的边长
+     * @param   level 层级索引
+     * @return  该层级一个瓦片在最后渲染层级像素坐标下的边长，层级无效时返回0
+     * @see     getCoverageMaps
+     */
+    float getCoverageMapTileExtent(unsigned int level) const;
+
+    /**
+     * @brief   获取最后渲染层级的瓦片大小
+     * @return  瓦片大小（像素）
      */
-    std::vector<QPainterPath> getCoverageMaps();
+    unsigned int getTileSize() const;
+
+    /**
+     * @brief   获取指定层级的瓦片大小
+     * @param   level 层级索引，超出范围时使用最后一个层级
+     * @return  瓦片大小（像素）
+     */
+    unsigned int getTileSize(unsigned int level) const;
+
+    /**
+     * @brief   获取各层级的瓦片大小
+     * @return  按层级索引的瓦片大小
+     * @note    预取线程使用同一瓦片网格，以便命中解码瓦片缓存
+     */
+    const std::vector<unsigned int>& getLevelTileSizes() const;
 
     /**
      * @brief   设置覆盖度地图模式为缓存模式
@@ -287,6 +570,27 @@ public:
      */
     void setCoverageMapModeToVisited();
 
+    /**
+     * @brief   设置是否渐进解码
+     * @details 开启后，附近没有足够精细瓦片的加载任务先投递缩小解码的预览并立即显示，
+     *          完整解码到达后就地替换预览的像素图；调用者需把IOThread::tilePreviewLoaded连接到onTilePreviewLoaded。
+     *          默认关闭
+     * @param   enabled 是否开启
+     * @see     needsPreview, onTilePreviewLoaded
+     */
+    void setProgressiveDecoding(bool enabled);
+
+    /**
+     * @brief   设置瓦片图层最底层的缩略图
+     * @details 缩略图缩放到最后渲染层级的范围，绘制在所有瓦片之下。
+     *          设置后已加载的最后渲染层级瓦片取消固定，之后加载的也不再固定，
+     *          它们仍按需加载并显示，但内存压力下可以被淘汰，淘汰后由缩略图覆盖；
+     *          为空时（如非RGB图像没有缩略图）保持原来的固定方式
+     * @param   overview 整幅图像的缩略图，通常与小地图共享同一个像素图
+     * @see     WSITileLayerItem::setOverview, MiniMap::setOverview
+     */
+    void setOverview(const QPixmap& overview);
+
     /**
      * @brief   清空所有瓦片
      * @details 清空所有已加载的瓦片和缓存，释放内存
@@ -303,6 +607,15 @@ public:
      */
     void refresh();
 
+    /**
+     * @brief   重新加载前景
+     * @details 前景图像改变后调用。释放所有缓存瓦片的前景并把它们标记为未覆盖，然后重新加载最后一个视场；
+     *          已在场景中的瓦片保留背景，只替换前景，其余瓦片在下次进入视野时重新加载。
+     *          前景数据由IOThread的前景瓦片缓存提供，切换回已经显示过的前景图像时无需重新读取
+     * @see     refresh, OverlayTileCache
+     */
+    void reloadForegrounds();
+
     /**
      * @brief   重新加载最后一个视场
      * @details 重新加载最后一个请求的视场瓦片
@@ -311,6 +624,14 @@ public:
      */
     void reloadLastFOV();
 
+    /**
+     * @brief   获取缓存瓦片的前景数据源字节数
+     * @details 前景数据源的缓冲区来自TileBufferPool，这部分同时计入了瓦片缓存的大小，
+     *          供MemoryGovernor避免重复扣除
+     * @return  字节数
+     */
+    unsigned long long getForegroundSourceBytes() const;
+
 public slots:
     /**
      * @brief   前景瓦片渲染完成槽函数
@@ -320,9 +641,22 @@ public slots:
      * @param   tileX 瓦片X坐标
      * @param   tileY 瓦片Y坐标
      * @param   tileLevel 瓦片层级
+     * @param   renderGeneration 渲染所用设置的渲染代，与当前代不符时丢弃结果
      * @note    该槽函数由IO线程调用，用于通知渲染完成
      */
-    void onForegroundTileRendered(QPixmap* tile, unsigned int tileX, unsigned int tileY, unsigned int tileLevel);
+    void onForegroundTileRendered(QPixmap* tile, unsigned int tileX, unsigned int tileY, unsigned int tileLevel, unsigned int renderGeneration);
+
+    /**
+     * @brief   背景瓦片重新合成完成槽函数
+     * @details 将新的背景替换到对应的瓦片图形项中
+     * @param   tile 重新渲染的背景瓦片像素图
+     * @param   tileX 瓦片X坐标
+     * @param   tileY 瓦片Y坐标
+     * @param   tileLevel 瓦片层级
+     * @param   backgroundGeneration 渲染所用设置的背景渲染代，与当前代不符时丢弃结果
+     * @note    该槽函数由IO线程调用
+     */
+    void onBackgroundTileRendered(QPixmap* tile, unsigned int tileX, unsigned int tileY, unsigned int tileLevel, unsigned int backgroundGeneration);
 
     /**
      * @brief   瓦片加载完成槽函数
@@ -332,13 +666,28 @@ public slots:
      * @param   tileX 瓦片X坐标
      * @param   tileY 瓦片Y坐标
      * @param   tileSize 瓦片大小
-     * @param   tileByteSize 瓦片字节大小
+     * @param   tileByteSize 瓦片解码数据的字节大小，缓存按瓦片图形项的实际内存占用计费
      * @param   tileLevel 瓦片层级
      * @param   foregroundTile 前景瓦片图像源
      * @param   foregroundPixmap 前景瓦片像素图
+     * @param   renderGeneration 渲染foregroundPixmap所用设置的渲染代，过期时重新提交渲染任务
+     * @param   backgroundGeneration 渲染tile所用设置的背景渲染代，过期时重新提交背景合成任务
      * @note    该槽函数由IO线程调用，用于通知加载完成
      */
-    void onTileLoaded(QPixmap* tile, unsigned int tileX, unsigned int tileY, unsigned int tileSize, unsigned int tileByteSize, unsigned int tileLevel, ImageSource* foregroundTile, QPixmap* foregroundPixmap);
+    void onTileLoaded(QPixmap* tile, unsigned int tileX, unsigned int tileY, unsigned int tileSize, unsigned int tileByteSize, unsigned int tileLevel, ImageSource* foregroundTile, QPixmap* foregroundPixmap, unsigned int renderGeneration, unsigned int backgroundGeneration);
+
+    /**
+     * @brief   瓦片预览加载完成槽函数
+     * @details 该瓦片仍在加载且尚未显示时，以预览像素图创建瓦片图形项加入图层和缓存，覆盖度保持为加载中；
+     *          否则（完整瓦片已显示或任务已被取消）丢弃预览
+     * @param   tile 预览像素图，所有权转移给瓦片管理器
+     * @param   tileX 瓦片X坐标
+     * @param   tileY 瓦片Y坐标
+     * @param   tileSize 完整瓦片的大小
+     * @param   tileLevel 瓦片层级
+     * @see     onTileLoaded, IOThread::tilePreviewLoaded
+     */
+    void onTilePreviewLoaded(QPixmap* tile, unsigned int tileX, unsigned int tileY, unsigned int tileSize, unsigned int tileLevel);
 
     /**
      * @brief   瓦片移除槽函数
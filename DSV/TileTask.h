@@ -0,0 +1,46 @@
+﻿/**
+ * @file    TileTask.h
+ * @brief   瓦片任务接口，由IO线程池逐个处理瓦片的后台任务
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 区域分析、区域导出等需要处理大量瓦片的后台任务实现该接口，
+ *          由IOThread::addTileTask投放到工作线程
+ * @see     IOThread, TileTaskJob, RegionAnalysis, RegionExport
+ */
+
+#pragma once
+
+/**
+ * @class  TileTask
+ * @brief  瓦片任务接口
+ * @details 任务自己维护瓦片顺序：工作线程每次调用processNextTile领取并处理下一个瓦片。
+ *          IOThread只为一个任务保持少量TileTaskJob，处理完一个瓦片后重新投放，
+ *          因此任务的瓦片数不影响队列长度，瓦片也按任务决定的顺序完成。
+ *
+ * @note    实现必须是线程安全的，多个工作线程同时调用processNextTile
+ */
+class TileTask
+{
+public:
+    virtual ~TileTask() {}
+
+    /**
+     * @brief   领取并处理下一个瓦片
+     * @return  处理了一个瓦片时返回true；没有剩余瓦片时返回false
+     * @details 取消后领取的瓦片直接计为完成，最后一个瓦片完成时任务发出完成通知
+     */
+    virtual bool processNextTile() = 0;
+
+    /**
+     * @brief   取消任务
+     * @details 尚未领取的瓦片仍需通过processNextTile逐个计为完成
+     */
+    virtual void cancel() = 0;
+
+    /**
+     * @brief   获取瓦片总数
+     * @return  瓦片数
+     */
+    virtual unsigned int getNumberOfTiles() const = 0;
+};
@@ -0,0 +1,1116 @@
+﻿/**
+ * @file TiledTiffImage.cpp
+ * @brief 分块TIFF/SVS图像实现文件
+ * @details 该文件实现了直接读取分块TIFF的功能，包括：
+ *          - 经典TIFF和BigTIFF的IFD解析
+ *          - JPEG、JPEG 2000、LZW、Deflate和未压缩瓦片的解码
+ *          - Aperio描述信息的解析
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "TiledTiffImage.h"
+#include "AsyncFileReader.h"
+#include "PipelineProfiler.h"
+#include "TileBufferPool.h"
+#include "openslide/openslide.h"
+#include <QBuffer>
+#include <QByteArray>
+#include <QFile>
+#include <QImageReader>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <shared_mutex>
+#include <sstream>
+
+namespace {
+
+    /** @brief 解析时使用的TIFF标签 */
+    enum TiffTag {
+        NewSubfileType = 254,
+        ImageWidth = 256,
+        ImageLength = 257,
+        BitsPerSample = 258,
+        Compression = 259,
+        PhotometricInterpretation = 262,
+        ImageDescription = 270,
+        StripOffsets = 273,
+        SamplesPerPixel = 277,
+        RowsPerStrip = 278,
+        StripByteCounts = 279,
+        XResolution = 282,
+        YResolution = 283,
+        PlanarConfiguration = 284,
+        ResolutionUnit = 296,
+        Predictor = 317,
+        TileWidth = 322,
+        TileLength = 323,
+        TileOffsets = 324,
+        TileByteCounts = 325,
+        JPEGTables = 347,
+        InterColorProfile = 34675
+    };
+
+    /** @brief 支持的压缩方式 */
+    enum TiffCompression {
+        CompressionNone = 1,
+        CompressionLZW = 5,
+        CompressionJPEG = 7,
+        CompressionAdobeDeflate = 8,
+        CompressionDeflate = 32946,
+        CompressionAperioJ2KYCbCr = 33003,
+        CompressionAperioJ2KRGB = 33005,
+        CompressionJPEG2000 = 34712
+    };
+
+    /**
+     * @brief 检查Qt是否提供JPEG 2000图像插件
+     * @return 有jp2插件时返回true，结果只查询一次
+     * @details Qt 5.15默认不带jp2插件，没有插件时JPEG 2000切片交给OpenSlide读取
+     */
+    bool hasJpeg2000Plugin() {
+        static const bool available = QImageReader::supportedImageFormats().contains("jp2");
+        return available;
+    }
+
+    /** @brief 单个目录的最大条目数，超出时视为损坏 */
+    const unsigned long long kMaxEntries = 4096;
+
+    /** @brief IFD链的最大长度，防止循环链 */
+    const unsigned int kMaxDirectories = 1024;
+
+    /**
+     * @brief 内存中的TIFF文件
+     * @details 所有读取都做越界检查，越界时返回0并置ok为false
+     */
+    struct TiffStream {
+        const unsigned char* data;
+        unsigned long long size;
+        bool bigEndian;
+        bool bigTiff;
+        mutable bool ok;
+
+        unsigned long long read(unsigned long long offset, unsigned int bytes) const {
+            if (offset > size || bytes > size - offset) {
+                ok = false;
+                return 0;
+            }
+            unsigned long long value = 0;
+            for (unsigned int i = 0; i < bytes; ++i) {
+                unsigned int shift = bigEndian ? (bytes - 1 - i) * 8 : i * 8;
+                value |= static_cast<unsigned long long>(data[offset + i]) << shift;
+            }
+            return value;
+        }
+
+        unsigned long long readOffset(unsigned long long offset) const {
+            return read(offset, bigTiff ? 8 : 4);
+        }
+    };
+
+    /**
+     * @brief 获取字段类型的字节数
+     * @return 字节数，未知类型返回0
+     */
+    unsigned int typeSize(unsigned int type) {
+        switch (type) {
+        case 1: case 2: case 6: case 7: return 1;
+        case 3: case 8: return 2;
+        case 4: case 9: case 11: case 13: return 4;
+        case 5: case 10: case 12: case 16: case 17: case 18: return 8;
+        default: return 0;
+        }
+    }
+
+    /**
+     * @brief 读取整数字段的第index个值
+     */
+    unsigned long long readInteger(const TiffStream& stream, unsigned int type, unsigned long long position, unsigned long long index) {
+        unsigned int bytes = typeSize(type);
+        if (type == 5 || type == 10 || type == 11 || type == 12 || bytes == 0) {
+            return 0;
+        }
+        return stream.read(position + index * bytes, bytes);
+    }
+
+    /**
+     * @brief 检查文件头
+     * @param stream 文件，成功时设置字节序和BigTIFF标志
+     * @param firstDirectory 第一个IFD的偏移
+     * @return 文件头为TIFF或BigTIFF时返回true
+     */
+    bool readHeader(TiffStream& stream, unsigned long long& firstDirectory) {
+        if (stream.size < 16) {
+            return false;
+        }
+        if (stream.data[0] == 'I' && stream.data[1] == 'I') {
+            stream.bigEndian = false;
+        }
+        else if (stream.data[0] == 'M' && stream.data[1] == 'M') {
+            stream.bigEndian = true;
+        }
+        else {
+            return false;
+        }
+        unsigned long long version = stream.read(2, 2);
+        if (version == 42) {
+            stream.bigTiff = false;
+            firstDirectory = stream.read(4, 4);
+        }
+        else if (version == 43 && stream.read(4, 2) == 8) {
+            stream.bigTiff = true;
+            firstDirectory = stream.read(8, 8);
+        }
+        else {
+            return false;
+        }
+        return stream.ok;
+    }
+
+    /**
+     * @brief 解析一个IFD
+     * @param stream 文件
+     * @param offset IFD偏移
+     * @param directory 输出的目录
+     * @param next 下一个IFD的偏移，0表示链结束
+     * @param loadArrays 是否读取瓦片偏移、字节数、JPEG表和ICC配置文件
+     * @return 解析成功时返回true
+     */
+    bool readDirectory(const TiffStream& stream, unsigned long long offset, TiledTiffImage::Directory& directory, unsigned long long& next, bool loadArrays) {
+        const unsigned int entrySize = stream.bigTiff ? 20 : 12;
+        const unsigned int valueSize = stream.bigTiff ? 8 : 4;
+        const unsigned long long count = stream.bigTiff ? stream.read(offset, 8) : stream.read(offset, 2);
+        if (!stream.ok || count == 0 || count > kMaxEntries) {
+            return false;
+        }
+        const unsigned long long entries = offset + (stream.bigTiff ? 8 : 2);
+        bool stripped = false;
+        unsigned long long rowsPerStrip = 0;
+        for (unsigned long long i = 0; i < count; ++i) {
+            const unsigned long long entry = entries + i * entrySize;
+            const unsigned int tag = static_cast<unsigned int>(stream.read(entry, 2));
+            const unsigned int type = static_cast<unsigned int>(stream.read(entry + 2, 2));
+            const unsigned long long n = stream.bigTiff ? stream.read(entry + 4, 8) : stream.read(entry + 4, 4);
+            const unsigned int bytes = typeSize(type);
+            if (!stream.ok) {
+                return false;
+            }
+            if (bytes == 0 || n == 0 || n > stream.size / bytes) {
+                continue;
+            }
+            // 值不超过valueSize字节时直接存放在条目中，否则条目中为值的偏移
+            const unsigned long long valuePosition = n * bytes <= valueSize ? entry + (stream.bigTiff ? 12 : 8) : stream.readOffset(entry + (stream.bigTiff ? 12 : 8));
+            switch (tag) {
+            case NewSubfileType: directory.subfileType = static_cast<unsigned int>(readInteger(stream, type, valuePosition, 0)); break;
+            case ImageWidth: directory.width = readInteger(stream, type, valuePosition, 0); break;
+            case ImageLength: directory.height = readInteger(stream, type, valuePosition, 0); break;
+            case BitsPerSample: directory.bitsPerSample = static_cast<unsigned int>(readInteger(stream, type, valuePosition, 0)); break;
+            case Compression: directory.compression = static_cast<unsigned int>(readInteger(stream, type, valuePosition, 0)); break;
+            case PhotometricInterpretation: directory.photometric = static_cast<unsigned int>(readInteger(stream, type, valuePosition, 0)); break;
+            case SamplesPerPixel: directory.samplesPerPixel = static_cast<unsigned int>(readInteger(stream, type, valuePosition, 0)); break;
+            case RowsPerStrip: rowsPerStrip = readInteger(stream, type, valuePosition, 0); break;
+            case PlanarConfiguration: directory.planarConfiguration = static_cast<unsigned int>(readInteger(stream, type, valuePosition, 0)); break;
+            case ResolutionUnit: directory.resolutionUnit = static_cast<unsigned int>(readInteger(stream, type, valuePosition, 0)); break;
+            case Predictor: directory.predictor = static_cast<unsigned int>(readInteger(stream, type, valuePosition, 0)); break;
+            case TileWidth: directory.chunkWidth = static_cast<unsigned int>(readInteger(stream, type, valuePosition, 0)); directory.tiled = true; break;
+            case TileLength: directory.chunkHeight = static_cast<unsigned int>(readInteger(stream, type, valuePosition, 0)); break;
+            case XResolution:
+            case YResolution:
+                if (type == 5) {
+                    double denominator = static_cast<double>(stream.read(valuePosition + 4, 4));
+                    double resolution = denominator > 0. ? stream.read(valuePosition, 4) / denominator : 0.;
+                    (tag == XResolution ? directory.xResolution : directory.yResolution) = resolution;
+                }
+                break;
+            case ImageDescription:
+                if (type == 2 && valuePosition <= stream.size && n <= stream.size - valuePosition) {
+                    directory.description.assign(reinterpret_cast<const char*>(stream.data + valuePosition), static_cast<size_t>(n));
+                    directory.description.erase(std::find(directory.description.begin(), directory.description.end(), '\0'), directory.description.end());
+                }
+                break;
+            case StripOffsets:
+            case TileOffsets:
+                stripped = stripped || tag == StripOffsets;
+                if (loadArrays) {
+                    directory.offsets.resize(static_cast<size_t>(n));
+                    for (unsigned long long k = 0; k < n; ++k) {
+                        directory.offsets[k] = readInteger(stream, type, valuePosition, k);
+                    }
+                }
+                break;
+            case StripByteCounts:
+            case TileByteCounts:
+                if (loadArrays) {
+                    directory.byteCounts.resize(static_cast<size_t>(n));
+                    for (unsigned long long k = 0; k < n; ++k) {
+                        directory.byteCounts[k] = readInteger(stream, type, valuePosition, k);
+                    }
+                }
+                break;
+            case JPEGTables:
+                if (loadArrays && (type == 7 || type == 1) && valuePosition <= stream.size && n <= stream.size - valuePosition) {
+                    directory.jpegTables.assign(stream.data + valuePosition, stream.data + valuePosition + n);
+                }
+                break;
+            case InterColorProfile:
+                if (loadArrays && (type == 7 || type == 1) && valuePosition <= stream.size && n <= stream.size - valuePosition) {
+                    directory.iccProfile.assign(stream.data + valuePosition, stream.data + valuePosition + n);
+                }
+                break;
+            default:
+                break;
+            }
+            if (!stream.ok) {
+                return false;
+            }
+        }
+        if (!directory.tiled && stripped) {
+            directory.chunkWidth = static_cast<unsigned int>(directory.width);
+            directory.chunkHeight = static_cast<unsigned int>(rowsPerStrip == 0 || rowsPerStrip > directory.height ? directory.height : rowsPerStrip);
+        }
+        next = stream.readOffset(entries + count * entrySize);
+        return stream.ok;
+    }
+
+    /**
+     * @brief 解析IFD链
+     * @param data 文件数据
+     * @param size 文件大小
+     * @param directories 输出的目录
+     * @param loadArrays 是否读取瓦片偏移、字节数和JPEG表
+     * @return 文件头有效且至少解析出一个目录时返回true
+     */
+    bool readDirectories(const unsigned char* data, unsigned long long size, std::vector<TiledTiffImage::Directory>& directories, bool loadArrays) {
+        TiffStream stream = { data, size, false, false, true };
+        unsigned long long offset = 0;
+        if (!readHeader(stream, offset)) {
+            return false;
+        }
+        while (offset != 0 && directories.size() < kMaxDirectories) {
+            TiledTiffImage::Directory directory;
+            unsigned long long next = 0;
+            if (!readDirectory(stream, offset, directory, next, loadArrays)) {
+                break;
+            }
+            directories.push_back(directory);
+            // 只排除指向自身的循环，更长的循环由kMaxDirectories限制
+            offset = next == offset ? 0 : next;
+        }
+        return !directories.empty();
+    }
+
+    /**
+     * @brief 解码TIFF LZW数据
+     * @param input 压缩数据
+     * @param length 压缩数据长度
+     * @param output 输出缓冲区，预先分配为期望的解压大小
+     * @return 输出已填满或遇到EOI时返回true
+     * @details TIFF LZW为高位在前，码长在表满前一项时增加（early change）
+     */
+    bool decodeLZW(const unsigned char* input, unsigned long long length, std::vector<unsigned char>& output) {
+        const unsigned int clearCode = 256;
+        const unsigned int endCode = 257;
+        std::vector<std::pair<int, unsigned char> > table(4096);  // 前缀码和末字节
+        std::vector<unsigned char> string;
+        unsigned int nextCode = 258;
+        unsigned int codeLength = 9;
+        int previous = -1;
+        unsigned long long bitPosition = 0;
+        size_t written = 0;
+        auto expand = [&table, &string](int code) {
+            string.clear();
+            while (code >= 258) {
+                string.push_back(table[code].second);
+                code = table[code].first;
+            }
+            string.push_back(static_cast<unsigned char>(code));
+            std::reverse(string.begin(), string.end());
+        };
+        while ((bitPosition + codeLength) <= length * 8 && written < output.size()) {
+            unsigned int code = 0;
+            for (unsigned int i = 0; i < codeLength; ++i, ++bitPosition) {
+                code = (code << 1) | ((input[bitPosition >> 3] >> (7 - (bitPosition & 7))) & 1);
+            }
+            if (code == endCode) {
+                break;
+            }
+            if (code == clearCode) {
+                nextCode = 258;
+                codeLength = 9;
+                previous = -1;
+                continue;
+            }
+            if (previous < 0) {
+                if (code > 255) {
+                    return false;
+                }
+                string.assign(1, static_cast<unsigned char>(code));
+            }
+            else if (code < nextCode) {
+                expand(static_cast<int>(code));
+                if (nextCode < 4096) {
+                    table[nextCode++] = std::make_pair(previous, string[0]);
+                }
+            }
+            else if (code == nextCode) {
+                expand(previous);
+                string.push_back(string[0]);
+                if (nextCode < 4096) {
+                    table[nextCode++] = std::make_pair(previous, string[0]);
+                }
+            }
+            else {
+                return false;
+            }
+            size_t copy = std::min(string.size(), output.size() - written);
+            std::memcpy(output.data() + written, string.data(), copy);
+            written += copy;
+            previous = static_cast<int>(code);
+            if (nextCode + 1 >= (1u << codeLength) && codeLength < 12) {
+                ++codeLength;
+            }
+        }
+        return written == output.size();
+    }
+
+    /**
+     * @brief 把YCbCr像素原地转换为RGB
+     * @param image QImage::Format_RGB32图像，红绿蓝分量中存放Y、Cb、Cr
+     * @details 使用JFIF的全范围BT.601系数
+     */
+    void convertYCbCrToRGB(QImage& image) {
+        for (int y = 0; y < image.height(); ++y) {
+            QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+            for (int x = 0; x < image.width(); ++x) {
+                const double luma = qRed(line[x]);
+                const double cb = qGreen(line[x]) - 128.;
+                const double cr = qBlue(line[x]) - 128.;
+                const int r = static_cast<int>(std::lround(luma + 1.402 * cr));
+                const int g = static_cast<int>(std::lround(luma - 0.344136 * cb - 0.714136 * cr));
+                const int b = static_cast<int>(std::lround(luma + 1.772 * cb));
+                line[x] = qRgb(std::min(std::max(r, 0), 255), std::min(std::max(g, 0), 255), std::min(std::max(b, 0), 255));
+            }
+        }
+    }
+
+    /**
+     * @brief 解析Aperio描述
+     * @param description ImageDescription，首行之后为"|"分隔的"键 = 值"
+     * @param properties 输出的aperio.*属性
+     */
+    void parseAperioDescription(const std::string& description, std::vector<SlideColorManagement::PropertyInfo>& properties) {
+        std::stringstream stream(description);
+        std::string field;
+        bool first = true;
+        while (std::getline(stream, field, '|')) {
+            if (first) {
+                first = false;
+                continue;
+            }
+            size_t equal = field.find(" = ");
+            if (equal == std::string::npos) {
+                continue;
+            }
+            const std::string key = field.substr(0, equal);
+            const std::string value = field.substr(equal + 3);
+            char* end = NULL;
+            double numeric = std::strtod(value.c_str(), &end);
+            if (!value.empty() && end && *end == '\0') {
+                properties.emplace_back("aperio." + key, true, numeric);
+            }
+            else {
+                properties.emplace_back("aperio." + key, false, 0.0, value);
+            }
+        }
+    }
+}
+
+/**
+ * @brief 构造函数：初始化TIFF图像对象
+ */
+TiledTiffImage::TiledTiffImage()
+    : MultiResolutionImage(),
+    _data(NULL),
+    _size(0)
+{
+}
+
+/**
+ * @brief 析构函数：解除文件映射
+ */
+TiledTiffImage::~TiledTiffImage()
+{
+    std::unique_lock<std::shared_mutex> l(*_openCloseMutex);
+    cleanup();
+    MultiResolutionImage::cleanup();
+}
+
+/**
+ * @brief 检查目录的压缩和像素格式是否可以解码
+ * @param directory 目录
+ * @return 8位、1或3通道、交错存储且压缩方式受支持时返回true，JPEG 2000还要求有Qt的jp2插件
+ */
+bool TiledTiffImage::isDecodable(const Directory& directory)
+{
+    if (directory.width == 0 || directory.height == 0 || directory.chunkWidth == 0 || directory.chunkHeight == 0 ||
+        directory.bitsPerSample != 8 || (directory.samplesPerPixel != 1 && directory.samplesPerPixel != 3) ||
+        (directory.planarConfiguration != 1 && directory.samplesPerPixel != 1)) {
+        return false;
+    }
+    switch (directory.compression) {
+    case CompressionJPEG:
+        return true;
+    case CompressionAperioJ2KYCbCr:
+    case CompressionAperioJ2KRGB:
+    case CompressionJPEG2000:
+        return hasJpeg2000Plugin();
+    case CompressionNone:
+    case CompressionLZW:
+    case CompressionAdobeDeflate:
+    case CompressionDeflate:
+        // 未压缩的YCbCr为子采样布局，不支持
+        return directory.photometric <= 2 && directory.predictor <= 2;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief 检查文件是否可以直接读取
+ * @param fileName 文件路径
+ * @return 可以读取时返回true
+ * @details 其他厂商的TIFF变体有各自的瓦片布局，交给OpenSlide读取
+ */
+bool TiledTiffImage::canReadFile(const std::string& fileName)
+{
+    const char* vendor = openslide_detect_vendor(fileName.c_str());
+    if (!vendor || (std::strcmp(vendor, "aperio") != 0 && std::strcmp(vendor, "generic-tiff") != 0)) {
+        return false;
+    }
+    QFile file(QString::fromStdString(fileName));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const unsigned long long size = static_cast<unsigned long long>(file.size());
+    const unsigned char* data = file.map(0, file.size());
+    if (!data) {
+        return false;
+    }
+    std::vector<Directory> directories;
+    bool readable = readDirectories(data, size, directories, false);
+    file.unmap(const_cast<unsigned char*>(data));
+    if (!readable) {
+        return false;
+    }
+    auto base = std::find_if(directories.begin(), directories.end(), [](const Directory& directory) { return directory.tiled; });
+    return base != directories.end() && isDecodable(*base);
+}
+
+/**
+ * @brief 初始化TIFF图像
+ * @param imagePath 图像文件路径
+ * @return 初始化是否成功
+ * @details 第一个分块目录为第0层，之后宽度递减且宽高比与第0层一致（误差2%以内）的
+ *          可解码分块目录依次作为层级
+ */
+bool TiledTiffImage::initializeType(const std::string& imagePath)
+{
+    std::unique_lock<std::shared_mutex> l(*_openCloseMutex);
+    cleanup();
+
+    _file.reset(new QFile(QString::fromStdString(imagePath)));
+    if (!_file->open(QIODevice::ReadOnly)) {
+        _isValid = false;
+        return false;
+    }
+    _size = static_cast<unsigned long long>(_file->size());
+    _data = _file->map(0, _file->size());
+    _reader.reset(new AsyncFileReader());
+    if (!_reader->open(imagePath)) {
+        _reader.reset();
+    }
+    std::vector<Directory> directories;
+    if (!_data || !readDirectories(_data, _size, directories, true)) {
+        _isValid = false;
+        return false;
+    }
+
+    for (const Directory& directory : directories) {
+        const unsigned long long nrChunks = ((directory.width + directory.chunkWidth - 1) / std::max(directory.chunkWidth, 1u)) *
+            ((directory.height + directory.chunkHeight - 1) / std::max(directory.chunkHeight, 1u));
+        if (!isDecodable(directory) || directory.offsets.size() != nrChunks || directory.byteCounts.size() != nrChunks) {
+            continue;
+        }
+        if (directory.tiled) {
+            if (!_levels.empty()) {
+                const Directory& base = _levels[0];
+                const double aspect = static_cast<double>(base.width) / base.height;
+                const double levelAspect = static_cast<double>(directory.width) / directory.height;
+                if (directory.width >= _levels.back().width || std::abs(levelAspect - aspect) > 0.02 * aspect) {
+                    continue;
+                }
+            }
+            _levels.push_back(directory);
+        }
+        else if (_label.chunkWidth == 0 && directory.description.find("label") != std::string::npos) {
+            _label = directory;
+        }
+    }
+    if (_levels.empty()) {
+        _isValid = false;
+        return false;
+    }
+
+    for (const Directory& level : _levels) {
+        std::vector<unsigned long long> dims;
+        dims.push_back(level.width);
+        dims.push_back(level.height);
+        _levelDimensions.push_back(dims);
+        std::vector<unsigned long long> tileSize;
+        tileSize.push_back(level.chunkWidth);
+        tileSize.push_back(level.chunkHeight);
+        _levelTileSizes.push_back(tileSize);
+    }
+    _numberOfLevels = static_cast<unsigned int>(_levels.size());
+    _dataType = SlideColorManagement::DataType::UChar;
+    _samplesPerPixel = 3;
+    _colorType = SlideColorManagement::ColorType::RGB;
+
+    const Directory& base = _levels[0];
+    const bool aperio = base.description.compare(0, 6, "Aperio") == 0;
+    _fileType = aperio ? "aperio" : "generic-tiff";
+    if (!base.description.empty()) {
+        _properties.emplace_back("tiff.ImageDescription", false, 0.0, base.description);
+    }
+    if (aperio) {
+        parseAperioDescription(base.description, _properties);
+    }
+    double mppX = 0., mppY = 0.;
+    for (const auto& property : _properties) {
+        if (property.name == "aperio.MPP" && property.isNumeric) {
+            mppX = mppY = property.numericValue;
+        }
+    }
+    if (mppX <= 0. && base.xResolution > 0. && base.yResolution > 0. && (base.resolutionUnit == 2 || base.resolutionUnit == 3)) {
+        // 分辨率单位为每英寸或每厘米的像素数
+        const double micronsPerUnit = base.resolutionUnit == 2 ? 25400. : 10000.;
+        mppX = micronsPerUnit / base.xResolution;
+        mppY = micronsPerUnit / base.yResolution;
+    }
+    if (mppX > 0. && mppY > 0.) {
+        _spacing.push_back(mppX);
+        _spacing.push_back(mppY);
+    }
+    _properties.emplace_back("openslide.level-count", true, static_cast<double>(_numberOfLevels));
+    _properties.emplace_back("openslide.level[0].width", true, static_cast<double>(base.width));
+    _properties.emplace_back("openslide.level[0].height", true, static_cast<double>(base.height));
+    if (!_spacing.empty()) {
+        _properties.emplace_back("openslide.mpp-x", true, _spacing[0]);
+        _properties.emplace_back("openslide.mpp-y", true, _spacing[1]);
+    }
+
+    _isValid = true;
+    return _isValid;
+}
+
+/**
+ * @brief 清理资源
+ * @details 解除文件映射并清空层级、标签和属性
+ */
+void TiledTiffImage::cleanup()
+{
+    if (_file && _data) {
+        _file->unmap(const_cast<unsigned char*>(_data));
+    }
+    _file.reset();
+    _reader.reset();
+    _data = NULL;
+    _size = 0;
+    _levels.clear();
+    _label = Directory();
+    _levelDimensions.clear();
+    _levelTileSizes.clear();
+    _spacing.clear();
+    _properties.clear();
+}
+
+/**
+ * @brief 解码一个瓦片或条带
+ * @param directory 目录
+ * @param index 瓦片或条带序号
+ * @param image 输出图像
+ * @return 是否解码成功
+ * @details 从映射的文件中取出压缩数据后由decodeChunkData解码
+ */
+bool TiledTiffImage::decodeChunk(const Directory& directory, unsigned long long index, QImage& image) const
+{
+    if (index >= directory.offsets.size()) {
+        return false;
+    }
+    const unsigned long long offset = directory.offsets[index];
+    const unsigned long long length = directory.byteCounts[index];
+    if (length == 0 || offset > _size || length > _size - offset) {
+        // 字节数为0的瓦片为稀疏存储中缺失的瓦片
+        return false;
+    }
+    return decodeChunkData(directory, index, _data + offset, length, image);
+}
+
+/**
+ * @brief 解码已读入内存的瓦片或条带
+ * @param directory 目录
+ * @param index 瓦片或条带序号
+ * @param chunk 压缩数据
+ * @param length 压缩数据字节数
+ * @param image 输出图像
+ * @return 是否解码成功
+ * @details JPEG处理两种变体：
+ *          - 仅表JPEG：JPEGTables去掉EOI后与去掉SOI的瓦片数据拼接
+ *          - Photometric为RGB的JPEG（Aperio常见）：在SOI后插入transform为0的Adobe APP14段，
+ *            阻止解码器按YCbCr转换
+ *          Aperio 33003的JPEG 2000码流为YCbCr，解码后转换为RGB
+ */
+bool TiledTiffImage::decodeChunkData(const Directory& directory, unsigned long long index, const unsigned char* chunk,
+    unsigned long long length, QImage& image) const
+{
+    const unsigned long long chunksAcross = (directory.width + directory.chunkWidth - 1) / directory.chunkWidth;
+    const unsigned long long row = index / chunksAcross;
+    // 条带的最后一条可能不足RowsPerStrip行
+    const unsigned int rows = directory.tiled ? directory.chunkHeight :
+        static_cast<unsigned int>(std::min<unsigned long long>(directory.chunkHeight, directory.height - row * directory.chunkHeight));
+
+    if (directory.compression == CompressionJPEG) {
+        if (!image.loadFromData(jpegStream(directory, chunk, length), "JPEG")) {
+            return false;
+        }
+    }
+    else if (directory.compression == CompressionAperioJ2KYCbCr || directory.compression == CompressionAperioJ2KRGB ||
+        directory.compression == CompressionJPEG2000) {
+        if (!image.loadFromData(chunk, static_cast<int>(length))) {
+            return false;
+        }
+        image = image.convertToFormat(QImage::Format_RGB32);
+        if (directory.compression == CompressionAperioJ2KYCbCr || (directory.compression == CompressionJPEG2000 && directory.photometric == 6)) {
+            convertYCbCrToRGB(image);
+        }
+    }
+    else {
+        const unsigned int samples = directory.samplesPerPixel;
+        const size_t rowBytes = static_cast<size_t>(directory.chunkWidth) * samples;
+        std::vector<unsigned char> raw(rowBytes * rows);
+        if (directory.compression == CompressionNone) {
+            if (length < raw.size()) {
+                return false;
+            }
+            std::memcpy(raw.data(), chunk, raw.size());
+        }
+        else if (directory.compression == CompressionLZW) {
+            if (!decodeLZW(chunk, length, raw)) {
+                return false;
+            }
+        }
+        else {
+            // zlib流，按qUncompress的格式在前面加上大端的解压大小
+            QByteArray compressed;
+            const unsigned int expected = static_cast<unsigned int>(raw.size());
+            compressed.append(static_cast<char>((expected >> 24) & 0xff));
+            compressed.append(static_cast<char>((expected >> 16) & 0xff));
+            compressed.append(static_cast<char>((expected >> 8) & 0xff));
+            compressed.append(static_cast<char>(expected & 0xff));
+            compressed.append(reinterpret_cast<const char*>(chunk), static_cast<int>(length));
+            QByteArray inflated = qUncompress(compressed);
+            if (static_cast<size_t>(inflated.size()) < raw.size()) {
+                return false;
+            }
+            std::memcpy(raw.data(), inflated.constData(), raw.size());
+        }
+        if (directory.predictor == 2) {
+            for (unsigned int y = 0; y < rows; ++y) {
+                unsigned char* line = raw.data() + y * rowBytes;
+                for (size_t i = samples; i < rowBytes; ++i) {
+                    line[i] = static_cast<unsigned char>(line[i] + line[i - samples]);
+                }
+            }
+        }
+        image = QImage(directory.chunkWidth, rows, QImage::Format_RGB32);
+        const unsigned char invert = directory.photometric == 0 ? 255 : 0;
+        for (unsigned int y = 0; y < rows; ++y) {
+            const unsigned char* source = raw.data() + y * rowBytes;
+            QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+            for (unsigned int x = 0; x < directory.chunkWidth; ++x) {
+                if (samples == 3) {
+                    line[x] = qRgb(source[x * 3], source[x * 3 + 1], source[x * 3 + 2]);
+                }
+                else {
+                    const unsigned char gray = source[x] ^ invert;
+                    line[x] = qRgb(gray, gray, gray);
+                }
+            }
+        }
+    }
+
+    if (image.format() != QImage::Format_RGB32) {
+        image = image.convertToFormat(QImage::Format_RGB32);
+    }
+    return static_cast<unsigned int>(image.width()) >= directory.chunkWidth && static_cast<unsigned int>(image.height()) >= rows;
+}
+
+/**
+ * @brief 组装可以独立解码的JPEG码流
+ * @param directory 目录
+ * @param chunk 瓦片数据
+ * @param length 瓦片数据字节数
+ * @return JPEG码流
+ * @details 仅表JPEG：JPEGTables去掉EOI后与去掉SOI的瓦片数据拼接；
+ *          Photometric为RGB时在SOI后插入transform为0的Adobe APP14段
+ */
+QByteArray TiledTiffImage::jpegStream(const Directory& directory, const unsigned char* chunk, unsigned long long length)
+{
+    QByteArray stream;
+    if (directory.jpegTables.size() >= 4 && length >= 2) {
+        stream.append(reinterpret_cast<const char*>(directory.jpegTables.data()), static_cast<int>(directory.jpegTables.size() - 2));
+        stream.append(reinterpret_cast<const char*>(chunk + 2), static_cast<int>(length - 2));
+    }
+    else {
+        stream.append(reinterpret_cast<const char*>(chunk), static_cast<int>(length));
+    }
+    if (directory.photometric == 2 && stream.size() >= 2) {
+        static const char adobe[] = { '\xFF', '\xEE', 0, 14, 'A', 'd', 'o', 'b', 'e', 0, 100, 0, 0, 0, 0, 0 };
+        stream.insert(2, adobe, sizeof(adobe));
+    }
+    return stream;
+}
+
+/**
+ * @brief 缩小解码一个JPEG瓦片
+ * @param directory 目录
+ * @param index 瓦片序号
+ * @param scale 缩小倍数
+ * @param image 输出图像
+ * @return 是否解码成功
+ * @details QImageReader的缩放大小传给JPEG解码器的scale_denom，缩小在反DCT中完成，不先解码完整瓦片
+ */
+bool TiledTiffImage::decodeChunkPreview(const Directory& directory, unsigned long long index, unsigned int scale, QImage& image) const
+{
+    if (index >= directory.offsets.size()) {
+        return false;
+    }
+    const unsigned long long offset = directory.offsets[index];
+    const unsigned long long length = directory.byteCounts[index];
+    if (length == 0 || offset > _size || length > _size - offset) {
+        return false;
+    }
+    QByteArray stream = jpegStream(directory, _data + offset, length);
+    QBuffer buffer(&stream);
+    QImageReader reader(&buffer, "JPEG");
+    reader.setScaledSize(QSize(directory.chunkWidth / scale, directory.chunkHeight / scale));
+    if (!reader.read(&image)) {
+        return false;
+    }
+    if (image.format() != QImage::Format_RGB32) {
+        image = image.convertToFormat(QImage::Format_RGB32);
+    }
+    return true;
+}
+
+/**
+ * @brief 读取层级区域
+ * @param startX 起始X坐标（第0层坐标）
+ * @param startY 起始Y坐标（第0层坐标）
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 层级
+ * @param rgb RGB输出缓冲区，可为NULL
+ * @param argb ARGB32输出缓冲区，可为NULL
+ * @details 输出缓冲区预先填充为白色，只覆盖成功解码的瓦片。
+ *          相交的瓦片多于一个时通过AsyncFileReader一次发出全部读请求，按完成顺序解码；
+ *          只有一个瓦片或读取器不可用时直接从映射的文件解码
+ */
+void TiledTiffImage::decodeRegion(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level, unsigned char* rgb, unsigned int* argb) const
+{
+    const Directory& directory = _levels[level];
+    const double downsample = static_cast<double>(_levelDimensions[0][0]) / _levelDimensions[level][0];
+    const long long levelX = std::llround(startX / downsample);
+    const long long levelY = std::llround(startY / downsample);
+    const long long x0 = std::max(levelX, 0LL);
+    const long long y0 = std::max(levelY, 0LL);
+    const long long x1 = std::min(levelX + static_cast<long long>(width), static_cast<long long>(directory.width));
+    const long long y1 = std::min(levelY + static_cast<long long>(height), static_cast<long long>(directory.height));
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    const long long chunkWidth = directory.chunkWidth;
+    const long long chunkHeight = directory.chunkHeight;
+    const long long chunksAcross = (static_cast<long long>(directory.width) + chunkWidth - 1) / chunkWidth;
+    auto copyChunk = [&](unsigned long long index, const QImage& chunk) {
+        const long long chunkX = static_cast<long long>(index % chunksAcross) * chunkWidth;
+        const long long chunkY = static_cast<long long>(index / chunksAcross) * chunkHeight;
+        const long long copyX0 = std::max(x0, chunkX);
+        const long long copyX1 = std::min(x1, chunkX + chunkWidth);
+        const long long copyY0 = std::max(y0, chunkY);
+        const long long copyY1 = std::min(y1, chunkY + chunkHeight);
+        for (long long y = copyY0; y < copyY1; ++y) {
+            const QRgb* source = reinterpret_cast<const QRgb*>(chunk.constScanLine(static_cast<int>(y - chunkY))) + (copyX0 - chunkX);
+            const long long destination = (y - levelY) * static_cast<long long>(width) + (copyX0 - levelX);
+            if (argb) {
+                std::memcpy(argb + destination, source, static_cast<size_t>(copyX1 - copyX0) * sizeof(unsigned int));
+            }
+            else {
+                unsigned char* target = rgb + destination * 3;
+                for (long long x = 0; x < copyX1 - copyX0; ++x) {
+                    target[x * 3] = static_cast<unsigned char>(qRed(source[x]));
+                    target[x * 3 + 1] = static_cast<unsigned char>(qGreen(source[x]));
+                    target[x * 3 + 2] = static_cast<unsigned char>(qBlue(source[x]));
+                }
+            }
+        }
+    };
+
+    std::vector<unsigned long long> indices;
+    for (long long row = y0 / chunkHeight; row <= (y1 - 1) / chunkHeight; ++row) {
+        for (long long column = x0 / chunkWidth; column <= (x1 - 1) / chunkWidth; ++column) {
+            indices.push_back(static_cast<unsigned long long>(row * chunksAcross + column));
+        }
+    }
+
+    QImage chunk;
+    if (indices.size() > 1 && _reader) {
+        std::vector<AsyncFileReader::Request> requests;
+        std::vector<unsigned long long> requestChunks;
+        for (unsigned long long index : indices) {
+            if (index >= directory.offsets.size()) {
+                continue;
+            }
+            const unsigned long long offset = directory.offsets[index];
+            const unsigned long long length = directory.byteCounts[index];
+            if (length == 0 || offset > _size || length > _size - offset) {
+                continue;
+            }
+            AsyncFileReader::Request request = { offset, length };
+            requests.push_back(request);
+            requestChunks.push_back(index);
+        }
+        if (_reader->read(requests, [&](size_t request, const unsigned char* data, unsigned long long length) {
+                if (decodeChunkData(directory, requestChunks[request], data, length, chunk)) {
+                    copyChunk(requestChunks[request], chunk);
+                }
+            })) {
+            return;
+        }
+    }
+    for (unsigned long long index : indices) {
+        if (decodeChunk(directory, index, chunk)) {
+            copyChunk(index, chunk);
+        }
+    }
+}
+
+/**
+ * @brief 读取区域数据
+ * @param startX 起始X坐标（第0层坐标）
+ * @param startY 起始Y坐标（第0层坐标）
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @return RGB数据，图像无效时返回NULL
+ */
+void* TiledTiffImage::readDataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level)
+{
+    unsigned char* rgb = TileBufferPool::allocateArray<unsigned char>(width * height * 3);
+    if (!readDataIntoBuffer(startX, startY, width, height, level, rgb, m_currentZPlaneIndex)) {
+        TileBufferPool::release(rgb);
+        return NULL;
+    }
+    return rgb;
+}
+
+/**
+ * @brief 把区域数据解码到调用者的缓冲区
+ * @param startX 起始X坐标（第0层坐标）
+ * @param startY 起始Y坐标（第0层坐标）
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @param data 输出缓冲区，width*height*3字节
+ * @param zPlane Z平面索引，单平面格式忽略
+ * @return 图像有效时返回true
+ */
+bool TiledTiffImage::readDataIntoBuffer(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level, void* data, const unsigned int& zPlane)
+{
+    if (!_isValid || level >= _levels.size()) {
+        return false;
+    }
+
+    PipelineProfiler::ScopedTimer timer(PipelineProfiler::ReadDataFromImage, PipelineProfiler::ReadTiledTiff);
+    std::shared_lock<std::shared_mutex> l(*_openCloseMutex);
+    unsigned char* rgb = static_cast<unsigned char*>(data);
+    std::fill(rgb, rgb + width * height * 3, 255);
+    decodeRegion(startX, startY, width, height, level, rgb, NULL);
+    return true;
+}
+
+/**
+ * @brief 直接读取ARGB32数据
+ * @param startX 起始X坐标（第0层坐标）
+ * @param startY 起始Y坐标（第0层坐标）
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @param data 输出缓冲区
+ * @param zPlane Z平面索引，单平面格式忽略
+ * @return 图像有效时返回true
+ */
+bool TiledTiffImage::readARGB32DataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level, unsigned int* data, const unsigned int& zPlane)
+{
+    if (!_isValid || level >= _levels.size()) {
+        return false;
+    }
+
+    PipelineProfiler::ScopedTimer timer(PipelineProfiler::ReadDataFromImage, PipelineProfiler::ReadTiledTiff);
+    std::shared_lock<std::shared_mutex> l(*_openCloseMutex);
+    std::fill(data, data + width * height, 0xFFFFFFFF);
+    decodeRegion(startX, startY, width, height, level, NULL, data);
+    return true;
+}
+
+/**
+ * @brief 缩小解码ARGB32预览
+ * @param startX 起始X坐标（第0层坐标）
+ * @param startY 起始Y坐标（第0层坐标）
+ * @param width 区域宽度
+ * @param height 区域高度
+ * @param level 图像层级
+ * @param scale 缩小倍数
+ * @param data 输出缓冲区，(width / scale) x (height / scale)个像素
+ * @param zPlane Z平面索引，单平面格式忽略
+ * @return 已写入预览时返回true
+ * @details 与decodeRegion相同逐个瓦片复制重叠部分，坐标除以scale；
+ *          区域起点需落在scale的倍数上，预览像素与瓦片像素一一对应
+ */
+bool TiledTiffImage::readPreviewARGB32DataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+    const unsigned long long& height, const unsigned int& level, unsigned int scale, unsigned int* data, const unsigned int& zPlane)
+{
+    if (!_isValid || level >= _levels.size() || scale == 0) {
+        return false;
+    }
+    const Directory& directory = _levels[level];
+    if (directory.compression != CompressionJPEG || !directory.tiled || directory.chunkWidth % scale != 0 || directory.chunkHeight % scale != 0) {
+        return false;
+    }
+    const double downsample = static_cast<double>(_levelDimensions[0][0]) / _levelDimensions[level][0];
+    const long long levelX = std::llround(startX / downsample);
+    const long long levelY = std::llround(startY / downsample);
+    if (levelX < 0 || levelY < 0 || levelX % scale != 0 || levelY % scale != 0) {
+        return false;
+    }
+
+    std::shared_lock<std::shared_mutex> l(*_openCloseMutex);
+    const long long previewWidth = static_cast<long long>(width / scale);
+    const long long previewHeight = static_cast<long long>(height / scale);
+    std::fill(data, data + previewWidth * previewHeight, 0xFFFFFFFF);
+    const long long x1 = std::min(levelX + static_cast<long long>(width), static_cast<long long>(directory.width));
+    const long long y1 = std::min(levelY + static_cast<long long>(height), static_cast<long long>(directory.height));
+    if (levelX >= x1 || levelY >= y1) {
+        return true;
+    }
+
+    const long long chunkWidth = directory.chunkWidth;
+    const long long chunkHeight = directory.chunkHeight;
+    const long long chunksAcross = (static_cast<long long>(directory.width) + chunkWidth - 1) / chunkWidth;
+    QImage chunk;
+    for (long long row = levelY / chunkHeight; row <= (y1 - 1) / chunkHeight; ++row) {
+        for (long long column = levelX / chunkWidth; column <= (x1 - 1) / chunkWidth; ++column) {
+            if (!decodeChunkPreview(directory, static_cast<unsigned long long>(row * chunksAcross + column), scale, chunk)) {
+                continue;
+            }
+            const long long chunkX = column * chunkWidth;
+            const long long chunkY = row * chunkHeight;
+            const long long copyX0 = std::max(levelX, chunkX);
+            const long long copyY0 = std::max(levelY, chunkY);
+            const long long columns = std::min<long long>((std::min(x1, chunkX + chunkWidth) - copyX0 + scale - 1) / scale,
+                std::min<long long>(chunk.width() - (copyX0 - chunkX) / scale, previewWidth - (copyX0 - levelX) / scale));
+            const long long rows = std::min<long long>((std::min(y1, chunkY + chunkHeight) - copyY0 + scale - 1) / scale,
+                std::min<long long>(chunk.height() - (copyY0 - chunkY) / scale, previewHeight - (copyY0 - levelY) / scale));
+            for (long long y = 0; y < rows; ++y) {
+                const QRgb* source = reinterpret_cast<const QRgb*>(chunk.constScanLine(static_cast<int>((copyY0 - chunkY) / scale + y))) + (copyX0 - chunkX) / scale;
+                unsigned int* target = data + ((copyY0 - levelY) / scale + y) * previewWidth + (copyX0 - levelX) / scale;
+                std::memcpy(target, source, static_cast<size_t>(std::max(0LL, columns)) * sizeof(unsigned int));
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 获取属性
+ * @param propertyName 属性名称
+ * @return 属性值字符串
+ */
+std::string TiledTiffImage::getProperty(const std::string& propertyName)
+{
+    for (const auto& property : _properties) {
+        if (property.name == propertyName) {
+            return property.isNumeric ? std::to_string(property.numericValue) : property.stringValue;
+        }
+    }
+    return std::string();
+}
+
+/**
+ * @brief 获取标签图
+ * @return 标签目录的全部条带拼接成的图像
+ */
+const QImage TiledTiffImage::getLabel()
+{
+    std::shared_lock<std::shared_mutex> l(*_openCloseMutex);
+    if (!_isValid || _label.chunkWidth == 0) {
+        return QImage();
+    }
+    QImage label(static_cast<int>(_label.width), static_cast<int>(_label.height), QImage::Format_RGB32);
+    label.fill(Qt::white);
+    const unsigned long long chunksAcross = (_label.width + _label.chunkWidth - 1) / _label.chunkWidth;
+    QImage chunk;
+    for (unsigned long long index = 0; index < _label.offsets.size(); ++index) {
+        if (!decodeChunk(_label, index, chunk)) {
+            continue;
+        }
+        const unsigned long long chunkX = (index % chunksAcross) * _label.chunkWidth;
+        const unsigned long long chunkY = (index / chunksAcross) * _label.chunkHeight;
+        const int copyWidth = static_cast<int>(std::min<unsigned long long>(_label.chunkWidth, _label.width - chunkX));
+        const int copyHeight = static_cast<int>(std::min<unsigned long long>(_label.chunkHeight, _label.height - chunkY));
+        for (int y = 0; y < copyHeight; ++y) {
+            std::memcpy(label.scanLine(static_cast<int>(chunkY) + y) + chunkX * 4, chunk.constScanLine(y), copyWidth * 4);
+        }
+    }
+    return label.convertToFormat(QImage::Format_RGB888);
+}
+
+/**
+ * @brief 获取切片的ICC颜色配置文件
+ * @return 第0层目录的ICC配置文件
+ */
+std::vector<unsigned char> TiledTiffImage::getICCProfile()
+{
+    std::shared_lock<std::shared_mutex> l(*_openCloseMutex);
+    if (!_isValid || _levels.empty()) {
+        return std::vector<unsigned char>();
+    }
+    return _levels[0].iccProfile;
+}
+
+/**
+ * @brief 获取图像属性
+ * @return 属性列表
+ */
+const std::vector<SlideColorManagement::PropertyInfo> TiledTiffImage::getProperties()
+{
+    return _properties;
+}
@@ -0,0 +1,261 @@
+﻿/**
+ * @file    TiledTiffImage.h
+ * @brief   分块TIFF/SVS图像实现类，直接解析IFD并按压缩瓦片解码
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了不经过OpenSlide的通用分块TIFF和Aperio SVS读取，包括：
+ *          - 内存映射文件，打开时一次性解析经典TIFF和BigTIFF的IFD链
+ *          - 按瓦片解码JPEG（含仅表JPEG和Aperio RGB JPEG）、JPEG 2000（Aperio 33003/33005）、
+ *            LZW、Deflate和未压缩数据
+ *          - 读取线程之间没有解码锁，多个IO工作线程并发解码
+ *          - 跨多个瓦片的区域通过AsyncFileReader同时发出全部瓦片的读请求，数据到达即解码
+ *          - 解析Aperio ImageDescription得到aperio.*属性和像素间距
+ *
+ * @note    JPEG和JPEG 2000通过Qt的图像插件解码（qjpeg基于libjpeg-turbo），没有jp2插件时JPEG 2000切片不由该类读取
+ * @see     MultiResolutionImage, TiledTiffImageFactory, OpenSlideImage
+ */
+
+#pragma once
+#include "MultiResolutionImage.h"
+#include <QImage>
+#include <memory>
+#include <vector>
+
+class AsyncFileReader;
+class QFile;
+
+/**
+ * @class  TiledTiffImage
+ * @brief  分块TIFF/SVS图像实现类
+ * @details 金字塔由IFD链中的分块目录组成：第一个分块目录为第0层，
+ *          之后宽度递减、宽高比一致的分块目录依次作为更低分辨率的层级。
+ *          SVS中描述包含"label"的条带目录作为标签图。
+ *
+ *          读取区域时只解码与区域相交的瓦片，区域与瓦片网格对齐且大小等于瓦片时
+ *          恰好解码一个压缩瓦片。文件以只读方式内存映射，解码不持有任何锁。
+ *          区域跨多个瓦片时改用重叠IO一次发出全部瓦片的读请求，
+ *          按完成顺序解码，慢速存储上的等待由在途请求重叠。
+ *
+ * @note   只处理openslide_detect_vendor识别为aperio或generic-tiff的文件，
+ *         其余TIFF变体（Philips、Ventana等）仍由OpenSlide读取
+ * @example
+ *          // 使用示例
+ *          TiledTiffImage* image = new TiledTiffImage();
+ *          if (image->initialize("slide.svs")) {
+ *              unsigned char* data = new unsigned char[256 * 256 * 3];
+ *              image->getRawRegion<unsigned char>(0, 0, 256, 256, 0, data);
+ *          }
+ * @see     MultiResolutionImage, TiledTiffImageFactory
+ */
+class TiledTiffImage : public MultiResolutionImage
+{
+public:
+    /**
+     * @brief   默认构造函数
+     * @note    构造函数不会打开文件，需要调用initialize来加载图像
+     */
+    TiledTiffImage();
+
+    /**
+     * @brief   析构函数
+     * @details 解除文件映射并关闭文件
+     */
+    ~TiledTiffImage();
+
+    /**
+     * @brief   初始化TIFF图像
+     * @details 映射文件，解析IFD链，建立层级和标签图目录
+     * @param   imagePath 图像文件路径
+     * @return  找到至少一个可解码的分块层级时返回true
+     */
+    bool initializeType(const std::string& imagePath);
+
+    /**
+     * @brief   获取通道最小值
+     * @return  8位RGB数据，始终为0
+     */
+    double getMinValue(int channel = -1) { return 0.; }
+
+    /**
+     * @brief   获取通道最大值
+     * @return  8位RGB数据，始终为255
+     */
+    double getMaxValue(int channel = -1) { return 255.; }
+
+    /**
+     * @brief   获取属性
+     * @param   propertyName 属性名称，与getProperties返回的名称相同
+     * @return  属性值，不存在时返回空字符串
+     */
+    std::string getProperty(const std::string& propertyName);
+
+    /**
+     * @brief   获取标签图
+     * @return  SVS的标签图，不存在或无法解码时返回空图像
+     */
+    const QImage getLabel();
+
+    /**
+     * @brief   获取图像属性
+     * @details 包括tiff.ImageDescription、Aperio描述中的aperio.*键值，
+     *          以及按openslide命名的层级数、第0层尺寸和像素间距
+     * @return  属性列表
+     */
+    const std::vector<SlideColorManagement::PropertyInfo> getProperties();
+
+    /**
+     * @brief   获取切片的ICC颜色配置文件
+     * @return  第0层目录InterColorProfile标签的内容，不存在时为空
+     */
+    std::vector<unsigned char> getICCProfile() override;
+
+    /**
+     * @brief   检查文件是否可以直接读取
+     * @details 只解析IFD的标量字段，不读取瓦片偏移数组，用于工厂的格式探测
+     * @param   fileName 文件路径
+     * @return  文件为aperio或generic-tiff格式且第0层为可解码的分块目录时返回true
+     */
+    static bool canReadFile(const std::string& fileName);
+
+protected:
+    /**
+     * @brief   清理资源
+     * @details 解除文件映射并清空目录信息
+     */
+    void cleanup();
+
+    /**
+     * @brief   读取区域数据
+     * @details 逐个解码与区域相交的瓦片并复制重叠部分，区域超出图像或瓦片缺失的部分为白色
+     * @return  从TileBufferPool分配的RGB数据（unsigned char，3通道），调用者负责归还
+     */
+    void* readDataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level);
+
+    /**
+     * @brief   把区域数据解码到调用者的缓冲区
+     * @details 与readDataFromImage相同，但直接写入data，省去返回缓冲区和一次复制
+     * @return  图像有效时返回true
+     */
+    bool readDataIntoBuffer(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, void* data, const unsigned int& zPlane);
+
+    /**
+     * @brief   直接读取ARGB32数据
+     * @details 瓦片解码为QImage::Format_RGB32后按行复制，不透明像素与预乘格式相同
+     * @return  图像有效时返回true
+     */
+    bool readARGB32DataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, unsigned int* data, const unsigned int& zPlane);
+
+    /**
+     * @brief   缩小解码ARGB32预览
+     * @details 只支持JPEG压缩的分块目录，每个瓦片由JPEG解码器按DCT缩放直接解码为1/scale大小，
+     *          只做熵解码和缩小的反变换，约为完整解码的十分之一开销；
+     *          瓦片数据经映射的文件读入页缓存，随后的完整解码不再等待存储
+     * @return  目录不是JPEG分块、区域或瓦片大小不是scale的倍数时返回false
+     */
+    bool readPreviewARGB32DataFromImage(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, unsigned int scale, unsigned int* data, const unsigned int& zPlane);
+
+public:
+    /**
+     * @struct  Directory
+     * @brief   单个IFD中与解码有关的字段
+     * @details 条带存储的目录按宽度等于图像宽度、高度等于RowsPerStrip的瓦片统一处理
+     */
+    struct Directory {
+        unsigned long long width = 0;
+        unsigned long long height = 0;
+        unsigned int chunkWidth = 0;          ///< 瓦片宽度，条带时为图像宽度
+        unsigned int chunkHeight = 0;         ///< 瓦片高度，条带时为RowsPerStrip
+        bool tiled = false;
+        unsigned int compression = 1;
+        unsigned int photometric = 1;
+        unsigned int samplesPerPixel = 1;
+        unsigned int bitsPerSample = 1;
+        unsigned int planarConfiguration = 1;
+        unsigned int predictor = 1;
+        unsigned int subfileType = 0;
+        unsigned int resolutionUnit = 2;
+        double xResolution = 0.;
+        double yResolution = 0.;
+        std::string description;
+        std::vector<unsigned long long> offsets;     ///< 瓦片或条带偏移
+        std::vector<unsigned long long> byteCounts;  ///< 瓦片或条带字节数
+        std::vector<unsigned char> jpegTables;       ///< 仅表JPEG的量化表和霍夫曼表
+        std::vector<unsigned char> iccProfile;       ///< InterColorProfile标签的ICC配置文件
+    };
+
+private:
+    /**
+     * @brief   检查目录的压缩和像素格式是否可以解码
+     */
+    static bool isDecodable(const Directory& directory);
+
+    /**
+     * @brief   解码一个瓦片或条带
+     * @param   directory 目录
+     * @param   index 瓦片或条带序号
+     * @param   image 输出图像，格式为QImage::Format_RGB32
+     * @return  解码成功时返回true，瓦片缺失或数据损坏时返回false
+     */
+    bool decodeChunk(const Directory& directory, unsigned long long index, QImage& image) const;
+
+    /**
+     * @brief   解码已读入内存的瓦片或条带
+     * @param   directory 目录
+     * @param   index 瓦片或条带序号
+     * @param   chunk 压缩数据
+     * @param   length 压缩数据字节数
+     * @param   image 输出图像，格式为QImage::Format_RGB32
+     * @return  解码成功时返回true
+     */
+    bool decodeChunkData(const Directory& directory, unsigned long long index, const unsigned char* chunk, unsigned long long length,
+        QImage& image) const;
+
+    /**
+     * @brief   缩小解码一个JPEG瓦片
+     * @param   directory JPEG压缩的分块目录
+     * @param   index 瓦片序号
+     * @param   scale 缩小倍数
+     * @param   image 输出图像，格式为QImage::Format_RGB32，大小为瓦片大小的1/scale
+     * @return  解码成功时返回true
+     */
+    bool decodeChunkPreview(const Directory& directory, unsigned long long index, unsigned int scale, QImage& image) const;
+
+    /**
+     * @brief   组装可以独立解码的JPEG码流
+     * @param   directory 目录
+     * @param   chunk 瓦片数据
+     * @param   length 瓦片数据字节数
+     * @return  合并JPEGTables、必要时插入Adobe段后的码流
+     */
+    static QByteArray jpegStream(const Directory& directory, const unsigned char* chunk, unsigned long long length);
+
+    /**
+     * @brief   读取层级区域
+     * @details 起点为第0层坐标；rgb和argb二者取一作为输出
+     */
+    void decodeRegion(const long long& startX, const long long& startY, const unsigned long long& width,
+        const unsigned long long& height, const unsigned int& level, unsigned char* rgb, unsigned int* argb) const;
+
+    /** @brief 映射的文件 */
+    std::unique_ptr<QFile> _file;
+
+    /** @brief 文件映射的起始地址 */
+    const unsigned char* _data;
+
+    /** @brief 文件大小 */
+    unsigned long long _size;
+
+    /** @brief 异步读取器，用于跨多个瓦片的区域，打开失败时为空 */
+    std::unique_ptr<AsyncFileReader> _reader;
+
+    /** @brief 按分辨率从高到低排列的层级目录 */
+    std::vector<Directory> _levels;
+
+    /** @brief 标签图目录，不存在时chunkWidth为0 */
+    Directory _label;
+};
@@ -0,0 +1,325 @@
+﻿/**
+ * @file TiledTiffWriter.cpp
+ * @brief 分块BigTIFF写入类实现文件
+ * @details 该文件实现了BigTIFF文件头、瓦片编码和IFD链的写出
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "TiledTiffWriter.h"
+#include <QBuffer>
+#include <QImageWriter>
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+    /** @brief 写入时使用的TIFF字段类型 */
+    enum TiffType {
+        TypeASCII = 2,
+        TypeShort = 3,
+        TypeLong = 4,
+        TypeRational = 5,
+        TypeLong8 = 16
+    };
+
+    /** @brief 按小端序追加整数 */
+    void appendInteger(QByteArray& data, unsigned long long value, unsigned int bytes) {
+        for (unsigned int i = 0; i < bytes; ++i) {
+            data.append(static_cast<char>((value >> (8 * i)) & 0xff));
+        }
+    }
+
+    /** @brief IFD条目，值不超过8字节时内联 */
+    struct Entry {
+        unsigned short tag;
+        unsigned short type;
+        unsigned long long count;
+        QByteArray value;
+    };
+
+    /** @brief 创建整数数组条目 */
+    Entry integerEntry(unsigned short tag, unsigned short type, const std::vector<unsigned long long>& values) {
+        const unsigned int bytes = type == TypeShort ? 2 : (type == TypeLong ? 4 : 8);
+        Entry entry = { tag, type, values.size(), QByteArray() };
+        entry.value.reserve(static_cast<int>(values.size() * bytes));
+        for (unsigned long long value : values) {
+            appendInteger(entry.value, value, bytes);
+        }
+        return entry;
+    }
+
+    /** @brief 创建单值整数条目 */
+    Entry integerEntry(unsigned short tag, unsigned short type, unsigned long long value) {
+        return integerEntry(tag, type, std::vector<unsigned long long>(1, value));
+    }
+
+    /** @brief 创建有理数条目，保留三位小数 */
+    Entry rationalEntry(unsigned short tag, double value) {
+        Entry entry = { tag, TypeRational, 1, QByteArray() };
+        appendInteger(entry.value, static_cast<unsigned long long>(std::llround(value * 1000.)), 4);
+        appendInteger(entry.value, 1000, 4);
+        return entry;
+    }
+}
+
+/**
+ * @brief 构造函数
+ */
+TiledTiffWriter::TiledTiffWriter() :
+    _compression(JPEG),
+    _jpegQuality(90),
+    _failed(false)
+{
+}
+
+/**
+ * @brief 析构函数
+ */
+TiledTiffWriter::~TiledTiffWriter()
+{
+    if (_file.isOpen()) {
+        abort();
+    }
+}
+
+/**
+ * @brief 创建文件并写入文件头
+ * @details BigTIFF文件头：字节序、版本43、偏移字节数8，第一个IFD的偏移在close时回填
+ */
+bool TiledTiffWriter::open(const QString& path, Compression compression, int jpegQuality)
+{
+    _file.setFileName(path);
+    if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    _compression = compression;
+    _jpegQuality = jpegQuality;
+    _levels.clear();
+    _failed = false;
+    QByteArray header("II", 2);
+    appendInteger(header, 43, 2);
+    appendInteger(header, 8, 2);
+    appendInteger(header, 0, 2);
+    appendInteger(header, 0, 8);
+    if (_file.write(header) != header.size()) {
+        abort();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 添加一个层级
+ */
+int TiledTiffWriter::addLevel(unsigned long long width, unsigned long long height, unsigned int tileSize, double mpp)
+{
+    if (!_file.isOpen() || width == 0 || height == 0 || tileSize == 0 || tileSize % 16 != 0) {
+        return -1;
+    }
+    Level level;
+    level.width = width;
+    level.height = height;
+    level.tileSize = tileSize;
+    level.tilesAcross = (width + tileSize - 1) / tileSize;
+    level.tilesDown = (height + tileSize - 1) / tileSize;
+    level.mpp = mpp;
+    level.offsets.assign(level.tilesAcross * level.tilesDown, 0);
+    level.byteCounts.assign(level.tilesAcross * level.tilesDown, 0);
+    _levels.push_back(level);
+    return static_cast<int>(_levels.size()) - 1;
+}
+
+/**
+ * @brief 设置图像描述
+ */
+void TiledTiffWriter::setDescription(const QString& description)
+{
+    _description = description;
+}
+
+/**
+ * @brief 编码一个瓦片
+ * @details JPEG为完整的JFIF流（Qt的JPEG编码器输出4:2:0 YCbCr），Deflate为zlib流，
+ *          qCompress输出的前4字节是长度前缀，需要去掉
+ */
+QByteArray TiledTiffWriter::encodeTile(const QImage& tile) const
+{
+    const QImage rgb = tile.convertToFormat(QImage::Format_RGB888);
+    if (_compression == JPEG) {
+        QByteArray data;
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        QImageWriter writer(&buffer, "jpg");
+        writer.setQuality(_jpegQuality);
+        if (!writer.write(rgb)) {
+            return QByteArray();
+        }
+        return data;
+    }
+    const int lineBytes = rgb.width() * 3;
+    QByteArray raw(lineBytes * rgb.height(), Qt::Uninitialized);
+    for (int y = 0; y < rgb.height(); ++y) {
+        std::copy(rgb.constScanLine(y), rgb.constScanLine(y) + lineBytes, raw.data() + y * lineBytes);
+    }
+    return qCompress(raw, 6).mid(4);
+}
+
+/**
+ * @brief 在文件末尾写入数据
+ */
+unsigned long long TiledTiffWriter::append(const QByteArray& data)
+{
+    // TIFF要求字段值从字边界开始
+    if (_file.size() % 2 != 0) {
+        _file.seek(_file.size());
+        _file.write("\0", 1);
+    }
+    const unsigned long long offset = _file.size();
+    if (!_file.seek(offset) || _file.write(data) != data.size()) {
+        _failed = true;
+        return 0;
+    }
+    return offset;
+}
+
+/**
+ * @brief 编码并写入一个瓦片
+ */
+bool TiledTiffWriter::writeTile(int level, unsigned long long tileX, unsigned long long tileY, const QImage& tile)
+{
+    if (level < 0 || level >= static_cast<int>(_levels.size())) {
+        return false;
+    }
+    const Level& info = _levels[level];
+    if (tileX >= info.tilesAcross || tileY >= info.tilesDown) {
+        return false;
+    }
+    QImage image = tile;
+    if (image.width() != static_cast<int>(info.tileSize) || image.height() != static_cast<int>(info.tileSize)) {
+        image = tile.copy(0, 0, info.tileSize, info.tileSize);
+    }
+    const QByteArray data = encodeTile(image);
+    QMutexLocker locker(&_mutex);
+    if (data.isEmpty() || !_file.isOpen()) {
+        _failed = true;
+        return false;
+    }
+    const unsigned long long offset = append(data);
+    if (offset == 0) {
+        return false;
+    }
+    const unsigned long long index = tileY * info.tilesAcross + tileX;
+    _levels[level].offsets[index] = offset;
+    _levels[level].byteCounts[index] = static_cast<unsigned long long>(data.size());
+    return true;
+}
+
+/**
+ * @brief 写出一个层级的IFD
+ * @details 超过8字节的字段值先写在IFD之前，条目按标签升序排列
+ */
+unsigned long long TiledTiffWriter::writeDirectory(int level, unsigned long long& nextPointer)
+{
+    const Level& info = _levels[level];
+    std::vector<Entry> entries;
+    entries.push_back(integerEntry(254, TypeLong, level == 0 ? 0 : 1));
+    entries.push_back(integerEntry(256, TypeLong, info.width));
+    entries.push_back(integerEntry(257, TypeLong, info.height));
+    entries.push_back(integerEntry(258, TypeShort, std::vector<unsigned long long>(3, 8)));
+    entries.push_back(integerEntry(259, TypeShort, _compression == JPEG ? 7 : 8));
+    entries.push_back(integerEntry(262, TypeShort, _compression == JPEG ? 6 : 2));
+    if (level == 0 && !_description.isEmpty()) {
+        Entry description = { 270, TypeASCII, 0, _description.toUtf8() };
+        description.value.append('\0');
+        description.count = description.value.size();
+        entries.push_back(description);
+    }
+    entries.push_back(integerEntry(277, TypeShort, 3));
+    if (info.mpp > 0.) {
+        // 分辨率单位为厘米，1厘米为10000微米
+        entries.push_back(rationalEntry(282, 10000. / info.mpp));
+        entries.push_back(rationalEntry(283, 10000. / info.mpp));
+    }
+    entries.push_back(integerEntry(284, TypeShort, 1));
+    if (info.mpp > 0.) {
+        entries.push_back(integerEntry(296, TypeShort, 3));
+    }
+    entries.push_back(integerEntry(322, TypeLong, info.tileSize));
+    entries.push_back(integerEntry(323, TypeLong, info.tileSize));
+    entries.push_back(integerEntry(324, TypeLong8, info.offsets));
+    entries.push_back(integerEntry(325, TypeLong8, info.byteCounts));
+    if (_compression == JPEG) {
+        entries.push_back(integerEntry(530, TypeShort, std::vector<unsigned long long>(2, 2)));
+    }
+
+    QByteArray directory;
+    appendInteger(directory, entries.size(), 8);
+    for (const Entry& entry : entries) {
+        appendInteger(directory, entry.tag, 2);
+        appendInteger(directory, entry.type, 2);
+        appendInteger(directory, entry.count, 8);
+        if (entry.value.size() <= 8) {
+            QByteArray value = entry.value;
+            value.append(QByteArray(8 - value.size(), '\0'));
+            directory.append(value);
+        }
+        else {
+            const unsigned long long offset = append(entry.value);
+            if (offset == 0) {
+                return 0;
+            }
+            appendInteger(directory, offset, 8);
+        }
+    }
+    appendInteger(directory, 0, 8);
+    const unsigned long long offset = append(directory);
+    nextPointer = offset + directory.size() - 8;
+    return offset;
+}
+
+/**
+ * @brief 写出IFD链并关闭文件
+ */
+bool TiledTiffWriter::close()
+{
+    QMutexLocker locker(&_mutex);
+    if (!_file.isOpen()) {
+        return false;
+    }
+    bool complete = !_levels.empty();
+    for (const Level& level : _levels) {
+        complete = complete && std::find(level.offsets.begin(), level.offsets.end(), 0ULL) == level.offsets.end();
+    }
+    unsigned long long pointer = 8;
+    for (int level = 0; level < static_cast<int>(_levels.size()) && !_failed; ++level) {
+        unsigned long long nextPointer = 0;
+        const unsigned long long offset = writeDirectory(level, nextPointer);
+        if (offset == 0) {
+            break;
+        }
+        QByteArray link;
+        appendInteger(link, offset, 8);
+        if (!_file.seek(pointer) || _file.write(link) != link.size()) {
+            _failed = true;
+        }
+        pointer = nextPointer;
+    }
+    const bool ok = !_failed && complete && _file.flush();
+    _file.close();
+    return ok;
+}
+
+/**
+ * @brief 放弃写入
+ */
+void TiledTiffWriter::abort()
+{
+    QMutexLocker locker(&_mutex);
+    if (_file.isOpen()) {
+        _file.close();
+    }
+    _file.remove();
+}
@@ -0,0 +1,154 @@
+﻿/**
+ * @file    TiledTiffWriter.h
+ * @brief   分块BigTIFF写入类，流式写出金字塔TIFF
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了不依赖libtiff的分块TIFF写入，包括：
+ *          - BigTIFF文件头和64位瓦片偏移，输出大小不受4GB限制
+ *          - 每个瓦片单独编码为JPEG（YCbCr）或Deflate（RGB）
+ *          - 瓦片可按任意顺序、从多个线程写入，编码不持有锁
+ *          - 金字塔的每一层为一个IFD，第0层之后的IFD标记为缩小图像
+ *
+ * @note    瓦片数据随写随落盘，内存中只保留各层级的瓦片偏移表；IFD在close时写在文件末尾
+ * @see     RegionExport, TiledTiffImage
+ */
+
+#pragma once
+
+#include <QFile>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+#include <vector>
+
+/**
+ * @class  TiledTiffWriter
+ * @brief  分块BigTIFF写入类
+ * @details 使用方式：open后用addLevel依次添加各层级，之后任意顺序调用writeTile，
+ *          最后调用close写出IFD链。写出的文件可以由TiledTiffImage和OpenSlide的generic-tiff读取。
+ *
+ * @example
+ * @code
+ * TiledTiffWriter writer;
+ * if (writer.open("region.tif", TiledTiffWriter::JPEG)) {
+ *     int level = writer.addLevel(width, height, 256, mpp);
+ *     writer.writeTile(level, 0, 0, tileImage);
+ *     writer.close();
+ * }
+ * @endcode
+ */
+class TiledTiffWriter
+{
+public:
+    /** @brief 瓦片压缩方式 */
+    enum Compression {
+        JPEG,    ///< 有损JPEG，YCbCr 4:2:0
+        Deflate  ///< 无损Deflate，RGB
+    };
+
+    TiledTiffWriter();
+
+    /**
+     * @brief   析构函数
+     * @details 未关闭的文件被放弃并删除
+     */
+    ~TiledTiffWriter();
+
+    /**
+     * @brief   创建文件并写入文件头
+     * @param   path 文件路径，已存在时覆盖
+     * @param   compression 瓦片压缩方式
+     * @param   jpegQuality JPEG质量（0-100）
+     * @return  成功时返回true
+     */
+    bool open(const QString& path, Compression compression, int jpegQuality = 90);
+
+    /**
+     * @brief   添加一个层级
+     * @param   width 层级宽度
+     * @param   height 层级高度
+     * @param   tileSize 瓦片边长，必须是16的倍数
+     * @param   mpp 像素间距（微米），不大于0表示未知
+     * @return  层级索引，失败时返回-1
+     * @note    必须在写入任何瓦片之前添加所有层级；第一个层级为全分辨率图像
+     */
+    int addLevel(unsigned long long width, unsigned long long height, unsigned int tileSize, double mpp = 0.);
+
+    /**
+     * @brief   设置图像描述
+     * @param   description 写入第0层ImageDescription的文本
+     */
+    void setDescription(const QString& description);
+
+    /**
+     * @brief   编码并写入一个瓦片
+     * @param   level 层级索引
+     * @param   tileX 瓦片X坐标
+     * @param   tileY 瓦片Y坐标
+     * @param   tile 瓦片图像，大小应为tileSize x tileSize，超出图像范围的部分照常编码
+     * @return  成功时返回true
+     * @note    线程安全；编码在调用线程中进行，只有追加到文件时持有锁
+     */
+    bool writeTile(int level, unsigned long long tileX, unsigned long long tileY, const QImage& tile);
+
+    /**
+     * @brief   写出IFD链并关闭文件
+     * @return  所有写入都成功且每个瓦片都已写入时返回true
+     * @details 缺失的瓦片偏移为0，读取时按空白处理，但结果视为失败
+     */
+    bool close();
+
+    /**
+     * @brief   放弃写入
+     * @details 关闭并删除文件
+     */
+    void abort();
+
+    /** @brief 文件是否已打开 */
+    bool isOpen() const { return _file.isOpen(); }
+
+private:
+    /** @brief 层级信息 */
+    struct Level {
+        unsigned long long width;
+        unsigned long long height;
+        unsigned int tileSize;
+        unsigned long long tilesAcross;
+        unsigned long long tilesDown;
+        double mpp;
+        std::vector<unsigned long long> offsets;
+        std::vector<unsigned long long> byteCounts;
+    };
+
+    /**
+     * @brief   编码一个瓦片
+     * @param   tile 瓦片图像
+     * @return  压缩后的数据，失败时为空
+     */
+    QByteArray encodeTile(const QImage& tile) const;
+
+    /**
+     * @brief   写出一个层级的IFD
+     * @param   level 层级索引
+     * @param   nextPointer 输出，该IFD中下一个IFD偏移字段的文件位置
+     * @return  IFD的文件偏移，失败时返回0
+     */
+    unsigned long long writeDirectory(int level, unsigned long long& nextPointer);
+
+    /**
+     * @brief   在文件末尾写入数据
+     * @param   data 数据
+     * @return  数据的文件偏移，失败时返回0
+     * @note    调用者持有_mutex
+     */
+    unsigned long long append(const QByteArray& data);
+
+    QFile _file;
+    QMutex _mutex;
+    Compression _compression;
+    int _jpegQuality;
+    QString _description;
+    std::vector<Level> _levels;
+    bool _failed;
+};
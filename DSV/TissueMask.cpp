@@ -0,0 +1,89 @@
+﻿/**
+ * @file TissueMask.cpp
+ * @brief 组织掩膜类实现文件
+ * @details 该文件实现了缩略图像素的组织判定和积分图查询
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "TissueMask.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+/**
+ * @brief 构造函数
+ * @param width 掩膜宽度
+ * @param height 掩膜高度
+ * @param downsample 相对第0层的下采样倍数
+ */
+TissueMask::TissueMask(unsigned int width, unsigned int height, double downsample) :
+    _width(width),
+    _height(height),
+    _downsample(downsample),
+    _integral(static_cast<size_t>(width + 1) * (height + 1), 0)
+{
+}
+
+/**
+ * @brief 根据缩略图像素创建掩膜
+ * @details 逐行判断像素并累加积分图，只遍历一次缩略图
+ */
+std::shared_ptr<TissueMask> TissueMask::fromPixels(const unsigned char* pixels, unsigned int width, unsigned int height, unsigned int samplesPerPixel,
+    double downsample, unsigned char bgR, unsigned char bgG, unsigned char bgB)
+{
+    if (!pixels || width == 0 || height == 0 || samplesPerPixel < 3 || downsample <= 0) {
+        return std::shared_ptr<TissueMask>();
+    }
+    std::shared_ptr<TissueMask> mask(new TissueMask(width, height, downsample));
+    const size_t stride = width + 1;
+    for (unsigned int y = 0; y < height; ++y) {
+        const unsigned char* row = pixels + static_cast<size_t>(y) * width * samplesPerPixel;
+        unsigned int rowSum = 0;
+        for (unsigned int x = 0; x < width; ++x) {
+            const unsigned char* pixel = row + static_cast<size_t>(x) * samplesPerPixel;
+            const int r = pixel[0], g = pixel[1], b = pixel[2];
+            const bool isFill = std::abs(r - bgR) <= static_cast<int>(kBackgroundTolerance)
+                && std::abs(g - bgG) <= static_cast<int>(kBackgroundTolerance)
+                && std::abs(b - bgB) <= static_cast<int>(kBackgroundTolerance);
+            // 与RegionAnalysis相同的Rec.601亮度和最大最小通道差色度
+            const unsigned int luminance = (299 * r + 587 * g + 114 * b) / 1000;
+            const unsigned int chroma = std::max(r, std::max(g, b)) - std::min(r, std::min(g, b));
+            const bool isGlass = luminance >= kLuminanceThreshold && chroma <= kChromaThreshold;
+            if (!isFill && !isGlass) {
+                ++rowSum;
+            }
+            mask->_integral[(y + 1) * stride + x + 1] = mask->_integral[y * stride + x + 1] + rowSum;
+        }
+    }
+    return mask;
+}
+
+/**
+ * @brief 判断第0层矩形内是否可能有组织
+ * @details 矩形换算到掩膜坐标后外扩kMarginPixels并裁剪到掩膜范围，用积分图四个角求和
+ */
+bool TissueMask::containsTissue(double x, double y, double width, double height) const
+{
+    const long long margin = kMarginPixels;
+    const long long left = std::max(0LL, static_cast<long long>(std::floor(x / _downsample)) - margin);
+    const long long top = std::max(0LL, static_cast<long long>(std::floor(y / _downsample)) - margin);
+    const long long right = std::min(static_cast<long long>(_width), static_cast<long long>(std::ceil((x + width) / _downsample)) + margin);
+    const long long bottom = std::min(static_cast<long long>(_height), static_cast<long long>(std::ceil((y + height) / _downsample)) + margin);
+    if (left >= right || top >= bottom) {
+        return false;
+    }
+    const size_t stride = _width + 1;
+    const unsigned int count = _integral[bottom * stride + right] - _integral[top * stride + right]
+        - _integral[bottom * stride + left] + _integral[top * stride + left];
+    return count > 0;
+}
+
+/**
+ * @brief 获取组织像素所占比例
+ */
+double TissueMask::getTissueFraction() const
+{
+    return static_cast<double>(_integral.back()) / (static_cast<double>(_width) * _height);
+}
@@ -0,0 +1,114 @@
+﻿/**
+ * @file    TissueMask.h
+ * @brief   组织掩膜类，根据缩略图区分组织和玻片背景
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了每张切片只计算一次的低分辨率组织掩膜，包括：
+ *          - 按亮度、色度和切片背景色判断缩略图像素是否为组织
+ *          - 使用积分图在常数时间内判断第0层矩形内是否有组织
+ *          - 统计组织所占比例
+ *
+ * @note    掩膜由SlideLoader在读取缩略图后创建并设置到MultiResolutionImage，
+ *          IOWorker和PrefetchThread据此跳过背景瓦片的解码
+ * @see     MultiResolutionImage::setTissueMask, SlideLoader
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+/**
+ * @class  TissueMask
+ * @brief  低分辨率组织掩膜
+ * @details 每个掩膜像素对应缩略图的一个像素。满足以下任一条件的像素视为背景：
+ *          - 亮度不低于亮度阈值且色度不高于色度阈值（明场切片的白色玻片）
+ *          - 与切片背景色的各通道差值都不超过kBackgroundTolerance（扫描区域以外的填充）
+ *          与RegionAnalysis的默认阈值一致。判断时查询矩形向外扩展kMarginPixels个掩膜像素，
+ *          避免组织边缘因缩略图分辨率不足被误判为背景。
+ *
+ * @note    创建后不再修改，可在多个线程中同时查询
+ *
+ * @example
+ * @code
+ * std::shared_ptr<TissueMask> mask = TissueMask::fromPixels(overview, width, height, 3, downsample, 255, 255, 255);
+ * if (!mask->containsTissue(x, y, tileExtent, tileExtent)) {
+ *     // 用背景色填充瓦片
+ * }
+ * @endcode
+ */
+class TissueMask
+{
+public:
+    /**
+     * @brief   根据缩略图像素创建掩膜
+     * @param   pixels 缩略图像素，RGB或RGBA交错排列，行间无填充
+     * @param   width 缩略图宽度
+     * @param   height 缩略图高度
+     * @param   samplesPerPixel 每像素样本数，3或4
+     * @param   downsample 缩略图相对第0层的下采样倍数
+     * @param   bgR 切片背景色红色分量
+     * @param   bgG 切片背景色绿色分量
+     * @param   bgB 切片背景色蓝色分量
+     * @return  掩膜，参数无效时返回空指针
+     */
+    static std::shared_ptr<TissueMask> fromPixels(const unsigned char* pixels, unsigned int width, unsigned int height, unsigned int samplesPerPixel,
+        double downsample, unsigned char bgR, unsigned char bgG, unsigned char bgB);
+
+    /**
+     * @brief   判断第0层矩形内是否可能有组织
+     * @param   x 矩形左边（第0层坐标）
+     * @param   y 矩形上边（第0层坐标）
+     * @param   width 矩形宽度
+     * @param   height 矩形高度
+     * @return  矩形（外扩kMarginPixels个掩膜像素后）内有组织像素时返回true；
+     *          与掩膜范围不相交时返回false
+     */
+    bool containsTissue(double x, double y, double width, double height) const;
+
+    /**
+     * @brief   获取组织像素所占比例
+     * @return  [0, 1]之间的比例
+     */
+    double getTissueFraction() const;
+
+    /** @brief 获取掩膜宽度 */
+    unsigned int getWidth() const { return _width; }
+
+    /** @brief 获取掩膜高度 */
+    unsigned int getHeight() const { return _height; }
+
+    /** @brief 获取掩膜相对第0层的下采样倍数 */
+    double getDownsample() const { return _downsample; }
+
+    /** @brief 亮度阈值，亮度低于该值的像素视为组织 */
+    static const unsigned int kLuminanceThreshold = 220;
+
+    /** @brief 色度阈值，色度高于该值的像素视为组织 */
+    static const unsigned int kChromaThreshold = 15;
+
+    /** @brief 与背景色的容差 */
+    static const unsigned int kBackgroundTolerance = 8;
+
+    /** @brief 查询矩形外扩的掩膜像素数 */
+    static const unsigned int kMarginPixels = 1;
+
+private:
+    TissueMask(unsigned int width, unsigned int height, double downsample);
+
+    /** @brief 掩膜宽度 */
+    unsigned int _width;
+
+    /** @brief 掩膜高度 */
+    unsigned int _height;
+
+    /** @brief 相对第0层的下采样倍数 */
+    double _downsample;
+
+    /**
+     * @brief 组织像素的积分图
+     * @details 大小为(_width + 1) * (_height + 1)，_integral[y * (_width + 1) + x]为左上角x*y个像素中的组织像素数
+     */
+    std::vector<unsigned int> _integral;
+};
@@ -7,6 +7,7 @@
  * @details 该文件包含DSV项目中使用的各种工具函数，包括：
  *          - RGB与HSV颜色空间转换函数
  *          - 颜色查找表(LUT)应用函数
+ *          - 预计算的稠密颜色查找表(DenseLUT)
  *          - 单色图像到RGB图像转换函数
  *          - 图像数据处理和格式转换功能
  *          所有函数都是内联函数，提供高效的图像处理性能。
@@ -17,8 +18,11 @@
 
 #pragma once
 #include <QImage>
+#include <algorithm>
 #include <array>
 #include <tuple>
+#include <type_traits>
+#include <vector>
 #include <math.h>
 #include "SlideColorManagement.h"
 
@@ -251,10 +255,201 @@ inline unsigned int applyLUT(const float& val, const SlideColorManagement::LUT&
     return qRgba(*currentColorBuffer, *(currentColorBuffer + 1), *(currentColorBuffer + 2), *(currentColorBuffer + 3));
 }
 
+/**
+ * @class   DenseLUT
+ * @brief   按像素值预计算的稠密颜色查找表
+ * @details 把LUT对某一数据类型和通道范围的映射一次性展开为颜色表，
+ *          逐像素转换只需一次仿射变换和一次查表，不再进行upper_bound查找和HSV插值：
+ *          - unsigned char/unsigned short：覆盖整个取值范围（256/65536项），结果与applyLUT完全一致
+ *          - 其他整数类型：LUT变化区间不超过65536个整数时逐整数展开，同样精确
+ *          - 浮点类型及更宽的整数区间：在LUT变化区间内均匀量化为4096项，区间外取两端颜色
+ *
+ * @note    编译结果与LUT、通道最小/最大值和数据类型绑定，调用方通过isCompiledFor判断是否需要重新编译。
+ *          编译后的对象只读，可被多个线程同时使用
+ * @see     applyLUT, convertMonochromeToRGB
+ * @example
+ *          DenseLUT table;
+ *          if (!table.isCompiledFor<float>(minValue, maxValue, generation)) {
+ *              table.compile<float>(lut, minValue, maxValue, generation);
+ *          }
+ *          QImage img = convertMonochromeToRGB(data, 512, 512, 0, 1, table);
+ */
+class DenseLUT {
+public:
+    /** @brief 浮点类型和宽整数区间的量化表项数 */
+    static const unsigned int kQuantizedSize = 4096;
+
+    /** @brief 逐整数展开的最大表项数 */
+    static const unsigned int kMaxExactSize = 65536;
+
+    /**
+     * @brief   判断是否已按给定参数编译
+     * @tparam  T 像素数据类型
+     * @param   channelMin 通道最小值
+     * @param   channelMax 通道最大值
+     * @param   generation 调用方为LUT分配的代号，LUT改变时应改变
+     * @return  参数完全相同时返回true
+     */
+    template<typename T>
+    bool isCompiledFor(double channelMin, double channelMax, unsigned int generation) const {
+        return !_table.empty() && _typeTag == typeTag<T>() && _channelMin == channelMin && _channelMax == channelMax && _generation == generation;
+    }
+
+    /**
+     * @brief   编译颜色表
+     * @tparam  T 像素数据类型
+     * @param   LUT 颜色查找表
+     * @param   channelMin 通道最小值，用于相对LUT
+     * @param   channelMax 通道最大值，用于相对LUT
+     * @param   generation LUT代号，见isCompiledFor
+     * @details 每个表项的颜色由applyLUT按该表项对应的像素值计算
+     */
+    template<typename T>
+    void compile(const SlideColorManagement::LUT& LUT, double channelMin, double channelMax, unsigned int generation) {
+        _typeTag = typeTag<T>();
+        _channelMin = channelMin;
+        _channelMax = channelMax;
+        _generation = generation;
+
+        double pixelBegin = 0.;
+        double pixelStep = 1.;
+        unsigned int size = 1;
+        if (std::is_unsigned<T>::value && sizeof(T) <= 2) {
+            size = 1u << (8 * sizeof(T));
+        }
+        else if (!LUT.indices.empty()) {
+            // LUT索引区间换算到像素值区间，区间外的颜色恒等于两端颜色
+            double lo = LUT.indices.front();
+            double hi = LUT.indices.back();
+            if (LUT.relative) {
+                lo = channelMin + lo * (channelMax - channelMin);
+                hi = channelMin + hi * (channelMax - channelMin);
+            }
+            if (std::is_integral<T>::value) {
+                lo = std::floor(lo);
+                hi = std::ceil(hi);
+            }
+            pixelBegin = lo;
+            if (std::is_integral<T>::value && hi - lo < kMaxExactSize) {
+                size = static_cast<unsigned int>(hi - lo) + 1;
+            }
+            else if (hi > lo) {
+                size = kQuantizedSize;
+                pixelStep = (hi - lo) / (kQuantizedSize - 1);
+            }
+        }
+        _pixelBegin = pixelBegin;
+        _inverseStep = 1. / pixelStep;
+
+        _table.resize(size);
+        for (unsigned int i = 0; i < size; ++i) {
+            double pixelValue = pixelBegin + i * pixelStep;
+            if (LUT.relative) {
+                _table[i] = applyLUT((pixelValue - channelMin) / (channelMax - channelMin), LUT);
+            }
+            else {
+                _table[i] = applyLUT(pixelValue, LUT);
+            }
+        }
+    }
+
+    /**
+     * @brief   转换一行或一块像素
+     * @tparam  T 像素数据类型，应与编译时一致
+     * @param   data 输入数据，按通道交错存储
+     * @param   nrPixels 像素数
+     * @param   channel 使用的通道索引
+     * @param   numberOfChannels 总通道数
+     * @param   pixels 输出的QRgb颜色
+     */
+    template<typename T>
+    void apply(const T* data, unsigned long long nrPixels, unsigned int channel, unsigned int numberOfChannels, QRgb* pixels) const {
+        const QRgb* table = _table.data();
+        data += channel;
+        if (std::is_unsigned<T>::value && sizeof(T) <= 2) {
+            for (unsigned long long j = 0; j < nrPixels; ++j) {
+                pixels[j] = table[static_cast<unsigned int>(data[j * numberOfChannels])];
+            }
+            return;
+        }
+        // 32位整数超出float的精确范围，使用double计算位置
+        typedef typename std::conditional<std::is_integral<T>::value, double, float>::type Real;
+        const Real last = static_cast<Real>(_table.size() - 1);
+        const Real begin = static_cast<Real>(_pixelBegin);
+        const Real inverseStep = static_cast<Real>(_inverseStep);
+        for (unsigned long long j = 0; j < nrPixels; ++j) {
+            Real position = (static_cast<Real>(data[j * numberOfChannels]) - begin) * inverseStep;
+            // NaN与applyLUT一致取最后一个颜色
+            position = position < 0 ? 0 : (position < last ? position + static_cast<Real>(0.5) : last);
+            pixels[j] = table[static_cast<unsigned int>(position)];
+        }
+    }
+
+    /**
+     * @brief   获取表项数
+     * @return  表项数，未编译时为0
+     */
+    size_t size() const { return _table.size(); }
+
+private:
+    /**
+     * @brief   数据类型标记
+     * @return  区分不同数据类型的整数
+     */
+    template<typename T>
+    static int typeTag() {
+        return static_cast<int>(sizeof(T)) * 4 + (std::is_floating_point<T>::value ? 2 : 0) + (std::is_signed<T>::value ? 1 : 0);
+    }
+
+    /** @brief 颜色表 */
+    std::vector<QRgb> _table;
+
+    /** @brief 第一个表项对应的像素值 */
+    double _pixelBegin = 0.;
+
+    /** @brief 相邻表项像素值间隔的倒数 */
+    double _inverseStep = 1.;
+
+    /** @brief 编译时的数据类型标记 */
+    int _typeTag = 0;
+
+    /** @brief 编译时的通道最小值 */
+    double _channelMin = 0.;
+
+    /** @brief 编译时的通道最大值 */
+    double _channelMax = 0.;
+
+    /** @brief 编译时的LUT代号 */
+    unsigned int _generation = 0;
+};
+
+/**
+ * @brief   使用稠密颜色查找表将单色图像数据转换为RGB图像
+ * @details 逐像素查表，适用于LUT不变、大量瓦片重复转换的场景
+ *
+ * @tparam  T 数据类型模板参数
+ * @param   data 输入图像数据指针
+ * @param   width 图像宽度
+ * @param   height 图像高度
+ * @param   channel 要处理的通道索引
+ * @param   numberOfChannels 总通道数
+ * @param   table 已按T编译的稠密颜色查找表
+ * @return  QImage格式的RGB图像，格式为ARGB32_Premultiplied
+ * @see     DenseLUT
+ */
+template<typename T>
+QImage convertMonochromeToRGB(const T* data, unsigned int width, unsigned int height,
+    unsigned int channel, unsigned int numberOfChannels, const DenseLUT& table) {
+    QImage img(width, height, QImage::Format_ARGB32_Premultiplied);
+    table.apply(data, static_cast<unsigned long long>(width) * height, channel, numberOfChannels, reinterpret_cast<QRgb*>(img.bits()));
+    return img;
+}
+
 /**
  * @brief   将单色图像数据转换为RGB图像
  * @details 将单通道图像数据转换为RGB格式的QImage，支持颜色查找表(LUT)应用。
  *          使用缓存机制避免重复的颜色计算，提高转换效率。
+ *          需要转换多个瓦片时应使用DenseLUT版本，避免逐像素的map查找。
  *
  * @tparam  T 数据类型模板参数，支持各种数值类型
  * @param   data 输入图像数据指针
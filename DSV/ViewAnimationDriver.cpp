@@ -0,0 +1,157 @@
+﻿/**
+ * @file ViewAnimationDriver.cpp
+ * @brief 视图动画驱动实现文件
+ * @details 该文件实现了视图动画的帧节奏推进，包括：
+ *          - 屏幕刷新率到帧间隔的换算
+ *          - 帧源交换缓冲区信号和后备定时器
+ *          - 多个动画在同一帧的合并推进
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "ViewAnimationDriver.h"
+#include <QOpenGLWidget>
+#include <QScreen>
+#include <QWidget>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief 构造函数
+ * @param widget 动画所属的窗口
+ */
+ViewAnimationDriver::ViewAnimationDriver(QWidget* widget)
+    : QObject(widget),
+    _widget(widget),
+    _lastFrame(0),
+    _curve(QEasingCurve::InOutSine)
+{
+    _timer.setTimerType(Qt::PreciseTimer);
+    connect(&_timer, &QTimer::timeout, this, &ViewAnimationDriver::advance);
+    _clock.start();
+}
+
+/**
+ * @brief 设置帧源
+ * @param frameSource OpenGL视口，NULL表示按定时器推进
+ * @details 切换帧源时正在运行的动画继续推进
+ */
+void ViewAnimationDriver::setFrameSource(QOpenGLWidget* frameSource)
+{
+    disconnect(_frameSourceConnection);
+    _frameSource = frameSource;
+    if (frameSource) {
+        _frameSourceConnection = connect(frameSource, &QOpenGLWidget::frameSwapped, this, &ViewAnimationDriver::advance);
+    }
+    if (_timer.isActive()) {
+        _timer.start(_frameSource ? 2 * frameInterval() : frameInterval());
+    }
+}
+
+/**
+ * @brief 获取帧间隔
+ * @return 帧间隔（毫秒），限制在4到50毫秒之间
+ */
+int ViewAnimationDriver::frameInterval() const
+{
+    const QScreen* screen = _widget ? _widget->screen() : NULL;
+    const qreal refreshRate = screen ? screen->refreshRate() : 0.;
+    if (refreshRate <= 0.) {
+        return kDefaultFrameInterval;
+    }
+    return std::max(4, std::min(50, static_cast<int>(std::lround(1000. / refreshRate))));
+}
+
+/**
+ * @brief 开始一个动画
+ * @param duration 持续时间（毫秒）
+ * @param step 步进函数
+ * @param finished 结束函数
+ */
+void ViewAnimationDriver::start(int duration, const StepFunction& step, const FinishedFunction& finished)
+{
+    const qint64 now = _clock.elapsed();
+    if (_animations.empty()) {
+        _lastFrame = now;
+    }
+    Animation animation;
+    animation.startTime = now;
+    animation.duration = std::max(duration, 1);
+    animation.done = false;
+    animation.step = step;
+    animation.finished = finished;
+    _animations.push_back(animation);
+    if (!_timer.isActive()) {
+        // 有帧源时先请求一次重绘，之后由交换缓冲区信号推进
+        if (_frameSource) {
+            _frameSource->update();
+        }
+        _timer.start(_frameSource ? 2 * frameInterval() : frameInterval());
+    }
+}
+
+/**
+ * @brief 停止所有动画
+ */
+void ViewAnimationDriver::stopAll()
+{
+    _animations.clear();
+    _timer.stop();
+}
+
+/**
+ * @brief 是否有正在运行的动画
+ * @return 有动画时返回true
+ */
+bool ViewAnimationDriver::isActive() const
+{
+    return !_animations.empty();
+}
+
+/**
+ * @brief 推进一帧
+ * @details 步进函数中可能开始新的动画，因此按下标遍历，新动画从下一帧开始推进；
+ *          结束函数在所有步进之后按开始顺序调用
+ */
+void ViewAnimationDriver::advance()
+{
+    if (_animations.empty()) {
+        _timer.stop();
+        return;
+    }
+    const qint64 now = _clock.elapsed();
+    const qint64 frameTime = now - _lastFrame;
+    if (2 * frameTime < frameInterval()) {
+        // 帧源和后备定时器在同一帧内都触发时只推进一次
+        return;
+    }
+    _lastFrame = now;
+
+    const size_t count = _animations.size();
+    std::vector<FinishedFunction> finished;
+    for (size_t i = 0; i < count; ++i) {
+        const qreal progress = std::min<qreal>(1., static_cast<qreal>(now - _animations[i].startTime) / _animations[i].duration);
+        _animations[i].step(_curve.valueForProgress(progress), static_cast<qreal>(frameTime));
+        if (progress >= 1.) {
+            finished.push_back(_animations[i].finished);
+            _animations[i].done = true;
+        }
+    }
+    _animations.erase(std::remove_if(_animations.begin(), _animations.end(), [](const Animation& animation) { return animation.done; }),
+        _animations.end());
+    for (const FinishedFunction& function : finished) {
+        if (function) {
+            function();
+        }
+    }
+    emit frameAdvanced();
+
+    if (_animations.empty()) {
+        _timer.stop();
+    }
+    else {
+        // 后备定时器从本帧重新计时，帧源按时交换缓冲区时不会触发
+        _timer.start(_frameSource ? 2 * frameInterval() : frameInterval());
+    }
+}
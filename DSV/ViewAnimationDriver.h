@@ -0,0 +1,155 @@
+﻿/**
+ * @file    ViewAnimationDriver.h
+ * @brief   视图动画驱动类，按显示器刷新节奏推进缩放和复位动画
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了PathologyViewer的帧节奏动画，包括：
+ *          - 所有同时运行的动画共用一个时钟，每帧推进一次
+ *          - OpenGL视口开启垂直同步时在QOpenGLWidget::frameSwapped后推进，与屏幕刷新对齐
+ *          - 光栅视口按屏幕刷新率的精确定时器推进
+ *          - 每帧所有动画推进之后只发出一次frameAdvanced，视图据此只更新一次视场
+ *
+ * @note    该类的公有接口只能在GUI线程中调用
+ * @see     PathologyViewer
+ */
+
+#pragma once
+
+#include <QEasingCurve>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <functional>
+#include <vector>
+
+class QOpenGLWidget;
+class QWidget;
+
+/**
+ * @class  ViewAnimationDriver
+ * @brief  视图动画驱动
+ * @details 每个动画由持续时间、步进函数和结束函数组成，进度按与QTimeLine默认曲线相同的InOutSine缓动。
+ *          每帧依次调用各动画的步进函数，参数为缓动后的进度和距上一帧的毫秒数；
+ *          随后调用本帧结束的动画的结束函数，最后发出一次frameAdvanced。
+ *
+ *          设置了帧源时，帧源每次交换缓冲区后推进一帧；为防止视图没有变化、不再重绘时动画停住，
+ *          同时保留一个两帧长的后备定时器。没有帧源时按屏幕刷新率的定时器推进。
+ *
+ * @example
+ *          // 使用示例
+ *          ViewAnimationDriver* driver = new ViewAnimationDriver(view);
+ *          connect(driver, &ViewAnimationDriver::frameAdvanced, view, &PathologyViewer::onAnimationFrame);
+ *          driver->start(300, [view](qreal value, qreal frameTime) { view->scalingTime(value, frameTime); },
+ *              [view]() { view->zoomFinished(); });
+ * @see     PathologyViewer
+ */
+class ViewAnimationDriver : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief 步进函数，参数为缓动后的进度（0到1）和距上一帧的毫秒数
+     */
+    typedef std::function<void(qreal value, qreal frameTime)> StepFunction;
+
+    /**
+     * @brief 结束函数
+     */
+    typedef std::function<void()> FinishedFunction;
+
+    /**
+     * @brief   构造函数
+     * @param   widget 动画所属的窗口，同时作为父对象，用于获取所在屏幕的刷新率
+     */
+    explicit ViewAnimationDriver(QWidget* widget);
+
+    /**
+     * @brief   设置帧源
+     * @details 帧源为开启垂直同步的OpenGL视口时，动画在每次交换缓冲区后推进
+     * @param   frameSource OpenGL视口，NULL表示按定时器推进
+     */
+    void setFrameSource(QOpenGLWidget* frameSource);
+
+    /**
+     * @brief   开始一个动画
+     * @details 与正在运行的动画合并到同一帧推进，第一次推进在下一帧
+     * @param   duration 持续时间（毫秒）
+     * @param   step 步进函数
+     * @param   finished 结束函数，可为空
+     */
+    void start(int duration, const StepFunction& step, const FinishedFunction& finished = FinishedFunction());
+
+    /**
+     * @brief   停止所有动画
+     * @details 不调用步进函数和结束函数
+     */
+    void stopAll();
+
+    /**
+     * @brief   是否有正在运行的动画
+     * @return  有动画时返回true
+     */
+    bool isActive() const;
+
+    /**
+     * @brief   获取帧间隔
+     * @return  所在屏幕刷新率对应的帧间隔（毫秒）
+     */
+    int frameInterval() const;
+
+signals:
+    /**
+     * @brief   帧推进信号
+     * @details 本帧所有动画推进之后发出一次
+     */
+    void frameAdvanced();
+
+private slots:
+    /**
+     * @brief   推进一帧
+     * @details 帧源交换缓冲区或定时器到期时调用；距上一帧不足半个帧间隔时忽略
+     */
+    void advance();
+
+private:
+    /**
+     * @brief 动画
+     */
+    struct Animation {
+        qint64 startTime;           ///< 开始时间（毫秒，_clock时间）
+        int duration;               ///< 持续时间（毫秒）
+        bool done;                  ///< 本帧已推进到终点
+        StepFunction step;
+        FinishedFunction finished;
+    };
+
+    /** @brief 动画所属的窗口 */
+    QPointer<QWidget> _widget;
+
+    /** @brief 帧源 */
+    QPointer<QOpenGLWidget> _frameSource;
+
+    /** @brief 帧源交换信号的连接 */
+    QMetaObject::Connection _frameSourceConnection;
+
+    /** @brief 正在运行的动画 */
+    std::vector<Animation> _animations;
+
+    /** @brief 推进帧的定时器，有帧源时为后备定时器 */
+    QTimer _timer;
+
+    /** @brief 动画时钟 */
+    QElapsedTimer _clock;
+
+    /** @brief 上一帧的时间（毫秒，_clock时间） */
+    qint64 _lastFrame;
+
+    /** @brief 进度缓动曲线 */
+    QEasingCurve _curve;
+
+    /** @brief 无法获取屏幕刷新率时的帧间隔（毫秒） */
+    static const int kDefaultFrameInterval = 16;
+};
@@ -0,0 +1,143 @@
+﻿/**
+ * @file ViewSnapshotService.cpp
+ * @brief 视图快照服务实现文件
+ * @details 该文件实现了视图的离屏快照，包括：
+ *          - 合并请求的延迟渲染
+ *          - 底图的缓存和失效判断
+ *          - 浮层窗口的合成
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "ViewSnapshotService.h"
+#include "PipelineTrace.h"
+#include <QGraphicsView>
+#include <QPainter>
+#include <QScrollBar>
+#include <QWidget>
+#include <algorithm>
+
+const double ViewSnapshotService::kMinScale = 0.125;
+
+/**
+ * @brief 构造函数
+ * @param view 要截图的视图
+ */
+ViewSnapshotService::ViewSnapshotService(QGraphicsView* view)
+    : QObject(view),
+    _view(view),
+    _scale(1.),
+    _baseValid(false),
+    _baseScrollX(0),
+    _baseScrollY(0)
+{
+    _timer.setSingleShot(true);
+    _timer.setInterval(0);
+    connect(&_timer, &QTimer::timeout, this, &ViewSnapshotService::render);
+}
+
+/**
+ * @brief 设置快照相对视口的比例
+ * @param scale 比例
+ */
+void ViewSnapshotService::setScale(double scale)
+{
+    scale = std::max(kMinScale, std::min(scale, 1.));
+    if (scale != _scale) {
+        _scale = scale;
+        _baseValid = false;
+    }
+}
+
+/**
+ * @brief 获取快照相对视口的比例
+ * @return 比例
+ */
+double ViewSnapshotService::getScale() const
+{
+    return _scale;
+}
+
+/**
+ * @brief 登记浮层窗口
+ * @param overlay 浮层窗口
+ */
+void ViewSnapshotService::addOverlay(QWidget* overlay)
+{
+    // 重新打开切片时浮层窗口被重建，顺便移除已删除的旧窗口
+    _overlays.erase(std::remove_if(_overlays.begin(), _overlays.end(), [](const QPointer<QWidget>& item) { return item.isNull(); }),
+        _overlays.end());
+    if (overlay) {
+        _overlays.push_back(QPointer<QWidget>(overlay));
+    }
+}
+
+/**
+ * @brief 请求一次快照
+ */
+void ViewSnapshotService::requestSnapshot()
+{
+    if (!_timer.isActive()) {
+        _timer.start();
+    }
+}
+
+/**
+ * @brief 使底图失效
+ */
+void ViewSnapshotService::invalidateScene()
+{
+    _baseValid = false;
+}
+
+/**
+ * @brief 渲染底图
+ */
+void ViewSnapshotService::renderScene()
+{
+    PipelineTrace::ScopedEvent event("ViewSnapshotService::renderScene");
+    const QRect source = _view->viewport()->rect();
+    const QSize size = (QSizeF(source.size()) * _scale).toSize().expandedTo(QSize(1, 1));
+    _base = QImage(size, QImage::Format_ARGB32_Premultiplied);
+    _base.fill(Qt::white);
+    {
+        QPainter painter(&_base);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform, _scale < 1.);
+        _view->render(&painter, QRectF(QPointF(0, 0), QSizeF(size)), source, Qt::IgnoreAspectRatio);
+    }
+    _baseTransform = _view->transform();
+    _baseScrollX = _view->horizontalScrollBar()->value();
+    _baseScrollY = _view->verticalScrollBar()->value();
+    _baseValid = true;
+}
+
+/**
+ * @brief 渲染快照
+ * @details 浮层的位置相对视图，先平移到视口原点再按比例缩放；浮层较小，每次重新绘制的开销可以忽略
+ */
+void ViewSnapshotService::render()
+{
+    if (!_view || !_view->viewport()) {
+        return;
+    }
+    const QSize expected = (QSizeF(_view->viewport()->size()) * _scale).toSize().expandedTo(QSize(1, 1));
+    if (!_baseValid || _base.size() != expected || _view->transform() != _baseTransform ||
+        _view->horizontalScrollBar()->value() != _baseScrollX || _view->verticalScrollBar()->value() != _baseScrollY) {
+        renderScene();
+    }
+
+    QImage snapshot = _base;
+    {
+        QPainter painter(&snapshot);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform, _scale < 1.);
+        painter.scale(_scale, _scale);
+        painter.translate(-_view->viewport()->pos());
+        for (const QPointer<QWidget>& overlay : _overlays) {
+            if (overlay && overlay->isVisible() && overlay->parentWidget() == _view) {
+                overlay->render(&painter, overlay->pos(), QRegion(), QWidget::DrawChildren);
+            }
+        }
+    }
+    emit snapshotReady(QPixmap::fromImage(snapshot));
+}
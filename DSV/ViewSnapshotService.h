@@ -0,0 +1,138 @@
+﻿/**
+ * @file    ViewSnapshotService.h
+ * @brief   视图快照服务类，在离屏图像上按需渲染当前视野
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了截图窗口使用的视图快照，包括：
+ *          - 用QGraphicsView::render把当前视野从场景中已缓存的瓦片绘制到离屏QImage，不读取OpenGL视口
+ *          - 快照可按比例缩小渲染
+ *          - 同一轮事件循环中的多次请求合并为一次渲染，在事件循环空闲时完成
+ *          - 视野和场景内容不变时复用底图，切换小地图、比例尺等浮层只重新合成浮层
+ *
+ * @note    该类的公有接口只能在GUI线程中调用
+ * @see     PathologyViewer, SnapDialog, SnapWidget
+ */
+
+#pragma once
+
+#include <QImage>
+#include <QObject>
+#include <QPixmap>
+#include <QPointer>
+#include <QTimer>
+#include <QTransform>
+#include <QVector>
+
+class QGraphicsView;
+class QWidget;
+
+/**
+ * @class  ViewSnapshotService
+ * @brief  视图快照服务
+ * @details requestSnapshot()只启动一个0ms的单次定时器，定时器到期时渲染一次并发出snapshotReady。
+ *          底图按视图变换、滚动位置、视口尺寸和缩放比例识别，invalidateScene()之前保持有效；
+ *          浮层（addOverlay登记的子窗口）每次在底图的副本上重新绘制。
+ *
+ * @example
+ *          // 使用示例
+ *          ViewSnapshotService* service = new ViewSnapshotService(view);
+ *          service->addOverlay(miniMap);
+ *          connect(service, &ViewSnapshotService::snapshotReady, dialog, &SnapDialog::drawPic);
+ *          service->requestSnapshot();
+ * @see     PathologyViewer
+ */
+class ViewSnapshotService : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief   构造函数
+     * @param   view 要截图的视图，同时作为父对象
+     */
+    explicit ViewSnapshotService(QGraphicsView* view);
+
+    /**
+     * @brief   设置快照相对视口的比例
+     * @param   scale 比例，限制在[kMinScale, 1]，变化时底图失效
+     */
+    void setScale(double scale);
+
+    /**
+     * @brief   获取快照相对视口的比例
+     * @return  比例
+     */
+    double getScale() const;
+
+    /**
+     * @brief   登记浮层窗口
+     * @details 浮层按其在视图中的位置绘制在底图之上，隐藏的浮层不绘制；窗口删除后自动忽略
+     * @param   overlay 视图的子窗口，如小地图、比例尺和标签窗口
+     */
+    void addOverlay(QWidget* overlay);
+
+public slots:
+    /**
+     * @brief   请求一次快照
+     * @details 在事件循环空闲时渲染，同一轮事件循环中的多次请求只渲染一次
+     */
+    void requestSnapshot();
+
+    /**
+     * @brief   使底图失效
+     * @details 场景内容变化（如新瓦片显示、标注变化）后调用，下一次快照重新渲染场景
+     */
+    void invalidateScene();
+
+signals:
+    /**
+     * @brief   快照完成信号
+     * @param   snapshot 视口大小乘以比例的快照
+     */
+    void snapshotReady(const QPixmap& snapshot);
+
+private slots:
+    /**
+     * @brief   渲染快照
+     * @details 底图有效时只在其副本上合成浮层
+     */
+    void render();
+
+private:
+    /**
+     * @brief   渲染底图
+     * @details 视图的背景、场景图元和前景绘制到离屏图像，图元使用已缓存的瓦片像素图
+     */
+    void renderScene();
+
+    /** @brief 要截图的视图 */
+    QGraphicsView* _view;
+
+    /** @brief 合并请求的单次定时器 */
+    QTimer _timer;
+
+    /** @brief 快照相对视口的比例 */
+    double _scale;
+
+    /** @brief 浮层窗口 */
+    QVector<QPointer<QWidget> > _overlays;
+
+    /** @brief 缓存的底图 */
+    QImage _base;
+
+    /** @brief 底图是否有效 */
+    bool _baseValid;
+
+    /** @brief 渲染底图时的视图变换 */
+    QTransform _baseTransform;
+
+    /** @brief 渲染底图时的水平滚动位置 */
+    int _baseScrollX;
+
+    /** @brief 渲染底图时的垂直滚动位置 */
+    int _baseScrollY;
+
+    /** @brief 快照的最小比例 */
+    static const double kMinScale;
+};
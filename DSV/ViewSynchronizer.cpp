@@ -0,0 +1,139 @@
+﻿/**
+ * @file    ViewSynchronizer.cpp
+ * @brief   多视图同步浏览实现
+ * @author  [JianZhang]
+ * @date    2025-01-19
+ * @version 1.0.0
+ */
+
+#include "ViewSynchronizer.h"
+#include "PathologyViewer.h"
+#include <algorithm>
+
+/**
+ * @brief 构造函数
+ * @param parent 父对象
+ */
+ViewSynchronizer::ViewSynchronizer(QObject* parent) :
+    QObject(parent),
+    _enabled(true),
+    _syncing(false)
+{
+}
+
+/**
+ * @brief 添加视图
+ * @param viewer 病理查看器
+ * @details 视图加载新切片后重新记录所有锚点
+ */
+void ViewSynchronizer::addViewer(PathologyViewer* viewer)
+{
+    if (!viewer) {
+        return;
+    }
+    for (const Entry& entry : _entries) {
+        if (entry.viewer == viewer) {
+            return;
+        }
+    }
+    Entry entry;
+    entry.viewer = viewer;
+    anchor(entry);
+    _entries.push_back(entry);
+    QObject::connect(viewer, SIGNAL(fieldOfViewChanged(const QRectF&, const unsigned int)), this, SLOT(onViewChanged()));
+    QObject::connect(viewer, SIGNAL(initOver()), this, SLOT(reanchor()));
+}
+
+/**
+ * @brief 移除视图
+ * @param viewer 病理查看器
+ */
+void ViewSynchronizer::removeViewer(PathologyViewer* viewer)
+{
+    _entries.erase(std::remove_if(_entries.begin(), _entries.end(),
+        [viewer](const Entry& entry) { return entry.viewer.isNull() || entry.viewer == viewer; }), _entries.end());
+    if (viewer) {
+        viewer->disconnect(this);
+    }
+}
+
+/**
+ * @brief 启用或停用同步
+ * @param enabled 是否启用
+ */
+void ViewSynchronizer::setEnabled(bool enabled)
+{
+    _enabled = enabled;
+    if (enabled) {
+        reanchor();
+    }
+}
+
+/**
+ * @brief 重新记录锚点
+ */
+void ViewSynchronizer::reanchor()
+{
+    for (Entry& entry : _entries) {
+        anchor(entry);
+    }
+}
+
+/**
+ * @brief 每微米对应的第0层像素数
+ * @param viewer 病理查看器
+ * @return 像素数，没有像素间距时为1
+ */
+double ViewSynchronizer::pixelsPerMicron(PathologyViewer* viewer)
+{
+    const double mpp = viewer->getMicronsPerPixel();
+    return mpp > 0. ? 1. / mpp : 1.;
+}
+
+/**
+ * @brief 记录视图的锚点
+ * @param entry 视图条目
+ */
+void ViewSynchronizer::anchor(Entry& entry)
+{
+    entry.anchored = false;
+    PathologyViewer* viewer = entry.viewer;
+    if (!viewer || !viewer->hasImage() || viewer->getViewScale() <= 0.) {
+        return;
+    }
+    const double ppm = pixelsPerMicron(viewer);
+    entry.anchorCenter = viewer->getViewCenter() / ppm;
+    entry.anchorScale = viewer->getViewScale() * ppm;
+    entry.anchored = true;
+}
+
+/**
+ * @brief 视图视场改变处理
+ * @details 其余视图的新中心为其锚点加上发出视图相对锚点的位移，缩放倍数相同
+ */
+void ViewSynchronizer::onViewChanged()
+{
+    if (!_enabled || _syncing) {
+        return;
+    }
+    PathologyViewer* source = qobject_cast<PathologyViewer*>(sender());
+    std::vector<Entry>::iterator sourceEntry = std::find_if(_entries.begin(), _entries.end(),
+        [source](const Entry& entry) { return entry.viewer == source; });
+    if (sourceEntry == _entries.end() || !sourceEntry->anchored || !source->hasImage()) {
+        return;
+    }
+    const double sourcePpm = pixelsPerMicron(source);
+    const QPointF delta = source->getViewCenter() / sourcePpm - sourceEntry->anchorCenter;
+    const double zoom = source->getViewScale() * sourcePpm / sourceEntry->anchorScale;
+
+    _syncing = true;
+    for (Entry& entry : _entries) {
+        PathologyViewer* viewer = entry.viewer;
+        if (viewer == source || !viewer || !entry.anchored || !viewer->hasImage()) {
+            continue;
+        }
+        const double ppm = pixelsPerMicron(viewer);
+        viewer->setView((entry.anchorCenter + delta) * ppm, entry.anchorScale * zoom / ppm);
+    }
+    _syncing = false;
+}
@@ -0,0 +1,102 @@
+﻿/**
+ * @file    ViewSynchronizer.h
+ * @brief   多视图同步浏览
+ * @author  [JianZhang]
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 并排对比连续切片（如HE与IHC）时同步各视图的平移和缩放
+ * @see     PathologyViewer, MainWin
+ */
+
+#pragma once
+#include <QObject>
+#include <QPointer>
+#include <QPointF>
+#include <vector>
+
+class PathologyViewer;
+
+/**
+ * @class  ViewSynchronizer
+ * @brief  同步多个PathologyViewer的视场
+ * @details 启用同步或有视图加载新切片时记录每个视图当前的中心和缩放作为锚点，
+ *          之后任一视图平移或缩放时，按相对锚点的物理位移（微米）和缩放倍数移动其余视图，
+ *          因此各切片在启用同步时的相对对齐关系保持不变。切片没有像素间距时按第0层像素计算。
+ *
+ * @example
+ *          ViewSynchronizer* sync = new ViewSynchronizer(this);
+ *          sync->addViewer(leftView);
+ *          sync->addViewer(rightView);
+ *          sync->setEnabled(true);
+ */
+class ViewSynchronizer : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief   构造函数
+     * @param   parent 父对象
+     */
+    explicit ViewSynchronizer(QObject* parent = nullptr);
+
+    /**
+     * @brief   添加视图
+     * @param   viewer 病理查看器，销毁时自动移除
+     */
+    void addViewer(PathologyViewer* viewer);
+
+    /**
+     * @brief   移除视图
+     * @param   viewer 病理查看器
+     */
+    void removeViewer(PathologyViewer* viewer);
+
+    /**
+     * @brief   是否启用同步
+     */
+    bool isEnabled() const { return _enabled; }
+
+public slots:
+    /**
+     * @brief   启用或停用同步
+     * @param   enabled 是否启用，启用时以各视图当前的视场为锚点
+     */
+    void setEnabled(bool enabled);
+
+    /**
+     * @brief   以各视图当前的视场重新记录锚点
+     */
+    void reanchor();
+
+private slots:
+    /**
+     * @brief   视图视场改变处理
+     * @details 由发出信号的视图驱动其余视图，同步过程中其余视图发出的信号被忽略
+     */
+    void onViewChanged();
+
+private:
+    /** @brief 视图及其锚点 */
+    struct Entry {
+        QPointer<PathologyViewer> viewer;
+        QPointF anchorCenter;       ///< 锚点中心（微米，无像素间距时为第0层像素）
+        double anchorScale = 0.;    ///< 锚点缩放（屏幕像素/微米）
+        bool anchored = false;      ///< 锚点是否有效，视图没有图像时无效
+    };
+
+    /** @brief 每微米对应的第0层像素数，没有像素间距时为1 */
+    static double pixelsPerMicron(PathologyViewer* viewer);
+
+    /** @brief 记录视图的锚点 */
+    static void anchor(Entry& entry);
+
+    /** @brief 已添加的视图 */
+    std::vector<Entry> _entries;
+
+    /** @brief 是否启用同步 */
+    bool _enabled;
+
+    /** @brief 正在移动其余视图，防止相互触发 */
+    bool _syncing;
+};
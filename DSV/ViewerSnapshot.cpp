@@ -0,0 +1,117 @@
+﻿/**
+ * @file ViewerSnapshot.cpp
+ * @brief 查看器状态快照实现文件
+ * @details 该文件实现了快照的QDataStream序列化
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "ViewerSnapshot.h"
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+#include <algorithm>
+
+const char* const ViewerSnapshot::kFileSuffix = ".resume";
+
+namespace {
+
+/** @brief 文件魔数 */
+const quint32 kSnapshotMagic = 0x44535652; // "DSVR"
+
+/** @brief 文件格式版本，版本2起每个瓦片记录所在层级的瓦片大小 */
+const quint32 kSnapshotVersion = 2;
+
+/**
+ * @brief 配置数据流的字节序和浮点精度，保证文件跨平台一致
+ */
+void setupStream(QDataStream& stream)
+{
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::DoublePrecision);
+}
+
+}
+
+/**
+ * @brief 写入快照文件
+ * @param path 文件路径
+ * @return 写入成功时返回true
+ * @details 通过QSaveFile写入，异常退出时不会留下不完整的快照
+ */
+bool ViewerSnapshot::save(const QString& path) const
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    setupStream(stream);
+    const quint32 nrTiles = static_cast<quint32>(std::min<size_t>(tiles.size(), kMaxTiles));
+    stream << kSnapshotMagic << kSnapshotVersion
+        << center.x() << center.y() << viewScale
+        << static_cast<quint32>(zPlane)
+        << static_cast<qint32>(foregroundChannel)
+        << static_cast<double>(foregroundOpacity)
+        << static_cast<quint8>(renderForeground ? 1 : 0)
+        << nrTiles;
+    for (quint32 i = 0; i < nrTiles; ++i) {
+        stream << static_cast<quint32>(tiles[i].level) << static_cast<quint32>(tiles[i].x) << static_cast<quint32>(tiles[i].y)
+            << static_cast<quint32>(tiles[i].tileSize);
+    }
+    if (stream.status() != QDataStream::Ok) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+/**
+ * @brief 读取快照文件
+ * @param path 文件路径
+ * @return 文件存在且格式正确时返回true
+ */
+bool ViewerSnapshot::load(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    setupStream(stream);
+    quint32 magic = 0, version = 0;
+    stream >> magic >> version;
+    if (magic != kSnapshotMagic || version != kSnapshotVersion) {
+        return false;
+    }
+    double x, y, scale, opacity;
+    quint32 plane, nrTiles;
+    qint32 channel;
+    quint8 render;
+    stream >> x >> y >> scale >> plane >> channel >> opacity >> render >> nrTiles;
+    if (stream.status() != QDataStream::Ok || scale <= 0. || nrTiles > kMaxTiles) {
+        return false;
+    }
+    std::vector<TileKey> keys(nrTiles);
+    for (TileKey& key : keys) {
+        quint32 level, tileX, tileY, tileSize;
+        stream >> level >> tileX >> tileY >> tileSize;
+        key.level = level;
+        key.x = tileX;
+        key.y = tileY;
+        key.tileSize = tileSize;
+    }
+    if (stream.status() != QDataStream::Ok) {
+        return false;
+    }
+    center = QPointF(x, y);
+    viewScale = scale;
+    zPlane = plane;
+    foregroundChannel = channel;
+    foregroundOpacity = static_cast<float>(opacity);
+    renderForeground = render != 0;
+    tiles.swap(keys);
+    return true;
+}
@@ -0,0 +1,92 @@
+﻿/**
+ * @file    ViewerSnapshot.h
+ * @brief   查看器状态快照，用于再次打开切片时恢复上次的视场
+ * @author  [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该文件实现了关闭切片时保存、再次打开时读取的查看器状态，包括：
+ *          - 视场中心、缩放比例和Z平面
+ *          - 叠加层的透明度、通道和是否显示
+ *          - 关闭时位于视场内的已加载瓦片
+ *          快照与磁盘瓦片缓存的包文件放在一起，这些瓦片再次打开时从磁盘缓存读取，无需重新解码。
+ *
+ * @note    格式错误或版本不符的快照被忽略，切片按冷启动打开
+ * @see     PathologyViewer::initialize, PathologyViewer::close, DiskTileCache::sidecarPath
+ */
+
+#pragma once
+
+#include <QPointF>
+#include <QString>
+#include <vector>
+
+/**
+ * @class  ViewerSnapshot
+ * @brief  查看器状态快照
+ * @details 文件为小端QDataStream：魔数、版本、状态字段、瓦片数和瓦片键。
+ *          瓦片按保存时的顺序恢复，PathologyViewer保存时按层级稳定排序，细层级的瓦片在前，
+ *          同一层级内保持瓦片缓存中的顺序
+ *
+ * @example
+ * @code
+ * ViewerSnapshot snapshot;
+ * if (snapshot.load(diskCache->sidecarPath(ViewerSnapshot::kFileSuffix))) {
+ *     viewer->setView(snapshot.center, snapshot.viewScale);
+ * }
+ * @endcode
+ */
+class ViewerSnapshot
+{
+public:
+    /**
+     * @brief 瓦片键，与TileManager的瓦片网格一致
+     */
+    struct TileKey {
+        unsigned int level;  ///< 层级
+        unsigned int x;      ///< 瓦片列号
+        unsigned int y;      ///< 瓦片行号
+        unsigned int tileSize; ///< 保存时该层级的瓦片大小
+    };
+
+    /** @brief 视场中心（第0层像素坐标） */
+    QPointF center;
+
+    /** @brief 视图缩放比例，与PathologyViewer::getViewScale一致 */
+    double viewScale = 0.;
+
+    /** @brief 显示的Z平面 */
+    unsigned int zPlane = 0;
+
+    /** @brief 叠加层显示的通道 */
+    int foregroundChannel = 0;
+
+    /** @brief 叠加层透明度 */
+    float foregroundOpacity = 1.f;
+
+    /** @brief 是否显示叠加层 */
+    bool renderForeground = true;
+
+    /** @brief 关闭时位于视场内的已加载瓦片 */
+    std::vector<TileKey> tiles;
+
+    /**
+     * @brief   写入快照文件
+     * @param   path 文件路径
+     * @return  写入成功时返回true
+     * @note    瓦片数超过kMaxTiles时只写入前kMaxTiles个
+     */
+    bool save(const QString& path) const;
+
+    /**
+     * @brief   读取快照文件
+     * @param   path 文件路径
+     * @return  文件存在且格式正确时返回true，否则保持对象不变
+     */
+    bool load(const QString& path);
+
+    /** @brief 快照文件相对于磁盘缓存包文件的后缀 */
+    static const char* const kFileSuffix;
+
+    /** @brief 最多保存的瓦片数 */
+    static const unsigned int kMaxTiles = 4096;
+};
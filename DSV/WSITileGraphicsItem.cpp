@@ -17,6 +17,9 @@
 #include "TileManager.h"
 #include <iostream>
 #include "ImageSource.h"
+#include "WSITileLayerItem.h"
+#include "PipelineProfiler.h"
+#include "PipelineTrace.h"
 
 /**
  * @brief 构造函数：初始化WSI瓦片图形项
@@ -48,11 +51,16 @@ WSITileGraphicsItem::WSITileGraphicsItem(QPixmap* item, unsigned int tileX, unsi
     _foregroundPixmap(foregroundPixmap),
     _foregroundTile(foregroundTile),
     _foregroundOpacity(foregroundOpacity),
-    _renderForeground(renderForeground)
+    _renderForeground(renderForeground),
+    _layer(NULL),
+    _solid(false),
+    _preview(false),
+    _painted(false)
 {
     if (item) {
         _item = item;
     }
+    updateSolidColor();
     if (manager) {
         _manager = manager;
     }
@@ -129,17 +137,49 @@ void WSITileGraphicsItem::paint(QPainter* painter, const QStyleOptionGraphicsIte
                 draw = true;
             }
             if (draw) {
-                QRectF pixmapArea = QRectF((option->exposedRect.left() + (_physicalSize / 2)) * (_tileSize / _physicalSize), (option->exposedRect.top() + (_physicalSize / 2)) * (_tileSize / _physicalSize), option->exposedRect.width() * (_tileSize / _physicalSize), option->exposedRect.height() * (_tileSize / _physicalSize));
-                painter->drawPixmap(option->exposedRect, *_item, pixmapArea);
-                if (_foregroundPixmap && _renderForeground && _foregroundOpacity > 0.0001) {
-                    painter->setOpacity(_foregroundOpacity);
-                    painter->drawPixmap(option->exposedRect, *_foregroundPixmap, pixmapArea);
-                }
+                drawContent(painter, option->exposedRect);
             }
         }
     }
 }
 
+/**
+ * @brief 绘制瓦片内容
+ * @param painter 绘制器
+ * @param exposedRect 瓦片坐标下的绘制区域
+ * @details 纯色瓦片直接填充；前景按绘制器透明度乘以前景透明度叠加。
+ *          paint和瓦片图层的BestResident绘制都经过这里，PaintTile阶段在此计时
+ */
+void WSITileGraphicsItem::drawContent(QPainter* painter, const QRectF& exposedRect) {
+    if (!_item) {
+        return;
+    }
+    PipelineProfiler::ScopedTimer timer(PipelineProfiler::PaintTile);
+    PipelineTrace::ScopedEvent event("WSITileGraphicsItem::drawContent", _tileX, _tileY, _itemLevel);
+    if (!_painted) {
+        // 首次绘制结束该瓦片的流，之后的重绘只记录作用域事件
+        _painted = true;
+        PipelineTrace::flow(PipelineTrace::FlowEnd, _tileX, _tileY, _itemLevel);
+    }
+    QRectF pixmapArea = QRectF((exposedRect.left() + (_physicalSize / 2)) * (_tileSize / _physicalSize), (exposedRect.top() + (_physicalSize / 2)) * (_tileSize / _physicalSize), exposedRect.width() * (_tileSize / _physicalSize), exposedRect.height() * (_tileSize / _physicalSize));
+    if (_solid) {
+        painter->fillRect(exposedRect, _solidColor);
+    }
+    else if (_preview) {
+        const qreal previewScale = static_cast<qreal>(_item->width()) / _tileSize;
+        painter->drawPixmap(exposedRect, *_item, QRectF(pixmapArea.topLeft() * previewScale, pixmapArea.size() * previewScale));
+    }
+    else {
+        painter->drawPixmap(exposedRect, *_item, pixmapArea);
+    }
+    if (_foregroundPixmap && _renderForeground && _foregroundOpacity > 0.0001) {
+        const qreal opacity = painter->opacity();
+        painter->setOpacity(opacity * _foregroundOpacity);
+        painter->drawPixmap(exposedRect, *_foregroundPixmap, pixmapArea);
+        painter->setOpacity(opacity);
+    }
+}
+
 /**
  * @brief 调试打印
  * @details 打印瓦片的位置、可见性、层级等调试信息
@@ -161,7 +201,33 @@ void WSITileGraphicsItem::setForegroundPixmap(QPixmap* foregroundPixmap) {
     QPixmap* oldPixmap = _foregroundPixmap;
     _foregroundPixmap = foregroundPixmap;
     delete oldPixmap;
-    this->update();
+    requestUpdate();
+}
+
+/**
+ * @brief 设置背景像素图
+ * @param backgroundPixmap 新的背景像素图
+ * @param preview 是否为预览
+ * @details 替换当前的背景像素图并删除旧的像素图
+ */
+void WSITileGraphicsItem::setBackgroundPixmap(QPixmap* backgroundPixmap, bool preview) {
+    QPixmap* oldPixmap = _item;
+    _item = backgroundPixmap;
+    _preview = preview && backgroundPixmap;
+    delete oldPixmap;
+    updateSolidColor();
+    requestUpdate();
+}
+
+/**
+ * @brief 更新纯色瓦片标记
+ * @details 1x1像素图转换为QImage的开销可以忽略，每次设置背景时只做一次
+ */
+void WSITileGraphicsItem::updateSolidColor() {
+    _solid = _item && _tileSize > 1 && _item->width() == 1 && _item->height() == 1;
+    if (_solid) {
+        _solidColor = QColor::fromRgba(_item->toImage().pixel(0, 0));
+    }
 }
 
 /**
@@ -173,6 +239,70 @@ ImageSource* WSITileGraphicsItem::getForegroundTile() {
     return _foregroundTile;
 }
 
+/**
+ * @brief 设置前景
+ * @param foregroundTile 前景瓦片数据源
+ * @param foregroundPixmap 前景像素图
+ * @details 替换前景数据源和前景像素图并删除旧的对象
+ */
+void WSITileGraphicsItem::setForeground(ImageSource* foregroundTile, QPixmap* foregroundPixmap) {
+    ImageSource* oldTile = _foregroundTile;
+    _foregroundTile = foregroundTile;
+    delete oldTile;
+    setForegroundPixmap(foregroundPixmap);
+}
+
+/**
+ * @brief 释放前景
+ * @details 删除前景像素图和前景数据源，背景保持不变
+ */
+void WSITileGraphicsItem::releaseForeground() {
+    if (!_foregroundPixmap && !_foregroundTile) {
+        return;
+    }
+    setForeground(NULL, NULL);
+}
+
+/**
+ * @brief 估计像素图的内存占用
+ * @param pixmap 像素图，可为NULL
+ * @return 宽×高×位深/8
+ */
+static unsigned long long pixmapByteSize(const QPixmap* pixmap) {
+    if (!pixmap || pixmap->isNull()) {
+        return 0;
+    }
+    return static_cast<unsigned long long>(pixmap->width()) * pixmap->height() * pixmap->depth() / 8;
+}
+
+/**
+ * @brief 获取背景瓦片的内存占用
+ * @return 背景像素图的字节数
+ */
+unsigned long long WSITileGraphicsItem::getBackgroundByteSize() const {
+    return pixmapByteSize(_item);
+}
+
+/**
+ * @brief 获取前景的内存占用
+ * @return 前景像素图和前景数据源缓冲区的字节数
+ */
+unsigned long long WSITileGraphicsItem::getForegroundByteSize() const {
+    unsigned long long bytes = pixmapByteSize(_foregroundPixmap);
+    if (_foregroundTile) {
+        bytes += _foregroundTile->getByteSize();
+    }
+    return bytes;
+}
+
+/**
+ * @brief 获取瓦片图形项的实际内存占用
+ * @return 背景、前景和图形项本身的字节数
+ */
+unsigned long long WSITileGraphicsItem::getByteSize() const {
+    return sizeof(WSITileGraphicsItem) + getBackgroundByteSize() + getForegroundByteSize();
+}
+
 /**
  * @brief 设置前景透明度
  * @param opacity 透明度值（0.0-1.0）
@@ -180,7 +310,7 @@ ImageSource* WSITileGraphicsItem::getForegroundTile() {
  */
 void WSITileGraphicsItem::setForegroundOpacity(float opacity) {
     _foregroundOpacity = opacity;
-    this->update();
+    requestUpdate();
 }
 
 /**
@@ -199,7 +329,7 @@ float WSITileGraphicsItem::getForegroundOpacity() {
 void WSITileGraphicsItem::setRenderForeground(bool renderForeground)
 {
     _renderForeground = renderForeground;
-    this->update();
+    requestUpdate();
 }
 
 /**
@@ -210,3 +340,26 @@ bool WSITileGraphicsItem::getRenderForeground()
 {
     return _renderForeground;
 }
+
+/**
+ * @brief 设置所属的瓦片图层
+ * @param layer 瓦片图层指针
+ */
+void WSITileGraphicsItem::setLayer(WSITileLayerItem* layer)
+{
+    _layer = layer;
+}
+
+/**
+ * @brief 请求重绘瓦片
+ * @details 图层中的瓦片不在场景中，update()不会产生重绘，需由图层重绘对应区域
+ */
+void WSITileGraphicsItem::requestUpdate()
+{
+    if (_layer) {
+        _layer->updateTile(this);
+    }
+    else {
+        this->update();
+    }
+}
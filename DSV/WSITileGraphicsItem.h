@@ -20,9 +20,11 @@
 #pragma once
 
 #include <QGraphicsItem>
+#include <QColor>
 
 class ImageSource;
 class TileManager;
+class WSITileLayerItem;
 
 /**
  * @brief   瓦片图形项类
@@ -42,8 +44,9 @@ class TileManager;
  *     lastRenderLevel, downsamples, tileManager,
  *     foregroundPixmap, foregroundSource, opacity, true);
  *
- * // 添加到图形场景
- * scene->addItem(tileItem);
+ * // 设置瓦片中心位置后交给瓦片图层管理和绘制
+ * tileItem->setPos(centerX, centerY);
+ * tileLayer->addTile(tileItem);
  * @endcode
  */
 class WSITileGraphicsItem : public QGraphicsItem {
@@ -107,6 +110,15 @@ public:
     void paint(QPainter* painter, const QStyleOptionGraphicsItem* option,
         QWidget* widget);
 
+    /**
+     * @brief   绘制瓦片内容
+     * @param   painter     绘制器指针，坐标系原点为瓦片中心
+     * @param   exposedRect 瓦片坐标下需要绘制的区域
+     * @details 不做LOD判断，直接绘制背景和前景；前景透明度与绘制器当前透明度相乘，
+     *          因此可以整体淡入。由paint和WSITileLayerItem调用
+     */
+    void drawContent(QPainter* painter, const QRectF& exposedRect);
+
     /**
      * @brief   调试打印函数
      * @details 打印瓦片图形项的调试信息，包括位置、大小、级别等属性
@@ -145,12 +157,61 @@ public:
      */
     void setForegroundPixmap(QPixmap* foregroundPixmap);
 
+    /**
+     * @brief   设置背景瓦片图像
+     * @param   backgroundPixmap    背景瓦片图像指针，所有权转移给图形项
+     * @param   preview             是否为缩小解码的预览，预览像素图比瓦片小，绘制时按比例放大
+     * @details 替换背景瓦片图像，用于通道合成设置改变后就地更新已显示的瓦片，
+     *          以及完整解码到达后替换预览，瓦片位置和大小不变，缓存占用由TileManager重新计算
+     */
+    void setBackgroundPixmap(QPixmap* backgroundPixmap, bool preview = false);
+
+    /**
+     * @brief   判断背景是否为预览
+     * @return  背景为缩小解码的预览、完整解码尚未到达时返回true
+     * @see     setBackgroundPixmap, IOThread::tilePreviewLoaded
+     */
+    bool isPreview() const { return _preview; }
+
     /**
      * @brief   获取前景瓦片数据源
-     * @return  前景瓦片数据源指针
+     * @return  前景瓦片数据源指针，前景已释放或没有前景时为NULL
      */
     ImageSource* getForegroundTile();
 
+    /**
+     * @brief   设置前景瓦片数据源和前景瓦片图像
+     * @param   foregroundTile      前景瓦片数据源，所有权转移给图形项
+     * @param   foregroundPixmap    前景瓦片图像，所有权转移给图形项
+     * @details 用于恢复被releaseForeground()释放的前景，原有的前景被删除
+     */
+    void setForeground(ImageSource* foregroundTile, QPixmap* foregroundPixmap);
+
+    /**
+     * @brief   释放前景
+     * @details 删除前景瓦片图像和前景数据源，只保留背景瓦片，
+     *          用于在不淘汰背景瓦片的情况下回收叠加层内存
+     */
+    void releaseForeground();
+
+    /**
+     * @brief   获取背景瓦片的内存占用
+     * @return  背景像素图的字节数
+     */
+    unsigned long long getBackgroundByteSize() const;
+
+    /**
+     * @brief   获取前景的内存占用
+     * @return  前景像素图与前景数据源缓冲区的字节数之和
+     */
+    unsigned long long getForegroundByteSize() const;
+
+    /**
+     * @brief   获取瓦片图形项的实际内存占用
+     * @return  背景、前景和图形项本身的字节数之和，作为缓存项的大小
+     */
+    unsigned long long getByteSize() const;
+
     /**
      * @brief   设置前景透明度
      * @param   opacity     透明度值（0.0-1.0）
@@ -177,10 +238,51 @@ public:
      */
     bool getRenderForeground();
 
+    /**
+     * @brief   设置所属的瓦片图层
+     * @param   layer   瓦片图层指针，NULL表示不属于任何图层
+     * @details 属于图层时瓦片不在场景中，内容改变时通过图层请求重绘
+     */
+    void setLayer(WSITileLayerItem* layer);
+
+    /**
+     * @brief   判断是否为纯色瓦片
+     * @return  背景为1x1像素图时返回true，绘制时直接填充该颜色
+     * @see     IOWorker::readBackgroundImage
+     */
+    bool isSolid() const { return _solid; }
+
 private:
-    /** @brief 背景瓦片图像指针，存储实际的图像数据 */
+    /**
+     * @brief   更新纯色瓦片标记
+     * @details 背景像素图为1x1时读取其颜色，绘制时用fillRect代替drawPixmap
+     */
+    void updateSolidColor();
+
+    /**
+     * @brief   请求重绘瓦片
+     * @details 属于图层时由图层重绘瓦片所在区域，否则调用QGraphicsItem::update
+     */
+    void requestUpdate();
+
+    /** @brief 所属的瓦片图层 */
+    WSITileLayerItem* _layer;
+
+    /** @brief 背景瓦片图像指针，存储实际的图像数据；纯色瓦片为1x1像素图 */
     QPixmap* _item;
 
+    /** @brief 背景是否为纯色 */
+    bool _solid;
+
+    /** @brief 背景是否为预览 */
+    bool _preview;
+
+    /** @brief 纯色瓦片的颜色 */
+    QColor _solidColor;
+
+    /** @brief 是否已绘制过，用于在时间线上标记首次绘制 */
+    bool _painted;
+
     /** @brief 前景瓦片图像指针，用于叠加显示 */
     QPixmap* _foregroundPixmap;
 
@@ -214,7 +316,7 @@ private:
     /** @brief 瓦片的像素大小 */
     unsigned int _tileSize;
 
-    /** @brief 瓦片的字节大小 */
+    /** @brief IO线程报告的瓦片解码数据字节大小 */
     unsigned int _tileByteSize;
 
     /** @brief 上次渲染的分辨率级别 */
@@ -32,7 +32,8 @@ class WSITileGraphicsItem;
  *          通过缓存机制显著提升图像浏览的流畅性。
  *
  * @note    该类使用模板特化，专门缓存WSITileGraphicsItem*类型的对象。
- *          缓存键为位置字符串（x-y-level格式），值为瓦片项和大小信息。
+ *          缓存键由makeKey(x, y, level)生成，存储、查找和LRU维护由基类的分片哈希表完成。
+ *          缓存不拥有瓦片项：清空时不删除瓦片项，淘汰时通过itemEvicted信号交给TileManager处理。
  *
  * @example
  * @code
@@ -41,7 +42,8 @@ class WSITileGraphicsItem;
  *
  * // 存储瓦片图形项
  * WSITileGraphicsItem* tileItem = createTileItem(x, y, level);
- * cache->set(key, tileItem, tileSize);
+ * WSITileGraphicsItemCache::keyType key = WSITileGraphicsItemCache::makeKey(x, y, level);
+ * cache->set(key, tileItem, tileItem->getByteSize());
  *
  * // 获取瓦片图形项
  * WSITileGraphicsItem* cachedItem;
@@ -49,7 +51,7 @@ class WSITileGraphicsItem;
  * cache->get(key, cachedItem, size);
  * @endcode
  */
-class WSITileGraphicsItemCache : public QObject, public TileCache<WSITileGraphicsItem* > {
+class WSITileGraphicsItemCache : public QObject, public TileCache<WSITileGraphicsItem> {
 	Q_OBJECT
 
 public:
@@ -59,41 +61,6 @@ public:
 	 */
 	~WSITileGraphicsItemCache();
 
-	/**
-	 * @brief   清空缓存
-	 * @details 移除缓存中的所有瓦片图形项，释放所有内存。
-	 *          在图像切换或内存不足时调用此函数。
-	 */
-	void clear();
-
-	/**
-	 * @brief   获取瓦片图形项
-	 * @param   k       缓存键（位置字符串）
-	 * @param   tile    输出参数：瓦片图形项指针
-	 * @param   size    输出参数：瓦片大小
-	 * @details 从缓存中获取指定键的瓦片图形项。如果缓存命中，
-	 *          返回缓存的瓦片项；如果缓存未命中，tile参数为nullptr。
-	 *          同时更新LRU列表，将访问的项移到最前面。
-	 *
-	 * @note    该函数是线程安全的
-	 */
-	void get(const keyType& k, WSITileGraphicsItem*& tile, unsigned int& size);
-
-	/**
-	 * @brief   存储瓦片图形项
-	 * @param   k           缓存键（位置字符串）
-	 * @param   v           瓦片图形项指针
-	 * @param   size        瓦片大小
-	 * @param   topLevel    是否为顶层项（优先级更高）
-	 * @return  操作结果：0表示成功，-1表示失败
-	 * @details 将瓦片图形项存储到缓存中。如果缓存已满，
-	 *          会自动清理最久未使用的项。支持顶层项标记，
-	 *          顶层项具有更高的缓存优先级。
-	 *
-	 * @note    该函数是线程安全的，会自动处理内存不足的情况
-	 */
-	int set(const keyType& k, WSITileGraphicsItem* v, unsigned int size, bool topLevel = false);
-
 	/**
 	 * @brief   获取所有缓存项
 	 * @return  所有瓦片图形项的指针向量
@@ -104,32 +71,32 @@ public:
 	 */
 	std::vector<WSITileGraphicsItem*> getAllItems();
 
+	/**
+	 * @brief   查找瓦片图形项
+	 * @param   k    缓存键
+	 * @param   tile 输出瓦片图形项，未找到时为NULL
+	 * @param   size 输出缓存大小
+	 * @details 在基类查找之外记录命中/未命中计数
+	 */
+	void get(const keyType& k, WSITileGraphicsItem*& tile, unsigned int& size);
+
 protected:
 	/**
-	 * @brief   清理缓存项
-	 * @details 当缓存大小超过限制时，自动清理最久未使用的项。
-	 *          清理过程会发送itemEvicted信号通知被清理的项。
-	 *          该函数由基类TileCache调用。
-	 *
-	 * @note    该函数是虚函数重写，实现具体的清理逻辑
+	 * @brief   释放瓦片图形项
+	 * @details 瓦片图形项归场景和TileManager所有，清空缓存时不删除
+	 * @param   value 瓦片图形项指针
 	 */
-	void evict();
+	void releaseValue(WSITileGraphicsItem* value);
 
-private:
 	/**
-	 * @brief   缓存数据结构
-	 * @details 缓存的核心数据结构，使用std::map存储：
-	 *          - 键：位置字符串（x-y-level格式）
-	 *          - 值：包含瓦片项指针、大小和LRU迭代器的pair
+	 * @brief   瓦片图形项被淘汰
+	 * @details 当缓存大小超过限制时，基类淘汰最久未使用的项后调用此函数，
+	 *          记录淘汰计数并发送itemEvicted信号通知被清理的项。调用时不持有缓存锁。
 	 *
-	 * 结构说明：
-	 * - 外层pair：瓦片项信息 + LRU迭代器
-	 * - 内层pair：瓦片项指针 + 大小
-	 * - keyTypeList::iterator：指向LRU列表中的位置
-	 *
-	 * @note    该结构支持O(log n)的查找和O(1)的LRU更新
+	 * @param   value 被淘汰的瓦片图形项
+	 * @note    该函数是虚函数重写，实现具体的清理逻辑
 	 */
-	std::map<keyType, std::pair<std::pair<WSITileGraphicsItem*, unsigned int>, keyTypeList::iterator> > _cache;
+	void onEvicted(WSITileGraphicsItem* value);
 
 signals:
 	/**
@@ -138,7 +105,7 @@ signals:
 	 * @details 当瓦片图形项因缓存策略被清理时，发送此信号。
 	 *          可用于监控缓存行为、统计清理频率等。
 	 *
-	 * @note    该信号在evict()函数中发送
+	 * @note    该信号在onEvicted()函数中发送
 	 */
 	void itemEvicted(WSITileGraphicsItem* item);
 };
\ No newline at end of file
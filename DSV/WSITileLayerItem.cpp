@@ -0,0 +1,527 @@
+﻿/**
+ * @file WSITileLayerItem.cpp
+ * @brief 瓦片图层图形项实现文件
+ * @details 该文件实现了按层级网格索引瓦片的图层图形项，包括：
+ *          - 瓦片的添加、移除和查找
+ *          - 按暴露区域和LOD裁剪的批量绘制
+ *          - 已驻留最精细层级的选择和新瓦片的淡入
+ *          - 作为最底层的缩略图
+ * @author [JianZhang] ([])
+ * @date    2025-01-19
+ * @version 1.0
+ */
+
+#include "WSITileLayerItem.h"
+#include "WSITileGraphicsItem.h"
+#include <QStyleOptionGraphicsItem>
+#include <QPainter>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief 构造函数：初始化瓦片图层
+ * @param levelDownsamples 各层级的降采样因子
+ * @param lastRenderLevel 最后渲染层级
+ * @param levelTileSizes 各层级的瓦片大小
+ * @param bounds 图层边界
+ * @details 按与WSITileGraphicsItem相同的公式计算各层级的瓦片边长和下界LOD
+ */
+WSITileLayerItem::WSITileLayerItem(const std::vector<float>& levelDownsamples, unsigned int lastRenderLevel, const std::vector<unsigned int>& levelTileSizes, const QRectF& bounds) :
+    QGraphicsObject(),
+    _bounds(bounds),
+    _nrTiles(0),
+    _paintMode(BestResident),
+    _fadeDuration(150),
+    _fadeTimer(this)
+{
+    _levels.resize(levelDownsamples.size());
+    if (lastRenderLevel < levelDownsamples.size() && levelTileSizes.size() >= levelDownsamples.size()) {
+        float lastRenderLevelDownsample = levelDownsamples[lastRenderLevel];
+        for (unsigned int level = 0; level < _levels.size(); ++level) {
+            _levels[level].tileExtent = levelTileSizes[level] / (lastRenderLevelDownsample / levelDownsamples[level]);
+            if (level >= lastRenderLevel || level + 1 >= levelDownsamples.size()) {
+                _levels[level].lowerLOD = 0.f;
+            }
+            else {
+                float avgDownsample = (levelDownsamples[level + 1] + levelDownsamples[level]) / 2.f;
+                _levels[level].lowerLOD = lastRenderLevelDownsample / avgDownsample;
+            }
+        }
+    }
+    this->setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+    _clock.start();
+    _fadeTimer.setInterval(kFadeInterval);
+    connect(&_fadeTimer, &QTimer::timeout, this, &WSITileLayerItem::onFadeTimer);
+}
+
+/**
+ * @brief 析构函数：删除剩余的瓦片
+ */
+WSITileLayerItem::~WSITileLayerItem() {
+    clearTiles();
+}
+
+/**
+ * @brief 获取边界矩形
+ * @return 图层边界
+ */
+QRectF WSITileLayerItem::boundingRect() const {
+    return _bounds;
+}
+
+/**
+ * @brief 计算瓦片键
+ * @param tileX 瓦片X坐标
+ * @param tileY 瓦片Y坐标
+ * @return 键
+ */
+unsigned long long WSITileLayerItem::tileKey(unsigned int tileX, unsigned int tileY) {
+    return (static_cast<unsigned long long>(tileX) << 32) | tileY;
+}
+
+/**
+ * @brief 计算瓦片矩形
+ * @param level 层级
+ * @param tileX 瓦片X坐标
+ * @param tileY 瓦片Y坐标
+ * @return 图层坐标下的瓦片矩形
+ */
+QRectF WSITileLayerItem::tileRect(unsigned int level, unsigned int tileX, unsigned int tileY) const {
+    float extent = _levels[level].tileExtent;
+    return QRectF(tileX * extent, tileY * extent, extent, extent);
+}
+
+/**
+ * @brief 添加瓦片
+ * @param tile 瓦片图形项
+ * @return 是否添加成功
+ */
+bool WSITileLayerItem::addTile(WSITileGraphicsItem* tile) {
+    unsigned int level = tile->getTileLevel();
+    if (level >= _levels.size()) {
+        return false;
+    }
+    if (!_levels[level].tiles.insert(std::make_pair(tileKey(tile->getTileX(), tile->getTileY()), tile)).second) {
+        return false;
+    }
+    ++_nrTiles;
+    tile->setLayer(this);
+    if (_paintMode == BestResident && _fadeDuration > 0 &&
+        (!_overview.isNull() || findCoarserTile(level, tileRect(level, tile->getTileX(), tile->getTileY()).center()))) {
+        _fadeStarts[tile] = _clock.elapsed();
+        if (!_fadeTimer.isActive()) {
+            _fadeTimer.start();
+        }
+    }
+    updateTile(tile);
+    return true;
+}
+
+/**
+ * @brief 移除瓦片
+ * @param tile 瓦片图形项
+ * @details 只有索引中记录的正是该瓦片时才移除
+ */
+void WSITileLayerItem::removeTile(WSITileGraphicsItem* tile) {
+    unsigned int level = tile->getTileLevel();
+    if (level >= _levels.size()) {
+        return;
+    }
+    std::unordered_map<unsigned long long, WSITileGraphicsItem*>& tiles = _levels[level].tiles;
+    std::unordered_map<unsigned long long, WSITileGraphicsItem*>::iterator it = tiles.find(tileKey(tile->getTileX(), tile->getTileY()));
+    if (it != tiles.end() && it->second == tile) {
+        updateTile(tile);
+        tiles.erase(it);
+        --_nrTiles;
+        _fadeStarts.erase(tile);
+        tile->setLayer(NULL);
+    }
+}
+
+/**
+ * @brief 删除所有瓦片
+ */
+void WSITileLayerItem::clearTiles() {
+    for (auto& level : _levels) {
+        for (auto& entry : level.tiles) {
+            delete entry.second;
+        }
+        level.tiles.clear();
+    }
+    _nrTiles = 0;
+    _fadeStarts.clear();
+    _fadeTimer.stop();
+    this->update();
+}
+
+/**
+ * @brief 查找瓦片
+ * @param tileX 瓦片X坐标
+ * @param tileY 瓦片Y坐标
+ * @param level 层级
+ * @return 瓦片图形项或NULL
+ */
+WSITileGraphicsItem* WSITileLayerItem::getTile(unsigned int tileX, unsigned int tileY, unsigned int level) const {
+    if (level >= _levels.size()) {
+        return NULL;
+    }
+    std::unordered_map<unsigned long long, WSITileGraphicsItem*>::const_iterator it = _levels[level].tiles.find(tileKey(tileX, tileY));
+    return it != _levels[level].tiles.end() ? it->second : NULL;
+}
+
+/**
+ * @brief 请求重绘瓦片区域
+ * @param tile 瓦片图形项
+ */
+void WSITileLayerItem::updateTile(WSITileGraphicsItem* tile) {
+    if (tile->getTileLevel() < _levels.size()) {
+        this->update(tileRect(tile->getTileLevel(), tile->getTileX(), tile->getTileY()));
+    }
+}
+
+/**
+ * @brief 获取瓦片数量
+ * @return 瓦片数量
+ */
+unsigned int WSITileLayerItem::getNumberOfTiles() const {
+    return _nrTiles;
+}
+
+/**
+ * @brief 绘制图层
+ * @param painter 绘制器
+ * @param option 样式选项
+ * @param widget 小部件
+ * @details 按绘制模式选择绘制方式
+ */
+void WSITileLayerItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) {
+    const QRectF exposed = option->exposedRect.intersected(_bounds);
+    if (exposed.isEmpty() || (_nrTiles == 0 && _overview.isNull())) {
+        return;
+    }
+    const float lod = option->levelOfDetailFromTransform(painter->worldTransform());
+    if (_paintMode == BestResident && paintBestResident(exposed, lod, painter)) {
+        return;
+    }
+    paintStacked(exposed, lod, painter, option, widget);
+}
+
+/**
+ * @brief 按StackLevels模式绘制
+ * @param exposed 暴露区域
+ * @param lod 当前LOD
+ * @param painter 绘制器
+ * @param option 样式选项
+ * @param widget 小部件
+ * @details 从最粗层级到最细层级绘制，按层级选择逐单元查表或遍历瓦片中代价较小的方式
+ */
+void WSITileLayerItem::paintStacked(const QRectF& exposed, float lod, QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) {
+    drawOverview(exposed, painter);
+    for (int level = static_cast<int>(_levels.size()) - 1; level >= 0; --level) {
+        const Level& current = _levels[level];
+        if (current.tiles.empty() || lod <= current.lowerLOD || current.tileExtent <= 0.f) {
+            continue;
+        }
+        long long firstX = std::max(0LL, static_cast<long long>(std::floor(exposed.left() / current.tileExtent)));
+        long long firstY = std::max(0LL, static_cast<long long>(std::floor(exposed.top() / current.tileExtent)));
+        long long lastX = static_cast<long long>(std::floor(exposed.right() / current.tileExtent));
+        long long lastY = static_cast<long long>(std::floor(exposed.bottom() / current.tileExtent));
+        if (lastX < firstX || lastY < firstY) {
+            continue;
+        }
+        unsigned long long nrCells = static_cast<unsigned long long>(lastX - firstX + 1) * (lastY - firstY + 1);
+        if (nrCells <= current.tiles.size()) {
+            for (long long y = firstY; y <= lastY; ++y) {
+                for (long long x = firstX; x <= lastX; ++x) {
+                    std::unordered_map<unsigned long long, WSITileGraphicsItem*>::const_iterator it = current.tiles.find(tileKey(x, y));
+                    if (it != current.tiles.end()) {
+                        paintTile(it->second, exposed.intersected(tileRect(level, x, y)), painter, option, widget);
+                    }
+                }
+            }
+        }
+        else {
+            for (const auto& entry : current.tiles) {
+                WSITileGraphicsItem* tile = entry.second;
+                QRectF tileExposed = exposed.intersected(tileRect(level, tile->getTileX(), tile->getTileY()));
+                if (!tileExposed.isEmpty()) {
+                    paintTile(tile, tileExposed, painter, option, widget);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief 绘制单个瓦片
+ * @param tile 瓦片图形项
+ * @param exposed 图层坐标下的暴露区域
+ * @param painter 绘制器
+ * @param option 图层的样式选项
+ * @param widget 小部件
+ * @details 切换到瓦片自身坐标系（原点为瓦片中心）后调用瓦片的paint，之后恢复变换和透明度
+ */
+void WSITileLayerItem::paintTile(WSITileGraphicsItem* tile, const QRectF& exposed, QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) {
+    if (exposed.isEmpty()) {
+        return;
+    }
+    const QPointF center = tile->pos();
+    const QTransform layerTransform = painter->worldTransform();
+    const qreal opacity = painter->opacity();
+    QStyleOptionGraphicsItem tileOption(*option);
+    tileOption.exposedRect = exposed.translated(-center);
+    painter->setWorldTransform(QTransform::fromTranslate(center.x(), center.y()) * layerTransform);
+    tile->paint(painter, &tileOption, widget);
+    painter->setWorldTransform(layerTransform);
+    painter->setOpacity(opacity);
+}
+
+
+/**
+ * @brief 按BestResident模式绘制
+ * @param exposed 暴露区域
+ * @param lod 当前LOD
+ * @param painter 绘制器
+ * @return 是否已绘制
+ * @details 目标层级为下界LOD低于当前LOD的最精细层级，逐单元选择已驻留的最精细瓦片。
+ *          各层级使用原生瓦片大小时，目标层级的单元可能跨越多个粗层级瓦片，
+ *          因此未完全覆盖的单元由drawCoarser按粗层级瓦片分块填充
+ */
+bool WSITileLayerItem::paintBestResident(const QRectF& exposed, float lod, QPainter* painter) {
+    int target = -1;
+    for (unsigned int level = 0; level < _levels.size(); ++level) {
+        if (lod > _levels[level].lowerLOD && _levels[level].tileExtent > 0.f) {
+            target = level;
+            break;
+        }
+    }
+    if (target < 0) {
+        return true;
+    }
+    const Level& current = _levels[target];
+    long long firstX = std::max(0LL, static_cast<long long>(std::floor(exposed.left() / current.tileExtent)));
+    long long firstY = std::max(0LL, static_cast<long long>(std::floor(exposed.top() / current.tileExtent)));
+    long long lastX = static_cast<long long>(std::floor(exposed.right() / current.tileExtent));
+    long long lastY = static_cast<long long>(std::floor(exposed.bottom() / current.tileExtent));
+    if (lastX < firstX || lastY < firstY) {
+        return true;
+    }
+    if (static_cast<unsigned long long>(lastX - firstX + 1) * (lastY - firstY + 1) > kMaxPaintCells) {
+        return false;
+    }
+    for (long long y = firstY; y <= lastY; ++y) {
+        for (long long x = firstX; x <= lastX; ++x) {
+            const QRectF cell = exposed.intersected(tileRect(target, x, y));
+            if (cell.isEmpty()) {
+                continue;
+            }
+            std::unordered_map<unsigned long long, WSITileGraphicsItem*>::const_iterator it = current.tiles.find(tileKey(x, y));
+            WSITileGraphicsItem* tile = it != current.tiles.end() ? it->second : NULL;
+            const qreal opacity = tile ? fadeOpacity(tile) : 0.;
+            if (opacity < 1.) {
+                drawCoarser(target, cell, painter);
+            }
+            if (tile) {
+                drawTile(tile, cell, painter, opacity);
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 以给定不透明度绘制瓦片内容
+ * @param tile 瓦片图形项
+ * @param exposed 图层坐标下的绘制区域
+ * @param painter 绘制器
+ * @param opacity 不透明度
+ */
+void WSITileLayerItem::drawTile(WSITileGraphicsItem* tile, const QRectF& exposed, QPainter* painter, qreal opacity) {
+    const QPointF center = tile->pos();
+    const QTransform layerTransform = painter->worldTransform();
+    const qreal layerOpacity = painter->opacity();
+    painter->setOpacity(layerOpacity * opacity);
+    painter->setWorldTransform(QTransform::fromTranslate(center.x(), center.y()) * layerTransform);
+    tile->drawContent(painter, exposed.translated(-center));
+    painter->setWorldTransform(layerTransform);
+    painter->setOpacity(layerOpacity);
+}
+
+/**
+ * @brief 绘制缩略图
+ * @param exposed 图层坐标下的绘制区域
+ * @param painter 绘制器
+ * @details 按目标区域与缩略图尺寸的比例求出源矩形
+ */
+void WSITileLayerItem::drawOverview(const QRectF& exposed, QPainter* painter) {
+    if (_overview.isNull() || _overviewTarget.isEmpty()) {
+        return;
+    }
+    const QRectF area = exposed.intersected(_overviewTarget);
+    if (area.isEmpty()) {
+        return;
+    }
+    const qreal scaleX = _overview.width() / _overviewTarget.width();
+    const qreal scaleY = _overview.height() / _overviewTarget.height();
+    const QRectF source((area.left() - _overviewTarget.left()) * scaleX, (area.top() - _overviewTarget.top()) * scaleY,
+        area.width() * scaleX, area.height() * scaleY);
+    painter->drawPixmap(area, _overview, source);
+}
+
+/**
+ * @brief 设置缩略图
+ * @param overview 缩略图
+ * @param target 图层坐标下的覆盖区域
+ */
+void WSITileLayerItem::setOverview(const QPixmap& overview, const QRectF& target) {
+    _overview = overview;
+    _overviewTarget = target;
+    this->update();
+}
+
+/**
+ * @brief 是否设置了缩略图
+ * @return 缩略图非空时返回true
+ */
+bool WSITileLayerItem::hasOverview() const {
+    return !_overview.isNull();
+}
+
+/**
+ * @brief 用粗层级瓦片填充区域
+ * @param level 起始层级（不含）
+ * @param area 图层坐标下的填充区域
+ * @param painter 绘制器
+ * @details 在下一个有瓦片的粗层级上逐个绘制与区域相交的瓦片，缺失瓦片的部分继续向更粗的层级查找，
+ *          所有层级都缺失时绘制缩略图。区域跨越多个粗层级瓦片时每个瓦片只绘制相交的部分
+ */
+void WSITileLayerItem::drawCoarser(unsigned int level, const QRectF& area, QPainter* painter) {
+    for (unsigned int coarser = level + 1; coarser < _levels.size(); ++coarser) {
+        const Level& current = _levels[coarser];
+        if (current.tiles.empty() || current.tileExtent <= 0.f) {
+            continue;
+        }
+        long long firstX = std::max(0LL, static_cast<long long>(std::floor(area.left() / current.tileExtent)));
+        long long firstY = std::max(0LL, static_cast<long long>(std::floor(area.top() / current.tileExtent)));
+        long long lastX = static_cast<long long>(std::floor(area.right() / current.tileExtent));
+        long long lastY = static_cast<long long>(std::floor(area.bottom() / current.tileExtent));
+        for (long long y = firstY; y <= lastY; ++y) {
+            for (long long x = firstX; x <= lastX; ++x) {
+                const QRectF part = area.intersected(tileRect(coarser, x, y));
+                if (part.isEmpty()) {
+                    continue;
+                }
+                std::unordered_map<unsigned long long, WSITileGraphicsItem*>::const_iterator it = current.tiles.find(tileKey(x, y));
+                if (it != current.tiles.end()) {
+                    drawTile(it->second, part, painter, 1.);
+                }
+                else {
+                    drawCoarser(coarser, part, painter);
+                }
+            }
+        }
+        return;
+    }
+    drawOverview(area, painter);
+}
+
+/**
+ * @brief 查找覆盖某点的粗层级瓦片
+ * @param level 起始层级（不含）
+ * @param point 图层坐标
+ * @return 最精细的已驻留粗层级瓦片或NULL
+ */
+WSITileGraphicsItem* WSITileLayerItem::findCoarserTile(unsigned int level, const QPointF& point) const {
+    if (point.x() < 0 || point.y() < 0) {
+        return NULL;
+    }
+    for (unsigned int coarser = level + 1; coarser < _levels.size(); ++coarser) {
+        const Level& current = _levels[coarser];
+        if (current.tiles.empty() || current.tileExtent <= 0.f) {
+            continue;
+        }
+        unsigned int x = static_cast<unsigned int>(point.x() / current.tileExtent);
+        unsigned int y = static_cast<unsigned int>(point.y() / current.tileExtent);
+        std::unordered_map<unsigned long long, WSITileGraphicsItem*>::const_iterator it = current.tiles.find(tileKey(x, y));
+        if (it != current.tiles.end()) {
+            return it->second;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 获取淡入不透明度
+ * @param tile 瓦片图形项
+ * @return 0到1之间的不透明度
+ */
+qreal WSITileLayerItem::fadeOpacity(WSITileGraphicsItem* tile) const {
+    std::unordered_map<WSITileGraphicsItem*, qint64>::const_iterator it = _fadeStarts.find(tile);
+    if (it == _fadeStarts.end() || _fadeDuration <= 0) {
+        return 1.;
+    }
+    return std::min(1., std::max(0., static_cast<double>(_clock.elapsed() - it->second) / _fadeDuration));
+}
+
+/**
+ * @brief 淡入定时器处理
+ * @details 淡入结束的瓦片再重绘一次，以完全不透明显示
+ */
+void WSITileLayerItem::onFadeTimer() {
+    const qint64 now = _clock.elapsed();
+    for (std::unordered_map<WSITileGraphicsItem*, qint64>::iterator it = _fadeStarts.begin(); it != _fadeStarts.end();) {
+        updateTile(it->first);
+        if (now - it->second >= _fadeDuration) {
+            it = _fadeStarts.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    if (_fadeStarts.empty()) {
+        _fadeTimer.stop();
+    }
+}
+
+/**
+ * @brief 设置绘制模式
+ * @param mode 绘制模式
+ */
+void WSITileLayerItem::setPaintMode(PaintMode mode) {
+    if (_paintMode == mode) {
+        return;
+    }
+    _paintMode = mode;
+    _fadeStarts.clear();
+    _fadeTimer.stop();
+    this->update();
+}
+
+/**
+ * @brief 获取绘制模式
+ * @return 绘制模式
+ */
+WSITileLayerItem::PaintMode WSITileLayerItem::getPaintMode() const {
+    return _paintMode;
+}
+
+/**
+ * @brief 设置淡入时长
+ * @param duration 毫秒数
+ */
+void WSITileLayerItem::setCrossFadeDuration(int duration) {
+    _fadeDuration = std::max(0, duration);
+    if (_fadeDuration == 0) {
+        _fadeStarts.clear();
+        _fadeTimer.stop();
+        this->update();
+    }
+}
+
+/**
+ * @brief 获取淡入时长
+ * @return 毫秒数
+ */
+int WSITileLayerItem::getCrossFadeDuration() const {
+    return _fadeDuration;
+}
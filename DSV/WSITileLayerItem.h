@@ -0,0 +1,306 @@
+﻿/**
+ * @file    WSITileLayerItem.h
+ * @brief   瓦片图层图形项类，以网格索引管理并绘制所有已加载的瓦片
+ * @author  [JianZhang]
+ * @date    2025-01-19
+ * @version 1.0.0
+ * @details 该类实现了DSV项目的瓦片图层功能，包括：
+ *          - 按层级和瓦片坐标索引所有已加载的WSITileGraphicsItem
+ *          - 绘制时只访问与暴露区域相交且处于显示LOD范围内的瓦片
+ *          - 代替逐个瓦片加入QGraphicsScene，避免场景BSP索引维护上千个图形项
+ *          - 每个屏幕区域只绘制已驻留的最精细层级，更精细的瓦片到达时短暂淡入
+ *          - 可选的整幅缩略图作为最底层，没有任何瓦片驻留的区域由它覆盖
+ *
+ * @note    瓦片图形项由图层拥有，不加入场景；图层析构时删除剩余的瓦片
+ * @see     WSITileGraphicsItem, TileManager, WSITileGraphicsItemCache
+ */
+
+#pragma once
+
+#include <QGraphicsObject>
+#include <QElapsedTimer>
+#include <QPixmap>
+#include <QTimer>
+#include <unordered_map>
+#include <vector>
+
+class WSITileGraphicsItem;
+
+/**
+ * @brief   瓦片图层图形项类
+ * @details 场景中只有这一个图形项代表全部瓦片。每个层级使用以makeKey(x, y, 0)为键的哈希表索引瓦片。
+ *
+ *          默认的BestResident模式下，先由当前LOD确定目标层级（下界LOD低于当前LOD的最精细层级），
+ *          对暴露区域内目标层级的每个网格单元：
+ *          - 目标层级的瓦片已驻留时只绘制该瓦片
+ *          - 否则绘制覆盖该单元的最精细的已驻留粗层级瓦片中与单元相交的部分
+ *          - 目标瓦片刚到达（淡入时长内）时先绘制粗层级瓦片，再以递增的不透明度绘制目标瓦片
+ *          稳定状态下每个像素只绘制一层，加载过程中也不会出现粗细瓦片的整块叠绘。
+ *          设置了缩略图时，没有粗层级瓦片的单元绘制缩略图中对应的部分，StackLevels模式下缩略图先于所有层级绘制。
+ *
+ *          StackLevels模式与原先按1/(level+1)设置Z值的叠放顺序一致，从最粗层级到最细层级依次处理：
+ *          - 层级的下界LOD不低于当前LOD时整层跳过
+ *          - 暴露区域覆盖的网格单元少于该层瓦片数时逐单元查表，否则遍历该层瓦片
+ *          - 每个瓦片以自身坐标系和裁剪后的暴露区域调用WSITileGraphicsItem::paint
+ *
+ * @note    图层坐标与原瓦片图形项所在的场景坐标相同（最后渲染层级像素坐标）
+ *
+ * @example
+ * @code
+ * WSITileLayerItem* layer = new WSITileLayerItem(downsamples, lastRenderLevel, levelTileSizes, QRectF(0, 0, w, h));
+ * scene->addItem(layer);
+ * layer->addTile(tileItem);
+ * @endcode
+ */
+class WSITileLayerItem : public QGraphicsObject {
+    Q_OBJECT
+
+public:
+    /**
+     * @brief   构造函数
+     * @param   levelDownsamples    各层级的降采样因子
+     * @param   lastRenderLevel     最后渲染层级
+     * @param   levelTileSizes      各层级的瓦片大小（像素），与levelDownsamples一一对应
+     * @param   bounds              图层边界（最后渲染层级像素坐标），应覆盖所有瓦片
+     */
+    WSITileLayerItem(const std::vector<float>& levelDownsamples, unsigned int lastRenderLevel, const std::vector<unsigned int>& levelTileSizes, const QRectF& bounds);
+
+    /**
+     * @brief   析构函数
+     * @details 删除图层中剩余的瓦片图形项
+     */
+    ~WSITileLayerItem();
+
+    /**
+     * @brief   获取边界矩形
+     * @return  图层边界
+     */
+    QRectF boundingRect() const;
+
+    /**
+     * @brief   绘制函数
+     * @param   painter     绘制器指针
+     * @param   option      绘制选项指针，exposedRect为图层坐标下的暴露区域
+     * @param   widget      绘制目标窗口指针
+     * @details 只绘制与暴露区域相交且可能在当前LOD下显示的瓦片
+     */
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget);
+
+    /**
+     * @brief   添加瓦片
+     * @param   tile 瓦片图形项，所有权转移给图层
+     * @return  true表示添加成功；该位置已有瓦片时返回false，调用者保留所有权
+     * @details 瓦片的位置由其pos()给出（瓦片中心）
+     */
+    bool addTile(WSITileGraphicsItem* tile);
+
+    /**
+     * @brief   移除瓦片
+     * @param   tile 瓦片图形项，所有权交还调用者
+     * @details 瓦片不在图层中时不做任何事
+     */
+    void removeTile(WSITileGraphicsItem* tile);
+
+    /**
+     * @brief   删除图层中的所有瓦片
+     */
+    void clearTiles();
+
+    /**
+     * @brief   查找瓦片
+     * @param   tileX 瓦片X坐标
+     * @param   tileY 瓦片Y坐标
+     * @param   level 层级
+     * @return  瓦片图形项，不存在时返回NULL
+     */
+    WSITileGraphicsItem* getTile(unsigned int tileX, unsigned int tileY, unsigned int level) const;
+
+    /**
+     * @brief   请求重绘一个瓦片所在的区域
+     * @param   tile 瓦片图形项
+     * @details 瓦片不在场景中，其内容改变时由WSITileGraphicsItem调用
+     */
+    void updateTile(WSITileGraphicsItem* tile);
+
+    /**
+     * @brief   获取图层中的瓦片数量
+     * @return  瓦片数量
+     */
+    unsigned int getNumberOfTiles() const;
+
+    /**
+     * @brief 绘制模式
+     */
+    enum PaintMode {
+        StackLevels,    ///< 各层级按LOD范围叠放绘制，粗层级在细层级未完全覆盖时整块绘制
+        BestResident    ///< 每个区域只绘制已驻留的最精细层级，新瓦片淡入
+    };
+
+    /**
+     * @brief   设置绘制模式
+     * @param   mode 绘制模式，默认BestResident
+     */
+    void setPaintMode(PaintMode mode);
+
+    /**
+     * @brief   获取绘制模式
+     * @return  绘制模式
+     */
+    PaintMode getPaintMode() const;
+
+    /**
+     * @brief   设置淡入时长
+     * @param   duration 毫秒数，0表示新瓦片立即替换粗层级瓦片，默认150
+     * @note    只在BestResident模式下生效；只有存在可以淡出的粗层级瓦片时才淡入
+     */
+    void setCrossFadeDuration(int duration);
+
+    /**
+     * @brief   获取淡入时长
+     * @return  毫秒数
+     */
+    int getCrossFadeDuration() const;
+
+    /**
+     * @brief   设置作为最底层的缩略图
+     * @param   overview 整幅图像的缩略图，为空时取消
+     * @param   target 缩略图在图层坐标下覆盖的区域
+     * @details 缩略图只在一次绘制调用中缩放到暴露区域，OpenGL视口下作为一个纹理缓存；
+     *          它没有经过瓦片的增强和颜色管理，只用于尚无瓦片驻留的区域
+     */
+    void setOverview(const QPixmap& overview, const QRectF& target);
+
+    /**
+     * @brief   是否设置了缩略图
+     * @return  缩略图非空时返回true
+     */
+    bool hasOverview() const;
+
+private slots:
+    /**
+     * @brief   淡入定时器槽函数
+     * @details 重绘正在淡入的瓦片，移除已完成淡入的记录，没有淡入的瓦片时停止定时器
+     */
+    void onFadeTimer();
+
+private:
+    /**
+     * @struct  Level
+     * @brief   单个层级的瓦片索引
+     */
+    struct Level {
+        /** @brief 以瓦片坐标为键的瓦片表 */
+        std::unordered_map<unsigned long long, WSITileGraphicsItem*> tiles;
+
+        /** @brief 瓦片在图层坐标下的边长 */
+        float tileExtent = 0.f;
+
+        /** @brief 下界LOD，当前LOD不高于该值时该层不显示 */
+        float lowerLOD = 0.f;
+    };
+
+    /** @brief 按层级索引的瓦片表 */
+    std::vector<Level> _levels;
+
+    /** @brief 图层边界 */
+    QRectF _bounds;
+
+    /** @brief 图层中的瓦片总数 */
+    unsigned int _nrTiles;
+
+    /** @brief 绘制模式 */
+    PaintMode _paintMode;
+
+    /** @brief 淡入时长（毫秒） */
+    int _fadeDuration;
+
+    /** @brief 正在淡入的瓦片及其开始时间（毫秒） */
+    std::unordered_map<WSITileGraphicsItem*, qint64> _fadeStarts;
+
+    /** @brief 淡入计时器 */
+    QElapsedTimer _clock;
+
+    /** @brief 最底层的缩略图 */
+    QPixmap _overview;
+
+    /** @brief 缩略图在图层坐标下覆盖的区域 */
+    QRectF _overviewTarget;
+
+    /** @brief 淡入期间的重绘定时器 */
+    QTimer _fadeTimer;
+
+    /** @brief 淡入重绘间隔（毫秒），约为一帧 */
+    static const int kFadeInterval = 16;
+
+    /** @brief BestResident模式下逐单元绘制的最大单元数，超过时按StackLevels绘制 */
+    static const unsigned long long kMaxPaintCells = 4096;
+
+    /**
+     * @brief   计算瓦片坐标的键
+     */
+    static unsigned long long tileKey(unsigned int tileX, unsigned int tileY);
+
+    /**
+     * @brief   计算瓦片在图层坐标下的矩形
+     */
+    QRectF tileRect(unsigned int level, unsigned int tileX, unsigned int tileY) const;
+
+    /**
+     * @brief   绘制单个瓦片
+     * @param   tile 瓦片图形项
+     * @param   exposed 图层坐标下与瓦片相交的暴露区域
+     */
+    void paintTile(WSITileGraphicsItem* tile, const QRectF& exposed, QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget);
+
+    /**
+     * @brief   绘制缩略图与给定区域相交的部分
+     * @param   exposed 图层坐标下的绘制区域
+     */
+    void drawOverview(const QRectF& exposed, QPainter* painter);
+
+    /**
+     * @brief   按StackLevels模式绘制
+     * @param   exposed 图层坐标下的暴露区域
+     * @param   lod 当前LOD
+     */
+    void paintStacked(const QRectF& exposed, float lod, QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget);
+
+    /**
+     * @brief   按BestResident模式绘制
+     * @param   exposed 图层坐标下的暴露区域
+     * @param   lod 当前LOD
+     * @return  单元数超过kMaxPaintCells未绘制时返回false
+     */
+    bool paintBestResident(const QRectF& exposed, float lod, QPainter* painter);
+
+    /**
+     * @brief   以给定不透明度绘制瓦片内容
+     * @param   tile 瓦片图形项
+     * @param   exposed 图层坐标下与瓦片相交的区域
+     * @param   opacity 不透明度
+     */
+    void drawTile(WSITileGraphicsItem* tile, const QRectF& exposed, QPainter* painter, qreal opacity);
+
+    /**
+     * @brief   用粗层级瓦片填充区域
+     * @param   level 从该层级的上一层（更粗）开始查找
+     * @param   area 图层坐标下的填充区域
+     * @details 与区域相交的每个粗层级瓦片分别绘制相交部分，缺失部分向更粗的层级查找，最后以缩略图填充
+     */
+    void drawCoarser(unsigned int level, const QRectF& area, QPainter* painter);
+
+    /**
+     * @brief   查找覆盖某点的最精细的粗层级瓦片
+     * @param   level 从该层级的上一层（更粗）开始查找
+     * @param   point 图层坐标
+     * @return  瓦片图形项，不存在时返回NULL
+     */
+    WSITileGraphicsItem* findCoarserTile(unsigned int level, const QPointF& point) const;
+
+    /**
+     * @brief   获取瓦片当前的淡入不透明度
+     * @param   tile 瓦片图形项
+     * @return  不在淡入时返回1
+     */
+    qreal fadeOpacity(WSITileGraphicsItem* tile) const;
+};
@@ -5,6 +5,10 @@
  *          - 初始化Qt应用程序
  *          - 创建并显示主窗口
  *          - 启动应用程序事件循环
+ *          - 带--benchmark参数时改为无界面运行基准测试
+ *          - 带--extract-patches参数时改为无界面提取图像块数据集
+ *          - 带--microbenchmark参数时改为无界面运行缓存和像素内核的微基准测试
+ *          - 带--convert-label-mask参数时改为无界面把分割结果转换为标签掩膜金字塔
  * @author [JianZhang] ([])
  * @date    2025-01-19
  * @version 1.0
@@ -12,17 +16,34 @@
 
 #include <QApplication>
 #include "MainWin.h"
+#include "SlideBenchmark.h"
+#include "PatchExtractor.h"
+#include "MicroBenchmark.h"
+#include "LabelMaskWriter.h"
 
 /**
  * @brief 主函数：应用程序入口点
  * @param argc 命令行参数数量
  * @param argv 命令行参数数组
  * @return 应用程序退出码
- * @details 创建Qt应用程序实例，初始化主窗口并启动事件循环
+ * @details 创建Qt应用程序实例，初始化主窗口并启动事件循环；
+ *          请求基准测试、微基准测试、图像块提取或标签掩膜转换时不创建主窗口，完成后直接退出
  */
 int main(int argc, char* argv[])
 {
     QApplication a(argc, argv);
+    if (SlideBenchmark::isRequested(a.arguments())) {
+        return SlideBenchmark::run(a.arguments());
+    }
+    if (PatchExtractor::isRequested(a.arguments())) {
+        return PatchExtractor::run(a.arguments());
+    }
+    if (MicroBenchmark::isRequested(a.arguments())) {
+        return MicroBenchmark::run(a.arguments());
+    }
+    if (LabelMaskWriter::isRequested(a.arguments())) {
+        return LabelMaskWriter::run(a.arguments());
+    }
     MainWin w;
     w.showMaximized();
     return a.exec();
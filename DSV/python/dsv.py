@@ -0,0 +1,154 @@
+"""Python access to the DSV slide decoding engine.
+
+Slides are decoded by the same MultiResolutionImage readers and tile caches
+as the viewer, through the C interface in SlideApi.h.  Region reads return
+NumPy arrays that reference the engine's pooled buffer directly: nothing is
+copied after decoding, and the buffer returns to the pool when the last
+array referencing it is garbage collected.  ctypes releases the GIL for the
+duration of each call, so several Python threads can decode concurrently.
+
+Example::
+
+    import dsv
+    with dsv.Slide("slide.svs") as slide:
+        region = slide.read_region(1000, 2000, 512, 512, level=0)  # (512, 512, 3) uint8
+"""
+
+import ctypes
+import os
+
+import numpy as np
+
+_DTYPES = {1: np.uint8, 2: np.uint16, 3: np.uint32, 4: np.float32}
+
+
+def _load_library():
+    name = os.environ.get("DSV_SLIDE_API_LIBRARY")
+    if not name:
+        name = "DSVSlideApi.dll" if os.name == "nt" else "libDSVSlideApi.so"
+    lib = ctypes.CDLL(name)
+    lib.dsv_open.restype = ctypes.c_void_p
+    lib.dsv_open.argtypes = [ctypes.c_char_p]
+    lib.dsv_close.argtypes = [ctypes.c_void_p]
+    lib.dsv_level_count.restype = ctypes.c_int
+    lib.dsv_level_count.argtypes = [ctypes.c_void_p]
+    lib.dsv_level_dimensions.restype = ctypes.c_int
+    lib.dsv_level_dimensions.argtypes = [ctypes.c_void_p, ctypes.c_int,
+                                         ctypes.POINTER(ctypes.c_ulonglong), ctypes.POINTER(ctypes.c_ulonglong)]
+    lib.dsv_level_downsample.restype = ctypes.c_double
+    lib.dsv_level_downsample.argtypes = [ctypes.c_void_p, ctypes.c_int]
+    lib.dsv_samples_per_pixel.restype = ctypes.c_int
+    lib.dsv_samples_per_pixel.argtypes = [ctypes.c_void_p]
+    lib.dsv_data_type.restype = ctypes.c_int
+    lib.dsv_data_type.argtypes = [ctypes.c_void_p]
+    lib.dsv_get_property.restype = ctypes.c_size_t
+    lib.dsv_get_property.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_size_t]
+    lib.dsv_read_region.restype = ctypes.c_void_p
+    lib.dsv_read_region.argtypes = [ctypes.c_void_p, ctypes.c_longlong, ctypes.c_longlong,
+                                    ctypes.c_ulonglong, ctypes.c_ulonglong, ctypes.c_int]
+    lib.dsv_region_data.restype = ctypes.c_void_p
+    lib.dsv_region_data.argtypes = [ctypes.c_void_p]
+    lib.dsv_region_shape.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_ulonglong)]
+    lib.dsv_region_data_type.restype = ctypes.c_int
+    lib.dsv_region_data_type.argtypes = [ctypes.c_void_p]
+    lib.dsv_release_region.argtypes = [ctypes.c_void_p]
+    lib.dsv_last_error.restype = ctypes.c_char_p
+    return lib
+
+
+_lib = _load_library()
+
+
+class DSVError(RuntimeError):
+    pass
+
+
+class _Region(object):
+    """Owns one pooled buffer and exposes it through the NumPy array interface."""
+
+    def __init__(self, handle):
+        self._handle = handle
+        shape = (ctypes.c_ulonglong * 3)()
+        _lib.dsv_region_shape(handle, shape)
+        self.__array_interface__ = {
+            "shape": tuple(int(n) for n in shape),
+            "typestr": np.dtype(_DTYPES[_lib.dsv_region_data_type(handle)]).str,
+            "data": (_lib.dsv_region_data(handle), False),
+            "version": 3,
+        }
+
+    def __del__(self):
+        if self._handle:
+            _lib.dsv_release_region(self._handle)
+            self._handle = None
+
+
+class Slide(object):
+    """A whole-slide image opened through the DSV engine."""
+
+    def __init__(self, path):
+        self._handle = _lib.dsv_open(os.fsencode(path))
+        if not self._handle:
+            raise DSVError(_lib.dsv_last_error().decode("utf-8", "replace"))
+
+    def close(self):
+        if self._handle:
+            _lib.dsv_close(self._handle)
+            self._handle = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    @property
+    def level_count(self):
+        return _lib.dsv_level_count(self._handle)
+
+    @property
+    def level_dimensions(self):
+        dims = []
+        for level in range(self.level_count):
+            width, height = ctypes.c_ulonglong(), ctypes.c_ulonglong()
+            _lib.dsv_level_dimensions(self._handle, level, ctypes.byref(width), ctypes.byref(height))
+            dims.append((width.value, height.value))
+        return dims
+
+    @property
+    def level_downsamples(self):
+        return [_lib.dsv_level_downsample(self._handle, level) for level in range(self.level_count)]
+
+    @property
+    def samples_per_pixel(self):
+        return _lib.dsv_samples_per_pixel(self._handle)
+
+    @property
+    def dtype(self):
+        return np.dtype(_DTYPES.get(_lib.dsv_data_type(self._handle), np.uint8))
+
+    def get_property(self, name):
+        key = name.encode("utf-8")
+        size = _lib.dsv_get_property(self._handle, key, None, 0)
+        if size == 0:
+            return None
+        buffer = ctypes.create_string_buffer(size + 1)
+        _lib.dsv_get_property(self._handle, key, buffer, size + 1)
+        return buffer.value.decode("utf-8", "replace")
+
+    def read_region(self, x, y, width, height, level=0):
+        """Read a region in the slide's native data type.
+
+        x and y are level-0 coordinates; width and height are level pixels.
+        Returns an array of shape (height, width, samples_per_pixel) that
+        references the decoded buffer without copying it.
+        """
+        handle = _lib.dsv_read_region(self._handle, x, y, width, height, level)
+        if not handle:
+            raise DSVError(_lib.dsv_last_error().decode("utf-8", "replace"))
+        return np.asarray(_Region(handle))
+
+    get_patch = read_region